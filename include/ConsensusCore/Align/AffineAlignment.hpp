@@ -46,4 +46,15 @@ PairwiseAlignment* AlignAffine(
 PairwiseAlignment* AlignAffineIupac(
     const std::string& target, const std::string& query,
     AffineAlignmentParams params = IupacAwareAffineAlignmentParams());  // NOLINT
+
+//
+// Affine gap-penalty alignment computed only over the diagonals
+// j - i within bandWidth of bandCenter (widened to take in both
+// corners), in memory proportional to the band.  If the path found
+// runs along the edge of the band, the band is doubled and the
+// alignment redone, up to the full matrices.
+//
+PairwiseAlignment* AlignAffineBanded(const std::string& target, const std::string& query,
+                                     AffineAlignmentParams params, int bandCenter,
+                                     int bandWidth);
 }
@@ -0,0 +1,88 @@
+// Author: David Alexander
+
+//
+// Pairwise alignment of many (target, query) pairs in one call.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Align/AffineAlignment.hpp>
+#include <ConsensusCore/Align/AlignConfig.hpp>
+
+namespace ConsensusCore {
+
+class PairwiseAlignment;
+
+/// \brief The alignments of a batch of (target, query) pairs.
+///
+/// The gapped targets, gapped queries and transcripts of the whole
+/// batch are each kept end to end in one string; alignment i spans
+/// [Offsets()[i], Offsets()[i + 1]) of each.  Callers wanting every
+/// alignment (from Python, say) can slice these, and need no object
+/// per pair.
+class PairwiseAlignmentBatch
+{
+public:
+    int Size() const;
+
+    std::string Target(int i) const;
+    std::string Query(int i) const;
+    std::string Transcript(int i) const;
+    float Score(int i) const;
+    float Accuracy(int i) const;
+
+    // A PairwiseAlignment of alignment i; the caller owns it
+    PairwiseAlignment* Alignment(int i) const;
+
+public:
+    const std::string& Targets() const;
+    const std::string& Queries() const;
+    const std::string& Transcripts() const;
+    const std::vector<int>& Offsets() const;
+    const std::vector<float>& Scores() const;
+
+public:
+    PairwiseAlignmentBatch();
+
+    // Add an alignment, given its gapped target and query, at the end
+    void Append(const std::string& alnTarget, const std::string& alnQuery, float score);
+
+    // Add the alignments of another batch at the end
+    void Append(const PairwiseAlignmentBatch& other);
+
+private:
+    std::string targets_;
+    std::string queries_;
+    std::string transcripts_;
+    std::vector<int> offsets_;
+    std::vector<float> scores_;
+};
+
+//
+// Align targets[i] to queries[i] for each i, as Align would, on
+// numThreads threads.  Each thread reuses its DP matrices from one
+// pair to the next.
+//
+PairwiseAlignmentBatch* AlignBatch(const std::vector<std::string>& targets,
+                                   const std::vector<std::string>& queries,
+                                   AlignConfig config = AlignConfig::Default(),
+                                   int numThreads = 1);
+
+//
+// Likewise, as AlignAffine would; the scores are those of the final
+// cell of the affine matrices.
+//
+PairwiseAlignmentBatch* AlignAffineBatch(
+    const std::vector<std::string>& targets, const std::vector<std::string>& queries,
+    AffineAlignmentParams params = DefaultAffineAlignmentParams(), int numThreads = 1);
+
+//
+// Likewise, as AlignAffineIupac would.
+//
+PairwiseAlignmentBatch* AlignAffineIupacBatch(
+    const std::vector<std::string>& targets, const std::vector<std::string>& queries,
+    AffineAlignmentParams params = IupacAwareAffineAlignmentParams(), int numThreads = 1);
+}
@@ -0,0 +1,32 @@
+// Author: David Alexander
+
+//
+// Bit-parallel (Myers / Hyyro) unit-cost edit distance.
+//
+
+#pragma once
+
+#include <string>
+
+#include <ConsensusCore/Align/AlignConfig.hpp>
+
+namespace ConsensusCore {
+
+class PairwiseAlignment;
+
+//
+// The edit distance of query against target: over all of target in
+// GLOBAL mode, or against its best-matching substring in SEMIGLOBAL
+// mode.  Runs 64 rows of the DP a word at a time.
+//
+int EditDistance(const std::string& target, const std::string& query,
+                 AlignMode mode = GLOBAL);
+
+//
+// The global alignment under AlignParams::Default(), the same as
+// Align would return (ties are broken alike), traced back from the
+// bit-vectors of each column in place of the full score matrix.
+//
+PairwiseAlignment* AlignEditDistance(const std::string& target, const std::string& query,
+                                     int* score = NULL);
+}
@@ -14,9 +14,11 @@ namespace ConsensusCore {
 
 class PairwiseAlignment;
 
+// The levels of the recursion are spread over numThreads threads; the
+// alignment does not depend on how many.
 PairwiseAlignment* AlignLinear(const std::string& target, const std::string& query,
-                               AlignConfig config = AlignConfig::Default());
+                               AlignConfig config = AlignConfig::Default(), int numThreads = 1);
 
 PairwiseAlignment* AlignLinear(const std::string& target, const std::string& query, int* score,
-                               AlignConfig config = AlignConfig::Default());
+                               AlignConfig config = AlignConfig::Default(), int numThreads = 1);
 }
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <cmath>
 #include <string>
 #include <vector>
@@ -24,12 +25,27 @@ inline int ArgMax3(int a, int b, int c)
 
 namespace ConsensusCore {
 /// \brief A pairwise alignment
+///
+/// The transcript is kept packed, at two bits per column, alongside
+/// the bases of the target and those query bases the target does not
+/// supply (at mismatches and insertions); the gapped strings are
+/// rebuilt from these on request.  The error counts are tallied once,
+/// on construction.
 class PairwiseAlignment
 {
 private:
-    std::string target_;
-    std::string query_;
-    std::string transcript_;
+    std::vector<uint8_t> ops_;    // the transcript, four columns to a byte
+    int length_;                  // number of columns
+    std::string targetBases_;     // target, ungapped
+    std::string queryOnlyBases_;  // query bases of 'R' and 'I' columns
+
+    int matches_;
+    int mismatches_;
+    int insertions_;
+    int deletions_;
+
+    // The op of column i, as an index into "MRID"
+    int Op(int i) const { return (ops_[i / 4] >> (2 * (i % 4))) & 3; }
 
 public:
     // target string, including gaps; usually the "reference"
@@ -1,5 +1,10 @@
 // Author: David Alexander
 
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
 #include <string>
 
 #include <ConsensusCore/Types.hpp>
@@ -9,6 +14,26 @@ namespace ConsensusCore {
 class Checksum
 {
 public:
+    /// \brief The CRC-32C (Castagnoli) of the bytes, continuing from the
+    ///        CRC-32C crc of the bytes before them.
+    ///
+    /// Uses the SSE4.2 crc32 instruction where the library has it
+    /// compiled in and the CPU supports it, and a table otherwise.
+    static uint32_t Crc32c(const void* data, size_t length, uint32_t crc = 0);
+
+    /// \brief The CRC-32C of the features: of the sequence, then each of
+    ///        the QV tracks.
+    static uint32_t Crc32c(const QvSequenceFeatures& f);
+
+    /// \brief The CRC-32C of the features, in hex
     static std::string Of(const QvSequenceFeatures& f);
 };
+
+namespace detail {
+// The CRC-32C register after the bytes, from the given register (not
+// the CRC-32C itself, which is its complement).  Crc32cSse42 must only
+// be called if the CPU supports SSE4.2.
+uint32_t Crc32cSoftware(uint32_t crc, const void* data, size_t length);
+uint32_t Crc32cSse42(uint32_t crc, const void* data, size_t length);
+}
 }
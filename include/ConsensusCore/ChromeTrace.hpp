@@ -0,0 +1,26 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <string>
+
+namespace ConsensusCore {
+
+/// \brief Record the instrumented phases' calls, on every thread, for a
+///        trace in the Chrome trace event format (which Perfetto and
+///        chrome://tracing read).
+///
+/// The trace takes the trace hook (see PerfStats.hpp) until stopped.
+/// Each thread records its events in a buffer of its own, so threads
+/// tracing do not contend; the buffers are written out, a thread's
+/// events in order, when the trace is stopped.  Throws
+/// UnsupportedFeatureError if the trace hooks are not compiled in, and
+/// InvalidInputError if a trace is already being recorded.
+void StartChromeTrace(const std::string& filename);
+
+/// \brief Stop recording and write the trace to the file it was started
+///        with.  Like SetPerfTraceHook, this must not run alongside
+///        instrumented code.  Throws InvalidInputError if no trace is
+///        being recorded or the file can't be written.
+void StopChromeTrace();
+}
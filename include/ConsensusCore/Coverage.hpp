@@ -13,9 +13,64 @@ namespace ConsensusCore {
 // "winLen" instead of winEnd.  Had to contort a bit to get SWIG
 // bindings working well.
 
+// The number of reads covering each position of the window, in time
+// linear in the reads and the window
 void CoverageInWindow(int tStartDim, int* tStart, int tEndDim, int* tEnd, int winStart, int winLen,
                       int* coverage);
 
+// The maximal intervals of the window covered by at least minCoverage
+// reads, found in one sweep over the reads if they are sorted by tStart
+// (as they are sorted first if not), whatever the length of the window
 std::vector<Interval> CoveredIntervals(int minCoverage, int tStartDim, int* tStart, int tEndDim,
                                        int* tEnd, int winStart, int winLen);
+
+/// \brief How well a window is covered: the least, most and mean number
+///        of reads over its positions.
+struct CoverageSummary
+{
+    int MinCoverage;
+    int MaxCoverage;
+    float MeanCoverage;
+
+    CoverageSummary() : MinCoverage(0), MaxCoverage(0), MeanCoverage(0) {}
+};
+
+/// \brief The reads' start and end positions, each sorted, for asking
+///        about the coverage of many windows.
+///
+/// Built once from all the alignments, the index answers for each
+/// window in time logarithmic in the reads plus linear in the reads
+/// starting or ending in it; the batch queries take a list of windows
+/// (Begin, End) and answer them on numThreads threads.
+class CoverageIndex
+{
+public:
+    CoverageIndex(int tStartDim, int* tStart, int tEndDim, int* tEnd);
+
+    int NumReads() const;
+
+    /// \brief The number of reads covering the position
+    int Coverage(int pos) const;
+
+    std::vector<Interval> CoveredIntervals(int minCoverage, int winStart, int winLen) const;
+
+    CoverageSummary Summary(int winStart, int winLen) const;
+
+    std::vector<std::vector<Interval> > CoveredIntervals(int minCoverage,
+                                                         const std::vector<Interval>& windows,
+                                                         int numThreads = 1) const;
+
+    std::vector<CoverageSummary> Summaries(const std::vector<Interval>& windows,
+                                           int numThreads = 1) const;
+
+private:
+    // Call f(begin, end, coverage) for each run [begin, end) of the
+    // window over which the coverage holds steady, in order
+    template <typename F>
+    void ForEachRun(int winStart, int winEnd, F f) const;
+
+private:
+    std::vector<int> starts_;
+    std::vector<int> ends_;
+};
 }
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include <ConsensusCore/Edna/EdnaEvaluator.hpp>
 #include <ConsensusCore/Features.hpp>
 #include <ConsensusCore/Interval.hpp>
@@ -11,6 +13,22 @@
 namespace ConsensusCore {
 class EdnaCounts
 {
+public:
+    // The layout of the counts DoCountBatch accumulates:
+    // counts[(move * 4 + tplChannel - 1) * 5 + obs], where move is
+    // STAY_COUNTS (j2 == j1), STEP_COUNTS (j2 == j1 + 1) or MERGE_COUNTS
+    // (j2 == j1 + 2), tplChannel the channel of template position j1,
+    // and obs the observation, as in DoCount.  MERGEABLE_STEP_COUNTS
+    // counts again the steps from positions a merge could be made from.
+    enum
+    {
+        STAY_COUNTS = 0,
+        STEP_COUNTS = 1,
+        MERGE_COUNTS = 2,
+        MERGEABLE_STEP_COUNTS = 3,
+        BATCH_COUNTS = 4 * 4 * 5
+    };
+
 public:
     EdnaCounts() {}
 
@@ -18,5 +36,19 @@ public:
 
     void DoCount(Feature<int> channelRead, EdnaEvaluator& eval,
                  MutationScorer<SparseSseEdnaRecursor>& scorer, int j1, int j2, float* results);
+
+#ifndef SWIG
+    /// \brief Add to counts[0, BATCH_COUNTS) the expected number of
+    ///        times each read took each move, over every template
+    ///        position, as found by DoCount.
+    ///
+    /// The reads are counted on numThreads threads, each into counts of
+    /// its own, which are added up in order of the reads at the end, so
+    /// that the result is the same for any number of threads.  The
+    /// scorers must not be checkpointed.
+    void DoCountBatch(const std::vector<Feature<int> >& channelReads,
+                      const std::vector<const MutationScorer<SparseSseEdnaRecursor>*>& scorers,
+                      int numThreads, float* counts);
+#endif  // SWIG
 };
 }
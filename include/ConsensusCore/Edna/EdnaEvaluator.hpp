@@ -18,7 +18,9 @@
 #include <ConsensusCore/Edna/EdnaConfig.hpp>
 #include <ConsensusCore/Features.hpp>
 #include <ConsensusCore/LFloat.hpp>
+#include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Simd.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
@@ -55,14 +57,34 @@ public:
 
     std::string Basecalls() const { return features_.Sequence(); }
 
-    std::string Template() const { return tpl_; }
+    const std::string& Template() const { return tpl_; }
 
-    void Template(std::string tpl) { tpl_ = tpl; }
+    void Template(const std::string& tpl) { tpl_ = tpl; }
+
+    // Set the template to buffer[start, start + length), reusing the
+    // storage of the old one
+    void Template(const std::string& buffer, int start, int length)
+    {
+        tpl_.assign(buffer, start, length);
+    }
+
+    // Temporarily mutate the template in place, for mutation scoring;
+    // UndoMutation must be passed the same mutation.
+    void ApplyMutation(const Mutation& m) { ApplyMutationInPlace(m, &tpl_, &savedBases_); }
+
+    void UndoMutation(const Mutation& m) { UndoMutationInPlace(m, &tpl_, savedBases_); }
 
     int ReadLength() const { return features_.Length(); }
 
     int TemplateLength() const { return tpl_.length(); }
 
+    // The bytes of the features, and of the template in channel space
+    int64_t FeatureBytes() const
+    {
+        return features_.AllocatedBytes() +
+               static_cast<int64_t>(channelTpl_.Length()) * sizeof(int);
+    }
+
     bool PinEnd() const { return pinEnd_; }
 
     bool PinStart() const { return pinStart_; }
@@ -158,7 +180,7 @@ public:
         }
     }
 
-    float ScoreMove(int j1, int j2, int obs)
+    float ScoreMove(int j1, int j2, int obs) const
     {
         if (j1 == j2) {
             float trans = pStay(j1);
@@ -192,35 +214,61 @@ public:
     }
 
     //
-    // SSE
+    // SIMD, computing the scores for rows [i, i + W) at once
     //
 
-    __m128 Inc4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec IncN(int i, int j) const
     {
-        __m128 res = _mm_setr_ps(Inc(i + 0, j), Inc(i + 1, j), Inc(i + 2, j), Inc(i + 3, j));
-        return res;
+        float res[W];
+        for (int k = 0; k < W; k++) {
+            res[k] = Inc(i + k, j);
+        }
+        return Simd<W>::Load(res);
     }
 
-    __m128 Del4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec DelN(int i, int j) const
     {
-        __m128 res = _mm_setr_ps(Del(i + 0, j), Del(i + 1, j), Del(i + 2, j), Del(i + 3, j));
-        return res;
+        float res[W];
+        for (int k = 0; k < W; k++) {
+            res[k] = Del(i + k, j);
+        }
+        return Simd<W>::Load(res);
     }
 
-    __m128 Extra4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec ExtraN(int i, int j) const
     {
-        __m128 res =
-            _mm_setr_ps(Extra(i + 0, j), Extra(i + 1, j), Extra(i + 2, j), Extra(i + 3, j));
-        return res;
+        float res[W];
+        for (int k = 0; k < W; k++) {
+            res[k] = Extra(i + k, j);
+        }
+        return Simd<W>::Load(res);
     }
 
-    __m128 Merge4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec MergeN(int i, int j) const
     {
-        __m128 res =
-            _mm_setr_ps(Merge(i + 0, j), Merge(i + 1, j), Merge(i + 2, j), Merge(i + 3, j));
-        return res;
+        float res[W];
+        for (int k = 0; k < W; k++) {
+            res[k] = Merge(i + k, j);
+        }
+        return Simd<W>::Load(res);
     }
 
+    //
+    // SSE
+    //
+
+    __m128 Inc4(int i, int j) const { return IncN<4>(i, j); }
+
+    __m128 Del4(int i, int j) const { return DelN<4>(i, j); }
+
+    __m128 Extra4(int i, int j) const { return ExtraN<4>(i, j); }
+
+    __m128 Merge4(int i, int j) const { return MergeN<4>(i, j); }
+
     __m128 Burst4(int, int, int) const
     {
         NotYetImplemented();
@@ -231,6 +279,7 @@ protected:
     ChannelSequenceFeatures features_;
     EdnaModelParams params_;
     std::string tpl_;
+    std::string savedBases_;
     Feature<int> channelTpl_;
     bool pinStart_;
     bool pinEnd_;
@@ -0,0 +1,96 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Edna/EdnaConfig.hpp>
+#include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Types.hpp>
+
+namespace ConsensusCore {
+
+/// \brief The channels of the bases of a template, A, C, G and T being
+///        channels 1 to 4, as the Edna evaluator takes them.
+std::vector<int> EdnaChannels(const std::string& tpl);
+
+/// \brief Many reads of one template, each filled under the same Edna
+///        model parameters, for training them.
+///
+/// Each read spans the whole template, on its forward strand.  The
+/// reads are filled, and their counts taken, on numThreads threads.
+/// Changing the parameters or the template refills every read.
+class MultiReadEdnaScorer : private boost::noncopyable
+{
+public:
+    MultiReadEdnaScorer(const std::string& tpl, const EdnaModelParams& params,
+                        const BandingOptions& banding, int numThreads = 1);
+    ~MultiReadEdnaScorer();
+
+    void AddRead(const ChannelSequenceFeatures& read);
+
+#ifndef SWIG
+    void AddReads(const std::vector<ChannelSequenceFeatures>& reads);
+#endif  // SWIG
+
+    int NumReads() const;
+
+    const std::string& Template() const;
+    void Template(const std::string& tpl);
+
+    const EdnaModelParams& Params() const;
+    void Params(const EdnaModelParams& params);
+
+    /// \brief The log-likelihood of all the reads
+    float BaselineScore() const;
+
+    /// \brief The log-likelihood of each read
+    std::vector<float> Scores() const;
+
+    /// \brief The expected counts of the moves of all the reads, laid
+    ///        out as EdnaCounts::DoCountBatch lays them out.
+    std::vector<float> Counts() const;
+
+#ifndef SWIG
+    const SparseSseEdnaMutationScorer* Scorer(int readIndex) const;
+#endif  // SWIG
+
+private:
+    // (Re)fill the scorers of reads [begin, NumReads())
+    void Fill(int begin);
+
+private:
+    std::string tpl_;
+    std::vector<int> channelTpl_;
+    EdnaModelParams params_;
+    BandingOptions banding_;
+    int numThreads_;
+    std::vector<ChannelSequenceFeatures> reads_;
+    std::vector<SparseSseEdnaMutationScorer*> scorers_;
+};
+
+/// \brief The parameters that maximize the likelihood of the moves
+///        counted, as by MultiReadEdnaScorer::Counts: the M step of EM.
+///
+/// A parameter whose moves went uncounted keeps its value in params.
+/// The stay distributions of the null observation, which no read
+/// makes, are kept too.
+EdnaModelParams UpdateEdnaParams(const std::vector<float>& counts, const EdnaModelParams& params);
+
+#ifndef SWIG
+/// \brief Train the Edna parameters of the scorers by EM, from those
+///        they hold, which must be the same for all of them, leaving
+///        them filled under the trained parameters.
+///
+/// Stops after maxIterations, or once an iteration improves the
+/// log-likelihood of all the reads by less than minImprovement.
+/// Returns the trained parameters.
+EdnaModelParams TrainEdnaParams(const std::vector<MultiReadEdnaScorer*>& scorers,
+                                int maxIterations, float minImprovement = 0.01f);
+#endif  // SWIG
+}
@@ -5,23 +5,70 @@
 #include <algorithm>
 #include <boost/range.hpp>
 #include <boost/shared_array.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 #include <cassert>
 #include <string>
 #include <vector>
 
+#include <ConsensusCore/MemoryUsage.hpp>
 #include <ConsensusCore/Types.hpp>
 
 namespace ConsensusCore {
+
+#ifndef SWIG
+namespace detail {
+// Deleter for borrowed feature storage: frees nothing itself, but holds
+// on to the storage's owner until the last copy of the feature is gone
+class KeepAlive
+{
+public:
+    explicit KeepAlive(const boost::shared_ptr<void>& owner) : owner_(owner) {}
+    template <typename T>
+    void operator()(T*)
+    {
+        owner_.reset();
+    }
+
+private:
+    boost::shared_ptr<void> owner_;
+};
+
+// Deleter for feature storage the feature allocated: counts the
+// storage as held for features from construction until it is freed
+template <typename T>
+class AccountedDelete
+{
+public:
+    explicit AccountedDelete(int length) : bytes_(static_cast<int64_t>(length) * sizeof(T))
+    {
+        AccountMemory(FEATURE_MEMORY, bytes_);
+    }
+
+    void operator()(T* p)
+    {
+        delete[] p;
+        AccountMemory(FEATURE_MEMORY, -bytes_);
+    }
+
+private:
+    int64_t bytes_;
+};
+}
+#endif  // !SWIG
+
 // Feature/Features object usage caveats:
 //  - Feature and Features objects _must_ be stored by value, not reference
-//  - The underlying array must be allocated using new[]
+//  - Copies share the underlying array, which is either allocated by
+//    the Feature using new[], and counted as FEATURE_MEMORY, or
+//    borrowed (see below)
 template <typename T>
 class Feature : private boost::shared_array<T>
 {
 public:
     // \brief Allocate a new feature object, copying content from ptr.
-    Feature(const T* inPtr, int length) : boost::shared_array<T>(new T[length]), length_(length)
+    Feature(const T* inPtr, int length)
+        : boost::shared_array<T>(new T[length], detail::AccountedDelete<T>(length)), length_(length)
     {
         assert(length >= 0);
         std::copy(inPtr, inPtr + length, get());
@@ -31,14 +78,30 @@ public:
     // Here are constructors to make it easier to stuff those guys into
     // a FloatFeature.
     Feature(const unsigned char* inPtr, int length)
-        : boost::shared_array<T>(new T[length]), length_(length)
+        : boost::shared_array<T>(new T[length], detail::AccountedDelete<T>(length)), length_(length)
     {
         assert(length >= 0);
         std::copy(inPtr, inPtr + length, get());
     }
 
+#ifndef SWIG
+    // \brief Refer to the length elements at ptr without copying them.
+    //
+    // The storage is not freed by the feature; owner, which should be
+    // what keeps the storage alive, is held until the last copy of the
+    // feature is destroyed.  A null owner means the caller guarantees
+    // the storage outlives the feature.
+    Feature(T* ptr, int length, const boost::shared_ptr<void>& owner)
+        : boost::shared_array<T>(ptr, detail::KeepAlive(owner)), length_(length)
+    {
+        assert(length >= 0);
+    }
+#endif  // !SWIG
+
     // \brief Allocate and zero-fill a new feature object of given length.
-    explicit Feature(int length) : boost::shared_array<T>(new T[length]()), length_(length)
+    explicit Feature(int length)
+        : boost::shared_array<T>(new T[length](), detail::AccountedDelete<T>(length))
+        , length_(length)
     {
         assert(length >= 0);
     }
@@ -5,6 +5,7 @@
 #include <boost/range.hpp>
 #include <boost/shared_array.hpp>
 #include <boost/utility.hpp>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -17,9 +18,17 @@ struct SequenceFeatures
 {
 public:
     explicit SequenceFeatures(const std::string& seq);
+#ifndef SWIG
+    // Shares the storage of the sequence rather than copying it
+    explicit SequenceFeatures(const Feature<char>& seq);
+#endif  // !SWIG
     int Length() const { return sequence_.Length(); }
     Feature<char> Sequence() const { return sequence_; }
 
+    /// The bytes of the feature arrays, whether allocated for these
+    /// features or shared with others
+    int64_t AllocatedBytes() const;
+
     /// Access to the sequence bases
     const char& operator[](int i) const { return sequence_[i]; }
     char ElementAt(int i) const { return (*this)[i]; }
@@ -43,6 +52,7 @@ struct QvSequenceFeatures : public SequenceFeatures
     QvSequenceFeatures(const std::string& seq, const float* insQv, const float* subsQv,
                        const float* delQv, const float* delTag, const float* mergeQv);
 
+    // Shares the storage of the given features rather than copying it
     QvSequenceFeatures(const std::string& seq, const Feature<float> insQv,
                        const Feature<float> subsQv, const Feature<float> delQv,
                        const Feature<float> delTag, const Feature<float> mergeQv);
@@ -50,6 +60,17 @@ struct QvSequenceFeatures : public SequenceFeatures
     QvSequenceFeatures(const std::string& seq, const unsigned char* insQv,
                        const unsigned char* subsQv, const unsigned char* delQv,
                        const unsigned char* delTag, const unsigned char* mergeQv);
+
+#ifndef SWIG
+    // Shares the storage of every feature, the sequence and the
+    // sequence as floats included, so copies nothing
+    QvSequenceFeatures(const Feature<char>& seq, const Feature<float> seqAsFloat,
+                       const Feature<float> insQv, const Feature<float> subsQv,
+                       const Feature<float> delQv, const Feature<float> delTag,
+                       const Feature<float> mergeQv);
+#endif  // !SWIG
+
+    int64_t AllocatedBytes() const;
 };
 
 /// \brief A features object that contains sequence in channel space.
@@ -60,5 +81,7 @@ struct ChannelSequenceFeatures : SequenceFeatures
     explicit ChannelSequenceFeatures(const std::string& seq);
 
     ChannelSequenceFeatures(const std::string& seq, const std::vector<int>& channel);
+
+    int64_t AllocatedBytes() const;
 };
 }
@@ -1,23 +1,144 @@
 // Author: David Alexander
 
+#pragma once
+
 #include <cpplog/cpplog.hpp>
 
+#ifndef SWIG
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif  // SWIG
+
+// The least level of the log statements compiled in; LTRACE and the
+// like below it compile to nothing, their arguments unevaluated.
+// Release builds keep LINFO and above unless told otherwise.
+#ifndef CONSENSUSCORE_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define CONSENSUSCORE_MIN_LOG_LEVEL LL_INFO
+#else
+#define CONSENSUSCORE_MIN_LOG_LEVEL LL_TRACE
+#endif  // NDEBUG
+#endif  // CONSENSUSCORE_MIN_LOG_LEVEL
+
 namespace ConsensusCore {
+
+#ifndef SWIG
+namespace detail {
+// Forwards messages at or above a level to another logger, one message
+// at a time, so that it may be logged to from several threads at once.
+// The level may be changed while other threads are logging.
+//
+// Made asynchronous, it queues messages on a lock-free list instead,
+// and a background thread forwards them, in the order each thread
+// logged them, every few milliseconds, so that logging threads never
+// wait on one another or on the output.  Fatal messages are forwarded
+// at once, after those queued.
+class ThreadSafeLogger : public cpplog::BaseLogger
+{
+public:
+    ThreadSafeLogger(cpplog::loglevel_t level, cpplog::BaseLogger* forwardTo);
+    ~ThreadSafeLogger();
+
+    void SetLevel(cpplog::loglevel_t level);
+    bool Enabled(cpplog::loglevel_t level) const;
+
+    void SetAsync(bool async);
+    bool Async() const;
+
+    // Forward the queued messages now
+    void Flush();
+
+    virtual bool sendLogMessage(cpplog::LogData* logData);
+
+private:
+    struct Record
+    {
+        cpplog::LogData* Data;
+        Record* Next;
+    };
+
+    // Forward the queued messages; mutex_ must be held
+    void ForwardQueued();
+    void WriterLoop();
+
+private:
+    std::atomic<cpplog::loglevel_t> level_;
+    std::atomic<bool> async_;
+    // The queued messages, latest first
+    std::atomic<Record*> queued_;
+    // Held while forwarding
+    std::mutex mutex_;
+    cpplog::BaseLogger* forwardTo_;
+
+    std::mutex writerMutex_;
+    std::condition_variable writerWake_;
+    bool stopWriter_;
+    std::thread writer_;
+};
+}
+#endif  // SWIG
+
+/// \brief The library-wide log.
+///
+/// This is the only mutable state the library shares between otherwise
+/// independent objects, and it is safe to use from several threads.
 class Logging
 {
 public:
     static void EnableDiagnosticLogging();
 
+    /// \brief Write the log from a background thread, so that threads
+    ///        logging never wait to write; Flush writes what is queued.
+    ///
+    /// Queued messages are written at exit, too.
+    static void EnableAsyncLogging();
+    static void Flush();
+
 #ifndef SWIG
     static cpplog::StdErrLogger* slog;
-    static cpplog::FilteringLogger* flog;
+    static detail::ThreadSafeLogger* flog;
 #endif  // SWIG
 };
 }
 
-#define LTRACE LOG_TRACE(*Logging::flog)
-#define LDEBUG LOG_DEBUG(*Logging::flog)
-#define LINFO LOG_INFO(*Logging::flog)
-#define LWARN LOG_WARN(*Logging::flog)
-#define LERROR LOG_ERROR(*Logging::flog)
-#define LFATAL LOG_FATAL(*Logging::flog)
+// A message is only formatted if its level is compiled in and enabled
+#define CONSENSUSCORE_LOG(level)   \
+    !Logging::flog->Enabled(level) \
+        ? (void)0                  \
+        : cpplog::helpers::VoidStreamClass() & LOG_LEVEL(level, *Logging::flog)
+#define CONSENSUSCORE_NO_LOG(level) LOG_NOTHING(level, *Logging::flog)
+
+#if CONSENSUSCORE_MIN_LOG_LEVEL <= LL_TRACE
+#define LTRACE CONSENSUSCORE_LOG(LL_TRACE)
+#else
+#define LTRACE CONSENSUSCORE_NO_LOG(LL_TRACE)
+#endif
+
+#if CONSENSUSCORE_MIN_LOG_LEVEL <= LL_DEBUG
+#define LDEBUG CONSENSUSCORE_LOG(LL_DEBUG)
+#else
+#define LDEBUG CONSENSUSCORE_NO_LOG(LL_DEBUG)
+#endif
+
+#if CONSENSUSCORE_MIN_LOG_LEVEL <= LL_INFO
+#define LINFO CONSENSUSCORE_LOG(LL_INFO)
+#else
+#define LINFO CONSENSUSCORE_NO_LOG(LL_INFO)
+#endif
+
+#if CONSENSUSCORE_MIN_LOG_LEVEL <= LL_WARN
+#define LWARN CONSENSUSCORE_LOG(LL_WARN)
+#else
+#define LWARN CONSENSUSCORE_NO_LOG(LL_WARN)
+#endif
+
+#if CONSENSUSCORE_MIN_LOG_LEVEL <= LL_ERROR
+#define LERROR CONSENSUSCORE_LOG(LL_ERROR)
+#else
+#define LERROR CONSENSUSCORE_NO_LOG(LL_ERROR)
+#endif
+
+// Always logged
+#define LFATAL LOG_LEVEL(LL_FATAL, *Logging::flog)
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 namespace ConsensusCore {
 
 class AbstractMatrix
@@ -17,6 +19,8 @@ public:  // Size information
 public:  // Information about entries filled by column
     virtual int UsedEntries() const = 0;
     virtual int AllocatedEntries() const = 0;
+    // All the storage the matrix holds, its bookkeeping included
+    virtual int64_t AllocatedBytes() const = 0;
 
 public:  // Accessors
     virtual bool IsAllocated(int i, int j) const = 0;
@@ -0,0 +1,26 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <cassert>
+
+#include <ConsensusCore/Matrix/BandArena.hpp>
+
+namespace ConsensusCore {
+
+inline float* BandArena::Allocate(int n)
+{
+    assert(n >= 0);
+    // keep every allocation 16-byte aligned
+    n = (n + 3) & ~3;
+    if (n > remaining_) {
+        return AllocateSlow(n);
+    }
+    float* p = cursor_;
+    cursor_ += n;
+    remaining_ -= n;
+    return p;
+}
+
+inline int BandArena::ReservedEntries() const { return reservedEntries_; }
+}
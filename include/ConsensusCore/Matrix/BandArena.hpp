@@ -0,0 +1,63 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <utility>
+#include <vector>
+
+#include <ConsensusCore/MemoryUsage.hpp>
+
+namespace ConsensusCore {
+
+/// \brief A bump allocator handing out float storage for the columns
+/// of a SparseMatrix.
+///
+/// Storage is carved out of a few large chunks, so the columns of a
+/// matrix lie close together in memory and are all released at once
+/// when the arena is destroyed.  Individual allocations are never
+/// freed; a column that outgrows its storage simply takes a new piece.
+/// Chunks of a huge page or more are backed by transparent huge pages,
+/// where the kernel offers them, to spare the TLB.
+class BandArena : private boost::noncopyable
+{
+public:
+    // initialChunkSize: the number of floats in the first chunk
+    explicit BandArena(int initialChunkSize);
+    ~BandArena();
+
+    // Uninitialized storage for n floats, aligned to four floats,
+    // valid for the lifetime of the arena.
+    float* Allocate(int n);
+
+    // The number of floats held in chunks, whether handed out or not
+    int ReservedEntries() const;
+
+    // Count the chunks, process-wide, as held for category (by default,
+    // MATRIX_MEMORY)
+    void SetMemoryCategory(MemoryCategory category);
+
+    // Invalidate every allocation made so far, keeping the reserved
+    // memory---merged into a single chunk---for the allocations to
+    // come.
+    void Reset();
+
+    // Exchange chunks, and allocations, with other; each arena goes on
+    // counting its chunks as held for its own category.
+    void Swap(BandArena& other);
+
+private:
+    float* AllocateSlow(int n);
+
+private:
+    // (storage, size) of each chunk
+    std::vector<std::pair<float*, int> > chunks_;
+    float* cursor_;
+    int remaining_;
+    int nextChunkSize_;
+    int reservedEntries_;
+    detail::AccountedBytes accounted_;
+};
+}
+
+#include <ConsensusCore/Matrix/BandArena-inl.hpp>
@@ -2,17 +2,15 @@
 
 #pragma once
 
-#include <boost/numeric/ublas/matrix.hpp>
-#include <boost/numeric/ublas/matrix_proxy.hpp>
+#include <algorithm>
 #include <boost/tuple/tuple.hpp>
 #include <cassert>
+#include <cfloat>
 
 #include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
 #include <ConsensusCore/Utils.hpp>
 
-using boost::numeric::ublas::matrix_column;
-
 namespace ConsensusCore {
 //
 // Nullability
@@ -28,9 +26,11 @@ inline bool DenseMatrix::IsNull() const { return (Rows() == 0 && Columns() == 0)
 //
 // Size information
 //
-inline int DenseMatrix::Rows() const { return size1(); }
+inline int DenseMatrix::Rows() const { return nRows_; }
+
+inline int DenseMatrix::Columns() const { return nCols_; }
 
-inline int DenseMatrix::Columns() const { return size2(); }
+inline int DenseMatrix::EntryBytes() { return sizeof(float); }
 
 //
 // Entry range queries per column
@@ -65,10 +65,23 @@ inline bool DenseMatrix::IsColumnEmpty(int j) const
 //
 // Accessors
 //
+inline float* DenseMatrix::Entry(int i, int j)
+{
+    assert(0 <= i && i < stride_ && 0 <= j && j < Columns());
+    return data_ + static_cast<size_t>(j) * stride_ + i;
+}
+
+inline const float* DenseMatrix::Entry(int i, int j) const
+{
+    assert(0 <= i && i < stride_ && 0 <= j && j < Columns());
+    return data_ + static_cast<size_t>(j) * stride_ + i;
+}
+
 inline void DenseMatrix::Set(int i, int j, float v)
 {
     assert(columnBeingEdited_ == j);
-    boost_dense_matrix::operator()(i, j) = v;
+    assert(i < Rows());
+    *Entry(i, j) = v;
 }
 
 inline bool DenseMatrix::IsAllocated(int
@@ -90,18 +103,16 @@ inline float DenseMatrix::Get(int i, int j) const { return (*this)(i, j); }
 
 inline const float& DenseMatrix::operator()(int i, int j) const
 {
-    return boost_dense_matrix::operator()(i, j);
+    assert(i < Rows());
+    return *Entry(i, j);
 }
 
 inline void DenseMatrix::ClearColumn(int j)
 {
     DEBUG_ONLY(CheckInvariants(j);)
-    // (Rely on the fact that the underlying memory is stored
-    // contiguously)
     int begin, end;
     boost::tie(begin, end) = usedRanges_[j];
-    std::fill_n(reinterpret_cast<float*>(&boost_dense_matrix::operator()(begin, j)),  // NOLINT
-                end - begin, value_type());
+    std::fill_n(Entry(begin, j), end - begin, -FLT_MAX);
     usedRanges_[j] = Interval(0, 0);
     DEBUG_ONLY(CheckInvariants(j);)
 }
@@ -112,13 +123,28 @@ inline void DenseMatrix::ClearColumn(int j)
 inline __m128 DenseMatrix::Get4(int i, int j) const
 {
     assert(0 <= i && i <= Rows() - 4);
-    return _mm_loadu_ps(&boost_dense_matrix::operator()(i, j).value);
+    return _mm_loadu_ps(Entry(i, j));
 }
 
 inline void DenseMatrix::Set4(int i, int j, __m128 v4)
 {
     assert(columnBeingEdited_ == j);
     assert(0 <= i && i <= Rows() - 4);
-    _mm_storeu_ps(&boost_dense_matrix::operator()(i, j).value, v4);
+    _mm_storeu_ps(Entry(i, j), v4);
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec DenseMatrix::GetN(int i, int j) const
+{
+    assert(0 <= i && i <= Rows() - W);
+    return Simd<W>::Load(Entry(i, j));
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline void DenseMatrix::SetN(int i, int j, typename Simd<W>::Vec v)
+{
+    assert(columnBeingEdited_ == j);
+    assert(0 <= i && i <= Rows() - W);
+    Simd<W>::Store(Entry(i, j), v);
 }
 }
@@ -4,32 +4,39 @@
 
 #include <xmmintrin.h>
 
-#include <boost/numeric/ublas/matrix.hpp>
 #include <utility>
 #include <vector>
 
 #include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/LFloat.hpp>
 #include <ConsensusCore/Matrix/AbstractMatrix.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
+#include <ConsensusCore/Simd.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
 namespace ConsensusCore {
 
-#ifndef SWIG
-// SWIG gags on this
-using boost::numeric::ublas::matrix;
-using boost::numeric::ublas::column_major;
-#endif  // SWIG
-
-typedef matrix<lfloat, column_major> boost_dense_matrix;
-
-class DenseMatrix : public AbstractMatrix, private boost_dense_matrix
+/// \brief A column-major matrix storing every entry.
+///
+/// The entries live in one flat buffer aligned to a cache line, each
+/// column padded to a whole number of cache lines, so that every
+/// column starts on a cache line and SIMD access to the rows of a
+/// column never strays out of the buffer's lines.  Unused entries hold
+/// -FLT_MAX, as do the padding rows.
+class DenseMatrix : public AbstractMatrix
 {
 public:  // Constructor, destructor
     DenseMatrix(int rows, int cols);
+    DenseMatrix(const DenseMatrix& other);
     ~DenseMatrix();
 
+    DenseMatrix& operator=(const DenseMatrix& other);
+
+    // Reshape to rows x cols with every column empty, reusing the
+    // storage already held where possible.
+    void Reset(int rows, int cols);
+
 public:  // Nullability
     static const DenseMatrix& Null();
     bool IsNull() const;
@@ -45,6 +52,15 @@ public:  // Information about entries filled by column
     bool IsColumnEmpty(int j) const;
     int UsedEntries() const;
     int AllocatedEntries() const;  // an entry may be stored but not filled
+    static int EntryBytes();       // the storage an entry takes
+    int64_t AllocatedBytes() const;
+    // As SparseMatrix::ShrinkToFit; every entry is stored, so there is
+    // nothing to release
+    void ShrinkToFit();
+
+    // Count the matrix, process-wide, as held for category (by default,
+    // MATRIX_MEMORY)
+    void SetMemoryCategory(MemoryCategory category);
 
 public:  // Accessors
     //
@@ -67,15 +83,35 @@ public:  // SSE accessors, which access 4 successive entries in a column
     __m128 Get4(int i, int j) const;
     void Set4(int i, int j, __m128 v);
 
+public:  // SIMD accessors, which access W successive entries in a column
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec GetN(int i, int j) const;
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET void SetN(int i, int j, typename Simd<W>::Vec v);
+
 public:
     // Method SWIG clients can use to get a native matrix (e.g. Numpy)
     // mat must be filled as a ROW major matrix
     void ToHostMatrix(float** mat, int* rows, int* cols) const;
 
 private:
+    void CheckInvariants(int column) const;
+    // The storage of entry (i, j)
+    float* Entry(int i, int j);
+    const float* Entry(int i, int j) const;
+    // Size the buffer for the shape, keeping it if it is big enough
+    void Allocate(int rows, int cols);
+
+private:
+    float* data_;
+    size_t capacity_;  // in floats
+    int nRows_;
+    int nCols_;
+    int stride_;  // floats between the starts of successive columns
     std::vector<Interval> usedRanges_;
     int columnBeingEdited_;
-    void CheckInvariants(int column) const;
+    // Counts AllocatedBytes, as of the last reshape
+    detail::AccountedBytes accounted_;
 };
 }
 
@@ -0,0 +1,114 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <vector>
+
+#include <ConsensusCore/Matrix/MatrixPool.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
+
+#define MATRIX_POOL_BUCKETS 32
+#define MATRICES_PER_BUCKET 8
+
+namespace ConsensusCore {
+
+template <typename M>
+MatrixPool<M>::Buckets::~Buckets()
+{
+    for (size_t b = 0; b < matrices.size(); b++) {
+        for (size_t k = 0; k < matrices[b].size(); k++) {
+            delete matrices[b][k];
+        }
+    }
+    Destroyed() = true;
+}
+
+template <typename M>
+bool& MatrixPool<M>::Destroyed()
+{
+    static thread_local bool destroyed = false;
+    return destroyed;
+}
+
+template <typename M>
+typename MatrixPool<M>::Buckets& MatrixPool<M>::Local()
+{
+    static thread_local Buckets buckets;
+    if (buckets.matrices.empty()) {
+        buckets.matrices.resize(MATRIX_POOL_BUCKETS);
+    }
+    return buckets;
+}
+
+template <typename M>
+int MatrixPool<M>::Bucket(int rows, int cols)
+{
+    // Matrices within a factor of two in size share a bucket
+    long entries = static_cast<long>(rows) * cols;
+    int b = 0;
+    while (entries > 1 && b < MATRIX_POOL_BUCKETS - 1) {
+        entries >>= 1;
+        b++;
+    }
+    return b;
+}
+
+template <typename M>
+M* MatrixPool<M>::Acquire(int rows, int cols)
+{
+    if (Destroyed()) return new M(rows, cols);
+    std::vector<M*>& bucket = Local().matrices[Bucket(rows, cols)];
+    if (bucket.empty()) {
+        return new M(rows, cols);
+    }
+    M* m = bucket.back();
+    bucket.pop_back();
+    m->SetMemoryCategory(MATRIX_MEMORY);
+    m->Reset(rows, cols);
+    return m;
+}
+
+template <typename M>
+void MatrixPool<M>::Release(M* m)
+{
+    if (m == NULL) return;
+    if (Destroyed()) {
+        // matrices outliving the thread's pool (e.g. in static
+        // objects) are simply deleted
+        delete m;
+        return;
+    }
+    std::vector<M*>& bucket = Local().matrices[Bucket(m->Rows(), m->Columns())];
+    if (static_cast<int>(bucket.size()) < MATRICES_PER_BUCKET) {
+        m->SetMemoryCategory(SCRATCH_MEMORY);
+        bucket.push_back(m);
+    } else {
+        delete m;
+    }
+}
+
+template <typename M>
+int MatrixPool<M>::Size()
+{
+    if (Destroyed()) return 0;
+    Buckets& local = Local();
+    int size = 0;
+    for (size_t b = 0; b < local.matrices.size(); b++) {
+        size += local.matrices[b].size();
+    }
+    return size;
+}
+
+template <typename M>
+void MatrixPool<M>::Clear()
+{
+    if (Destroyed()) return;
+    Buckets& local = Local();
+    for (size_t b = 0; b < local.matrices.size(); b++) {
+        for (size_t k = 0; k < local.matrices[b].size(); k++) {
+            delete local.matrices[b][k];
+        }
+        local.matrices[b].clear();
+    }
+}
+}
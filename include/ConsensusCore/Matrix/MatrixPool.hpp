@@ -0,0 +1,49 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <vector>
+
+namespace ConsensusCore {
+
+/// \brief A per-thread cache of matrices, letting code that keeps
+/// building matrices of similar shapes---a MutationScorer refilling
+/// alpha and beta after each template change, say---recycle their
+/// storage rather than go back to the allocator.
+///
+/// Matrices are kept in buckets by size; a matrix acquired from the
+/// pool is Reset to the requested shape.  The matrices a pool holds
+/// are counted as SCRATCH_MEMORY.  Matrices may be released
+/// on a different thread than they were acquired on.
+template <typename M>
+class MatrixPool
+{
+public:
+    // A rows x cols matrix with every column empty, owned by the caller
+    static M* Acquire(int rows, int cols);
+
+    // Hand a matrix back to this thread's pool (or delete it, if the
+    // pool is full)
+    static void Release(M* m);
+
+    // The number of matrices held by this thread's pool
+    static int Size();
+
+    // Delete the matrices held by this thread's pool
+    static void Clear();
+
+private:
+    struct Buckets
+    {
+        ~Buckets();
+        std::vector<std::vector<M*> > matrices;
+    };
+
+    static Buckets& Local();
+    // Whether this thread's pool has been destroyed (at thread exit)
+    static bool& Destroyed();
+    static int Bucket(int rows, int cols);
+};
+}
+
+#include <ConsensusCore/Matrix/MatrixPool-inl.hpp>
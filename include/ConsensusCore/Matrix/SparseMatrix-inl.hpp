@@ -32,56 +32,77 @@ inline int SparseMatrix::Rows() const { return nRows_; }
 
 inline int SparseMatrix::Columns() const { return nCols_; }
 
+inline int SparseMatrix::EntryBytes() { return SparseVector::EntryBytes(); }
+
+inline bool SparseMatrix::IsColumnStored(int j) const
+{
+    return beginColumn_ <= j && j < endColumn_;
+}
+
 //
 // Entry range queries per column
 //
 inline void SparseMatrix::StartEditingColumn(int j, int hintBegin, int hintEnd)
 {
     assert(columnBeingEdited_ == -1);
+    assert(IsColumnStored(j));
     columnBeingEdited_ = j;
-    if (columns_[j] != NULL) {
-        columns_[j]->ResetForRange(hintBegin, hintEnd);
-    } else {
-        columns_[j] = new SparseVector(Rows(), hintBegin, hintEnd);
-    }
+    columns_[j - beginColumn_].ResetForRange(hintBegin, hintEnd);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    if (static_cast<int>(editing_.size()) < nRows_) editing_.resize(nRows_);
+    editedRows_ = Interval(0, 0);
+#endif
 }
 
 inline void SparseMatrix::FinishEditingColumn(int j, int usedRowsBegin, int usedRowsEnd)
 {
     assert(columnBeingEdited_ == j);
-    usedRanges_[j] = Interval(usedRowsBegin, usedRowsEnd);
+    usedRanges_[j - beginColumn_] = Interval(usedRowsBegin, usedRowsEnd);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    SparseVector& column = columns_[j - beginColumn_];
+    int begin = editedRows_.Begin, end = editedRows_.End;
+    if (begin < end) {
+        column.SetOffset(*std::max_element(editing_.begin() + begin, editing_.begin() + end));
+    }
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        column.Set4(i, _mm_loadu_ps(&editing_[i]));
+    }
+    for (; i < end; i++) {
+        column.Set(i, editing_[i]);
+    }
+#endif
     DEBUG_ONLY(CheckInvariants(columnBeingEdited_));
     columnBeingEdited_ = -1;
 }
 
 inline Interval SparseMatrix::UsedRowRange(int j) const
 {
-    assert(0 <= j && j < static_cast<int>(usedRanges_.size()));
-    return usedRanges_[j];
+    assert(IsColumnStored(j));
+    return usedRanges_[j - beginColumn_];
 }
 
 inline bool SparseMatrix::IsColumnEmpty(int j) const
 {
-    assert(0 <= j && j < static_cast<int>(usedRanges_.size()));
-    return (usedRanges_[j].Begin >= usedRanges_[j].End);
+    assert(IsColumnStored(j));
+    return (usedRanges_[j - beginColumn_].Begin >= usedRanges_[j - beginColumn_].End);
 }
 
 //
 // Accessors
 //
-inline const float& SparseMatrix::operator()(int i, int j) const
+inline float SparseMatrix::operator()(int i, int j) const
 {
-    static const float emptyCell = Zero<lfloat>();
-    if (columns_[j] == NULL) {
-        return emptyCell;
-    } else {
-        return (*columns_[j])(i);
-    }
+    assert(IsColumnStored(j));
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    if (j == columnBeingEdited_) return EditedEntry(i);
+#endif
+    return columns_[j - beginColumn_](i);
 }
 
 inline bool SparseMatrix::IsAllocated(int i, int j) const
 {
-    return columns_[j] != NULL && columns_[j]->IsAllocated(i);
+    return IsColumnStored(j) && columns_[j - beginColumn_].IsAllocated(i);
 }
 
 inline float SparseMatrix::Get(int i, int j) const { return (*this)(i, j); }
@@ -89,13 +110,18 @@ inline float SparseMatrix::Get(int i, int j) const { return (*this)(i, j); }
 inline void SparseMatrix::Set(int i, int j, float v)
 {
     assert(columnBeingEdited_ == j);
-    columns_[j]->Set(i, v);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    SetEditedEntry(i, v);
+#else
+    columns_[j - beginColumn_].Set(i, v);
+#endif
 }
 
 inline void SparseMatrix::ClearColumn(int j)
 {
-    usedRanges_[j] = Interval(0, 0);
-    columns_[j]->Clear();
+    assert(IsColumnStored(j));
+    usedRanges_[j - beginColumn_] = Interval(0, 0);
+    columns_[j - beginColumn_].Clear();
     DEBUG_ONLY(CheckInvariants(j);)
 }
 
@@ -104,16 +130,93 @@ inline void SparseMatrix::ClearColumn(int j)
 //
 inline __m128 SparseMatrix::Get4(int i, int j) const
 {
-    if (columns_[j] == NULL) {
-        return Zero4<lfloat>();
-    } else {
-        return columns_[j]->Get4(i);
-    }
+    assert(IsColumnStored(j));
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    if (j == columnBeingEdited_) return EditedEntries<4>(i);
+#endif
+    return columns_[j - beginColumn_].Get4(i);
 }
 
 inline void SparseMatrix::Set4(int i, int j, __m128 v4)
 {
     assert(columnBeingEdited_ == j);
-    columns_[j]->Set4(i, v4);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    SetEditedEntries<4>(i, v4);
+#else
+    columns_[j - beginColumn_].Set4(i, v4);
+#endif
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec SparseMatrix::GetN(int i, int j) const
+{
+    assert(IsColumnStored(j));
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    if (j == columnBeingEdited_) return EditedEntries<W>(i);
+#endif
+    return columns_[j - beginColumn_].GetN<W>(i);
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline void SparseMatrix::SetN(int i, int j, typename Simd<W>::Vec v)
+{
+    assert(columnBeingEdited_ == j);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    SetEditedEntries<W>(i, v);
+#else
+    columns_[j - beginColumn_].SetN<W>(i, v);
+#endif
+}
+
+#ifdef CONSENSUSCORE_HALF_MATRICES
+//
+// The column being edited
+//
+inline float SparseMatrix::EditedEntry(int i) const
+{
+    return (editedRows_.Begin <= i && i < editedRows_.End) ? editing_[i] : LZERO;
+}
+
+inline void SparseMatrix::SetEditedEntry(int i, float v)
+{
+    assert(0 <= i && i < nRows_);
+    if (editedRows_.Begin == editedRows_.End) {
+        editedRows_ = Interval(i, i + 1);
+    } else if (i < editedRows_.Begin) {
+        std::fill(editing_.begin() + i, editing_.begin() + editedRows_.Begin, LZERO);
+        editedRows_.Begin = i;
+    } else if (i >= editedRows_.End) {
+        std::fill(editing_.begin() + editedRows_.End, editing_.begin() + i + 1, LZERO);
+        editedRows_.End = i + 1;
+    }
+    editing_[i] = v;
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec SparseMatrix::EditedEntries(int i) const
+{
+    if (editedRows_.Begin <= i && i + W <= editedRows_.End) {
+        return Simd<W>::Load(&editing_[i]);
+    }
+    float vbuf[W];
+    for (int k = 0; k < W; k++) {
+        vbuf[k] = EditedEntry(i + k);
+    }
+    return Simd<W>::Load(vbuf);
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline void SparseMatrix::SetEditedEntries(int i, typename Simd<W>::Vec v)
+{
+    if (editedRows_.Begin <= i && i + W <= editedRows_.End) {
+        Simd<W>::Store(&editing_[i], v);
+        return;
+    }
+    float vbuf[W];
+    Simd<W>::Store(vbuf, v);
+    for (int k = 0; k < W; k++) {
+        SetEditedEntry(i + k, vbuf[k]);
+    }
 }
+#endif  // CONSENSUSCORE_HALF_MATRICES
 }
@@ -8,7 +8,10 @@
 
 #include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/Matrix/AbstractMatrix.hpp>
+#include <ConsensusCore/Matrix/BandArena.hpp>
 #include <ConsensusCore/Matrix/SparseVector.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
+#include <ConsensusCore/Simd.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
@@ -21,6 +24,13 @@ public:  // Constructor, destructor
     SparseMatrix(const SparseMatrix& other);
     ~SparseMatrix();
 
+    // Reshape to rows x cols with every column empty, reusing the
+    // storage already held where possible.
+    void Reset(int rows, int cols);
+    // As Reset, but store only columns [beginColumn, endColumn); the
+    // others may not be accessed.
+    void Reset(int rows, int cols, int beginColumn, int endColumn);
+
 public:  // Nullability
     static const SparseMatrix& Null();
     bool IsNull() const;
@@ -36,9 +46,21 @@ public:  // Information about entries filled by column
     bool IsColumnEmpty(int j) const;
     int UsedEntries() const;
     int AllocatedEntries() const;  // an entry may be allocated but not used
+    static int EntryBytes();       // the storage an allocated entry takes
+    int64_t AllocatedBytes() const;
+
+    // Release the storage each column holds beyond its used rows,
+    // moving the columns, back to back, into a single chunk just big
+    // enough for them.  Every entry reads as it did; a column edited
+    // afterwards takes new storage as it grows.
+    void ShrinkToFit();
+
+    // Count the matrix, process-wide, as held for category (by default,
+    // MATRIX_MEMORY)
+    void SetMemoryCategory(MemoryCategory category);
 
 public:  // Accessors
-    const float& operator()(int i, int j) const;
+    float operator()(int i, int j) const;
     bool IsAllocated(int i, int j) const;
     float Get(int i, int j) const;
     void Set(int i, int j, float v);
@@ -48,20 +70,76 @@ public:  // SSE accessors, which access 4 successive entries in a column
     __m128 Get4(int i, int j) const;
     void Set4(int i, int j, __m128 v);
 
+public:  // SIMD accessors, which access W successive entries in a column
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec GetN(int i, int j) const;
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET void SetN(int i, int j, typename Simd<W>::Vec v);
+
 public:
     // Method SWIG clients can use to get a native matrix (e.g. Numpy)
     // mat must be filled as a ROW major matrix
     void ToHostMatrix(float** mat, int* rows, int* cols) const;
 
+    // As ToHostMatrix, but just rows [beginRow, endRow) of columns
+    // [beginColumn, endColumn), so that a look at part of a large
+    // matrix costs the size of the part.  window is allocated with
+    // malloc.
+    void ToHostMatrix(float** window, int* windowRows, int* windowCols, int beginRow, int endRow,
+                      int beginColumn, int endColumn) const;
+
+    // Band-native export, taking UsedEntries() floats rather than
+    // Rows() x Columns().  The used entries are packed column after
+    // column into values; column j holds rows UsedRowRange(j), and its
+    // entries begin at values[offsets[j]], offsets having Columns() + 1
+    // elements.  Columns not stored (see Reset) are empty.  The arrays
+    // are allocated with malloc, so that numpy can take them over.
+    void ToHostBand(float** values, int* nValues) const;
+    void ToHostBandOffsets(int** offsets, int* nOffsets) const;
+    // Row ranges as a Columns() x 2 row-major array of (begin, end)
+    void ToHostUsedRowRanges(int** ranges, int* cols, int* two) const;
+
 private:
     void CheckInvariants(int column) const;
+    bool IsColumnStored(int j) const;
+    // The used rows of column j, empty if it is not stored
+    Interval StoredRowRange(int j) const;
+    // The bytes held besides the arena
+    int64_t BookkeepingBytes() const;
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    // Entries of the column being edited
+    float EditedEntry(int i) const;
+    void SetEditedEntry(int i, float v);
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec EditedEntries(int i) const;
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET void SetEditedEntries(int i, typename Simd<W>::Vec v);
+#endif
+
+    SparseMatrix& operator=(const SparseMatrix&);
 
 private:
-    std::vector<SparseVector*> columns_;
+    // Backs the storage of every column; declared before columns_ so
+    // that it outlives them.
+    BandArena arena_;
+    // columns_[k] stores column beginColumn_ + k
+    std::vector<SparseVector> columns_;
+    int beginColumn_;
+    int endColumn_;
     int nCols_;
     int nRows_;
     int columnBeingEdited_;
     std::vector<Interval> usedRanges_;
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    // The column being edited is held as floats, over rows editedRows_,
+    // until it is finished; it is then stored relative to its best
+    // entry, so that the entries near the best are the most precise.
+    std::vector<float> editing_;
+    Interval editedRows_;
+#endif
+    // Counts the bookkeeping bytes, as of the last reshape; the arena
+    // counts its own
+    detail::AccountedBytes accounted_;
 };
 }
 
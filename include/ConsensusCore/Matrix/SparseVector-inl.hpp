@@ -4,12 +4,26 @@
 #include <cassert>
 #include <vector>
 
+#ifdef CONSENSUSCORE_HALF_MATRICES
+#include <immintrin.h>
+#endif
+
 #include <ConsensusCore/LFloat.hpp>
 #include <ConsensusCore/Matrix/SparseVector.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
+#include <ConsensusCore/PerfStats.hpp>
 
 #define PADDING 8
 #define LZERO (-FLT_MAX)
-#define SHRINK_THRESHOLD 0.8
+#define GROWTH_FACTOR 2
+
+// The stored form of LZERO: a half float minus infinity, which reads
+// back as LZERO whatever the offset
+#ifdef CONSENSUSCORE_HALF_MATRICES
+#define EMPTY_CELL static_cast<SparseVector::Cell>(0xFC00)
+#else
+#define EMPTY_CELL LZERO
+#endif
 
 namespace ConsensusCore {
 using std::vector;
@@ -17,28 +31,126 @@ using std::max;
 using std::min;
 
 inline SparseVector::SparseVector(int logicalLength, int beginRow, int endRow)
+    : storage_(NULL)
+    , capacity_(0)
+    , arena_(NULL)
+    , logicalLength_(logicalLength)
+    , allocatedBeginRow_(0)
+    , allocatedEndRow_(0)
+    , nReallocs_(0)
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    , offset_(0.0f)
+    , hasOffset_(false)
+#endif
 {
     assert(beginRow >= 0 && beginRow <= endRow && endRow <= logicalLength);
-    logicalLength_ = logicalLength;
-    allocatedBeginRow_ = max(beginRow - PADDING, 0);
-    allocatedEndRow_ = min(endRow + PADDING, logicalLength_);
-    storage_ = new vector<float>(allocatedEndRow_ - allocatedBeginRow_, LZERO);
+    ResetForRange(beginRow, endRow);
     nReallocs_ = 0;
     DEBUG_ONLY(CheckInvariants());
 }
 
+inline SparseVector::SparseVector(int logicalLength, BandArena* arena)
+    : storage_(NULL)
+    , capacity_(0)
+    , arena_(arena)
+    , logicalLength_(logicalLength)
+    , allocatedBeginRow_(0)
+    , allocatedEndRow_(0)
+    , nReallocs_(0)
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    , offset_(0.0f)
+    , hasOffset_(false)
+#endif
+{
+    assert(arena != NULL);
+    DEBUG_ONLY(CheckInvariants());
+}
+
 inline SparseVector::SparseVector(const SparseVector& other)
-    : logicalLength_(other.logicalLength_)
+    : storage_(NULL)
+    , capacity_(0)
+    , arena_(other.arena_)
+    , logicalLength_(other.logicalLength_)
     , allocatedBeginRow_(other.allocatedBeginRow_)
     , allocatedEndRow_(other.allocatedEndRow_)
     , nReallocs_(0)
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    , offset_(other.offset_)
+    , hasOffset_(other.hasOffset_)
+#endif
 {
-    storage_ = new vector<float>(*other.storage_);
-    nReallocs_ = 0;
+    Reserve(allocatedEndRow_ - allocatedBeginRow_);
+    std::copy(other.storage_, other.storage_ + (allocatedEndRow_ - allocatedBeginRow_), storage_);
     DEBUG_ONLY(CheckInvariants());
 }
 
-inline SparseVector::~SparseVector() { delete storage_; }
+inline SparseVector::SparseVector(const SparseVector& other, BandArena* arena)
+    : storage_(NULL)
+    , capacity_(0)
+    , arena_(arena)
+    , logicalLength_(other.logicalLength_)
+    , allocatedBeginRow_(other.allocatedBeginRow_)
+    , allocatedEndRow_(other.allocatedEndRow_)
+    , nReallocs_(0)
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    , offset_(other.offset_)
+    , hasOffset_(other.hasOffset_)
+#endif
+{
+    assert(arena != NULL);
+    Reserve(allocatedEndRow_ - allocatedBeginRow_);
+    std::copy(other.storage_, other.storage_ + (allocatedEndRow_ - allocatedBeginRow_), storage_);
+    DEBUG_ONLY(CheckInvariants());
+}
+
+inline SparseVector::SparseVector(const SparseVector& other, int beginRow, int endRow,
+                                  BandArena* arena)
+    : storage_(NULL)
+    , capacity_(0)
+    , arena_(arena)
+    , logicalLength_(other.logicalLength_)
+    , allocatedBeginRow_(max(beginRow, other.allocatedBeginRow_))
+    , allocatedEndRow_(min(endRow, other.allocatedEndRow_))
+    , nReallocs_(0)
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    , offset_(other.offset_)
+    , hasOffset_(other.hasOffset_)
+#endif
+{
+    assert(arena != NULL);
+    allocatedEndRow_ = max(allocatedBeginRow_, allocatedEndRow_);
+    Reserve(allocatedEndRow_ - allocatedBeginRow_);
+    const Cell* begin = other.storage_ + (allocatedBeginRow_ - other.allocatedBeginRow_);
+    std::copy(begin, begin + (allocatedEndRow_ - allocatedBeginRow_), storage_);
+    DEBUG_ONLY(CheckInvariants());
+}
+
+inline SparseVector::~SparseVector()
+{
+    if (arena_ == NULL) {
+        delete[] storage_;
+        AccountHeapCells(-capacity_);
+    }
+}
+
+inline void SparseVector::AccountHeapCells(int cells)
+{
+    detail::AccountMemory(MATRIX_MEMORY, static_cast<int64_t>(sizeof(Cell)) * cells);
+}
+
+inline void SparseVector::Reserve(int n)
+{
+    // Arena storage is abandoned rather than freed; the arena releases
+    // it all at once.
+    if (arena_ == NULL) {
+        delete[] storage_;
+        storage_ = new Cell[n];
+        AccountHeapCells(n - capacity_);
+    } else {
+        storage_ = Allocate(arena_, n);
+    }
+    capacity_ = n;
+}
 
 inline void SparseVector::ResetForRange(int beginRow, int endRow)
 {
@@ -47,21 +159,16 @@ inline void SparseVector::ResetForRange(int beginRow, int endRow)
     assert(beginRow >= 0 && beginRow <= endRow && endRow <= logicalLength_);
     int newAllocatedBegin = max(beginRow - PADDING, 0);
     int newAllocatedEnd = min(endRow + PADDING, logicalLength_);
-    if ((newAllocatedEnd - newAllocatedBegin) > (allocatedEndRow_ - allocatedBeginRow_)) {
-        storage_->resize(newAllocatedEnd - newAllocatedBegin);
-        nReallocs_++;
-        Clear();
-    } else if ((newAllocatedEnd - newAllocatedBegin) <
-               static_cast<int>(SHRINK_THRESHOLD * (allocatedEndRow_ - allocatedBeginRow_))) {
-        // use swap trick to free allocated but unused memory,
-        // see: http://stackoverflow.com/questions/253157/how-to-downsize-stdvector
-        std::vector<float>(newAllocatedEnd - newAllocatedBegin, LZERO).swap(*storage_);
+    if ((newAllocatedEnd - newAllocatedBegin) > capacity_) {
+        Reserve(newAllocatedEnd - newAllocatedBegin);
         nReallocs_++;
-    } else {
-        Clear();
+        PERF_SPARSE_VECTOR_REALLOC();
     }
+    // A narrower band keeps its storage; there is nothing to gain from
+    // shrinking it in place.
     allocatedBeginRow_ = newAllocatedBegin;
     allocatedEndRow_ = newAllocatedEnd;
+    Clear();
     DEBUG_ONLY(CheckInvariants());
 }
 
@@ -72,23 +179,39 @@ inline void SparseVector::ExpandAllocated(int newAllocatedBegin, int newAllocate
     assert(newAllocatedBegin >= 0 && newAllocatedBegin <= newAllocatedEnd &&
            newAllocatedEnd <= logicalLength_);
     assert(newAllocatedBegin <= allocatedBeginRow_ && newAllocatedEnd >= allocatedEndRow_);
-    // Resize the underlying storage.
-    storage_->resize(newAllocatedEnd - newAllocatedBegin);
-    // Use memmove to robustly relocate the old data (handles overlapping ranges).
-    //   Data is at:
-    //      storage[0 ... (end - begin) )
-    //   Must be moved to:
-    //      storage[(begin - newBegin) ... (end - newBegin)]
-    memmove(&(*storage_)[allocatedBeginRow_ - newAllocatedBegin], &(*storage_)[0],
-            (allocatedEndRow_ - allocatedBeginRow_) * sizeof(float));  // NOLINT
+    int oldSize = allocatedEndRow_ - allocatedBeginRow_;
+    int newSize = newAllocatedEnd - newAllocatedBegin;
+    int offset = allocatedBeginRow_ - newAllocatedBegin;
+    if (newSize > capacity_) {
+        // Grow geometrically, so repeated expansion of a column costs
+        // amortized constant time per entry.
+        Cell* oldStorage = storage_;
+        int newCapacity = min(max(newSize, GROWTH_FACTOR * capacity_), logicalLength_);
+        if (arena_ == NULL) {
+            storage_ = new Cell[newCapacity];
+            AccountHeapCells(newCapacity - capacity_);
+        } else {
+            storage_ = Allocate(arena_, newCapacity);
+        }
+        capacity_ = newCapacity;
+        std::copy(oldStorage, oldStorage + oldSize, storage_ + offset);
+        if (arena_ == NULL) delete[] oldStorage;
+    } else {
+        // Use memmove to robustly relocate the old data (handles overlapping ranges).
+        //   Data is at:
+        //      storage[0 ... (end - begin) )
+        //   Must be moved to:
+        //      storage[(begin - newBegin) ... (end - newBegin)]
+        memmove(storage_ + offset, storage_, oldSize * sizeof(Cell));  // NOLINT
+    }
     // "Zero"-fill the allocated but unused space.
-    std::fill(storage_->begin(), storage_->begin() + (allocatedBeginRow_ - newAllocatedBegin),
-              LZERO);
-    std::fill(storage_->begin() + (allocatedEndRow_ - newAllocatedBegin), storage_->end(), LZERO);
+    std::fill(storage_, storage_ + offset, EMPTY_CELL);
+    std::fill(storage_ + offset + oldSize, storage_ + newSize, EMPTY_CELL);
     // Update pointers.
     allocatedBeginRow_ = newAllocatedBegin;
     allocatedEndRow_ = newAllocatedEnd;
     nReallocs_++;
+    PERF_SPARSE_VECTOR_REALLOC();
     DEBUG_ONLY(CheckInvariants());
 }
 
@@ -98,13 +221,12 @@ inline bool SparseVector::IsAllocated(int i) const
     return i >= allocatedBeginRow_ && i < allocatedEndRow_;
 }
 
-inline const float& SparseVector::operator()(int i) const
+inline float SparseVector::operator()(int i) const
 {
     if (IsAllocated(i)) {
-        return (*storage_)[i - allocatedBeginRow_];
+        return Decode(storage_[i - allocatedBeginRow_]);
     } else {
-        static const float emptyCell_ = LZERO;
-        return emptyCell_;
+        return LZERO;
     }
 }
 
@@ -119,7 +241,7 @@ inline void SparseVector::Set(int i, float v)
         int newEndRow = min(max(i + PADDING, allocatedEndRow_), logicalLength_);
         ExpandAllocated(newBeginRow, newEndRow);
     }
-    (*storage_)[i - allocatedBeginRow_] = v;
+    storage_[i - allocatedBeginRow_] = Encode(v);
     DEBUG_ONLY(CheckInvariants());
 }
 
@@ -127,7 +249,7 @@ inline __m128 SparseVector::Get4(int i) const
 {
     assert(i >= 0 && i < logicalLength_ - 3);
     if (i >= allocatedBeginRow_ && i < allocatedEndRow_ - 3) {
-        return _mm_loadu_ps(&(*storage_)[i - allocatedBeginRow_]);
+        return DecodeN<4>(&storage_[i - allocatedBeginRow_]);
     } else {
         return _mm_set_ps(Get(i + 3), Get(i + 2), Get(i + 1), Get(i + 0));
     }
@@ -137,7 +259,7 @@ inline void SparseVector::Set4(int i, __m128 v4)
 {
     assert(i >= 0 && i < logicalLength_ - 3);
     if (i >= allocatedBeginRow_ && i < allocatedEndRow_ - 3) {
-        _mm_storeu_ps(&(*storage_)[i - allocatedBeginRow_], v4);
+        EncodeN<4>(&storage_[i - allocatedBeginRow_], v4);
     } else {
         float vbuf[4];
         _mm_storeu_ps(vbuf, v4);
@@ -148,21 +270,127 @@ inline void SparseVector::Set4(int i, __m128 v4)
     }
 }
 
-inline void SparseVector::Clear() { std::fill(storage_->begin(), storage_->end(), LZERO); }
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec SparseVector::GetN(int i) const
+{
+    assert(i >= 0 && i <= logicalLength_ - W);
+    if (i >= allocatedBeginRow_ && i <= allocatedEndRow_ - W) {
+        return DecodeN<W>(&storage_[i - allocatedBeginRow_]);
+    } else {
+        float vbuf[W];
+        for (int k = 0; k < W; k++) {
+            vbuf[k] = Get(i + k);
+        }
+        return Simd<W>::Load(vbuf);
+    }
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline void SparseVector::SetN(int i, typename Simd<W>::Vec v)
+{
+    assert(i >= 0 && i <= logicalLength_ - W);
+    if (i >= allocatedBeginRow_ && i <= allocatedEndRow_ - W) {
+        EncodeN<W>(&storage_[i - allocatedBeginRow_], v);
+    } else {
+        float vbuf[W];
+        Simd<W>::Store(vbuf, v);
+        for (int k = 0; k < W; k++) {
+            Set(i + k, vbuf[k]);
+        }
+    }
+}
 
-inline int SparseVector::AllocatedEntries() const
+inline void SparseVector::Clear()
 {
-    // We want the real memory usage.  std::vector is holding some memory back
-    // from us.
-    return storage_->capacity();
+    std::fill(storage_, storage_ + (allocatedEndRow_ - allocatedBeginRow_), EMPTY_CELL);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    offset_ = 0.0f;
+    hasOffset_ = false;
+#endif
 }
 
+inline SparseVector::Cell* SparseVector::Allocate(BandArena* arena, int n)
+{
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    // the arena hands out floats
+    int floats = (n * sizeof(Cell) + sizeof(float) - 1) / sizeof(float);
+    return reinterpret_cast<Cell*>(arena->Allocate(floats));  // NOLINT
+#else
+    return arena->Allocate(n);
+#endif
+}
+
+#ifdef CONSENSUSCORE_HALF_MATRICES
+inline float SparseVector::Decode(Cell c) const { return max(_cvtsh_ss(c) + offset_, LZERO); }
+
+inline void SparseVector::SetOffset(float offset)
+{
+    if (offset > LZERO) {
+        offset_ = offset;
+        hasOffset_ = true;
+    }
+}
+
+inline SparseVector::Cell SparseVector::Encode(float v)
+{
+    if (!hasOffset_ && v > LZERO) {
+        offset_ = v;
+        hasOffset_ = true;
+    }
+    return _cvtss_sh(v - offset_, _MM_FROUND_TO_NEAREST_INT);
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec SparseVector::DecodeN(const Cell* p) const
+{
+    typedef Simd<W> S;
+    return S::Max(S::Add(S::LoadHalf(p), S::Set1(offset_)), S::Set1(LZERO));
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline void SparseVector::EncodeN(Cell* p, typename Simd<W>::Vec v)
+{
+    typedef Simd<W> S;
+    if (!hasOffset_) {
+        // Encode takes its offset from the first entry above LZERO
+        float vbuf[W];
+        S::Store(vbuf, v);
+        for (int k = 0; k < W && !hasOffset_; k++) {
+            Encode(vbuf[k]);
+        }
+    }
+    S::StoreHalf(p, S::Sub(v, S::Set1(offset_)));
+}
+#else
+inline void SparseVector::SetOffset(float) {}
+
+inline float SparseVector::Decode(Cell c) const { return c; }
+
+inline SparseVector::Cell SparseVector::Encode(float v) { return v; }
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec SparseVector::DecodeN(const Cell* p) const
+{
+    return Simd<W>::Load(p);
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline void SparseVector::EncodeN(Cell* p, typename Simd<W>::Vec v)
+{
+    Simd<W>::Store(p, v);
+}
+#endif  // CONSENSUSCORE_HALF_MATRICES
+
+inline int SparseVector::AllocatedEntries() const { return capacity_; }
+
+inline int SparseVector::EntryBytes() { return sizeof(Cell); }
+
 inline void SparseVector::CheckInvariants() const
 {
     assert(logicalLength_ >= 0);
-    assert(0 <= allocatedBeginRow_ && allocatedBeginRow_ < logicalLength_);
+    assert(0 <= allocatedBeginRow_ && allocatedBeginRow_ <= logicalLength_);
     assert(0 <= allocatedEndRow_ && allocatedEndRow_ <= logicalLength_);
     assert(allocatedBeginRow_ <= allocatedEndRow_);
-    assert((allocatedEndRow_ - allocatedBeginRow_) <= static_cast<int>(storage_->size()));
+    assert((allocatedEndRow_ - allocatedBeginRow_) <= capacity_);
 }
 }
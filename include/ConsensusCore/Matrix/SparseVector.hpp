@@ -2,20 +2,46 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <xmmintrin.h>
 #include <utility>
 #include <vector>
 
+#include <ConsensusCore/Matrix/BandArena.hpp>
+#include <ConsensusCore/Simd.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
 namespace ConsensusCore {
 
+/// \brief A vector of which only a band of entries is stored.
+///
+/// Storage comes either from the heap, owned by the vector, or from
+/// a BandArena, which must outlive the vector.  Arena-backed vectors
+/// never free their storage; when they outgrow it, they take a larger
+/// piece from the arena and abandon the old one.
+///
+/// Built with CONSENSUSCORE_HALF_MATRICES defined (meson
+/// -Dhalf_matrices=true), entries are stored as IEEE half floats,
+/// less an offset: the one last given to SetOffset, or else the first
+/// entry above LZERO set since the vector was last cleared.  They are
+/// read and written as floats, converted by F16C instructions.  This
+/// halves the memory of the band, at the cost of precision: an entry
+/// is off by up to 2^-11 of its distance from the offset, and entries
+/// more than 65504 below it read as LZERO.
 class SparseVector
 {
 public:  // Constructor, destructor
     SparseVector(int logicalLength, int beginRow, int endRow);
+    // An empty vector, allocating from arena once it is first used
+    SparseVector(int logicalLength, BandArena* arena);
+    // A copy allocating from the same storage source as other
     SparseVector(const SparseVector& other);
+    // A copy allocating from arena
+    SparseVector(const SparseVector& other, BandArena* arena);
+    // A copy, allocating from arena, of just the rows of other in
+    // [beginRow, endRow); the others read as LZERO
+    SparseVector(const SparseVector& other, int beginRow, int endRow, BandArena* arena);
     ~SparseVector();
 
     // Ensures there is enough allocated storage to
@@ -24,16 +50,26 @@ public:  // Constructor, destructor
     void ResetForRange(int beginRow, int endRow);
 
 public:
-    const float& operator()(int i) const;
+    float operator()(int i) const;
     bool IsAllocated(int i) const;
     float Get(int i) const;
     void Set(int i, float v);
     __m128 Get4(int i) const;
     void Set4(int i, __m128 v);
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec GetN(int i) const;
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET void SetN(int i, typename Simd<W>::Vec v);
     void Clear();
 
+    // Store the entries set from now until the next clear relative to
+    // offset; a no-op unless entries are stored as half floats
+    void SetOffset(float offset);
+
 public:
     int AllocatedEntries() const;
+    // The bytes of storage an entry takes
+    static int EntryBytes();
     void CheckInvariants() const;
 
 private:
@@ -43,8 +79,37 @@ private:
     // before calling.
     void ExpandAllocated(int newAllocatedBegin, int newAllocatedEnd);
 
+    // Replace the storage by at least n uninitialized entries
+    void Reserve(int n);
+
+    SparseVector& operator=(const SparseVector&);
+
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    typedef uint16_t Cell;
+#else
+    typedef float Cell;
+#endif
+
+    // n cells of storage from arena
+    static Cell* Allocate(BandArena* arena, int n);
+    // Count cells of heap storage, or uncount them if negative, as
+    // held for matrices
+    static void AccountHeapCells(int cells);
+
+    // The stored form of entries
+    float Decode(Cell c) const;
+    Cell Encode(float v);
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec DecodeN(const Cell* p) const;
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET void EncodeN(Cell* p, typename Simd<W>::Vec v);
+
 private:
-    std::vector<float>* storage_;
+    Cell* storage_;
+    int capacity_;
+
+    // where storage comes from; NULL for the heap
+    BandArena* arena_;
 
     // the "logical" length of the vector, of which only
     // a subset of entries are actually allocated
@@ -56,6 +121,13 @@ private:
 
     // analytics
     int nReallocs_;
+
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    // what stored entries are relative to, once an entry above LZERO
+    // is set
+    float offset_;
+    bool hasOffset_;
+#endif
 };
 }
 
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <vector>
 
 namespace ConsensusCore {
@@ -17,6 +18,12 @@ template <typename T>
 T Max(const VectorL<T>& v);
 template <typename T>
 size_t ArgMax(const VectorL<T>& v);
+template <typename T>
+class VectorViewL;  // fwd
+template <typename T>
+T Max(const VectorViewL<T>& v);
+template <typename T>
+size_t ArgMax(const VectorViewL<T>& v);
 
 //
 // Vector class that stores only a subsequence of the rows
@@ -57,6 +64,39 @@ public:
     friend size_t ArgMax<>(const VectorL<T>& v);
 };
 
+//
+// The same, over storage owned by someone else (e.g., an arena shared by
+// many vectors).  Copying a view does not copy the elements.
+//
+template <typename T>
+class VectorViewL
+{
+private:
+    T* storage_;
+    size_t beginRow_;
+    size_t endRow_;
+
+public:
+    VectorViewL() : storage_(NULL), beginRow_(0), endRow_(0) {}
+
+    VectorViewL(T* storage, int beginRow, int endRow)
+        : storage_(storage), beginRow_(beginRow), endRow_(endRow)
+    {
+    }
+
+    T& operator[](size_t pos) const
+    {
+        assert(beginRow_ <= pos && pos < endRow_);
+        return storage_[pos - beginRow_];
+    }
+
+    size_t BeginRow() const { return beginRow_; }
+    size_t EndRow() const { return endRow_; }
+
+    friend T Max<>(const VectorViewL<T>& v);
+    friend size_t ArgMax<>(const VectorViewL<T>& v);
+};
+
 using std::max_element;
 using std::distance;
 
@@ -72,5 +112,18 @@ size_t ArgMax(const VectorL<T>& v)
     return v.beginRow_ +
            distance(v.storage_.begin(), max_element(v.storage_.begin(), v.storage_.end()));
 }
+
+template <typename T>
+T Max(const VectorViewL<T>& v)
+{
+    return *max_element(v.storage_, v.storage_ + (v.endRow_ - v.beginRow_));
+}
+
+template <typename T>
+size_t ArgMax(const VectorViewL<T>& v)
+{
+    return v.beginRow_ +
+           distance(v.storage_, max_element(v.storage_, v.storage_ + (v.endRow_ - v.beginRow_)));
+}
 }
 }  // ConsensusCore::detail
@@ -0,0 +1,106 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+namespace ConsensusCore {
+
+/// \brief What memory is held for.
+enum MemoryCategory
+{
+    MATRIX_MEMORY = 0,
+    SCRATCH_MEMORY = 1,
+    FEATURE_MEMORY = 2,
+    POA_MEMORY = 3,
+    SCORER_MEMORY = 4,
+    NUM_MEMORY_CATEGORIES = 5
+};
+
+/// \brief Bytes held, by category.
+struct MemoryUsage
+{
+    // The alpha and beta matrices: their bands, with padding and the
+    // capacity not in use, and their per-column bookkeeping
+    int64_t MatrixBytes;
+    // Matrices held per thread rather than per scorer: the extend
+    // buffers and refilled checkpoint columns of ScoreMutation, and the
+    // matrices pooled for reuse
+    int64_t ScratchBytes;
+    // Feature arrays: those of the reads, and the move scores the
+    // evaluators precompute from them
+    int64_t FeatureBytes;
+    // The alignment columns of POA graphs, including those each
+    // thread keeps for the next read it adds
+    int64_t PoaBytes;
+    // What a scorer keeps besides matrices and features: its reads'
+    // scorers and evaluators, their score caches, and its index of them
+    int64_t ScorerBytes;
+
+    MemoryUsage() : MatrixBytes(0), ScratchBytes(0), FeatureBytes(0), PoaBytes(0), ScorerBytes(0)
+    {
+    }
+
+    int64_t TotalBytes() const
+    {
+        return MatrixBytes + ScratchBytes + FeatureBytes + PoaBytes + ScorerBytes;
+    }
+};
+
+/// \brief The bytes held now, by every thread, by the matrices, feature
+///        arrays and POA alignment columns alive.  ScorerBytes is not
+///        tracked process-wide, and is zero.
+MemoryUsage ProcessMemoryUsage();
+
+/// \brief The most bytes held at once, in total, since the process
+///        started or ResetPeakMemoryBytes was last called.
+int64_t PeakMemoryBytes();
+
+/// \brief Start tracking the peak afresh, from the bytes held now.
+void ResetPeakMemoryBytes();
+
+#ifndef SWIG
+namespace detail {
+
+// Count bytes, or with a negative count uncount them, as held for the
+// category
+void AccountMemory(MemoryCategory category, int64_t bytes);
+
+// The bytes held by an object, counted process-wide as they change and
+// uncounted when it is destroyed.  A copy counts nothing until Set.
+class AccountedBytes
+{
+public:
+    explicit AccountedBytes(MemoryCategory category = MATRIX_MEMORY)
+        : category_(category), bytes_(0)
+    {
+    }
+
+    AccountedBytes(const AccountedBytes& other) : category_(other.category_), bytes_(0) {}
+
+    ~AccountedBytes() { AccountMemory(category_, -bytes_); }
+
+    void Set(int64_t bytes)
+    {
+        if (bytes != bytes_) AccountMemory(category_, bytes - bytes_);
+        bytes_ = bytes;
+    }
+
+    // Count the bytes held as held for category instead
+    void SetCategory(MemoryCategory category)
+    {
+        if (category == category_) return;
+        AccountMemory(category_, -bytes_);
+        AccountMemory(category, bytes_);
+        category_ = category;
+    }
+
+private:
+    AccountedBytes& operator=(const AccountedBytes&);
+
+    MemoryCategory category_;
+    int64_t bytes_;
+};
+}
+#endif  // SWIG
+}
@@ -5,41 +5,99 @@
 #include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Utils.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <string>
 
 namespace ConsensusCore {
 
-inline Mutation::Mutation() : type_(SUBSTITUTION), start_(0), end_(1), newBases_("A") {}
+inline Mutation::Mutation() : type_(SUBSTITUTION), start_(0), end_(1), nBases_(0)
+{
+    SetBases("A", 1);
+}
 
-inline Mutation::Mutation(MutationType type, int start, int end, std::string newBases)
-    : type_(type), start_(start), end_(end), newBases_(newBases)
+inline Mutation::Mutation(MutationType type, int start, int end, const std::string& newBases)
+    : type_(type), start_(start), end_(end), nBases_(0)
 {
-    if (!CheckInvariants()) throw InvalidInputError();
+    SetBases(newBases.data(), newBases.length());
+    if (!CheckInvariants()) {
+        FreeBases();
+        throw InvalidInputError();
+    }
+}
+
+inline Mutation::Mutation(MutationType type, int start, int end, const char* newBases,
+                          int length)
+    : type_(type), start_(start), end_(end), nBases_(0)
+{
+    SetBases(newBases, length);
+    if (!CheckInvariants()) {
+        FreeBases();
+        throw InvalidInputError();
+    }
 }
 
 inline Mutation::Mutation(MutationType type, int position, char base)
-    : type_(type), start_(position)
+    : type_(type), start_(position), nBases_(0)
 {
     if (type == INSERTION) {
         end_ = position;
     } else {
         end_ = position + 1;
     }
-    newBases_ = (type == DELETION ? "" : std::string(1, base));
+    if (type != DELETION) {
+        SetBases(&base, 1);
+    }
     if (!CheckInvariants()) throw InvalidInputError();
 }
 
 inline Mutation::Mutation(const Mutation& other)
-    : type_(other.type_), start_(other.start_), end_(other.end_), newBases_(other.newBases_)
+    : type_(other.type_), start_(other.start_), end_(other.end_), nBases_(0)
 {
+    SetBases(other.NewBasesData(), other.nBases_);
+}
+
+inline Mutation::~Mutation() { FreeBases(); }
+
+inline Mutation& Mutation::operator=(const Mutation& other)
+{
+    if (this != &other) {
+        FreeBases();
+        type_ = other.type_;
+        start_ = other.start_;
+        end_ = other.end_;
+        SetBases(other.NewBasesData(), other.nBases_);
+    }
+    return *this;
+}
+
+inline void Mutation::SetBases(const char* bases, int length)
+{
+    assert(nBases_ == 0 && length >= 0);
+    nBases_ = length;
+    if (length > INLINE_BASES) {
+        bases_.heap_ = new char[length];
+        std::memcpy(bases_.heap_, bases, length);
+    } else {
+        std::memcpy(bases_.inline_, bases, length);
+    }
+}
+
+inline void Mutation::FreeBases()
+{
+    if (nBases_ > INLINE_BASES) {
+        delete[] bases_.heap_;
+    }
+    nBases_ = 0;
 }
 
 inline bool Mutation::CheckInvariants() const
 {
-    if (!((type_ == INSERTION && (start_ == end_) && newBases_.length() > 0) ||
-          (type_ == DELETION && (start_ < end_) && newBases_.length() == 0) ||
+    if (!((type_ == INSERTION && (start_ == end_) && nBases_ > 0) ||
+          (type_ == DELETION && (start_ < end_) && nBases_ == 0) ||
           (type_ == SUBSTITUTION && (start_ < end_) &&
-           (static_cast<int>(newBases_.length()) == end_ - start_))))  // NOLINT
+           (nBases_ == end_ - start_))))  // NOLINT
     {
         return false;
     }
@@ -59,14 +117,21 @@ inline int Mutation::Start() const { return start_; }
 
 inline int Mutation::End() const { return end_; }
 
-inline std::string Mutation::NewBases() const { return newBases_; }
+inline std::string Mutation::NewBases() const { return std::string(NewBasesData(), nBases_); }
+
+inline int Mutation::NewBasesLength() const { return nBases_; }
+
+inline const char* Mutation::NewBasesData() const
+{
+    return (nBases_ > INLINE_BASES ? bases_.heap_ : bases_.inline_);
+}
 
 inline MutationType Mutation::Type() const { return type_; }
 
 inline int Mutation::LengthDiff() const
 {
     if (IsInsertion())
-        return newBases_.length();
+        return nBases_;
     else if (IsDeletion())
         return start_ - end_;
     else
@@ -76,7 +141,8 @@ inline int Mutation::LengthDiff() const
 inline bool Mutation::operator==(const Mutation& other) const
 {
     return (Start() == other.Start() && End() == other.End() && Type() == other.Type() &&
-            NewBases() == other.NewBases());
+            nBases_ == other.nBases_ &&
+            std::memcmp(NewBasesData(), other.NewBasesData(), nBases_) == 0);
 }
 
 inline bool Mutation::operator<(const Mutation& other) const
@@ -90,6 +156,8 @@ inline bool Mutation::operator<(const Mutation& other) const
     if (Type() != other.Type()) {
         return Type() < other.Type();
     }
-    return NewBases() < other.NewBases();
+    return std::lexicographical_compare(NewBasesData(), NewBasesData() + nBases_,
+                                        other.NewBasesData(),
+                                        other.NewBasesData() + other.nBases_);
 }
 }
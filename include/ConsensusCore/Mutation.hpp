@@ -10,6 +10,8 @@
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
+#define TEMPLATE_FINGERPRINT_WINDOW 24
+
 namespace ConsensusCore {
 enum MutationType
 {
@@ -19,20 +21,43 @@ enum MutationType
 };
 
 /// \brief Single mutation to a template sequence.
+///
+/// The new bases of a mutation of up to eight bases---which is to say,
+/// of every mutation the enumerators propose---are held inline, so that
+/// making, copying and orienting one does not allocate.
 class Mutation
 {
 private:
+    enum
+    {
+        INLINE_BASES = 8
+    };
+
     MutationType type_;
     int start_;
     int end_;
-    std::string newBases_;
+    int nBases_;
+    union
+    {
+        char inline_[INLINE_BASES];
+        char* heap_;  // if nBases_ > INLINE_BASES
+    } bases_;
 
     bool CheckInvariants() const;
+    void SetBases(const char* bases, int length);
+    void FreeBases();
 
 public:
-    Mutation(MutationType type, int start, int end, std::string newBases);
+    Mutation(MutationType type, int start, int end, const std::string& newBases);
     Mutation(MutationType type, int position, char base);
     Mutation(const Mutation& other);
+#ifndef SWIG
+    // The new bases are newBases[0, length)
+    Mutation(MutationType type, int start, int end, const char* newBases, int length);
+#endif  // SWIG
+    ~Mutation();
+
+    Mutation& operator=(const Mutation& other);
 
     // Note: this defines a default mutation.  This is really only needed to fix
     // SWIG compilation.
@@ -55,6 +80,12 @@ public:
     int End() const;
 
     std::string NewBases() const;
+    int NewBasesLength() const;
+#ifndef SWIG
+    // The new bases, without making a string of them; there are
+    // NewBasesLength() of them, and they are not null-terminated.
+    const char* NewBasesData() const;
+#endif  // SWIG
     int LengthDiff() const;
     std::string ToString() const;
 
@@ -71,11 +102,39 @@ std::ostream& operator<<(std::ostream& out, const Mutation& m);
 std::string ApplyMutation(const Mutation& mut, const std::string& tpl);
 std::string ApplyMutations(const std::vector<Mutation>& muts, const std::string& tpl);
 
+/// \brief Apply mutations to a template, writing the result to *out,
+/// which must not be tpl.  Where the mutations do not overlap the
+/// result is laid down in a single pass over the template, and once
+/// *out has grown to the size of the results, no allocation is made
+/// (beyond sorting the mutations, if they are not sorted already).
+void ApplyMutations(const std::vector<Mutation>& muts, const std::string& tpl, std::string* out);
+
+/// \brief Apply a mutation to a template in place, saving the bases it
+/// overwrites or removes in *savedBases so that UndoMutationInPlace can
+/// restore the original template.  Once tpl and savedBases have grown
+/// to accommodate the mutations seen, neither call allocates.
+void ApplyMutationInPlace(const Mutation& mut, std::string* tpl, std::string* savedBases);
+void UndoMutationInPlace(const Mutation& mut, std::string* tpl, const std::string& savedBases);
+
 std::string MutationsToTranscript(const std::vector<Mutation>& muts, const std::string& tpl);
 
 std::vector<int> TargetToQueryPositions(const std::vector<Mutation>& mutations,
                                         const std::string& tpl);
 
+/// \brief A 64-bit fingerprint of a template, for telling templates
+/// apart without comparing (or hashing) them whole.  It sums a hash of
+/// each window of TEMPLATE_FINGERPRINT_WINDOW bases, padded at either
+/// end, so two templates share one only if they have the same windows
+/// (which takes a rearrangement of repeats as long as a window) or by
+/// a 64-bit collision.
+uint64_t TemplateFingerprint(const std::string& tpl);
+
+/// \brief The fingerprint of the template mutations make of tpl, given
+/// the fingerprint of tpl, in time proportional to the mutations and
+/// the windows about them rather than to the template.
+uint64_t MutatedTemplateFingerprint(uint64_t fingerprint, const std::vector<Mutation>& mutations,
+                                    const std::string& tpl);
+
 class ScoredMutation : public Mutation
 {
 private:
@@ -0,0 +1,28 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <vector>
+
+namespace ConsensusCore {
+
+/// \brief The NUMA nodes of the machine, as Linux lists them under
+///        /sys/devices/system/node; a machine it cannot tell the nodes
+///        of has just one, node 0, holding every CPU.
+int NumNumaNodes();
+
+/// \brief The CPUs of a node, in ascending order; empty for nodes
+///        that are not online or have no CPUs.
+std::vector<int> NumaNodeCpus(int node);
+
+/// \brief The node of the CPU the calling thread is running on.
+int CurrentNumaNode();
+
+/// \brief Keep the calling thread, and the threads it starts from now
+///        on, to the CPUs of node.  Memory is placed on the node of
+///        the thread that first touches it, so the matrices such a
+///        thread fills are then local to it.  Returns false, leaving
+///        the thread where it was, where threads cannot be pinned or
+///        the node has no CPUs.
+bool PinThreadToNumaNode(int node);
+}
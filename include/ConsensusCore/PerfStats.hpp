@@ -0,0 +1,174 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ConsensusCore {
+
+/// \brief The phases of the Quiver pipeline that are instrumented.
+///
+/// Phases are inclusive: the time of a ScoreMutation call includes
+/// that of the ExtendAlpha and LinkAlphaBeta calls made within it.
+enum PerfPhase
+{
+    PERF_FILL_ALPHA_BETA = 0,
+    PERF_EXTEND = 1,
+    PERF_LINK_ALPHA_BETA = 2,
+    PERF_SCORE_MUTATION = 3,
+    PERF_APPLY_MUTATIONS = 4,
+    PERF_ENUMERATE_MUTATIONS = 5,
+    PERF_TRY_ADD_READ = 6,
+    PERF_COMMIT_ADD = 7,
+    PERF_REFINE_ITERATION = 8,
+    PERF_NUM_PHASES = 9
+};
+
+/// \brief The counters for one phase
+struct PhaseStats
+{
+    std::string Phase;
+    // Calls made, and matrix cells computed by them
+    int64_t Calls;
+    int64_t Cells;
+    double Seconds;
+
+    PhaseStats() : Phase(), Calls(0), Cells(0), Seconds(0) {}
+};
+
+/// \brief The instrumentation counters, summed over all threads.
+///
+/// Counting is compiled in only when the library is built with
+/// CONSENSUSCORE_PERF_STATS defined (meson -Dperf_stats=true);
+/// otherwise Enabled is false and every counter stays zero, at no
+/// cost to the instrumented code.
+struct PerfStats
+{
+    bool Enabled;
+    std::vector<PhaseStats> Phases;
+    // Times a SparseVector outgrew its storage
+    int64_t SparseVectorReallocs;
+
+    PerfStats() : Enabled(false), Phases(), SparseVectorReallocs(0) {}
+};
+
+/// \brief The counters accumulated so far, by all threads, live or
+///        exited.
+PerfStats CollectPerfStats();
+
+/// \brief Zero the counters.  Counts made by other threads while this
+///        runs may be lost.
+void ResetPerfStats();
+
+/// \brief The start or end of a call of an instrumented phase, as
+///        passed to a trace hook.
+struct PerfTraceEvent
+{
+    PerfPhase Phase;
+    const char* Name;
+    // The call's start, else its end
+    bool Begin;
+    // On the steady clock
+    int64_t Nanoseconds;
+    // A small number naming the calling thread, from 0
+    int Thread;
+};
+
+/// \brief Whether the trace hooks are compiled in, which they are only
+///        when the library is built with CONSENSUSCORE_PERF_TRACE
+///        defined (meson -Dperf_trace=true).  When they are not, a hook
+///        set is never called.
+bool PerfTraceEnabled();
+
+#ifndef SWIG
+/// \brief A trace hook.  It is called on the thread making the call,
+///        at its start and end, so must be thread safe and quick.
+typedef std::function<void(const PerfTraceEvent&)> PerfTraceHook;
+
+/// \brief Set the trace hook, or clear it with an empty one.  It must
+///        not be set while instrumented code runs on other threads.
+void SetPerfTraceHook(const PerfTraceHook& hook);
+#endif  // SWIG
+
+#ifndef SWIG
+namespace detail {
+
+// Add to the calling thread's counters
+void CountPerfCall(PerfPhase phase, std::chrono::steady_clock::duration elapsed);
+void CountPerfCells(PerfPhase phase, int64_t cells);
+void CountSparseVectorRealloc();
+
+// Pass the start or end of a call to the trace hook, if one is set
+void TracePerf(PerfPhase phase, bool begin);
+
+// Times the enclosing scope as a call of the given phase
+class PerfScope
+{
+public:
+    explicit PerfScope(PerfPhase phase) : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+
+    ~PerfScope() { CountPerfCall(phase_, std::chrono::steady_clock::now() - start_); }
+
+private:
+    PerfScope(const PerfScope&);
+    PerfScope& operator=(const PerfScope&);
+
+    PerfPhase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Traces the enclosing scope as a call of the given phase
+class TraceScope
+{
+public:
+    explicit TraceScope(PerfPhase phase) : phase_(phase) { TracePerf(phase_, true); }
+
+    ~TraceScope() { TracePerf(phase_, false); }
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    PerfPhase phase_;
+};
+
+// The cells of columns [beginColumn, endColumn) of a matrix
+template <typename M>
+int64_t UsedCells(const M& m, int beginColumn, int endColumn)
+{
+    int64_t cells = 0;
+    for (int j = beginColumn; j < endColumn; j++) {
+        cells += m.UsedRowRange(j).End - m.UsedRowRange(j).Begin;
+    }
+    return cells;
+}
+}
+
+#ifdef CONSENSUSCORE_PERF_STATS
+#define PERF_COUNT_SCOPE(phase) ::ConsensusCore::detail::PerfScope perfScope_(phase)
+#define PERF_CELLS(phase, cells) ::ConsensusCore::detail::CountPerfCells(phase, cells)
+#define PERF_SPARSE_VECTOR_REALLOC() ::ConsensusCore::detail::CountSparseVectorRealloc()
+#else
+#define PERF_COUNT_SCOPE(phase)
+#define PERF_CELLS(phase, cells)
+#define PERF_SPARSE_VECTOR_REALLOC()
+#endif  // CONSENSUSCORE_PERF_STATS
+
+#ifdef CONSENSUSCORE_PERF_TRACE
+#define PERF_TRACE_SCOPE(phase) ::ConsensusCore::detail::TraceScope traceScope_(phase)
+#else
+#define PERF_TRACE_SCOPE(phase)
+#endif  // CONSENSUSCORE_PERF_TRACE
+
+// The trace scope opens first and closes last, so the time counted
+// leaves out the hook's
+#define PERF_SCOPE(phase)    \
+    PERF_TRACE_SCOPE(phase); \
+    PERF_COUNT_SCOPE(phase)
+#endif  // SWIG
+}
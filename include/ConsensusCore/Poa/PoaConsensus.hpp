@@ -10,6 +10,7 @@
 
 #include <ConsensusCore/Align/AlignConfig.hpp>
 #include <ConsensusCore/Poa/PoaGraph.hpp>
+#include <ConsensusCore/Read.hpp>
 
 namespace ConsensusCore {
 using boost::noncopyable;
@@ -27,17 +28,26 @@ struct PoaConsensus : private noncopyable
     PoaGraph Graph;
     std::vector<PoaGraph::Vertex> Path;
 
+    // The vertex each base of each read was threaded to, for the
+    // reads of FindConsensus, in the order given; empty otherwise
+    std::vector<std::vector<PoaGraph::Vertex> > ReadPaths;
+
     PoaConsensus(const std::string& css, const PoaGraph& g,
                  const std::vector<PoaGraph::Vertex>& ConsensusPath);
 
-    // NB: this constructor exists to provide a means to avoid an unnecessary copy
-    // of the
-    // boost graph.  If we had move semantics (C++11) we would be able to get by
-    // without
-    // this.
+    // NB: this constructor exists to provide a means to avoid copying a
+    // PoaGraph on the way to copying its graph.
     PoaConsensus(const std::string& css, const detail::PoaGraphImpl& g,
                  const std::vector<PoaGraph::Vertex>& ConsensusPath);
 
+#ifndef SWIG
+    // Takes over g, and the paths of the reads, without copying them
+    PoaConsensus(const std::string& css, PoaGraph&& g,
+                 const std::vector<PoaGraph::Vertex>& ConsensusPath,
+                 std::vector<std::vector<PoaGraph::Vertex> >&& readPaths =
+                     std::vector<std::vector<PoaGraph::Vertex> >());
+#endif  // SWIG
+
     ~PoaConsensus();
 
     static const PoaConsensus* FindConsensus(const std::vector<std::string>& reads);
@@ -48,10 +58,56 @@ struct PoaConsensus : private noncopyable
     static const PoaConsensus* FindConsensus(const std::vector<std::string>& reads, AlignMode mode,
                                              int minCoverage = -INT_MAX);
 
+    /// \brief The consensus of each of many independent read sets
+    ///        (e.g., ZMWs or windows), computed on numThreads threads.
+    ///
+    /// Results are in the order of the read sets, and are as
+    /// FindConsensus would give them one at a time.  The caller owns
+    /// them.
+    static std::vector<const PoaConsensus*> FindConsensusBatch(
+        const std::vector<std::vector<std::string> >& readSets, const AlignConfig& config,
+        int minCoverage = -INT_MAX, int numThreads = 1);
+
+    static std::vector<const PoaConsensus*> FindConsensusBatch(
+        const std::vector<std::vector<std::string> >& readSets, AlignMode mode,
+        int minCoverage = -INT_MAX, int numThreads = 1);
+
+    /// \brief The consensus of many reads, found by dividing them into
+    ///        numGroups groups, finding the consensus of each group on
+    ///        numThreads threads, and merging those.
+    ///
+    /// Read k goes to group k % numGroups, and each group's consensus
+    /// is merged (PoaGraph::MergeConsensus) into the final graph,
+    /// weighted by the group's reads; the final graph's consensus is
+    /// returned.  Each graph holds a group's reads, not all of them,
+    /// so it stays smaller.  Where the groups disagree, the consensus
+    /// may differ from FindConsensus's.  minCoverage is scaled to each
+    /// group's share of the reads for the groups' consensi.  ReadPaths
+    /// is left empty.  With numGroups of 1 or less, or no more reads
+    /// than that, it is FindConsensus.
+    static const PoaConsensus* FindConsensusHierarchical(const std::vector<std::string>& reads,
+                                                         const AlignConfig& config,
+                                                         int minCoverage = -INT_MAX,
+                                                         int numGroups = 4, int numThreads = 1);
+
 public:
     // Additional accessors, which do things on the graph/graphImpl
     // LikelyVariants
 
+    /// \brief Read readIndex of FindConsensus, placed on the consensus
+    ///        as the graph aligned it, for handing to Quiver without
+    ///        aligning it again.
+    ///
+    /// read is the read as Quiver is to see it: on FORWARD_STRAND, the
+    /// sequence given to FindConsensus; on REVERSE_STRAND, its reverse
+    /// complement.  The template extent spans the consensus bases the
+    /// read's path shares, and the BandHint spans the rows the graph
+    /// alignment passes through in each template column, padded a
+    /// little.  Throws InvalidInputError if the read's path shares no
+    /// base with the consensus, or its length is not that of read.
+    MappedRead ToMappedRead(int readIndex, const Read& read,
+                            StrandEnum strand = FORWARD_STRAND) const;
+
 public:
     std::string ToGraphViz(int flags = 0) const;
 
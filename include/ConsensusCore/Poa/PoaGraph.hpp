@@ -45,6 +45,15 @@ public:
     PoaGraph(const detail::PoaGraphImpl& o);  // NB: this performs a copy
     ~PoaGraph();
 
+    PoaGraph& operator=(const PoaGraph& other);
+
+#ifndef SWIG
+    // Moving hands over the graph without copying it; the moved-from
+    // PoaGraph may only be assigned to or destroyed.
+    PoaGraph(PoaGraph&& other) noexcept;
+    PoaGraph& operator=(PoaGraph&& other) noexcept;
+#endif  // SWIG
+
     //
     // Easy API
     //
@@ -60,19 +69,127 @@ public:
     PoaAlignmentMatrix* TryAddRead(const std::string& sequence, const AlignConfig& config,
                                    detail::SdpRangeFinder* rangeFinder = NULL) const;
 
+    /// \brief Align each of many reads against the graph as it stands,
+    ///        on numThreads threads, adding none of them.
+    ///
+    /// Each read is banded as PoaConsensus::FindConsensus bands it.
+    /// The matrices are in the order of the reads, and the caller owns
+    /// them.  They all align to this graph, so once one is committed
+    /// the rest are out of date and should be tried again.
+    std::vector<PoaAlignmentMatrix*> TryAddReads(const std::vector<std::string>& sequences,
+                                                 const AlignConfig& config,
+                                                 int numThreads = 1) const;
+
     void CommitAdd(PoaAlignmentMatrix* mat, std::vector<Vertex>* readPathOutput = NULL);
 
+    /// \brief Add the consensus of another graph, standing for the
+    ///        reads that built it.
+    ///
+    /// The consensus is aligned and threaded as a read is, but each of
+    /// its bases counts as the reads through its vertex of pc.Graph,
+    /// and the whole as pc.Graph.NumReads() reads, both in NumReads()
+    /// and in the spanning counts of the vertices it spans.  The reads
+    /// of pc.Graph off its consensus add nothing.  readPathOutput gets
+    /// the vertex each consensus base was threaded to.
+    void MergeConsensus(const PoaConsensus& pc, const AlignConfig& config,
+                        detail::SdpRangeFinder* rangeFinder = NULL,
+                        std::vector<Vertex>* readPathOutput = NULL);
+
     // ----------
 
     size_t NumReads() const;
 
+    /// \brief The number of vertices, counting ^ and $
+    size_t NumVertices() const;
+
+    /// \brief Align each read (AddRead, TryAddRead) on numThreads
+    ///        threads, once the graph is large.
+    ///
+    /// A vertex's column of the alignment is made as soon as the
+    /// columns of its predecessors are, so the branches of bubbles,
+    /// and other parallel paths, are aligned at once.  Below
+    /// PARALLEL_POA_MIN_VERTICES vertices, and in TryAddReads, which
+    /// is parallel over the reads, columns are made one at a time.
+    /// The alignments are the same either way.  Copies of the graph
+    /// share its threads.  1 by default, using none.
+    void SetNumThreads(int numThreads);
+    int NumThreads() const;
+
+    /// \brief Bound the memory of the alignment of each read (AddRead,
+    ///        TryAddRead, TryAddReads) to about bytes; 0, the default,
+    ///        for no bound.
+    ///
+    /// An alignment whose full matrix would be larger is checkpointed:
+    /// its columns are made a segment of the topological order at a
+    /// time, keeping only those that later segments read, and the
+    /// dropped ones are remade, a segment at a time, as the traceback
+    /// of CommitAdd (or AddRead) reaches them.  Half the budget goes to
+    /// a segment's columns, so at least twice the bytes of a column,
+    /// (read length + 1) * 6, should be given.  A checkpointed
+    /// alignment is made one column at a time, whatever NumThreads,
+    /// and costs up to twice the time; it is the same alignment.
+    void SetMemoryBudget(size_t bytes);
+    size_t MemoryBudget() const;
+
+    /// \brief Remove the vertices that fewer than minReads reads
+    ///        pass through, except those on the consensus path found
+    ///        under config.
+    ///
+    /// Where that would leave a kept vertex without successors or
+    /// predecessors, it gets edges around the removed run, so that the
+    /// graph stays connected.  The kept vertices are renumbered
+    /// densely, which invalidates any vertex ids (read paths,
+    /// consensus paths) obtained before.  Call it once the graph has
+    /// grown past some size, to hold down the cost of aligning further
+    /// reads.  Returns the number of vertices removed.
+    ///
+    /// NB: outside GLOBAL mode a vertex is scored against the reads
+    /// spanning it since it was made, so one that a later read makes
+    /// anew, after its like was pruned, is scored leniently.  There,
+    /// prune late, or not at all.
+    size_t Prune(int minReads, const AlignConfig& config);
+
     std::string ToGraphViz(int flags = 0, const PoaConsensus* pc = NULL) const;
 
     void WriteGraphVizFile(std::string filename, int flags = 0,
                            const PoaConsensus* pc = NULL) const;
 
+    //
+    // Binary form, for checkpointing a graph part-way through a batch
+    // or handing it to another process without rebuilding it from the
+    // reads.  The form is flat and versioned: a header, then a record
+    // per vertex (base and counts), then the edges in the order they
+    // were made, so a loaded graph aligns further reads exactly as the
+    // original would.  The paths of the reads are not part of the
+    // graph, and are not saved.  Loading throws InvalidInputError on
+    // bytes that do not describe a well-formed graph, and
+    // UnsupportedFeatureError on a version or byte order it can't read.
+    //
+#ifndef SWIG
+    std::string ToBinary() const;
+
+    /// \brief The graph saved in data[0, size), which may be a
+    ///        memory-mapped file; nothing in it need be aligned.
+    static PoaGraph FromBinary(const char* data, size_t size);
+#endif  // SWIG
+
+    void WriteBinaryFile(const std::string& filename) const;
+
+    static PoaGraph ReadBinaryFile(const std::string& filename);
+
     const PoaConsensus* FindConsensus(const AlignConfig& config, int minCoverage = -INT_MAX) const;
 
+    /// \brief The consensus, as FindConsensus finds it, but handed this
+    ///        graph rather than a copy of it.  The graph is left empty.
+    const PoaConsensus* ReleaseConsensus(const AlignConfig& config,
+                                         int minCoverage = -INT_MAX);
+
+#ifndef SWIG
+    // As above, the consensus taking over readPaths as its ReadPaths
+    const PoaConsensus* ReleaseConsensus(const AlignConfig& config, int minCoverage,
+                                         std::vector<std::vector<Vertex> >&& readPaths);
+#endif  // SWIG
+
 private:
     detail::PoaGraphImpl* impl;
 };
@@ -4,7 +4,6 @@
 #include <ConsensusCore/Poa/PoaGraph.hpp>
 
 #include <cstddef>
-#include <map>
 #include <string>
 #include <utility>
 #include <vector>
@@ -28,7 +27,8 @@ using ConsensusCore::Interval;
 // enabling sparse memory usage.
 //
 // This is an abstract class that will be inherited in a client
-// library that has access to an SDP method.
+// library that has access to an SDP method; MinimizerRangeFinder,
+// below, is the one PoaConsensus uses.
 //
 // RangeFinder state goes away on next call to InitRangeFinder.  We could
 // have dealt with this using a factory pattern but bleh.
@@ -36,7 +36,13 @@ using ConsensusCore::Interval;
 class SdpRangeFinder
 {
 private:
-    std::map<PoaGraph::Vertex, Interval> alignableReadIntervalByVertex_;
+    // Indexed by vertex
+    std::vector<Interval> alignableReadIntervalByVertex_;
+
+    // scratch for InitRangeFinder, kept to save reallocating it
+    std::vector<Interval> directRanges_;
+    std::vector<bool> hasDirectRange_;
+    std::vector<Interval> revMarks_;
 
 public:
     virtual ~SdpRangeFinder();
@@ -51,5 +57,27 @@ protected:
     virtual SdpAnchorVector FindAnchors(const std::string& consensusSequence,
                                         const std::string& readSequence) const = 0;
 };
+
+//
+// The built-in SdpRangeFinder: seeds are the (w, k)-minimizers the
+// consensus and read share, and the anchors are the best-scoring
+// chain of seeds increasing in both sequences, found by sparse DP
+// over a limited lookback.  Minimizers occurring more than
+// maxOccurrences times in the consensus are ignored as repeats.
+//
+class MinimizerRangeFinder : public SdpRangeFinder
+{
+public:
+    explicit MinimizerRangeFinder(int k = 11, int w = 5, int maxOccurrences = 16);
+
+protected:
+    SdpAnchorVector FindAnchors(const std::string& consensusSequence,
+                                const std::string& readSequence) const;
+
+private:
+    int k_;
+    int w_;
+    int maxOccurrences_;
+};
 }
 }
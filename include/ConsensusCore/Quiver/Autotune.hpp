@@ -0,0 +1,138 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Read.hpp>
+
+namespace ConsensusCore {
+
+/// \brief The Viterbi QV recursors the autotuner chooses among
+enum RecursorKind
+{
+    // SimpleQvRecursor and SseQvRecursor, over dense matrices
+    DENSE_SIMPLE_RECURSOR = 0,
+    DENSE_SSE_RECURSOR = 1,
+    // SparseSimpleQvRecursor and SparseSseQvRecursor; the SSE
+    // recursors run the widest SIMD kernels the CPU supports
+    SPARSE_SIMPLE_RECURSOR = 2,
+    SPARSE_SSE_RECURSOR = 3
+};
+
+/// \brief A template, and a sample of reads mapped to it, to tune the
+///        chemistries of the reads on.
+struct AutotuneSample
+{
+    std::string Template;
+    std::vector<MappedRead> Reads;
+
+    explicit AutotuneSample(const std::string& tpl = "") : Template(tpl) {}
+};
+
+struct AutotuneOptions
+{
+    // The bands to try, as BandingOptions::ScoreDiff
+    std::vector<float> ScoreDiffs;
+    // The scores of the reads, and of single-base substitutions along
+    // them, are taken from a fill banded this loosely
+    float ReferenceScoreDiff;
+    // How far any of the sample's scores may drift from the reference
+    float ScoreTolerance;
+    // The most flip-flops per read, on average, a choice may need
+    float MaxFlipFlopRate;
+    // Each read is timed this many times, keeping the fastest
+    int Repeats;
+    // Reads beyond this many of a chemistry are left out
+    int MaxReadsPerChemistry;
+    // The dense recursors are only tried on chemistries whose reads'
+    // whole matrices each hold at most this many entries
+    int MaxDenseEntries;
+
+    AutotuneOptions()
+        : ReferenceScoreDiff(100)
+        , ScoreTolerance(0.05f)
+        , MaxFlipFlopRate(1.0f)
+        , Repeats(3)
+        , MaxReadsPerChemistry(50)
+        , MaxDenseEntries(1 << 22)
+    {
+        const float scoreDiffs[] = {6, 8, 10, 12, 14, 16, 18, 21, 25, 30};
+        ScoreDiffs.assign(scoreDiffs, scoreDiffs + sizeof(scoreDiffs) / sizeof(float));
+    }
+};
+
+/// \brief What the autotuner chose for a chemistry, and how it fared.
+struct AutotuneChoice
+{
+    // The name of the chemistry's entry in the QuiverConfigTable
+    std::string Chemistry;
+    // The chemistry's config, the options and the CPU's SIMD width, in
+    // hex; a cached choice whose fingerprint differs is stale
+    std::string Fingerprint;
+    // Whether any choice met the options; if not, the rest describe
+    // the config's own banding under SPARSE_SSE_RECURSOR, unmeasured
+    bool Tuned;
+    RecursorKind Recursor;
+    float ScoreDiff;
+    // Of the sample, under the choice: the alpha and beta entries
+    // filled per second, flip-flops per read, and the largest drift of
+    // a score from the reference
+    double CellsPerSecond;
+    float FlipFlopRate;
+    float ScoreDrift;
+
+    AutotuneChoice()
+        : Tuned(false)
+        , Recursor(SPARSE_SSE_RECURSOR)
+        , ScoreDiff(0)
+        , CellsPerSecond(0)
+        , FlipFlopRate(0)
+        , ScoreDrift(0)
+    {
+    }
+};
+
+/// \brief Choose, for each chemistry of configs that the samples have
+///        reads of, the fastest recursor and band for it.
+///
+/// Reads are taken as their chemistry's config (QuiverConfigTable::At)
+/// would be, so reads of chemistries without a config of their own tune
+/// the default.  Each of the sample's reads is filled, and scored for
+/// single-base substitutions spread along it, under each recursor and
+/// band in turn, on the calling thread.  For each recursor the tightest
+/// band is kept whose scores all stay within ScoreTolerance of the
+/// reference, whose flip-flop rate is within MaxFlipFlopRate, and that
+/// fills every read the reference does; of those, the recursor that
+/// took least time wins.
+///
+/// The recursion is always the Viterbi one, as refinement uses.
+std::vector<AutotuneChoice> Autotune(const QuiverConfigTable& configs,
+                                     const std::vector<AutotuneSample>& samples,
+                                     const AutotuneOptions& options = AutotuneOptions());
+
+/// \brief configs, with the banding of each chemistry chosen set.  The
+///        recursor, fixed by the scorer type, is for the caller to use.
+QuiverConfigTable ApplyAutotune(const QuiverConfigTable& configs,
+                                const std::vector<AutotuneChoice>& choices);
+
+/// \brief Write choices to a file, replacing it whole.  Throws
+///        InvalidInputError if the file can't be written.
+void SaveAutotuneChoices(const std::string& filename, const std::vector<AutotuneChoice>& choices);
+
+/// \brief The choices in a file that are still fresh for configs and
+///        options.  A missing or unreadable file holds none.
+std::vector<AutotuneChoice> LoadAutotuneChoices(const std::string& filename,
+                                                const QuiverConfigTable& configs,
+                                                const AutotuneOptions& options = AutotuneOptions());
+
+/// \brief The choices cached in a file, if they are fresh and cover
+///        every chemistry the samples tune; otherwise Autotune's, which
+///        are then cached in the file.
+std::vector<AutotuneChoice> AutotuneCached(const std::string& filename,
+                                           const QuiverConfigTable& configs,
+                                           const std::vector<AutotuneSample>& samples,
+                                           const AutotuneOptions& options = AutotuneOptions());
+}
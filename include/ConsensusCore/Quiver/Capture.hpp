@@ -0,0 +1,140 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+
+namespace ConsensusCore {
+
+class AbstractMultiReadMutationScorer;
+struct MappedRead;
+class Mutation;
+
+/// \brief The version of the capture files written by StartCapture;
+///        replaying any other throws.
+static const int CAPTURE_VERSION = 2;
+
+/// \brief Capture, to a file, what is done to the multi-read scorers
+///        constructed from now on, so a workload can be replayed (by
+///        ReplayCapture, or the quiver_replay tool) elsewhere.
+///
+/// Captured are each scorer's construction (its configs and template),
+/// its coverage cap, memory budget and score caching, the reads it is
+/// given, the mutations applied to it and the slides of its template,
+/// and the RefineConsensus and ConsensusQVs calls on it along with
+/// their results, so that a replay can check it reproduces them.
+/// Calls made within a captured call, such as the ApplyMutations of
+/// RefineConsensus, are not captured themselves, and nor is anything
+/// done to a scorer constructed before the capture started, or copied
+/// or restored.  Reads are kept as work units keep them, without band
+/// hints.
+///
+/// Capturing takes a lock per call captured, so is meant for recording
+/// a problem workload rather than for production.  Throws
+/// InvalidInputError if a capture is already running or the file
+/// can't be created.
+void StartCapture(const std::string& filename);
+
+/// \brief Stop capturing, and close the file.  Throws InvalidInputError
+///        if no capture is running.
+void StopCapture();
+
+/// \brief What a replay did, and how long it took.
+struct ReplayReport
+{
+    int Scorers;
+    int Reads;
+    int Refines;
+    int QvCalls;
+    // Calls whose results differ from the captured ones, and the first
+    // of them
+    int Mismatches;
+    std::string FirstMismatch;
+    double AddSeconds;
+    double RefineSeconds;
+    double QvSeconds;
+
+    ReplayReport()
+        : Scorers(0)
+        , Reads(0)
+        , Refines(0)
+        , QvCalls(0)
+        , Mismatches(0)
+        , FirstMismatch()
+        , AddSeconds(0)
+        , RefineSeconds(0)
+        , QvSeconds(0)
+    {
+    }
+};
+
+/// \brief Replay a capture, in the order captured, on sparse SSE
+///        scorers, comparing each result to the captured one.  Throws
+///        InvalidInputError if the file can't be read or is not a
+///        capture of this version.
+ReplayReport ReplayCapture(const std::string& filename);
+
+#ifndef SWIG
+namespace detail {
+
+extern std::atomic<bool> capturing;
+
+// Whether a call now is to be captured: a capture is running, and the
+// call is not made within a captured one
+bool CaptureThisCall();
+
+// Marks the calls made within its scope as made within a captured one
+class NestedInCapture
+{
+public:
+    NestedInCapture();
+    ~NestedInCapture();
+
+private:
+    NestedInCapture(const NestedInCapture&);
+    NestedInCapture& operator=(const NestedInCapture&);
+};
+
+// Record a call on a scorer; all but the construction are dropped for
+// a scorer that was not captured from its construction
+void CaptureScorer(const AbstractMultiReadMutationScorer* mms, const QuiverConfigTable& configs,
+                   const std::string& tpl);
+void CaptureDestruction(const AbstractMultiReadMutationScorer* mms);
+
+enum CapturedSetting
+{
+    COVERAGE_CAP_SETTING = 0,
+    MEMORY_BUDGET_SETTING = 1,
+    SCORE_CACHING_SETTING = 2
+};
+
+void CaptureSetting(const AbstractMultiReadMutationScorer* mms, CapturedSetting setting,
+                    int64_t value);
+void CaptureAddRead(const AbstractMultiReadMutationScorer* mms, const MappedRead& mr,
+                    float threshold, bool added);
+void CaptureAddReads(const AbstractMultiReadMutationScorer* mms,
+                     const std::vector<MappedRead>& reads, int added);
+void CaptureApplyMutations(const AbstractMultiReadMutationScorer* mms,
+                           const std::vector<Mutation>& mutations);
+void CaptureSlideTemplate(const AbstractMultiReadMutationScorer* mms, int trimLength,
+                          const std::string& extension);
+void CaptureRefine(const AbstractMultiReadMutationScorer* mms, const RefineOptions& options,
+                   bool converged, const std::string& result);
+void CaptureQVs(const AbstractMultiReadMutationScorer* mms, int beginPos, int endPos,
+                const std::vector<int>& qvs);
+}
+
+// Evaluates to whether a call is to be captured, at the cost of one
+// relaxed load when no capture is running
+#define CAPTURE_THIS_CALL()                                                \
+    (::ConsensusCore::detail::capturing.load(std::memory_order_relaxed) && \
+     ::ConsensusCore::detail::CaptureThisCall())
+#endif  // SWIG
+}
@@ -0,0 +1,61 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Align/PairwiseAlignment.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+
+namespace ConsensusCore {
+
+/// \brief A read-to-template alignment as read out of an alpha matrix,
+///        held as runs of moves.
+///
+/// An alignment of a thousand-base read takes a few dozen runs, where
+/// a PairwiseAlignment takes three gapped strings.  The gapped strings
+/// are only built, from the template and read, when asked for.  A
+/// default-constructed CompactAlignment is empty, as for a read that
+/// could not be aligned.
+class CompactAlignment
+{
+public:
+    CompactAlignment();
+
+    // Append a run of moves; runs of the same move are joined
+    void Append(Move move, int count = 1);
+
+    // Put the runs in the opposite order, for tracebacks, which
+    // read the moves out last to first
+    void Reverse();
+
+    bool Empty() const { return runs_.empty(); }
+    int NumRuns() const { return runs_.size(); }
+    Move RunMove(int run) const;
+    int RunLength(int run) const;
+
+    // The read bases and template bases the moves span
+    int ReadLength() const;
+    int TemplateLength() const;
+
+    // As a CIGAR string, with a merge written as a deletion followed
+    // by a match (as in the gapped strings), e.g. "5M1D1M2I"
+    std::string Cigar() const;
+
+    // The gapped template and read, for the template and read aligned
+    std::string Target(const std::string& tpl) const;
+    std::string Query(const std::string& read) const;
+
+    // The alignment as a PairwiseAlignment; the caller owns it
+    PairwiseAlignment* ToPairwiseAlignment(const std::string& tpl,
+                                           const std::string& read) const;
+
+private:
+    // Each run is its length, times four, plus its move type's index
+    // in INCORPORATE, EXTRA, DELETE, MERGE
+    std::vector<uint32_t> runs_;
+};
+}
@@ -0,0 +1,153 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+#include <climits>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Align/AlignConfig.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+#include <ConsensusCore/Read.hpp>
+
+namespace ConsensusCore {
+
+namespace detail {
+class ConsensusPipelineImpl;
+}
+
+/// \brief A window of reads to find the consensus of: each read as
+///        sequenced, with the strand of the window it lies on.
+struct ConsensusWindow
+{
+    int Id;
+    std::vector<Read> Reads;
+    std::vector<StrandEnum> Strands;
+
+    explicit ConsensusWindow(int id = 0) : Id(id) {}
+
+    void AddRead(const Read& read, StrandEnum strand = FORWARD_STRAND)
+    {
+        Reads.push_back(read);
+        Strands.push_back(strand);
+    }
+};
+
+/// \brief The consensus of a window, and its QVs.
+///
+/// If the window failed, Error says why and the rest is empty.
+struct ConsensusResult
+{
+    int Id;
+    std::string Sequence;
+    std::vector<int> QVs;
+    bool Converged;
+    int NumReads;  // the reads Quiver took
+    std::string Error;
+
+    ConsensusResult() : Id(0), Converged(false), NumReads(0) {}
+};
+
+struct ConsensusPipelineOptions
+{
+    // The workers that find the POA consensus and place the reads on
+    // it, that refine the consensus, and that compute its QVs
+    int PoaWorkers;
+    int RefineWorkers;
+    int QvWorkers;
+    // The windows each queue holds before whatever feeds it blocks
+    int QueueCapacity;
+    AlignMode PoaMode;
+    int PoaMinCoverage;
+    RefineOptions Refine;
+    // Refine dinucleotide repeats of at least this many elements, if
+    // positive
+    int MinDinucleotideRepeatElements;
+    // Hibernate the scorer of a window waiting on the next stage
+    // whenever the process holds more than this many bytes (see
+    // ProcessMemoryUsage), if positive
+    int64_t HibernateAboveBytes;
+    // Pin the workers of each stage to the NUMA nodes in turn, and keep
+    // each window to the node it was placed on (see below)
+    bool PinToNumaNodes;
+};
+
+static const ConsensusPipelineOptions DefaultConsensusPipelineOptions = {
+    1,                     // PoaWorkers
+    1,                     // RefineWorkers
+    1,                     // QvWorkers
+    4,                     // QueueCapacity
+    GLOBAL,                // PoaMode
+    -INT_MAX,              // PoaMinCoverage
+    DefaultRefineOptions,  // Refine
+    3,                     // MinDinucleotideRepeatElements
+    0,                     // HibernateAboveBytes
+    false                  // PinToNumaNodes
+};
+
+/// \brief Finds the consensus of a stream of windows, natively, from
+///        POA through Quiver refinement to the consensus QVs.
+///
+/// Each window goes through three stages, each run by its own workers
+/// and fed by a queue of at most QueueCapacity windows:
+///  - its POA consensus is found, and its reads placed on it
+///    (PoaConsensus::ToMappedRead) in a Quiver scorer;
+///  - the consensus is refined (RefineConsensus, then
+///    RefineDinucleotideRepeats);
+///  - its QVs are computed (ConsensusQVs).
+/// Results stream out, through a queue of the same bound, in the order
+/// the windows finish, which is not that they were submitted in once
+/// there is more than one worker to a stage.  A stage that gets ahead
+/// of the next blocks on the queue between them, and Submit blocks
+/// once the first is full, so that at most a few windows per queue are
+/// ever in flight.  Results must therefore be taken (Next) as windows
+/// are submitted, from another thread if need be.  Under memory
+/// pressure (HibernateAboveBytes), the scorers of windows queued
+/// between stages hibernate, to be woken by the next stage.
+///
+/// With PinToNumaNodes, the i-th worker of each stage is pinned to node
+/// i mod N, N being the least of the number of NUMA nodes and of the
+/// workers of any stage, and the stages pass each window on through
+/// queues of their own per node.  A window's matrices, filled by the
+/// worker that placed it, are then refined and scored on their own
+/// node, as are those of any thread pool its scorer starts.
+///
+/// A window that fails, as by the POA finding no consensus, yields a
+/// result with its Error set; the pipeline carries on.  Reads that the
+/// POA consensus leaves out, or that Quiver won't take, are skipped.
+class ConsensusPipeline : private boost::noncopyable
+{
+public:
+    ConsensusPipeline(const QuiverConfigTable& configs,
+                      const ConsensusPipelineOptions& options = DefaultConsensusPipelineOptions);
+
+    /// Abandons the windows in flight.
+    ~ConsensusPipeline();
+
+    /// \brief Queue a window, blocking while the first queue is full.
+    ///        Throws InvalidInputError once the pipeline is closed.
+    void Submit(const ConsensusWindow& window);
+
+    /// \brief No more windows will be submitted.
+    void Close();
+
+    /// \brief The next result, blocking until there is one.  False once
+    ///        the pipeline is closed and every window's result taken.
+    bool Next(ConsensusResult* result);
+
+private:
+    detail::ConsensusPipelineImpl* impl_;
+};
+
+/// \brief The consensus of one window, found on the calling thread as
+///        the stages of a ConsensusPipeline would find it.  A window
+///        that fails yields a result with its Error set.
+ConsensusResult FindWindowConsensus(const QuiverConfigTable& configs,
+                                    const ConsensusWindow& window,
+                                    const ConsensusPipelineOptions& options =
+                                        DefaultConsensusPipelineOptions);
+}
@@ -24,4 +24,36 @@ struct DiploidSite
 //  (siteScores)
 // for Python by SWIG.
 DiploidSite* IsSiteHeterozygous(const float* siteScores, int dim1, int dim2, float logPriorRatio);
+
+/// \brief The sites of a batch called heterozygous, in site order.
+///
+/// Called site k is site Sites[k] of the batch, with alleles
+/// Allele0[k] and Allele1[k] and log Bayes factor LogBayesFactors[k];
+/// read i is assigned to allele AlleleForRead[k * NumReads + i] there.
+struct DiploidSiteCalls
+{
+    int NumReads;
+    std::vector<int> Sites;
+    std::vector<int> Allele0;
+    std::vector<int> Allele1;
+    std::vector<float> LogBayesFactors;
+    std::vector<int> AlleleForRead;
+
+    DiploidSiteCalls() : NumReads(0) {}
+};
+
+// Call every site of a batch, as IsSiteHeterozygous would, on
+// numThreads threads.  The scores are a row-major (sites x mutations x
+// reads) tensor, as from ScoresMany over the mutations of each site in
+// turn, so a site's scores for a mutation are contiguous over the
+// reads.  Throws InvalidInputError unless there are as many mutations
+// a site as IsSiteHeterozygous takes.
+//
+// NB: The prototype
+//  (float* siteScores, int numSites, int numMutations, int numReads)
+// gets transformed to just
+//  (siteScores)
+// for Python by SWIG.
+DiploidSiteCalls CallHeterozygousSites(const float* siteScores, int numSites, int numMutations,
+                                       int numReads, float logPriorRatio, int numThreads = 1);
 }
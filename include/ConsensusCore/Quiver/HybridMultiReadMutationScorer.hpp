@@ -0,0 +1,147 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+// How far, in nats, a mutation's Viterbi score may fall short of the
+// favorability bar and still have its sum-product score computed
+#define DEFAULT_SCREEN_TOLERANCE 2.0f
+
+namespace ConsensusCore {
+
+/// \brief A sum-product MultiReadMutationScorer that screens candidate
+///        mutations with a Viterbi one first.
+///
+/// Every read is held by both scorers.  Score, Scores, IsFavorable and
+/// their batched versions are those of the sum-product scorer.
+/// FastScore, FastIsFavorable and FastScoreMany first score a mutation
+/// with the cheaper Viterbi recursion.  A mutation whose Viterbi
+/// FastScore is no better than MIN_FAVORABLE_SCOREDIFF minus the
+/// screen tolerance is rejected with that score, which never clears
+/// the favorability bar.  The other mutations get their sum-product
+/// FastScore.  The larger the tolerance, the less likely a mutation
+/// that sum-product scoring finds favorable is screened out.
+class HybridMultiReadMutationScorer : public AbstractMultiReadMutationScorer
+{
+public:
+    HybridMultiReadMutationScorer(const QuiverConfigTable& paramsByChemistry, std::string tpl,
+                                  float screenTolerance = DEFAULT_SCREEN_TOLERANCE);
+    HybridMultiReadMutationScorer(const HybridMultiReadMutationScorer& other);
+    virtual ~HybridMultiReadMutationScorer();
+
+    // The screen tolerance, in nats; it must not be negative
+    void SetScreenTolerance(float screenTolerance);
+    float ScreenTolerance() const;
+
+    // The two tiers
+    const SparseSseQvMultiReadMutationScorer& ViterbiScorer() const;
+    const SparseSseQvSumProductMultiReadMutationScorer& SumProductScorer() const;
+
+    int TemplateLength() const;
+    int NumReads() const;
+    const MappedRead* Read(int readIndex) const;
+
+    std::string Template(StrandEnum strand = FORWARD_STRAND) const;
+    std::string Template(StrandEnum strand, int templateStart, int templateEnd) const;
+
+    void ApplyMutations(const std::vector<Mutation>& mutations);
+    uint64_t TemplateVersion() const;
+    uint64_t TemplateFingerprint() const;
+
+    // A read is active if the sum-product scorer takes it
+    bool AddRead(const MappedRead& mappedRead, float threshold);
+    bool AddRead(const MappedRead& mappedRead);
+
+    float Score(const Mutation& m) const;
+    float FastScore(const Mutation& m) const;
+
+    std::vector<float> Scores(const Mutation& m, float unscoredValue) const;
+    std::vector<float> Scores(const Mutation& m) const { return Scores(m, 0.0f); }
+
+    bool IsFavorable(const Mutation& m) const;
+    bool FastIsFavorable(const Mutation& m) const;
+
+    std::vector<float> ScoreMany(const std::vector<Mutation>& mutations) const;
+    std::vector<float> FastScoreMany(const std::vector<Mutation>& mutations) const;
+    std::vector<float> ScoresMany(const std::vector<Mutation>& mutations,
+                                  float unscoredValue) const;
+    std::vector<float> ScoresMany(const std::vector<Mutation>& mutations) const
+    {
+        return ScoresMany(mutations, 0.0f);
+    }
+#if !defined(SWIG) || defined(SWIGPYTHON)
+    void ScoresManyInto(const std::vector<Mutation>& mutations, float unscoredValue,
+                        float* scores, int nMutations, int nReads) const;
+#endif
+
+    // Matrix entries are summed over the two tiers; the matrices,
+    // flip-flops and fill statistics are the sum-product scorer's
+    std::vector<int> AllocatedMatrixEntries() const;
+    std::vector<int> UsedMatrixEntries() const;
+    MemoryUsage Memory() const;
+    const AbstractMatrix* AlphaMatrix(int i) const;
+    const AbstractMatrix* BetaMatrix(int i) const;
+    std::vector<int> NumFlipFlops() const;
+    std::vector<FillStatistics> FillStats() const;
+
+    // The Viterbi scorer's
+    std::vector<CompactAlignment> Alignments() const;
+
+    // The thread pool, and the budget, cap and caching options, apply
+    // to each tier; the dropped and standby reads reported are the
+    // sum-product scorer's
+    void SetNumThreads(int numThreads);
+    int NumThreads() const;
+#ifndef SWIG
+    void SetThreadPool(const boost::shared_ptr<ThreadPool>& pool);
+#endif
+
+    void SetMemoryBudget(int64_t bytes);
+    int64_t MemoryBudget() const;
+    std::vector<int> DroppedReads() const;
+
+    void SetCoverageCap(int maxCoverage);
+    int CoverageCap() const;
+    int AddReads(const std::vector<MappedRead>& mappedReads);
+    std::vector<int> StandbyReads() const;
+
+    void SetScoreCaching(bool cacheScores);
+    bool ScoreCaching() const;
+
+    // Both tiers hibernate, and each wakes when it is next used
+    void Hibernate();
+    void Wake();
+    bool IsHibernating() const;
+
+#if !defined(SWIG) || defined(SWIGCSHARP)
+    float Score(MutationType mutationType, int position, char base) const;
+    std::vector<float> Scores(MutationType mutationType, int position, char base,
+                              float unscoredValue) const;
+    std::vector<float> Scores(MutationType mutationType, int position, char base) const
+    {
+        return Scores(mutationType, position, base, 0.0f);
+    }
+#endif
+
+    float BaselineScore() const;
+    std::vector<float> BaselineScores() const;
+
+    std::string ToString() const;
+
+private:
+    // Does the Viterbi score of a mutation pass the screen?
+    bool PassesScreen(float viterbiScore) const;
+
+private:
+    SparseSseQvMultiReadMutationScorer viterbi_;
+    SparseSseQvSumProductMultiReadMutationScorer sumProduct_;
+    float screenTolerance_;
+};
+}
@@ -0,0 +1,43 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+
+namespace ConsensusCore {
+
+/// \brief A Viterbi recursor computing the banded alpha score in
+///        16-bit fixed point.
+///
+/// Move scores are scaled by Int16ViterbiRecursor::Scale and rounded,
+/// and cells are combined with saturating SIMD arithmetic, eight rows
+/// to an SSE register---twice the lanes of the float recursors.  Only
+/// the few alpha columns the recursion reads are kept, each rebased
+/// to the best score of the column before it so the 16-bit range is
+/// never exhausted.
+///
+/// The banding follows SseRecursor's first alpha pass, so Score()
+/// matches the float Viterbi score of that pass up to rounding, at
+/// most 1/(2*Scale) per move of the best path.  With
+/// SetScoreUnheldReads, the Viterbi MultiTemplateScorer scores with it
+/// the reads it holds no matrices for; the float recursors remain the
+/// reference.
+class Int16ViterbiRecursor
+{
+public:
+    // move scores are stored as round(Scale * score)
+    static const int Scale = 128;
+
+public:
+    Int16ViterbiRecursor(int movesAvailable, const BandingOptions& banding);
+
+    /// \brief The Viterbi score of the read against the template, or
+    ///        -FLT_MAX if the band misses the end of the alignment.
+    float Score(const QvEvaluator& e) const;
+
+private:
+    int movesAvailable_;
+    BandingOptions bandingOptions_;
+};
+}
@@ -3,18 +3,29 @@
 #pragma once
 
 #include <ConsensusCore/Matrix/AbstractMatrix.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
 #include <ConsensusCore/Quiver/MutationScorer.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/ReadScorerCache.hpp>
 #include <ConsensusCore/Quiver/SseRecursor.hpp>
 #include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 #include <ConsensusCore/Types.hpp>
 
+#include <stdint.h>
+
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <functional>
 #include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+#define MIN_FAVORABLE_SCOREDIFF 0.04f  // Chosen such that 0.49 = 1 / (1 + exp(minScoreDiff))
+
 namespace ConsensusCore {
 
 class AbstractMultiReadMutationScorer
@@ -33,6 +44,13 @@ public:
 
     virtual void ApplyMutations(const std::vector<Mutation>& mutations) = 0;
 
+    // The number of times the template has been changed, and its
+    // TemplateFingerprint, kept up to date as it is changed (by
+    // ApplyMutations, in time proportional to the mutations), so that
+    // templates can be told apart without copying them
+    virtual uint64_t TemplateVersion() const = 0;
+    virtual uint64_t TemplateFingerprint() const = 0;
+
     // Reads provided must be clipped to the reference/scaffold window implied by
     // the
     // template, however they need not span the window entirely---nonspanning
@@ -56,12 +74,95 @@ public:
     virtual bool IsFavorable(const Mutation& m) const = 0;
     virtual bool FastIsFavorable(const Mutation& m) const = 0;
 
+    // Batched Score, FastScore and Scores over many mutations.
+    // ScoresMany returns a row-major (mutations x NumReads) matrix.
+    virtual std::vector<float> ScoreMany(const std::vector<Mutation>& mutations) const = 0;
+    virtual std::vector<float> FastScoreMany(const std::vector<Mutation>& mutations) const = 0;
+    virtual std::vector<float> ScoresMany(const std::vector<Mutation>& mutations,
+                                          float unscoredValue) const = 0;
+    virtual std::vector<float> ScoresMany(const std::vector<Mutation>& mutations) const = 0;
+
     // Rough estimate of memory consumption of scoring machinery
     virtual std::vector<int> AllocatedMatrixEntries() const = 0;
     virtual std::vector<int> UsedMatrixEntries() const = 0;
+    // The bytes the scorer holds, by category: its reads' matrices,
+    // their features and scorers, and its own bookkeeping, down to
+    // the padding and spare capacity of the matrix bands.  Matrices
+    // still shared with a copy of the scorer count in both.  Scratch
+    // matrices are held per thread, so count only in
+    // ProcessMemoryUsage, as do POA graphs.
+    virtual MemoryUsage Memory() const = 0;
     virtual const AbstractMatrix* AlphaMatrix(int i) const = 0;
     virtual const AbstractMatrix* BetaMatrix(int i) const = 0;
     virtual std::vector<int> NumFlipFlops() const = 0;
+    virtual std::vector<FillStatistics> FillStats() const = 0;
+
+    // Every read's Viterbi alignment to its slice of the template, in
+    // the read's orientation, read out over the thread pool; empty for
+    // reads that are not active.  For reporting on many reads, these
+    // are far smaller than PairwiseAlignments.
+    virtual std::vector<CompactAlignment> Alignments() const = 0;
+
+    // Number of threads used to score a mutation across the reads.
+    // The default (1) scores serially; results do not depend on the
+    // number of threads.
+    virtual void SetNumThreads(int numThreads) = 0;
+    virtual int NumThreads() const = 0;
+
+    // Bound, in bytes, the memory held by the reads' alpha and beta
+    // matrices; 0 (the default) sets no bound.  Whenever a read is
+    // added, or the budget set, with the total over budget, the reads
+    // costing the most memory per template base they cover are
+    // deactivated until it fits.  DroppedReads lists the reads
+    // deactivated for the budget, in the order they were dropped.
+    // Reads dropped, rejected, or lost to alpha/beta mismatches are
+    // let go of at once, matrices and all; they keep their indices,
+    // Read returning NULL for them.
+    virtual void SetMemoryBudget(int64_t bytes) = 0;
+    virtual int64_t MemoryBudget() const = 0;
+    virtual std::vector<int> DroppedReads() const = 0;
+
+    // Cap, at maxCoverage, the number of active reads covering any
+    // template base; 0 (the default) sets no cap.  A read added where
+    // every base it covers is already at the cap is kept, without a
+    // scorer, as a standby, and is activated should ApplyMutations
+    // lose reads covering its region to alpha/beta mismatches, or a
+    // raised cap leave its region short.
+    // AddReads offers reads in order of preference---spanning reads,
+    // then the longest, then those whose length best matches their
+    // template extent---and returns the number activated.  The reads'
+    // matrices are filled in batches spread over the thread pool: all
+    // at once without a cap, and otherwise in waves of the reads the cap
+    // admits were every fill of the wave to succeed, redoing the wave
+    // past the first that doesn't.  Either way the outcome is that of
+    // adding the reads one at a time, in that order.
+    // StandbyReads lists the standbys, in the order they would be
+    // activated.
+    virtual void SetCoverageCap(int maxCoverage) = 0;
+    virtual int CoverageCap() const = 0;
+    virtual int AddReads(const std::vector<MappedRead>& mappedReads) = 0;
+    virtual std::vector<int> StandbyReads() const = 0;
+
+    // Remember each read's score for the mutations scored against it,
+    // until ApplyMutations changes the read's slice of the template;
+    // refinement re-proposes many mutations, and ConsensusQVs rescores
+    // a template most of whose mutations were scored while refining.
+    // On by default; turning it off frees the remembered scores.
+    virtual void SetScoreCaching(bool cacheScores) = 0;
+    virtual bool ScoreCaching() const = 0;
+
+    // Let go of the reads' alpha and beta matrices, keeping what it
+    // takes to refill them, so that a scorer left idle---waiting on a
+    // later stage, say---holds little more than its reads.  The first
+    // call after that to score, align, save or change the template
+    // wakes the scorer, refilling the matrices over the thread pool, as
+    // Wake does; reads added meanwhile are filled as ever.  Scores
+    // after waking agree with those from before to within rounding.
+    // Matrices still shared with a copy of the scorer, or with a scorer
+    // cache, are held on to by those.
+    virtual void Hibernate() = 0;
+    virtual void Wake() = 0;
+    virtual bool IsHibernating() const = 0;
 
 #if !defined(SWIG) || defined(SWIGCSHARP)
     // Alternate entry points for C# code, not requiring zillions of object
@@ -72,6 +173,40 @@ public:
     virtual std::vector<float> Scores(MutationType mutationType, int position, char base) const = 0;
 #endif
 
+#if !defined(SWIG) || defined(SWIGPYTHON)
+    // Entry points for numpy, sparing SWIG the conversion of vectors
+    // to tuples element by element.  Scores, BaselineScores and the
+    // matrix entries go into arrays allocated with malloc, which numpy
+    // takes over; ScoresManyInto fills scores, a caller's row-major
+    // nMutations x nReads array, nMutations being mutations.size() and
+    // nReads NumReads() (else InvalidInputError).
+    void ScoresArray(const Mutation& m, float unscoredValue, float** scores, int* nScores) const;
+    void BaselineScoresArray(float** scores, int* nScores) const;
+    void AllocatedMatrixEntriesArray(int** entries, int* nEntries) const;
+    void UsedMatrixEntriesArray(int** entries, int* nEntries) const;
+    virtual void ScoresManyInto(const std::vector<Mutation>& mutations, float unscoredValue,
+                                float* scores, int nMutations, int nReads) const = 0;
+#endif
+
+    // Batched scoring for any binding, without a Mutation object made
+    // on either side of it.  Mutation i has type types[i] (a
+    // MutationType) and spans [starts[i], ends[i]) of the template;
+    // its new bases are the next baseCounts[i] of newBases.  The
+    // arrays must be of one length, and newBases of the sum of
+    // baseCounts (else InvalidInputError).  ScoreManyArrays and
+    // FastScoreManyArrays fill scores[0, nScores) as ScoreMany and
+    // FastScoreMany would, and ScoresManyArrays the row-major
+    // nMutations x nReads array as ScoresManyInto would.
+    void ScoreManyArrays(int nTypes, int* types, int nStarts, int* starts, int nEnds, int* ends,
+                         int nCounts, int* baseCounts, const std::string& newBases,
+                         float* scores, int nScores) const;
+    void FastScoreManyArrays(int nTypes, int* types, int nStarts, int* starts, int nEnds,
+                             int* ends, int nCounts, int* baseCounts,
+                             const std::string& newBases, float* scores, int nScores) const;
+    void ScoresManyArrays(int nTypes, int* types, int nStarts, int* starts, int nEnds, int* ends,
+                          int nCounts, int* baseCounts, const std::string& newBases,
+                          float unscoredValue, float* scores, int nMutations, int nReads) const;
+
     // Return the actual sum of scores for the current template.
     // TODO(dalexander): need to refactor to make the semantics of
     // the various "Score" functions clearer.
@@ -88,13 +223,20 @@ namespace detail {
 template <typename ScorerType>
 struct ReadState
 {
-    MappedRead* Read;
+    // Shared with the evaluator of the scorer (and its copies), which
+    // only reads the immutable Read part of it
+    boost::shared_ptr<MappedRead> Read;
     ScorerType* Scorer;
     bool IsActive;
+    // Score differences of the oriented mutations scored against the
+    // scorer's current template
+    mutable std::map<Mutation, float> ScoreCache;
 
     ReadState(MappedRead* read, ScorerType* scorer, bool isActive);
 
     ReadState(const ReadState& other);
+    ReadState(ReadState&& other) noexcept;
+    ReadState& operator=(ReadState&& other) noexcept;
     ~ReadState();
     void CheckInvariants() const;
     std::string ToString() const;
@@ -122,6 +264,15 @@ public:
     std::string Template(StrandEnum strand = FORWARD_STRAND) const;
     std::string Template(StrandEnum strand, int templateStart, int templateEnd) const;
     void ApplyMutations(const std::vector<Mutation>& mutations);
+    uint64_t TemplateVersion() const;
+    uint64_t TemplateFingerprint() const;
+
+    // Drop the first trimLength bases of the template, with the reads
+    // mapped to any of them, and append extension to it, as a window
+    // sliding along a longer sequence.  The reads kept are shifted, but
+    // their slices of the template are unchanged, so they keep their
+    // matrices.  Reads dropped are let go of, keeping their indices.
+    void SlideTemplate(int trimLength, const std::string& extension);
 
     // Reads provided must be clipped to the reference/scaffold window implied by
     // the
@@ -146,12 +297,86 @@ public:
     bool IsFavorable(const Mutation& m) const;
     bool FastIsFavorable(const Mutation& m) const;
 
+    // Batched versions of Score, FastScore and Scores.  The mutations
+    // are visited in template order within each read, which keeps the
+    // read's alpha/beta columns hot in cache across neighboring
+    // mutations; results are identical to calling the single mutation
+    // versions in turn.  ScoresMany returns a row-major (mutations x
+    // NumReads) matrix.
+    std::vector<float> ScoreMany(const std::vector<Mutation>& mutations) const;
+    std::vector<float> FastScoreMany(const std::vector<Mutation>& mutations) const;
+    std::vector<float> ScoresMany(const std::vector<Mutation>& mutations,
+                                  float unscoredValue) const;
+    std::vector<float> ScoresMany(const std::vector<Mutation>& mutations) const
+    {
+        return ScoresMany(mutations, 0.0f);
+    }
+#if !defined(SWIG) || defined(SWIGPYTHON)
+    void ScoresManyInto(const std::vector<Mutation>& mutations, float unscoredValue,
+                        float* scores, int nMutations, int nReads) const;
+#endif
+
     // Rough estimate of memory consumption of scoring machinery
     std::vector<int> AllocatedMatrixEntries() const;
     std::vector<int> UsedMatrixEntries() const;
+    MemoryUsage Memory() const;
     const AbstractMatrix* AlphaMatrix(int i) const;
     const AbstractMatrix* BetaMatrix(int i) const;
     std::vector<int> NumFlipFlops() const;
+    std::vector<FillStatistics> FillStats() const;
+
+    // Only for Viterbi recursors; throws InvalidInputError otherwise
+    std::vector<CompactAlignment> Alignments() const;
+
+    // Score mutations across the reads using numThreads threads (a
+    // private pool is created for numThreads > 1), or using a pool
+    // shared with other scorers.  Per-read score differences are
+    // always summed in read order, so results are identical to the
+    // serial computation.
+    void SetNumThreads(int numThreads);
+    int NumThreads() const;
+#ifndef SWIG
+    void SetThreadPool(const boost::shared_ptr<ThreadPool>& pool);
+#endif
+
+    void SetMemoryBudget(int64_t bytes);
+    int64_t MemoryBudget() const;
+    std::vector<int> DroppedReads() const;
+
+    void SetCoverageCap(int maxCoverage);
+    int CoverageCap() const;
+    int AddReads(const std::vector<MappedRead>& mappedReads);
+    std::vector<int> StandbyReads() const;
+
+    void SetScoreCaching(bool cacheScores);
+    bool ScoreCaching() const;
+
+    void Hibernate();
+    void Wake();
+    bool IsHibernating() const;
+
+#ifndef SWIG
+    // Look up each read added in the cache, and cache those filled;
+    // the cache may be shared with other scorers, of overlapping
+    // windows say, built from the same QuiverConfigTable.  NULL (the
+    // default) fills every read.
+    void SetScorerCache(const boost::shared_ptr<ReadScorerCache<ScorerType> >& cache);
+    const boost::shared_ptr<ReadScorerCache<ScorerType> >& ScorerCache() const;
+#endif
+
+    // Save the template, the live reads (encoded as a WorkUnit's are)
+    // under their indices, which are active or on standby, the settings
+    // that pick them, and the active reads' alpha and
+    // beta bands, in the sparse layout, to filename.  Restore maps the
+    // file and copies the bands straight into matrices, rather than
+    // refilling them; the reads' configs are looked up in configs
+    // anew.  Score caches and thread settings are not saved.  Scorers
+    // keeping only checkpoints of alpha and beta cannot be saved
+    // (UnsupportedFeatureError), and files of another version or byte
+    // order, or truncated, cannot be restored (InvalidInputError).
+    void Save(const std::string& filename) const;
+    static MultiReadMutationScorer<R>* Restore(const QuiverConfigTable& configs,
+                                               const std::string& filename);
 
 #if !defined(SWIG) || defined(SWIGCSHARP)
     // Alternate entry points for C# code, not requiring zillions of object
@@ -178,12 +403,172 @@ public:
 private:
     void CheckInvariants() const;
 
+    // Invoke fn(i) for each i in [begin, end), spread over the thread
+    // pool if there is one.
+    void ForEachRead(int begin, int end, const std::function<void(int)>& fn) const;
+
+    // Keep the read index up to date: IndexRead adds reads_[readIdx],
+    // RebuildReadIndex starts over after read extents have changed.
+    void IndexRead(int readIdx);
+    void RebuildReadIndex();
+
+    // Copy the sweep state of reads_[readIdx] into the flat arrays
+    void RecordRead(int readIdx);
+
+    // Does active read readIdx score m, and m as the read's scorer sees
+    // it: ReadScoresMutation and OrientedMutation, off the flat arrays
+    bool ScoresMutation(int readIdx, const Mutation& m) const;
+    Mutation OrientMutation(int readIdx, const Mutation& m) const;
+
+    // Append mr to reads_, under the next read index
+    void AppendRead(const MappedRead& mr);
+
+    // The position in reads_ of the read added as readIndex, or -1 if
+    // it has been let go
+    int LivePosition(int readIndex) const;
+
+    // Let go of the reads that are neither active nor on standby, with
+    // their scorers, closing up reads_ and the positions held in it.
+    // Called as each public mutator finishes, so that positions in
+    // reads_ hold still while it works.
+    void ReleaseDeadReads();
+
+    // A scorer for mr on the current template, or NULL if mr cannot be
+    // scored or its matrices exceed the threshold fraction of full.
+    // Taken from scorerCache_, if there is one holding it.  Filled in
+    // the read's band (ReadBanding), which, if adaptive, is widened
+    // and narrowed in turn to rescue it.
+    ScorerType* NewScorer(const boost::shared_ptr<MappedRead>& mr, float threshold) const;
+
+    // Give reads_[readIdx] a scorer and index it; returns false,
+    // leaving it inactive, if NewScorer fails.  The second form takes
+    // ownership of a scorer NewScorer has already made, or NULL.
+    bool ActivateRead(int readIdx, float threshold);
+    bool ActivateRead(int readIdx, ScorerType* scorer);
+
+    // Scorers for reads_[readIdxs[k]], made across the pool a read at a
+    // time, in order, so that the costliest should be offered first
+    std::vector<ScorerType*> NewScorers(const std::vector<int>& readIdxs) const;
+
+    // Is any template base mr covers short of coverageCap_ reads, those
+    // active and those of reads_ listed in pending?
+    bool BelowCoverageCap(const MappedRead& mr,
+                          const std::vector<int>& pending = std::vector<int>()) const;
+
+    // Add reads_[readIdx], as a standby if it is not needed below the
+    // coverage cap; returns whether it was activated.
+    bool AdmitRead(int readIdx, float threshold);
+
+    // Activate, in order, the standbys whose regions are short of the
+    // coverage cap
+    void ActivateStandbys();
+
+    // The difference the oriented mutation makes to the score of
+    // active read readIdx, remembered if score caching is on and
+    // remember is set.  Threads may score one read at once so long as
+    // none of them remembers.
+    float ScoreDelta(int readIdx, const Mutation& orientedMut, bool remember = true) const;
+
+    // Wake the scorer if it is hibernating
+    void WakeReads() const;
+
+    // The bytes held by an active read's alpha and beta matrices
+    int64_t MatrixBytes(const ReadStateType& rs) const;
+
+    // Deactivate reads, costliest per base first, until the active
+    // reads' matrices fit in memoryBudget_
+    void EnforceMemoryBudget();
+
+    // Set reads to the active reads, in ascending order, whose template
+    // extents meet the closed interval [begin, end]; they include all
+    // the reads that score a mutation within it.
+    void ReadsNear(int begin, int end, std::vector<int>* reads) const;
+
+    // Reorder reads, first to last, by how likely each is to reject a
+    // poor mutation: by rejectPriority_, then by index
+    void OrderForRejection(std::vector<int>* reads) const;
+
+    // Fill scores[0, end - begin) with the score differences caused
+    // by m for reads_[reads[k]], k in [begin, end), or unscoredValue
+    // where the read does not score m.
+    void ScoreReads(const Mutation& m, const std::vector<int>& reads, int begin, int end,
+                    float unscoredValue, float* scores) const;
+
+    // Sum of the score differences over all reads, in read order.  If
+    // fastReject is set, stops as soon as the running sum drops below
+    // fastScoreThreshold_.
+    float SumScores(const Mutation& m, bool fastReject) const;
+
+    // Engine behind the batched entry points: sums[i] receives the
+    // Score (or, with fastReject, FastScore) of mutations[i]; if
+    // scoresByRead is non-NULL it receives the per-read matrix, with
+    // unscoredValue where a read does not score a mutation.
+    void ScoreBatch(const std::vector<Mutation>& mutations, bool fastReject, float* sums,
+                    float unscoredValue, float* scoresByRead) const;
+
+    // Score mutations[order[begin, end)], which are in template order,
+    // for ScoreBatch, a block at a time.  The reads near a block are
+    // spread over the pool if parallelReads is set, and scored on the
+    // calling thread otherwise.
+    void ScoreBlocks(const std::vector<Mutation>& mutations, const std::vector<int>& order,
+                     int begin, int end, bool fastReject, bool parallelReads, float* sums,
+                     float* scoresByRead) const;
+
 private:
     QuiverConfigTable quiverConfigByChemistry_;
     float fastScoreThreshold_;
     std::string fwdTemplate_;
     std::string revTemplate_;
+    uint64_t templateVersion_;
+    uint64_t templateFingerprint_;
+
+    // The live reads---active, or on standby---in the order added, and
+    // the index each was added under, by which reads are known outside.
+    // Elsewhere in this class reads are known by position in reads_.
     std::vector<ReadStateType> reads_;
+    std::vector<int> readIndices_;
+    int numReadsAdded_;
+    boost::shared_ptr<ThreadPool> threadPool_;
+
+    // The active reads ordered by TemplateStart, their starts, and the
+    // longest extent among them: a read meeting [begin, end] starts in
+    // [begin - maxReadExtent_, end], found by binary search.
+    std::vector<int> readsByStart_;
+    std::vector<int> readStarts_;
+    int maxReadExtent_;
+
+    // Per read, the mean per base score of the read against its slice
+    // of the template, kept up to date with the index.  The fast
+    // rejection paths visit the reads that fit the template best
+    // first, as they penalize a mutation the most.
+    std::vector<float> rejectPriority_;
+
+    // Per read, what a sweep over the reads for a mutation consults
+    // before scoring it against a read: copies of the read's template
+    // extent, strand and baseline score, kept up to date with the
+    // index.  A sweep scans these flat arrays rather than chasing each
+    // read's MappedRead and scorer, and reaches into the scorer only to
+    // score.  Reads not active have an empty extent and no score.
+    std::vector<char> isActive_;
+    std::vector<char> isReverse_;
+    std::vector<int> extentStarts_;
+    std::vector<int> extentEnds_;
+    std::vector<float> baselineScores_;
+
+    int64_t memoryBudget_;
+    std::vector<int> droppedReads_;
+
+    // The standby reads, in activation order, with their AddRead
+    // thresholds
+    int coverageCap_;
+    std::vector<std::pair<int, float> > standbys_;
+
+    bool cacheScores_;
+    boost::shared_ptr<ReadScorerCache<ScorerType> > scorerCache_;
+
+    // Set by Hibernate; the reads' scorers are woken together, by the
+    // first call that needs their matrices
+    mutable bool hibernating_;
 };
 
 typedef MultiReadMutationScorer<SparseSseQvRecursor> SparseSseQvMultiReadMutationScorer;
@@ -0,0 +1,135 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
+
+namespace ConsensusCore {
+
+/// \brief Scores one set of reads against several candidate templates
+///        at once: the haplotypes of a locus, say, or the amplicons of
+///        a multiplexed run.
+///
+/// Each read is held once, and the move scores its evaluator
+/// precomputes from its features are shared by its scorers for every
+/// template, which keep only their own banded alpha and beta.  Reads
+/// span every template; of a MappedRead, only the strand and pinning
+/// are used.  A read whose fill against a template fails (by an
+/// alpha/beta mismatch, or its chemistry's AddThreshold) is kept, but
+/// unscored against that template.  With SetScoreUnheldReads, though,
+/// a read whose matrices would be over the AddThreshold still has its
+/// likelihood, computed a few columns at a time: by the
+/// ScaledSumProductRecursor under sum-product scoring, and under
+/// Viterbi by the Int16ViterbiRecursor, to within its rounding.  It
+/// then counts in Scores and AssignReads, but not in the scores of
+/// mutations, which need the matrices.
+///
+/// The fills of AddReads and ApplyMutations, and the mutations of
+/// ScoreMany, are spread over a thread pool of NumThreads threads
+/// (1 by default, using none).
+template <typename R>
+class MultiTemplateScorer : private boost::noncopyable
+{
+public:
+    typedef R RecursorType;
+    typedef typename R::EvaluatorType EvaluatorType;
+    typedef MutationScorer<R> ScorerType;
+
+public:
+    MultiTemplateScorer(const QuiverConfigTable& configs,
+                        const std::vector<std::string>& templates);
+    ~MultiTemplateScorer();
+
+    int NumTemplates() const;
+    std::string Template(int templateIdx) const;
+
+    int NumReads() const;
+    const MappedRead* Read(int readIdx) const;
+
+    void SetNumThreads(int numThreads);
+    int NumThreads() const;
+
+    // Whether the fills that follow score the reads over the
+    // AddThreshold without their matrices (off by default)
+    void SetScoreUnheldReads(bool scoreUnheldReads);
+    bool ScoreUnheldReads() const;
+
+    // Add reads, filling them against every template; AddRead returns
+    // the number of templates the read is scored against, with or
+    // without matrices
+    int AddRead(const MappedRead& mr);
+    void AddReads(const std::vector<MappedRead>& reads);
+
+    // The log-likelihood of each read under each template, as a
+    // row-major (NumReads x NumTemplates) matrix, with unscoredValue
+    // for the pairs whose fills failed
+    std::vector<float> Scores(float unscoredValue) const;
+    // Of one read, under each template
+    std::vector<float> ReadScores(int readIdx, float unscoredValue) const;
+
+    // The template each read is likeliest under, if it is so by at
+    // least minMargin over every other template it is scored against;
+    // -1 otherwise, and for reads scored against no template
+    std::vector<int> AssignReads(float minMargin = 0) const;
+
+    // The change a mutation of a template makes to the summed
+    // log-likelihood of the given reads (all of them, if none are
+    // given) under it
+    float Score(int templateIdx, const Mutation& m) const;
+    float Score(int templateIdx, const Mutation& m, const std::vector<int>& reads) const;
+    std::vector<float> ScoreMany(int templateIdx, const std::vector<Mutation>& mutations,
+                                 const std::vector<int>& reads) const;
+
+    // Mutate a template, refilling each read against the new one
+    void ApplyMutations(int templateIdx, const std::vector<Mutation>& mutations);
+
+    // The alpha and beta entries allocated, over all reads and templates
+    int64_t AllocatedMatrixEntries() const;
+
+private:
+    void CheckTemplateIdx(int templateIdx) const;
+    // Make, or remake, the scorers of reads_[r] for templates[t] of
+    // each (r, t) pair, across the pool
+    void Fill(const std::vector<std::pair<int, int> >& pairs);
+    void ForEach(int n, const std::function<void(int)>& fn) const;
+    // The mutation as it applies to the read's strand of the template
+    Mutation Oriented(int templateIdx, const MappedRead& mr, const Mutation& m) const;
+    // Whether reads_[r] has a likelihood under templates[t]
+    bool IsScored(int readIdx, int templateIdx) const;
+
+private:
+    struct ReadEntry
+    {
+        boost::shared_ptr<const MappedRead> Read;
+        // Holds the precomputed move scores its copies share
+        boost::shared_ptr<EvaluatorType> Evaluator;
+        std::vector<ScorerType*> Scorers;
+        // The likelihoods of those templates the read has no scorer
+        // for, where known without matrices; -FLT_MAX otherwise
+        std::vector<float> ColumnScores;
+    };
+
+    QuiverConfigTable configs_;
+    std::vector<std::string> fwdTemplates_;
+    std::vector<std::string> revTemplates_;
+    std::vector<ReadEntry> reads_;
+    boost::shared_ptr<ThreadPool> threadPool_;
+    bool scoreUnheldReads_;
+};
+
+typedef MultiTemplateScorer<SparseSseQvRecursor> SparseSseQvMultiTemplateScorer;
+typedef MultiTemplateScorer<SparseSseQvSumProductRecursor> SparseSseQvSumProductMultiTemplateScorer;
+}
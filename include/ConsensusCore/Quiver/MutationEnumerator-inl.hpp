@@ -2,9 +2,114 @@
 
 #include <algorithm>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace ConsensusCore {
+namespace detail {
+inline int BoundPosition(const std::string& tpl, int pos)
+{
+    return pos < 0 ? 0 : (pos > static_cast<int>(tpl.length()) ? tpl.length() : pos);
+}
+}  // detail
+
+template <typename F>
+void AllSingleBaseMutationEnumerator::ForEachMutation(F f) const
+{
+    ForEachMutation(0, tpl_.length(), f);
+}
+
+template <typename F>
+void AllSingleBaseMutationEnumerator::ForEachMutation(int beginPos, int endPos, F f) const
+{
+    const char bases[] = {'A', 'C', 'G', 'T'};
+    beginPos = detail::BoundPosition(tpl_, beginPos);
+    endPos = detail::BoundPosition(tpl_, endPos);
+    for (int pos = beginPos; pos < endPos; pos++) {
+        for (char base : bases) {
+            if (base != tpl_[pos]) {
+                f(Mutation(SUBSTITUTION, pos, base));
+            }
+        }
+        for (char base : bases) {
+            f(Mutation(INSERTION, pos, base));
+        }
+        f(Mutation(DELETION, pos, '-'));
+    }
+}
+
+template <typename F>
+void UniqueSingleBaseMutationEnumerator::ForEachMutation(F f) const
+{
+    ForEachMutation(0, tpl_.length(), f);
+}
+
+template <typename F>
+void UniqueSingleBaseMutationEnumerator::ForEachMutation(int beginPos, int endPos, F f) const
+{
+    const char bases[] = {'A', 'C', 'G', 'T'};
+    beginPos = detail::BoundPosition(tpl_, beginPos);
+    endPos = detail::BoundPosition(tpl_, endPos);
+    for (int pos = beginPos; pos < endPos; pos++) {
+        char prevTplBase = pos > 0 ? tpl_[pos - 1] : '-';
+        for (char base : bases) {
+            if (base != tpl_[pos]) {
+                f(Mutation(SUBSTITUTION, pos, base));
+            }
+        }
+        // Insertions only allowed at the beginning of homopolymers
+        for (char base : bases) {
+            if (base != prevTplBase) {
+                f(Mutation(INSERTION, pos, base));
+            }
+        }
+        // Deletions only allowed at the beginning of homopolymers
+        if (tpl_[pos] != prevTplBase) {
+            f(Mutation(DELETION, pos, '-'));
+        }
+    }
+}
+
+template <typename F>
+void TandemRepeatMutationEnumerator::ForEachMutation(F f) const
+{
+    ForEachMutation(0, tpl_.length(), f);
+}
+
+template <typename F>
+void TandemRepeatMutationEnumerator::ForEachMutation(int beginPos, int endPos, F f) const
+{
+    if (minElements_ <= 0) return;
+    index_.ForEachRepeat(unitLength_, beginPos, endPos, [&](const TandemRepeat& r) {
+        if (r.Elements() >= minElements_) {
+            f(Mutation(INSERTION, r.Start, r.Start, tpl_.data() + r.Start, unitLength_));
+            f(Mutation(DELETION, r.Start, r.Start + unitLength_, tpl_.data(), 0));
+        }
+    });
+}
+
+inline const std::string& TandemRepeatMutationEnumerator::Template() const { return tpl_; }
+
+template <typename F>
+void PileupMutationEnumerator::ForEachMutation(F f) const
+{
+    for (const Mutation& m : mutations_) {
+        f(m);
+    }
+}
+
+template <typename F>
+void PileupMutationEnumerator::ForEachMutation(int beginPos, int endPos, F f) const
+{
+    std::vector<Mutation>::const_iterator it = std::lower_bound(
+        mutations_.begin(), mutations_.end(), beginPos,
+        [](const Mutation& m, int pos) { return m.Start() < pos; });
+    for (; it != mutations_.end() && it->Start() < endPos; ++it) {
+        f(*it);
+    }
+}
+
 ///
 /// Enumerate all mutations within a neighborhood of another set of
 /// mutations of interest.  Note that the neighborhoods are presently
@@ -22,8 +127,7 @@ std::vector<Mutation> UniqueNearbyMutations(const T& mutationEnumerator,
         int l = c - neighborhoodSize;
         // FIXME: r should probably be +1 to be symmetric
         int r = c + neighborhoodSize;
-        std::vector<Mutation> mutsInRange = mutationEnumerator.Mutations(l, r);
-        muts.insert(mutsInRange.begin(), mutsInRange.end());
+        mutationEnumerator.ForEachMutation(l, r, [&](const Mutation& m) { muts.insert(m); });
     }
     std::vector<Mutation> result;
     std::copy(muts.begin(), muts.end(), back_inserter(result));
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/TandemRepeatIndex.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
@@ -10,7 +11,16 @@
 #include <vector>
 
 namespace ConsensusCore {
+class AbstractMultiReadMutationScorer;
+
 namespace detail {
+//
+// Enumerators list their mutations either as a vector, with Mutations,
+// or one at a time to a callback f(const Mutation&), with
+// ForEachMutation, which makes no vector and so lets the mutations go
+// straight to whatever consumes them.  Both visit the same mutations in
+// the same order.
+//
 struct AbstractMutationEnumerator
 {
     explicit AbstractMutationEnumerator(const std::string& tpl);
@@ -20,7 +30,7 @@ struct AbstractMutationEnumerator
     virtual std::vector<Mutation> Mutations(int beginPos, int endPos) const = 0;
 
 protected:
-    const std::string tpl_;
+    std::string tpl_;
 };
 }  // detail
 
@@ -30,6 +40,13 @@ struct AllSingleBaseMutationEnumerator : detail::AbstractMutationEnumerator
 
     std::vector<Mutation> Mutations() const;
     std::vector<Mutation> Mutations(int beginPos, int endPos) const;
+
+#ifndef SWIG
+    template <typename F>
+    void ForEachMutation(F f) const;
+    template <typename F>
+    void ForEachMutation(int beginPos, int endPos, F f) const;
+#endif  // SWIG
 };
 
 struct UniqueSingleBaseMutationEnumerator : detail::AbstractMutationEnumerator
@@ -38,17 +55,86 @@ struct UniqueSingleBaseMutationEnumerator : detail::AbstractMutationEnumerator
 
     std::vector<Mutation> Mutations() const;
     std::vector<Mutation> Mutations(int beginPos, int endPos) const;
+
+#ifndef SWIG
+    template <typename F>
+    void ForEachMutation(F f) const;
+    template <typename F>
+    void ForEachMutation(int beginPos, int endPos, F f) const;
+#endif  // SWIG
+};
+
+/// \brief The lengthening and shortening by one unit of each tandem
+///        repeat of unitLength bases and at least minElements units.
+///
+/// The repeats are looked up in a TandemRepeatIndex, so listing those
+/// in a range takes time in the number of them, and ApplyMutations
+/// brings the enumerator up to date with a mutated template without
+/// rescanning all of it.  Mutations(beginPos, endPos) lists the
+/// mutations of the repeats that start in [beginPos, endPos).
+struct TandemRepeatMutationEnumerator : detail::AbstractMutationEnumerator
+{
+    TandemRepeatMutationEnumerator(const std::string& tpl, int unitLength, int minElements = 3);
+
+    std::vector<Mutation> Mutations() const;
+    std::vector<Mutation> Mutations(int beginPos, int endPos) const;
+
+#ifndef SWIG
+    template <typename F>
+    void ForEachMutation(F f) const;
+    template <typename F>
+    void ForEachMutation(int beginPos, int endPos, F f) const;
+#endif  // SWIG
+
+    /// \brief Apply the mutations, which must not overlap, to the
+    ///        template.
+    void ApplyMutations(const std::vector<Mutation>& mutations);
+
+    const std::string& Template() const;
+
+private:
+    int unitLength_;
+    int minElements_;
+    TandemRepeatIndex index_;
 };
 
-struct DinucleotideRepeatMutationEnumerator : detail::AbstractMutationEnumerator
+struct DinucleotideRepeatMutationEnumerator : TandemRepeatMutationEnumerator
 {
     DinucleotideRepeatMutationEnumerator(const std::string& tpl, int minDinucRepeatElements = 3);
+};
+
+/// \brief The mutations the reads' alignments to the template call
+///        for, rather than every mutation there is.
+///
+/// A pileup is made of the Viterbi alignments of the reads of a
+/// scorer, and a mutation is proposed where at least minSupport reads
+/// (or every aligned read, if there are fewer) show it.  A gap within
+/// a homopolymer counts as the gap at its start, as in
+/// UniqueSingleBaseMutationEnumerator, whose mutations these are a
+/// subset of.  Every homopolymer of two or more bases also gets its
+/// one-base lengthening and shortening proposed, supported or not.
+/// The template and the alignments are those of the scorer when the
+/// enumerator is made.  Alignments need a Viterbi (or hybrid) scorer;
+/// see AbstractMultiReadMutationScorer::Alignments.
+struct PileupMutationEnumerator : detail::AbstractMutationEnumerator
+{
+    explicit PileupMutationEnumerator(const AbstractMultiReadMutationScorer& mms,
+                                      int minSupport = 2);
 
     std::vector<Mutation> Mutations() const;
     std::vector<Mutation> Mutations(int beginPos, int endPos) const;
 
+#ifndef SWIG
+    template <typename F>
+    void ForEachMutation(F f) const;
+    template <typename F>
+    void ForEachMutation(int beginPos, int endPos, F f) const;
+#endif  // SWIG
+
 private:
-    int minDinucRepeatElements_;
+    // in template order, and at each position in the order of
+    // UniqueSingleBaseMutationEnumerator
+    std::vector<Mutation> mutations_;
 };
 
 template <typename T>
@@ -2,17 +2,35 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <atomic>
 #include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <functional>
 #include <string>
+#include <vector>
 
 // TODO(dalexander): how can we remove this include??
 //  We should move all template instantiations out to another
 //  header, I presume.
+#include <ConsensusCore/Interval.hpp>
+#include <ConsensusCore/Matrix/MatrixPool.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
 #include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Quiver/SimpleRecursor.hpp>
 #include <ConsensusCore/Quiver/SseRecursor.hpp>
 #include <ConsensusCore/Types.hpp>
 
+// The least checkpoint interval: two columns of every interval are
+// kept, and at least one refilled
+#define MIN_CHECKPOINT_INTERVAL 3
+
+// The copies of its evaluator a scorer keeps for ScoreMutation to
+// mutate; more threads than this scoring one scorer at once make
+// copies of their own as they go
+#define SCRATCH_EVALUATORS 4
+
 namespace ConsensusCore {
 template <typename R>
 class MutationScorer
@@ -23,7 +41,31 @@ public:
     typedef R RecursorType;
 
 public:
-    MutationScorer(const EvaluatorType& evaluator, const R& recursor);
+    // With a checkpointInterval k of 0, alpha and beta are kept whole.
+    // Otherwise only the last two columns of every k are kept, which
+    // cuts the memory of a long template's matrices about k/2-fold;
+    // ScoreMutation refills the columns it needs from the nearest of
+    // these checkpoints, caching the latest refills on the calling
+    // thread.  A refilled column spans the rows it spanned as first
+    // filled, so scores agree with those of a scorer keeping alpha and
+    // beta whole, to within rounding.  Checkpointing needs sparse
+    // matrices, and k of at least MIN_CHECKPOINT_INTERVAL.
+    //
+    // A bandHint, if given, has the rows of the read a prior alignment
+    // passes through in each template column (see MappedRead::BandHint),
+    // and bands the first fill of alpha to at least those.
+    MutationScorer(const EvaluatorType& evaluator, const R& recursor, int checkpointInterval = 0,
+                   const std::vector<Interval>& bandHint = std::vector<Interval>());
+
+#ifndef SWIG
+    // Rather than filling alpha and beta, have restore(alpha, beta)
+    // write them as a fill of the evaluator by the recursor would (from
+    // a saved scorer, say); fillStats describes that fill.  They are
+    // then kept, or checkpointed, as the fill's would be.
+    MutationScorer(const EvaluatorType& evaluator, const R& recursor,
+                   const std::function<void(MatrixType*, MatrixType*)>& restore,
+                   const FillStatistics& fillStats, int checkpointInterval = 0);
+#endif  // SWIG
 
     MutationScorer(const MutationScorer& other);
     virtual ~MutationScorer();
@@ -31,25 +73,111 @@ public:
 public:
     std::string Template() const;
     void Template(std::string tpl);
+    // Change the template to buffer[start, start + length).  The
+    // refill of alpha is banded to at least the rows its old columns
+    // spanned, each moved to the column of the new template columnMap
+    // gives it (one per column of the old matrices, as
+    // TargetToQueryPositions of the edit has them); without a map, the
+    // columns between the ends the edit left alone are taken to stay
+    // put.
+    void Template(const std::string& buffer, int start, int length,
+                  const std::vector<int>& columnMap = std::vector<int>());
 
     float Score() const;
+
+    // The score with m applied to the template.  It reads the scorer
+    // without changing it, applying m to a copy of the evaluator of
+    // its own, so threads may score mutations on one scorer at once
+    // (but not while its template changes, or it hibernates or wakes).
     float ScoreMutation(const Mutation& m) const;
 
+    int CheckpointInterval() const { return checkpointInterval_; }
+
+    // Let go of alpha and beta, keeping only the rows each of their
+    // columns spans, and the score.  A hibernating scorer cannot score
+    // mutations or be aligned until woken; Wake refills alpha and beta
+    // within those rows, so that scores agree with those from before,
+    // to within rounding.  Changing the template wakes the scorer.
+    void Hibernate();
+    void Wake();
+    bool IsHibernating() const { return !alpha_; }
+
 public:
-    // Accessors that are handy for debugging.
+    // Accessors that are handy for debugging.  With checkpointing,
+    // alpha and beta hold just the checkpoints: their columns 2b - 2
+    // and 2b - 1 are columns bk - 2 and bk - 1 of the whole matrices.
+    // NULL while hibernating.
     const MatrixType* Alpha() const;
     const MatrixType* Beta() const;
     const PairwiseAlignment* Alignment() const;
+    // The alignment as runs of moves, read out without building the
+    // gapped strings
+    CompactAlignment Traceback() const;
     const EvaluatorType* Evaluator() const;
-    int NumFlipFlops() const { return numFlipFlops_; }
+    int NumFlipFlops() const { return fillStats_.FlipFlops; }
+    // What the last fill of alpha and beta from scratch did
+    const FillStatistics& FillStats() const { return fillStats_; }
+    // Add what the scorer holds to usage: alpha and beta (shared with
+    // copies of the scorer until their templates change) as matrices,
+    // the evaluator's precomputed arrays as features, and the rest as
+    // scorer bookkeeping
+    void AddMemoryUsage(MemoryUsage* usage) const;
 
 private:
+    // alpha and beta are drawn from, and returned to, the calling
+    // thread's pool.  ScoreMutation extends into scratch space of the
+    // calling thread's own, so that scratch memory scales with the
+    // threads scoring rather than with the scorers.
+    typedef MatrixPool<MatrixType> Pool;
+
+    // A matrix from the pool, handed back when its last owner lets go
+    static boost::shared_ptr<const MatrixType> Shared(MatrixType* m);
+
+    // Fill alpha and beta from scratch, and keep them; the first fill
+    // of alpha is banded to at least bandHint, if given
+    void Fill(const std::vector<Interval>* bandHint = NULL);
+    // Keep filled alpha and beta, or just their checkpoints
+    void Keep(const boost::shared_ptr<const MatrixType>& alpha,
+              const boost::shared_ptr<const MatrixType>& beta);
+
+    // A matrix holding alpha, or beta, columns [beginColumn, endColumn]
+    // for the current template: alpha_ or beta_ itself, or else the
+    // columns refilled from the checkpoints, valid until the calling
+    // thread next asks for a refill
+    const MatrixType& AlphaColumns(int beginColumn, int endColumn) const;
+    const MatrixType& BetaColumns(int beginColumn, int endColumn) const;
+
+    // The score of the template of ev, with m applied to it, by
+    // extending and linking the given alpha and beta columns
+    float ScoreMutated(EvaluatorType* ev, const Mutation& m, const MatrixType* alpha,
+                       const MatrixType* beta) const;
+
+    // Take a copy of the evaluator from scratch_, or make one if none
+    // is free, and hand it back when done
+    EvaluatorType* TakeScratchEvaluator() const;
+    void ReturnScratchEvaluator(EvaluatorType* ev) const;
+    void DeleteScratchEvaluators();
+
     EvaluatorType* evaluator_;
     R* recursor_;
-    MatrixType* alpha_;
-    MatrixType* beta_;
-    MatrixType* extendBuffer_;
-    int numFlipFlops_;
+    int checkpointInterval_;
+    // alpha and beta are never written once filled, so copies of a
+    // scorer share them until their templates change
+    boost::shared_ptr<const MatrixType> alpha_;
+    boost::shared_ptr<const MatrixType> beta_;
+    // Tells the checkpoints in alpha_ and beta_ from earlier ones, to
+    // the cache of refilled columns
+    uint64_t checkpointSerial_;
+    // The rows each column of alpha and beta spanned as filled, to
+    // band their refills; kept while checkpointing or hibernating
+    boost::shared_ptr<const std::vector<Interval> > alphaBands_;
+    boost::shared_ptr<const std::vector<Interval> > betaBands_;
+    float score_;
+    FillStatistics fillStats_;
+    // Copies of evaluator_, with its template, for ScoreMutation to
+    // mutate; a slot is NULL while its copy is taken, or before one is
+    // made.  Not shared with copies of the scorer.
+    mutable std::atomic<EvaluatorType*> scratch_[SCRATCH_EVALUATORS];
 };
 
 typedef MutationScorer<SimpleQvRecursor> SimpleQvMutationScorer;
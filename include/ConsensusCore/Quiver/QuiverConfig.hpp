@@ -2,11 +2,14 @@
 
 #pragma once
 
+#include <boost/shared_ptr.hpp>
+#include <cmath>
 #include <list>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <ConsensusCore/Features.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
@@ -26,10 +29,117 @@ enum Move
 struct BandingOptions
 {
     float ScoreDiff;
+    // Adapt ScoreDiff to each read (see ReadBanding), within
+    // [MinScoreDiff, MaxScoreDiff]; a read whose alpha and beta do
+    // not mate is refilled in a band twice as wide, and one whose
+    // matrices run past AddThreshold in a band narrowed to fit.
+    bool Adaptive;
+    float MinScoreDiff;
+    float MaxScoreDiff;
 
-    BandingOptions(int, float scoreDiff) : ScoreDiff(scoreDiff) {}
+    BandingOptions(int, float scoreDiff)
+        : ScoreDiff(scoreDiff), Adaptive(false), MinScoreDiff(scoreDiff), MaxScoreDiff(scoreDiff)
+    {
+    }
 
-    BandingOptions(int, float scoreDiff, float, float) : ScoreDiff(scoreDiff) {}
+    BandingOptions(int, float scoreDiff, float, float)
+        : ScoreDiff(scoreDiff), Adaptive(false), MinScoreDiff(scoreDiff), MaxScoreDiff(scoreDiff)
+    {
+    }
+};
+
+// The expected error rate of a typical raw read, for which an adaptive
+// band is ScoreDiff wide
+#define ADAPTIVE_BANDING_ERROR_RATE 0.15f
+
+/// \brief The banding for one read against a template of the given
+///        length: banding itself, unless it is Adaptive.
+///
+/// An adaptive ScoreDiff is scaled by the square root of the read's
+/// expected error rate---the mean, over its bases, of the error
+/// probabilities its insertion, substitution and deletion QVs
+/// give---over that of typical raw reads, ADAPTIVE_BANDING_ERROR_RATE,
+/// and widened by twice the read's relative difference in length from
+/// the template, before being clamped to [MinScoreDiff, MaxScoreDiff].
+/// Clean reads thus fill narrower bands, and noisy or indel-heavy ones
+/// the wider bands they need to mate alpha and beta.
+BandingOptions ReadBanding(const BandingOptions& banding, const QvSequenceFeatures& features,
+                           int templateLength);
+
+/// \brief How the sum-product recursion evaluates log(exp(x) + exp(y)),
+///        that is max(x, y) + log1p(exp(-|x - y|)).
+///
+/// The approximations bound the absolute error of the log1p(exp(-d))
+/// term, and so of each path join; the bounds are the
+/// LOG1P_EXP_*_MAX_ERROR of SimdMath.hpp.  The Viterbi recursion,
+/// and the Edna evaluator's, always use the exact arithmetic.
+enum LogAddMode
+{
+    // With the cephes log and exp of sse_mathfun.h
+    EXACT_LOGADD = 0,
+    // By linear interpolation in a table, to within 8e-6
+    TABLE_LOGADD = 1,
+    // By a piecewise polynomial, to within 5e-5
+    POLYNOMIAL_LOGADD = 2
+};
+
+/// \brief How a recursor mates, and keeps, its alpha and beta matrices,
+///        and the arithmetic its sum-product kernels use
+struct RecursorConfig
+{
+    // Refilling alpha and beta back and forth stops once more than
+    // this many refills have been done
+    int MaxFlipFlops;
+    // How far apart the alpha and beta scores may be and still agree
+    float AlphaBetaMismatchTolerance;
+    // The fraction of the full matrix beyond which the band is
+    // refilled, guided by the other matrix, to narrow it
+    double RebandingThreshold;
+    // How the sum-product recursion adds in log space
+    LogAddMode LogAdd;
+    // Whether FillAlphaBeta and RefillAlphaBeta, once alpha and beta
+    // agree, shrink them to the rows their bands use (see
+    // SparseMatrix::ShrinkToFit): less memory for scorers that keep
+    // them, for a copy of each band
+    bool CompactBands;
+
+    RecursorConfig(int maxFlipFlops = 5, float alphaBetaMismatchTolerance = 0.2f,
+                   double rebandingThreshold = 0.04, LogAddMode logAdd = EXACT_LOGADD,
+                   bool compactBands = false)
+        : MaxFlipFlops(maxFlipFlops)
+        , AlphaBetaMismatchTolerance(alphaBetaMismatchTolerance)
+        , RebandingThreshold(rebandingThreshold)
+        , LogAdd(logAdd)
+        , CompactBands(compactBands)
+    {
+    }
+};
+
+/// \brief What a recursor's FillAlphaBeta did, for tuning the banding
+///        against throughput
+struct FillStatistics
+{
+    // Alpha and beta fills, the first two included
+    int Passes;
+    // Passes after the first two, as returned by FillAlphaBeta
+    int FlipFlops;
+    int AlphaUsedEntries;
+    int AlphaAllocatedEntries;
+    int BetaUsedEntries;
+    int BetaAllocatedEntries;
+    // Wall-clock time spent in FillAlphaBeta
+    float Seconds;
+
+    FillStatistics()
+        : Passes(0)
+        , FlipFlops(0)
+        , AlphaUsedEntries(0)
+        , AlphaAllocatedEntries(0)
+        , BetaUsedEntries(0)
+        , BetaAllocatedEntries(0)
+        , Seconds(0)
+    {
+    }
 };
 
 /// \brief A parameter vector for analysis using the QV model
@@ -120,6 +230,84 @@ struct QvModelParams
     float MergeS_T() const { return this->MergeS[3]; }
 };
 
+#ifndef SWIG
+/// \brief A QV-dependent move score, intercept + slope * QV, and its
+///        exp, tabulated for the integral QVs of [0, NUM_TABULATED_QVS)
+///        and computed for any others.
+class QvScoreTable
+{
+public:
+    static const int NUM_TABULATED_QVS = 256;
+
+    QvScoreTable(float intercept, float slope);
+
+    float Score(float qv) const
+    {
+        int q = Index(qv);
+        return (q >= 0) ? scores_[q] : intercept_ + slope_ * qv;
+    }
+
+    float Prob(float qv) const
+    {
+        int q = Index(qv);
+        return (q >= 0) ? probs_[q] : std::exp(intercept_ + slope_ * qv);
+    }
+
+private:
+    int Index(float qv) const
+    {
+        int q = static_cast<int>(qv);
+        return (q == qv && 0 <= q && q < NUM_TABULATED_QVS) ? q : -1;
+    }
+
+    float intercept_;
+    float slope_;
+    float scores_[NUM_TABULATED_QVS];
+    float probs_[NUM_TABULATED_QVS];
+};
+
+/// \brief A QvModelParams compiled for scoring: the move scores, and
+///        their exps, tabulated by QV.
+///
+/// It is immutable once built, so one model is shared, by pointer,
+/// among all the evaluators of a chemistry and may be read from many
+/// threads at once.
+class QvModel
+{
+public:
+    // chemistryId is the model's index in its QuiverConfigTable, or -1
+    explicit QvModel(const QvModelParams& params, int chemistryId = -1);
+
+    const QvModelParams& Params() const { return params_; }
+
+    int ChemistryId() const { return chemistryId_; }
+
+    float Match() const { return params_.Match; }
+    float MatchProb() const { return matchProb_; }
+
+    float DeletionN() const { return params_.DeletionN; }
+    float DeletionNProb() const { return deletionNProb_; }
+
+    const QvScoreTable& Mismatch() const { return mismatch_; }
+    const QvScoreTable& DeletionWithTag() const { return deletionWithTag_; }
+    const QvScoreTable& Branch() const { return branch_; }
+    const QvScoreTable& Nce() const { return nce_; }
+    // For the read base, as an index into "ACGT"
+    const QvScoreTable& Merge(int base) const { return merge_[base]; }
+
+private:
+    QvModelParams params_;
+    int chemistryId_;
+    float matchProb_;
+    float deletionNProb_;
+    QvScoreTable mismatch_;
+    QvScoreTable deletionWithTag_;
+    QvScoreTable branch_;
+    QvScoreTable nce_;
+    QvScoreTable merge_[4];
+};
+#endif  // !SWIG
+
 struct QuiverConfig
 {
     QvModelParams QvParams;
@@ -127,10 +315,21 @@ struct QuiverConfig
     BandingOptions Banding;
     float FastScoreThreshold;
     float AddThreshold;
+    RecursorConfig Recursor;
+    // Keep alpha and beta columns checkpointed at this interval, for
+    // long templates; 0 keeps them whole (see MutationScorer)
+    int CheckpointInterval;
+#ifndef SWIG
+    // QvParams, compiled when the config is built, and again when it is
+    // inserted into a QuiverConfigTable; changes to QvParams in between
+    // are not seen by the evaluators built from the config.
+    boost::shared_ptr<const QvModel> Model;
+#endif  // !SWIG
 
     QuiverConfig(const QvModelParams& qvParams, int movesAvailable,
                  const BandingOptions& bandingOptions, float fastScoreThreshold,
-                 float addThreshold = 1.0f);
+                 float addThreshold = 1.0f, const RecursorConfig& recursorConfig = RecursorConfig(),
+                 int checkpointInterval = 0);
 
     QuiverConfig(const QuiverConfig& qvConfig);
 };
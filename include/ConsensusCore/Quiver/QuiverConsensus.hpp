@@ -13,25 +13,64 @@ struct RefineOptions
     int MaximumIterations;
     int MutationSeparation;
     int MutationNeighborhood;
+    // If positive, the first round tries only the mutations that this
+    // many reads' alignments show (see PileupMutationEnumerator),
+    // rather than every one; this needs a Viterbi or hybrid scorer.
+    int MinPileupSupport;
 };
 
 static const RefineOptions DefaultRefineOptions = {
     40,  // MaximumIterations
     10,  // MutationSeparation
-    20   // MutationNeighborhood
+    20,  // MutationNeighborhood
+    0    // MinPileupSupport
 };
 
 bool RefineConsensus(AbstractMultiReadMutationScorer& mms,
                      const RefineOptions& = DefaultRefineOptions);
 
+// The relative cost of refining the consensus: the matrix entries the
+// reads' fills use, about the sum over the reads of their length times
+// their band width.
+int64_t RefineCost(const AbstractMultiReadMutationScorer& mms);
+
+#ifndef SWIG
+// RefineConsensus each scorer on numThreads threads, returning whether
+// each converged.  The scorers go costliest first (by RefineCost), so
+// that the costly ones don't come last and leave the other threads
+// idle.  One costing more than a thread's share of the batch is split
+// instead, refined alone with all the threads on its reads (as by
+// SetNumThreads), before the rest are shared out a scorer at a time.
+std::vector<bool> RefineConsensusBatch(const std::vector<AbstractMultiReadMutationScorer*>& scorers,
+                                       const RefineOptions& = DefaultRefineOptions,
+                                       int numThreads = 1);
+#endif  // SWIG
+
 void RefineDinucleotideRepeats(AbstractMultiReadMutationScorer& mms,
                                int minDinucleotideRepeatElements = 3);
 
+void RefineTrinucleotideRepeats(AbstractMultiReadMutationScorer& mms,
+                                int minTrinucleotideRepeatElements = 3);
+
 std::vector<int> ConsensusQVs(AbstractMultiReadMutationScorer& mms);
 
-//
-// Lower priority:
-//
-// Matrix<float> MutationScoresMatrix(mms);
-// Matrix<float> MutationScoresMatrix(mms, mutationsToScore);
+// The QVs of template positions [beginPos, endPos) alone
+std::vector<int> ConsensusQVs(AbstractMultiReadMutationScorer& mms, int beginPos, int endPos);
+
+// Row-major (mutations x reads) matrix of the per-read score
+// differences for the given mutations, or for every unique single base
+// mutation of the template, in the order UniqueSingleBaseMutationEnumerator
+// lists them.  Reads that do not score a mutation get 0.
+std::vector<float> MutationScoresMatrix(const AbstractMultiReadMutationScorer& mms);
+std::vector<float> MutationScoresMatrix(const AbstractMultiReadMutationScorer& mms,
+                                        const std::vector<Mutation>& mutationsToScore);
+
+#if !defined(SWIG) || defined(SWIGPYTHON)
+// For numpy: the QVs, and the mutation scores matrix of every unique
+// single base mutation, in arrays allocated with malloc, which numpy
+// takes over
+void ConsensusQVsArray(AbstractMultiReadMutationScorer& mms, int** qvs, int* nQvs);
+void MutationScoresMatrixArray(const AbstractMultiReadMutationScorer& mms, float** scores,
+                               int* nMutations, int* nReads);
+#endif
 }
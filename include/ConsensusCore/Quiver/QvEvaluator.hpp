@@ -14,10 +14,15 @@
 #include <string>
 #include <utility>
 
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
 #include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
 #include <ConsensusCore/Quiver/detail/SseMath.hpp>
 #include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Simd.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
@@ -29,29 +34,6 @@ using std::max;
 #define NEG_INF -FLT_MAX
 
 namespace ConsensusCore {
-//
-// Utility functions
-//
-static inline int encodeTplBase(char base)
-{
-    switch (base) {
-        case 'A':
-            return 0;
-        case 'C':
-            return 1;
-        case 'G':
-            return 2;
-        case 'T':
-            return 3;
-        case 'M':
-            return 4;  // For testing
-        case 'N':
-            return 5;  // For testing
-        default:
-            ShouldNotReachHere();
-    }
-}
-
 //
 // Evaluator classes
 //
@@ -59,6 +41,8 @@ static inline int encodeTplBase(char base)
 /// \brief An Evaluator that can compute move scores using a QvSequenceFeatures
 class QvEvaluator
 {
+    friend class QvMoveProbs;
+
 public:
     typedef QvSequenceFeatures FeaturesType;
     typedef QvModelParams ParamsType;
@@ -66,24 +50,78 @@ public:
 public:
     QvEvaluator(const Read& read, const std::string& tpl, const QvModelParams& params,
                 bool pinStart = true, bool pinEnd = true)
-        : read_(read), params_(params), tpl_(tpl), pinStart_(pinStart), pinEnd_(pinEnd)
+        : QvEvaluator(read, tpl, boost::make_shared<const QvModel>(params), pinStart, pinEnd)
+    {
+    }
+
+#ifndef SWIG
+    // Scores with a compiled model, shared rather than copied; see
+    // QuiverConfig::Model
+    QvEvaluator(const Read& read, const std::string& tpl,
+                const boost::shared_ptr<const QvModel>& model, bool pinStart = true,
+                bool pinEnd = true)
+        : QvEvaluator(boost::make_shared<const Read>(read), tpl, model, pinStart, pinEnd)
+    {
+    }
+
+    // Shares the read, which must not change, rather than copying it;
+    // so do the copies of the evaluator
+    QvEvaluator(const boost::shared_ptr<const Read>& read, const std::string& tpl,
+                const boost::shared_ptr<const QvModel>& model, bool pinStart = true,
+                bool pinEnd = true)
+        : read_(read)
+        , model_(model)
+        , tpl_(tpl)
+        , pinStart_(pinStart)
+        , pinEnd_(pinEnd)
+        , mismatch_(read->Length())
+        , delTag_(read->Length() + 1)
+        , deletionWithTag_(read->Length() + 1)
+        , deletion_(read->Length() + 1)
+        , branch_(read->Length())
+        , nce_(read->Length())
+        , merge_(read->Length())
     {
+        PrecomputeMoveScores();
     }
 
+#endif  // !SWIG
+
     ~QvEvaluator() {}
 
-    std::string ReadName() const { return read_.Name; }
+    std::string ReadName() const { return read_->Name; }
 
     std::string Basecalls() const { return Features().Sequence(); }
 
-    std::string Template() const { return tpl_; }
+    const std::string& Template() const { return tpl_; }
 
-    void Template(std::string tpl) { tpl_ = tpl; }
+    void Template(const std::string& tpl) { tpl_ = tpl; }
+
+    // Set the template to buffer[start, start + length), reusing the
+    // storage of the old one
+    void Template(const std::string& buffer, int start, int length)
+    {
+        tpl_.assign(buffer, start, length);
+    }
+
+    // Temporarily mutate the template in place, for mutation scoring;
+    // UndoMutation must be passed the same mutation.
+    void ApplyMutation(const Mutation& m) { ApplyMutationInPlace(m, &tpl_, &savedBases_); }
+
+    void UndoMutation(const Mutation& m) { UndoMutationInPlace(m, &tpl_, savedBases_); }
 
     int ReadLength() const { return Features().Length(); }
 
     int TemplateLength() const { return tpl_.length(); }
 
+    // The bytes of the move scores precomputed from the read's features
+    int64_t FeatureBytes() const
+    {
+        int64_t floats = mismatch_.Length() + delTag_.Length() + deletionWithTag_.Length() +
+                         deletion_.Length() + branch_.Length() + nce_.Length() + merge_.Length();
+        return floats * sizeof(float);
+    }
+
     bool PinEnd() const { return pinEnd_; }
 
     bool PinStart() const { return pinStart_; }
@@ -98,29 +136,20 @@ public:
     float Inc(int i, int j) const
     {
         assert(0 <= j && j < TemplateLength() && 0 <= i && i < ReadLength());
-        return (IsMatch(i, j)) ? params_.Match
-                               : params_.Mismatch + params_.MismatchS * Features().SubsQv[i];
+        return (IsMatch(i, j)) ? model_->Match() : mismatch_[i];
     }
 
     float Del(int i, int j) const
     {
         assert(0 <= j && j < TemplateLength() && 0 <= i && i <= ReadLength());
-        if ((!PinStart() && i == 0) || (!PinEnd() && i == ReadLength())) {
-            return 0.0f;
-        } else {
-            float tplBase = tpl_[j];
-            return (i < ReadLength() && tplBase == Features().DelTag[i])
-                       ? params_.DeletionWithTag + params_.DeletionWithTagS * Features().DelQv[i]
-                       : params_.DeletionN;
-        }
+        float tplBase = tpl_[j];
+        return (tplBase == delTag_[i]) ? deletionWithTag_[i] : deletion_[i];
     }
 
     float Extra(int i, int j) const
     {
         assert(0 <= j && j <= TemplateLength() && 0 <= i && i < ReadLength());
-        return (j < TemplateLength() && IsMatch(i, j))
-                   ? params_.Branch + params_.BranchS * Features().InsQv[i]
-                   : params_.Nce + params_.NceS * Features().InsQv[i];
+        return (j < TemplateLength() && IsMatch(i, j)) ? branch_[i] : nce_[i];
     }
 
     float Merge(int i, int j) const
@@ -129,96 +158,267 @@ public:
         if (!(Features()[i] == tpl_[j] && Features()[i] == tpl_[j + 1])) {
             return -FLT_MAX;
         } else {
-            int tplBase = encodeTplBase(tpl_[j]);
-            return params_.Merge[tplBase] + params_.MergeS[tplBase] * Features().MergeQv[i];
+            return merge_[i];
         }
     }
 
     //
-    // SSE
+    // SIMD, computing the scores for rows [i, i + W) at once
     //
 
-    __m128 Inc4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec IncN(int i, int j) const
     {
-        assert(0 <= i && i <= ReadLength() - 4);
+        typedef Simd<W> S;
+        assert(0 <= i && i <= ReadLength() - W);
         assert(0 <= j && j < TemplateLength());
         float tplBase = tpl_[j];
-        __m128 match = _mm_set_ps1(params_.Match);
-        __m128 mismatch = AFFINE4(params_.Mismatch, params_.MismatchS, &Features().SubsQv[i]);
+        typename S::Vec match = S::Set1(model_->Match());
+        typename S::Vec mismatch = S::Load(&mismatch_[i]);
         // Mask to see it the base is equal to the template
-        __m128 mask =
-            _mm_cmpeq_ps(_mm_loadu_ps(&Features().SequenceAsFloat[i]), _mm_set_ps1(tplBase));
-        return MUX4(mask, match, mismatch);
+        typename S::Mask mask = S::CmpEq(S::Load(&Features().SequenceAsFloat[i]), S::Set1(tplBase));
+        return S::Select(mask, match, mismatch);
     }
 
-    __m128 Del4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec DelN(int i, int j) const
     {
+        typedef Simd<W> S;
         assert(0 <= i && i <= ReadLength());
         assert(0 <= j && j < TemplateLength());
-        if (i != 0 && i + 3 != ReadLength()) {
-            float tplBase = tpl_[j];
-            __m128 delWTag =
-                AFFINE4(params_.DeletionWithTag, params_.DeletionWithTagS, &Features().DelQv[i]);
-            __m128 delNoTag = _mm_set_ps1(params_.DeletionN);
-            __m128 mask = _mm_cmpeq_ps(_mm_loadu_ps(&Features().DelTag[i]), _mm_set_ps1(tplBase));
-            return MUX4(mask, delWTag, delNoTag);
-        } else {
-            // Have to do PinStart/PinEnd logic, and weird
-            // logic for last row.  Punt.
-            __m128 res = _mm_setr_ps(Del(i + 0, j), Del(i + 1, j), Del(i + 2, j), Del(i + 3, j));
-            return res;
-        }
+        assert(i + W - 1 <= ReadLength());
+        // The pinning and the last row are folded into the tracks, so
+        // no row needs special handling
+        float tplBase = tpl_[j];
+        typename S::Vec delWTag = S::Load(&deletionWithTag_[i]);
+        typename S::Vec delNoTag = S::Load(&deletion_[i]);
+        typename S::Mask mask = S::CmpEq(S::Load(&delTag_[i]), S::Set1(tplBase));
+        return S::Select(mask, delWTag, delNoTag);
     }
 
-    __m128 Extra4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec ExtraN(int i, int j) const
     {
-        assert(0 <= i && i <= ReadLength() - 4);
+        typedef Simd<W> S;
+        assert(0 <= i && i <= ReadLength() - W);
         assert(0 <= j && j <= TemplateLength());
-        if (i != 0 && i + 3 != ReadLength()) {
-            float tplBase = tpl_[j];
-            __m128 branch = AFFINE4(params_.Branch, params_.BranchS, &Features().InsQv[i]);
-            __m128 nce = AFFINE4(params_.Nce, params_.NceS, &Features().InsQv[i]);
-
-            __m128 mask =
-                _mm_cmpeq_ps(_mm_loadu_ps(&Features().SequenceAsFloat[i]), _mm_set_ps1(tplBase));
-            return MUX4(mask, branch, nce);
-        } else {
-            __m128 res =
-                _mm_setr_ps(Extra(i + 0, j), Extra(i + 1, j), Extra(i + 2, j), Extra(i + 3, j));
-            return res;
-        }
+        // Past the end of the template, tpl_[j] is the terminating
+        // NUL, which matches no base
+        float tplBase = tpl_[j];
+        typename S::Vec branch = S::Load(&branch_[i]);
+        typename S::Vec nce = S::Load(&nce_[i]);
+        typename S::Mask mask = S::CmpEq(S::Load(&Features().SequenceAsFloat[i]), S::Set1(tplBase));
+        return S::Select(mask, branch, nce);
     }
 
-    __m128 Merge4(int i, int j) const
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec MergeN(int i, int j) const
     {
-        assert(0 <= i && i <= ReadLength() - 4);
+        typedef Simd<W> S;
+        assert(0 <= i && i <= ReadLength() - W);
         assert(0 <= j && j < TemplateLength() - 1);
 
         float tplBase = tpl_[j];
         float tplBaseNext = tpl_[j + 1];
-        int tplBase_ = encodeTplBase(tpl_[j]);
 
-        __m128 merge =
-            AFFINE4(params_.Merge[tplBase_], params_.MergeS[tplBase_], &Features().MergeQv[i]);
-        __m128 noMerge = _mm_set_ps1(-FLT_MAX);
+        typename S::Vec merge = S::Load(&merge_[i]);
+        typename S::Vec noMerge = S::Set1(-FLT_MAX);
 
         if (tplBase == tplBaseNext) {
-            __m128 mask =
-                _mm_cmpeq_ps(_mm_loadu_ps(&Features().SequenceAsFloat[i]), _mm_set_ps1(tplBase));
-            return MUX4(mask, merge, noMerge);
+            typename S::Mask mask =
+                S::CmpEq(S::Load(&Features().SequenceAsFloat[i]), S::Set1(tplBase));
+            return S::Select(mask, merge, noMerge);
         } else {
             return noMerge;
         }
     }
 
+    //
+    // SSE
+    //
+
+    __m128 Inc4(int i, int j) const { return IncN<4>(i, j); }
+
+    __m128 Del4(int i, int j) const { return DelN<4>(i, j); }
+
+    __m128 Extra4(int i, int j) const { return ExtraN<4>(i, j); }
+
+    __m128 Merge4(int i, int j) const { return MergeN<4>(i, j); }
+
 protected:
-    inline const QvSequenceFeatures& Features() const { return read_.Features; }
+    inline const QvSequenceFeatures& Features() const { return read_->Features; }
+
+    // The QV-dependent move scores depend only on the read, the
+    // parameters and the pinning, so they are computed once here rather
+    // than on every visit to a cell, as one contiguous track per move
+    // (a struct of arrays), ready for SIMD loads; the model has them,
+    // and their exps, tabulated by QV already.  The tracks are shared
+    // among copies of the evaluator; later changes to the read's
+    // features are not seen.
+    void PrecomputeMoveScores()
+    {
+        const QvModel& m = *model_;
+        const QvSequenceFeatures& f = Features();
+        const std::string mergeBases = "ACGT";
+        int I = f.Length();
+        for (int i = 0; i < I; i++) {
+            mismatch_[i] = m.Mismatch().Score(f.SubsQv[i]);
+            delTag_[i] = f.DelTag[i];
+            deletionWithTag_[i] = m.DeletionWithTag().Score(f.DelQv[i]);
+            deletion_[i] = m.DeletionN();
+            branch_[i] = m.Branch().Score(f.InsQv[i]);
+            nce_[i] = m.Nce().Score(f.InsQv[i]);
+            // A merge needs the read base to match the template, so the
+            // read base picks the merge parameters; there are none for
+            // bases outside ACGT.
+            size_t base = mergeBases.find(f[i]);
+            if (base == std::string::npos) {
+                merge_[i] = -FLT_MAX;
+            } else {
+                merge_[i] = m.Merge(base).Score(f.MergeQv[i]);
+            }
+        }
+
+        // Deletions past the last base never carry a tag; a zero tag
+        // matches no template base.
+        delTag_[I] = 0;
+        deletionWithTag_[I] = deletion_[I] = m.DeletionN();
+
+        // Unpinned ends delete for free
+        if (!pinStart_) {
+            deletionWithTag_[0] = deletion_[0] = 0.0f;
+        }
+        if (!pinEnd_) {
+            deletionWithTag_[I] = deletion_[I] = 0.0f;
+        }
+    }
 
 protected:
-    Read read_;
-    QvModelParams params_;
+    boost::shared_ptr<const Read> read_;
+    boost::shared_ptr<const QvModel> model_;
     std::string tpl_;
+    std::string savedBases_;
     bool pinStart_;
     bool pinEnd_;
+
+    // Per-row move scores, as computed by PrecomputeMoveScores; the
+    // deletion tracks have a row past the end of the read
+    Feature<float> mismatch_;
+    Feature<float> delTag_;
+    Feature<float> deletionWithTag_;
+    Feature<float> deletion_;
+    Feature<float> branch_;
+    Feature<float> nce_;
+    Feature<float> merge_;
+};
+
+/// \brief The move probabilities of a QvEvaluator, the exps of its move
+///        scores, for recursors that work with probabilities rather than
+///        their logs.
+///
+/// Like the evaluator's move scores, they are kept as one track per
+/// move, looked up in the model's tables by QV; they are made by the
+/// recursor that wants them, for the length of its fill, rather than
+/// by every evaluator.  The evaluator must outlive them, and its
+/// template is read as it stands at each call.
+class QvMoveProbs
+{
+public:
+    explicit QvMoveProbs(const QvEvaluator& e)
+        : e_(e)
+        , mismatch_(e.ReadLength())
+        , deletionWithTag_(e.ReadLength() + 1)
+        , deletion_(e.ReadLength() + 1)
+        , branch_(e.ReadLength())
+        , nce_(e.ReadLength())
+        , merge_(e.ReadLength())
+    {
+        const QvModel& m = *e.model_;
+        const QvSequenceFeatures& f = e.Features();
+        const std::string mergeBases = "ACGT";
+        int I = f.Length();
+        for (int i = 0; i < I; i++) {
+            mismatch_[i] = m.Mismatch().Prob(f.SubsQv[i]);
+            deletionWithTag_[i] = m.DeletionWithTag().Prob(f.DelQv[i]);
+            deletion_[i] = m.DeletionNProb();
+            branch_[i] = m.Branch().Prob(f.InsQv[i]);
+            nce_[i] = m.Nce().Prob(f.InsQv[i]);
+            size_t base = mergeBases.find(f[i]);
+            merge_[i] = (base == std::string::npos) ? 0.0f : m.Merge(base).Prob(f.MergeQv[i]);
+        }
+        deletionWithTag_[I] = deletion_[I] = m.DeletionNProb();
+        if (!e.pinStart_) {
+            deletionWithTag_[0] = deletion_[0] = 1.0f;
+        }
+        if (!e.pinEnd_) {
+            deletionWithTag_[I] = deletion_[I] = 1.0f;
+        }
+        match_ = m.MatchProb();
+    }
+
+    float Inc(int i, int j) const { return e_.IsMatch(i, j) ? match_ : mismatch_[i]; }
+
+    float Del(int i, int j) const
+    {
+        return (e_.tpl_[j] == e_.delTag_[i]) ? deletionWithTag_[i] : deletion_[i];
+    }
+
+    float Extra(int i, int j) const
+    {
+        return (j < e_.TemplateLength() && e_.IsMatch(i, j)) ? branch_[i] : nce_[i];
+    }
+
+    float Merge(int i, int j) const
+    {
+        const QvSequenceFeatures& f = e_.Features();
+        return (f[i] == e_.tpl_[j] && f[i] == e_.tpl_[j + 1]) ? merge_[i] : 0.0f;
+    }
+
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec IncN(int i, int j) const
+    {
+        typedef Simd<W> S;
+        typename S::Mask mask = S::CmpEq(S::Load(&e_.Features().SequenceAsFloat[i]),
+                                         S::Set1(static_cast<float>(e_.tpl_[j])));
+        return S::Select(mask, S::Set1(match_), S::Load(&mismatch_[i]));
+    }
+
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec DelN(int i, int j) const
+    {
+        typedef Simd<W> S;
+        typename S::Mask mask =
+            S::CmpEq(S::Load(&e_.delTag_[i]), S::Set1(static_cast<float>(e_.tpl_[j])));
+        return S::Select(mask, S::Load(&deletionWithTag_[i]), S::Load(&deletion_[i]));
+    }
+
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec ExtraN(int i, int j) const
+    {
+        typedef Simd<W> S;
+        typename S::Mask mask = S::CmpEq(S::Load(&e_.Features().SequenceAsFloat[i]),
+                                         S::Set1(static_cast<float>(e_.tpl_[j])));
+        return S::Select(mask, S::Load(&branch_[i]), S::Load(&nce_[i]));
+    }
+
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET typename Simd<W>::Vec MergeN(int i, int j) const
+    {
+        typedef Simd<W> S;
+        if (e_.tpl_[j] != e_.tpl_[j + 1]) return S::Set1(0.0f);
+        typename S::Mask mask = S::CmpEq(S::Load(&e_.Features().SequenceAsFloat[i]),
+                                         S::Set1(static_cast<float>(e_.tpl_[j])));
+        return S::Select(mask, S::Load(&merge_[i]), S::Set1(0.0f));
+    }
+
+private:
+    const QvEvaluator& e_;
+    float match_;
+    Feature<float> mismatch_;
+    Feature<float> deletionWithTag_;
+    Feature<float> deletion_;
+    Feature<float> branch_;
+    Feature<float> nce_;
+    Feature<float> merge_;
 };
 }
@@ -0,0 +1,80 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <ConsensusCore/Read.hpp>
+
+namespace ConsensusCore {
+
+/// \brief The scorers of reads against their slices of the template,
+///        kept by content, so that a read added again against the same
+///        slice---as where consensus windows overlap---needs no fill.
+///
+/// A read matches a cached scorer if its features, chemistry, strand,
+/// pinning and band hint are those of the scorer's read, and it is
+/// scored against the same template bases.  The features are keyed by
+/// their CRC-32C and compared in full on a match.  Find returns a copy
+/// of the cached scorer, sharing its alpha and beta matrices.
+///
+/// The cache holds the capacity scorers most recently inserted or found,
+/// and their matrices with them.  It may be shared by scorers on many
+/// threads, which must all score with the same QuiverConfigTable.
+template <typename ScorerType>
+class ReadScorerCache : private boost::noncopyable
+{
+public:
+    explicit ReadScorerCache(int capacity);
+
+    int Capacity() const;
+    int Size() const;
+    int Hits() const;
+    int Misses() const;
+
+    // A new copy of the scorer cached for mr against tpl, its slice of
+    // the template in its orientation, or NULL
+    ScorerType* Find(const MappedRead& mr, const std::string& tpl);
+
+    // Cache a copy of scorer, filled for mr against tpl
+    void Insert(const MappedRead& mr, const std::string& tpl, const ScorerType& scorer);
+
+    void Clear();
+
+private:
+    struct Entry
+    {
+        uint64_t Key;
+        MappedRead Read;
+        std::string Template;
+        boost::shared_ptr<const ScorerType> Scorer;
+
+        Entry(uint64_t key, const MappedRead& mr, const std::string& tpl,
+              const boost::shared_ptr<const ScorerType>& scorer);
+    };
+    typedef std::list<Entry> EntryList;
+    typedef std::multimap<uint64_t, typename EntryList::iterator> KeyIndex;
+
+    static uint64_t Key(const MappedRead& mr, const std::string& tpl);
+
+    // The entry for mr against tpl, or entries_.end()
+    typename EntryList::iterator Lookup(uint64_t key, const MappedRead& mr,
+                                        const std::string& tpl);
+
+private:
+    int capacity_;
+    int hits_;
+    int misses_;
+    // Most recently used first, and the entries by key
+    EntryList entries_;
+    KeyIndex byKey_;
+    mutable std::mutex mutex_;
+};
+}
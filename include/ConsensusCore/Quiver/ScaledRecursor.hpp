@@ -0,0 +1,47 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+
+namespace ConsensusCore {
+
+/// \brief A sum-product recursor computing the banded alpha score in
+///        linear probability space.
+///
+/// Cells hold probabilities rather than their logs, and are combined
+/// with plain SIMD multiplies and adds, the move probabilities coming
+/// from the QvMoveProbs each fill makes of the evaluator; no exp or log
+/// is taken per cell.  As in classic HMM forward recursions, underflow is
+/// avoided by scaling each column so that its largest cell is one,
+/// the log of the product of the scale factors being carried
+/// alongside---one log per column.  Only the few alpha columns the
+/// recursion reads are kept.
+///
+/// The banding follows SseRecursor's first alpha pass, so Score()
+/// matches SparseSseQvSumProductRecursor's alpha score up to float
+/// rounding.  A float only spans about 87 nats below one, so cells
+/// further below the best of their column than that are taken as
+/// zero, and the band is at most that deep.
+///
+/// It only scores whole reads, and is not a Combiner for the recursors
+/// a MutationScorer uses.  Their matrices hold log scores, which the
+/// scorer extends and links across columns, whereas a scaled cell only
+/// means something next to its column's scale.  MultiTemplateScorer
+/// uses it for the reads too big to hold (see SetScoreUnheldReads).
+class ScaledSumProductRecursor
+{
+public:
+    ScaledSumProductRecursor(int movesAvailable, const BandingOptions& banding);
+
+    /// \brief The sum-product (forward) score of the read against the
+    ///        template, or -FLT_MAX if the band misses the end of the
+    ///        alignment.
+    float Score(const QvEvaluator& e) const;
+
+private:
+    int movesAvailable_;
+    BandingOptions bandingOptions_;
+};
+}
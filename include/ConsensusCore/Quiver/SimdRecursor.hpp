@@ -0,0 +1,145 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/detail/Combiner.hpp>
+#include <ConsensusCore/Quiver/detail/RecursorBase.hpp>
+
+namespace ConsensusCore {
+
+/// \brief A recursor filling W rows of a column at a time.
+///
+/// Each width is instantiated in its own translation unit, compiled
+/// for the matching instruction set: W = 4 (SSE) in SimdRecursor.cpp,
+/// W = 8 (AVX2) in SimdRecursorAvx2.cpp and W = 16 (AVX-512F) in
+/// SimdRecursorAvx512.cpp.  Only the 4-wide kernels may be constructed
+/// directly on any CPU; SseRecursor picks the widest kernel the CPU
+/// supports at runtime.
+///
+/// K, C by default, is the combiner whose arithmetic joins the paths;
+/// it may instead be one of C's approximations (see Combiner.hpp).
+template <typename M, typename E, typename C, int W, typename K = C>
+class SimdRecursor : public detail::RecursorBase<M, E, C>
+{
+public:
+    using detail::RecursorBase<M, E, C>::FillAlpha;
+    using detail::RecursorBase<M, E, C>::FillBeta;
+
+    void FillAlpha(const E& e, const M& guide, M& alpha, int beginColumn, int endColumn) const;
+    void FillBeta(const E& e, const M& guide, M& beta, int beginColumn, int endColumn) const;
+
+    float LinkAlphaBeta(const E& e, const M& alpha, int alphaColumn, const M& beta, int betaColumn,
+                        int absoluteColumn) const;
+
+    void ExtendAlpha(const E& e, const M& alpha, int beginColumn, M& ext,
+                     int numExtColumns = 2) const;
+
+    void ExtendBeta(const E& e, const M& beta, int lastColumn, M& ext, int numExtColumns = 2,
+                    int lengthDiff = 0) const;
+
+public:
+    //
+    // Constructors
+    //
+    SimdRecursor(int movesAvailable, const BandingOptions& banding,
+                 const RecursorConfig& config = RecursorConfig());
+
+private:
+    // The recursions, for the moves fixed at compile time; Merge is
+    // whether merges are available
+    template <bool Merge>
+    CONSENSUSCORE_SIMD_TARGET void FillAlphaImpl(const E& e, const M& guide, M& alpha,
+                                                 int beginColumn, int endColumn) const;
+    template <bool Merge>
+    CONSENSUSCORE_SIMD_TARGET void FillBetaImpl(const E& e, const M& guide, M& beta,
+                                                int beginColumn, int endColumn) const;
+    template <bool Merge>
+    CONSENSUSCORE_SIMD_TARGET float LinkAlphaBetaImpl(const E& e, const M& alpha,
+                                                      int alphaColumn, const M& beta,
+                                                      int betaColumn, int absoluteColumn) const;
+    template <bool Merge>
+    CONSENSUSCORE_SIMD_TARGET void ExtendAlphaImpl(const E& e, const M& alpha, int beginColumn,
+                                                   M& ext, int numExtColumns) const;
+    template <bool Merge>
+    CONSENSUSCORE_SIMD_TARGET void ExtendBetaImpl(const E& e, const M& beta, int lastColumn,
+                                                  M& ext, int numExtColumns,
+                                                  int lengthDiff) const;
+};
+
+/// The SIMD lane count (4, 8 or 16) of the widest recursor kernels
+/// that were compiled in and that the running CPU supports, capped by
+/// SetMaxSimdWidth.
+int SimdWidth();
+
+/// Cap the lane count reported by SimdWidth, and thus used by
+/// recursors constructed afterwards; 4 selects the SSE kernels.
+void SetMaxSimdWidth(int width);
+
+namespace detail {
+// Must only be called if the CPU supports the instruction set
+template <typename M, typename E, typename C, typename K>
+RecursorBase<M, E, C>* NewAvx2Recursor(int movesAvailable, const BandingOptions& banding);
+
+template <typename M, typename E, typename C, typename K>
+RecursorBase<M, E, C>* NewAvx512Recursor(int movesAvailable, const BandingOptions& banding);
+
+// A kernel of the given width joining paths with K's arithmetic
+template <typename M, typename E, typename C, typename K>
+RecursorBase<M, E, C>* NewSimdKernel(int width, int movesAvailable, const BandingOptions& banding)
+{
+    if (width == 16) {
+        return NewAvx512Recursor<M, E, C, K>(movesAvailable, banding);
+    } else if (width == 8) {
+        return NewAvx2Recursor<M, E, C, K>(movesAvailable, banding);
+    } else {
+        return new SimdRecursor<M, E, C, 4, K>(movesAvailable, banding);
+    }
+}
+
+// The kernel SseRecursor uses for a RecursorConfig.  Only the QV
+// sum-product recursion has approximate kernels; the rest ignore
+// RecursorConfig::LogAdd.
+template <typename M, typename E, typename C>
+struct SimdKernels
+{
+    static RecursorBase<M, E, C>* New(int width, int movesAvailable, const BandingOptions& banding,
+                                      LogAddMode)
+    {
+        return NewSimdKernel<M, E, C, C>(width, movesAvailable, banding);
+    }
+};
+
+template <typename M>
+struct SimdKernels<M, QvEvaluator, SumProductCombiner>
+{
+    static RecursorBase<M, QvEvaluator, SumProductCombiner>* New(int width, int movesAvailable,
+                                                                 const BandingOptions& banding,
+                                                                 LogAddMode logAdd)
+    {
+        typedef SumProductCombiner C;
+        switch (logAdd) {
+            case TABLE_LOGADD:
+                return NewSimdKernel<M, QvEvaluator, C, TableSumProductCombiner>(
+                    width, movesAvailable, banding);
+            case POLYNOMIAL_LOGADD:
+                return NewSimdKernel<M, QvEvaluator, C, PolynomialSumProductCombiner>(
+                    width, movesAvailable, banding);
+            default:
+                return NewSimdKernel<M, QvEvaluator, C, C>(width, movesAvailable, banding);
+        }
+    }
+};
+}
+
+typedef SimdRecursor<SparseMatrix, QvEvaluator, detail::ViterbiCombiner, 8> SparseAvx2QvRecursor;
+typedef SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 8>
+    SparseAvx2QvSumProductRecursor;
+
+typedef SimdRecursor<SparseMatrix, QvEvaluator, detail::ViterbiCombiner, 16> SparseAvx512QvRecursor;
+typedef SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 16>
+    SparseAvx512QvSumProductRecursor;
+}
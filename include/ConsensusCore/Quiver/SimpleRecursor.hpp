@@ -13,8 +13,11 @@ template <typename M, typename E, typename C>
 class SimpleRecursor : public detail::RecursorBase<M, E, C>
 {
 public:
-    void FillAlpha(const E& e, const M& guide, M& alpha) const;
-    void FillBeta(const E& e, const M& guide, M& beta) const;
+    using detail::RecursorBase<M, E, C>::FillAlpha;
+    using detail::RecursorBase<M, E, C>::FillBeta;
+
+    void FillAlpha(const E& e, const M& guide, M& alpha, int beginColumn, int endColumn) const;
+    void FillBeta(const E& e, const M& guide, M& beta, int beginColumn, int endColumn) const;
 
     float LinkAlphaBeta(const E& e, const M& alpha, int alphaColumn, const M& beta, int betaColumn,
                         int absoluteColumn) const;
@@ -29,7 +32,22 @@ public:
     //
     // Constructors
     //
-    SimpleRecursor(int movesAvailable, const BandingOptions& banding);
+    SimpleRecursor(int movesAvailable, const BandingOptions& banding,
+                   const RecursorConfig& config = RecursorConfig());
+
+private:
+    // The recursions, for the moves fixed at compile time; Merge is
+    // whether merges are available
+    template <bool Merge>
+    void FillAlphaImpl(const E& e, const M& guide, M& alpha, int beginColumn, int endColumn) const;
+    template <bool Merge>
+    void FillBetaImpl(const E& e, const M& guide, M& beta, int beginColumn, int endColumn) const;
+    template <bool Merge>
+    void ExtendAlphaImpl(const E& e, const M& alpha, int beginColumn, M& ext,
+                         int numExtColumns) const;
+    template <bool Merge>
+    void ExtendBetaImpl(const E& e, const M& beta, int lastColumn, M& ext, int numExtColumns,
+                        int lengthDiff) const;
 };
 
 typedef SimpleRecursor<DenseMatrix, QvEvaluator, detail::ViterbiCombiner> SimpleQvRecursor;
@@ -2,41 +2,78 @@
 
 #pragma once
 
+#include <boost/shared_ptr.hpp>
+
 #include <ConsensusCore/Edna/EdnaEvaluator.hpp>
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
 #include <ConsensusCore/Matrix/SparseMatrix.hpp>
 #include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
 #include <ConsensusCore/Quiver/SimpleRecursor.hpp>
 #include <ConsensusCore/Quiver/detail/Combiner.hpp>
 #include <ConsensusCore/Quiver/detail/RecursorBase.hpp>
 
 namespace ConsensusCore {
 
+/// \brief The SIMD recursor, dispatching at construction time to the
+/// widest SimdRecursor kernel the running CPU supports (see SimdWidth).
 template <typename M, typename E, typename C>
 class SseRecursor : public detail::RecursorBase<M, E, C>
 {
 public:
-    void FillAlpha(const E& e, const M& guide, M& alpha) const;
-    void FillBeta(const E& e, const M& guide, M& beta) const;
+    using detail::RecursorBase<M, E, C>::FillAlpha;
+    using detail::RecursorBase<M, E, C>::FillBeta;
+
+    void FillAlpha(const E& e, const M& guide, M& alpha, int beginColumn, int endColumn) const
+    {
+        kernel_->FillAlpha(e, guide, alpha, beginColumn, endColumn);
+    }
+
+    void FillBeta(const E& e, const M& guide, M& beta, int beginColumn, int endColumn) const
+    {
+        kernel_->FillBeta(e, guide, beta, beginColumn, endColumn);
+    }
 
     float LinkAlphaBeta(const E& e, const M& alpha, int alphaColumn, const M& beta, int betaColumn,
-                        int absoluteColumn) const;
+                        int absoluteColumn) const
+    {
+        return kernel_->LinkAlphaBeta(e, alpha, alphaColumn, beta, betaColumn, absoluteColumn);
+    }
 
     void ExtendAlpha(const E& e, const M& alpha, int beginColumn, M& ext,
-                     int numExtColumns = 2) const;
+                     int numExtColumns = 2) const
+    {
+        kernel_->ExtendAlpha(e, alpha, beginColumn, ext, numExtColumns);
+    }
 
     void ExtendBeta(const E& e, const M& beta, int endColumn, M& ext, int numExtColumns = 2,
-                    int lengthDiff = 0) const;
+                    int lengthDiff = 0) const
+    {
+        kernel_->ExtendBeta(e, beta, endColumn, ext, numExtColumns, lengthDiff);
+    }
+
+    /// The lane count of the kernel in use
+    int Width() const { return width_; }
 
 public:
     //
     // Constructors
     //
-    SseRecursor(int movesAvailable, const BandingOptions& banding);
+    // The kernel only fills matrices; mating them, and so the rest of
+    // the RecursorConfig, is this recursor's business.  The config's
+    // LogAdd picks the kernel's arithmetic.
+    SseRecursor(int movesAvailable, const BandingOptions& banding,
+                const RecursorConfig& config = RecursorConfig())
+        : detail::RecursorBase<M, E, C>(movesAvailable, banding, config), width_(SimdWidth())
+    {
+        kernel_.reset(
+            detail::SimdKernels<M, E, C>::New(width_, movesAvailable, banding, config.LogAdd));
+    }
 
 private:
-    // Used during bringup
-    SimpleRecursor<M, E, C> simpleRecursor_;
+    // Immutable, so copies of the recursor can share it
+    boost::shared_ptr<const detail::RecursorBase<M, E, C> > kernel_;
+    int width_;
 };
 
 typedef SseRecursor<DenseMatrix, QvEvaluator, detail::ViterbiCombiner> SseQvRecursor;
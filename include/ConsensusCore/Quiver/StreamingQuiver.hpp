@@ -0,0 +1,96 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Quiver/ConsensusPipeline.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+#include <ConsensusCore/Read.hpp>
+
+namespace ConsensusCore {
+
+/// \brief The reference bases a StreamingQuiver takes in, by default,
+///        between refinements.
+static const int DEFAULT_STREAMING_STEP = 2000;
+
+/// \brief Polish a long reference, a chromosome say, with a window that
+///        slides along it as the reads mapped to it stream in.
+///
+/// Rather than cutting the reference into windows, each with a scorer
+/// of its own, one scorer's template follows the reads.  As a read
+/// reaching past the template arrives, the template is extended with
+/// reference bases; every step bases of reads' starts, the template is
+/// refined, and the stretch of it that no read yet to come can cover
+/// is settled, with its QVs, and trimmed away along with the reads
+/// that lie on it.  Reads spanning the trim stay, and keep their
+/// matrices, so no read is filled twice and the overlap of successive
+/// windows is not refined from scratch; the template, and the memory
+/// held, stay about a read length plus a step long.
+///
+/// Reads are given on the reference, and must come in order of their
+/// TemplateStart (as from a sorted alignment file).  They are placed on
+/// the template by the tracked positions of the reads nearest them, so
+/// to within the indels refined between.
+class StreamingQuiver : private boost::noncopyable
+{
+public:
+    StreamingQuiver(const QuiverConfigTable& configs, const std::string& reference,
+                    int step = DEFAULT_STREAMING_STEP,
+                    const RefineOptions& options = DefaultRefineOptions);
+
+    /// \brief Add a read mapped to the reference.  Throws
+    ///        InvalidInputError if it starts before the last read did,
+    ///        or does not lie on the reference, or if Finish was called.
+    void AddRead(const MappedRead& mr);
+
+    /// \brief Settle the rest of the reference.
+    void Finish();
+
+    /// \brief The consensus settled since the last call, with its QVs.
+    ///        Converged says whether every refinement settling it
+    ///        converged, and NumReads counts the reads taken since.
+    ///        Once finished, the consensus taken over all the calls is
+    ///        that of the whole reference.
+    ConsensusResult Take();
+
+    /// \brief The length of the sliding template.
+    int WindowLength() const;
+
+private:
+    // A read in the scorer, by its index there, and its extent on the
+    // reference
+    struct PlacedRead
+    {
+        int Index;
+        int RefStart;
+        int RefEnd;
+    };
+
+    // The template position of reference position refPos, by the
+    // nearest tracked read start or end, or the template's end
+    int TemplatePosition(int refPos) const;
+
+    // Refine the template, then settle and trim what lies before both
+    // refPos and the reads reaching past it
+    void Advance(int refPos);
+
+    std::string reference_;
+    int step_;
+    RefineOptions options_;
+    SparseSseQvMultiReadMutationScorer mms_;
+    std::deque<PlacedRead> placed_;
+    // The reference position the template ends at, the start of the
+    // last read added, and where the last refinement was
+    int refEnd_;
+    int lastStart_;
+    int advancedAt_;
+    bool finished_;
+    ConsensusResult settled_;
+};
+}
@@ -0,0 +1,27 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <ConsensusCore/Quiver/TandemRepeatIndex.hpp>
+
+namespace ConsensusCore {
+
+inline int TandemRepeatIndex::MaxUnitLength() const { return repeats_.size(); }
+
+template <typename F>
+void TandemRepeatIndex::ForEachRepeat(int unitLength, int beginPos, int endPos, F f) const
+{
+    assert(1 <= unitLength && unitLength <= MaxUnitLength());
+    const std::vector<TandemRepeat>& repeats = repeats_[unitLength - 1];
+    std::vector<TandemRepeat>::const_iterator it =
+        std::lower_bound(repeats.begin(), repeats.end(), beginPos,
+                         [](const TandemRepeat& r, int pos) { return r.Start < pos; });
+    for (; it != repeats.end() && it->Start < endPos; ++it) {
+        f(*it);
+    }
+}
+}
@@ -0,0 +1,71 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Mutation.hpp>
+
+namespace ConsensusCore {
+
+/// \brief A tandem repeat: the template bases [Start, End) repeat with
+///        period UnitLength, over at least two whole units.
+struct TandemRepeat
+{
+    int Start;
+    int End;
+    int UnitLength;
+
+    TandemRepeat(int start, int end, int unitLength)
+        : Start(start), End(end), UnitLength(unitLength)
+    {
+    }
+
+    // The whole units in the repeat
+    int Elements() const { return (End - Start) / UnitLength; }
+
+    bool operator==(const TandemRepeat& other) const
+    {
+        return Start == other.Start && End == other.End && UnitLength == other.UnitLength;
+    }
+};
+
+/// \brief The tandem repeats of a template with units of one to
+///        MaxUnitLength() bases, for looking up those in a range.
+///
+/// For each unit length the index holds the maximal runs of the
+/// template with that period, which are the repeats a scan from the
+/// start of the template, skipping over each repeat it finds, would
+/// find.  (A homopolymer of four or more bases is also a repeat of two
+/// bases, and so on.)  Once built, the index is kept up to date with a
+/// template under mutation by rescanning only around the mutations.
+class TandemRepeatIndex
+{
+public:
+    explicit TandemRepeatIndex(const std::string& tpl, int maxUnitLength = 3);
+
+    int MaxUnitLength() const;
+
+    /// \brief Call f(const TandemRepeat&) for each repeat of the given
+    ///        unit length starting in [beginPos, endPos), in order.
+#ifndef SWIG
+    template <typename F>
+    void ForEachRepeat(int unitLength, int beginPos, int endPos, F f) const;
+#endif  // SWIG
+
+    std::vector<TandemRepeat> Repeats(int unitLength, int beginPos, int endPos) const;
+
+    /// \brief Bring the index up to date with newTpl, which is oldTpl
+    ///        with the mutations applied (as by ApplyMutations); the
+    ///        mutations must not overlap.
+    void ApplyMutations(const std::vector<Mutation>& mutations, const std::string& oldTpl,
+                        const std::string& newTpl);
+
+private:
+    // repeats_[k - 1] holds the repeats of unit length k, by Start
+    std::vector<std::vector<TandemRepeat> > repeats_;
+};
+}
+
+#include <ConsensusCore/Quiver/TandemRepeatIndex-inl.hpp>
@@ -0,0 +1,186 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Quiver/ConsensusPipeline.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
+
+namespace ConsensusCore {
+
+/// \brief A window to refine elsewhere: its draft template and the
+///        reads mapped to it.  Each read names its chemistry, which
+///        picks its config from the QuiverConfigTable of the worker.
+struct WorkUnit
+{
+    int Id;
+    std::string Template;
+    std::vector<MappedRead> Reads;
+
+    explicit WorkUnit(int id = 0, const std::string& tpl = "") : Id(id), Template(tpl) {}
+};
+
+/// \brief The version of the encoding written by EncodeWorkUnit and
+///        EncodeConsensusResult; decoding any other throws.
+static const int WORK_UNIT_VERSION = 1;
+
+/// \brief Encode a work unit for sending to another host.
+///
+/// The encoding is a header (magic, version, byte order and counts),
+/// the chemistry names, the template and then, read by read, its
+/// mapping, name and bases and its six feature tracks.  Chemistries
+/// are named once each, and referred to by index.  A track whose
+/// values are all whole numbers from 0 to 255, as QVs and the DelTag
+/// bases are, takes a byte a base; any other is kept as floats.
+/// Sections are padded to eight bytes, so that the float tracks can
+/// be viewed where they lie.  Band hints are not encoded.
+///
+/// Like ReadStore files, encodings are in the byte order of the
+/// machine that made them, and decoding one in the other order throws
+/// InvalidInputError, as does a truncated or corrupt one.
+std::string EncodeWorkUnit(const WorkUnit& unit);
+
+/// \brief Decode a work unit, copying the buffer once.
+WorkUnit DecodeWorkUnit(const std::string& bytes);
+
+#ifndef SWIG
+/// \brief Decode a work unit without copying: the bases and the
+///        float-coded tracks of the reads view the buffer, and hold it.
+///        The byte-coded tracks are widened to floats.
+WorkUnit DecodeWorkUnit(const boost::shared_ptr<std::string>& buffer);
+#endif  // SWIG
+
+/// \brief Encode the result of a work unit, in the same manner; the
+///        QVs take a byte each.
+std::string EncodeConsensusResult(const ConsensusResult& result);
+
+ConsensusResult DecodeConsensusResult(const std::string& bytes);
+
+/// \brief Refine a work unit's template and compute its QVs, as the
+///        refinement and QV stages of ConsensusPipeline do.  A unit
+///        that fails yields a result with its Error set.
+ConsensusResult RefineWorkUnit(const QuiverConfigTable& configs, const WorkUnit& unit,
+                               const ConsensusPipelineOptions& options =
+                                   DefaultConsensusPipelineOptions);
+
+/// \brief Refines batches of work units, as RefineWorkUnit does each,
+///        on a pool of numThreads threads (the caller's among them).
+///
+/// Meant for many small problems, as of CCS, where setting each up
+/// costs about as much as refining it.  The pool's threads live as
+/// long as the refiner, so the matrices and scratch space they draw
+/// from their per-thread pools (see MatrixPool) are recycled from one
+/// unit to the next, and from one batch to the next.  Units are handed
+/// out a unit at a time, the costliest (template length times read
+/// bases) first, so that a long one does not finish the batch alone.
+class BatchRefiner : private boost::noncopyable
+{
+public:
+    BatchRefiner(const QuiverConfigTable& configs, int numThreads = 1,
+                 const ConsensusPipelineOptions& options = DefaultConsensusPipelineOptions);
+    ~BatchRefiner();
+
+    int NumThreads() const;
+
+    /// The results, in the order of the units; a unit that fails
+    /// yields a result with its Error set, as from RefineWorkUnit.
+    /// Refine may be called from several threads, which take turns on
+    /// the pool.
+    std::vector<ConsensusResult> Refine(const std::vector<WorkUnit>& units);
+
+private:
+    QuiverConfigTable configs_;
+    ConsensusPipelineOptions options_;
+    boost::scoped_ptr<ThreadPool> pool_;
+};
+
+/// \brief Refine a batch of work units on a refiner of its own.
+std::vector<ConsensusResult> RefineConsensusBatch(
+    const QuiverConfigTable& configs, const std::vector<WorkUnit>& units, int numThreads = 1,
+    const ConsensusPipelineOptions& options = DefaultConsensusPipelineOptions);
+
+namespace detail {
+class AsyncRefinerImpl;
+struct RefineJob;
+}
+
+/// \brief A job submitted to an AsyncRefiner, and in time its result.
+///        Copies share the job, and may outlive the refiner.
+class RefineFuture
+{
+public:
+    RefineFuture();
+
+    /// The number the refiner gave the job, counting from 0 in the
+    /// order of submission (not the Id of its unit or window); -1 for
+    /// a default-made future.
+    int Ticket() const;
+
+    /// Whether the job has finished or been cancelled, and whether it
+    /// was cancelled
+    bool Done() const;
+    bool Cancelled() const;
+
+    /// Block until the job is done, or for at most timeoutSeconds if
+    /// that is not negative, returning whether it is done.
+    bool Wait(double timeoutSeconds = -1) const;
+
+    /// The job's result, blocking until it is done.  A job that fails,
+    /// or is cancelled, yields a result with its Error set.
+    ConsensusResult Result() const;
+
+    /// Cancel the job if no worker has started on it, returning whether
+    /// it was cancelled.
+    bool Cancel();
+
+private:
+    explicit RefineFuture(const boost::shared_ptr<detail::RefineJob>& job);
+    friend class detail::AsyncRefinerImpl;
+
+    boost::shared_ptr<detail::RefineJob> job_;
+};
+
+/// \brief Refines work units, and finds the consensus of windows, on
+///        threads of its own, returning a RefineFuture for each job as
+///        soon as it is queued.
+///
+/// Meant for callers that must not block, such as event loops.  Jobs
+/// are taken in the order they were submitted by numThreads workers,
+/// which live as long as the refiner, as BatchRefiner's threads do.  A
+/// unit is refined as by RefineWorkUnit, and a window as by
+/// FindWindowConsensus.  The tickets of finished jobs queue up in the
+/// order they finish, so one thread can wait on every job at once
+/// (NextCompleted); those of cancelled jobs do not.  Destroying the
+/// refiner cancels the jobs not yet started and waits for the rest.
+class AsyncRefiner : private boost::noncopyable
+{
+public:
+    AsyncRefiner(const QuiverConfigTable& configs, int numThreads = 1,
+                 const ConsensusPipelineOptions& options = DefaultConsensusPipelineOptions);
+    ~AsyncRefiner();
+
+    int NumThreads() const;
+
+    RefineFuture Submit(const WorkUnit& unit);
+    RefineFuture SubmitWindow(const ConsensusWindow& window);
+
+    /// The jobs queued or running
+    int Pending() const;
+
+    /// The ticket of the next job to finish that has not yet been
+    /// taken, blocking until there is one, or for at most
+    /// timeoutSeconds if that is not negative; -1 if there is none in
+    /// time.
+    int NextCompleted(double timeoutSeconds = -1);
+
+private:
+    detail::AsyncRefinerImpl* impl_;
+};
+}
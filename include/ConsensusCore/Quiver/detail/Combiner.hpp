@@ -5,7 +5,9 @@
 
 #include <algorithm>
 
+#include <ConsensusCore/Quiver/detail/SimdMath.hpp>
 #include <ConsensusCore/Quiver/detail/SseMath.hpp>
+#include <ConsensusCore/Simd.hpp>
 #include <ConsensusCore/Utils.hpp>
 
 #pragma once
@@ -21,6 +23,15 @@ public:
     static float Combine(float x, float y) { return std::max(x, y); }
 
     static __m128 Combine4(__m128 x4, __m128 y4) { return _mm_max_ps(x4, y4); }
+
+#ifndef SWIG
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET static typename Simd<W>::Vec CombineN(typename Simd<W>::Vec x,
+                                                                    typename Simd<W>::Vec y)
+    {
+        return Simd<W>::Max(x, y);
+    }
+#endif  // SWIG
 };
 
 /// \brief A tag dispatch class calculating path-join score in the
@@ -31,6 +42,53 @@ public:
     static float Combine(float x, float y) { return logAdd(x, y); }
 
     static __m128 Combine4(__m128 x4, __m128 y4) { return logAdd4(x4, y4); }
+
+#ifndef SWIG
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET static typename Simd<W>::Vec CombineN(typename Simd<W>::Vec x,
+                                                                    typename Simd<W>::Vec y)
+    {
+        return LogAddN<W>(x, y);
+    }
+#endif  // SWIG
+};
+
+/// \brief The sum-product path join, with log1p(exp(-|x - y|)) looked
+/// up in a table; to within LOG1P_EXP_TABLE_MAX_ERROR
+class TableSumProductCombiner
+{
+public:
+    static float Combine(float x, float y) { return logAddByTable(x, y); }
+
+    static __m128 Combine4(__m128 x4, __m128 y4) { return LogAddByTableN<4>(x4, y4); }
+
+#ifndef SWIG
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET static typename Simd<W>::Vec CombineN(typename Simd<W>::Vec x,
+                                                                    typename Simd<W>::Vec y)
+    {
+        return LogAddByTableN<W>(x, y);
+    }
+#endif  // SWIG
+};
+
+/// \brief The sum-product path join, with log1p(exp(-|x - y|)) given by
+/// a piecewise polynomial; to within LOG1P_EXP_POLYNOMIAL_MAX_ERROR
+class PolynomialSumProductCombiner
+{
+public:
+    static float Combine(float x, float y) { return logAddByPolynomial(x, y); }
+
+    static __m128 Combine4(__m128 x4, __m128 y4) { return LogAddByPolynomialN<4>(x4, y4); }
+
+#ifndef SWIG
+    template <int W>
+    CONSENSUSCORE_SIMD_TARGET static typename Simd<W>::Vec CombineN(typename Simd<W>::Vec x,
+                                                                    typename Simd<W>::Vec y)
+    {
+        return LogAddByPolynomialN<W>(x, y);
+    }
+#endif  // SWIG
 };
 }
 }
@@ -3,9 +3,11 @@
 #pragma once
 
 #include <algorithm>
+#include <boost/tuple/tuple.hpp>
 #include <string>
 #include <utility>
 
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
 #include <ConsensusCore/Types.hpp>
 
@@ -13,6 +15,20 @@ namespace ConsensusCore {
 
 namespace detail {
 
+/// \brief Copy the used entries of column srcColumn of src into
+///        column destColumn of dest.
+template <typename M>
+void CopyColumn(const M& src, int srcColumn, M& dest, int destColumn)
+{
+    int beginRow, endRow;
+    boost::tie(beginRow, endRow) = src.UsedRowRange(srcColumn);
+    dest.StartEditingColumn(destColumn, beginRow, endRow);
+    for (int i = beginRow; i < endRow; i++) {
+        dest.Set(i, destColumn, src(i, srcColumn));
+    }
+    dest.FinishEditingColumn(destColumn, beginRow, endRow);
+}
+
 /// \brief A base class for recursors, providing some functionality
 ///        based on polymorphic virtual private methods.
 template <typename M, typename E, typename C>
@@ -36,8 +52,10 @@ public:
     /// \brief Fill the alpha and beta matrices.
     /// This routine will fill the alpha and beta matrices, ensuring
     /// that the score computed from the alpha and beta recursions are
-    /// identical, refilling back-and-forth if necessary.
-    virtual int FillAlphaBeta(const E& e, M& alpha, M& beta) const;
+    /// identical, refilling back-and-forth if necessary.  Returns the
+    /// number of refills after the first alpha and beta; if stats is
+    /// given, it is filled in with what the fill did.
+    virtual int FillAlphaBeta(const E& e, M& alpha, M& beta, FillStatistics* stats = NULL) const;
 
     /// \brief Reband alpha and beta matrices.
     /// This routine will reband alpha and beta to the convex hull
@@ -45,28 +63,76 @@ public:
     virtual bool RangeGuide(int j, const M& guide, const M& matrix, int* beginRow,
                             int* endRow) const;
 
+    /// \brief Refill the alpha and beta matrices after a template edit.
+    /// The first unchangedPrefix and last unchangedSuffix bases of the
+    /// template are those of the template oldAlpha and oldBeta were
+    /// filled for; the alpha columns and beta columns that only see
+    /// those bases are copied over, and the rest are recomputed.
+    /// Returns false if the refilled alpha and beta do not agree, in
+    /// which case the caller should fill from scratch.
+    virtual bool RefillAlphaBeta(const E& e, const M& oldAlpha, const M& oldBeta,
+                                 int unchangedPrefix, int unchangedSuffix, M& alpha, M& beta) const;
+
     /// \brief Raw FillAlpha, provided primarily for testing purposes.
     ///        Client code should use FillAlphaBeta.
-    virtual void FillAlpha(const E& e, const M& guide, M& alpha) const = 0;
+    void FillAlpha(const E& e, const M& guide, M& alpha) const { FillAlpha(e, guide, alpha, 0); }
 
     /// \brief Raw FillBeta, provided primarily for testing purposes.
     ///        Client code should use FillAlphaBeta.
-    virtual void FillBeta(const E& e, const M& guide, M& beta) const = 0;
+    void FillBeta(const E& e, const M& guide, M& beta) const
+    {
+        FillBeta(e, guide, beta, e.TemplateLength());
+    }
+
+    /// \brief Fill alpha columns [beginColumn, J], given the columns
+    ///        before beginColumn.
+    void FillAlpha(const E& e, const M& guide, M& alpha, int beginColumn) const
+    {
+        FillAlpha(e, guide, alpha, beginColumn, e.TemplateLength());
+    }
+
+    /// \brief Fill beta columns [0, endColumn], given the columns
+    ///        after endColumn.
+    void FillBeta(const E& e, const M& guide, M& beta, int endColumn) const
+    {
+        FillBeta(e, guide, beta, 0, endColumn);
+    }
+
+    /// \brief Fill alpha columns [beginColumn, endColumn], given the
+    ///        columns before beginColumn.
+    virtual void FillAlpha(const E& e, const M& guide, M& alpha, int beginColumn,
+                           int endColumn) const = 0;
+
+    /// \brief Fill beta columns [beginColumn, endColumn], given the
+    ///        columns after endColumn.
+    virtual void FillBeta(const E& e, const M& guide, M& beta, int beginColumn,
+                          int endColumn) const = 0;
 
     /// \brief Compute two columns of the alpha matrix starting at columnBegin,
     ///        storing the output in ext.
     virtual void ExtendAlpha(const E& e, const M& alphaIn, int columnBegin, M& ext,
                              int numExtColumns = 2) const = 0;
 
+    /// \brief Compute two columns of the beta matrix ending at lastColumn,
+    ///        storing the output in ext.
+    virtual void ExtendBeta(const E& e, const M& betaIn, int lastColumn, M& ext,
+                            int numExtColumns = 2, int lengthDiff = 0) const = 0;
+
     /// \brief Read out the alignment from the computed alpha matrix.
     const PairwiseAlignment* Alignment(const E& e, const M& alpha) const;
 
-    RecursorBase(int movesAvailable, const BandingOptions& banding);
+    /// \brief Read out the alignment from the computed alpha matrix,
+    ///        as runs of moves; see CompactAlignment.
+    CompactAlignment Traceback(const E& e, const M& alpha) const;
+
+    RecursorBase(int movesAvailable, const BandingOptions& banding,
+                 const RecursorConfig& config = RecursorConfig());
     virtual ~RecursorBase();
 
 protected:
     int movesAvailable_;
     BandingOptions bandingOptions_;
+    RecursorConfig config_;
 };
 }
 }
@@ -0,0 +1,236 @@
+// Author: David Alexander
+
+/// \file  SimdMath.hpp
+/// \brief Log-space arithmetic on vectors of any lane width.
+///
+/// The 4-lane versions are those of SseMath.hpp; the wider ones port
+/// the same cephes kernels used by sse_mathfun.h, so that all widths
+/// agree to within rounding.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <ConsensusCore/Quiver/detail/SseMath.hpp>
+#include <ConsensusCore/Simd.hpp>
+
+namespace ConsensusCore {
+namespace detail {
+
+/// exp(x), for x clamped to the range of normal floats
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec ExpN(typename Simd<W>::Vec x)
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+    const Vec one = S::Set1(1.0f);
+
+    x = S::Min(x, S::Set1(88.3762626647949f));
+    x = S::Max(x, S::Set1(-88.3762626647949f));
+
+    // express exp(x) as exp(g + n*log(2))
+    Vec fx = S::Add(S::Mul(x, S::Set1(1.44269504088896341f)), S::Set1(0.5f));
+    fx = S::Floor(fx);
+
+    x = S::Sub(x, S::Mul(fx, S::Set1(0.693359375f)));
+    x = S::Sub(x, S::Mul(fx, S::Set1(-2.12194440e-4f)));
+    Vec z = S::Mul(x, x);
+
+    Vec y = S::Set1(1.9875691500E-4f);
+    y = S::Add(S::Mul(y, x), S::Set1(1.3981999507E-3f));
+    y = S::Add(S::Mul(y, x), S::Set1(8.3334519073E-3f));
+    y = S::Add(S::Mul(y, x), S::Set1(4.1665795894E-2f));
+    y = S::Add(S::Mul(y, x), S::Set1(1.6666665459E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(5.0000001201E-1f));
+    y = S::Add(S::Add(S::Mul(y, z), x), one);
+
+    return S::Mul(y, S::Pow2(fx));
+}
+
+/// Natural logarithm; NaN for x < 0, -inf for x == 0
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec LogN(typename Simd<W>::Vec x)
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+    const Vec zero = S::Set1(0.0f);
+    const Vec one = S::Set1(1.0f);
+
+    typename S::Mask invalidMask = S::CmpLt(x, zero);
+    typename S::Mask zeroMask = S::CmpEq(x, zero);
+
+    // cut off denormalized stuff
+    Vec e, x0 = S::Max(x, S::Set1(std::numeric_limits<float>::min()));
+    x = S::Frexp(x0, &e);
+
+    // if (x < SQRTHF) { e -= 1; x = x + x - 1.0; } else { x = x - 1.0; }
+    typename S::Mask mask = S::CmpLt(x, S::Set1(0.707106781186547524f));
+    Vec tmp = S::Select(mask, x, zero);
+    x = S::Sub(x, one);
+    e = S::Sub(e, S::Select(mask, one, zero));
+    x = S::Add(x, tmp);
+
+    Vec z = S::Mul(x, x);
+
+    Vec y = S::Set1(7.0376836292E-2f);
+    y = S::Add(S::Mul(y, x), S::Set1(-1.1514610310E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(1.1676998740E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(-1.2420140846E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(+1.4249322787E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(-1.6668057665E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(+2.0000714765E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(-2.4999993993E-1f));
+    y = S::Add(S::Mul(y, x), S::Set1(+3.3333331174E-1f));
+    y = S::Mul(S::Mul(y, x), z);
+
+    y = S::Add(y, S::Mul(e, S::Set1(-2.12194440e-4f)));
+    y = S::Sub(y, S::Mul(z, S::Set1(0.5f)));
+    x = S::Add(S::Add(x, y), S::Mul(e, S::Set1(0.693359375f)));
+
+    x = S::Select(invalidMask, S::Set1(std::numeric_limits<float>::quiet_NaN()), x);
+    return S::Select(zeroMask, S::Set1(-std::numeric_limits<float>::infinity()), x);
+}
+
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec LogAddN(typename Simd<W>::Vec aa,
+                                                               typename Simd<W>::Vec bb)
+{
+    typedef Simd<W> S;
+    typename S::Vec max = S::Max(aa, bb);
+    typename S::Vec min = S::Min(aa, bb);
+    typename S::Vec diff = S::Sub(min, max);
+    return S::Add(max, LogN<W>(S::Add(S::Set1(1.0f), ExpN<W>(diff))));
+}
+
+template <>
+inline __m128 LogAddN<4>(__m128 aa, __m128 bb)
+{
+    return logAdd4(aa, bb);
+}
+
+//
+// Approximations of log1p(exp(-d)), d >= 0, the term log-space
+// addition adds to the larger operand.  Both take the term as 0 past a
+// cutoff, and so return the larger operand where the operands are far
+// apart or infinite.
+//
+
+// Table entries per unit of d, and the d beyond which the table takes
+// the term as 0
+#define LOG1P_EXP_TABLE_RESOLUTION 64
+#define LOG1P_EXP_TABLE_CUTOFF 16
+
+// max |error| of the table: h^2 / 32 by linear interpolation of a
+// function whose second derivative is at most 1/4, h the table step,
+// plus rounding
+#define LOG1P_EXP_TABLE_MAX_ERROR 8e-6f
+
+// The polynomial is a degree 6 Chebyshev fit on each of [0, 4) and [4,
+// 12), the term taken as 0 from 12 = LOG1P_EXP_POLYNOMIAL_CUTOFF on
+#define LOG1P_EXP_POLYNOMIAL_CUTOFF 12.0f
+#define LOG1P_EXP_POLYNOMIAL_MAX_ERROR 5e-5f
+
+/// log1p(exp(-k / LOG1P_EXP_TABLE_RESOLUTION)), for k in [0,
+/// LOG1P_EXP_TABLE_RESOLUTION * LOG1P_EXP_TABLE_CUTOFF], and a zero
+inline const float* Log1pExpTable()
+{
+    static const std::vector<float> table = [] {
+        int n = LOG1P_EXP_TABLE_RESOLUTION * LOG1P_EXP_TABLE_CUTOFF;
+        std::vector<float> t(n + 2, 0.0f);
+        for (int k = 0; k <= n; k++) {
+            t[k] = static_cast<float>(
+                std::log1p(std::exp(-static_cast<double>(k) / LOG1P_EXP_TABLE_RESOLUTION)));
+        }
+        return t;
+    }();
+    return &table[0];
+}
+
+/// log1p(exp(-d)) by linear interpolation in Log1pExpTable
+inline float Log1pExpByTable(const float* table, float d)
+{
+    if (!(d < LOG1P_EXP_TABLE_CUTOFF)) return 0.0f;
+    float x = d * LOG1P_EXP_TABLE_RESOLUTION;
+    int k = static_cast<int>(x);
+    float frac = x - k;
+    return table[k] + frac * (table[k + 1] - table[k]);
+}
+
+// The polynomials' coefficients, lowest order first, in t in [-1, 1]
+// spanning the piece
+static const float log1pExpNear[7] = {1.269280110e-01f,  -2.382456341e-01f, 2.100637130e-01f,
+                                      -1.079725258e-01f, 2.530920924e-02f,  8.706004654e-03f,
+                                      -6.665151615e-03f};
+static const float log1pExpFar[7] = {3.354063729e-04f,  -1.505475204e-03f, 2.754721644e-03f,
+                                     -2.288954543e-03f, 2.995095754e-03f,  -5.249814416e-03f,
+                                     2.981192326e-03f};
+
+/// log1p(exp(-d)) by the piecewise polynomial
+inline float Log1pExpByPolynomial(float d)
+{
+    if (!(d < LOG1P_EXP_POLYNOMIAL_CUTOFF)) return 0.0f;
+    bool near = d < 4.0f;
+    const float* c = near ? log1pExpNear : log1pExpFar;
+    float t = near ? d * 0.5f - 1.0f : d * 0.25f - 2.0f;
+    float y = c[6];
+    for (int k = 5; k >= 0; k--) {
+        y = y * t + c[k];
+    }
+    return y;
+}
+
+inline float logAddByTable(float a, float b)
+{
+    float max = std::max(a, b);
+    return max + Log1pExpByTable(Log1pExpTable(), max - std::min(a, b));
+}
+
+inline float logAddByPolynomial(float a, float b)
+{
+    float max = std::max(a, b);
+    return max + Log1pExpByPolynomial(max - std::min(a, b));
+}
+
+/// log(exp(aa) + exp(bb)) by table; the lookups are done lane by lane
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec LogAddByTableN(typename Simd<W>::Vec aa,
+                                                                      typename Simd<W>::Vec bb)
+{
+    typedef Simd<W> S;
+    typename S::Vec max = S::Max(aa, bb);
+    float d[W];
+    S::Store(d, S::Sub(max, S::Min(aa, bb)));
+    const float* table = Log1pExpTable();
+    for (int k = 0; k < W; k++) {
+        d[k] = Log1pExpByTable(table, d[k]);
+    }
+    return S::Add(max, S::Load(d));
+}
+
+/// log(exp(aa) + exp(bb)) by the piecewise polynomial
+template <int W>
+CONSENSUSCORE_SIMD_TARGET inline typename Simd<W>::Vec LogAddByPolynomialN(typename Simd<W>::Vec aa,
+                                                                           typename Simd<W>::Vec bb)
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+    Vec max = S::Max(aa, bb);
+    Vec d = S::Sub(max, S::Min(aa, bb));
+
+    typename S::Mask near = S::CmpLt(d, S::Set1(4.0f));
+    Vec t = S::Add(S::Mul(d, S::Select(near, S::Set1(0.5f), S::Set1(0.25f))),
+                   S::Select(near, S::Set1(-1.0f), S::Set1(-2.0f)));
+    Vec y = S::Select(near, S::Set1(log1pExpNear[6]), S::Set1(log1pExpFar[6]));
+    for (int k = 5; k >= 0; k--) {
+        y = S::Add(S::Mul(y, t),
+                   S::Select(near, S::Set1(log1pExpNear[k]), S::Set1(log1pExpFar[k])));
+    }
+    // The comparison fails for a NaN d, from infinite operands
+    y = S::Select(S::CmpLt(d, S::Set1(LOG1P_EXP_POLYNOMIAL_CUTOFF)), y, S::Set1(0.0f));
+    return S::Add(max, y);
+}
+}
+}
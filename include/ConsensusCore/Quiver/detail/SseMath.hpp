@@ -3,6 +3,7 @@
 #pragma once
 
 #include <xmmintrin.h>
+#include <climits>
 #include <limits>
 
 #include <ConsensusCore/Quiver/detail/sse_mathfun.h>
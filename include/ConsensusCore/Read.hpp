@@ -3,8 +3,10 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/Types.hpp>
 
 namespace ConsensusCore {
@@ -38,6 +40,15 @@ struct MappedRead : public Read
     bool PinStart;
     bool PinEnd;
 
+    // Optionally, where a prior alignment (e.g., the POA that built
+    // the template; see PoaConsensus::ToMappedRead) puts the read: for
+    // each column j in [0, TemplateEnd - TemplateStart] of the
+    // alignment of the read against its stranded template window, the
+    // rows of the read it passes through.  The first fill of the read
+    // is banded to at least these, which spares refills.  It describes
+    // the template as it was, so is dropped once mutations are applied.
+    std::vector<Interval> BandHint;
+
     MappedRead(const Read& read, StrandEnum strand, int templateStart, int templateEnd,
                bool pinStart = true, bool pinEnd = true);
 
@@ -0,0 +1,68 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Types.hpp>
+
+namespace ConsensusCore {
+
+/// \brief Mapped reads stored column by column in a file, which is
+///        memory mapped rather than read, so that it opens in constant
+///        time, and whose reads are views of the mapping.
+///
+/// The file holds, after a header, the per read columns---base offsets,
+/// name offsets, template starts and ends, chemistry IDs and strand and
+/// pinning flags---then the names, the chemistry names, the bases of
+/// all the reads end to end, and the float feature tracks
+/// (SequenceAsFloat, InsQv, SubsQv, DelQv, DelTag and MergeQv) laid
+/// out as the bases are.  The tracks are kept as floats, as
+/// QvSequenceFeatures keeps them, so that the features of a read share
+/// the mapping rather than copying it; the mapping stays open as long
+/// as any of them does, and is private, so that writes to them never
+/// reach the file.  Only the name and chemistry strings of a read are
+/// copied.  Band hints are not stored.
+///
+/// The file is in the byte order of the machine that wrote it; opening
+/// one in the other order, or not a read store, or truncated, throws
+/// InvalidInputError.  A read's columns are checked as it is viewed.
+class ReadStore : private boost::noncopyable
+{
+public:
+    explicit ReadStore(const std::string& filename);
+
+    /// \brief Write the reads to a new read store file
+    static void Write(const std::string& filename, const std::vector<MappedRead>& reads);
+
+    int NumReads() const;
+    int64_t NumBases() const;
+
+    /// \brief The names of the chemistries of the reads
+    std::vector<std::string> Chemistries() const;
+
+    /// \brief A view of read i
+    MappedRead ReadAt(int i) const;
+
+    /// \brief Views of reads [begin, end)
+    std::vector<MappedRead> Reads(int begin, int end) const;
+
+private:
+    class Mapping;
+    struct Layout;
+
+    char* Section(int64_t offset) const;
+    std::string String(const uint64_t* offsets, const char* chars, uint64_t numChars,
+                       int i) const;
+
+private:
+    boost::shared_ptr<Mapping> mapping_;
+    boost::shared_ptr<Layout> layout_;
+};
+}
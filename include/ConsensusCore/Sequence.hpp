@@ -2,11 +2,80 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#include <cstddef>
 #include <string>
+#include <vector>
 
 namespace ConsensusCore {
 char ComplementaryBase(char base);
 std::string Complement(const std::string& input);
 std::string Reverse(const std::string& input);
 std::string ReverseComplement(const std::string& input);
+
+#ifndef SWIG
+/// \brief Write the complement, or reverse complement, of the length
+///        bases at input into output, which must have room for them.
+///        Complement may write over its input; ReverseComplement's
+///        output must not overlap its input.
+///
+/// Runs of ACGT, upper or lower case, are complemented 32 bases at a
+/// time where the library has AVX2 kernels and the CPU allows them
+/// (see SimdWidth); other characters go through the table
+/// ComplementaryBase uses.
+void Complement(const char* input, int length, char* output);
+void ReverseComplement(const char* input, int length, char* output);
+#endif  // !SWIG
+
+/// \brief A sequence of the bases ACGT, packed four to a byte.
+///
+/// Bases are coded A = 0, C = 1, G = 2, T = 3, so a base's complement
+/// is its code's bitwise complement; ReverseComplement reverses and
+/// complements a word of 32 bases at a time.
+class PackedSequence
+{
+public:
+    PackedSequence();
+
+    /// Throws InvalidInputError if bases holds anything but ACGT.
+    explicit PackedSequence(const std::string& bases);
+
+    int Length() const { return length_; }
+
+    /// The code, and base, at position i
+    int Code(int i) const
+    {
+        return (words_[i / BASES_PER_WORD] >> (2 * (i % BASES_PER_WORD))) & 3;
+    }
+    char Base(int i) const { return "ACGT"[Code(i)]; }
+
+    std::string ToString() const;
+
+    PackedSequence ReverseComplement() const;
+
+    /// The bytes of the packed bases
+    size_t Bytes() const { return words_.size() * sizeof(uint64_t); }
+
+    bool operator==(const PackedSequence& other) const;
+
+private:
+    static const int BASES_PER_WORD = 32;
+
+    // Base i in bits [2 (i mod 32), 2 (i mod 32) + 2) of word i / 32;
+    // the bits past the last base are zero
+    std::vector<uint64_t> words_;
+    int length_;
+};
+
+#ifndef SWIG
+namespace detail {
+// The AVX2 kernels, which must only be called if the CPU supports
+// AVX2.  They write the whole 32-base blocks of input, returning the
+// bases written: the first of input, for Complement, and the last, for
+// ReverseComplement.
+int ComplementAvx2(const char* input, int length, char* output);
+int ReverseComplementAvx2(const char* input, int length, char* output);
+}
+#endif  // !SWIG
 }
@@ -0,0 +1,234 @@
+// Author: David Alexander
+
+/// \file  Simd.hpp
+/// \brief Lane-width-generic wrappers for the single precision vector
+///        intrinsics used by the matrices, evaluators and recursors.
+
+#pragma once
+
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <stdint.h>
+#include <xmmintrin.h>
+
+/// \brief Compiles a function for the given instruction set, whatever
+///        the flags of its translation unit.
+#ifdef __GNUC__
+#define CONSENSUSCORE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CONSENSUSCORE_TARGET(isa)
+#endif
+
+/// \brief The instruction set of the width-generic kernels: the
+///        N-suffixed templates of the matrices, evaluators and
+///        combiners, and the recursors built of them.
+///
+/// All translation units are compiled with the baseline flags.  The
+/// ones instantiating the kernels 8 or 16 wide define this, before any
+/// include, to CONSENSUSCORE_TARGET("avx2") or ("avx512f"); as only the
+/// width-generic templates change instruction set, no inline function
+/// is compiled differently in two translation units, and the linker
+/// cannot keep an AVX copy of one for the baseline code.
+#ifndef CONSENSUSCORE_SIMD_TARGET
+#define CONSENSUSCORE_SIMD_TARGET
+#endif
+
+namespace ConsensusCore {
+
+/// \brief Operations on a vector of W floats.
+///
+/// Simd<4> (SSE) is always available.  The operations of Simd<8> are
+/// compiled for AVX2, and those of Simd<16> for AVX-512F, so they may
+/// only be called from code of the same instruction set, and on a CPU
+/// that has it.  Masks produced by the comparisons are only meaningful
+/// as arguments to Select.  LoadHalf and StoreHalf, which convert from
+/// and to W IEEE half floats, require F16C.
+template <int W>
+struct Simd;
+
+template <>
+struct Simd<4>
+{
+    typedef __m128 Vec;
+    typedef __m128 Mask;
+
+    static Vec Load(const float* p) { return _mm_loadu_ps(p); }
+    static void Store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+    static Vec Set1(float x) { return _mm_set_ps1(x); }
+#ifdef __F16C__
+    static Vec LoadHalf(const uint16_t* p)
+    {
+        return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));  // NOLINT
+    }
+    static void StoreHalf(uint16_t* p, Vec v)
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p),  // NOLINT
+                         _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif  // __F16C__
+
+    static Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+    static Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+    static Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+    static Vec Max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+    static Vec Min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+
+    static Mask CmpEq(Vec a, Vec b) { return _mm_cmpeq_ps(a, b); }
+    static Mask CmpLt(Vec a, Vec b) { return _mm_cmplt_ps(a, b); }
+    static Mask CmpLe(Vec a, Vec b) { return _mm_cmple_ps(a, b); }
+
+    // a where mask is set, b elsewhere
+    static Vec Select(Mask mask, Vec a, Vec b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // Whether the mask is set in any lane
+    static bool Any(Mask mask) { return _mm_movemask_ps(mask) != 0; }
+
+    // The lanes of v moved up one, lane i to lane i + 1, with x in lane 0
+    static Vec ShiftIn(Vec v, float x)
+    {
+        Vec shifted = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4));
+        return _mm_move_ss(shifted, _mm_set_ss(x));
+    }
+};
+
+#define AVX2 CONSENSUSCORE_TARGET("avx2")
+template <>
+struct Simd<8>
+{
+    typedef __m256 Vec;
+    typedef __m256 Mask;
+
+    AVX2 static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+    AVX2 static void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+    AVX2 static Vec Set1(float x) { return _mm256_set1_ps(x); }
+#ifdef __F16C__
+    AVX2 static Vec LoadHalf(const uint16_t* p)
+    {
+        return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));  // NOLINT
+    }
+    AVX2 static void StoreHalf(uint16_t* p, Vec v)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p),  // NOLINT
+                         _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif  // __F16C__
+
+    AVX2 static Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    AVX2 static Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+    AVX2 static Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+    AVX2 static Vec Max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+    AVX2 static Vec Min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+
+    AVX2 static Mask CmpEq(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    AVX2 static Mask CmpLt(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    AVX2 static Mask CmpLe(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+
+    AVX2 static Vec Select(Mask mask, Vec a, Vec b) { return _mm256_blendv_ps(b, a, mask); }
+
+    AVX2 static bool Any(Mask mask) { return _mm256_movemask_ps(mask) != 0; }
+
+    AVX2 static Vec ShiftIn(Vec v, float x)
+    {
+        Vec shifted = _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6));
+        return _mm256_blend_ps(shifted, _mm256_set1_ps(x), 0x1);
+    }
+
+    // The pieces of the cephes exp/log kernels that need integer ops
+    AVX2 static Vec Floor(Vec x) { return _mm256_floor_ps(x); }
+
+    // 2^n, for integral n within the normal exponent range
+    AVX2 static Vec Pow2(Vec n)
+    {
+        __m256i e = _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(0x7f));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+    }
+
+    // As frexpf: returns the mantissa, in [0.5, 1), and stores the exponent
+    AVX2 static Vec Frexp(Vec x, Vec* e)
+    {
+        __m256i bits = _mm256_castps_si256(x);
+        __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0x7e));
+        *e = _mm256_cvtepi32_ps(exponent);
+        __m256i mantissa = _mm256_and_si256(bits, _mm256_set1_epi32(~0x7f800000));
+        return _mm256_or_ps(_mm256_castsi256_ps(mantissa), _mm256_set1_ps(0.5f));
+    }
+};
+#undef AVX2
+
+#define AVX512F CONSENSUSCORE_TARGET("avx512f")
+// GCC's unmasked AVX-512 intrinsics pass the self-initialized
+// _mm512_undefined_* as the masked-off source, which it then warns may be
+// used uninitialized; the zero-masking forms, with every lane selected,
+// are the same instructions without it.
+template <>
+struct Simd<16>
+{
+    typedef __m512 Vec;
+    typedef __mmask16 Mask;
+
+    static const Mask All = 0xFFFF;
+
+    AVX512F static Vec Load(const float* p) { return _mm512_loadu_ps(p); }
+    AVX512F static void Store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+    AVX512F static Vec Set1(float x) { return _mm512_set1_ps(x); }
+#ifdef __F16C__
+    AVX512F static Vec LoadHalf(const uint16_t* p)
+    {
+        return _mm512_maskz_cvtph_ps(
+            All, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));  // NOLINT
+    }
+    AVX512F static void StoreHalf(uint16_t* p, Vec v)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p),  // NOLINT
+                            _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif  // __F16C__
+
+    AVX512F static Vec Add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+    AVX512F static Vec Sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+    AVX512F static Vec Mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+    AVX512F static Vec Max(Vec a, Vec b) { return _mm512_maskz_max_ps(All, a, b); }
+    AVX512F static Vec Min(Vec a, Vec b) { return _mm512_maskz_min_ps(All, a, b); }
+
+    AVX512F static Mask CmpEq(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    AVX512F static Mask CmpLt(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    AVX512F static Mask CmpLe(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+
+    AVX512F static Vec Select(Mask mask, Vec a, Vec b) { return _mm512_mask_blend_ps(mask, b, a); }
+
+    AVX512F static bool Any(Mask mask) { return mask != 0; }
+
+    AVX512F static Vec ShiftIn(Vec v, float x)
+    {
+        Vec shifted = _mm512_permutexvar_ps(
+            _mm512_setr_epi32(15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14), v);
+        return _mm512_mask_blend_ps(0x1, shifted, _mm512_set1_ps(x));
+    }
+
+    AVX512F static Vec Floor(Vec x)
+    {
+        return _mm512_maskz_roundscale_ps(All, x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    }
+
+    AVX512F static Vec Pow2(Vec n)
+    {
+        __m512i e = _mm512_add_epi32(_mm512_maskz_cvttps_epi32(All, n), _mm512_set1_epi32(0x7f));
+        return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(All, e, 23));
+    }
+
+    AVX512F static Vec Frexp(Vec x, Vec* e)
+    {
+        __m512i bits = _mm512_castps_si512(x);
+        __m512i exponent =
+            _mm512_sub_epi32(_mm512_maskz_srli_epi32(All, bits, 23), _mm512_set1_epi32(0x7e));
+        *e = _mm512_maskz_cvtepi32_ps(All, exponent);
+        __m512i mantissa = _mm512_and_si512(bits, _mm512_set1_epi32(~0x7f800000));
+        return _mm512_castsi512_ps(
+            _mm512_or_si512(mantissa, _mm512_castps_si512(_mm512_set1_ps(0.5f))));
+    }
+};
+#undef AVX512F
+}
@@ -9,4 +9,13 @@ namespace ConsensusCore {
 // in R.   If `asPhred` is true, the probability is converted
 // to the "phred" quality scale via Q=-10*log10(p)
 double BinomialSurvival(int q, int size, double prob, bool asPhred = false);
+
+// BinomialSurvival of each site (q[i], size[i], prob[i]), into
+// survival[0, nSurvival), which is malloc'd and the caller's to free.
+// The sites share a cached table of log-factorials, and are evaluated
+// on numThreads threads.  Throws InvalidInputError if the arrays differ
+// in length, or a site has a negative size or a prob outside [0, 1].
+void BinomialSurvivalBatch(int qDim, int* q, int sizeDim, int* size, int probDim, double* prob,
+                           double** survival, int* nSurvival, bool asPhred = false,
+                           int numThreads = 1);
 }
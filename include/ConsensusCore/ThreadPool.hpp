@@ -0,0 +1,60 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ConsensusCore {
+
+/// \brief A minimal fork-join pool of worker threads.
+///
+/// ParallelFor(n, fn) invokes fn(i) once for every i in [0, n) and
+/// blocks until all invocations have returned.  The calling thread
+/// participates in the work, so a pool constructed with numThreads
+/// workers spawns numThreads - 1 helper threads.  Which thread runs a
+/// given index is unspecified; callers needing reproducible results
+/// should write into per-index slots and reduce afterwards, in index
+/// order.
+///
+/// The first exception thrown by fn is rethrown in the caller once all
+/// running invocations have finished; remaining indices are skipped.
+/// Calls from several client threads are serialized, and a ParallelFor
+/// issued from inside a worker runs inline on that worker.
+class ThreadPool : private boost::noncopyable
+{
+public:
+    explicit ThreadPool(int numThreads);
+    ~ThreadPool();
+
+    int NumThreads() const;
+
+    void ParallelFor(int n, const std::function<void(int)>& fn);
+
+private:
+    void WorkerLoop();
+    void RunJob();
+
+private:
+    std::vector<std::thread> workers_;
+
+    std::mutex submitMutex_;
+    std::mutex mutex_;
+    std::condition_variable wakeCv_;
+    std::condition_variable doneCv_;
+
+    // State of the job currently in flight; guarded by mutex_
+    const std::function<void(int)>* job_;
+    int jobSize_;
+    int nextIndex_;
+    int busyWorkers_;
+    unsigned long generation_;
+    std::exception_ptr error_;
+    bool shutdown_;
+};
+}
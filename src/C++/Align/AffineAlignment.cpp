@@ -3,122 +3,100 @@
 #include <ConsensusCore/Align/AffineAlignment.hpp>
 
 #include <ConsensusCore/Align/PairwiseAlignment.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
 #include <ConsensusCore/Sequence.hpp>
 #include <ConsensusCore/Utils.hpp>
 
 #include <algorithm>
-#include <boost/numeric/ublas/matrix.hpp>
-#include <boost/numeric/ublas/matrix_proxy.hpp>
+#include <boost/type_traits.hpp>
 #include <cassert>
 #include <cfloat>
 #include <string>
 #include <vector>
 
+#include "AffineAlignmentImpl.hpp"
+#include "AlignWorkspace.hpp"
+
 namespace CC = ConsensusCore;
 
 namespace {
-class IupacAware;
-class Standard;
-
-static float MAX4(float a, float b, float c, float d)
-{
-    return std::max(std::max(a, b), std::max(c, d));
-}
-
-inline bool IsIupacPartialMatch(char iupacCode, char b)
+// The match and gap matrices restricted to the diagonals j - i in
+// [lo, hi], stored a row at a time; entries off the band read as
+// -FLT_MAX.
+class BandedAffineMatrices
 {
-    assert(iupacCode != b);
-
-    switch (iupacCode) {
-        case 'R':
-            return (b == 'A' || b == 'G');
-        case 'Y':
-            return (b == 'C' || b == 'T');
-        case 'S':
-            return (b == 'G' || b == 'C');
-        case 'W':
-            return (b == 'A' || b == 'T');
-        case 'K':
-            return (b == 'G' || b == 'T');
-        case 'M':
-            return (b == 'A' || b == 'C');
-        default:
-            return false;
+public:
+    BandedAffineMatrices(int I, int lo, int hi)
+        : lo_(lo), stride_(hi - lo + 1), m_((I + 1) * stride_, -FLT_MAX), gap_(m_)
+    {
     }
-}
 
-template <typename C>
-inline float MatchScore(char t, char q, float matchScore, float mismatchScore,
-                        float partialMatchScore);
+    bool InBand(int i, int j) const { return j - i >= lo_ && j - i < lo_ + stride_; }
 
-template <>
-inline float MatchScore<Standard>(char t, char q, float matchScore, float mismatchScore, float)
-{
-    return (t == q ? matchScore : mismatchScore);
-}
+    float M(int i, int j) const { return InBand(i, j) ? m_[Index(i, j)] : -FLT_MAX; }
+    float GAP(int i, int j) const { return InBand(i, j) ? gap_[Index(i, j)] : -FLT_MAX; }
 
-template <>
-inline float MatchScore<IupacAware>(char t, char q, float matchScore, float mismatchScore,
-                                    float partialMatchScore)
-{
-    if (t == q) {
-        return matchScore;
-    } else if (IsIupacPartialMatch(t, q)) {
-        return partialMatchScore;
-    } else if (IsIupacPartialMatch(q, t)) {
-        return partialMatchScore;
-    } else {
-        return mismatchScore;
-    }  // NOLINT
-}
+    float& M(int i, int j) { return m_[Index(i, j)]; }
+    float& GAP(int i, int j) { return gap_[Index(i, j)]; }
+
+private:
+    int Index(int i, int j) const { return i * stride_ + (j - i - lo_); }
+
+    int lo_;
+    int stride_;
+    std::vector<float> m_;
+    std::vector<float> gap_;
+};
 
+// The scalar recursion of the two-state model, over the band only
 template <class C>
-CC::PairwiseAlignment* AlignAffineGeneric(const std::string& target, const std::string& query,
-                                          CC::AffineAlignmentParams params)
+void FillAffineBanded(const std::string& target, const std::string& query,
+                      const CC::AffineAlignmentParams& params, int lo, int hi,
+                      BandedAffineMatrices* mats)
 {
-    // Implementation follows the textbook "two-state" affine gap model
-    // description from Durbin et. al
-    using boost::numeric::ublas::matrix;
-
+    const BandedAffineMatrices& m = *mats;
+    const C matchScore(params);
     int I = query.length();
     int J = target.length();
-    matrix<float> M(I + 1, J + 1);
-    matrix<float> GAP(I + 1, J + 1);
-
-    // Initialization
-    M(0, 0) = 0;
-    GAP(0, 0) = -FLT_MAX;
-    for (int i = 1; i <= I; ++i) {
-        M(i, 0) = -FLT_MAX;
-        GAP(i, 0) = params.GapOpen + (i - 1) * params.GapExtend;
-    }
-    for (int j = 1; j <= J; ++j) {
-        M(0, j) = -FLT_MAX;
-        GAP(0, j) = params.GapOpen + (j - 1) * params.GapExtend;
+    mats->M(0, 0) = 0;
+    for (int j = 1; j <= std::min(J, hi); ++j) {
+        mats->GAP(0, j) = params.GapOpen + (j - 1) * params.GapExtend;
     }
-
-    // Main part of the recursion
     for (int i = 1; i <= I; ++i) {
-        for (int j = 1; j <= J; ++j) {
-            float matchScore = MatchScore<C>(target[j - 1], query[i - 1], params.MatchScore,
-                                             params.MismatchScore, params.PartialMatchScore);
-            M(i, j) = std::max(M(i - 1, j - 1), GAP(i - 1, j - 1)) + matchScore;
-            GAP(i, j) = MAX4(M(i, j - 1) + params.GapOpen, GAP(i, j - 1) + params.GapExtend,
-                             M(i - 1, j) + params.GapOpen, GAP(i - 1, j) + params.GapExtend);
+        if (i <= -lo) {
+            mats->GAP(i, 0) = params.GapOpen + (i - 1) * params.GapExtend;
+        }
+        for (int j = std::max(1, i + lo); j <= std::min(J, i + hi); ++j) {
+            mats->M(i, j) = std::max(m.M(i - 1, j - 1), m.GAP(i - 1, j - 1)) +
+                            matchScore(target[j - 1], query[i - 1]);
+            mats->GAP(i, j) = std::max(
+                std::max(m.M(i, j - 1) + params.GapOpen, m.GAP(i, j - 1) + params.GapExtend),
+                std::max(m.M(i - 1, j) + params.GapOpen, m.GAP(i - 1, j) + params.GapExtend));
         }
     }
+}
 
-    // Perform the traceback
+// Trace back the gapped target and query into alnTarget and alnQuery
+template <class Matrices>
+void AffineTraceback(const std::string& target, const std::string& query,
+                     const CC::AffineAlignmentParams& params, const Matrices& mats,
+                     std::string* alnTarget, std::string* alnQuery)
+{
+    int I = query.length();
+    int J = target.length();
     const int MATCH_MATRIX = 1;
     const int GAP_MATRIX = 2;
 
-    std::string raQuery, raTarget;
+    std::string& raQuery = *alnQuery;
+    std::string& raTarget = *alnTarget;
+    raQuery.clear();
+    raTarget.clear();
     int i = I, j = J;
-    int mat = (M(I, J) >= GAP(I, J) ? MATCH_MATRIX : GAP_MATRIX);
+    int mat = (mats.M(I, J) >= mats.GAP(I, J) ? MATCH_MATRIX : GAP_MATRIX);
     int iPrev, jPrev, matPrev;
     while (i > 0 || j > 0) {
         if (mat == MATCH_MATRIX) {
-            matPrev = (M(i - 1, j - 1) >= GAP(i - 1, j - 1) ? MATCH_MATRIX : GAP_MATRIX);
+            matPrev = (mats.M(i - 1, j - 1) >= mats.GAP(i - 1, j - 1) ? MATCH_MATRIX : GAP_MATRIX);
             iPrev = i - 1;
             jPrev = j - 1;
             raQuery.push_back(query[iPrev]);
@@ -126,10 +104,10 @@ CC::PairwiseAlignment* AlignAffineGeneric(const std::string& target, const std::
         } else {
             assert(mat == GAP_MATRIX);
             float s[4];
-            s[0] = (j > 0 ? M(i, j - 1) + params.GapOpen : -FLT_MAX);
-            s[1] = (j > 0 ? GAP(i, j - 1) + params.GapExtend : -FLT_MAX);
-            s[2] = (i > 0 ? M(i - 1, j) + params.GapOpen : -FLT_MAX);
-            s[3] = (i > 0 ? GAP(i - 1, j) + params.GapExtend : -FLT_MAX);
+            s[0] = (j > 0 ? mats.M(i, j - 1) + params.GapOpen : -FLT_MAX);
+            s[1] = (j > 0 ? mats.GAP(i, j - 1) + params.GapExtend : -FLT_MAX);
+            s[2] = (i > 0 ? mats.M(i - 1, j) + params.GapOpen : -FLT_MAX);
+            s[3] = (i > 0 ? mats.GAP(i - 1, j) + params.GapExtend : -FLT_MAX);
             int argMax = std::max_element(s, s + 4) - s;
 
             matPrev = ((argMax == 0 || argMax == 2) ? MATCH_MATRIX : GAP_MATRIX);
@@ -153,12 +131,81 @@ CC::PairwiseAlignment* AlignAffineGeneric(const std::string& target, const std::
     }
 
     assert(raQuery.length() == raTarget.length());
-    return new CC::PairwiseAlignment(CC::Reverse(raTarget), CC::Reverse(raQuery));
+    std::reverse(raQuery.begin(), raQuery.end());
+    std::reverse(raTarget.begin(), raTarget.end());
+}
+
+template <class C>
+float AlignAffineGeneric(const std::string& target, const std::string& query,
+                         const CC::AffineAlignmentParams& params, CC::detail::AffineMatrices* mats,
+                         std::string* alnTarget, std::string* alnQuery)
+{
+    // Implementation follows the textbook "two-state" affine gap model
+    // description from Durbin et. al
+    int I = query.length();
+    int J = target.length();
+    int W = (CC::SimdWidth() >= 8) ? 8 : 4;
+    mats->Reset(I, J, W, params);
+    if (W == 8) {
+        CC::detail::FillAffineAvx2(target, query, params,
+                                   boost::is_same<C, CC::detail::IupacAwareMatchScores>::value,
+                                   mats);
+    } else {
+        CC::detail::FillAffineStriped<C, 4>(target, query, params, mats);
+    }
+    AffineTraceback(target, query, params, *mats, alnTarget, alnQuery);
+    return std::max(mats->M(I, J), mats->GAP(I, J));
+}
+
+// Does the path of the alignment run along an edge of the band [lo, hi]
+// that is not also an edge of the matrices?
+bool TouchesBandEdge(const CC::PairwiseAlignment& aln, int I, int J, int lo, int hi)
+{
+    const std::string& t = aln.Target();
+    const std::string& q = aln.Query();
+    int i = 0, j = 0;
+    for (size_t k = 0; k <= t.length(); ++k) {
+        if ((j - i == lo && lo > -I) || (j - i == hi && hi < J)) return true;
+        if (k == t.length()) break;
+        if (t[k] != '-') ++j;
+        if (q[k] != '-') ++i;
+    }
+    return false;
 }
 }
 
 namespace ConsensusCore {
 
+namespace detail {
+AffineMatrices::AffineMatrices() : I_(0), J_(0), W_(1), L_(1) {}
+
+AffineMatrices::AffineMatrices(int I, int J, int W, const AffineAlignmentParams& params)
+{
+    Reset(I, J, W, params);
+}
+
+void AffineMatrices::Reset(int I, int J, int W, const AffineAlignmentParams& params)
+{
+    I_ = I;
+    J_ = J;
+    W_ = W;
+    L_ = std::max(1, (I + W - 1) / W);
+    topM_.assign(J + 1, 0);
+    topGap_.assign(J + 1, 0);
+    m_.assign((J + 1) * L_ * W, -FLT_MAX);
+    gap_.assign((J + 1) * L_ * W, -FLT_MAX);
+    topM_[0] = 0;
+    topGap_[0] = -FLT_MAX;
+    for (int i = 1; i <= I; ++i) {
+        gap_[Index(i, 0)] = params.GapOpen + (i - 1) * params.GapExtend;
+    }
+    for (int j = 1; j <= J; ++j) {
+        topM_[j] = -FLT_MAX;
+        topGap_[j] = params.GapOpen + (j - 1) * params.GapExtend;
+    }
+}
+}
+
 AffineAlignmentParams::AffineAlignmentParams(float matchScore, float mismatchScore, float gapOpen,
                                              float gapExtend, float partialMatchScore)
     : MatchScore(matchScore)
@@ -179,15 +226,66 @@ AffineAlignmentParams IupacAwareAffineAlignmentParams()
     return AffineAlignmentParams(0, -1.0, -1.0, -0.5, -0.25);
 }
 
+namespace detail {
+float AlignAffineInWorkspace(const std::string& target, const std::string& query,
+                             const AffineAlignmentParams& params, bool iupacAware,
+                             AlignWorkspace* ws, std::string* alnTarget, std::string* alnQuery)
+{
+    if (iupacAware) {
+        return AlignAffineGeneric<IupacAwareMatchScores>(target, query, params, &ws->Affine,
+                                                         alnTarget, alnQuery);
+    } else {
+        return AlignAffineGeneric<StandardMatchScores>(target, query, params, &ws->Affine,
+                                                       alnTarget, alnQuery);
+    }
+}
+}
+
 PairwiseAlignment* AlignAffine(const std::string& target, const std::string& query,
                                AffineAlignmentParams params)
 {
-    return AlignAffineGeneric<Standard>(target, query, params);
+    detail::AffineMatrices mats;
+    std::string alnTarget, alnQuery;
+    AlignAffineGeneric<detail::StandardMatchScores>(target, query, params, &mats, &alnTarget,
+                                                    &alnQuery);
+    return new PairwiseAlignment(alnTarget, alnQuery);
 }
 
 PairwiseAlignment* AlignAffineIupac(const std::string& target, const std::string& query,
                                     AffineAlignmentParams params)
 {
-    return AlignAffineGeneric<IupacAware>(target, query, params);
+    detail::AffineMatrices mats;
+    std::string alnTarget, alnQuery;
+    AlignAffineGeneric<detail::IupacAwareMatchScores>(target, query, params, &mats, &alnTarget,
+                                                      &alnQuery);
+    return new PairwiseAlignment(alnTarget, alnQuery);
+}
+
+PairwiseAlignment* AlignAffineBanded(const std::string& target, const std::string& query,
+                                     AffineAlignmentParams params, int bandCenter, int bandWidth)
+{
+    int I = query.length();
+    int J = target.length();
+    int w = std::max(bandWidth, 1);
+    while (true) {
+        // The band must hold both corners, and need never be wider
+        // than the matrices
+        int lo = std::max(-I, std::min(std::min(bandCenter - w, 0), J - I));
+        int hi = std::min(J, std::max(std::max(bandCenter + w, 0), J - I));
+        if (lo == -I && hi == J) {
+            return AlignAffine(target, query, params);
+        }
+
+        BandedAffineMatrices mats(I, lo, hi);
+        FillAffineBanded<detail::StandardMatchScores>(target, query, params, lo, hi, &mats);
+        std::string alnTarget, alnQuery;
+        AffineTraceback(target, query, params, mats, &alnTarget, &alnQuery);
+        PairwiseAlignment* aln = new PairwiseAlignment(alnTarget, alnQuery);
+        if (!TouchesBandEdge(*aln, I, J, lo, hi)) {
+            return aln;
+        }
+        delete aln;
+        w *= 2;
+    }
 }
 }
@@ -0,0 +1,28 @@
+// Author: David Alexander
+
+// The 8-wide (AVX2) affine alignment fill.  Only the width-generic
+// kernels are compiled for AVX2 (see CONSENSUSCORE_SIMD_TARGET); nothing
+// here may be called unless the CPU supports it.
+
+#define CONSENSUSCORE_SIMD_TARGET CONSENSUSCORE_TARGET("avx2")
+
+#include <ConsensusCore/Align/AffineAlignment.hpp>
+
+#include <string>
+
+#include "AffineAlignmentImpl.hpp"
+
+namespace ConsensusCore {
+namespace detail {
+
+void FillAffineAvx2(const std::string& target, const std::string& query,
+                    const AffineAlignmentParams& params, bool iupacAware, AffineMatrices* mats)
+{
+    if (iupacAware) {
+        FillAffineStriped<IupacAwareMatchScores, 8>(target, query, params, mats);
+    } else {
+        FillAffineStriped<StandardMatchScores, 8>(target, query, params, mats);
+    }
+}
+}
+}
@@ -0,0 +1,227 @@
+// Author: David Alexander
+
+// The striped fill of the affine alignment matrices, for any SIMD
+// lane count; AffineAlignment.cpp instantiates it for SSE, and
+// AffineAlignmentAvx2.cpp for AVX2.
+
+#pragma once
+
+#include <ConsensusCore/Align/AffineAlignment.hpp>
+#include <ConsensusCore/Simd.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <string>
+#include <vector>
+
+namespace ConsensusCore {
+namespace detail {
+
+/// \brief Match and mismatch scores, by whether the bases are equal.
+class StandardMatchScores
+{
+public:
+    explicit StandardMatchScores(const AffineAlignmentParams& params)
+        : match_(params.MatchScore), mismatch_(params.MismatchScore)
+    {
+    }
+
+    float operator()(char t, char q) const { return (t == q ? match_ : mismatch_); }
+
+private:
+    float match_;
+    float mismatch_;
+};
+
+/// \brief Match scores that also give partial credit to a base against
+///        a two-base IUPAC code standing for it (A against M = A/C,
+///        say).
+///
+/// Each code is mapped to the set of bases it stands for, as a 4-bit
+/// mask, and the score of two unequal codes is looked up in a 16 x 16
+/// table over the masks.  Codes of three or four bases, and other
+/// characters, partially match nothing.
+class IupacAwareMatchScores
+{
+public:
+    explicit IupacAwareMatchScores(const AffineAlignmentParams& params)
+        : match_(params.MatchScore)
+    {
+        const char* codes = "ACGTRYSWKM";
+        const int masks[] = {1, 2, 4, 8, 1 | 4, 2 | 8, 2 | 4, 1 | 8, 4 | 8, 1 | 2};
+        std::fill(masks_, masks_ + 256, 0);
+        for (int k = 0; codes[k] != '\0'; k++) {
+            masks_[static_cast<unsigned char>(codes[k])] = masks[k];
+        }
+        for (int a = 0; a < 16; a++) {
+            for (int b = 0; b < 16; b++) {
+                bool partial = (a & b) != 0 && ((Bases(a) == 2 && Bases(b) == 1) ||
+                                                (Bases(a) == 1 && Bases(b) == 2));
+                table_[a * 16 + b] = partial ? params.PartialMatchScore : params.MismatchScore;
+            }
+        }
+    }
+
+    float operator()(char t, char q) const
+    {
+        return (t == q ? match_
+                       : table_[masks_[static_cast<unsigned char>(t)] * 16 +
+                                masks_[static_cast<unsigned char>(q)]]);
+    }
+
+private:
+    static int Bases(int mask) { return (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1) + (mask >> 3); }
+
+    float match_;
+    unsigned char masks_[256];
+    float table_[256];
+};
+
+/// \brief The match and gap matrices of the two-state affine model,
+///        for a query of I bases (rows) and a target of J (columns).
+///
+/// Rows 1..I of each column are striped for a SIMD width W: with
+/// L = ceil(I / W) segments, row i is lane (i - 1) / L of segment
+/// (i - 1) % L, so the rows a lane holds are consecutive and a
+/// segment's predecessor rows are the segment before it.  Row 0 is
+/// kept apart.  Reset reuses the storage of earlier alignments.
+class AffineMatrices
+{
+public:
+    AffineMatrices();
+    AffineMatrices(int I, int J, int W, const AffineAlignmentParams& params);
+
+    // Size for and initialize the edges of a new alignment
+    void Reset(int I, int J, int W, const AffineAlignmentParams& params);
+
+    int Rows() const { return I_ + 1; }
+    int Columns() const { return J_ + 1; }
+    int Width() const { return W_; }
+    int Segments() const { return L_; }
+
+    float M(int i, int j) const { return (i == 0) ? topM_[j] : m_[Index(i, j)]; }
+    float GAP(int i, int j) const { return (i == 0) ? topGap_[j] : gap_[Index(i, j)]; }
+
+    // Column j of rows 1..I, as Segments() vectors of Width()
+    float* MColumn(int j) { return &m_[j * L_ * W_]; }
+    float* GapColumn(int j) { return &gap_[j * L_ * W_]; }
+
+private:
+    int Index(int i, int j) const { return (j * L_ + (i - 1) % L_) * W_ + (i - 1) / L_; }
+
+    int I_;
+    int J_;
+    int W_;
+    int L_;
+    std::vector<float> topM_;
+    std::vector<float> topGap_;
+    std::vector<float> m_;
+    std::vector<float> gap_;
+};
+
+/// \brief Fill the matrices, column by column, W rows at a time.
+///
+/// The match matrix of a column only needs the column before, so it
+/// is filled a segment at a time, from a striped profile of the match
+/// scores of the query against each target base.  The gap matrix
+/// within a column is a running maximum down the rows; it is first
+/// run within each lane, and then the carry from the end of each lane
+/// into the next lane is propagated until it no longer raises any
+/// entry (the "lazy F" loop of Farrar's striped Smith-Waterman).
+/// Every entry is the same sum of the same terms as in the scalar
+/// recursion, so the matrices, and tracebacks from them, are the
+/// same.
+template <typename C, int W>
+CONSENSUSCORE_SIMD_TARGET void FillAffineStriped(const std::string& target,
+                                                 const std::string& query,
+                                                 const AffineAlignmentParams& params,
+                                                 AffineMatrices* mats)
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+
+    int I = query.length();
+    int J = target.length();
+    int L = mats->Segments();
+    assert(mats->Width() == W && mats->Rows() == I + 1 && mats->Columns() == J + 1);
+
+    // The profile: for each target base, its match scores against the
+    // query, striped as the columns are.  Rows past the end of the
+    // query score zero.
+    const C matchScore(params);
+    std::vector<int> profileOf(256, -1);
+    std::vector<float> profiles;
+    for (int j = 0; j < J; j++) {
+        unsigned char t = target[j];
+        if (profileOf[t] >= 0) continue;
+        profileOf[t] = profiles.size();
+        profiles.resize(profiles.size() + L * W, 0.0f);
+        float* profile = &profiles[profileOf[t]];
+        for (int i = 1; i <= I; i++) {
+            profile[((i - 1) % L) * W + (i - 1) / L] = matchScore(target[j], query[i - 1]);
+        }
+    }
+
+    const Vec gapOpen = S::Set1(params.GapOpen);
+    const Vec gapExtend = S::Set1(params.GapExtend);
+    const Vec negInf = S::Set1(-FLT_MAX);
+
+    for (int j = 1; j <= J; j++) {
+        const float* Mp = mats->MColumn(j - 1);
+        const float* Gp = mats->GapColumn(j - 1);
+        float* Mc = mats->MColumn(j);
+        float* Gc = mats->GapColumn(j);
+        const float* profile = &profiles[profileOf[static_cast<unsigned char>(target[j - 1])]];
+
+        float topM = mats->M(0, j);
+        float topGap = mats->GAP(0, j);
+        float topBest = std::max(mats->M(0, j - 1), mats->GAP(0, j - 1));
+
+        // The rows above those of segment 0 are the last segment's,
+        // a lane over, under row 0
+        Vec diag = S::ShiftIn(
+            S::Max(S::Load(&Mp[(L - 1) * W]), S::Load(&Gp[(L - 1) * W])), topBest);
+
+        // Match, and the gaps but for those extended down the lanes
+        for (int s = 0; s < L; s++) {
+            Vec m = S::Add(diag, S::Load(&profile[s * W]));
+            S::Store(&Mc[s * W], m);
+            diag = S::Max(S::Load(&Mp[s * W]), S::Load(&Gp[s * W]));
+        }
+        Vec up = S::ShiftIn(S::Load(&Mc[(L - 1) * W]), topM);
+        Vec carry = S::ShiftIn(negInf, topGap);
+        for (int s = 0; s < L; s++) {
+            Vec gap =
+                S::Max(S::Add(S::Load(&Mp[s * W]), gapOpen), S::Add(S::Load(&Gp[s * W]), gapExtend));
+            gap = S::Max(gap, S::Add(up, gapOpen));
+            gap = S::Max(gap, S::Add(carry, gapExtend));
+            S::Store(&Gc[s * W], gap);
+            up = S::Load(&Mc[s * W]);
+            carry = gap;
+        }
+
+        // Lazy F: carry the gaps extended off the end of each lane
+        // into the next, until they raise nothing
+        carry = S::ShiftIn(S::Load(&Gc[(L - 1) * W]), topGap);
+        for (int s = 0;;) {
+            Vec extended = S::Add(carry, gapExtend);
+            Vec gap = S::Load(&Gc[s * W]);
+            if (!S::Any(S::CmpLt(gap, extended))) break;
+            gap = S::Max(gap, extended);
+            S::Store(&Gc[s * W], gap);
+            carry = gap;
+            if (++s == L) {
+                s = 0;
+                carry = S::ShiftIn(S::Load(&Gc[(L - 1) * W]), topGap);
+            }
+        }
+    }
+}
+
+// The AVX2 kernels, in their own translation unit; they may only be
+// called if the CPU supports AVX2
+void FillAffineAvx2(const std::string& target, const std::string& query,
+                    const AffineAlignmentParams& params, bool iupacAware, AffineMatrices* mats);
+}
+}
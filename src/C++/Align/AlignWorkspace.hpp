@@ -0,0 +1,47 @@
+// Author: David Alexander
+
+// The pairwise aligners, run in storage the caller keeps between
+// calls; the batch entry points hold one workspace per task.
+
+#pragma once
+
+#include <ConsensusCore/Align/AffineAlignment.hpp>
+#include <ConsensusCore/Align/AlignConfig.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "AffineAlignmentImpl.hpp"
+
+namespace ConsensusCore {
+namespace detail {
+
+/// \brief The DP storage of the pairwise aligners, reused from one
+///        alignment to the next.
+struct AlignWorkspace
+{
+    std::vector<int> Score;    // Align's (I + 1) x (J + 1) matrix, by rows
+    std::vector<uint64_t> Pv;  // AlignEditDistance's vertical deltas,
+    std::vector<uint64_t> Mv;  // every column in turn
+    AffineMatrices Affine;     // AlignAffine's matrices
+};
+
+// Align, leaving the gapped target and query in alnTarget and alnQuery;
+// returns the score
+int AlignInWorkspace(const std::string& target, const std::string& query,
+                     const AlignConfig& config, AlignWorkspace* ws, std::string* alnTarget,
+                     std::string* alnQuery);
+
+// AlignEditDistance, likewise
+int AlignEditDistanceInWorkspace(const std::string& target, const std::string& query,
+                                 AlignWorkspace* ws, std::string* alnTarget,
+                                 std::string* alnQuery);
+
+// AlignAffine (or AlignAffineIupac), likewise; returns the best
+// score of the final cell
+float AlignAffineInWorkspace(const std::string& target, const std::string& query,
+                             const AffineAlignmentParams& params, bool iupacAware,
+                             AlignWorkspace* ws, std::string* alnTarget, std::string* alnQuery);
+}
+}
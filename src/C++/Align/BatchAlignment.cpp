@@ -0,0 +1,164 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Align/BatchAlignment.hpp>
+
+#include <ConsensusCore/Align/PairwiseAlignment.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
+#include <ConsensusCore/Types.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "AlignWorkspace.hpp"
+
+namespace ConsensusCore {
+
+PairwiseAlignmentBatch::PairwiseAlignmentBatch()
+    : targets_(), queries_(), transcripts_(), offsets_(1, 0), scores_()
+{
+}
+
+int PairwiseAlignmentBatch::Size() const { return scores_.size(); }
+
+std::string PairwiseAlignmentBatch::Target(int i) const
+{
+    return targets_.substr(offsets_.at(i), offsets_.at(i + 1) - offsets_[i]);
+}
+
+std::string PairwiseAlignmentBatch::Query(int i) const
+{
+    return queries_.substr(offsets_.at(i), offsets_.at(i + 1) - offsets_[i]);
+}
+
+std::string PairwiseAlignmentBatch::Transcript(int i) const
+{
+    return transcripts_.substr(offsets_.at(i), offsets_.at(i + 1) - offsets_[i]);
+}
+
+float PairwiseAlignmentBatch::Score(int i) const { return scores_.at(i); }
+
+float PairwiseAlignmentBatch::Accuracy(int i) const
+{
+    std::string::const_iterator begin = transcripts_.begin() + offsets_.at(i);
+    std::string::const_iterator end = transcripts_.begin() + offsets_.at(i + 1);
+    return static_cast<float>(std::count(begin, end, 'M')) / (end - begin);
+}
+
+PairwiseAlignment* PairwiseAlignmentBatch::Alignment(int i) const
+{
+    return new PairwiseAlignment(Target(i), Query(i));
+}
+
+const std::string& PairwiseAlignmentBatch::Targets() const { return targets_; }
+
+const std::string& PairwiseAlignmentBatch::Queries() const { return queries_; }
+
+const std::string& PairwiseAlignmentBatch::Transcripts() const { return transcripts_; }
+
+const std::vector<int>& PairwiseAlignmentBatch::Offsets() const { return offsets_; }
+
+const std::vector<float>& PairwiseAlignmentBatch::Scores() const { return scores_; }
+
+void PairwiseAlignmentBatch::Append(const std::string& alnTarget, const std::string& alnQuery,
+                                    float score)
+{
+    // The constructor checks the alignment and supplies its transcript
+    PairwiseAlignment aln(alnTarget, alnQuery);
+    targets_ += alnTarget;
+    queries_ += alnQuery;
+    transcripts_ += aln.Transcript();
+    offsets_.push_back(targets_.length());
+    scores_.push_back(score);
+}
+
+void PairwiseAlignmentBatch::Append(const PairwiseAlignmentBatch& other)
+{
+    int base = targets_.length();
+    targets_ += other.targets_;
+    queries_ += other.queries_;
+    transcripts_ += other.transcripts_;
+    for (size_t i = 1; i < other.offsets_.size(); i++) {
+        offsets_.push_back(base + other.offsets_[i]);
+    }
+    scores_.insert(scores_.end(), other.scores_.begin(), other.scores_.end());
+}
+
+namespace {
+typedef std::function<float(const std::string&, const std::string&, detail::AlignWorkspace*,
+                            std::string*, std::string*)>
+    Aligner;
+
+PairwiseAlignmentBatch* AlignEach(const std::vector<std::string>& targets,
+                                  const std::vector<std::string>& queries, int numThreads,
+                                  const Aligner& align)
+{
+    if (targets.size() != queries.size()) {
+        throw InvalidInputError("Batch alignment needs as many targets as queries");
+    }
+
+    // The pairs are dealt to the pool in contiguous chunks, several per
+    // thread to even out the load; a chunk reuses one workspace, and
+    // its alignments are joined to the others in order at the end
+    const int n = targets.size();
+    const int numChunks = std::min(n, 4 * std::max(numThreads, 1));
+    std::vector<PairwiseAlignmentBatch> chunks(numChunks);
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(numChunks, [&](int c) {
+        detail::AlignWorkspace ws;
+        std::string alnTarget, alnQuery;
+        for (int i = (int64_t(n) * c) / numChunks; i < (int64_t(n) * (c + 1)) / numChunks; i++) {
+            float score = align(targets[i], queries[i], &ws, &alnTarget, &alnQuery);
+            chunks[c].Append(alnTarget, alnQuery, score);
+        }
+    });
+
+    PairwiseAlignmentBatch* batch = new PairwiseAlignmentBatch();
+    for (int c = 0; c < numChunks; c++) {
+        batch->Append(chunks[c]);
+    }
+    return batch;
+}
+}
+
+PairwiseAlignmentBatch* AlignBatch(const std::vector<std::string>& targets,
+                                   const std::vector<std::string>& queries, AlignConfig config,
+                                   int numThreads)
+{
+    return AlignEach(targets, queries, numThreads,
+                     [&config](const std::string& target, const std::string& query,
+                               detail::AlignWorkspace* ws, std::string* alnTarget,
+                               std::string* alnQuery) {
+                         return detail::AlignInWorkspace(target, query, config, ws, alnTarget,
+                                                         alnQuery);
+                     });
+}
+
+PairwiseAlignmentBatch* AlignAffineBatch(const std::vector<std::string>& targets,
+                                         const std::vector<std::string>& queries,
+                                         AffineAlignmentParams params, int numThreads)
+{
+    return AlignEach(targets, queries, numThreads,
+                     [&params](const std::string& target, const std::string& query,
+                               detail::AlignWorkspace* ws, std::string* alnTarget,
+                               std::string* alnQuery) {
+                         return detail::AlignAffineInWorkspace(target, query, params, false, ws,
+                                                               alnTarget, alnQuery);
+                     });
+}
+
+PairwiseAlignmentBatch* AlignAffineIupacBatch(const std::vector<std::string>& targets,
+                                              const std::vector<std::string>& queries,
+                                              AffineAlignmentParams params, int numThreads)
+{
+    return AlignEach(targets, queries, numThreads,
+                     [&params](const std::string& target, const std::string& query,
+                               detail::AlignWorkspace* ws, std::string* alnTarget,
+                               std::string* alnQuery) {
+                         return detail::AlignAffineInWorkspace(target, query, params, true, ws,
+                                                               alnTarget, alnQuery);
+                     });
+}
+}
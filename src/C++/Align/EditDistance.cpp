@@ -0,0 +1,247 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Align/EditDistance.hpp>
+
+#include <ConsensusCore/Align/PairwiseAlignment.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "AlignWorkspace.hpp"
+
+//
+// Myers' recurrence keeps a column of the unit-cost DP as the vertical
+// deltas D(i, j) - D(i - 1, j), one bit per row in each of two
+// bit-vectors (Pv for +1, Mv for -1), and steps to the next column a
+// word of rows at a time.  Long queries take several words, chained by
+// the horizontal delta leaving the bottom of each (Hyyro's block-based
+// form, as in Myers 1999, "A fast bit-vector algorithm for approximate
+// string matching based on dynamic programming").
+//
+
+namespace ConsensusCore {
+
+namespace {
+typedef uint64_t Word;
+const int WORD_BITS = 64;
+
+// The match bit-vectors of the query: bit b of word w of the profile
+// of c is set where query[WORD_BITS * w + b] == c.  Characters the
+// query lacks share an empty profile.
+class QueryProfile
+{
+public:
+    explicit QueryProfile(const std::string& query)
+        : words_((query.length() + WORD_BITS - 1) / WORD_BITS), profileOf_(256, 0), eq_(words_)
+    {
+        for (size_t i = 0; i < query.length(); i++) {
+            unsigned char c = query[i];
+            if (profileOf_[c] == 0) {
+                profileOf_[c] = eq_.size();
+                eq_.resize(eq_.size() + words_);
+            }
+            eq_[profileOf_[c] + i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+        }
+    }
+
+    int Words() const { return words_; }
+    const Word* Eq(char c) const { return &eq_[profileOf_[static_cast<unsigned char>(c)]]; }
+
+private:
+    int words_;
+    std::vector<int> profileOf_;
+    std::vector<Word> eq_;
+};
+
+// Step one word of rows to the next column: given the vertical deltas
+// of the column before, the matches against the new column's target
+// base, and the horizontal delta entering above the word, leave the
+// new column's vertical deltas and return the horizontal delta at the
+// row `last` (the word's bottom row).
+inline int AdvanceBlock(Word* Pv, Word* Mv, Word Eq, int hin, Word last)
+{
+    Word Xv = Eq | *Mv;
+    if (hin < 0) Eq |= 1;
+    Word Xh = (((Eq & *Pv) + *Pv) ^ *Pv) | Eq;
+    Word Ph = *Mv | ~(Xh | *Pv);
+    Word Mh = *Pv & Xh;
+
+    int hout = 0;
+    if (Ph & last) {
+        hout = 1;
+    } else if (Mh & last) {
+        hout = -1;
+    }
+
+    Ph <<= 1;
+    Mh <<= 1;
+    if (hin < 0) {
+        Mh |= 1;
+    } else if (hin > 0) {
+        Ph |= 1;
+    }
+    *Pv = Mh | ~(Xv | Ph);
+    *Mv = Ph & Xv;
+    return hout;
+}
+
+inline Word LastRow(int I, int w, int words)
+{
+    return Word(1) << (w + 1 < words ? WORD_BITS - 1 : (I - 1) % WORD_BITS);
+}
+
+inline int PopCount(Word x) { return __builtin_popcountll(x); }
+
+// The sum of the vertical deltas of rows 1..i of a column
+int DeltaSum(const Word* Pv, const Word* Mv, int i)
+{
+    int sum = 0;
+    int w = 0;
+    for (; (w + 1) * WORD_BITS <= i; w++) {
+        sum += PopCount(Pv[w]) - PopCount(Mv[w]);
+    }
+    if (i % WORD_BITS != 0) {
+        Word mask = (Word(1) << (i % WORD_BITS)) - 1;
+        sum += PopCount(Pv[w] & mask) - PopCount(Mv[w] & mask);
+    }
+    return sum;
+}
+
+// The vertical delta D(i, j) - D(i - 1, j), for i >= 1
+inline int Delta(const Word* Pv, const Word* Mv, int i)
+{
+    Word bit = Word(1) << ((i - 1) % WORD_BITS);
+    int w = (i - 1) / WORD_BITS;
+    return (Pv[w] & bit) ? 1 : ((Mv[w] & bit) ? -1 : 0);
+}
+}
+
+int EditDistance(const std::string& target, const std::string& query, AlignMode mode)
+{
+    if (mode != GLOBAL && mode != SEMIGLOBAL) {
+        throw UnsupportedFeatureError("Only GLOBAL and SEMIGLOBAL edit distance supported");
+    }
+    int I = query.length();
+    int J = target.length();
+    if (I == 0) {
+        return (mode == GLOBAL) ? J : 0;
+    }
+
+    QueryProfile profile(query);
+    int words = profile.Words();
+    std::vector<Word> Pv(words, ~Word(0)), Mv(words, 0);
+
+    // Row 0 rises by one per column globally, and is flat when the
+    // target may be entered anywhere
+    int top = (mode == GLOBAL) ? 1 : 0;
+    int score = I;
+    int best = score;
+    for (int j = 0; j < J; j++) {
+        const Word* eq = profile.Eq(target[j]);
+        int h = top;
+        for (int w = 0; w < words; w++) {
+            h = AdvanceBlock(&Pv[w], &Mv[w], eq[w], h, LastRow(I, w, words));
+        }
+        score += h;
+        best = std::min(best, score);
+    }
+    return (mode == GLOBAL) ? score : best;
+}
+
+namespace detail {
+int AlignEditDistanceInWorkspace(const std::string& target, const std::string& query,
+                                 AlignWorkspace* ws, std::string* alnTarget,
+                                 std::string* alnQuery)
+{
+    int I = query.length();
+    int J = target.length();
+    QueryProfile profile(query);
+    int words = profile.Words();
+
+    // The vertical deltas of every column, column 0 rising by one a row
+    std::vector<Word>& Pv = ws->Pv;
+    std::vector<Word>& Mv = ws->Mv;
+    Pv.resize((J + 1) * words);
+    Mv.resize((J + 1) * words);
+    std::fill(Pv.begin(), Pv.begin() + words, ~Word(0));
+    std::fill(Mv.begin(), Mv.begin() + words, 0);
+    int d = (I == 0) ? J : I;
+    for (int j = 1; j <= J && I > 0; j++) {
+        std::copy(&Pv[(j - 1) * words], &Pv[j * words], &Pv[j * words]);
+        std::copy(&Mv[(j - 1) * words], &Mv[j * words], &Mv[j * words]);
+        const Word* eq = profile.Eq(target[j - 1]);
+        int h = 1;
+        for (int w = 0; w < words; w++) {
+            h = AdvanceBlock(&Pv[j * words + w], &Mv[j * words + w], eq[w], h,
+                             LastRow(I, w, words));
+        }
+        d += h;
+    }
+    int score = -d;
+
+    // Traceback, preferring moves in the order Align does; d is D(i, j)
+    std::string& raQuery = *alnQuery;
+    std::string& raTarget = *alnTarget;
+    raQuery.clear();
+    raTarget.clear();
+    int i = I, j = J;
+    while (i > 0 || j > 0) {
+        int move;
+        int dLeft = 0;
+        if (i == 0) {
+            move = 2;
+        } else if (j == 0) {
+            move = 1;
+        } else {
+            const Word* pv = &Pv[j * words];
+            const Word* mv = &Mv[j * words];
+            const Word* pvLeft = &Pv[(j - 1) * words];
+            const Word* mvLeft = &Mv[(j - 1) * words];
+            dLeft = (j - 1) + DeltaSum(pvLeft, mvLeft, i);
+            int dUp = d - Delta(pv, mv, i);
+            int dDiag = dLeft - Delta(pvLeft, mvLeft, i);
+            bool isMatch = (query[i - 1] == target[j - 1]);
+            move = ArgMax3(-(dDiag + (isMatch ? 0 : 1)), -(dUp + 1), -(dLeft + 1));
+        }
+        if (move == 0) {
+            d = (query[i - 1] == target[j - 1]) ? d : d - 1;
+            i--;
+            j--;
+            raQuery.push_back(query[i]);
+            raTarget.push_back(target[j]);
+        } else if (move == 1) {
+            d -= 1;
+            i--;
+            raQuery.push_back(query[i]);
+            raTarget.push_back('-');
+        } else {
+            d -= 1;
+            j--;
+            raQuery.push_back('-');
+            raTarget.push_back(target[j]);
+        }
+    }
+
+    std::reverse(raQuery.begin(), raQuery.end());
+    std::reverse(raTarget.begin(), raTarget.end());
+    return score;
+}
+}
+
+PairwiseAlignment* AlignEditDistance(const std::string& target, const std::string& query,
+                                     int* score)
+{
+    detail::AlignWorkspace ws;
+    std::string alnTarget, alnQuery;
+    int s = detail::AlignEditDistanceInWorkspace(target, query, &ws, &alnTarget, &alnQuery);
+    if (score != NULL) {
+        *score = s;
+    }
+    return new PairwiseAlignment(alnTarget, alnQuery);
+}
+}
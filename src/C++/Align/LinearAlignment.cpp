@@ -20,15 +20,13 @@
 
 #include <ConsensusCore/Align/LinearAlignment.hpp>
 #include <ConsensusCore/Align/PairwiseAlignment.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 #include <ConsensusCore/Utils.hpp>
 
-#include <boost/numeric/ublas/io.hpp>
-#include <boost/numeric/ublas/matrix.hpp>
-#include <boost/numeric/ublas/vector.hpp>
-
 #include <algorithm>
 #include <cassert>
 #include <string>
+#include <utility>
 #include <vector>
 
 using ConsensusCore::PairwiseAlignment;
@@ -37,6 +35,7 @@ using ConsensusCore::AlignConfig;
 using ConsensusCore::Align;
 using ConsensusCore::GLOBAL;
 using ConsensusCore::SEMIGLOBAL;
+using ConsensusCore::ThreadPool;
 
 //#define DEBUG_LINEAR_ALIGNMENT
 
@@ -50,12 +49,10 @@ namespace {
 
 using ConsensusCore::NotYetImplementedException;
 
-namespace ublas = boost::numeric::ublas;
-
-int INSERT_SCORE = -2;
-int DELETE_SCORE = -2;
-int MISMATCH_SCORE = -1;
-int MATCH_SCORE = +2;
+const int INSERT_SCORE = -2;
+const int DELETE_SCORE = -2;
+const int MISMATCH_SCORE = -1;
+const int MATCH_SCORE = +2;
 
 const AlignParams params(MATCH_SCORE, MISMATCH_SCORE, INSERT_SCORE, DELETE_SCORE);
 const AlignConfig config(params, GLOBAL);
@@ -68,7 +65,7 @@ const AlignConfig config(params, GLOBAL);
 std::string NWTranscript(const std::string& target, int j1, int j2, const std::string& query,
                          int i1, int i2, int* score)
 {
-    assert((i1 <= i2) && (j1 <= j2));
+    assert((i1 <= i2 + 1) && (j1 <= j2 + 1));
     // implement this inline later
     std::string T = target.substr(j1 - 1, j2 - j1 + 1);
     std::string Q = query.substr(i1 - 1, i2 - i1 + 1);
@@ -110,133 +107,203 @@ bool CheckTranscript(const std::string& transcript, const std::string& unalnTarg
 // i refers to query; j refers to target
 // this gives better balanced recursion in the (common) semiglobal case
 //
-std::string OptimalTranscript(const std::string& target, int j1, int j2, const std::string& query,
-                              int i1, int i2, ublas::vector<int>& buf1, ublas::vector<int>& buf2,
-                              int* score = NULL)
+// The recursion is run a level at a time: the forward and backward
+// score rows of every segment of a level (and the base cases) are
+// independent, so they are spread over a thread pool, and the pieces
+// of the transcript are only joined, once, at the end.
+//
+
+// A subproblem: take target[j1..j2] into query[i1..i2]
+struct Segment
 {
-    DEBUG_ONLY(std::string subtarget = target.substr(j1 - 1, j2 - j1 + 1);
-               std::string subquery = query.substr(i1 - 1, i2 - i1 + 1);)
+    int j1, j2, i1, i2;
 
-#ifdef DEBUG_LINEAR_ALIGNMENT
-    cout << "Called OptimalTranscript("
-         << "T[" << j1 << ".." << j2 << "], "
-         << "Q[" << i1 << ".." << i2 << "]) "
-         << " " << target << " " << query << " "
-         << "(" << subtarget << ", " << subquery << ")" << endl;
-#endif
-
-    std::string x, x1, x2;
-    int segmentScore;
-    const AlignParams& configParams = config.Params;
-
-    //
-    // Base case
-    //
-    if ((j2 - j1 <= 1) || (i2 - i1 <= 1)) {
-        x = NWTranscript(target, j1, j2, query, i1, i2, &segmentScore);
+    Segment(int j1_, int j2_, int i1_, int i2_) : j1(j1_), j2(j2_), i1(i1_), i2(i2_) {}
+
+    bool IsBaseCase() const { return (j2 - j1 <= 1) || (i2 - i1 <= 1); }
+    int Mid() const { return (i1 + i2) / 2; }
+};
+
+// A piece of the transcript, in order: a segment yet to be split, or
+// the transcript of a base case
+struct Piece
+{
+    Segment segment;
+    bool done;
+    std::string transcript;
+
+    explicit Piece(const Segment& s) : segment(s), done(false), transcript() {}
+};
+
+//
+// Advance a row of scores against t[0..n) (entry k of row is column k)
+// down numRows query bases, qs[0], qs[step], ...; edgeGap is the
+// score of the step down the edge column.
+//
+void ScoreRows(const char* t, int n, const char* qs, int numRows, int step, int edgeGap,
+               std::vector<int>* row)
+{
+    const AlignParams& p = config.Params;
+    std::vector<int> diagOrUp(n);
+    int* S = &(*row)[0];
+    int* D = &diagOrUp[0];
+    for (int r = 0; r < numRows; r++) {
+        char q = qs[r * step];
+
+        // The diagonal and vertical moves need only the row above, so
+        // this loop vectorizes
+        for (int k = 0; k < n; k++) {
+            D[k] = std::max(S[k + 1] + p.Insert, S[k] + (t[k] == q ? p.Match : p.Mismatch));
+        }
+
+        // The horizontal move is a running maximum along the row
+        int c = S[0] + edgeGap;
+        S[0] = c;
+        for (int k = 0; k < n; k++) {
+            c = std::max(D[k], c + p.Delete);
+            S[k + 1] = c;
+        }
     }
+}
 
-    //
-    // Recursive case
-    //
-    else {
-        assert(buf1.size() == target.size() + 1);
-        assert(buf2.size() == target.size() + 1);
+//
+// Score forward, i1 upto mid ( T[j1..j2] vs Q[i1..m] ), into
+// Sm(j1 - 1 + k) = (*Sm)[k]
+//
+void ForwardScores(const std::string& target, const std::string& query, const Segment& s,
+                   std::vector<int>* Sm)
+{
+    int n = s.j2 - s.j1 + 1;
+    Sm->resize(n + 1);
+    (*Sm)[0] = 0;
+    for (int k = 1; k <= n; k++) {
+        (*Sm)[k] = (*Sm)[k - 1] + config.Params.Delete;
+    }
+    ScoreRows(&target[s.j1 - 1], n, &query[s.i1 - 1], s.Mid() - s.i1 + 1, 1,
+              config.Params.Insert, Sm);
+}
 
-        ublas::vector<int>& Sm = buf1;  // S-
-        ublas::vector<int>& Sp = buf2;  // S+
+//
+// Score backwards, i2 downto mid ( T[j1..j2] vs Q[m+1..i2] ), into
+// Sp(j2 - k) = (*Sp)[k]
+//
+void BackwardScores(const std::string& target, const std::string& query, const Segment& s,
+                    std::vector<int>* Sp)
+{
+    int n = s.j2 - s.j1 + 1;
+    std::string reversed(target.rbegin() + (target.length() - s.j2),
+                         target.rbegin() + (target.length() - s.j1 + 1));
+    Sp->resize(n + 1);
+    (*Sp)[0] = 0;
+    for (int k = 1; k <= n; k++) {
+        (*Sp)[k] = (*Sp)[k - 1] + config.Params.Delete;
+    }
+    ScoreRows(reversed.data(), n, &query[s.i2 - 1], s.i2 - s.Mid(), -1, config.Params.Delete,
+              Sp);
+}
 
-        int mid = (i1 + i2) / 2;
+std::string OptimalTranscript(const std::string& target, const std::string& query,
+                              ThreadPool* pool, int* score = NULL)
+{
+    std::vector<Piece> pieces(1, Piece(Segment(1, target.length(), 1, query.length())));
+    int rootScore = 0;
+    bool atRoot = true;
 
-        //
-        // Score forward, i1 upto mid
-        // ( T[j1..j2] vs Q[i1..m] )
-        //
-        Sm(j1 - 1) = 0;
-        for (int j = j1; j <= j2; j++) {
-            Sm(j) = Sm(j - 1) + configParams.Delete;
+    while (true) {
+        // The work of this level: a base case, or the two score rows
+        // of a segment to split
+        std::vector<int> pending;
+        for (size_t p = 0; p < pieces.size(); p++) {
+            if (!pieces[p].done) pending.push_back(p);
         }
-        for (int i = i1; i <= mid; i++) {
-            int s, c;
-            s = Sm(j1 - 1);
-            c = Sm(j1 - 1) + configParams.Insert;
-            Sm(j1 - 1) = c;
-            for (int j = j1; j <= j2; j++) {
-                char t = target[j - 1];
-                char q = query[i - 1];
-                c = Max3(Sm(j) + configParams.Insert,
-                         s + (t == q ? configParams.Match : configParams.Mismatch),
-                         c + configParams.Delete);
-                s = Sm(j);
-                Sm(j) = c;
+        if (pending.empty()) break;
+
+        std::vector<std::vector<int> > Sm(pending.size()), Sp(pending.size());
+        std::vector<int> baseScores(pending.size());
+        pool->ParallelFor(2 * pending.size(), [&](int task) {
+            int n = task / 2;
+            Piece& piece = pieces[pending[n]];
+            const Segment& s = piece.segment;
+            if (s.IsBaseCase()) {
+                if (task % 2 == 0) {
+                    piece.transcript =
+                        NWTranscript(target, s.j1, s.j2, query, s.i1, s.i2, &baseScores[n]);
+                }
+            } else if (task % 2 == 0) {
+                ForwardScores(target, query, s, &Sm[n]);
+            } else {
+                BackwardScores(target, query, s, &Sp[n]);
             }
-        }
+        });
 
         //
-        // Score backwards, i2 downto mid
-        // ( T[j1..j2] vs Q[m+1..i2] )
+        // Find where optimal path crosses the mid row of each segment,
+        // and put its halves in its place
         //
-        Sp(j2) = 0;
-        for (int j = j2 - 1; j >= j1 - 1; j--) {
-            Sp(j) = Sp(j + 1) + configParams.Delete;
-        }
-        for (int i = i2 - 1; i >= mid; i--) {
-            int s, c;
-            s = Sp(j2);
-            c = Sp(j2) + configParams.Delete;
-            Sp(j2) = c;
-            for (int j = j2 - 1; j >= j1 - 1; j--) {
-                char t = target[j];  // j + 1 - 1
-                char q = query[i];   // i + 1 - 1
-                c = Max3(Sp(j) + configParams.Insert,
-                         s + (t == q ? configParams.Match : configParams.Mismatch),
-                         c + configParams.Delete);
-                s = Sp(j);
-                Sp(j) = c;
+        std::vector<Piece> next;
+        next.reserve(pieces.size() + pending.size());
+        size_t n = 0;
+        for (size_t p = 0; p < pieces.size(); p++) {
+            if (n < pending.size() && pending[n] == static_cast<int>(p)) {
+                const Segment& s = pieces[p].segment;
+                if (s.IsBaseCase()) {
+                    if (atRoot) rootScore = baseScores[n];
+                    next.push_back(std::move(pieces[p]));
+                    next.back().done = true;
+                } else {
+                    int bestJ = s.j1;
+                    int best = Sm[n][1] + Sp[n][s.j2 - s.j1];
+                    for (int j = s.j1 + 1; j <= s.j2; j++) {
+                        int sum = Sm[n][j - s.j1 + 1] + Sp[n][s.j2 - j];
+                        if (sum > best) {
+                            best = sum;
+                            bestJ = j;
+                        }
+                    }
+                    if (atRoot) rootScore = best;
+                    next.push_back(Piece(Segment(s.j1, bestJ, s.i1, s.Mid())));
+                    next.push_back(Piece(Segment(bestJ + 1, s.j2, s.Mid() + 1, s.i2)));
+                }
+                n++;
+            } else {
+                next.push_back(std::move(pieces[p]));
             }
         }
+        pieces.swap(next);
+        atRoot = false;
+    }
 
-        //
-        // Find where optimal path crosses the mid row
-        //
-        ublas::vector<int> sum = Sm + Sp;
-        int j = std::max_element(sum.begin() + j1, sum.begin() + j2 + 1) - sum.begin();
-        segmentScore = sum[j];
-
-        int segment1Score, segment2Score;
-        x1 = OptimalTranscript(target, j1, j, query, i1, mid, buf1, buf2, &segment1Score);
-        x2 = OptimalTranscript(target, j + 1, j2, query, mid + 1, i2, buf1, buf2, &segment2Score);
-        assert(segmentScore == segment1Score + segment2Score);
-        x = x1 + x2;
+    std::string x;
+    x.reserve(target.length() + query.length());
+    for (size_t p = 0; p < pieces.size(); p++) {
+        x += pieces[p].transcript;
     }
 
-    // Check 1: transcript has to take target[j1..j2] into query[i1..i2]
-    assert(CheckTranscript(x, subtarget, subquery));
+    // Check 1: transcript has to take target into query
+    assert(CheckTranscript(x, target, query));
 
     // Check 2: same score as basic N/W?
     DEBUG_ONLY(int peerScore;
-               PairwiseAlignment* peerAlignment = Align(subtarget, subquery, &peerScore, config);
-               assert(peerScore == segmentScore); delete peerAlignment;)
+               PairwiseAlignment* peerAlignment = Align(target, query, &peerScore, config);
+               assert(peerScore == rootScore); delete peerAlignment;)
 
     if (score != NULL) {
-        *score = segmentScore;
+        *score = rootScore;
     }
     return x;
 }
 }
 
 PairwiseAlignment* ConsensusCore::AlignLinear(const std::string& target, const std::string& query,
-                                              int* score, AlignConfig)
+                                              int* score, AlignConfig, int numThreads)
 {
-    int J = target.length();
-    ublas::vector<int> buf1(J + 1), buf2(J + 1);
-    std::string x =
-        OptimalTranscript(target, 1, target.length(), query, 1, query.length(), buf1, buf2, score);
+    ThreadPool pool(numThreads);
+    std::string x = OptimalTranscript(target, query, &pool, score);
     return PairwiseAlignment::FromTranscript(x, target, query);
 }
 
 PairwiseAlignment* ConsensusCore::AlignLinear(const std::string& target, const std::string& query,
-                                              AlignConfig config_)
+                                              AlignConfig config_, int numThreads)
 {
-    return AlignLinear(target, query, NULL, config_);
+    return AlignLinear(target, query, NULL, config_, numThreads);
 }
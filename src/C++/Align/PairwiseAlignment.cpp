@@ -3,7 +3,6 @@
 #include <ConsensusCore/Align/PairwiseAlignment.hpp>
 
 #include <algorithm>
-#include <boost/numeric/ublas/matrix.hpp>
 #include <string>
 #include <vector>
 
@@ -11,80 +10,141 @@
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
+#include "AlignWorkspace.hpp"
+
 namespace ConsensusCore {
 
-std::string PairwiseAlignment::Target() const { return target_; }
+namespace {
+const char TRANSCRIPT_CHARS[] = "MRID";
+const int MATCH_OP = 0;
+const int MISMATCH_OP = 1;
+const int INSERTION_OP = 2;
+const int DELETION_OP = 3;
+}
 
-std::string PairwiseAlignment::Query() const { return query_; }
+std::string PairwiseAlignment::Target() const
+{
+    std::string target(length_, '-');
+    int t = 0;
+    for (int i = 0; i < length_; i++) {
+        if (Op(i) != INSERTION_OP) {
+            target[i] = targetBases_[t++];
+        }
+    }
+    return target;
+}
 
-float PairwiseAlignment::Accuracy() const { return (static_cast<float>(Matches())) / Length(); }
+std::string PairwiseAlignment::Query() const
+{
+    std::string query(length_, '-');
+    int t = 0, q = 0;
+    for (int i = 0; i < length_; i++) {
+        switch (Op(i)) {
+            case MATCH_OP:
+                query[i] = targetBases_[t++];
+                break;
+            case MISMATCH_OP:
+                query[i] = queryOnlyBases_[q++];
+                t++;
+                break;
+            case INSERTION_OP:
+                query[i] = queryOnlyBases_[q++];
+                break;
+            case DELETION_OP:
+                t++;
+                break;
+        }
+    }
+    return query;
+}
 
-std::string PairwiseAlignment::Transcript() const { return transcript_; }
+float PairwiseAlignment::Accuracy() const { return (static_cast<float>(Matches())) / Length(); }
 
-int PairwiseAlignment::Matches() const
+std::string PairwiseAlignment::Transcript() const
 {
-    return std::count(transcript_.begin(), transcript_.end(), 'M');
+    std::string transcript(length_, 'Z');
+    for (int i = 0; i < length_; i++) {
+        transcript[i] = TRANSCRIPT_CHARS[Op(i)];
+    }
+    return transcript;
 }
 
+int PairwiseAlignment::Matches() const { return matches_; }
+
 int PairwiseAlignment::Errors() const { return Length() - Matches(); }
 
-int PairwiseAlignment::Mismatches() const
-{
-    return std::count(transcript_.begin(), transcript_.end(), 'R');
-}
+int PairwiseAlignment::Mismatches() const { return mismatches_; }
 
-int PairwiseAlignment::Insertions() const
-{
-    return std::count(transcript_.begin(), transcript_.end(), 'I');
-}
+int PairwiseAlignment::Insertions() const { return insertions_; }
 
-int PairwiseAlignment::Deletions() const
-{
-    return std::count(transcript_.begin(), transcript_.end(), 'D');
-}
+int PairwiseAlignment::Deletions() const { return deletions_; }
 
-int PairwiseAlignment::Length() const { return target_.length(); }
+int PairwiseAlignment::Length() const { return length_; }
 
 PairwiseAlignment::PairwiseAlignment(const std::string& target, const std::string& query)
-    : target_(target), query_(query), transcript_(target_.length(), 'Z')
+    : ops_((target.length() + 3) / 4, 0)
+    , length_(target.length())
+    , targetBases_()
+    , queryOnlyBases_()
+    , matches_(0)
+    , mismatches_(0)
+    , insertions_(0)
+    , deletions_(0)
 {
-    if (target_.length() != query_.length()) {
+    if (target.length() != query.length()) {
         throw InvalidInputError();
     }
-    for (unsigned int i = 0; i < target_.length(); i++) {
-        char t = target_[i];
-        char q = query_[i];
-        char tr;
+    for (int i = 0; i < length_; i++) {
+        char t = target[i];
+        char q = query[i];
+        int op;
 
         if (t == '-' && q == '-') {
             throw InvalidInputError();
         } else if (t == q) {
-            tr = 'M';
+            op = MATCH_OP;
+            matches_++;
+            targetBases_.push_back(t);
         } else if (t == '-') {
-            tr = 'I';
+            op = INSERTION_OP;
+            insertions_++;
+            queryOnlyBases_.push_back(q);
         } else if (q == '-') {
-            tr = 'D';
+            op = DELETION_OP;
+            deletions_++;
+            targetBases_.push_back(t);
         } else {
-            tr = 'R';
+            op = MISMATCH_OP;
+            mismatches_++;
+            targetBases_.push_back(t);
+            queryOnlyBases_.push_back(q);
         }  // NOLINT
 
-        transcript_[i] = tr;
+        ops_[i / 4] |= static_cast<uint8_t>(op << (2 * (i % 4)));
     }
 }
 
-PairwiseAlignment* Align(const std::string& target, const std::string& query, int* score,
-                         AlignConfig config)
+namespace detail {
+int AlignInWorkspace(const std::string& target, const std::string& query,
+                     const AlignConfig& config, AlignWorkspace* ws, std::string* alnTarget,
+                     std::string* alnQuery)
 {
-    using boost::numeric::ublas::matrix;
-
     const AlignParams& params = config.Params;
     if (config.Mode != GLOBAL) {
         throw UnsupportedFeatureError("Only GLOBAL alignment supported at present");
     }
 
+    // Plain edit distance goes to the bit-parallel engine
+    if (params.Match == 0 && params.Mismatch == -1 && params.Insert == -1 &&
+        params.Delete == -1) {
+        return AlignEditDistanceInWorkspace(target, query, ws, alnTarget, alnQuery);
+    }
+
     int I = query.length();
     int J = target.length();
-    matrix<int> Score(I + 1, J + 1);
+    ws->Score.resize((I + 1) * (J + 1));
+    int* S = &ws->Score[0];
+    auto Score = [S, J](int i, int j) -> int& { return S[i * (J + 1) + j]; };
 
     Score(0, 0) = 0;
     for (int i = 1; i <= I; i++) {
@@ -100,12 +160,12 @@ PairwiseAlignment* Align(const std::string& target, const std::string& query, in
                                Score(i - 1, j) + params.Insert, Score(i, j - 1) + params.Delete);
         }
     }
-    if (score != NULL) {
-        *score = Score(I, J);
-    }
 
     // Traceback, build up reversed aligned query, aligned target
-    std::string raQuery, raTarget;
+    std::string& raQuery = *alnQuery;
+    std::string& raTarget = *alnTarget;
+    raQuery.clear();
+    raTarget.clear();
     int i = I, j = J;
     while (i > 0 || j > 0) {
         int move;
@@ -138,8 +198,23 @@ PairwiseAlignment* Align(const std::string& target, const std::string& query, in
             raTarget.push_back(target[j]);
         }
     }
+    std::reverse(raQuery.begin(), raQuery.end());
+    std::reverse(raTarget.begin(), raTarget.end());
 
-    return new PairwiseAlignment(Reverse(raTarget), Reverse(raQuery));
+    return Score(I, J);
+}
+}
+
+PairwiseAlignment* Align(const std::string& target, const std::string& query, int* score,
+                         AlignConfig config)
+{
+    detail::AlignWorkspace ws;
+    std::string alnTarget, alnQuery;
+    int s = detail::AlignInWorkspace(target, query, config, &ws, &alnTarget, &alnQuery);
+    if (score != NULL) {
+        *score = s;
+    }
+    return new PairwiseAlignment(alnTarget, alnQuery);
 }
 
 PairwiseAlignment* Align(const std::string& target, const std::string& query, AlignConfig config)
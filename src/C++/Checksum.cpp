@@ -1,6 +1,5 @@
 // Author: David Alexander
 
-#include <boost/crc.hpp>
 #include <boost/format.hpp>
 
 #include <string>
@@ -10,21 +9,72 @@
 
 namespace ConsensusCore {
 
-std::string Checksum::Of(const QvSequenceFeatures& x)
+namespace {  // PRIVATE
+// The reflected Castagnoli polynomial
+const uint32_t CRC32C_POLY = 0x82f63b78;
+
+struct Crc32cTable
 {
-    boost::crc_32_type summer;
+    uint32_t Entries[256];
 
-    int len = x.Length();
-    summer.process_bytes(x.Sequence().get(), len * sizeof(char));        // NOLINT
-    summer.process_bytes(x.SequenceAsFloat.get(), len * sizeof(float));  // NOLINT
-    summer.process_bytes(x.InsQv.get(), len * sizeof(float));            // NOLINT
-    summer.process_bytes(x.SubsQv.get(), len * sizeof(float));           // NOLINT
-    summer.process_bytes(x.DelQv.get(), len * sizeof(float));            // NOLINT
-    summer.process_bytes(x.DelTag.get(), len * sizeof(float));           // NOLINT
-    summer.process_bytes(x.MergeQv.get(), len * sizeof(float));          // NOLINT
+    Crc32cTable()
+    {
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t crc = b;
+            for (int k = 0; k < 8; k++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+            }
+            Entries[b] = crc;
+        }
+    }
+};
 
-    int checksum = summer.checksum();
+bool UseSse42()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+}
+
+namespace detail {
+uint32_t Crc32cSoftware(uint32_t crc, const void* data, size_t length)
+{
+    static const Crc32cTable table;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; i++) {
+        crc = (crc >> 8) ^ table.Entries[(crc ^ p[i]) & 0xff];
+    }
+    return crc;
+}
+}
 
-    return (boost::format("0x%x") % checksum).str();
+uint32_t Checksum::Crc32c(const void* data, size_t length, uint32_t crc)
+{
+    static const bool sse42 = UseSse42();
+    crc = ~crc;
+    crc = sse42 ? detail::Crc32cSse42(crc, data, length)
+                : detail::Crc32cSoftware(crc, data, length);
+    return ~crc;
+}
+
+uint32_t Checksum::Crc32c(const QvSequenceFeatures& x)
+{
+    size_t len = x.Length();
+    uint32_t crc = Crc32c(x.Sequence().get(), len * sizeof(char));  // NOLINT
+    crc = Crc32c(x.SequenceAsFloat.get(), len * sizeof(float), crc);  // NOLINT
+    crc = Crc32c(x.InsQv.get(), len * sizeof(float), crc);            // NOLINT
+    crc = Crc32c(x.SubsQv.get(), len * sizeof(float), crc);           // NOLINT
+    crc = Crc32c(x.DelQv.get(), len * sizeof(float), crc);            // NOLINT
+    crc = Crc32c(x.DelTag.get(), len * sizeof(float), crc);           // NOLINT
+    crc = Crc32c(x.MergeQv.get(), len * sizeof(float), crc);          // NOLINT
+    return crc;
+}
+
+std::string Checksum::Of(const QvSequenceFeatures& x)
+{
+    return (boost::format("0x%x") % Crc32c(x)).str();
 }
 }
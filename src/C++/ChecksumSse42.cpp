@@ -0,0 +1,40 @@
+// Author: David Alexander
+
+// The SSE4.2 CRC-32C kernel, compiled for SSE4.2; it may not be called
+// unless the CPU supports it.
+
+#include <ConsensusCore/Checksum.hpp>
+
+#include <cstring>
+
+#include <ConsensusCore/Simd.hpp>
+
+#include <nmmintrin.h>
+
+namespace ConsensusCore {
+namespace detail {
+
+CONSENSUSCORE_TARGET("sse4.2") uint32_t Crc32cSse42(uint32_t crc, const void* data, size_t length)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; length >= 8; p += 8, length -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif  // __x86_64__
+    for (; length >= 4; p += 4, length -= 4) {
+        uint32_t word;
+        std::memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; length > 0; p++, length--) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+}
+}
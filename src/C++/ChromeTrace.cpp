@@ -0,0 +1,129 @@
+// Author: David Alexander
+
+#include <ConsensusCore/ChromeTrace.hpp>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+// The trace being recorded.  The buffers belong to it rather than to
+// their threads, so they outlive threads that exit mid-trace.  A trace
+// is numbered, so a thread holding a buffer of an earlier one knows to
+// take a new one.
+struct Trace
+{
+    std::mutex Mutex;
+    bool Recording;
+    std::atomic<uint64_t> Number;
+    std::string Filename;
+    std::list<std::vector<PerfTraceEvent> > Buffers;
+
+    Trace() : Recording(false), Number(0) {}
+};
+
+Trace& TheTrace()
+{
+    static Trace* trace = new Trace();
+    return *trace;
+}
+
+struct ThreadBuffer
+{
+    uint64_t Number;
+    std::vector<PerfTraceEvent>* Events;
+
+    ThreadBuffer() : Number(0), Events(NULL) {}
+};
+
+void Record(const PerfTraceEvent& event)
+{
+    static thread_local ThreadBuffer buffer;
+    Trace& trace = TheTrace();
+    uint64_t number = trace.Number.load(std::memory_order_relaxed);
+    if (buffer.Number != number) {
+        std::lock_guard<std::mutex> lock(trace.Mutex);
+        trace.Buffers.push_back(std::vector<PerfTraceEvent>());
+        buffer.Events = &trace.Buffers.back();
+        buffer.Number = number;
+    }
+    buffer.Events->push_back(event);
+}
+}  // PRIVATE
+
+void StartChromeTrace(const std::string& filename)
+{
+    if (!PerfTraceEnabled()) {
+        throw UnsupportedFeatureError("Tracing needs CONSENSUSCORE_PERF_TRACE defined");
+    }
+    Trace& trace = TheTrace();
+    {
+        std::lock_guard<std::mutex> lock(trace.Mutex);
+        if (trace.Recording) {
+            throw InvalidInputError("A trace is already being recorded");
+        }
+        trace.Recording = true;
+        trace.Number++;
+        trace.Filename = filename;
+        trace.Buffers.clear();
+    }
+    SetPerfTraceHook(Record);
+}
+
+void StopChromeTrace()
+{
+    Trace& trace = TheTrace();
+    std::list<std::vector<PerfTraceEvent> > buffers;
+    std::string filename;
+    {
+        std::lock_guard<std::mutex> lock(trace.Mutex);
+        if (!trace.Recording) {
+            throw InvalidInputError("No trace is being recorded");
+        }
+        SetPerfTraceHook(PerfTraceHook());
+        trace.Recording = false;
+        // Numbering anew sends the threads' stale buffers back for new
+        // ones, should a trace be started again
+        trace.Number++;
+        buffers.swap(trace.Buffers);
+        filename = trace.Filename;
+    }
+
+    // Times are in microseconds from the trace's first event
+    int64_t origin = INT64_MAX;
+    foreach (const std::vector<PerfTraceEvent>& events, buffers) {
+        if (!events.empty()) origin = std::min(origin, events.front().Nanoseconds);
+    }
+    std::ofstream out(filename.c_str());
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    char line[256];
+    foreach (const std::vector<PerfTraceEvent>& events, buffers) {
+        foreach (const PerfTraceEvent& e, events) {
+            std::snprintf(line, sizeof(line),
+                          "%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}",
+                          first ? "" : ",", e.Name, e.Begin ? "B" : "E",
+                          1e-3 * (e.Nanoseconds - origin), e.Thread);
+            out << line;
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    if (!out) {
+        throw InvalidInputError("Can't write trace " + filename);
+    }
+}
+}
@@ -1,15 +1,45 @@
 // Author: David Alexander
 
+#include <emmintrin.h>
 #include <algorithm>
 #include <cassert>
+#include <climits>
+#include <functional>
+#include <queue>
+#include <utility>
 #include <vector>
 
 #include <ConsensusCore/Coverage.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
+#include <ConsensusCore/Types.hpp>
 
 using std::vector;
 
 namespace ConsensusCore {
 
+namespace {  // PRIVATE
+// Replace x[0, n) by its running sums, four at a time: each vector is
+// summed in register, by two shifted adds, and carries the total so far
+inline void PrefixSum(int* x, int n)
+{
+    __m128i carry = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(x + i), v);
+        carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    int total = _mm_cvtsi128_si32(carry);
+    for (; i < n; i++) {
+        total += x[i];
+        x[i] = total;
+    }
+}
+}  // PRIVATE
+
 void CoverageInWindow(int tStartDim, int* tStart, int
 #ifndef NDEBUG
                                                       tEndDim
@@ -22,20 +52,22 @@ void CoverageInWindow(int tStartDim, int* tStart, int
 
     assert(tStartDim == tEndDim);
 
+    // Mark where each read starts and stops covering the window, then
+    // add up the marks
     int nReads = tStartDim;
     int winEnd = winStart + winLen;
     std::fill_n(coverage, winLen, 0);
     for (int read = 0; read < nReads; read++) {
-        int tStart_ = tStart[read];
-        int tEnd_ = tEnd[read];
-        for (int pos = max(tStart_, winStart); pos < min(tEnd_, winEnd); pos++) {
-            coverage[pos - winStart] += 1;
+        int begin = max(tStart[read], winStart);
+        int end = min(tEnd[read], winEnd);
+        if (begin < end) {
+            coverage[begin - winStart] += 1;
+            if (end < winEnd) coverage[end - winStart] -= 1;
         }
     }
+    PrefixSum(coverage, winLen);
 }
 
-#define CHUNK_SIZE 10000
-
 vector<Interval> CoveredIntervals(int minCoverage, int tStartDim, int* tStart, int
 #ifndef NDEBUG
                                                                                    tEndDim
@@ -44,55 +76,160 @@ vector<Interval> CoveredIntervals(int minCoverage, int tStartDim, int* tStart, i
                                   int* tEnd, int winStart, int winLen)
 {
     assert(tStartDim == tEndDim);
-    // assert(isSorted(tStart));  // find out how to get this ... it's C++11
-
-    // Approach: divide into chunks, find coverage in each chunk,
-    // then scan for covered windows ... careful to anneal windows
-    // spanning chunk boundaries.  We also rely on the sortedness of the
-    // tStart to restrict our attention to
 
+    // Approach: sweep across the window, from one read start or end to
+    // the next, keeping the ends of the reads covering the sweep in a
+    // heap; coverage only changes at those positions.  Sorted by tStart,
+    // as alignments usually come, the reads are taken in a single pass;
+    // otherwise they are sorted first.
+    int nReads = tStartDim;
     int winEnd = winStart + winLen;
-    int coverage[CHUNK_SIZE];
-    int currentIntervalStart = -1;
+    vector<std::pair<int, int> > sortedReads;
+    if (!std::is_sorted(tStart, tStart + nReads)) {
+        for (int read = 0; read < nReads; read++) {
+            sortedReads.push_back(std::make_pair(tStart[read], tEnd[read]));
+        }
+        std::sort(sortedReads.begin(), sortedReads.end());
+    }
+    auto startOf = [&](int read) {
+        return sortedReads.empty() ? tStart[read] : sortedReads[read].first;
+    };
+    auto endOf = [&](int read) {
+        return sortedReads.empty() ? tEnd[read] : sortedReads[read].second;
+    };
+
+    std::priority_queue<int, vector<int>, std::greater<int> > activeEnds;
     vector<Interval> intervals;
+    int currentIntervalStart = -1;
+    int read = 0;
+    int pos = winStart;
+    while (pos < winEnd) {
+        for (; read < nReads && startOf(read) <= pos; read++) {
+            if (endOf(read) > pos) activeEnds.push(endOf(read));
+        }
+        while (!activeEnds.empty() && activeEnds.top() <= pos) {
+            activeEnds.pop();
+        }
 
-    int startRowInChunk = 0;
-    for (int chunkStart = winStart; chunkStart < winEnd; chunkStart += CHUNK_SIZE) {
-        int chunkEnd = std::min(chunkStart + CHUNK_SIZE, winEnd);
-
-        // We compute a conservative guess of the rows that are involved in
-        // this chunk.  Not every row in the range [startRowInChunk, endRowInChunk)
-        // actually overlaps the chunk, but no rows not in that range intersect the
-        // chunk.
-        // startRowInChunk is computed by scanning from where it was for the last
-        // chunk.
-        // This is the best we can do within pulling in the nBackRead stuff.
-        int endRowInChunk = std::lower_bound(tStart, tStart + tStartDim, chunkEnd) - tStart;
-        for (; ((startRowInChunk < endRowInChunk) & (tEnd[startRowInChunk] < chunkStart));
-             startRowInChunk++)
-            ;
-
-        CoverageInWindow((endRowInChunk - startRowInChunk), tStart + startRowInChunk,
-                         (endRowInChunk - startRowInChunk), tEnd + startRowInChunk, chunkStart,
-                         CHUNK_SIZE, coverage);
-        int j = 0;
-        while (j < (chunkEnd - chunkStart)) {
-            if (coverage[j] >= minCoverage) {
-                if (currentIntervalStart == -1) {
-                    currentIntervalStart = chunkStart + j;
-                }
-            } else {
-                if (currentIntervalStart != -1) {
-                    intervals.push_back(Interval(currentIntervalStart, chunkStart + j));
-                    currentIntervalStart = -1;
-                }
-            }
-            j++;
+        bool covered = static_cast<int>(activeEnds.size()) >= minCoverage;
+        if (covered && currentIntervalStart == -1) {
+            currentIntervalStart = pos;
+        } else if (!covered && currentIntervalStart != -1) {
+            intervals.push_back(Interval(currentIntervalStart, pos));
+            currentIntervalStart = -1;
         }
+
+        // on to the next position the coverage may change at
+        int next = winEnd;
+        if (read < nReads) next = std::min(next, startOf(read));
+        if (!activeEnds.empty()) next = std::min(next, activeEnds.top());
+        pos = next;
     }
     if (currentIntervalStart != -1) {
         intervals.push_back(Interval(currentIntervalStart, winEnd));
     }
     return intervals;
 }
+
+CoverageIndex::CoverageIndex(int tStartDim, int* tStart, int tEndDim, int* tEnd)
+    : starts_(), ends_()
+{
+    if (tStartDim != tEndDim) {
+        throw InvalidInputError("CoverageIndex needs as many ends as starts");
+    }
+    // Empty reads cover nothing, and are left out
+    for (int read = 0; read < tStartDim; read++) {
+        if (tStart[read] < tEnd[read]) {
+            starts_.push_back(tStart[read]);
+            ends_.push_back(tEnd[read]);
+        }
+    }
+    std::sort(starts_.begin(), starts_.end());
+    std::sort(ends_.begin(), ends_.end());
+}
+
+int CoverageIndex::NumReads() const { return starts_.size(); }
+
+int CoverageIndex::Coverage(int pos) const
+{
+    // the reads started by pos, less those ended by it
+    return (std::upper_bound(starts_.begin(), starts_.end(), pos) - starts_.begin()) -
+           (std::upper_bound(ends_.begin(), ends_.end(), pos) - ends_.begin());
+}
+
+template <typename F>
+void CoverageIndex::ForEachRun(int winStart, int winEnd, F f) const
+{
+    if (winStart >= winEnd) return;
+    vector<int>::const_iterator start = std::upper_bound(starts_.begin(), starts_.end(), winStart);
+    vector<int>::const_iterator end = std::upper_bound(ends_.begin(), ends_.end(), winStart);
+    int coverage = (start - starts_.begin()) - (end - ends_.begin());
+    int pos = winStart;
+    while (pos < winEnd) {
+        int next = winEnd;
+        if (start != starts_.end()) next = std::min(next, *start);
+        if (end != ends_.end()) next = std::min(next, *end);
+        f(pos, next, coverage);
+        for (; start != starts_.end() && *start == next; ++start) {
+            coverage++;
+        }
+        for (; end != ends_.end() && *end == next; ++end) {
+            coverage--;
+        }
+        pos = next;
+    }
+}
+
+vector<Interval> CoverageIndex::CoveredIntervals(int minCoverage, int winStart, int winLen) const
+{
+    vector<Interval> intervals;
+    ForEachRun(winStart, winStart + winLen, [&](int begin, int end, int coverage) {
+        if (coverage < minCoverage) return;
+        if (!intervals.empty() && intervals.back().End == begin) {
+            intervals.back().End = end;
+        } else {
+            intervals.push_back(Interval(begin, end));
+        }
+    });
+    return intervals;
+}
+
+CoverageSummary CoverageIndex::Summary(int winStart, int winLen) const
+{
+    CoverageSummary summary;
+    if (winLen <= 0) return summary;
+    summary.MinCoverage = INT_MAX;
+    double total = 0;
+    ForEachRun(winStart, winStart + winLen, [&](int begin, int end, int coverage) {
+        summary.MinCoverage = std::min(summary.MinCoverage, coverage);
+        summary.MaxCoverage = std::max(summary.MaxCoverage, coverage);
+        total += static_cast<double>(coverage) * (end - begin);
+    });
+    summary.MeanCoverage = total / winLen;
+    return summary;
+}
+
+vector<vector<Interval> > CoverageIndex::CoveredIntervals(int minCoverage,
+                                                          const vector<Interval>& windows,
+                                                          int numThreads) const
+{
+    vector<vector<Interval> > intervals(windows.size());
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(windows.size(), [&](int w) {
+        intervals[w] =
+            CoveredIntervals(minCoverage, windows[w].Begin, windows[w].End - windows[w].Begin);
+    });
+    return intervals;
+}
+
+vector<CoverageSummary> CoverageIndex::Summaries(const vector<Interval>& windows,
+                                                 int numThreads) const
+{
+    vector<CoverageSummary> summaries(windows.size());
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(windows.size(), [&](int w) {
+        summaries[w] = Summary(windows[w].Begin, windows[w].End - windows[w].Begin);
+    });
+    return summaries;
+}
 }
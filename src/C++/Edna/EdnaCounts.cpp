@@ -9,6 +9,7 @@
 #include <iostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <ConsensusCore/Edna/EdnaCounts.hpp>
 #include <ConsensusCore/Edna/EdnaEvaluator.hpp>
@@ -21,6 +22,8 @@
 #include <ConsensusCore/Quiver/SimpleRecursor.hpp>
 #include <ConsensusCore/Quiver/detail/Combiner.hpp>
 #include <ConsensusCore/Quiver/detail/RecursorBase.hpp>
+#include <ConsensusCore/Quiver/detail/SseMath.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
@@ -30,9 +33,115 @@ using std::max;
 #define NEG_INF -FLT_MAX
 
 namespace ConsensusCore {
-INLINE_CALLEES void EdnaCounts::DoCount(Feature<int> channelRead, EdnaEvaluator& eval,
-                                        MutationScorer<SparseSseEdnaRecursor>& scorer, int j1,
-                                        int j2, float* results)
+
+namespace {  // PRIVATE
+const int CLASSES = 5;
+
+// The reads DoCountBatch counts together
+const int READS_PER_CHUNK = 4;
+
+// The larger of x and NEG_INF, so that sums of unreachable entries stay
+// finite
+inline __m128 Floor4(__m128 x) { return _mm_max_ps(x, _mm_set1_ps(NEG_INF)); }
+
+inline float Floor(float x) { return max(x, NEG_INF); }
+
+// out[c] = the log of the sum over the rows i in [begin, end) of class c
+// of exp(alpha(i, j1) + move[c] + beta(i + d, j2)), for c in [0, 5);
+// classes == NULL puts every row in class 0.
+//
+// The rows are taken four at a time.  A first pass finds the largest
+// term of each class, and a second sums the exponentials of the terms
+// less it, so a term costs one exp, where adding them up one by one in
+// log space costs an exp and a log each.
+void LogSumRows(const SparseMatrix& alpha, const SparseMatrix& beta, int j1, int j2, int d,
+                int begin, int end, const int* classes, const float* move, float* out)
+{
+    const __m128 negInf4 = _mm_set1_ps(NEG_INF);
+    const int nClasses = (classes != NULL) ? CLASSES : 1;
+    int vectorEnd = begin + (end - begin) / 4 * 4;
+
+    // the terms of rows [i, i + 4), and the class of each
+    auto terms4 = [&](int i, __m128* cls4) {
+        int c[4] = {0, 0, 0, 0};
+        if (classes != NULL) {
+            for (int k = 0; k < 4; k++) {
+                c[k] = classes[i + k];
+            }
+        }
+        *cls4 = _mm_set_ps(c[3], c[2], c[1], c[0]);
+        __m128 move4 = _mm_set_ps(move[c[3]], move[c[2]], move[c[1]], move[c[0]]);
+        return Floor4(_mm_add_ps(_mm_add_ps(alpha.Get4(i, j1), move4), beta.Get4(i + d, j2)));
+    };
+    auto term = [&](int i, int* c) {
+        *c = (classes != NULL) ? classes[i] : 0;
+        return Floor(alpha.Get(i, j1) + move[*c] + beta.Get(i + d, j2));
+    };
+
+    // the largest terms
+    __m128 max4[CLASSES];
+    for (int c = 0; c < nClasses; c++) {
+        max4[c] = negInf4;
+    }
+    for (int i = begin; i < vectorEnd; i += 4) {
+        __m128 cls4;
+        __m128 v4 = terms4(i, &cls4);
+        for (int c = 0; c < nClasses; c++) {
+            __m128 inClass = _mm_cmpeq_ps(cls4, _mm_set1_ps(c));
+            max4[c] = _mm_max_ps(max4[c], _mm_or_ps(_mm_and_ps(inClass, v4),
+                                                    _mm_andnot_ps(inClass, negInf4)));
+        }
+    }
+    float maxes[CLASSES];
+    for (int c = 0; c < nClasses; c++) {
+        ALIGN16_BEG float buf[4] ALIGN16_END;
+        _mm_store_ps(buf, max4[c]);
+        maxes[c] = max(max(buf[0], buf[1]), max(buf[2], buf[3]));
+    }
+    for (int i = vectorEnd; i < end; i++) {
+        int c;
+        float v = term(i, &c);
+        maxes[c] = max(maxes[c], v);
+    }
+
+    // the sums of the exponentials
+    __m128 sum4[CLASSES];
+    for (int c = 0; c < nClasses; c++) {
+        sum4[c] = _mm_setzero_ps();
+    }
+    for (int i = begin; i < vectorEnd; i += 4) {
+        __m128 cls4;
+        __m128 v4 = terms4(i, &cls4);
+        __m128i c4 = _mm_cvtps_epi32(cls4);
+        __m128 max4ByRow =
+            _mm_set_ps(maxes[_mm_extract_epi16(c4, 6)], maxes[_mm_extract_epi16(c4, 4)],
+                       maxes[_mm_extract_epi16(c4, 2)], maxes[_mm_extract_epi16(c4, 0)]);
+        __m128 e4 = exp_ps(_mm_sub_ps(v4, max4ByRow));
+        for (int c = 0; c < nClasses; c++) {
+            __m128 inClass = _mm_cmpeq_ps(cls4, _mm_set1_ps(c));
+            sum4[c] = _mm_add_ps(sum4[c], _mm_and_ps(inClass, e4));
+        }
+    }
+    float sums[CLASSES];
+    for (int c = 0; c < nClasses; c++) {
+        ALIGN16_BEG float buf[4] ALIGN16_END;
+        _mm_store_ps(buf, sum4[c]);
+        sums[c] = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+    }
+    for (int i = vectorEnd; i < end; i++) {
+        int c;
+        float v = term(i, &c);
+        sums[c] += std::exp(v - maxes[c]);
+    }
+
+    for (int c = 0; c < CLASSES; c++) {
+        out[c] = (c >= nClasses || maxes[c] == NEG_INF) ? NEG_INF : maxes[c] + std::log(sums[c]);
+    }
+}
+
+// results[0, 5) as DoCount finds them, for the given scorer and evaluator
+void Count(const int* channelRead, const EdnaEvaluator& eval,
+           const MutationScorer<SparseSseEdnaRecursor>& scorer, int j1, int j2, float* results)
 {
     const SparseMatrix* alpha = scorer.Alpha();
     const SparseMatrix* beta = scorer.Beta();
@@ -40,22 +149,88 @@ INLINE_CALLEES void EdnaCounts::DoCount(Feature<int> channelRead, EdnaEvaluator&
     int usedBegin, usedEnd;
     boost::tie(usedBegin, usedEnd) = RangeUnion(alpha->UsedRowRange(j1), beta->UsedRowRange(j2));
 
-    for (int k = 0; k < 5; k++)
-        results[k] = NEG_INF;
-
-    for (int i = usedBegin; i < usedEnd; i++) {
-        results[0] = detail::logAdd(
-            results[0], alpha->Get(i, j1) + eval.ScoreMove(j1, j2, 0) + beta->Get(i, j2));
+    float move[CLASSES];
+    for (int c = 0; c < CLASSES; c++) {
+        move[c] = eval.ScoreMove(j1, j2, c);
     }
 
+    // the moves observing nothing, from every row, and those observing
+    // the read base, from every row but the last
+    float stays[CLASSES];
+    LogSumRows(*alpha, *beta, j1, j2, 0, usedBegin, usedEnd, NULL, move, stays);
+
     int nRows = alpha->Rows();
     int usedCap = usedEnd < nRows - 1 ? usedEnd : nRows - 1;
+    LogSumRows(*alpha, *beta, j1, j2, 1, usedBegin, max(usedBegin, usedCap), channelRead, move,
+               results);
+    results[0] = (results[0] == NEG_INF) ? stays[0] : detail::logAdd(stays[0], results[0]);
+}
+}  // PRIVATE
+
+INLINE_CALLEES void EdnaCounts::DoCount(Feature<int> channelRead, EdnaEvaluator& eval,
+                                        MutationScorer<SparseSseEdnaRecursor>& scorer, int j1,
+                                        int j2, float* results)
+{
+    Count(channelRead.get(), eval, scorer, j1, j2, results);
+}
+
+void EdnaCounts::DoCountBatch(
+    const std::vector<Feature<int> >& channelReads,
+    const std::vector<const MutationScorer<SparseSseEdnaRecursor>*>& scorers, int numThreads,
+    float* counts)
+{
+    if (channelReads.size() != scorers.size()) {
+        throw InvalidInputError("DoCountBatch needs as many reads as scorers");
+    }
+    foreach (const MutationScorer<SparseSseEdnaRecursor>* scorer, scorers) {
+        if (scorer->CheckpointInterval() != 0) {
+            throw UnsupportedFeatureError("DoCountBatch needs whole alpha and beta matrices");
+        }
+    }
+
+    // The reads are dealt to the pool in contiguous chunks, each
+    // counting into its own slot.  The chunks are the same for any
+    // number of threads, so the counts add up in the same order.
+    const int n = scorers.size();
+    const int numChunks = (n + READS_PER_CHUNK - 1) / READS_PER_CHUNK;
+    std::vector<std::vector<double> > chunkCounts(numChunks,
+                                                  std::vector<double>(BATCH_COUNTS, 0.0));
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(numChunks, [&](int c) {
+        std::vector<double>& acc = chunkCounts[c];
+        float results[CLASSES];
+        for (int r = c * READS_PER_CHUNK; r < std::min(n, (c + 1) * READS_PER_CHUNK); r++) {
+            const MutationScorer<SparseSseEdnaRecursor>& scorer = *scorers[r];
+            const EdnaEvaluator& eval = *scorer.Evaluator();
+            const float score = scorer.Score();
+            const int tplLength = eval.TemplateLength();
+            for (int j1 = 0; j1 < tplLength; j1++) {
+                const int tplChannel = eval.templateBase(j1);
+                for (int move = STAY_COUNTS; move <= MERGE_COUNTS && j1 + move <= tplLength;
+                     move++) {
+                    Count(channelReads[r].get(), eval, scorer, j1, j1 + move, results);
+                    double* out = &acc[(move * 4 + tplChannel - 1) * CLASSES];
+                    double* mergeableOut =
+                        (move == STEP_COUNTS && eval.mergeable(j1))
+                            ? &acc[(MERGEABLE_STEP_COUNTS * 4 + tplChannel - 1) * CLASSES]
+                            : NULL;
+                    for (int obs = 0; obs < CLASSES; obs++) {
+                        if (results[obs] != NEG_INF) {
+                            double count = std::exp(static_cast<double>(results[obs]) -
+                                                    static_cast<double>(score));
+                            out[obs] += count;
+                            if (mergeableOut != NULL) mergeableOut[obs] += count;
+                        }
+                    }
+                }
+            }
+        }
+    });
 
-    for (int i = usedBegin; i < usedCap; i++) {
-        int readBase = channelRead[i];
-        results[readBase] =
-            detail::logAdd(results[readBase], alpha->Get(i, j1) + eval.ScoreMove(j1, j2, readBase) +
-                                                  beta->Get(i + 1, j2));
+    for (int c = 0; c < numChunks; c++) {
+        for (int k = 0; k < BATCH_COUNTS; k++) {
+            counts[k] = static_cast<float>(static_cast<double>(counts[k]) + chunkCounts[c][k]);
+        }
     }
 }
 }
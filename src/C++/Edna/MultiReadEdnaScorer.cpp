@@ -0,0 +1,246 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Edna/MultiReadEdnaScorer.hpp>
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Edna/EdnaCounts.hpp>
+#include <ConsensusCore/Logging.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+std::vector<int> EdnaChannels(const std::string& tpl)
+{
+    std::vector<int> channels(tpl.length());
+    for (size_t j = 0; j < tpl.length(); j++) {
+        switch (tpl[j]) {
+            case 'A':
+                channels[j] = 1;
+                break;
+            case 'C':
+                channels[j] = 2;
+                break;
+            case 'G':
+                channels[j] = 3;
+                break;
+            case 'T':
+                channels[j] = 4;
+                break;
+            default:
+                throw InvalidInputError("Edna templates must be of the bases ACGT");
+        }
+    }
+    return channels;
+}
+
+MultiReadEdnaScorer::MultiReadEdnaScorer(const std::string& tpl, const EdnaModelParams& params,
+                                         const BandingOptions& banding, int numThreads)
+    : tpl_(tpl)
+    , channelTpl_(EdnaChannels(tpl))
+    , params_(params)
+    , banding_(banding)
+    , numThreads_(numThreads)
+    , reads_()
+    , scorers_()
+{
+    if (tpl.empty()) {
+        throw InvalidInputError("MultiReadEdnaScorer needs a template");
+    }
+}
+
+MultiReadEdnaScorer::~MultiReadEdnaScorer()
+{
+    foreach (SparseSseEdnaMutationScorer* scorer, scorers_) {
+        delete scorer;
+    }
+}
+
+void MultiReadEdnaScorer::AddRead(const ChannelSequenceFeatures& read)
+{
+    AddReads(std::vector<ChannelSequenceFeatures>(1, read));
+}
+
+void MultiReadEdnaScorer::AddReads(const std::vector<ChannelSequenceFeatures>& reads)
+{
+    foreach (const ChannelSequenceFeatures& read, reads) {
+        if (read.Length() == 0) {
+            throw InvalidInputError("MultiReadEdnaScorer can't score empty reads");
+        }
+    }
+    int begin = reads_.size();
+    reads_.insert(reads_.end(), reads.begin(), reads.end());
+    scorers_.resize(reads_.size(), NULL);
+    Fill(begin);
+}
+
+int MultiReadEdnaScorer::NumReads() const { return reads_.size(); }
+
+const std::string& MultiReadEdnaScorer::Template() const { return tpl_; }
+
+void MultiReadEdnaScorer::Template(const std::string& tpl)
+{
+    if (tpl.empty()) {
+        throw InvalidInputError("MultiReadEdnaScorer needs a template");
+    }
+    channelTpl_ = EdnaChannels(tpl);
+    tpl_ = tpl;
+    Fill(0);
+}
+
+const EdnaModelParams& MultiReadEdnaScorer::Params() const { return params_; }
+
+void MultiReadEdnaScorer::Params(const EdnaModelParams& params)
+{
+    params_ = params;
+    Fill(0);
+}
+
+void MultiReadEdnaScorer::Fill(int begin)
+{
+    SparseSseEdnaRecursor recursor(ALL_MOVES, banding_);
+    ThreadPool pool(numThreads_);
+    pool.ParallelFor(NumReads() - begin, [&](int k) {
+        int r = begin + k;
+        EdnaEvaluator ev(reads_[r], tpl_, channelTpl_, params_);
+        SparseSseEdnaMutationScorer* scorer = new SparseSseEdnaMutationScorer(ev, recursor);
+        delete scorers_[r];
+        scorers_[r] = scorer;
+    });
+}
+
+float MultiReadEdnaScorer::BaselineScore() const
+{
+    float sum = 0.0f;
+    foreach (const SparseSseEdnaMutationScorer* scorer, scorers_) {
+        sum += scorer->Score();
+    }
+    return sum;
+}
+
+std::vector<float> MultiReadEdnaScorer::Scores() const
+{
+    std::vector<float> scores;
+    foreach (const SparseSseEdnaMutationScorer* scorer, scorers_) {
+        scores.push_back(scorer->Score());
+    }
+    return scores;
+}
+
+std::vector<float> MultiReadEdnaScorer::Counts() const
+{
+    std::vector<Feature<int> > channelReads;
+    foreach (const ChannelSequenceFeatures& read, reads_) {
+        channelReads.push_back(read.Channel);
+    }
+    std::vector<const SparseSseEdnaMutationScorer*> scorers(scorers_.begin(), scorers_.end());
+    std::vector<float> counts(EdnaCounts::BATCH_COUNTS, 0.0f);
+    EdnaCounts().DoCountBatch(channelReads, scorers, numThreads_, &counts[0]);
+    return counts;
+}
+
+const SparseSseEdnaMutationScorer* MultiReadEdnaScorer::Scorer(int readIndex) const
+{
+    if (readIndex < 0 || readIndex >= NumReads()) {
+        throw InvalidInputError("Read index out of range");
+    }
+    return scorers_[readIndex];
+}
+
+namespace {  // PRIVATE
+// The counts of the moves of the given kind from template channel t,
+// by observation
+const float* MoveCounts(const std::vector<float>& counts, int move, int t)
+{
+    return &counts[(move * 4 + t) * 5];
+}
+
+float Total(const float* obsCounts, int beginObs = 0)
+{
+    float total = 0.0f;
+    for (int obs = beginObs; obs < 5; obs++) {
+        total += obsCounts[obs];
+    }
+    return total;
+}
+}  // PRIVATE
+
+EdnaModelParams UpdateEdnaParams(const std::vector<float>& counts, const EdnaModelParams& params)
+{
+    if (counts.size() != EdnaCounts::BATCH_COUNTS) {
+        throw InvalidInputError("Edna counts are laid out as EdnaCounts::DoCountBatch lays them");
+    }
+
+    EdnaModelParams updated(params);
+    for (int t = 0; t < 4; t++) {
+        const float* stays = MoveCounts(counts, EdnaCounts::STAY_COUNTS, t);
+        const float* steps = MoveCounts(counts, EdnaCounts::STEP_COUNTS, t);
+        const float* merges = MoveCounts(counts, EdnaCounts::MERGE_COUNTS, t);
+        const float* mergeableSteps = MoveCounts(counts, EdnaCounts::MERGEABLE_STEP_COUNTS, t);
+
+        // Stays observe a read base, never the null observation
+        float nStays = Total(stays, 1);
+        float nSteps = Total(steps);
+        float nMerges = Total(merges);
+        float nMergeableSteps = Total(mergeableSteps);
+
+        if (nStays + nSteps + nMerges > 0) {
+            updated.pStay_[t] = nStays / (nStays + nSteps + nMerges);
+        }
+        // A merge is only possible where a step from a mergeable
+        // position could have been taken instead
+        if (nMerges + nMergeableSteps > 0) {
+            updated.pMerge_[t] = nMerges / (nMerges + nMergeableSteps);
+        }
+        for (int obs = 0; obs < 5; obs++) {
+            if (nSteps > 0) {
+                updated.moveDists_[t * 5 + obs] = steps[obs] / nSteps;
+            }
+            if (nStays > 0 && obs > 0) {
+                updated.stayDists_[t * 5 + obs] = stays[obs] / nStays;
+            }
+        }
+    }
+    return updated;
+}
+
+EdnaModelParams TrainEdnaParams(const std::vector<MultiReadEdnaScorer*>& scorers,
+                                int maxIterations, float minImprovement)
+{
+    if (scorers.empty()) {
+        throw InvalidInputError("TrainEdnaParams needs reads to train on");
+    }
+    EdnaModelParams params = scorers[0]->Params();
+    float score = 0.0f;
+    foreach (const MultiReadEdnaScorer* scorer, scorers) {
+        score += scorer->BaselineScore();
+    }
+    for (int iter = 0; iter < maxIterations; iter++) {
+        // E step: the expected counts of the moves of every read
+        std::vector<float> counts(EdnaCounts::BATCH_COUNTS, 0.0f);
+        foreach (const MultiReadEdnaScorer* scorer, scorers) {
+            std::vector<float> scorerCounts = scorer->Counts();
+            for (int k = 0; k < EdnaCounts::BATCH_COUNTS; k++) {
+                counts[k] += scorerCounts[k];
+            }
+        }
+
+        // M step, and the reads refilled under the new parameters
+        params = UpdateEdnaParams(counts, params);
+        float newScore = 0.0f;
+        foreach (MultiReadEdnaScorer* scorer, scorers) {
+            scorer->Params(params);
+            newScore += scorer->BaselineScore();
+        }
+        LDEBUG << "Edna EM iteration " << iter << ": log-likelihood " << newScore;
+
+        bool converged = (newScore - score < minImprovement);
+        score = newScore;
+        if (converged) break;
+    }
+    return params;
+}
+}
@@ -15,6 +15,13 @@ ConsensusCore::SequenceFeatures::SequenceFeatures(const std::string& seq)
 {
 }
 
+ConsensusCore::SequenceFeatures::SequenceFeatures(const Feature<char>& seq) : sequence_(seq) {}
+
+int64_t ConsensusCore::SequenceFeatures::AllocatedBytes() const
+{
+    return static_cast<int64_t>(sequence_.Length()) * sizeof(char);
+}
+
 namespace {
 void CheckTagFeature(ConsensusCore::Feature<float> feature)
 {
@@ -92,6 +99,21 @@ QvSequenceFeatures::QvSequenceFeatures(const std::string& seq, const Feature<flo
     CheckTagFeature(DelTag);
 }
 
+QvSequenceFeatures::QvSequenceFeatures(const Feature<char>& seq, const Feature<float> seqAsFloat,
+                                       const Feature<float> insQv, const Feature<float> subsQv,
+                                       const Feature<float> delQv, const Feature<float> delTag,
+                                       const Feature<float> mergeQv)
+    : SequenceFeatures(seq)
+    , SequenceAsFloat(seqAsFloat)
+    , InsQv(insQv)
+    , SubsQv(subsQv)
+    , DelQv(delQv)
+    , DelTag(delTag)
+    , MergeQv(mergeQv)
+{
+    CheckTagFeature(DelTag);
+}
+
 ChannelSequenceFeatures::ChannelSequenceFeatures(const std::string& seq)
     : SequenceFeatures(seq), Channel(Length())
 {
@@ -102,4 +124,17 @@ ChannelSequenceFeatures::ChannelSequenceFeatures(const std::string& seq,
     : SequenceFeatures(seq), Channel(&(channel[0]), Length())
 {
 }
+
+int64_t QvSequenceFeatures::AllocatedBytes() const
+{
+    int64_t floats = SequenceAsFloat.Length() + InsQv.Length() + SubsQv.Length() +
+                     DelQv.Length() + DelTag.Length() + MergeQv.Length();
+    return SequenceFeatures::AllocatedBytes() + floats * sizeof(float);
+}
+
+int64_t ChannelSequenceFeatures::AllocatedBytes() const
+{
+    int64_t ints = Channel.Length();
+    return SequenceFeatures::AllocatedBytes() + ints * sizeof(int);
+}
 }
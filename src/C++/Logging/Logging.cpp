@@ -3,13 +3,136 @@
 #include <ConsensusCore/Logging.hpp>
 #include <cpplog/cpplog.hpp>
 
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// How often the background thread forwards queued messages
+#define ASYNC_LOG_INTERVAL_MS 20
+
 namespace ConsensusCore {
+
+namespace detail {
+ThreadSafeLogger::ThreadSafeLogger(cpplog::loglevel_t level, cpplog::BaseLogger* forwardTo)
+    : level_(level)
+    , async_(false)
+    , queued_(NULL)
+    , mutex_()
+    , forwardTo_(forwardTo)
+    , writerMutex_()
+    , writerWake_()
+    , stopWriter_(false)
+    , writer_()
+{
+}
+
+ThreadSafeLogger::~ThreadSafeLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(writerMutex_);
+        stopWriter_ = true;
+    }
+    writerWake_.notify_one();
+    if (writer_.joinable()) writer_.join();
+    Flush();
+}
+
+void ThreadSafeLogger::SetLevel(cpplog::loglevel_t level) { level_ = level; }
+
+bool ThreadSafeLogger::Enabled(cpplog::loglevel_t level) const
+{
+    return level >= level_.load(std::memory_order_relaxed);
+}
+
+void ThreadSafeLogger::SetAsync(bool async)
+{
+    if (async) {
+        std::lock_guard<std::mutex> lock(writerMutex_);
+        if (!writer_.joinable()) {
+            writer_ = std::thread(&ThreadSafeLogger::WriterLoop, this);
+        }
+    }
+    async_ = async;
+    if (!async) Flush();
+}
+
+bool ThreadSafeLogger::Async() const { return async_; }
+
+void ThreadSafeLogger::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ForwardQueued();
+}
+
+bool ThreadSafeLogger::sendLogMessage(cpplog::LogData* logData)
+{
+    if (logData->level < level_) return true;
+    if (async_ && logData->level < LL_FATAL) {
+        // Push onto the queue; the message is ours to delete now
+        Record* record = new Record;
+        record->Data = logData;
+        record->Next = queued_.load(std::memory_order_relaxed);
+        while (!queued_.compare_exchange_weak(record->Next, record, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ForwardQueued();
+    return forwardTo_->sendLogMessage(logData);
+}
+
+void ThreadSafeLogger::ForwardQueued()
+{
+    // Take the whole queue, and put it in the order it was logged
+    Record* record = queued_.exchange(NULL, std::memory_order_acquire);
+    Record* oldest = NULL;
+    while (record != NULL) {
+        Record* next = record->Next;
+        record->Next = oldest;
+        oldest = record;
+        record = next;
+    }
+    while (oldest != NULL) {
+        Record* next = oldest->Next;
+        if (forwardTo_->sendLogMessage(oldest->Data)) {
+            delete oldest->Data;
+        }
+        delete oldest;
+        oldest = next;
+    }
+}
+
+void ThreadSafeLogger::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(writerMutex_);
+    while (!stopWriter_) {
+        writerWake_.wait_for(lock, std::chrono::milliseconds(ASYNC_LOG_INTERVAL_MS));
+        Flush();
+    }
+}
+}
+
+namespace {  // PRIVATE
+void FlushAtExit() { Logging::Flush(); }
+}
+
 void Logging::EnableDiagnosticLogging()
 {
-    delete flog;
-    flog = new cpplog::FilteringLogger(LL_TRACE, slog);
+    // The logger is never replaced, as other threads may be using it
+    flog->SetLevel(LL_TRACE);
 }
 
+void Logging::EnableAsyncLogging()
+{
+    static std::once_flag atExit;
+    std::call_once(atExit, [] { std::atexit(FlushAtExit); });
+    flog->SetAsync(true);
+}
+
+void Logging::Flush() { flog->Flush(); }
+
 cpplog::StdErrLogger* Logging::slog = new cpplog::StdErrLogger();
-cpplog::FilteringLogger* Logging::flog = new cpplog::FilteringLogger(LL_WARN, slog);
+detail::ThreadSafeLogger* Logging::flog = new detail::ThreadSafeLogger(LL_WARN, slog);
 }
@@ -0,0 +1,122 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Matrix/BandArena.hpp>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+#define MIN_CHUNK_SIZE 1024
+#define MAX_CHUNK_SIZE (1 << 22)
+
+// Chunks of at least a huge page are aligned to one, and backed by
+// transparent huge pages where the kernel offers them
+#define HUGE_PAGE_BYTES (2 << 20)
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+bool IsHugeChunk(int size) { return static_cast<size_t>(size) * sizeof(float) >= HUGE_PAGE_BYTES; }
+
+float* NewChunk(int size)
+{
+    if (!IsHugeChunk(size)) return new float[size];
+    void* chunk = NULL;
+    if (posix_memalign(&chunk, HUGE_PAGE_BYTES, size * sizeof(float)) != 0) {
+        throw std::bad_alloc();
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Only a hint: the chunk is usable whether or not it is taken
+    madvise(chunk, size * sizeof(float), MADV_HUGEPAGE);
+#endif
+    return static_cast<float*>(chunk);
+}
+
+void DeleteChunk(const std::pair<float*, int>& chunk)
+{
+    if (IsHugeChunk(chunk.second)) {
+        free(chunk.first);
+    } else {
+        delete[] chunk.first;
+    }
+}
+}
+
+BandArena::BandArena(int initialChunkSize)
+    : chunks_()
+    , cursor_(NULL)
+    , remaining_(0)
+    , nextChunkSize_(std::max(initialChunkSize, MIN_CHUNK_SIZE))
+    , reservedEntries_(0)
+    , accounted_()
+{
+}
+
+BandArena::~BandArena()
+{
+    for (size_t k = 0; k < chunks_.size(); k++) {
+        DeleteChunk(chunks_[k]);
+    }
+}
+
+float* BandArena::AllocateSlow(int n)
+{
+    // Start a new chunk; whatever remains of the current one is wasted.
+    // Chunks double in size, so a matrix that outgrows its initial
+    // estimate still needs only a handful of them.
+    int chunkSize = std::max(n, nextChunkSize_);
+    nextChunkSize_ = std::min(2 * nextChunkSize_, MAX_CHUNK_SIZE);
+
+    float* chunk = NewChunk(chunkSize);
+    chunks_.push_back(std::make_pair(chunk, chunkSize));
+    reservedEntries_ += chunkSize;
+    accounted_.Set(static_cast<int64_t>(reservedEntries_) * sizeof(float));
+
+    cursor_ = chunk + n;
+    remaining_ = chunkSize - n;
+    return chunk;
+}
+
+void BandArena::Reset()
+{
+    if (chunks_.size() > 1) {
+        // Replace the chunks by one big enough for all that they held,
+        // so that refilling a matrix of the same shape allocates nothing.
+        int chunkSize = std::min(reservedEntries_, MAX_CHUNK_SIZE);
+        for (size_t k = 0; k < chunks_.size(); k++) {
+            DeleteChunk(chunks_[k]);
+        }
+        chunks_.clear();
+        chunks_.push_back(std::make_pair(NewChunk(chunkSize), chunkSize));
+        reservedEntries_ = chunkSize;
+        accounted_.Set(static_cast<int64_t>(reservedEntries_) * sizeof(float));
+        nextChunkSize_ = std::max(nextChunkSize_, chunkSize);
+    }
+    if (chunks_.empty()) {
+        cursor_ = NULL;
+        remaining_ = 0;
+    } else {
+        cursor_ = chunks_[0].first;
+        remaining_ = chunks_[0].second;
+    }
+}
+
+void BandArena::Swap(BandArena& other)
+{
+    std::swap(chunks_, other.chunks_);
+    std::swap(cursor_, other.cursor_);
+    std::swap(remaining_, other.remaining_);
+    std::swap(nextChunkSize_, other.nextChunkSize_);
+    std::swap(reservedEntries_, other.reservedEntries_);
+    accounted_.Set(static_cast<int64_t>(reservedEntries_) * sizeof(float));
+    other.accounted_.Set(static_cast<int64_t>(other.reservedEntries_) * sizeof(float));
+}
+
+void BandArena::SetMemoryCategory(MemoryCategory category) { accounted_.SetCategory(category); }
+}
@@ -2,29 +2,113 @@
 
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
 
+#include <xmmintrin.h>
 #include <algorithm>
 #include <boost/tuple/tuple.hpp>
 #include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <new>
 #include <vector>
 
 #include <ConsensusCore/LFloat.hpp>
 
-using boost::numeric::ublas::matrix;
-using boost::numeric::ublas::row_major;
+// Bytes to align the buffer and each column to: a cache line, which is
+// also the width of the widest SIMD vectors
+#define DENSE_MATRIX_ALIGNMENT 64
+#define DENSE_MATRIX_ROW_PADDING (DENSE_MATRIX_ALIGNMENT / sizeof(float))
 
 namespace ConsensusCore {
 
 // Performance insensitive routines are not inlined
 
+namespace {  // PRIVATE
+int PaddedRows(int rows)
+{
+    const int padding = DENSE_MATRIX_ROW_PADDING;
+    return (rows + padding - 1) / padding * padding;
+}
+
+// Set n floats at p, which is aligned to 16 bytes with n a multiple of
+// four, to -FLT_MAX
+void FillEmpty(float* p, size_t n)
+{
+    assert(reinterpret_cast<size_t>(p) % 16 == 0 && n % 4 == 0);
+    const __m128 empty = _mm_set1_ps(-FLT_MAX);
+    for (size_t k = 0; k < n; k += 4) {
+        _mm_store_ps(p + k, empty);
+    }
+}
+}
+
 DenseMatrix::DenseMatrix(int rows, int cols)
-    : boost_dense_matrix(rows, cols), usedRanges_(cols, Interval(0, 0)), columnBeingEdited_(-1)
+    : data_(NULL)
+    , capacity_(0)
+    , nRows_(0)
+    , nCols_(0)
+    , stride_(0)
+    , usedRanges_()
+    , columnBeingEdited_(-1)
+    , accounted_()
+{
+    Reset(rows, cols);
+}
+
+DenseMatrix::DenseMatrix(const DenseMatrix& other)
+    : data_(NULL)
+    , capacity_(0)
+    , nRows_(0)
+    , nCols_(0)
+    , stride_(0)
+    , usedRanges_()
+    , columnBeingEdited_(-1)
+    , accounted_()
+{
+    *this = other;
+}
+
+DenseMatrix::~DenseMatrix() { _mm_free(data_); }
+
+DenseMatrix& DenseMatrix::operator=(const DenseMatrix& other)
+{
+    if (this != &other) {
+        Allocate(other.nRows_, other.nCols_);
+        if (other.nCols_ > 0) {
+            std::memcpy(data_, other.data_,
+                        static_cast<size_t>(stride_) * nCols_ * sizeof(float));
+        }
+        usedRanges_ = other.usedRanges_;
+        columnBeingEdited_ = other.columnBeingEdited_;
+        accounted_.Set(AllocatedBytes());
+    }
+    return *this;
+}
+
+void DenseMatrix::Allocate(int rows, int cols)
 {
-    for (int j = 0; j < cols; j++) {
-        CheckInvariants(j);
+    nRows_ = rows;
+    nCols_ = cols;
+    stride_ = PaddedRows(rows);
+    const size_t size = static_cast<size_t>(stride_) * cols;
+    if (size > capacity_) {
+        _mm_free(data_);
+        data_ = static_cast<float*>(_mm_malloc(size * sizeof(float), DENSE_MATRIX_ALIGNMENT));
+        if (data_ == NULL) {
+            capacity_ = 0;
+            throw std::bad_alloc();
+        }
+        capacity_ = size;
     }
 }
 
-DenseMatrix::~DenseMatrix() {}
+void DenseMatrix::Reset(int rows, int cols)
+{
+    assert(columnBeingEdited_ == -1);
+    Allocate(rows, cols);
+    FillEmpty(data_, static_cast<size_t>(stride_) * cols);
+    usedRanges_.assign(cols, Interval(0, 0));
+    accounted_.Set(AllocatedBytes());
+}
 
 int DenseMatrix::UsedEntries() const
 {
@@ -40,13 +124,25 @@ int DenseMatrix::UsedEntries() const
 
 int DenseMatrix::AllocatedEntries() const { return Rows() * Columns(); }
 
+int64_t DenseMatrix::AllocatedBytes() const
+{
+    return sizeof(*this) + capacity_ * sizeof(float) + usedRanges_.capacity() * sizeof(Interval);
+}
+
+void DenseMatrix::ShrinkToFit() {}
+
+void DenseMatrix::SetMemoryCategory(MemoryCategory category) { accounted_.SetCategory(category); }
+
 void DenseMatrix::ToHostMatrix(float** mat, int* rows, int* cols) const
 {
     // TODO(dalexander): make sure SWIG client deallocates this memory -- use
     // %newobject flag
-    matrix<lfloat, row_major> rowMajorPeer(*this);
     *mat = new float[Rows() * Columns()];
-    std::copy(rowMajorPeer.data().begin(), rowMajorPeer.data().end(), *mat);
+    for (int i = 0; i < Rows(); i++) {
+        for (int j = 0; j < Columns(); j++) {
+            (*mat)[i * Columns() + j] = *Entry(i, j);
+        }
+    }
     *rows = Rows();
     *cols = Columns();
 }
@@ -57,9 +153,9 @@ void DenseMatrix::CheckInvariants(int column) const
     int start, end;
     boost::tie(start, end) = UsedRowRange(column);
     assert(0 <= start && start <= end && end <= Rows());
-    for (int i = 0; i < Rows(); i++) {
+    for (int i = 0; i < stride_; i++) {
         if (!(start <= i && i < end)) {
-            assert((*this)(i, column) == value_type());
+            assert(*Entry(i, column) == -FLT_MAX);
         }
     }
 }
@@ -2,54 +2,104 @@
 
 #include <algorithm>
 #include <boost/tuple/tuple.hpp>
+#include <cassert>
+#include <cstdlib>
 #include <limits>
 #include <vector>
 
 #include <ConsensusCore/Matrix/SparseMatrix.hpp>
 
+// Rows per column to reserve arena storage for up front; the arena
+// grows as needed if the bands turn out wider.
+#define TYPICAL_BAND_WIDTH 48
+
 namespace ConsensusCore {
 // Performance insensitive routines are not inlined
 
+namespace {  // PRIVATE
+// The arena floats that hold the given number of entries
+int ArenaFloats(int entries) { return entries * SparseVector::EntryBytes() / sizeof(float); }
+
+// The arena floats a column of the given entries takes, allocations
+// being rounded up to four floats
+int ColumnArenaFloats(int entries)
+{
+    int floats = (entries * SparseVector::EntryBytes() + sizeof(float) - 1) / sizeof(float);
+    return (floats + 3) & ~3;
+}
+}
+
 SparseMatrix::SparseMatrix(int rows, int cols)
-    : columns_(cols)
+    : arena_(ArenaFloats(cols * min(rows, TYPICAL_BAND_WIDTH)))
+    , columns_()
+    , beginColumn_(0)
+    , endColumn_(cols)
     , nCols_(cols)
     , nRows_(rows)
     , columnBeingEdited_(-1)
     , usedRanges_(cols, Interval(0, 0))
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    , editing_()
+    , editedRows_(0, 0)
+#endif
+    , accounted_()
 {
+    columns_.reserve(nCols_);
     for (int j = 0; j < nCols_; j++) {
-        columns_[j] = NULL;
+        columns_.emplace_back(nRows_, &arena_);
     }
+    accounted_.Set(BookkeepingBytes());
 }
 
 SparseMatrix::SparseMatrix(const SparseMatrix& other)
-    : columns_(other.nCols_)
+    : arena_(ArenaFloats(other.AllocatedEntries()))
+    , columns_()
+    , beginColumn_(other.beginColumn_)
+    , endColumn_(other.endColumn_)
     , nCols_(other.nCols_)
     , nRows_(other.nRows_)
     , columnBeingEdited_(other.columnBeingEdited_)
     , usedRanges_(other.usedRanges_)
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    , editing_(other.editing_)
+    , editedRows_(other.editedRows_)
+#endif
+    , accounted_()
 {
-    for (int j = 0; j < nCols_; j++) {
-        if (other.columns_[j] != NULL) {
-            columns_[j] = new SparseVector(*other.columns_[j]);
-        } else {
-            columns_[j] = NULL;
-        }
+    columns_.reserve(other.columns_.size());
+    for (size_t k = 0; k < other.columns_.size(); k++) {
+        columns_.emplace_back(other.columns_[k], &arena_);
     }
+    accounted_.Set(BookkeepingBytes());
 }
 
-SparseMatrix::~SparseMatrix()
+SparseMatrix::~SparseMatrix() {}
+
+void SparseMatrix::Reset(int rows, int cols) { Reset(rows, cols, 0, cols); }
+
+void SparseMatrix::Reset(int rows, int cols, int beginColumn, int endColumn)
 {
-    for (int j = 0; j < nCols_; j++) {
-        if (columns_[j] != NULL) delete columns_[j];
+    assert(columnBeingEdited_ == -1);
+    assert(0 <= beginColumn && beginColumn <= endColumn && endColumn <= cols);
+    columns_.clear();
+    arena_.Reset();
+    beginColumn_ = beginColumn;
+    endColumn_ = endColumn;
+    nCols_ = cols;
+    nRows_ = rows;
+    columns_.reserve(endColumn - beginColumn);
+    for (int j = beginColumn; j < endColumn; j++) {
+        columns_.emplace_back(nRows_, &arena_);
     }
+    usedRanges_.assign(endColumn - beginColumn, Interval(0, 0));
+    accounted_.Set(BookkeepingBytes());
 }
 
 int SparseMatrix::UsedEntries() const
 {
     // use column ranges
     int filledEntries = 0;
-    for (int col = 0; col < Columns(); ++col) {
+    for (int col = beginColumn_; col < endColumn_; ++col) {
         int start, end;
         boost::tie(start, end) = UsedRowRange(col);
         filledEntries += (end - start);
@@ -60,12 +110,56 @@ int SparseMatrix::UsedEntries() const
 int SparseMatrix::AllocatedEntries() const
 {
     int sum = 0;
-    for (int j = 0; j < nCols_; j++) {
-        sum += (columns_[j] != NULL ? columns_[j]->AllocatedEntries() : 0);
+    for (size_t k = 0; k < columns_.size(); k++) {
+        sum += columns_[k].AllocatedEntries();
     }
     return sum;
 }
 
+void SparseMatrix::ShrinkToFit()
+{
+    assert(columnBeingEdited_ == -1);
+    int floats = 0;
+    for (size_t k = 0; k < columns_.size(); k++) {
+        floats += ColumnArenaFloats(usedRanges_[k].End - usedRanges_[k].Begin);
+    }
+    // The old storage stays valid, in old, until the columns are copied
+    // out of it
+    BandArena old(floats);
+    arena_.Swap(old);
+    std::vector<SparseVector> compacted;
+    compacted.reserve(columns_.size());
+    for (size_t k = 0; k < columns_.size(); k++) {
+        compacted.emplace_back(columns_[k], usedRanges_[k].Begin, usedRanges_[k].End, &arena_);
+    }
+    columns_.swap(compacted);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    std::vector<float>().swap(editing_);
+#endif
+    accounted_.Set(BookkeepingBytes());
+}
+
+int64_t SparseMatrix::BookkeepingBytes() const
+{
+    int64_t bytes = sizeof(*this) + columns_.capacity() * sizeof(SparseVector) +
+                    usedRanges_.capacity() * sizeof(Interval);
+#ifdef CONSENSUSCORE_HALF_MATRICES
+    bytes += editing_.capacity() * sizeof(float);
+#endif
+    return bytes;
+}
+
+int64_t SparseMatrix::AllocatedBytes() const
+{
+    return static_cast<int64_t>(arena_.ReservedEntries()) * sizeof(float) + BookkeepingBytes();
+}
+
+void SparseMatrix::SetMemoryCategory(MemoryCategory category)
+{
+    arena_.SetMemoryCategory(category);
+    accounted_.SetCategory(category);
+}
+
 void SparseMatrix::ToHostMatrix(float** mat, int* rows, int* cols) const
 {
     const float nan = std::numeric_limits<float>::quiet_NaN();
@@ -79,10 +173,71 @@ void SparseMatrix::ToHostMatrix(float** mat, int* rows, int* cols) const
     }
 }
 
+void SparseMatrix::ToHostMatrix(float** window, int* windowRows, int* windowCols, int beginRow, int endRow,
+                                int beginColumn, int endColumn) const
+{
+    if (beginRow < 0 || beginRow > endRow || endRow > Rows() || beginColumn < 0 ||
+        beginColumn > endColumn || endColumn > Columns()) {
+        throw InvalidInputError("Invalid matrix window");
+    }
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    *windowRows = endRow - beginRow;
+    *windowCols = endColumn - beginColumn;
+    *window =
+        static_cast<float*>(malloc(std::max(1, *windowRows * *windowCols) * sizeof(float)));
+    for (int i = beginRow; i < endRow; i++) {
+        float* row = *window + (i - beginRow) * *windowCols - beginColumn;
+        for (int j = beginColumn; j < endColumn; j++) {
+            row[j] = IsAllocated(i, j) ? Get(i, j) : nan;
+        }
+    }
+}
+
+Interval SparseMatrix::StoredRowRange(int j) const
+{
+    return IsColumnStored(j) ? UsedRowRange(j) : Interval(0, 0);
+}
+
+void SparseMatrix::ToHostBand(float** values, int* nValues) const
+{
+    *nValues = UsedEntries();
+    *values = static_cast<float*>(malloc(std::max(1, *nValues) * sizeof(float)));
+    float* out = *values;
+    for (int j = beginColumn_; j < endColumn_; j++) {
+        Interval rows = UsedRowRange(j);
+        for (int i = rows.Begin; i < rows.End; i++) {
+            *out++ = Get(i, j);
+        }
+    }
+}
+
+void SparseMatrix::ToHostBandOffsets(int** offsets, int* nOffsets) const
+{
+    *nOffsets = Columns() + 1;
+    *offsets = static_cast<int*>(malloc(*nOffsets * sizeof(int)));
+    (*offsets)[0] = 0;
+    for (int j = 0; j < Columns(); j++) {
+        Interval rows = StoredRowRange(j);
+        (*offsets)[j + 1] = (*offsets)[j] + std::max(0, rows.End - rows.Begin);
+    }
+}
+
+void SparseMatrix::ToHostUsedRowRanges(int** ranges, int* cols, int* two) const
+{
+    *cols = Columns();
+    *two = 2;
+    *ranges = static_cast<int*>(malloc(std::max(1, 2 * Columns()) * sizeof(int)));
+    for (int j = 0; j < Columns(); j++) {
+        Interval rows = StoredRowRange(j);
+        (*ranges)[2 * j] = rows.Begin;
+        (*ranges)[2 * j + 1] = rows.End;
+    }
+}
+
 void SparseMatrix::CheckInvariants(int) const
 {
-    for (int j = 0; j < nCols_; j++) {
-        if (columns_[j] != NULL) columns_[j]->CheckInvariants();
+    for (size_t k = 0; k < columns_.size(); k++) {
+        columns_[k].CheckInvariants();
     }
 }
 }
@@ -0,0 +1,50 @@
+// Author: David Alexander
+
+#include <ConsensusCore/MemoryUsage.hpp>
+
+#include <atomic>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+// Zeroed as statics, before any object that counts itself is built,
+// and never destroyed
+std::atomic<int64_t> held[NUM_MEMORY_CATEGORIES];
+std::atomic<int64_t> totalHeld;
+std::atomic<int64_t> peakHeld;
+}
+
+namespace detail {
+
+void AccountMemory(MemoryCategory category, int64_t bytes)
+{
+    if (bytes == 0) return;
+    held[category].fetch_add(bytes, std::memory_order_relaxed);
+    int64_t total = totalHeld.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes > 0) {
+        int64_t peak = peakHeld.load(std::memory_order_relaxed);
+        while (total > peak &&
+               !peakHeld.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+        }
+    }
+}
+}
+
+MemoryUsage ProcessMemoryUsage()
+{
+    MemoryUsage usage;
+    usage.MatrixBytes = held[MATRIX_MEMORY].load(std::memory_order_relaxed);
+    usage.ScratchBytes = held[SCRATCH_MEMORY].load(std::memory_order_relaxed);
+    usage.FeatureBytes = held[FEATURE_MEMORY].load(std::memory_order_relaxed);
+    usage.PoaBytes = held[POA_MEMORY].load(std::memory_order_relaxed);
+    usage.ScorerBytes = held[SCORER_MEMORY].load(std::memory_order_relaxed);
+    return usage;
+}
+
+int64_t PeakMemoryBytes() { return peakHeld.load(std::memory_order_relaxed); }
+
+void ResetPeakMemoryBytes()
+{
+    peakHeld.store(totalHeld.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+}
@@ -27,11 +27,11 @@ std::string Mutation::ToString() const
 
     switch (Type()) {
         case INSERTION:
-            return str(format("Insertion (%s) @%d") % newBases_ % start_);
+            return str(format("Insertion (%s) @%d") % NewBases() % start_);
         case DELETION:
             return str(format("Deletion @%d:%d") % start_ % end_);
         case SUBSTITUTION:
-            return str(format("Substitution (%s) @%d:%d") % newBases_ % start_ % end_);
+            return str(format("Substitution (%s) @%d:%d") % NewBases() % start_ % end_);
         default:
             ShouldNotReachHere();
     }
@@ -48,11 +48,11 @@ ScoredMutation Mutation::WithScore(float score) const { return ScoredMutation(*t
 static void _ApplyMutationInPlace(const Mutation& mut, int start, std::string* tpl)
 {
     if (mut.IsSubstitution()) {
-        (*tpl).replace(start, mut.End() - mut.Start(), mut.NewBases());
+        (*tpl).replace(start, mut.End() - mut.Start(), mut.NewBasesData(), mut.NewBasesLength());
     } else if (mut.IsDeletion()) {
         (*tpl).erase(start, mut.End() - mut.Start());
     } else if (mut.IsInsertion()) {
-        (*tpl).insert(start, mut.NewBases());
+        (*tpl).insert(start, mut.NewBasesData(), mut.NewBasesLength());
     }
 }
 
@@ -65,15 +65,72 @@ std::string ApplyMutation(const Mutation& mut, const std::string& tpl)
 
 std::string ApplyMutations(const std::vector<Mutation>& muts, const std::string& tpl)
 {
-    std::string tplCopy(tpl);
-    std::vector<Mutation> sortedMuts(muts);
-    std::sort(sortedMuts.begin(), sortedMuts.end());
-    int runningLengthDiff = 0;
-    foreach (const Mutation& mut, sortedMuts) {
-        _ApplyMutationInPlace(mut, mut.Start() + runningLengthDiff, &tplCopy);
-        runningLengthDiff += mut.LengthDiff();
+    std::string out;
+    ApplyMutations(muts, tpl, &out);
+    return out;
+}
+
+static void _ApplySortedMutations(const std::vector<Mutation>& sortedMuts, const std::string& tpl,
+                                  std::string* out)
+{
+    bool disjoint = true;
+    int lengthDiff = 0;
+    for (size_t k = 0; k < sortedMuts.size(); k++) {
+        disjoint = disjoint && (k == 0 || sortedMuts[k - 1].End() <= sortedMuts[k].Start());
+        lengthDiff += sortedMuts[k].LengthDiff();
+    }
+
+    if (disjoint) {
+        // Lay down the stretches of the template between the mutations
+        // and the mutations' bases, in order
+        out->clear();
+        out->reserve(tpl.length() + lengthDiff);
+        int pos = 0;
+        foreach (const Mutation& mut, sortedMuts) {
+            out->append(tpl, pos, mut.Start() - pos);
+            out->append(mut.NewBasesData(), mut.NewBasesLength());
+            pos = mut.End();
+        }
+        out->append(tpl, pos, std::string::npos);
+    } else {
+        // Overlapping mutations are applied one after another, each
+        // where the ones before it have moved its position to
+        out->assign(tpl);
+        int runningLengthDiff = 0;
+        foreach (const Mutation& mut, sortedMuts) {
+            _ApplyMutationInPlace(mut, mut.Start() + runningLengthDiff, out);
+            runningLengthDiff += mut.LengthDiff();
+        }
+    }
+}
+
+void ApplyMutations(const std::vector<Mutation>& muts, const std::string& tpl, std::string* out)
+{
+    assert(out != &tpl);
+    if (std::is_sorted(muts.begin(), muts.end())) {
+        _ApplySortedMutations(muts, tpl, out);
+    } else {
+        std::vector<Mutation> sortedMuts(muts);
+        std::sort(sortedMuts.begin(), sortedMuts.end());
+        _ApplySortedMutations(sortedMuts, tpl, out);
+    }
+}
+
+void ApplyMutationInPlace(const Mutation& mut, std::string* tpl, std::string* savedBases)
+{
+    savedBases->assign(*tpl, mut.Start(), mut.End() - mut.Start());
+    _ApplyMutationInPlace(mut, mut.Start(), tpl);
+}
+
+void UndoMutationInPlace(const Mutation& mut, std::string* tpl, const std::string& savedBases)
+{
+    if (mut.IsSubstitution()) {
+        tpl->replace(mut.Start(), savedBases.length(), savedBases);
+    } else if (mut.IsDeletion()) {
+        tpl->insert(mut.Start(), savedBases);
+    } else if (mut.IsInsertion()) {
+        tpl->erase(mut.Start(), mut.LengthDiff());
     }
-    return tplCopy;
 }
 
 std::string MutationsToTranscript(const std::vector<Mutation>& mutations, const std::string& tpl)
@@ -134,6 +191,92 @@ std::vector<int> TargetToQueryPositions(const std::vector<Mutation>& mutations,
     return TargetToQueryPositions(MutationsToTranscript(mutations, tpl));
 }
 
+// The template fingerprint: each window of K bases, starting at
+// position i in [-(K - 1), length), is hashed as a polynomial in its
+// bases (those off either end of the template counting as a pad, 0),
+// and the hashes, mixed, are summed
+namespace {
+const int K = TEMPLATE_FINGERPRINT_WINDOW;
+const uint64_t BASE = 0x100000001b3ULL;
+
+inline uint64_t Mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t Code(const std::string& s, int i)
+{
+    return (i < 0 || i >= static_cast<int>(s.length())) ? 0 : 1 + static_cast<uint8_t>(s[i]);
+}
+
+// The summed hashes of the windows of s starting in [begin, end)
+uint64_t SumWindows(const std::string& s, int begin, int end)
+{
+    uint64_t lead = 1;
+    for (int j = 1; j < K; j++) {
+        lead *= BASE;
+    }
+    uint64_t h = 0, sum = 0;
+    for (int j = begin; j < begin + K - 1; j++) {
+        h = h * BASE + Code(s, j);
+    }
+    for (int i = begin; i < end; i++) {
+        h = h * BASE + Code(s, i + K - 1);
+        sum += Mix(h);
+        h -= Code(s, i) * lead;
+    }
+    return sum;
+}
+}
+
+uint64_t TemplateFingerprint(const std::string& tpl)
+{
+    return SumWindows(tpl, 1 - K, tpl.length());
+}
+
+uint64_t MutatedTemplateFingerprint(uint64_t fingerprint, const std::vector<Mutation>& mutations,
+                                    const std::string& tpl)
+{
+    std::vector<Mutation> sortedMuts(mutations);
+    std::sort(sortedMuts.begin(), sortedMuts.end());
+    int length = tpl.length();
+    for (size_t k = 0; k < sortedMuts.size();) {
+        // The mutations whose windows [Start - K + 1, End) overlap are
+        // taken together: the windows starting in [begin, end) go, and
+        // those of the mutated stretch, from begin on, take their place
+        int begin = sortedMuts[k].Start() - K + 1;
+        int end = sortedMuts[k].End();
+        size_t last = k + 1;
+        while (last < sortedMuts.size() && sortedMuts[last].Start() - K + 1 <= end) {
+            end = std::max(end, sortedMuts[last].End());
+            last++;
+        }
+        fingerprint -= SumWindows(tpl, begin, end);
+
+        // The stretch of the template the new windows span, mutated
+        int lo = std::max(begin, 0);
+        int hi = std::min(end + K - 1, length);
+        std::vector<Mutation> local;
+        int lengthDiff = 0;
+        for (size_t j = k; j < last; j++) {
+            const Mutation& m = sortedMuts[j];
+            local.push_back(Mutation(m.Type(), m.Start() - lo, m.End() - lo, m.NewBasesData(),
+                                     m.NewBasesLength()));
+            lengthDiff += m.LengthDiff();
+        }
+        std::string stretch = ApplyMutations(local, tpl.substr(lo, hi - lo));
+        fingerprint += SumWindows(stretch, begin - lo, end - lo + lengthDiff);
+
+        k = last;
+    }
+    return fingerprint;
+}
+
 ScoredMutation::ScoredMutation(const Mutation& m, float score) : Mutation(m), score_(score) {}
 
 ScoredMutation::ScoredMutation() : Mutation(), score_(0) {}
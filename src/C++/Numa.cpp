@@ -0,0 +1,110 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Numa.hpp>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+const std::string NODE_DIR = "/sys/devices/system/node/";
+
+// Parse a Linux CPU or node list, as "0-3,8,10-11", into its members
+std::vector<int> ParseList(const std::string& list)
+{
+    std::vector<int> members;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        int first, last;
+        char dash;
+        std::stringstream rs(range);
+        if (!(rs >> first)) continue;
+        last = (rs >> dash >> last) ? last : first;
+        for (int k = first; k <= last; k++) {
+            members.push_back(k);
+        }
+    }
+    return members;
+}
+
+std::vector<int> ReadList(const std::string& path)
+{
+    std::ifstream in(path.c_str());
+    std::string list;
+    std::getline(in, list);
+    return ParseList(list);
+}
+
+// The CPUs of each node, read once
+const std::vector<std::vector<int> >& NodeCpus()
+{
+    static const std::vector<std::vector<int> > nodeCpus = [] {
+        std::vector<int> online = ReadList(NODE_DIR + "online");
+        std::vector<std::vector<int> > cpus;
+        if (!online.empty()) {
+            cpus.resize(*std::max_element(online.begin(), online.end()) + 1);
+        }
+        foreach (int node, online) {
+            cpus[node] = ReadList(NODE_DIR + "node" + std::to_string(node) + "/cpulist");
+        }
+        if (cpus.empty()) {
+            cpus.resize(1);
+            int n = std::max(1u, std::thread::hardware_concurrency());
+            for (int cpu = 0; cpu < n; cpu++) {
+                cpus[0].push_back(cpu);
+            }
+        }
+        return cpus;
+    }();
+    return nodeCpus;
+}
+}
+
+int NumNumaNodes() { return NodeCpus().size(); }
+
+std::vector<int> NumaNodeCpus(int node)
+{
+    if (node < 0 || node >= NumNumaNodes()) return std::vector<int>();
+    return NodeCpus()[node];
+}
+
+int CurrentNumaNode()
+{
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    for (int node = 0; node < NumNumaNodes(); node++) {
+        const std::vector<int>& cpus = NodeCpus()[node];
+        if (std::binary_search(cpus.begin(), cpus.end(), cpu)) return node;
+    }
+#endif
+    return 0;
+}
+
+bool PinThreadToNumaNode(int node)
+{
+    std::vector<int> cpus = NumaNodeCpus(node);
+    if (cpus.empty()) return false;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    foreach (int cpu, cpus) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+}
@@ -0,0 +1,196 @@
+// Author: David Alexander
+
+#include <ConsensusCore/PerfStats.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+const char* const phaseNames[PERF_NUM_PHASES] = {
+    "FillAlphaBeta",      "Extend",     "LinkAlphaBeta", "ScoreMutation",  "ApplyMutations",
+    "EnumerateMutations", "TryAddRead", "CommitAdd",     "RefineIteration"};
+
+// One thread's counters.  Only the owning thread writes them, so a
+// relaxed load and store suffice to count; the atomics only keep
+// CollectPerfStats, reading from another thread, well defined.
+struct Counters
+{
+    std::atomic<int64_t> Calls[PERF_NUM_PHASES];
+    std::atomic<int64_t> Cells[PERF_NUM_PHASES];
+    std::atomic<int64_t> Nanoseconds[PERF_NUM_PHASES];
+    std::atomic<int64_t> SparseVectorReallocs;
+
+    Counters() { Reset(); }
+
+    void Reset()
+    {
+        for (int p = 0; p < PERF_NUM_PHASES; p++) {
+            Calls[p].store(0, std::memory_order_relaxed);
+            Cells[p].store(0, std::memory_order_relaxed);
+            Nanoseconds[p].store(0, std::memory_order_relaxed);
+        }
+        SparseVectorReallocs.store(0, std::memory_order_relaxed);
+    }
+
+    void AddTo(PerfStats* stats) const
+    {
+        for (int p = 0; p < PERF_NUM_PHASES; p++) {
+            stats->Phases[p].Calls += Calls[p].load(std::memory_order_relaxed);
+            stats->Phases[p].Cells += Cells[p].load(std::memory_order_relaxed);
+            stats->Phases[p].Seconds += 1e-9 * Nanoseconds[p].load(std::memory_order_relaxed);
+        }
+        stats->SparseVectorReallocs += SparseVectorReallocs.load(std::memory_order_relaxed);
+    }
+};
+
+inline void Bump(std::atomic<int64_t>* counter, int64_t n)
+{
+    counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// The counters of the live threads, and the sums of those of the
+// threads that have exited.  Never destroyed, as threads may exit
+// after static destruction has begun.
+struct Registry
+{
+    std::mutex Mutex;
+    std::set<Counters*> Live;
+    PerfStats Exited;
+
+    Registry() { Exited.Phases.resize(PERF_NUM_PHASES); }
+};
+
+Registry& TheRegistry()
+{
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+struct ThreadCounters
+{
+    Counters Counts;
+
+    ThreadCounters()
+    {
+        std::lock_guard<std::mutex> lock(TheRegistry().Mutex);
+        TheRegistry().Live.insert(&Counts);
+    }
+
+    ~ThreadCounters()
+    {
+        std::lock_guard<std::mutex> lock(TheRegistry().Mutex);
+        Counts.AddTo(&TheRegistry().Exited);
+        TheRegistry().Live.erase(&Counts);
+    }
+};
+
+Counters& LocalCounters()
+{
+    static thread_local ThreadCounters counters;
+    return counters.Counts;
+}
+
+// The trace hook; IsSet lets the threads tracing skip it cheaply when
+// there is none.  Never destroyed, as for the registry.
+struct TraceHookSlot
+{
+    std::atomic<bool> IsSet;
+    PerfTraceHook Hook;
+
+    TraceHookSlot() : IsSet(false), Hook() {}
+};
+
+TraceHookSlot& TheTraceHook()
+{
+    static TraceHookSlot* slot = new TraceHookSlot();
+    return *slot;
+}
+
+int LocalThreadNumber()
+{
+    static std::atomic<int> numThreads(0);
+    static thread_local int number = numThreads.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+}
+
+PerfStats CollectPerfStats()
+{
+    Registry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    PerfStats stats = registry.Exited;
+    for (const Counters* counters : registry.Live) {
+        counters->AddTo(&stats);
+    }
+    for (int p = 0; p < PERF_NUM_PHASES; p++) {
+        stats.Phases[p].Phase = phaseNames[p];
+    }
+#ifdef CONSENSUSCORE_PERF_STATS
+    stats.Enabled = true;
+#endif  // CONSENSUSCORE_PERF_STATS
+    return stats;
+}
+
+void ResetPerfStats()
+{
+    Registry& registry = TheRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    registry.Exited = PerfStats();
+    registry.Exited.Phases.resize(PERF_NUM_PHASES);
+    for (Counters* counters : registry.Live) {
+        counters->Reset();
+    }
+}
+
+bool PerfTraceEnabled()
+{
+#ifdef CONSENSUSCORE_PERF_TRACE
+    return true;
+#else
+    return false;
+#endif  // CONSENSUSCORE_PERF_TRACE
+}
+
+void SetPerfTraceHook(const PerfTraceHook& hook)
+{
+    TraceHookSlot& slot = TheTraceHook();
+    slot.IsSet.store(false, std::memory_order_release);
+    slot.Hook = hook;
+    slot.IsSet.store(static_cast<bool>(hook), std::memory_order_release);
+}
+
+namespace detail {
+
+void CountPerfCall(PerfPhase phase, std::chrono::steady_clock::duration elapsed)
+{
+    Counters& counters = LocalCounters();
+    Bump(&counters.Calls[phase], 1);
+    Bump(&counters.Nanoseconds[phase],
+         std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void CountPerfCells(PerfPhase phase, int64_t cells) { Bump(&LocalCounters().Cells[phase], cells); }
+
+void CountSparseVectorRealloc() { Bump(&LocalCounters().SparseVectorReallocs, 1); }
+
+void TracePerf(PerfPhase phase, bool begin)
+{
+    TraceHookSlot& slot = TheTraceHook();
+    if (!slot.IsSet.load(std::memory_order_acquire)) return;
+    PerfTraceEvent event;
+    event.Phase = phase;
+    event.Name = phaseNames[phase];
+    event.Begin = begin;
+    event.Nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    event.Thread = LocalThreadNumber();
+    slot.Hook(event);
+}
+}
+}
@@ -5,15 +5,24 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include <ConsensusCore/Align/AlignConfig.hpp>
+#include <ConsensusCore/Interval.hpp>
+#include <ConsensusCore/Poa/RangeFinder.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 #include <ConsensusCore/Utils.hpp>
 
 using boost::tie;
 
+// Rows either side of the graph alignment that a read's band hint
+// also covers (see ToMappedRead), to leave its first fill some room
+#define POA_BAND_PADDING 4
+
 namespace ConsensusCore {
 AlignConfig DefaultPoaConfig(AlignMode mode)
 {
@@ -34,6 +43,13 @@ PoaConsensus::PoaConsensus(const std::string& css, const detail::PoaGraphImpl& g
 {
 }
 
+PoaConsensus::PoaConsensus(const std::string& css, PoaGraph&& g,
+                           const std::vector<size_t>& cssPath,
+                           std::vector<std::vector<size_t> >&& readPaths)
+    : Sequence(css), Graph(std::move(g)), Path(cssPath), ReadPaths(std::move(readPaths))
+{
+}
+
 PoaConsensus::~PoaConsensus() {}
 
 const PoaConsensus* PoaConsensus::FindConsensus(const std::vector<std::string>& reads)
@@ -44,14 +60,18 @@ const PoaConsensus* PoaConsensus::FindConsensus(const std::vector<std::string>&
 const PoaConsensus* PoaConsensus::FindConsensus(const std::vector<std::string>& reads,
                                                 const AlignConfig& config, int minCoverage)
 {
+    // Each read is aligned only within a band about its anchors
+    // against the consensus so far
     PoaGraph pg;
-    foreach (const std::string& read, reads) {
-        if (read.length() == 0) {
+    detail::MinimizerRangeFinder rangeFinder;
+    std::vector<std::vector<PoaGraph::Vertex> > readPaths(reads.size());
+    for (size_t k = 0; k < reads.size(); k++) {
+        if (reads[k].length() == 0) {
             throw InvalidInputError("Input sequences must have nonzero length.");
         }
-        pg.AddRead(read, config);
+        pg.AddRead(reads[k], config, &rangeFinder, &readPaths[k]);
     }
-    return pg.FindConsensus(config, minCoverage);
+    return pg.ReleaseConsensus(config, minCoverage, std::move(readPaths));
 }
 
 const PoaConsensus* PoaConsensus::FindConsensus(const std::vector<std::string>& reads,
@@ -60,6 +80,150 @@ const PoaConsensus* PoaConsensus::FindConsensus(const std::vector<std::string>&
     return FindConsensus(reads, DefaultPoaConfig(mode), minCoverage);
 }
 
+std::vector<const PoaConsensus*> PoaConsensus::FindConsensusBatch(
+    const std::vector<std::vector<std::string> >& readSets, const AlignConfig& config,
+    int minCoverage, int numThreads)
+{
+    // Each read set gets a graph of its own, so the sets are
+    // independent; the pool hands them out one at a time, which keeps
+    // the threads busy however unevenly sized the sets are.
+    const int n = readSets.size();
+    std::vector<const PoaConsensus*> results(n, NULL);
+    ThreadPool pool(numThreads);
+    try {
+        pool.ParallelFor(
+            n, [&](int i) { results[i] = FindConsensus(readSets[i], config, minCoverage); });
+    } catch (...) {
+        foreach (const PoaConsensus* pc, results) {
+            delete pc;
+        }
+        throw;
+    }
+    return results;
+}
+
+std::vector<const PoaConsensus*> PoaConsensus::FindConsensusBatch(
+    const std::vector<std::vector<std::string> >& readSets, AlignMode mode, int minCoverage,
+    int numThreads)
+{
+    return FindConsensusBatch(readSets, DefaultPoaConfig(mode), minCoverage, numThreads);
+}
+
+const PoaConsensus* PoaConsensus::FindConsensusHierarchical(const std::vector<std::string>& reads,
+                                                            const AlignConfig& config,
+                                                            int minCoverage, int numGroups,
+                                                            int numThreads)
+{
+    const int numReads = reads.size();
+    if (numGroups <= 1 || numReads <= numGroups) {
+        return FindConsensus(reads, config, minCoverage);
+    }
+
+    // Interleaving the reads gives each group a like share of them,
+    // however they are ordered
+    std::vector<std::vector<std::string> > groups(numGroups);
+    for (int k = 0; k < numReads; k++) {
+        groups[k % numGroups].push_back(reads[k]);
+    }
+    std::vector<const PoaConsensus*> groupConsensi(numGroups, NULL);
+    PoaGraph pg;
+    ThreadPool pool(numThreads);
+    try {
+        pool.ParallelFor(numGroups, [&](int g) {
+            int groupMinCoverage = minCoverage;
+            if (minCoverage > 0) {
+                groupMinCoverage = static_cast<int64_t>(minCoverage) * groups[g].size() / numReads;
+            }
+            groupConsensi[g] = FindConsensus(groups[g], config, groupMinCoverage);
+        });
+
+        // The merge is banded as the reads of FindConsensus are
+        detail::MinimizerRangeFinder rangeFinder;
+        foreach (const PoaConsensus* pc, groupConsensi) {
+            if (pc->Sequence.length() > 0) pg.MergeConsensus(*pc, config, &rangeFinder);
+        }
+    } catch (...) {
+        foreach (const PoaConsensus* pc, groupConsensi) {
+            delete pc;
+        }
+        throw;
+    }
+    foreach (const PoaConsensus* pc, groupConsensi) {
+        delete pc;
+    }
+    return pg.ReleaseConsensus(config, minCoverage);
+}
+
+MappedRead PoaConsensus::ToMappedRead(int readIndex, const Read& read, StrandEnum strand) const
+{
+    if (readIndex < 0 || readIndex >= static_cast<int>(ReadPaths.size())) {
+        throw InvalidInputError("No path kept for this read");
+    }
+    const std::vector<PoaGraph::Vertex>& readPath = ReadPaths[readIndex];
+    const int I = readPath.size();
+    if (read.Length() != I) {
+        throw InvalidInputError("Read length differs from that given to FindConsensus");
+    }
+
+    // The consensus position of each vertex on the consensus path
+    std::vector<int> consensusPosition(Graph.NumVertices(), -1);
+    for (size_t j = 0; j < Path.size(); j++) {
+        consensusPosition[Path[j]] = j;
+    }
+
+    // The read bases threaded to consensus vertices are the anchors of
+    // its alignment to the consensus; both paths run through the graph
+    // in topological order, so the anchors are increasing in both.
+    std::vector<std::pair<int, int> > anchors;
+    for (int i = 0; i < I; i++) {
+        int j = consensusPosition[readPath[i]];
+        if (j >= 0) {
+            anchors.push_back(std::make_pair(i, j));
+        }
+    }
+    if (anchors.empty()) {
+        throw InvalidInputError("Read shares no base with the consensus");
+    }
+    const int templateStart = anchors.front().second;
+    const int templateEnd = anchors.back().second + 1;
+    const int J = templateEnd - templateStart;
+
+    // Base i against template base j puts the alignment at cell
+    // (i + 1, j + 1) of alpha.  Between two anchors, the alignment
+    // stays within the box they bound, so in column c it spans at most
+    // the rows from the last anchor at or before c to the first anchor
+    // after it (or the last row).
+    std::vector<int> anchorRow(J + 1, -1);
+    for (size_t k = 0; k < anchors.size(); k++) {
+        anchorRow[anchors[k].second - templateStart + 1] = anchors[k].first + 1;
+    }
+    std::vector<int> firstRowAfter(J + 1);
+    int nextRow = I;
+    for (int c = J; c >= 0; c--) {
+        firstRowAfter[c] = nextRow;
+        if (anchorRow[c] >= 0) nextRow = anchorRow[c];
+    }
+    std::vector<Interval> band(J + 1);
+    int lastRow = 0;
+    for (int c = 0; c <= J; c++) {
+        if (anchorRow[c] >= 0) lastRow = anchorRow[c];
+        band[c] = Interval(std::max(0, lastRow - POA_BAND_PADDING),
+                           std::min(I, firstRowAfter[c] + POA_BAND_PADDING) + 1);
+    }
+
+    // On the reverse strand, the read and the template window are both
+    // reversed, which turns cell (i, c) into (I - i, J - c)
+    MappedRead mr(read, strand, templateStart, templateEnd);
+    if (strand == REVERSE_STRAND) {
+        std::reverse(band.begin(), band.end());
+        foreach (Interval& rows, band) {
+            rows = Interval(I + 1 - rows.End, I + 1 - rows.Begin);
+        }
+    }
+    mr.BandHint.swap(band);
+    return mr;
+}
+
 std::string PoaConsensus::ToGraphViz(int flags) const { return Graph.ToGraphViz(flags, this); }
 
 void PoaConsensus::WriteGraphVizFile(std::string filename, int flags) const
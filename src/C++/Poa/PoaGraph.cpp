@@ -2,8 +2,14 @@
 // (Based on the original "Partial Order Aligner" by Lee, Grasso, and Sharlow,
 //  and an implementation in C# by Patrick Marks)
 
+#include <ConsensusCore/Poa/PoaConsensus.hpp>
 #include <ConsensusCore/Poa/PoaGraph.hpp>
 
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <utility>
+
 #include "PoaGraphImpl.hpp"
 
 namespace ConsensusCore {
@@ -29,18 +35,67 @@ PoaAlignmentMatrix* PoaGraph::TryAddRead(const std::string& sequence, const Alig
     return impl->TryAddRead(sequence, config, rangeFinder);
 }
 
+std::vector<PoaAlignmentMatrix*> PoaGraph::TryAddReads(const std::vector<std::string>& sequences,
+                                                       const AlignConfig& config,
+                                                       int numThreads) const
+{
+    std::vector<detail::PoaAlignmentMatrixImpl*> mats =
+        impl->TryAddReads(sequences, config, numThreads);
+    return std::vector<PoaAlignmentMatrix*>(mats.begin(), mats.end());
+}
+
 void PoaGraph::CommitAdd(PoaAlignmentMatrix* mat, std::vector<Vertex>* readPathOutput)
 {
     impl->CommitAdd(mat, readPathOutput);
 }
 
+void PoaGraph::MergeConsensus(const PoaConsensus& pc, const AlignConfig& config,
+                              detail::SdpRangeFinder* rangeFinder,
+                              std::vector<Vertex>* readPathOutput)
+{
+    impl->MergeConsensus(*pc.Graph.impl, pc.Path, pc.Sequence, config, rangeFinder,
+                         readPathOutput);
+}
+
 size_t PoaGraph::NumReads() const { return impl->NumReads(); }
 
+size_t PoaGraph::NumVertices() const { return impl->NumVertices(); }
+
+void PoaGraph::SetNumThreads(int numThreads) { impl->SetNumThreads(numThreads); }
+
+int PoaGraph::NumThreads() const { return impl->NumThreads(); }
+
+void PoaGraph::SetMemoryBudget(size_t bytes) { impl->SetMemoryBudget(bytes); }
+
+size_t PoaGraph::MemoryBudget() const { return impl->MemoryBudget(); }
+
+size_t PoaGraph::Prune(int minReads, const AlignConfig& config)
+{
+    return impl->Prune(minReads, config.Mode);
+}
+
 const PoaConsensus* PoaGraph::FindConsensus(const AlignConfig& config, int minCoverage) const
 {
     return impl->FindConsensus(config, minCoverage);
 }
 
+const PoaConsensus* PoaGraph::ReleaseConsensus(const AlignConfig& config, int minCoverage)
+{
+    return ReleaseConsensus(config, minCoverage, std::vector<std::vector<Vertex> >());
+}
+
+const PoaConsensus* PoaGraph::ReleaseConsensus(const AlignConfig& config, int minCoverage,
+                                               std::vector<std::vector<Vertex> >&& readPaths)
+{
+    std::string consensusSequence;
+    std::vector<Vertex> bestPath = impl->FindConsensusPath(config, minCoverage, &consensusSequence);
+    std::unique_ptr<detail::PoaGraphImpl> empty(new detail::PoaGraphImpl());
+    const PoaConsensus* pc =
+        new PoaConsensus(consensusSequence, std::move(*this), bestPath, std::move(readPaths));
+    impl = empty.release();
+    return pc;
+}
+
 string PoaGraph::ToGraphViz(int flags, const PoaConsensus* pc) const
 {
     return impl->ToGraphViz(flags, pc);
@@ -51,11 +106,60 @@ void PoaGraph::WriteGraphVizFile(string filename, int flags, const PoaConsensus*
     impl->WriteGraphVizFile(filename, flags, pc);
 }
 
+std::string PoaGraph::ToBinary() const { return impl->ToBinary(); }
+
+PoaGraph PoaGraph::FromBinary(const char* data, size_t size)
+{
+    PoaGraph g;
+    g.impl->LoadBinary(data, size);
+    return g;
+}
+
+void PoaGraph::WriteBinaryFile(const std::string& filename) const
+{
+    const std::string bytes = impl->ToBinary();
+    std::ofstream outfile(filename.c_str(), std::ios::binary);
+    outfile.write(bytes.data(), bytes.size());
+    outfile.close();
+    if (!outfile) {
+        throw InvalidInputError("Could not write POA graph file: " + filename);
+    }
+}
+
+PoaGraph PoaGraph::ReadBinaryFile(const std::string& filename)
+{
+    std::ifstream infile(filename.c_str(), std::ios::binary);
+    if (!infile) {
+        throw InvalidInputError("Could not open POA graph file: " + filename);
+    }
+    const std::string bytes((std::istreambuf_iterator<char>(infile)),
+                            std::istreambuf_iterator<char>());
+    return FromBinary(bytes.data(), bytes.size());
+}
+
 PoaGraph::PoaGraph() { impl = new detail::PoaGraphImpl(); }
 
 PoaGraph::PoaGraph(const PoaGraph& other) { impl = new detail::PoaGraphImpl(*other.impl); }
 
 PoaGraph::PoaGraph(const detail::PoaGraphImpl& o) { impl = new detail::PoaGraphImpl(o); }
 
+PoaGraph::PoaGraph(PoaGraph&& other) noexcept : impl(other.impl) { other.impl = NULL; }
+
 PoaGraph::~PoaGraph() { delete impl; }
+
+PoaGraph& PoaGraph::operator=(const PoaGraph& other)
+{
+    if (this != &other) {
+        detail::PoaGraphImpl* copy = new detail::PoaGraphImpl(*other.impl);
+        delete impl;
+        impl = copy;
+    }
+    return *this;
+}
+
+PoaGraph& PoaGraph::operator=(PoaGraph&& other) noexcept
+{
+    std::swap(impl, other.impl);
+    return *this;
+}
 }
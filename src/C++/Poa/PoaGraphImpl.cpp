@@ -2,79 +2,153 @@
 
 #include <ConsensusCore/Align/AlignConfig.hpp>
 #include <ConsensusCore/Interval.hpp>
+#include <ConsensusCore/PerfStats.hpp>
 #include <ConsensusCore/Poa/PoaConsensus.hpp>
 #include <ConsensusCore/Poa/PoaGraph.hpp>
 #include <ConsensusCore/Poa/RangeFinder.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 #include <ConsensusCore/Utils.hpp>
 
-#include <boost/graph/copy.hpp>
-#include <boost/graph/graphviz.hpp>
-#include <boost/graph/topological_sort.hpp>
+#include <boost/format.hpp>
 
+#include <emmintrin.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <sstream>
+
+namespace ConsensusCore {
+namespace detail {
 
-namespace boost {
-using ConsensusCore::detail::VertexInfoMap;
-using ConsensusCore::PoaConsensus;
-using ConsensusCore::PoaGraph;
-using ConsensusCore::detail::VD;
 using boost::format;
 
-class my_label_writer
+// ----------------- PoaAlignmentMatrixImpl ---------------------
+
+PoaAlignmentMatrixImpl::PoaAlignmentMatrixImpl()
+    : columns_()
+    , readSequence_()
+    , mode_(GLOBAL)
+    , score_(-FLT_MAX)
+    , heldSegment_(-1)
+    , config_(AlignParams(0, 0, 0, 0), GLOBAL)
+    , exitScore_(-FLT_MAX)
+    , exitFrom_(null_vertex)
+    , columnStore_()
+    , scoreStore_()
+    , tracebackStore_()
+    , originStore_()
+    , columnsUsed_(0)
+    , cellsUsed_(0)
+    , originsUsed_(0)
+    , checkpointed_(false)
+    , numRows_(0)
+    , freeSlots_()
+    , slotOf_()
+    , accounted_(POA_MEMORY)
 {
-public:
-    my_label_writer(VertexInfoMap map, bool color, bool verbose, const PoaConsensus* pc = NULL)
-        : map_(map), cssVtxs_(), color_(color), verbose_(verbose)
-    {
-        if (pc != NULL) {
-            cssVtxs_.insert(pc->Path.begin(), pc->Path.end());
-        }
-    }
+}
 
-    template <class descriptor>
-    void operator()(std::ostream& out, const descriptor& v) const
-    {
-        PoaGraph::Vertex vertexId = map_[v].Id;
+PoaAlignmentMatrixImpl::~PoaAlignmentMatrixImpl() {}
 
-        std::string nodeColoringAttribute =
-            (color_ && isInConsensus(vertexId) ? " style=\"filled\", fillcolor=\"lightblue\" ,"
-                                               : "");
+void PoaAlignmentMatrixImpl::Reset(size_t numVertices, size_t numEdges, int numRows)
+{
+    // Every column has at most its predecessors and ^ as origins; the
+    // column for $ has just one.
+    columns_.assign(numVertices, NULL);
+    columnStore_.resize(numVertices);
+    scoreStore_.resize(numVertices * numRows);
+    tracebackStore_.resize(numVertices * numRows);
+    originStore_.resize(numEdges + numVertices);
+    columnsUsed_ = cellsUsed_ = originsUsed_ = 0;
+    checkpointed_ = false;
+    accounted_.Set(columnStore_.capacity() * sizeof(AlignmentColumn) +
+                   scoreStore_.capacity() * sizeof(float) +
+                   tracebackStore_.capacity() * sizeof(uint16_t) +
+                   originStore_.capacity() * sizeof(VD));
+}
 
-        if (!verbose_) {
-            out << format("[shape=Mrecord,%s label=\"{ %c | %d }\"]") % nodeColoringAttribute %
-                       map_[v].Base % map_[v].Reads;
-        } else {
-            out << format(
-                       "[shape=Mrecord,%s label=\"{ "
-                       "{ %d | %c } |"
-                       "{ %d | %d } |"
-                       "{ %0.2f | %0.2f } }\"]") %
-                       nodeColoringAttribute % vertexId % map_[v].Base % map_[v].Reads %
-                       map_[v].SpanningReads % map_[v].Score % map_[v].ReachingScore;
-        }
+void PoaAlignmentMatrixImpl::ResetCheckpointed(size_t numVertices, size_t numEdges, int numRows,
+                                               size_t numSlots)
+{
+    // Columns are indexed by vertex, so that a remade column reuses
+    // the origins its first making claimed
+    columns_.assign(numVertices, NULL);
+    columnStore_.assign(numVertices, AlignmentColumn());
+    scoreStore_.resize(numSlots * numRows);
+    tracebackStore_.resize(numSlots * numRows);
+    originStore_.resize(numEdges + numVertices);
+    columnsUsed_ = cellsUsed_ = originsUsed_ = 0;
+    checkpointed_ = true;
+    numRows_ = numRows;
+    freeSlots_.resize(numSlots);
+    for (size_t k = 0; k < numSlots; k++) {
+        freeSlots_[k] = numSlots - 1 - k;
     }
+    slotOf_.assign(numVertices, 0);
+    heldSegment_ = -1;
+    exitScore_ = -FLT_MAX;
+    exitFrom_ = null_vertex;
+    accounted_.Set(columnStore_.capacity() * sizeof(AlignmentColumn) +
+                   scoreStore_.capacity() * sizeof(float) +
+                   tracebackStore_.capacity() * sizeof(uint16_t) +
+                   originStore_.capacity() * sizeof(VD));
+}
 
-private:
-    bool isInConsensus(PoaGraph::Vertex v) const { return cssVtxs_.find(v) != cssVtxs_.end(); }
+AlignmentColumn* PoaAlignmentMatrixImpl::NewColumn(VD v, int beginRow, int endRow, int maxOrigins)
+{
+    const int numRows = endRow - beginRow;
+    if (checkpointed_) {
+        assert(columns_[v] == NULL && !freeSlots_.empty() && numRows <= numRows_);
+        slotOf_[v] = freeSlots_.back();
+        freeSlots_.pop_back();
+        float* score = &scoreStore_[0] + slotOf_[v] * numRows_;
+        uint16_t* traceback = &tracebackStore_[0] + slotOf_[v] * numRows_;
+        std::fill(score, score + numRows, -FLT_MAX);
+        std::fill(traceback, traceback + numRows, static_cast<uint16_t>(InvalidMove));
 
-    VertexInfoMap map_;
-    std::set<PoaGraph::Vertex> cssVtxs_;
-    bool color_;
-    bool verbose_;
-};
-}
+        AlignmentColumn* col = &columnStore_[v];
+        col->CurrentVertex = v;
+        col->Score = VectorViewL<float>(score, beginRow, endRow);
+        col->Traceback = VectorViewL<uint16_t>(traceback, beginRow, endRow);
+        if (col->Origins == NULL) {
+            col->Origins = &originStore_[0] + originsUsed_.fetch_add(maxOrigins);
+        }
+        col->NumOrigins = 0;
+        return col;
+    }
 
-namespace ConsensusCore {
-namespace detail {
+    assert(columnsUsed_ < columnStore_.size());
+    assert(cellsUsed_ + numRows <= scoreStore_.size());
+    assert(originsUsed_ + maxOrigins <= originStore_.size());
 
-// ----------------- PoaAlignmentMatrixImpl ---------------------
+    // Each claim is a single atomic add, so that columns made
+    // concurrently get storage of their own
+    size_t cells = cellsUsed_.fetch_add(numRows, std::memory_order_relaxed);
+    float* score = &scoreStore_[0] + cells;
+    uint16_t* traceback = &tracebackStore_[0] + cells;
+    std::fill(score, score + numRows, -FLT_MAX);
+    std::fill(traceback, traceback + numRows, static_cast<uint16_t>(InvalidMove));
 
-PoaAlignmentMatrixImpl::~PoaAlignmentMatrixImpl()
+    AlignmentColumn* col = &columnStore_[columnsUsed_.fetch_add(1, std::memory_order_relaxed)];
+    col->CurrentVertex = v;
+    col->Score = VectorViewL<float>(score, beginRow, endRow);
+    col->Traceback = VectorViewL<uint16_t>(traceback, beginRow, endRow);
+    col->Origins =
+        &originStore_[0] + originsUsed_.fetch_add(maxOrigins, std::memory_order_relaxed);
+    col->NumOrigins = 0;
+    return col;
+}
+
+void PoaAlignmentMatrixImpl::FreeColumn(VD v)
 {
-    foreach (AlignmentColumnMap::value_type& kv, columns_) {
-        delete kv.second;
-    }
+    assert(checkpointed_ && columns_[v] != NULL);
+    freeSlots_.push_back(slotOf_[v]);
+    columns_[v] = NULL;
 }
 
 float PoaAlignmentMatrixImpl::Score() const { return score_; }
@@ -82,18 +156,39 @@ float PoaAlignmentMatrixImpl::Score() const { return score_; }
 // ----------------- PoaGraphImpl ---------------------
 
 PoaGraphImpl::PoaGraphImpl()
-    : g_(), vertexInfoMap_(get(vertex_info, g_)), numReads_(0), totalVertices_(0), liveVertices_(0)
+    : numReads_(0)
+    , consensusPath_()
+    , consensusPathValid_(false)
+    , consensusPathMode_(GLOBAL)
+    , consensusPathMinCoverage_(0)
+    , bestPrevVertex_()
+    , columnPool_()
+    , memoryBudget_(0)
 {
     enterVertex_ = addVertex('^', 0);
     exitVertex_ = addVertex('$', 0);
+    reindex();
 }
 
 PoaGraphImpl::PoaGraphImpl(const PoaGraphImpl& other)
-    : g_(other.g_)
-    , vertexInfoMap_(get(vertex_info, g_))
+    : nodes_(other.nodes_)
+    , out_(other.out_)
+    , edges_(other.edges_)
+    , predOffsets_(other.predOffsets_)
+    , preds_(other.preds_)
+    , succOffsets_(other.succOffsets_)
+    , succs_(other.succs_)
+    , topoOrder_(other.topoOrder_)
     , enterVertex_(other.enterVertex_)
     , exitVertex_(other.exitVertex_)
     , numReads_(other.numReads_)
+    , consensusPath_()
+    , consensusPathValid_(false)
+    , consensusPathMode_(GLOBAL)
+    , consensusPathMinCoverage_(0)
+    , bestPrevVertex_()
+    , columnPool_(other.columnPool_)
+    , memoryBudget_(other.memoryBudget_)
 {
 }
 
@@ -102,53 +197,142 @@ PoaGraphImpl::~PoaGraphImpl() {}
 void PoaGraphImpl::repCheck() const
 {
     // assert the representation invariant for the object
-    foreach (VD v, vertices(g_)) {
+    assert(topoOrder_.size() == numVertices());
+    for (VD v = 0; v < numVertices(); v++) {
+        assert(nodes_[v].Id == v);
         if (v == enterVertex_) {
-            assert(in_degree(v, g_) == 0);
-            assert(out_degree(v, g_) > 0 || NumReads() == 0);
+            assert(inDegree(v) == 0);
+            assert(outDegree(v) > 0 || NumReads() == 0);
         } else if (v == exitVertex_) {
-            assert(in_degree(v, g_) > 0 || NumReads() == 0);
-            assert(out_degree(v, g_) == 0);
+            assert(inDegree(v) > 0 || NumReads() == 0);
+            assert(outDegree(v) == 0);
         } else {
-            assert(in_degree(v, g_) > 0);
-            assert(out_degree(v, g_) > 0);
+            assert(inDegree(v) > 0);
+            assert(outDegree(v) > 0);
         }
     }
 }
 
-static inline vector<const AlignmentColumn*> getPredecessorColumns(const BoostGraph& g, VD v,
-                                                                   const AlignmentColumnMap& colMap)
+void PoaGraphImpl::reindex()
+{
+    const size_t n = numVertices();
+
+    // Successors, sorted by index
+    succOffsets_.assign(n + 1, 0);
+    succs_.clear();
+    succs_.reserve(edges_.size());
+    for (VD u = 0; u < n; u++) {
+        succOffsets_[u] = succs_.size();
+        succs_.insert(succs_.end(), out_[u].begin(), out_[u].end());
+        std::sort(succs_.begin() + succOffsets_[u], succs_.end());
+    }
+    succOffsets_[n] = succs_.size();
+
+    // Predecessors; filling them from the sources in increasing order
+    // leaves each list sorted by index.
+    predOffsets_.assign(n + 1, 0);
+    for (size_t k = 0; k < succs_.size(); k++) {
+        predOffsets_[succs_[k] + 1]++;
+    }
+    for (VD v = 0; v < n; v++) {
+        predOffsets_[v + 1] += predOffsets_[v];
+    }
+    preds_.resize(succs_.size());
+    std::vector<size_t> fill(predOffsets_.begin(), predOffsets_.end() - 1);
+    for (VD u = 0; u < n; u++) {
+        for (size_t k = succOffsets_[u]; k < succOffsets_[u + 1]; k++) {
+            preds_[fill[succs_[k]]++] = u;
+        }
+    }
+
+    // Topological order: reverse postorder of a depth-first search
+    // started from each vertex in turn, in index order---the order
+    // boost::topological_sort produced for this graph.
+    topoOrder_.resize(n);
+    size_t next = n;
+    std::vector<bool> visited(n, false);
+    std::vector<std::pair<VD, size_t> > stack;
+    for (VD root = 0; root < n; root++) {
+        if (visited[root]) continue;
+        visited[root] = true;
+        stack.push_back(std::make_pair(root, succOffsets_[root]));
+        while (!stack.empty()) {
+            VD u = stack.back().first;
+            size_t& k = stack.back().second;
+            if (k < succOffsets_[u + 1]) {
+                VD w = succs_[k++];
+                if (!visited[w]) {
+                    visited[w] = true;
+                    stack.push_back(std::make_pair(w, succOffsets_[w]));
+                }
+            } else {
+                topoOrder_[--next] = u;
+                stack.pop_back();
+            }
+        }
+    }
+    assert(next == 0);
+}
+
+// Lanes of a where mask is set, of b elsewhere
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline vector<const AlignmentColumn*> getPredecessorColumns(
+    std::pair<const VD*, const VD*> preds, const AlignmentColumnMap& colMap)
 {
     vector<const AlignmentColumn*> predecessorColumns;
-    const AlignmentColumn* predCol;
-    foreach (ED e, inEdges(v, g)) {
-        VD u = source(e, g);
-        predCol = colMap.at(u);
+    predecessorColumns.reserve(preds.second - preds.first);
+    for (const VD* u = preds.first; u != preds.second; ++u) {
+        const AlignmentColumn* predCol = colMap[*u];
         assert(predCol != NULL);
         predecessorColumns.push_back(predCol);
     }
     return predecessorColumns;
 }
 
+// The score of the End move from predCol to $ under local or
+// semiglobal alignment: from its best row, or from the last
+static inline float exitMoveScore(const AlignmentColumn* predCol, AlignMode mode, int I)
+{
+    int prevRow = (mode == LOCAL ? ArgMax(predCol->Score) : I);
+    return predCol->ScoreAt(prevRow);
+}
+
+std::vector<Vertex> PoaGraphImpl::FindConsensusPath(const AlignConfig& config, int minCoverage,
+                                                     std::string* sequence)
+{
+    const std::vector<VD>& bestPath = consensusPath(config.Mode, minCoverage);
+    *sequence = sequenceAlongPath(nodes_, bestPath);
+    return externalizePath(bestPath);
+}
+
 PoaConsensus* PoaGraphImpl::FindConsensus(const AlignConfig& config, int minCoverage)
 {
-    std::vector<VD> bestPath = consensusPath(config.Mode, minCoverage);
-    std::string consensusSequence = sequenceAlongPath(g_, vertexInfoMap_, bestPath);
-    PoaConsensus* pc = new PoaConsensus(consensusSequence, *this, externalizePath(bestPath));
+    std::string consensusSequence;
+    std::vector<Vertex> bestPath = FindConsensusPath(config, minCoverage, &consensusSequence);
+    PoaConsensus* pc = new PoaConsensus(consensusSequence, *this, bestPath);
     return pc;
 }
 
-const AlignmentColumn* PoaGraphImpl::makeAlignmentColumnForExit(VD v,
-                                                                const AlignmentColumnMap& colMap,
+const AlignmentColumn* PoaGraphImpl::makeAlignmentColumnForExit(VD v, PoaAlignmentMatrixImpl* mat,
                                                                 const std::string& sequence,
                                                                 const AlignConfig& config) const
 {
-    assert(out_degree(v, g_) == 0);
+    const AlignmentColumnMap& colMap = mat->columns_;
+    assert(outDegree(v) == 0);
 
     // this is kind of unnecessary as we are only actually using one entry in this
     // column
     int I = sequence.length();
-    AlignmentColumn* curCol = new AlignmentColumn(v, I + 1);
+    AlignmentColumn* curCol = mat->NewColumn(v, 0, I + 1, 1);
 
     float bestScore = -FLT_MAX;
     VD prevVertex = null_vertex;
@@ -158,77 +342,100 @@ const AlignmentColumn* PoaGraphImpl::makeAlignmentColumnForExit(VD v,
     // in one step via the End move--not just its predecessors in
     // the graph.  In local alignment, it may have been from any
     // row, not necessarily I.
-    if (config.Mode == SEMIGLOBAL || config.Mode == LOCAL) {
-        foreach (VD u, vertices(g_)) {
+    if (mat->Checkpointed() && (config.Mode == SEMIGLOBAL || config.Mode == LOCAL)) {
+        // the columns, since dropped, were weighed as they were made
+        bestScore = mat->exitScore_;
+        prevVertex = mat->exitFrom_;
+    } else if (config.Mode == SEMIGLOBAL || config.Mode == LOCAL) {
+        for (VD u = 0; u < numVertices(); u++) {
             if (u != exitVertex_) {
-                const AlignmentColumn* predCol = colMap.at(u);
-                int prevRow = (config.Mode == LOCAL ? ArgMax(predCol->Score) : I);
-
-                if (predCol->Score[prevRow] > bestScore) {
-                    bestScore = predCol->Score[prevRow];
+                const AlignmentColumn* predCol = colMap[u];
+                float score = exitMoveScore(predCol, config.Mode, I);
+                if (score > bestScore) {
+                    bestScore = score;
                     prevVertex = predCol->CurrentVertex;
                 }
             }
         }
     } else {
         // regular predecessors
-        vector<const AlignmentColumn*> predecessorColumns = getPredecessorColumns(g_, v, colMap);
+        vector<const AlignmentColumn*> predecessorColumns =
+            getPredecessorColumns(predecessors(v), colMap);
         foreach (const AlignmentColumn* predCol, predecessorColumns) {
-            if (predCol->Score[I] > bestScore) {
-                bestScore = predCol->Score[I];
+            if (predCol->ScoreAt(I) > bestScore) {
+                bestScore = predCol->ScoreAt(I);
                 prevVertex = predCol->CurrentVertex;
             }
         }
     }
-    assert(prevVertex != null_vertex);
-    curCol->Score[I] = bestScore;
-    curCol->PreviousVertex[I] = prevVertex;
-    curCol->ReachingMove[I] = EndMove;
+    // (with a band too narrow, $ may be out of reach)
+    if (prevVertex != null_vertex) {
+        curCol->Score[I] = bestScore;
+        curCol->AddOrigin(prevVertex);
+        curCol->SetTraceback(I, EndMove, 0);
+    }
     return curCol;
 }
 
-const AlignmentColumn* PoaGraphImpl::makeAlignmentColumn(VD v, const AlignmentColumnMap& colMap,
+const AlignmentColumn* PoaGraphImpl::makeAlignmentColumn(VD v, PoaAlignmentMatrixImpl* mat,
                                                          const std::string& sequence,
-                                                         const AlignConfig& config, int, int) const
+                                                         const AlignConfig& config, int beginRow,
+                                                         int endRow) const
 {
-    AlignmentColumn* curCol = new AlignmentColumn(v, sequence.length() + 1);
-    const PoaNode& vertexInfo = vertexInfoMap_[v];
-    vector<const AlignmentColumn*> predecessorColumns = getPredecessorColumns(g_, v, colMap);
+    const int I = sequence.length();
+    const PoaNode& vertexInfo = nodes_[v];
+    std::pair<const VD*, const VD*> preds = predecessors(v);
+    vector<const AlignmentColumn*> predecessorColumns = getPredecessorColumns(preds, mat->columns_);
+    const int numPreds = predecessorColumns.size();
+    if (numPreds + 1 > TRACEBACK_MAX_ORIGINS) {
+        throw InternalError("POA vertex has too many predecessors");
+    }
+
+    // Only rows [beginRow, endRow) are filled; cells outside them, here
+    // or in a predecessor's column, are unreachable.
+    beginRow = std::min(std::max(beginRow, 0), I);
+    endRow = std::min(std::max(endRow, beginRow + 1), I + 1);
+
+    // Traceback slots: the predecessors, then ^ for the Start move
+    AlignmentColumn* curCol = mat->NewColumn(v, beginRow, endRow, numPreds + 1);
+    for (const VD* u = preds.first; u != preds.second; ++u) {
+        curCol->AddOrigin(*u);
+    }
+    const int startSlot = numPreds;
+    if (config.Mode != GLOBAL) {
+        curCol->AddOrigin(enterVertex_);
+    }
 
     //
     // handle row 0 separately:
     //
-    if (predecessorColumns.size() == 0) {
+    if (beginRow > 0) {
+        // row 0 is out of the band
+    } else if (numPreds == 0) {
         // if this vertex doesn't have any in-edges it is ^; has
         // no reaching move
         assert(v == enterVertex_);
         curCol->Score[0] = 0;
-        curCol->ReachingMove[0] = InvalidMove;
-        curCol->PreviousVertex[0] = null_vertex;
+        curCol->SetTraceback(0, InvalidMove, 0);
     } else if (config.Mode == SEMIGLOBAL || config.Mode == LOCAL) {
         // under semiglobal or local alignment, we use the Start move
         curCol->Score[0] = 0;
-        curCol->ReachingMove[0] = StartMove;
-        curCol->PreviousVertex[0] = enterVertex_;
+        curCol->SetTraceback(0, StartMove, startSlot);
     } else {
         // otherwise it's a deletion
-        float candidateScore;
         float bestScore = -FLT_MAX;
-        VD prevVertex = null_vertex;
-        MoveType reachingMove = InvalidMove;
-
-        foreach (const AlignmentColumn* prevCol, predecessorColumns) {
-            candidateScore = prevCol->Score[0] + config.Params.Delete;
+        int bestSlot = -1;
+        for (int p = 0; p < numPreds; p++) {
+            float candidateScore = predecessorColumns[p]->ScoreAt(0) + config.Params.Delete;
             if (candidateScore > bestScore) {
                 bestScore = candidateScore;
-                prevVertex = prevCol->CurrentVertex;
-                reachingMove = DeleteMove;
+                bestSlot = p;
             }
         }
-        assert(reachingMove != InvalidMove);
-        curCol->Score[0] = bestScore;
-        curCol->ReachingMove[0] = reachingMove;
-        curCol->PreviousVertex[0] = prevVertex;
+        if (bestSlot >= 0) {
+            curCol->Score[0] = bestScore;
+            curCol->SetTraceback(0, DeleteMove, bestSlot);
+        }
     }
 
     //
@@ -236,50 +443,128 @@ const AlignmentColumn* PoaGraphImpl::makeAlignmentColumn(VD v, const AlignmentCo
     //
     // i represents position in array
     // readPos=i-1 represents position in read
-    for (unsigned int i = 1, readPos = 0; i <= sequence.length(); i++, readPos++) {
-        float candidateScore, bestScore;
-        VD prevVertex;
-        MoveType reachingMove;
-
-        if (config.Mode == LOCAL) {
-            bestScore = 0;
-            prevVertex = enterVertex_;
-            reachingMove = StartMove;
-        } else {
-            bestScore = -FLT_MAX;
-            prevVertex = null_vertex;
-            reachingMove = InvalidMove;
+    //
+    // The Match/Mismatch and Delete moves read only the predecessor
+    // columns, so they are scored first, four rows at a time where every
+    // predecessor has the rows needed; the Extra moves, which chain down
+    // the column, follow in a second pass.  Candidates are compared in
+    // the same order, with the same strict inequality, in both the
+    // vector and the scalar code, so ties are broken identically.
+    const bool local = (config.Mode == LOCAL);
+    const float initialScore = local ? 0 : -FLT_MAX;
+    const MoveType initialMove = local ? StartMove : InvalidMove;
+    const int initialSlot = local ? startSlot : 0;
+    float* score = &curCol->Score[beginRow];  // score[i - beginRow] is row i
+
+    const int firstRow = std::max(beginRow, 1);
+    int vectorBegin = firstRow;
+    int vectorEnd = firstRow;
+    if (numPreds > 0) {
+        vectorEnd = endRow;
+        foreach (const AlignmentColumn* predCol, predecessorColumns) {
+            vectorBegin = std::max(vectorBegin, predCol->BeginRow() + 1);
+            vectorEnd = std::min(vectorEnd, predCol->EndRow());
         }
+    }
 
-        foreach (const AlignmentColumn* prevCol, predecessorColumns) {
+    auto scoreRow = [&](int i) {
+        int readPos = i - 1;
+        float bestScore = initialScore;
+        MoveType reachingMove = initialMove;
+        int bestSlot = initialSlot;
+
+        for (int p = 0; p < numPreds; p++) {
+            const AlignmentColumn* prevCol = predecessorColumns[p];
             // Incorporate (Match or Mismatch)
             bool isMatch = sequence[readPos] == vertexInfo.Base;
-            candidateScore =
-                prevCol->Score[i - 1] + (isMatch ? config.Params.Match : config.Params.Mismatch);
+            float candidateScore =
+                prevCol->ScoreAt(i - 1) + (isMatch ? config.Params.Match : config.Params.Mismatch);
             if (candidateScore > bestScore) {
                 bestScore = candidateScore;
-                prevVertex = prevCol->CurrentVertex;
+                bestSlot = p;
                 reachingMove = (isMatch ? MatchMove : MismatchMove);
             }
             // Delete
-            candidateScore = prevCol->Score[i] + config.Params.Delete;
+            candidateScore = prevCol->ScoreAt(i) + config.Params.Delete;
             if (candidateScore > bestScore) {
                 bestScore = candidateScore;
-                prevVertex = prevCol->CurrentVertex;
+                bestSlot = p;
                 reachingMove = DeleteMove;
             }
         }
-        // Extra
-        candidateScore = curCol->Score[i - 1] + config.Params.Insert;
-        if (candidateScore > bestScore) {
-            bestScore = candidateScore;
-            prevVertex = v;
-            reachingMove = ExtraMove;
+        score[i - beginRow] = bestScore;
+        curCol->SetTraceback(i, reachingMove, bestSlot);
+    };
+
+    // rows before those every predecessor has
+    int i = firstRow;
+    for (; i < std::min(vectorBegin, endRow); i++) {
+        scoreRow(i);
+    }
+
+    if (numPreds > 0) {
+        const __m128i base4 = _mm_set1_epi32(static_cast<unsigned char>(vertexInfo.Base));
+        const __m128 match4 = _mm_set1_ps(config.Params.Match);
+        const __m128 mismatch4 = _mm_set1_ps(config.Params.Mismatch);
+        const __m128 delete4 = _mm_set1_ps(config.Params.Delete);
+        const __m128i matchMove4 = _mm_set1_epi32(MatchMove);
+        const __m128i mismatchMove4 = _mm_set1_epi32(MismatchMove);
+        const __m128i deleteMove4 = _mm_set1_epi32(DeleteMove);
+
+        for (; i + 4 <= vectorEnd; i += 4) {
+            // the read bases of rows i..i+3, one to a lane
+            int32_t bases_;
+            memcpy(&bases_, &sequence[i - 1], sizeof(bases_));
+            __m128i bases = _mm_cvtsi32_si128(bases_);
+            bases = _mm_unpacklo_epi8(bases, _mm_setzero_si128());
+            bases = _mm_unpacklo_epi16(bases, _mm_setzero_si128());
+            __m128i isMatch = _mm_cmpeq_epi32(bases, base4);
+            __m128 subst = Select(_mm_castsi128_ps(isMatch), match4, mismatch4);
+            __m128i substMove = Select(isMatch, matchMove4, mismatchMove4);
+
+            __m128 best = _mm_set1_ps(initialScore);
+            __m128i move = _mm_set1_epi32(initialMove);
+            __m128i slot = _mm_set1_epi32(initialSlot);
+            for (int p = 0; p < numPreds; p++) {
+                const float* prevScore = &predecessorColumns[p]->Score[i - 1];
+                __m128i p4 = _mm_set1_epi32(p);
+                // Incorporate (Match or Mismatch)
+                __m128 candidate = _mm_add_ps(_mm_loadu_ps(prevScore), subst);
+                __m128 better = _mm_cmpgt_ps(candidate, best);
+                best = Select(better, candidate, best);
+                move = Select(_mm_castps_si128(better), substMove, move);
+                slot = Select(_mm_castps_si128(better), p4, slot);
+                // Delete
+                candidate = _mm_add_ps(_mm_loadu_ps(prevScore + 1), delete4);
+                better = _mm_cmpgt_ps(candidate, best);
+                best = Select(better, candidate, best);
+                move = Select(_mm_castps_si128(better), deleteMove4, move);
+                slot = Select(_mm_castps_si128(better), p4, slot);
+            }
+
+            int32_t moves_[4], slots_[4];
+            _mm_storeu_ps(score + i - beginRow, best);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(moves_), move);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(slots_), slot);
+            for (int k = 0; k < 4; k++) {
+                curCol->SetTraceback(i + k, static_cast<MoveType>(moves_[k]), slots_[k]);
+            }
+        }
+    }
+
+    // rows left over from the vector loop
+    for (; i < endRow; i++) {
+        scoreRow(i);
+    }
+
+    // Extra
+    for (i = beginRow + 1; i < endRow; i++) {
+        float candidateScore = score[i - 1 - beginRow] + config.Params.Insert;
+        if (candidateScore > score[i - beginRow]) {
+            score[i - beginRow] = candidateScore;
+            curCol->SetTraceback(i, ExtraMove, 0);
         }
-        assert(reachingMove != InvalidMove);
-        curCol->Score[i] = bestScore;
-        curCol->ReachingMove[i] = reachingMove;
-        curCol->PreviousVertex[i] = prevVertex;
+        assert(curCol->ReachingMove(i) != InvalidMove || score[i - beginRow] == -FLT_MAX);
     }
 
     return curCol;
@@ -291,9 +576,12 @@ void PoaGraphImpl::AddRead(const std::string& readSeq, const AlignConfig& config
     if (NumReads() == 0) {
         AddFirstRead(readSeq, readPathOutput);
     } else {
-        PoaAlignmentMatrixImpl* mat = TryAddRead(readSeq, config, rangeFinder);
-        CommitAdd(mat, readPathOutput);
-        delete mat;
+        // One matrix per thread, reused from read to read (and graph to
+        // graph), so that adding reads doesn't allocate once it has grown
+        // to the largest graph and read seen.
+        static thread_local PoaAlignmentMatrixImpl scratchMatrix;
+        fillAlignmentMatrix(readSeq, config, rangeFinder, &scratchMatrix);
+        CommitAdd(&scratchMatrix, readPathOutput);
     }
 }
 
@@ -305,6 +593,7 @@ void PoaGraphImpl::AddFirstRead(const std::string& readSeq, std::vector<Vertex>*
 
     threadFirstRead(readSeq, readPathOutput);
     numReads_++;
+    consensusPathValid_ = false;
 
     DEBUG_ONLY(repCheck());
 }
@@ -312,6 +601,53 @@ void PoaGraphImpl::AddFirstRead(const std::string& readSeq, std::vector<Vertex>*
 PoaAlignmentMatrixImpl* PoaGraphImpl::TryAddRead(const std::string& readSeq,
                                                  const AlignConfig& config,
                                                  SdpRangeFinder* rangeFinder) const
+{
+    PERF_SCOPE(PERF_TRY_ADD_READ);
+    PoaAlignmentMatrixImpl* mat = new PoaAlignmentMatrixImpl();
+    fillAlignmentMatrix(readSeq, config, rangeFinder, mat);
+    return mat;
+}
+
+std::vector<PoaAlignmentMatrixImpl*> PoaGraphImpl::TryAddReads(
+    const std::vector<std::string>& readSeqs, const AlignConfig& config, int numThreads) const
+{
+    if (NumReads() == 0) {
+        throw InvalidInputError("Reads can only be tried against a graph with reads in it.");
+    }
+    foreach (const std::string& readSeq, readSeqs) {
+        if (readSeq.length() == 0) {
+            throw InvalidInputError("Input sequences must have nonzero length.");
+        }
+    }
+
+    // The fill is read-only on the graph but for the consensus path
+    // the range finders ask for, so find that first; the workers then
+    // all share it.  Range finders keep per-read state, so each read
+    // gets one of its own.
+    consensusPath(config.Mode);
+
+    const int n = readSeqs.size();
+    std::vector<PoaAlignmentMatrixImpl*> mats(n, NULL);
+    ThreadPool pool(numThreads);
+    try {
+        pool.ParallelFor(n, [&](int i) {
+            // The reads are in parallel already, so not their columns
+            MinimizerRangeFinder rangeFinder;
+            mats[i] = new PoaAlignmentMatrixImpl();
+            fillAlignmentMatrix(readSeqs[i], config, &rangeFinder, mats[i], false);
+        });
+    } catch (...) {
+        foreach (PoaAlignmentMatrixImpl* mat, mats) {
+            delete mat;
+        }
+        throw;
+    }
+    return mats;
+}
+
+void PoaGraphImpl::fillAlignmentMatrix(const std::string& readSeq, const AlignConfig& config,
+                                       SdpRangeFinder* rangeFinder, PoaAlignmentMatrixImpl* mat,
+                                       bool parallel) const
 {
     DEBUG_ONLY(repCheck());
     assert(readSeq.length() > 0);
@@ -322,60 +658,418 @@ PoaAlignmentMatrixImpl* PoaGraphImpl::TryAddRead(const std::string& readSeq,
         // NB: no minCoverage applicable here; this
         // "intermediate" consensus may include extra sequence
         // at either end
-        std::vector<VD> cssPath = consensusPath(config.Mode);
-        std::string cssSeq = sequenceAlongPath(g_, vertexInfoMap_, cssPath);
+        const std::vector<VD>& cssPath = consensusPath(config.Mode);
+        std::string cssSeq = sequenceAlongPath(nodes_, cssPath);
         rangeFinder->InitRangeFinder(*this, externalizePath(cssPath), cssSeq, readSeq);
     }
 
     // Calculate alignment columns of sequence vs. graph, using sparsity if
-    // we have a range finder.
-    PoaAlignmentMatrixImpl* mat = new PoaAlignmentMatrixImpl();
+    // we have a range finder.  The range of read positions a vertex may
+    // align to takes rows [Begin, End + 1); ^ gets the whole column, so
+    // that the read may begin anywhere.
     mat->readSequence_ = readSeq;
     mat->mode_ = config.Mode;
 
-    vector<VD> sortedVertices(num_vertices(g_));
-    topological_sort(g_, sortedVertices.rbegin());
-    const AlignmentColumn* curCol;
-    foreach (VD v, sortedVertices) {
-        if (v != exitVertex_) {
-            Interval rowRange;
-            if (rangeFinder) {
-                rowRange = rangeFinder->FindAlignableRange(externalize(v));
+    // Over budget, the matrix is checkpointed
+    if (memoryBudget_ > 0) {
+        const int I = readSeq.size();
+        std::vector<Interval> rowRanges(numVertices(), Interval(0, I));
+        size_t cells = 0;
+        for (VD v = 0; v < numVertices(); v++) {
+            if (rangeFinder && v != enterVertex_ && v != exitVertex_) {
+                rowRanges[v] = rangeFinder->FindAlignableRange(externalize(v));
+            }
+            int beginRow = std::min(std::max(rowRanges[v].Begin, 0), I);
+            cells += std::min(std::max(rowRanges[v].End + 1, beginRow + 1), I + 1) - beginRow;
+        }
+        if (cells * PoaAlignmentMatrixImpl::CELL_BYTES > memoryBudget_) {
+            fillCheckpointed(readSeq, config, rowRanges, mat);
+            if (rangeFinder != NULL && mat->score_ == -FLT_MAX) {
+                fillAlignmentMatrix(readSeq, config, NULL, mat, parallel);
+            }
+            return;
+        }
+    }
+
+    mat->Reset(numVertices(), succs_.size(), readSeq.size() + 1);
+
+    if (parallel && columnPool_ && numVertices() >= PARALLEL_POA_MIN_VERTICES) {
+        fillColumnsInParallel(readSeq, config, rangeFinder, mat);
+        mat->columns_[exitVertex_] = makeAlignmentColumnForExit(exitVertex_, mat, readSeq, config);
+    } else {
+        const AlignmentColumn* curCol;
+        foreach (VD v, topoOrder_) {
+            if (v != exitVertex_) {
+                Interval rowRange;
+                if (rangeFinder && v != enterVertex_) {
+                    rowRange = rangeFinder->FindAlignableRange(externalize(v));
+                } else {
+                    rowRange = Interval(0, readSeq.size());
+                }
+                curCol =
+                    makeAlignmentColumn(v, mat, readSeq, config, rowRange.Begin, rowRange.End + 1);
             } else {
-                rowRange = Interval(0, readSeq.size());
+                curCol = makeAlignmentColumnForExit(v, mat, readSeq, config);
             }
-            curCol = makeAlignmentColumn(v, mat->columns_, readSeq, config, rowRange.Begin,
-                                         rowRange.End);
-        } else {
-            curCol = makeAlignmentColumnForExit(v, mat->columns_, readSeq, config);
+            mat->columns_[v] = curCol;
         }
-        mat->columns_[v] = curCol;
     }
 
     mat->score_ = mat->columns_[exitVertex_]->Score[readSeq.size()];
+
+    // The band missed every alignment; fall back to the full matrix
+    if (rangeFinder != NULL && mat->score_ == -FLT_MAX) {
+        fillAlignmentMatrix(readSeq, config, NULL, mat, parallel);
+        return;
+    }
     DEBUG_ONLY(repCheck());
+}
 
-    return mat;
+void PoaGraphImpl::fillCheckpointed(const std::string& readSeq, const AlignConfig& config,
+                                    const std::vector<Interval>& rowRanges,
+                                    PoaAlignmentMatrixImpl* mat) const
+{
+    const size_t n = numVertices();
+    const int numRows = readSeq.size() + 1;
+
+    // Half the budget goes to the columns of a segment, the rest to
+    // those kept across segments---on graphs as near to linear as POA
+    // graphs are, a few at each segment's start.  $ comes last, in the
+    // last segment.
+    const size_t columnBytes = numRows * PoaAlignmentMatrixImpl::CELL_BYTES;
+    const size_t segmentLength = std::max<size_t>(1, memoryBudget_ / 2 / columnBytes);
+    mat->order_.clear();
+    foreach (VD v, topoOrder_) {
+        if (v != exitVertex_) mat->order_.push_back(v);
+    }
+    mat->order_.push_back(exitVertex_);
+    mat->segmentStarts_.clear();
+    mat->segmentOf_.assign(n, 0);
+    for (size_t k = 0; k < n; k++) {
+        if (k % segmentLength == 0) mat->segmentStarts_.push_back(k);
+        mat->segmentOf_[mat->order_[k]] = mat->segmentStarts_.size() - 1;
+    }
+    mat->segmentStarts_.push_back(n);
+
+    // A column is kept if a successor in a later segment reads it
+    size_t numKept = 0;
+    mat->kept_.assign(n, false);
+    for (VD u = 0; u < n; u++) {
+        std::pair<const VD*, const VD*> succs = successors(u);
+        for (const VD* w = succs.first; w != succs.second; ++w) {
+            if (mat->segmentOf_[*w] > mat->segmentOf_[u]) mat->kept_[u] = true;
+        }
+        if (u == exitVertex_) mat->kept_[u] = true;
+        if (mat->kept_[u]) numKept++;
+    }
+    mat->rowRanges_ = rowRanges;
+    mat->config_ = config;
+    mat->ResetCheckpointed(n, succs_.size(), numRows, numKept + segmentLength);
+
+    // Fill a segment at a time; the last is left held for the
+    // traceback to start in
+    const int numSegments = mat->segmentStarts_.size() - 1;
+    for (int s = 0; s < numSegments; s++) {
+        makeSegment(s, mat);
+    }
+    mat->score_ = mat->columns_[exitVertex_]->Score[readSeq.size()];
+}
+
+void PoaGraphImpl::makeSegment(int s, PoaAlignmentMatrixImpl* mat) const
+{
+    assert(mat->Checkpointed() && s != mat->heldSegment_);
+    if (mat->heldSegment_ >= 0) {
+        for (size_t k = mat->segmentStarts_[mat->heldSegment_];
+             k < mat->segmentStarts_[mat->heldSegment_ + 1]; k++) {
+            VD v = mat->order_[k];
+            if (!mat->kept_[v] && mat->columns_[v] != NULL) mat->FreeColumn(v);
+        }
+    }
+    mat->heldSegment_ = s;
+
+    // Predecessors in earlier segments are kept; the rest come first
+    // in the segment.  Under local or semiglobal alignment, the End
+    // move from each column is weighed as it is made, before $ is.
+    const AlignConfig& config = mat->config_;
+    const int I = mat->readSequence_.size();
+    for (size_t k = mat->segmentStarts_[s]; k < mat->segmentStarts_[s + 1]; k++) {
+        VD v = mat->order_[k];
+        if (mat->columns_[v] != NULL) continue;
+        if (v == exitVertex_) {
+            mat->columns_[v] = makeAlignmentColumnForExit(v, mat, mat->readSequence_, config);
+            continue;
+        }
+        const Interval& rowRange = mat->rowRanges_[v];
+        mat->columns_[v] = makeAlignmentColumn(v, mat, mat->readSequence_, config,
+                                               rowRange.Begin, rowRange.End + 1);
+        if (config.Mode == SEMIGLOBAL || config.Mode == LOCAL) {
+            // ties go to the lowest vertex, as in the unbounded fill
+            float score = exitMoveScore(mat->columns_[v], config.Mode, I);
+            if (score > mat->exitScore_ ||
+                (score == mat->exitScore_ && score > -FLT_MAX && v < mat->exitFrom_)) {
+                mat->exitScore_ = score;
+                mat->exitFrom_ = v;
+            }
+        }
+    }
+}
+
+void PoaGraphImpl::fillColumnsInParallel(const std::string& readSeq, const AlignConfig& config,
+                                         SdpRangeFinder* rangeFinder,
+                                         PoaAlignmentMatrixImpl* mat) const
+{
+    // A vertex is ready once its last predecessor's column is made;
+    // the worker making that column queues it.  A column's scores are
+    // published to the worker that takes up its successor through the
+    // queue's lock.
+    const size_t n = numVertices();
+    std::unique_ptr<std::atomic<int>[]> pending(new std::atomic<int>[n]);
+    std::vector<VD> ready;
+    ready.reserve(n);
+    for (VD v = 0; v < n; v++) {
+        pending[v] = inDegree(v);
+        if (inDegree(v) == 0 && v != exitVertex_) ready.push_back(v);
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    size_t remaining = n - 1;  // all but $
+    bool failed = false;
+
+    columnPool_->ParallelFor(columnPool_->NumThreads(), [&](int) {
+        while (true) {
+            VD v;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return !ready.empty() || remaining == 0 || failed; });
+                if (remaining == 0 || failed) return;
+                v = ready.back();
+                ready.pop_back();
+            }
+
+            std::vector<VD> nowReady;
+            try {
+                Interval rowRange = (rangeFinder && v != enterVertex_)
+                                        ? rangeFinder->FindAlignableRange(externalize(v))
+                                        : Interval(0, readSeq.size());
+                mat->columns_[v] =
+                    makeAlignmentColumn(v, mat, readSeq, config, rowRange.Begin, rowRange.End + 1);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+                wake.notify_all();
+                throw;
+            }
+            std::pair<const VD*, const VD*> succs = successors(v);
+            for (const VD* w = succs.first; w != succs.second; ++w) {
+                if (--pending[*w] == 0 && *w != exitVertex_) nowReady.push_back(*w);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.insert(ready.end(), nowReady.begin(), nowReady.end());
+            if (--remaining == 0 || nowReady.size() > 1) {
+                wake.notify_all();
+            } else if (nowReady.size() == 1) {
+                wake.notify_one();
+            }
+        }
+    });
 }
 
 void PoaGraphImpl::CommitAdd(PoaAlignmentMatrix* mat_, std::vector<Vertex>* readPathOutput)
 {
+    PERF_SCOPE(PERF_COMMIT_ADD);
     DEBUG_ONLY(repCheck());
 
     PoaAlignmentMatrixImpl* mat = static_cast<PoaAlignmentMatrixImpl*>(mat_);
-    tracebackAndThread(mat->readSequence_, mat->columns_, mat->mode_, readPathOutput);
+    tracebackAndThread(mat->readSequence_, mat, mat->mode_, readPathOutput);
     numReads_++;
+    consensusPathValid_ = false;
 
     DEBUG_ONLY(repCheck());
 }
 
+void PoaGraphImpl::MergeConsensus(const PoaGraphImpl& other, const std::vector<Vertex>& path,
+                                  const std::string& sequence, const AlignConfig& config,
+                                  SdpRangeFinder* rangeFinder,
+                                  std::vector<Vertex>* readPathOutput)
+{
+    if (sequence.length() == 0) {
+        throw InvalidInputError("Input sequences must have nonzero length.");
+    }
+    assert(path.size() == sequence.length());
+
+    // Thread the consensus as one read, then scale up what it added:
+    // the reads through each vertex it passed, and the spanning counts
+    // of the vertices tagged as within its span
+    std::vector<int> spanningBefore(numVertices());
+    for (VD v = 0; v < numVertices(); v++) {
+        spanningBefore[v] = nodes_[v].SpanningReads;
+    }
+    std::vector<Vertex> threaded;
+    AddRead(sequence, config, rangeFinder, &threaded);
+
+    const int weight = other.NumReads();
+    for (size_t i = 0; i < threaded.size(); i++) {
+        const PoaNode& source = other.nodes_[other.internalize(path[i])];
+        nodes_[internalize(threaded[i])].Reads += source.Reads - 1;
+    }
+    for (VD v = 0; v < numVertices(); v++) {
+        int tagged = nodes_[v].SpanningReads - (v < spanningBefore.size() ? spanningBefore[v] : 0);
+        nodes_[v].SpanningReads += tagged * (weight - 1);
+    }
+    numReads_ += weight - 1;
+    consensusPathValid_ = false;
+
+    if (readPathOutput) readPathOutput->swap(threaded);
+}
+
+size_t PoaGraphImpl::Prune(int minReads, AlignMode mode)
+{
+    DEBUG_ONLY(repCheck());
+    const size_t n = numVertices();
+    if (numReads_ == 0) return 0;
+
+    // Keep ^, $, the consensus path, and whatever enough reads support
+    std::vector<bool> keep(n, false);
+    keep[enterVertex_] = keep[exitVertex_] = true;
+    foreach (VD v, consensusPath(mode)) {
+        keep[v] = true;
+    }
+    for (VD v = 0; v < n; v++) {
+        if (nodes_[v].Reads >= minReads) keep[v] = true;
+    }
+
+    // A kept vertex left with no kept successors gets an edge to each
+    // kept vertex it reached through pruned ones only, as does one
+    // left with no kept predecessors from each that reached it; the
+    // pruned runs become deletions, and no kept vertex is stranded.
+    std::vector<int> keptIn(n, 0), keptOut(n, 0);
+    for (VD u = 0; u < n; u++) {
+        std::pair<const VD*, const VD*> succs = successors(u);
+        for (const VD* w = succs.first; w != succs.second; ++w) {
+            if (keep[u] && keep[*w]) {
+                keptOut[u]++;
+                keptIn[*w]++;
+            }
+        }
+    }
+    std::vector<std::pair<VD, VD> > bridges;
+    std::vector<VD> stack;
+    std::vector<VD> visitedFrom(n, null_vertex);
+    for (VD u = 0; u < n; u++) {
+        if (!keep[u]) continue;
+        std::pair<const VD*, const VD*> succs = successors(u);
+        for (const VD* w = succs.first; w != succs.second; ++w) {
+            if (!keep[*w] && visitedFrom[*w] != u) {
+                visitedFrom[*w] = u;
+                stack.push_back(*w);
+            }
+        }
+        while (!stack.empty()) {
+            VD v = stack.back();
+            stack.pop_back();
+            succs = successors(v);
+            for (const VD* w = succs.first; w != succs.second; ++w) {
+                if (keep[*w]) {
+                    if (keptOut[u] == 0 || keptIn[*w] == 0) {
+                        bridges.push_back(std::make_pair(u, *w));
+                    }
+                } else if (visitedFrom[*w] != u) {
+                    visitedFrom[*w] = u;
+                    stack.push_back(*w);
+                }
+            }
+        }
+    }
+
+    // Renumber the kept vertices densely, in their old order
+    std::vector<VD> newIndex(n, null_vertex);
+    std::vector<PoaNode> nodes;
+    for (VD v = 0; v < n; v++) {
+        if (keep[v]) {
+            newIndex[v] = nodes.size();
+            nodes.push_back(nodes_[v]);
+            nodes.back().Id = newIndex[v];
+        }
+    }
+    const size_t numPruned = n - nodes.size();
+    if (numPruned == 0) return 0;
+
+    std::vector<std::pair<VD, VD> > edges;
+    edges.swap(edges_);
+    nodes_.swap(nodes);
+    out_.assign(nodes_.size(), std::vector<VD>());
+    for (size_t k = 0; k < edges.size(); k++) {
+        if (keep[edges[k].first] && keep[edges[k].second]) {
+            addEdge(newIndex[edges[k].first], newIndex[edges[k].second]);
+        }
+    }
+    for (size_t k = 0; k < bridges.size(); k++) {
+        addEdge(newIndex[bridges[k].first], newIndex[bridges[k].second]);
+    }
+    enterVertex_ = newIndex[enterVertex_];
+    exitVertex_ = newIndex[exitVertex_];
+    reindex();
+    consensusPathValid_ = false;
+
+    DEBUG_ONLY(repCheck());
+    return numPruned;
+}
+
 size_t PoaGraphImpl::NumReads() const { return numReads_; }
 
+size_t PoaGraphImpl::NumVertices() const { return numVertices(); }
+
+void PoaGraphImpl::SetNumThreads(int numThreads)
+{
+    if (numThreads <= 1) {
+        columnPool_.reset();
+    } else if (NumThreads() != numThreads) {
+        columnPool_.reset(new ThreadPool(numThreads));
+    }
+}
+
+int PoaGraphImpl::NumThreads() const { return columnPool_ ? columnPool_->NumThreads() : 1; }
+
+void PoaGraphImpl::SetMemoryBudget(size_t bytes) { memoryBudget_ = bytes; }
+
+size_t PoaGraphImpl::MemoryBudget() const { return memoryBudget_; }
+
 string PoaGraphImpl::ToGraphViz(int flags, const PoaConsensus* pc) const
 {
+    bool color = flags & PoaGraph::COLOR_NODES;
+    bool verbose = flags & PoaGraph::VERBOSE_NODES;
+    std::set<Vertex> cssVtxs;
+    if (pc != NULL) {
+        cssVtxs.insert(pc->Path.begin(), pc->Path.end());
+    }
+
     std::stringstream ss;
-    write_graphviz(ss, g_, my_label_writer(vertexInfoMap_, flags & PoaGraph::COLOR_NODES,
-                                           flags & PoaGraph::VERBOSE_NODES, pc));
+    ss << "digraph G {" << std::endl;
+    for (VD v = 0; v < numVertices(); v++) {
+        const PoaNode& node = nodes_[v];
+        std::string nodeColoringAttribute =
+            (color && cssVtxs.count(node.Id) ? " style=\"filled\", fillcolor=\"lightblue\" ," : "");
+        ss << v;
+        if (!verbose) {
+            ss << format("[shape=Mrecord,%s label=\"{ %c | %d }\"]") % nodeColoringAttribute %
+                      node.Base % node.Reads;
+        } else {
+            ss << format(
+                      "[shape=Mrecord,%s label=\"{ "
+                      "{ %d | %c } |"
+                      "{ %d | %d } |"
+                      "{ %0.2f | %0.2f } }\"]") %
+                      nodeColoringAttribute % node.Id % node.Base % node.Reads %
+                      node.SpanningReads % node.Score % node.ReachingScore;
+        }
+        ss << ";" << std::endl;
+    }
+    for (size_t k = 0; k < edges_.size(); k++) {
+        ss << edges_[k].first << "->" << edges_[k].second << " ;" << std::endl;
+    }
+    ss << "}" << std::endl;
     return ss.str();
 }
 
@@ -9,41 +9,40 @@
 #endif  // SWIG
 
 #include <ConsensusCore/Align/AlignConfig.hpp>
+#include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/Matrix/VectorL.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
 #include <ConsensusCore/Poa/PoaGraph.hpp>
+#include <ConsensusCore/Types.hpp>
 
-#include <boost/config.hpp>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
 #include <boost/format.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/static_assert.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/tuple/tuple.hpp>
-#include <boost/type_traits.hpp>
 #include <boost/utility.hpp>
+#include <cassert>
 #include <cfloat>
 #include <climits>
+#include <utility>
 #include <vector>
 
 using std::string;
 using std::vector;
 
-///
-///  Boost graph library typedefs, properties, and graphviz output.
-///
-using namespace boost;  // NOLINT
-
-namespace boost {
-enum vertex_info_t
-{
-    vertex_info = 424
-};  // a unique #
-BOOST_INSTALL_PROPERTY(vertex, info);
-}
-
 namespace ConsensusCore {
+class ThreadPool;
+
 namespace detail {
 
 class SdpRangeFinder;
 
+// Graphs of fewer vertices are aligned a column at a time, even with a
+// thread pool to hand
+#define PARALLEL_POA_MIN_VERTICES 256
+
 enum MoveType
 {
     InvalidMove,  // Invalid move reaching ^ (start)
@@ -84,120 +83,199 @@ struct PoaNode
     PoaNode(size_t id, char base, int reads) { Init(id, base, reads); }
 };
 
-// BGL is intimidating, and it *deserves* your hatred.  But it's
-// the only game in town!
-typedef property<vertex_info_t, PoaNode, property<vertex_index_t, size_t>> vertex_property_t;
-typedef adjacency_list<setS, listS, bidirectionalS, vertex_property_t> BoostGraph;
-
-// Descriptor types used internally
-typedef graph_traits<BoostGraph>::edge_descriptor ED;
-typedef graph_traits<BoostGraph>::vertex_descriptor VD;
-
-// External-facing vertex id type
+// Vertices are numbered densely in order of creation, so the internal
+// descriptor and the external-facing id coincide.  (The two types are
+// kept apart to mark which side of the API a vertex number is on.)
+typedef size_t VD;
 typedef size_t Vertex;
-
-typedef property_map<BoostGraph, vertex_info_t>::type VertexInfoMap;
-typedef property_map<BoostGraph, vertex_index_t>::type index_map_t;
-static const VD null_vertex = graph_traits<BoostGraph>::null_vertex();
-
-struct EdgeComparator
+static const VD null_vertex = static_cast<VD>(-1);
+
+// The traceback of a cell fits in 16 bits: the reaching move in the low
+// four, and above them the slot in AlignmentColumn::Origins of the
+// vertex the move came from.
+#define TRACEBACK_MOVE_BITS 4
+#define TRACEBACK_MOVE_MASK ((1 << TRACEBACK_MOVE_BITS) - 1)
+#define TRACEBACK_MAX_ORIGINS (1 << (16 - TRACEBACK_MOVE_BITS))
+
+// A column of the alignment of a read against the graph.  Columns don't
+// own their storage; it is carved out of the PoaAlignmentMatrixImpl
+// they belong to.
+struct AlignmentColumn
 {
-    EdgeComparator(const BoostGraph& g) : g_(g) {}
+    VD CurrentVertex;
+    VectorViewL<float> Score;
+
+    // The vertices a move into this column may come from: the
+    // predecessors, in index order, then ^ if Start moves are allowed.
+    // (Extra moves come from CurrentVertex and need no slot.)
+    VD* Origins;
+    int NumOrigins;
+    VectorViewL<uint16_t> Traceback;
 
-    // want lex. comparison... just using pair to get it..
-    bool operator()(ED e1, ED e2)
+    AlignmentColumn()
+        : CurrentVertex(null_vertex), Score(), Origins(NULL), NumOrigins(0), Traceback()
     {
-        std::pair<int, int> vt1, vt2;
-        vt1 = std::make_pair(get(vertex_index, g_, source(e1, g_)),
-                             get(vertex_index, g_, target(e1, g_)));
-        vt2 = std::make_pair(get(vertex_index, g_, source(e2, g_)),
-                             get(vertex_index, g_, target(e2, g_)));
-        return (vt1 < vt2);
     }
 
-private:
-    const BoostGraph& g_;
-};
-
-inline std::vector<ED> inEdges(VD v, const BoostGraph& g)
-{
-    // This is a sad workaround the nondeterministic order of iteration
-    // from BGL's in_edges. (see: http://stackoverflow.com/questions/30968690/)
-
-    // Unfortunately, we can't just use the boost::sort range adapter
-    // because it requires an underlying random access iterator, which
-    // we can't get from the std::set container.
-    graph_traits<BoostGraph>::in_edge_iterator begin, end;
-    tie(begin, end) = in_edges(v, g);
-    std::vector<ED> tmp(begin, end);
-    std::sort(tmp.begin(), tmp.end(), EdgeComparator(g));
-    return tmp;
-}
+    int BeginRow() const { return Score.BeginRow(); }
+    int EndRow() const { return Score.EndRow(); }
 
-struct AlignmentColumn : noncopyable
-{
-    VD CurrentVertex;
-    VectorL<float> Score;
-    VectorL<MoveType> ReachingMove;
-    VectorL<VD> PreviousVertex;
-
-    AlignmentColumn(VD vertex, int len)
-        : CurrentVertex(vertex)
-        , Score(0, len, -FLT_MAX)
-        , ReachingMove(0, len, InvalidMove)
-        , PreviousVertex(0, len, null_vertex)
+    // The score at row, or -FLT_MAX if row is outside the band
+    float ScoreAt(int row) const
     {
+        return (BeginRow() <= row && row < EndRow()) ? Score[row] : -FLT_MAX;
     }
 
-    AlignmentColumn(VD vertex, int beginRow, int endRow)
-        : CurrentVertex(vertex)
-        , Score(beginRow, endRow, -FLT_MAX)
-        , ReachingMove(beginRow, endRow, InvalidMove)
-        , PreviousVertex(beginRow, endRow, null_vertex)
+    void AddOrigin(VD u) { Origins[NumOrigins++] = u; }
+
+    MoveType ReachingMove(int row) const
     {
+        return static_cast<MoveType>(Traceback[row] & TRACEBACK_MOVE_MASK);
     }
 
-    ~AlignmentColumn() {}
+    VD PreviousVertex(int row) const
+    {
+        MoveType move = ReachingMove(row);
+        if (move == InvalidMove) return null_vertex;
+        if (move == ExtraMove) return CurrentVertex;
+        assert((Traceback[row] >> TRACEBACK_MOVE_BITS) < NumOrigins);
+        return Origins[Traceback[row] >> TRACEBACK_MOVE_BITS];
+    }
 
-    int BeginRow() const { return Score.BeginRow(); }
-    int EndRow() const { return Score.EndRow(); }
+    void SetTraceback(int row, MoveType move, int slot)
+    {
+        assert(0 <= slot && slot < TRACEBACK_MAX_ORIGINS);
+        Traceback[row] = static_cast<uint16_t>((slot << TRACEBACK_MOVE_BITS) | move);
+    }
 };
 
-typedef unordered_map<VD, const AlignmentColumn*> AlignmentColumnMap;
+// Alignment columns, indexed by vertex
+typedef std::vector<const AlignmentColumn*> AlignmentColumnMap;
 
 class PoaAlignmentMatrixImpl : public PoaAlignmentMatrix
 {
 public:
+    PoaAlignmentMatrixImpl();
     virtual ~PoaAlignmentMatrixImpl();
     virtual float Score() const;
 
+    // Size the storage for the columns of a graph with the given number
+    // of vertices and edges, invalidating the columns held.  Storage is
+    // kept from one use to the next, so refilling a matrix no bigger
+    // than before allocates nothing.
+    void Reset(size_t numVertices, size_t numEdges, int numRows);
+
+    // Size the storage for a checkpointed alignment, which holds at
+    // most numSlots columns at once, each in a slot of numRows cells
+    // that FreeColumn gives back.  Columns are then made one at a time.
+    void ResetCheckpointed(size_t numVertices, size_t numEdges, int numRows, size_t numSlots);
+
+    // Make the column for vertex v, covering rows [beginRow, endRow),
+    // with room for maxOrigins origins.  Scores start at -FLT_MAX and
+    // moves at InvalidMove.  Threads may make columns concurrently,
+    // unless the matrix is checkpointed.
+    AlignmentColumn* NewColumn(VD v, int beginRow, int endRow, int maxOrigins);
+
+    // Drop the column of v from a checkpointed matrix
+    void FreeColumn(VD v);
+
+    bool Checkpointed() const { return checkpointed_; }
+
+    // The bytes a cell of a column takes
+    static const size_t CELL_BYTES = sizeof(float) + sizeof(uint16_t);
+
 public:
     AlignmentColumnMap columns_;
     std::string readSequence_;
     AlignMode mode_;
     float score_;
+
+    // Of a checkpointed matrix: the vertices in the order their columns
+    // are made, cut into segments at segmentStarts_ (ending with the
+    // number of vertices); each vertex's segment and rows; whether its
+    // column is kept throughout, as a successor in a later segment
+    // needs it; the segment whose columns are held besides those kept;
+    // and the config to remake columns under
+    std::vector<VD> order_;
+    std::vector<size_t> segmentStarts_;
+    std::vector<int> segmentOf_;
+    std::vector<Interval> rowRanges_;
+    std::vector<bool> kept_;
+    int heldSegment_;
+    AlignConfig config_;
+    // The best End move to $ yet, under local or semiglobal alignment
+    float exitScore_;
+    VD exitFrom_;
+
+private:
+    // bump-allocated storage for the columns
+    std::vector<AlignmentColumn> columnStore_;
+    std::vector<float> scoreStore_;
+    std::vector<uint16_t> tracebackStore_;
+    std::vector<VD> originStore_;
+    std::atomic<size_t> columnsUsed_;
+    std::atomic<size_t> cellsUsed_;
+    std::atomic<size_t> originsUsed_;
+    // Of a checkpointed matrix, whose columns are indexed by vertex
+    bool checkpointed_;
+    int numRows_;
+    std::vector<size_t> freeSlots_;
+    std::vector<size_t> slotOf_;
+    // Counts the storage as POA_MEMORY
+    AccountedBytes accounted_;
 };
 
 class PoaGraphImpl
 {
     friend class SdpRangeFinder;
 
-    BoostGraph g_;
-    VertexInfoMap vertexInfoMap_;  // NB: this is a reference type and refers to an
-                                   // "internal" property map
-    index_map_t indexMap_;
+    // The graph is stored flat: node records in a vector indexed by
+    // vertex, and the edges both in insertion order (for output) and as
+    // per-vertex successor lists.  Compressed (CSR) successor and
+    // predecessor arrays and a topological order are rebuilt by
+    // reindex() whenever a read has been threaded, so that the
+    // alignment of the next read walks contiguous memory.
+    // (the scores in the nodes are scratch space for consensusPath)
+    mutable std::vector<PoaNode> nodes_;
+    std::vector<std::vector<VD> > out_;
+    std::vector<std::pair<VD, VD> > edges_;
+
+    std::vector<size_t> predOffsets_;
+    std::vector<VD> preds_;
+    std::vector<size_t> succOffsets_;
+    std::vector<VD> succs_;
+    std::vector<VD> topoOrder_;
+
     VD enterVertex_;
     VD exitVertex_;
     size_t numReads_;
-    size_t totalVertices_;               // includes "ex"-vertices which have since been removed
-    size_t liveVertices_;                // vertices that are in the graph.  this is needed for
-                                         // algorithms.
-    std::map<Vertex, VD> vertexLookup_;  // external ID -> internal ID
+
+    // The last path found by consensusPath and what it was asked for,
+    // good until a read is added; and its scratch space
+    mutable std::vector<VD> consensusPath_;
+    mutable bool consensusPathValid_;
+    mutable AlignMode consensusPathMode_;
+    mutable int consensusPathMinCoverage_;
+    mutable std::vector<VD> bestPrevVertex_;
+
+    // Aligns the columns of large graphs in parallel, if set; shared
+    // by copies of the graph
+    boost::shared_ptr<ThreadPool> columnPool_;
+
+    // The bytes an alignment matrix may take before it is checkpointed;
+    // 0 for no limit
+    size_t memoryBudget_;
 
     void repCheck() const;
 
-    Vertex externalize(VD vd) const { return vertexInfoMap_[vd].Id; }
-    VD internalize(Vertex vertex) const { return vertexLookup_.at(vertex); }
+    Vertex externalize(VD vd) const { return nodes_[vd].Id; }
+    VD internalize(Vertex vertex) const
+    {
+        if (vertex >= nodes_.size()) {
+            throw InvalidInputError("Invalid POA graph vertex");
+        }
+        return vertex;
+    }
 
     std::vector<Vertex> externalizePath(const std::vector<VD>& vds) const
     {
@@ -219,26 +297,84 @@ class PoaGraphImpl
 
     VD addVertex(char base, int nReads = 1)
     {
-        VD vd = add_vertex(g_);
-        Vertex vExt = totalVertices_++;
-        vertexInfoMap_[vd] = PoaNode(vExt, base, nReads);
-        vertexLookup_[vExt] = vd;
-        indexMap_[vd] = liveVertices_++;
+        VD vd = nodes_.size();
+        nodes_.push_back(PoaNode(vd, base, nReads));
+        out_.push_back(std::vector<VD>());
         return vd;
     }
 
+    void addEdge(VD u, VD v)
+    {
+        // there are no parallel edges
+        std::vector<VD>& succ = out_[u];
+        if (std::find(succ.begin(), succ.end(), v) == succ.end()) {
+            succ.push_back(v);
+            edges_.push_back(std::make_pair(u, v));
+        }
+    }
+
+    // Rebuild the compressed adjacency arrays and the topological order
+    void reindex();
+
+    size_t numVertices() const { return nodes_.size(); }
+
+    std::pair<const VD*, const VD*> predecessors(VD v) const
+    {
+        const VD* base = preds_.empty() ? NULL : &preds_[0];
+        return std::make_pair(base + predOffsets_[v], base + predOffsets_[v + 1]);
+    }
+
+    std::pair<const VD*, const VD*> successors(VD v) const
+    {
+        const VD* base = succs_.empty() ? NULL : &succs_[0];
+        return std::make_pair(base + succOffsets_[v], base + succOffsets_[v + 1]);
+    }
+
+    size_t inDegree(VD v) const { return predOffsets_[v + 1] - predOffsets_[v]; }
+    size_t outDegree(VD v) const { return succOffsets_[v + 1] - succOffsets_[v]; }
+
     //
     // utility routines
     //
-    const AlignmentColumn* makeAlignmentColumn(VD v,
-                                               const AlignmentColumnMap& alignmentColumnForVertex,
+
+    // The column for v, filled over rows [beginRow, endRow) only
+    const AlignmentColumn* makeAlignmentColumn(VD v, PoaAlignmentMatrixImpl* mat,
                                                const std::string& sequence,
                                                const AlignConfig& config, int beginRow,
                                                int endRow) const;
 
-    const AlignmentColumn* makeAlignmentColumnForExit(
-        VD v, const AlignmentColumnMap& alignmentColumnForVertex, const std::string& sequence,
-        const AlignConfig& config) const;
+    const AlignmentColumn* makeAlignmentColumnForExit(VD v, PoaAlignmentMatrixImpl* mat,
+                                                      const std::string& sequence,
+                                                      const AlignConfig& config) const;
+
+    // Align a read against the graph, filling in mat; across
+    // columnPool_, if parallel and the graph is large enough
+    void fillAlignmentMatrix(const std::string& sequence, const AlignConfig& config,
+                             SdpRangeFinder* rangeFinder, PoaAlignmentMatrixImpl* mat,
+                             bool parallel = true) const;
+
+    // Make the columns of every vertex but $ across columnPool_, each
+    // as soon as those of its predecessors are made
+    void fillColumnsInParallel(const std::string& sequence, const AlignConfig& config,
+                               SdpRangeFinder* rangeFinder, PoaAlignmentMatrixImpl* mat) const;
+
+    // Fill mat keeping only the columns of one segment of the
+    // topological order, and those that later segments need, at once;
+    // the others are remade as the traceback reaches their segment
+    void fillCheckpointed(const std::string& sequence, const AlignConfig& config,
+                          const std::vector<Interval>& rowRanges,
+                          PoaAlignmentMatrixImpl* mat) const;
+
+    // Make the columns of segment s of a checkpointed matrix that it
+    // lacks, dropping those of the segment held before
+    void makeSegment(int s, PoaAlignmentMatrixImpl* mat) const;
+
+    // The column of v, remade if mat is checkpointed and dropped it
+    const AlignmentColumn* columnOf(VD v, PoaAlignmentMatrixImpl* mat) const
+    {
+        if (mat->columns_[v] == NULL) makeSegment(mat->segmentOf_[v], mat);
+        return mat->columns_[v];
+    }
 
 public:
     //
@@ -246,12 +382,11 @@ public:
     //
     void tagSpan(VD start, VD end);
 
-    std::vector<VD> consensusPath(AlignMode mode, int minCoverage = -INT_MAX) const;
+    const std::vector<VD>& consensusPath(AlignMode mode, int minCoverage = -INT_MAX) const;
 
     void threadFirstRead(std::string sequence, std::vector<Vertex>* readPathOutput = NULL);
 
-    void tracebackAndThread(std::string sequence,
-                            const AlignmentColumnMap& alignmentColumnForVertex, AlignMode mode,
+    void tracebackAndThread(std::string sequence, PoaAlignmentMatrixImpl* mat, AlignMode mode,
                             std::vector<Vertex>* readPathOutput = NULL);
 
     vector<ScoredMutation>* findPossibleVariants(const std::vector<Vertex>& bestPath) const;
@@ -269,17 +404,46 @@ public:
     PoaAlignmentMatrixImpl* TryAddRead(const std::string& sequence, const AlignConfig& config,
                                        SdpRangeFinder* rangeFinder = NULL) const;
 
+    std::vector<PoaAlignmentMatrixImpl*> TryAddReads(const std::vector<std::string>& sequences,
+                                                     const AlignConfig& config,
+                                                     int numThreads) const;
+
     void CommitAdd(PoaAlignmentMatrix* mat, std::vector<Vertex>* readPathOutput = NULL);
 
+    // Add the consensus, along path, of other, weighted by its reads
+    void MergeConsensus(const PoaGraphImpl& other, const std::vector<Vertex>& path,
+                        const std::string& sequence, const AlignConfig& config,
+                        SdpRangeFinder* rangeFinder = NULL,
+                        std::vector<Vertex>* readPathOutput = NULL);
+
+    // The consensus path, as external vertices, and the sequence along it
+    std::vector<Vertex> FindConsensusPath(const AlignConfig& config, int minCoverage,
+                                          std::string* sequence);
+
     PoaConsensus* FindConsensus(const AlignConfig& config, int minCoverage = -INT_MAX);
 
+    // Remove the vertices fewer than minReads reads pass through, but
+    // for those on the consensus path, and renumber the rest densely.
+    // Returns the number removed.
+    size_t Prune(int minReads, AlignMode mode);
+
     size_t NumReads() const;
+    size_t NumVertices() const;
+
+    void SetNumThreads(int numThreads);
+    int NumThreads() const;
+    void SetMemoryBudget(size_t bytes);
+    size_t MemoryBudget() const;
     string ToGraphViz(int flags, const PoaConsensus* pc) const;
     void WriteGraphVizFile(string filename, int flags, const PoaConsensus* pc) const;
+
+    // Binary form; see PoaGraphSerialization.cpp.  LoadBinary replaces
+    // the graph, and leaves it untouched if data is rejected.
+    std::string ToBinary() const;
+    void LoadBinary(const char* data, size_t size);
 };
 
 // free functions, we should put these all in traversals
-std::string sequenceAlongPath(const BoostGraph& g, const VertexInfoMap& vertexInfoMap,
-                              const std::vector<VD>& path);
+std::string sequenceAlongPath(const std::vector<PoaNode>& nodes, const std::vector<VD>& path);
 }
 }  // ConsensusCore::detail
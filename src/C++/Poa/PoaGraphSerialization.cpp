@@ -0,0 +1,220 @@
+// Binary form of a PoaGraph.
+//
+// All fields are fixed-width and stored in the byte order of the
+// machine that wrote them, which the header records; there are no
+// pointers or offsets, so the bytes can be mapped from a file and read
+// where they lie.
+//
+//   header                       PoaGraphFileHeader
+//   NumVertices vertex records   PoaGraphFileVertex, indexed by vertex
+//   NumEdges edge records        PoaGraphFileEdge, in insertion order
+//
+// The edges keep their insertion order because it is the order in
+// which the successors of a vertex are visited, which decides ties in
+// the traceback.
+
+#include <ConsensusCore/Poa/PoaGraph.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PoaGraphImpl.hpp"
+
+namespace ConsensusCore {
+namespace detail {
+
+namespace {
+
+const char POA_GRAPH_MAGIC[8] = {'C', 'C', 'P', 'O', 'A', 'G', 'R', '\0'};
+const uint32_t POA_GRAPH_VERSION = 1;
+const uint32_t POA_GRAPH_BYTE_ORDER_MARK = 0x01020304;
+
+struct PoaGraphFileHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ByteOrderMark;
+    uint64_t NumVertices;
+    uint64_t NumEdges;
+    uint64_t NumReads;
+    uint64_t EnterVertex;
+    uint64_t ExitVertex;
+};
+
+struct PoaGraphFileVertex
+{
+    int32_t Reads;
+    int32_t SpanningReads;
+    char Base;
+    char Padding[3];
+};
+
+struct PoaGraphFileEdge
+{
+    uint32_t Source;
+    uint32_t Target;
+};
+
+static_assert(sizeof(PoaGraphFileHeader) == 56, "PoaGraphFileHeader is not packed");
+static_assert(sizeof(PoaGraphFileVertex) == 12, "PoaGraphFileVertex is not packed");
+static_assert(sizeof(PoaGraphFileEdge) == 8, "PoaGraphFileEdge is not packed");
+
+template <typename T>
+void Append(std::string* out, const T& record)
+{
+    out->append(reinterpret_cast<const char*>(&record), sizeof(T));
+}
+
+// The record at data + offset, which need not be aligned
+template <typename T>
+T RecordAt(const char* data, size_t offset)
+{
+    T record;
+    std::memcpy(&record, data + offset, sizeof(T));
+    return record;
+}
+
+void CheckLoad(bool condition, const char* what)
+{
+    if (!condition) {
+        throw InvalidInputError(std::string("Malformed binary POA graph: ") + what);
+    }
+}
+}
+
+std::string PoaGraphImpl::ToBinary() const
+{
+    if (numVertices() > UINT32_MAX) {
+        throw UnsupportedFeatureError("POA graph too large for its binary form");
+    }
+
+    PoaGraphFileHeader header;
+    std::memcpy(header.Magic, POA_GRAPH_MAGIC, sizeof(header.Magic));
+    header.Version = POA_GRAPH_VERSION;
+    header.ByteOrderMark = POA_GRAPH_BYTE_ORDER_MARK;
+    header.NumVertices = numVertices();
+    header.NumEdges = edges_.size();
+    header.NumReads = numReads_;
+    header.EnterVertex = enterVertex_;
+    header.ExitVertex = exitVertex_;
+
+    std::string out;
+    out.reserve(sizeof(PoaGraphFileHeader) + numVertices() * sizeof(PoaGraphFileVertex) +
+                edges_.size() * sizeof(PoaGraphFileEdge));
+    Append(&out, header);
+    for (VD v = 0; v < numVertices(); v++) {
+        PoaGraphFileVertex record;
+        std::memset(&record, 0, sizeof(record));
+        record.Reads = nodes_[v].Reads;
+        record.SpanningReads = nodes_[v].SpanningReads;
+        record.Base = nodes_[v].Base;
+        Append(&out, record);
+    }
+    for (size_t k = 0; k < edges_.size(); k++) {
+        PoaGraphFileEdge record;
+        record.Source = static_cast<uint32_t>(edges_[k].first);
+        record.Target = static_cast<uint32_t>(edges_[k].second);
+        Append(&out, record);
+    }
+    return out;
+}
+
+void PoaGraphImpl::LoadBinary(const char* data, size_t size)
+{
+    CheckLoad(data != NULL && size >= sizeof(PoaGraphFileHeader), "truncated header");
+    const PoaGraphFileHeader header = RecordAt<PoaGraphFileHeader>(data, 0);
+    CheckLoad(std::memcmp(header.Magic, POA_GRAPH_MAGIC, sizeof(header.Magic)) == 0,
+              "bad magic number");
+    if (header.ByteOrderMark != POA_GRAPH_BYTE_ORDER_MARK) {
+        throw UnsupportedFeatureError("Binary POA graph was written with another byte order");
+    }
+    if (header.Version != POA_GRAPH_VERSION) {
+        throw UnsupportedFeatureError("Unsupported binary POA graph version");
+    }
+
+    // Bound the counts by the size before multiplying, so that a
+    // corrupt count can't wrap the sum around
+    const size_t body = size - sizeof(PoaGraphFileHeader);
+    CheckLoad(header.NumVertices >= 2 && header.NumVertices <= UINT32_MAX &&
+                  header.NumVertices <= body / sizeof(PoaGraphFileVertex),
+              "bad vertex count");
+    const size_t n = header.NumVertices;
+    const size_t edgeBytes = body - n * sizeof(PoaGraphFileVertex);
+    CheckLoad(header.NumEdges <= edgeBytes / sizeof(PoaGraphFileEdge) &&
+                  edgeBytes == header.NumEdges * sizeof(PoaGraphFileEdge),
+              "size does not match the counts");
+    CheckLoad(header.EnterVertex < n && header.ExitVertex < n &&
+                  header.EnterVertex != header.ExitVertex,
+              "bad enter or exit vertex");
+
+    // Build the graph aside, so that a rejected load leaves this one be
+    PoaGraphImpl g;
+    g.nodes_.clear();
+    g.out_.clear();
+    g.edges_.clear();
+    g.nodes_.reserve(n);
+    g.out_.reserve(n);
+    size_t offset = sizeof(PoaGraphFileHeader);
+    for (size_t v = 0; v < n; v++, offset += sizeof(PoaGraphFileVertex)) {
+        const PoaGraphFileVertex record = RecordAt<PoaGraphFileVertex>(data, offset);
+        CheckLoad(record.Reads >= 0 && record.SpanningReads >= 0, "negative read count");
+        g.addVertex(record.Base, record.Reads);
+        g.nodes_[v].SpanningReads = record.SpanningReads;
+    }
+    g.edges_.reserve(header.NumEdges);
+    for (size_t k = 0; k < header.NumEdges; k++, offset += sizeof(PoaGraphFileEdge)) {
+        const PoaGraphFileEdge record = RecordAt<PoaGraphFileEdge>(data, offset);
+        CheckLoad(record.Source < n && record.Target < n && record.Source != record.Target,
+                  "bad edge");
+        CheckLoad(std::find(g.out_[record.Source].begin(), g.out_[record.Source].end(),
+                            record.Target) == g.out_[record.Source].end(),
+                  "repeated edge");
+        g.addEdge(record.Source, record.Target);
+    }
+    g.enterVertex_ = header.EnterVertex;
+    g.exitVertex_ = header.ExitVertex;
+    g.numReads_ = header.NumReads;
+    g.reindex();
+
+    // What repCheck asserts of a graph built from reads, and that the
+    // edges run forward in the topological order, which they can only
+    // all do if the graph is acyclic
+    std::vector<size_t> position(n);
+    for (size_t i = 0; i < n; i++) {
+        position[g.topoOrder_[i]] = i;
+    }
+    for (size_t k = 0; k < g.edges_.size(); k++) {
+        CheckLoad(position[g.edges_[k].first] < position[g.edges_[k].second], "cycle");
+    }
+    for (VD v = 0; v < n; v++) {
+        if (v == g.enterVertex_) {
+            CheckLoad(g.inDegree(v) == 0, "edge into ^");
+        } else if (v == g.exitVertex_) {
+            CheckLoad(g.outDegree(v) == 0, "edge out of $");
+        } else {
+            CheckLoad(g.inDegree(v) > 0 && g.outDegree(v) > 0, "dangling vertex");
+        }
+    }
+
+    std::swap(nodes_, g.nodes_);
+    std::swap(out_, g.out_);
+    std::swap(edges_, g.edges_);
+    std::swap(predOffsets_, g.predOffsets_);
+    std::swap(preds_, g.preds_);
+    std::swap(succOffsets_, g.succOffsets_);
+    std::swap(succs_, g.succs_);
+    std::swap(topoOrder_, g.topoOrder_);
+    enterVertex_ = g.enterVertex_;
+    exitVertex_ = g.exitVertex_;
+    numReads_ = g.numReads_;
+    consensusPathValid_ = false;
+    DEBUG_ONLY(repCheck());
+}
+}
+}  // ConsensusCore::detail
@@ -1,24 +1,25 @@
 // Author: David Alexander
 
+#include <algorithm>
 #include <limits>
+#include <sstream>
 
 #include <ConsensusCore/Matrix/VectorL.hpp>
 #include <ConsensusCore/Poa/PoaGraph.hpp>
 #include <ConsensusCore/Utils.hpp>
 
-#include <boost/graph/topological_sort.hpp>
+#include <boost/unordered_set.hpp>
 
 #include "PoaGraphImpl.hpp"
 
 namespace ConsensusCore {
 namespace detail {
 
-std::string sequenceAlongPath(const BoostGraph&, const VertexInfoMap& vertexInfoMap,
-                              const std::vector<VD>& path)
+std::string sequenceAlongPath(const std::vector<PoaNode>& nodes, const std::vector<VD>& path)
 {
     std::stringstream ss;
     foreach (VD v, path) {
-        ss << vertexInfoMap[v].Base;
+        ss << nodes[v].Base;
     }
     return ss.str();
 }
@@ -26,10 +27,8 @@ std::string sequenceAlongPath(const BoostGraph&, const VertexInfoMap& vertexInfo
 void PoaGraphImpl::tagSpan(VD start, VD end)
 {
     // cout << "Tagging span " << start << " to " << end << endl;
-    std::list<VD> sortedVertices(num_vertices(g_));
-    topological_sort(g_, sortedVertices.rbegin());
     bool spanning = false;
-    foreach (VD v, sortedVertices) {
+    foreach (VD v, topoOrder_) {
         if (v == start) {
             spanning = true;
         }
@@ -37,13 +36,24 @@ void PoaGraphImpl::tagSpan(VD start, VD end)
             break;
         }
         if (spanning) {
-            vertexInfoMap_[v].SpanningReads++;
+            nodes_[v].SpanningReads++;
         }
     }
 }
 
-std::vector<VD> PoaGraphImpl::consensusPath(AlignMode mode, int minCoverage) const
+const std::vector<VD>& PoaGraphImpl::consensusPath(AlignMode mode, int minCoverage) const
 {
+    // Adding a read changes the score of nearly every vertex---through
+    // totalReads in GLOBAL mode, and through the spanning counts
+    // otherwise---so there is no smaller part of the pass below to
+    // redo.  It is instead done at most once per read added: the path
+    // is kept until the graph next changes, and handed out again to
+    // every caller asking with the same mode and minCoverage.
+    if (consensusPathValid_ && consensusPathMode_ == mode &&
+        consensusPathMinCoverage_ == minCoverage) {
+        return consensusPath_;
+    }
+
     // Pat's note on the approach here:
     //
     // "A node gets a score of NumReads if all reads go through
@@ -60,21 +70,19 @@ std::vector<VD> PoaGraphImpl::consensusPath(AlignMode mode, int minCoverage) con
     // against inclusion in the consensus.
     int totalReads = NumReads();
 
-    std::list<VD> path;
-    std::list<VD> sortedVertices(num_vertices(g_));
-    topological_sort(g_, sortedVertices.rbegin());
-    unordered_map<VD, VD> bestPrevVertex;
+    std::vector<VD>& bestPrevVertex = bestPrevVertex_;
+    bestPrevVertex.assign(numVertices(), null_vertex);
 
     // ignore ^ and $
     // TODO(dalexander): find a cleaner way to do this
-    vertexInfoMap_[sortedVertices.front()].ReachingScore = 0;
-    sortedVertices.pop_back();
-    sortedVertices.pop_front();
+    assert(topoOrder_.front() == enterVertex_ && topoOrder_.back() == exitVertex_);
+    nodes_[topoOrder_.front()].ReachingScore = 0;
 
     VD bestVertex = null_vertex;
     float bestReachingScore = -FLT_MAX;
-    foreach (VD v, sortedVertices) {
-        PoaNode& vInfo = vertexInfoMap_[v];
+    for (size_t k = 1; k + 1 < topoOrder_.size(); k++) {
+        VD v = topoOrder_[k];
+        PoaNode& vInfo = nodes_[v];
         int containingReads = vInfo.Reads;
         int spanningReads = vInfo.SpanningReads;
         float score =
@@ -83,10 +91,10 @@ std::vector<VD> PoaGraphImpl::consensusPath(AlignMode mode, int minCoverage) con
                 : (2 * containingReads - 1 * totalReads - 0.0001f);
         vInfo.Score = score;
         vInfo.ReachingScore = score;
-        bestPrevVertex[v] = null_vertex;
-        foreach (ED e, inEdges(v, g_)) {
-            VD sourceVertex = source(e, g_);
-            float rsc = score + vertexInfoMap_[sourceVertex].ReachingScore;
+        std::pair<const VD*, const VD*> preds = predecessors(v);
+        for (const VD* u = preds.first; u != preds.second; ++u) {
+            VD sourceVertex = *u;
+            float rsc = score + nodes_[sourceVertex].ReachingScore;
             if (rsc > vInfo.ReachingScore) {
                 vInfo.ReachingScore = rsc;
                 bestPrevVertex[v] = sourceVertex;
@@ -100,12 +108,16 @@ std::vector<VD> PoaGraphImpl::consensusPath(AlignMode mode, int minCoverage) con
     assert(bestVertex != null_vertex);
 
     // trace back from best-scoring vertex
-    VD v = bestVertex;
-    while (v != null_vertex) {
-        path.push_front(v);
-        v = bestPrevVertex[v];
+    consensusPath_.clear();
+    for (VD v = bestVertex; v != null_vertex; v = bestPrevVertex[v]) {
+        consensusPath_.push_back(v);
     }
-    return std::vector<VD>(path.begin(), path.end());
+    std::reverse(consensusPath_.begin(), consensusPath_.end());
+
+    consensusPathValid_ = true;
+    consensusPathMode_ = mode;
+    consensusPathMinCoverage_ = minCoverage;
+    return consensusPath_;
 }
 
 void PoaGraphImpl::threadFirstRead(std::string sequence, std::vector<Vertex>* outputPath)
@@ -125,10 +137,10 @@ void PoaGraphImpl::threadFirstRead(std::string sequence, std::vector<Vertex>* ou
             outputPath->push_back(externalize(v));
         }
         if (readPos == 0) {
-            add_edge(enterVertex_, v, g_);
+            addEdge(enterVertex_, v);
             startSpanVertex = v;
         } else {
-            add_edge(u, v, g_);
+            addEdge(u, v);
         }
         u = v;
         readPos++;
@@ -136,14 +148,17 @@ void PoaGraphImpl::threadFirstRead(std::string sequence, std::vector<Vertex>* ou
     assert(startSpanVertex != null_vertex);
     assert(u != null_vertex);
     endSpanVertex = u;
-    add_edge(u, exitVertex_, g_);  // terminus -> $
+    addEdge(u, exitVertex_);  // terminus -> $
+    reindex();
     tagSpan(startSpanVertex, endSpanVertex);
 }
 
-void PoaGraphImpl::tracebackAndThread(std::string sequence,
-                                      const AlignmentColumnMap& alignmentColumnForVertex,
+void PoaGraphImpl::tracebackAndThread(std::string sequence, PoaAlignmentMatrixImpl* mat,
                                       AlignMode alignMode, std::vector<Vertex>* outputPath)
 {
+    // Threading adds vertices and edges, but the graph is reindexed
+    // only once the traceback is done, so the columns of a checkpointed
+    // matrix are remade against the graph it was filled against.
     const int I = sequence.length();
 
     // perform traceback from (I,$), threading the new sequence into the graph as
@@ -153,7 +168,7 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
     VD v = null_vertex, forkVertex = null_vertex;
     VD u = exitVertex_;
     VD startSpanVertex;
-    VD endSpanVertex = alignmentColumnForVertex.at(exitVertex_)->PreviousVertex[I];
+    VD endSpanVertex = columnOf(exitVertex_, mat)->PreviousVertex(I);
 
     if (outputPath) {
         outputPath->resize(I);
@@ -171,11 +186,11 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
         // u: current vertex
         // v: vertex last visited in traceback (could be == u)
         // forkVertex: the vertex that will be the target of a new edge
-        curCol = alignmentColumnForVertex.at(u);
+        curCol = columnOf(u, mat);
         assert(curCol != NULL);
-        PoaNode& curNodeInfo = vertexInfoMap_[u];
-        VD prevVertex = curCol->PreviousVertex[i];
-        MoveType reachingMove = curCol->ReachingMove[i];
+        PoaNode& curNodeInfo = nodes_[u];
+        VD prevVertex = curCol->PreviousVertex(i);
+        MoveType reachingMove = curCol->ReachingMove(i);
 
         if (reachingMove == StartMove) {
             assert(v != null_vertex);
@@ -187,7 +202,7 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
             while (i > 0) {
                 assert(alignMode == LOCAL);
                 VD newForkVertex = addVertex(sequence[READPOS]);
-                add_edge(newForkVertex, forkVertex, g_);
+                addEdge(newForkVertex, forkVertex);
                 VERTEX_ON_PATH(READPOS, newForkVertex);
                 forkVertex = newForkVertex;
                 i--;
@@ -201,12 +216,12 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
                 // Find the row # we are coming from, walk
                 // back to there, threading read bases onto
                 // graph via forkVertex, adjusting i.
-                const AlignmentColumn* prevCol = alignmentColumnForVertex.at(prevVertex);
+                const AlignmentColumn* prevCol = columnOf(prevVertex, mat);
                 int prevRow = ArgMax(prevCol->Score);
 
                 while (i > prevRow) {
                     VD newForkVertex = addVertex(sequence[READPOS]);
-                    add_edge(newForkVertex, forkVertex, g_);
+                    addEdge(newForkVertex, forkVertex);
                     VERTEX_ON_PATH(READPOS, newForkVertex);
                     forkVertex = newForkVertex;
                     i--;
@@ -216,7 +231,7 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
             VERTEX_ON_PATH(READPOS, u);
             // if there is an extant forkVertex, join it
             if (forkVertex != null_vertex) {
-                add_edge(u, forkVertex, g_);
+                addEdge(u, forkVertex);
                 forkVertex = null_vertex;
             }
             // add to existing node
@@ -232,7 +247,7 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
             if (forkVertex == null_vertex) {
                 forkVertex = v;
             }
-            add_edge(newForkVertex, forkVertex, g_);
+            addEdge(newForkVertex, forkVertex);
             VERTEX_ON_PATH(READPOS, newForkVertex);
             forkVertex = newForkVertex;
             i--;
@@ -244,14 +259,16 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
         u = prevVertex;
     }
     startSpanVertex = v;
+    reindex();
     if (startSpanVertex != exitVertex_) {
         tagSpan(startSpanVertex, endSpanVertex);
     }
 
     // if there is an extant forkVertex, join it to enterVertex
     if (forkVertex != null_vertex) {
-        add_edge(enterVertex_, forkVertex, g_);
+        addEdge(enterVertex_, forkVertex);
         forkVertex = null_vertex;
+        reindex();
     }
 
     // all filled in?
@@ -263,22 +280,9 @@ void PoaGraphImpl::tracebackAndThread(std::string sequence,
 #undef VERTEX_ON_PATH
 }
 
-static boost::unordered_set<VD> childVertices(VD v, const BoostGraph& g)
-{
-    boost::unordered_set<VD> result;
-    foreach (ED e, out_edges(v, g)) {
-        result.insert(target(e, g));
-    }
-    return result;
-}
-
-static boost::unordered_set<VD> parentVertices(VD v, const BoostGraph& g)
+static boost::unordered_set<VD> vertexSet(std::pair<const VD*, const VD*> range)
 {
-    boost::unordered_set<VD> result;
-    foreach (ED e, in_edges(v, g)) {
-        result.insert(source(e, g));
-    }
-    return result;
+    return boost::unordered_set<VD>(range.first, range.second);
 }
 
 vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
@@ -292,13 +296,13 @@ vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
     for (int i = 2; i < static_cast<int>(bestPath_.size()) - 2; i++)  // NOLINT
     {
         VD v = bestPath_[i];
-        boost::unordered_set<VD> children = childVertices(v, g_);
+        boost::unordered_set<VD> children = vertexSet(successors(v));
 
         // Look for a direct edge from the current node to the node
         // two spaces down---suggesting a deletion with respect to
         // the consensus sequence.
         if (children.find(bestPath_[i + 2]) != children.end()) {
-            float score = -vertexInfoMap_[bestPath_[i + 1]].Score;
+            float score = -nodes_[bestPath_[i + 1]].Score;
             variants->push_back(Mutation(DELETION, i + 1, '-').WithScore(score));
         }
 
@@ -306,7 +310,7 @@ vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
         // This indicates we should try inserting the base at i + 1.
 
         // Parents of (i + 1)
-        boost::unordered_set<VD> lookBack = parentVertices(bestPath_[i + 1], g_);
+        boost::unordered_set<VD> lookBack = vertexSet(predecessors(bestPath_[i + 1]));
 
         // (We could do this in STL using std::set sorted on score, which would then
         // provide an intersection mechanism (in <algorithm>) but that actually ends
@@ -317,7 +321,7 @@ vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
         foreach (VD vi, children) {
             boost::unordered_set<VD>::iterator found = lookBack.find(vi);
             if (found != lookBack.end()) {
-                float score = vertexInfoMap_[*found].Score;
+                float score = nodes_[*found].Score;
                 if (score > bestInsertScore) {
                     bestInsertScore = score;
                     bestInsertVertex = *found;
@@ -326,7 +330,7 @@ vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
         }
 
         if (bestInsertVertex != null_vertex) {
-            char base = vertexInfoMap_[bestInsertVertex].Base;
+            char base = nodes_[bestInsertVertex].Base;
             variants->push_back(Mutation(INSERTION, i + 1, base).WithScore(bestInsertScore));
         }
 
@@ -334,7 +338,7 @@ vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
         // to i + 2.  This indicates we should try mismatching the base i + 1.
 
         // Parents of (i + 2)
-        lookBack = parentVertices(bestPath_[i + 2], g_);
+        lookBack = vertexSet(predecessors(bestPath_[i + 2]));
 
         float bestMismatchScore = -FLT_MAX;
         VD bestMismatchVertex = null_vertex;
@@ -344,7 +348,7 @@ vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
 
             boost::unordered_set<VD>::iterator found = lookBack.find(vi);
             if (found != lookBack.end()) {
-                float score = vertexInfoMap_[*found].Score;
+                float score = nodes_[*found].Score;
                 if (score > bestMismatchScore) {
                     bestMismatchScore = score;
                     bestMismatchVertex = *found;
@@ -356,7 +360,7 @@ vector<ScoredMutation>* PoaGraphImpl::findPossibleVariants(
             // TODO(dalexander): As implemented (compatibility), this returns
             // the score of the mismatch node. I think it should return the score
             // difference, no?
-            char base = vertexInfoMap_[bestMismatchVertex].Base;
+            char base = nodes_[bestMismatchVertex].Base;
             variants->push_back(Mutation(SUBSTITUTION, i + 1, base).WithScore(bestMismatchScore));
         }
     }
@@ -2,10 +2,14 @@
 #include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/Poa/RangeFinder.hpp>
 
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include <stdint.h>
 #include <algorithm>
-#include <boost/graph/topological_sort.hpp>
-#include <boost/optional.hpp>
-#include <map>
+#include <cassert>
+#include <climits>
+#include <cstdlib>
 #include <string>
 #include <utility>
 #include <vector>
@@ -27,24 +31,9 @@ namespace detail {
 using std::min;
 using std::max;
 using std::make_pair;
-using boost::optional;
-
-static inline bool compareAnchorsOnCssPos(const SdpAnchor& a1, const SdpAnchor& a2)
-{
-    return a1.first < a2.first;
-}
 
-static const SdpAnchor* binarySearchAnchors(const SdpAnchorVector& anchors, size_t cssPosition)
-{
-    typedef SdpAnchorVector::const_iterator iter_t;
-    iter_t found = std::lower_bound(anchors.begin(), anchors.end(), make_pair(cssPosition, -1),
-                                    compareAnchorsOnCssPos);
-    if (found != anchors.end() && (*found).first == cssPosition) {
-        return &(*found);
-    } else {
-        return NULL;
-    }
-}
+// The union of no ranges, as RangeUnion has it
+static const Interval EMPTY_RANGE(INT_MAX / 2, -INT_MAX / 2);
 
 static inline Interval next(const Interval& v, int upperBound)
 {
@@ -71,88 +60,226 @@ void SdpRangeFinder::InitRangeFinder(const PoaGraphImpl& poaGraph,
 #if DEBUG_RANGE_FINDER
     poaGraph.WriteGraphVizFile("debug-graph.dot", PoaGraph::VERBOSE_NODES, NULL);
 #endif
-    // Clear prexisting state first!
-    alignableReadIntervalByVertex_.clear();
-
     const int readLength = readSequence.size();
+    const size_t numVertices = poaGraph.numVertices();
+    const std::vector<VD>& sortedVertices = poaGraph.topoOrder_;
 
-    SdpAnchorVector anchors = FindAnchors(consensusSequence, readSequence);
+    // The tables are indexed by vertex and kept from read to read, so
+    // once they have grown to the largest graph seen, refilling them
+    // allocates nothing.
+    alignableReadIntervalByVertex_.resize(numVertices);
 
-    std::map<VD, optional<Interval>> directRanges;
-    std::map<VD, Interval> fwdMarks, revMarks;
+    SdpAnchorVector anchors = FindAnchors(consensusSequence, readSequence);
 
-    std::vector<VD> sortedVertices(num_vertices(poaGraph.g_));
-    topological_sort(poaGraph.g_, sortedVertices.rbegin());
-    foreach (VD v, sortedVertices) {
-        directRanges[v] = boost::none;
+    // With nothing to anchor on, the whole read is alignable everywhere
+    if (anchors.empty()) {
+        std::fill(alignableReadIntervalByVertex_.begin(), alignableReadIntervalByVertex_.end(),
+                  Interval(0, readLength));
+        return;
     }
 
+    directRanges_.resize(numVertices);
+    hasDirectRange_.assign(numVertices, false);
+    revMarks_.resize(numVertices);
+
     // Find the "direct ranges" implied by the anchors between the
-    // css and this read.  Possibly null.
+    // css and this read.  The anchors are sorted by css position, so
+    // one pass down the css path, in step with them, finds them all.
+    SdpAnchorVector::const_iterator anchor = anchors.begin();
     for (size_t cssPos = 0; cssPos < consensusPath.size(); cssPos++) {
-        Vertex vExt = consensusPath[cssPos];
-        VD v = poaGraph.internalize(vExt);
-        const SdpAnchor* anchor = binarySearchAnchors(anchors, cssPos);
-        if (anchor != NULL) {
+        while (anchor != anchors.end() && anchor->first < cssPos) {
+            ++anchor;
+        }
+        if (anchor != anchors.end() && anchor->first == cssPos) {
+            Vertex vExt = consensusPath[cssPos];
+            VD v = poaGraph.internalize(vExt);
 #if DEBUG_RANGE_FINDER
             cout << "Anchor: " << anchor->first << "-" << anchor->second << " (Vertex " << vExt
                  << ")" << endl;
 #endif
-            directRanges[v] = Interval(max(int(anchor->second) - WIDTH, 0),
-                                       min(int(anchor->second) + WIDTH, readLength));
-        } else {
-            directRanges[v] = boost::none;
+            directRanges_[v] = Interval(max(int(anchor->second) - WIDTH, 0),
+                                        min(int(anchor->second) + WIDTH, readLength));
+            hasDirectRange_[v] = true;
         }
     }
 
     // Use the direct ranges as a seed and perform a forward recursion,
     // letting a node with null direct range have a range that is the
-    // union of the "forward stepped" ranges of its predecessors
+    // union of the "forward stepped" ranges of its predecessors.  The
+    // forward marks go straight into the result table.
+    std::vector<Interval>& fwdMarks = alignableReadIntervalByVertex_;
     foreach (VD v, sortedVertices) {
-        optional<Interval> directRange = directRanges.at(v);
-        if (directRange) {
-            fwdMarks[v] = directRange.get();
+        if (hasDirectRange_[v]) {
+            fwdMarks[v] = directRanges_[v];
         } else {
-            std::vector<Interval> predRangesStepped;
-            foreach (ED e, inEdges(v, poaGraph.g_)) {
-                VD pred = source(e, poaGraph.g_);
-                Interval predRangeStepped = next(fwdMarks.at(pred), readLength);
-                predRangesStepped.push_back(predRangeStepped);
+            Interval range = EMPTY_RANGE;
+            std::pair<const VD*, const VD*> preds = poaGraph.predecessors(v);
+            for (const VD* pred = preds.first; pred != preds.second; ++pred) {
+                range = RangeUnion(range, next(fwdMarks[*pred], readLength));
             }
-            fwdMarks[v] = RangeUnion(predRangesStepped);
+            fwdMarks[v] = range;
         }
     }
 
     // Do the same thing, but as a backwards recursion
     foreach (VD v, make_pair(sortedVertices.rbegin(), sortedVertices.rend())) {
-        optional<Interval> directRange = directRanges.at(v);
-        if (directRange) {
-            revMarks[v] = directRange.get();
+        if (hasDirectRange_[v]) {
+            revMarks_[v] = directRanges_[v];
         } else {
-            std::vector<Interval> succRangesStepped;
-            foreach (ED e, out_edges(v, poaGraph.g_)) {
-                VD succ = target(e, poaGraph.g_);
-                Interval succRangeStepped = prev(revMarks.at(succ), 0);
-                succRangesStepped.push_back(succRangeStepped);
+            Interval range = EMPTY_RANGE;
+            std::pair<const VD*, const VD*> succs = poaGraph.successors(v);
+            for (const VD* succ = succs.first; succ != succs.second; ++succ) {
+                range = RangeUnion(range, prev(revMarks_[*succ], 0));
             }
-            revMarks[v] = RangeUnion(succRangesStepped);
+            revMarks_[v] = range;
         }
     }
 
     // take hulls of extents from forward and reverse recursions
     foreach (VD v, sortedVertices) {
-        Vertex vExt = poaGraph.externalize(v);
-        alignableReadIntervalByVertex_[vExt] = RangeUnion(fwdMarks.at(v), revMarks.at(v));
+        alignableReadIntervalByVertex_[v] = RangeUnion(fwdMarks[v], revMarks_[v]);
 #if DEBUG_RANGE_FINDER
-        cout << vExt << " range = [" << alignableReadIntervalByVertex_[v].Begin << ", "
-             << alignableReadIntervalByVertex_[v].End << ")" << endl;
+        cout << poaGraph.externalize(v) << " range = [" << alignableReadIntervalByVertex_[v].Begin
+             << ", " << alignableReadIntervalByVertex_[v].End << ")" << endl;
 #endif
     }
 }
 
 Interval SdpRangeFinder::FindAlignableRange(Vertex v)
 {
-    return alignableReadIntervalByVertex_.at(v);
+    // Vertices are numbered densely, so the external id is the index
+    assert(v < alignableReadIntervalByVertex_.size());
+    return alignableReadIntervalByVertex_[v];
+}
+
+namespace {
+// An invertible mix of a k-mer's bits, so that minimizers are not
+// biased to poly-A
+inline uint64_t HashKmer(uint64_t key, uint64_t mask)
+{
+    key = (~key + (key << 21)) & mask;
+    key = key ^ key >> 24;
+    key = ((key + (key << 3)) + (key << 8)) & mask;
+    key = key ^ key >> 14;
+    key = ((key + (key << 2)) + (key << 4)) & mask;
+    key = key ^ key >> 28;
+    key = (key + (key << 31)) & mask;
+    return key;
+}
+
+// The (hash, position) of each (w, k)-minimizer of seq: the least hash
+// of every w consecutive k-mers, those with a base other than ACGT
+// left out
+std::vector<std::pair<uint64_t, int>> Minimizers(const std::string& seq, int k, int w)
+{
+    const uint64_t mask = (k < 32) ? (uint64_t(1) << (2 * k)) - 1 : ~uint64_t(0);
+    std::vector<uint64_t> hashes(seq.size(), ~uint64_t(0));
+    uint64_t kmer = 0;
+    int valid = 0;
+    for (size_t i = 0; i < seq.size(); i++) {
+        int code;
+        switch (seq[i]) {
+            case 'A':
+                code = 0;
+                break;
+            case 'C':
+                code = 1;
+                break;
+            case 'G':
+                code = 2;
+                break;
+            case 'T':
+                code = 3;
+                break;
+            default:
+                code = -1;
+        }
+        if (code < 0) {
+            valid = 0;
+            continue;
+        }
+        kmer = ((kmer << 2) | code) & mask;
+        if (++valid >= k) {
+            hashes[i + 1 - k] = HashKmer(kmer, mask);
+        }
+    }
+
+    std::vector<std::pair<uint64_t, int>> minimizers;
+    const int numKmers = static_cast<int>(seq.size()) - k + 1;
+    for (int start = 0; start + w <= std::max(numKmers, w); start++) {
+        int best = -1;
+        for (int i = start; i < std::min(start + w, numKmers); i++) {
+            if (hashes[i] != ~uint64_t(0) && (best < 0 || hashes[i] < hashes[best])) {
+                best = i;
+            }
+        }
+        if (best >= 0 && (minimizers.empty() || minimizers.back().second != best)) {
+            minimizers.push_back(std::make_pair(hashes[best], best));
+        }
+    }
+    return minimizers;
+}
+}
+
+MinimizerRangeFinder::MinimizerRangeFinder(int k, int w, int maxOccurrences)
+    : k_(k), w_(w), maxOccurrences_(maxOccurrences)
+{
+    if (k < 1 || k > 32 || w < 1) {
+        throw InvalidInputError("Minimizers need 1 <= k <= 32 and w >= 1");
+    }
+}
+
+SdpAnchorVector MinimizerRangeFinder::FindAnchors(const std::string& consensusSequence,
+                                                  const std::string& readSequence) const
+{
+    // Seeds: the minimizers of the read found among the consensus's
+    std::vector<std::pair<uint64_t, int>> cssMinimizers =
+        Minimizers(consensusSequence, k_, w_);
+    std::sort(cssMinimizers.begin(), cssMinimizers.end());
+    SdpAnchorVector seeds;
+    typedef std::vector<std::pair<uint64_t, int>>::const_iterator iter_t;
+    foreach (const auto& m, Minimizers(readSequence, k_, w_)) {
+        std::pair<iter_t, iter_t> hits =
+            std::equal_range(cssMinimizers.begin(), cssMinimizers.end(), std::make_pair(m.first, 0),
+                             [](const std::pair<uint64_t, int>& a,
+                                const std::pair<uint64_t, int>& b) { return a.first < b.first; });
+        if (hits.second - hits.first > maxOccurrences_) continue;
+        for (iter_t hit = hits.first; hit != hits.second; ++hit) {
+            seeds.push_back(SdpAnchor(hit->second, m.second));
+        }
+    }
+    std::sort(seeds.begin(), seeds.end());
+
+    // Chain: a seed scores its k bases, plus the best chain ending at
+    // a seed before it in both sequences, less the difference in
+    // their diagonals; seeds closer than k count only their new bases
+    const int LOOKBACK = 50;
+    const int n = seeds.size();
+    std::vector<int> score(n), pred(n, -1);
+    int bestEnd = -1;
+    for (int i = 0; i < n; i++) {
+        score[i] = k_;
+        for (int j = std::max(0, i - LOOKBACK); j < i; j++) {
+            if (seeds[j].first >= seeds[i].first || seeds[j].second >= seeds[i].second) continue;
+            int dc = seeds[i].first - seeds[j].first;
+            int dr = seeds[i].second - seeds[j].second;
+            int s = score[j] + std::min(k_, std::min(dc, dr)) - std::abs(dc - dr);
+            if (s > score[i]) {
+                score[i] = s;
+                pred[i] = j;
+            }
+        }
+        if (bestEnd < 0 || score[i] > score[bestEnd]) {
+            bestEnd = i;
+        }
+    }
+
+    SdpAnchorVector anchors;
+    for (int i = bestEnd; i >= 0; i = pred[i]) {
+        anchors.push_back(seeds[i]);
+    }
+    std::reverse(anchors.begin(), anchors.end());
+    return anchors;
 }
 }
 }
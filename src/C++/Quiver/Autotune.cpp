@@ -0,0 +1,394 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/Autotune.hpp>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ConsensusCore/Checksum.hpp>
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+#include <ConsensusCore/Quiver/SimpleRecursor.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+const char AUTOTUNE_HEADER[] = "# ConsensusCore autotune choices, version 1";
+
+// Single-base substitutions probed along each read
+const int NUM_PROBES = 8;
+
+// A read of the sample, its stranded template window, and the
+// mutations of the window it is scored for
+struct ProbedRead
+{
+    boost::shared_ptr<const ConsensusCore::Read> Read;
+    std::string Template;
+    std::vector<Mutation> Probes;
+};
+
+// How a recursor and band fared over a chemistry's reads
+struct Trial
+{
+    // Whether every read the reference filled was filled
+    bool Complete;
+    double Seconds;
+    int64_t Cells;
+    int FlipFlops;
+    float Drift;
+
+    Trial() : Complete(true), Seconds(0), Cells(0), FlipFlops(0), Drift(0) {}
+};
+
+ProbedRead Probe(const std::string& tpl, const MappedRead& mr)
+{
+    int L = tpl.length();
+    if (mr.TemplateStart < 0 || mr.TemplateStart > mr.TemplateEnd || mr.TemplateEnd > L) {
+        throw InvalidInputError("Autotune read extends beyond its template");
+    }
+    ProbedRead pr;
+    pr.Read = boost::make_shared<const Read>(mr);
+    int len = mr.TemplateEnd - mr.TemplateStart;
+    if (mr.Strand == FORWARD_STRAND) {
+        pr.Template = tpl.substr(mr.TemplateStart, len);
+    } else {
+        pr.Template.resize(len);
+        ReverseComplement(tpl.data() + mr.TemplateStart, len, &pr.Template[0]);
+    }
+    for (int k = 0; k < NUM_PROBES && len > 0; k++) {
+        int j = (k + 1) * len / (NUM_PROBES + 1);
+        const char* base = std::find("ACGT", "ACGT" + 4, pr.Template[j]);
+        pr.Probes.push_back(Mutation(SUBSTITUTION, j, "ACGT"[(base - "ACGT" + 1) % 4]));
+    }
+    return pr;
+}
+
+// The scores of a read and its probes under recursor R, banded by
+// scoreDiff, filled repeats times; false if it can't be filled
+template <typename R>
+bool ScoreRead(const QuiverConfig& config, const ProbedRead& pr, float scoreDiff, int repeats,
+               std::vector<float>* scores, Trial* trial)
+{
+    QvEvaluator ev(pr.Read, pr.Template, config.Model);
+    R recursor(config.MovesAvailable, BandingOptions(0, scoreDiff), config.Recursor);
+    double fastest = std::numeric_limits<double>::max();
+    for (int rep = 0; rep < std::max(1, repeats); rep++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        try {
+            MutationScorer<R> scorer(ev, recursor);
+            scores->assign(1, scorer.Score());
+            foreach (const Mutation& m, pr.Probes) {
+                scores->push_back(scorer.ScoreMutation(m));
+            }
+            if (rep == 0) {
+                const FillStatistics& stats = scorer.FillStats();
+                trial->Cells += stats.AlphaUsedEntries + stats.BetaUsedEntries;
+                trial->FlipFlops += stats.FlipFlops;
+            }
+        } catch (AlphaBetaMismatchException&) {
+            return false;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        fastest = std::min(fastest, elapsed.count());
+    }
+    trial->Seconds += fastest;
+    return true;
+}
+
+// How R fares over the reads the reference scored
+template <typename R>
+Trial RunTrial(const QuiverConfig& config, const std::vector<ProbedRead>& reads,
+               const std::vector<std::vector<float> >& reference, float scoreDiff, int repeats)
+{
+    Trial trial;
+    std::vector<float> scores;
+    for (size_t r = 0; r < reads.size(); r++) {
+        if (reference[r].empty()) continue;
+        if (!ScoreRead<R>(config, reads[r], scoreDiff, repeats, &scores, &trial)) {
+            trial.Complete = false;
+            continue;
+        }
+        for (size_t k = 0; k < scores.size(); k++) {
+            trial.Drift = std::max(trial.Drift, std::fabs(scores[k] - reference[r][k]));
+        }
+    }
+    return trial;
+}
+
+Trial RunTrial(RecursorKind kind, const QuiverConfig& config, const std::vector<ProbedRead>& reads,
+               const std::vector<std::vector<float> >& reference, float scoreDiff, int repeats)
+{
+    switch (kind) {
+        case DENSE_SIMPLE_RECURSOR:
+            return RunTrial<SimpleQvRecursor>(config, reads, reference, scoreDiff, repeats);
+        case DENSE_SSE_RECURSOR:
+            return RunTrial<SseQvRecursor>(config, reads, reference, scoreDiff, repeats);
+        case SPARSE_SIMPLE_RECURSOR:
+            return RunTrial<SparseSimpleQvRecursor>(config, reads, reference, scoreDiff, repeats);
+        default:
+            return RunTrial<SparseSseQvRecursor>(config, reads, reference, scoreDiff, repeats);
+    }
+}
+
+template <typename T>
+uint32_t Crc32c(const T& value, uint32_t crc)
+{
+    return Checksum::Crc32c(&value, sizeof(value), crc);
+}
+
+std::string Fingerprint(const QuiverConfig& config, const AutotuneOptions& options)
+{
+    const QvModelParams& p = config.QvParams;
+    uint32_t crc = Checksum::Crc32c(p.ModelName.data(), p.ModelName.length());
+    const float params[] = {p.Match,    p.Mismatch,  p.MismatchS,       p.Branch,
+                            p.BranchS,  p.DeletionN, p.DeletionWithTag, p.DeletionWithTagS,
+                            p.Nce,      p.NceS,      p.Merge[0],        p.Merge[1],
+                            p.Merge[2], p.Merge[3],  p.MergeS[0],       p.MergeS[1],
+                            p.MergeS[2], p.MergeS[3]};
+    crc = Checksum::Crc32c(params, sizeof(params), crc);
+    crc = Crc32c(config.MovesAvailable, crc);
+    crc = Crc32c(config.Recursor.MaxFlipFlops, crc);
+    crc = Crc32c(config.Recursor.AlphaBetaMismatchTolerance, crc);
+    crc = Crc32c(config.Recursor.RebandingThreshold, crc);
+    crc = Crc32c(static_cast<int>(config.Recursor.LogAdd), crc);
+    foreach (float scoreDiff, options.ScoreDiffs) {
+        crc = Crc32c(scoreDiff, crc);
+    }
+    crc = Crc32c(options.ReferenceScoreDiff, crc);
+    crc = Crc32c(options.ScoreTolerance, crc);
+    crc = Crc32c(options.MaxFlipFlopRate, crc);
+    crc = Crc32c(options.MaxDenseEntries, crc);
+    crc = Crc32c(SimdWidth(), crc);
+    std::stringstream ss;
+    ss << std::hex << std::setw(8) << std::setfill('0') << crc;
+    return ss.str();
+}
+
+// The name of the entry of configs that At(chemistry) finds
+std::string EntryName(const QuiverConfigTable& configs, const std::string& chemistry)
+{
+    const QuiverConfig* config = &configs.At(chemistry);
+    for (QuiverConfigTable::const_iterator it = configs.begin(); it != configs.end(); it++) {
+        if (&it->second == config) return it->first;
+    }
+    ShouldNotReachHere();
+}
+
+AutotuneChoice Tune(const std::string& name, const QuiverConfig& config,
+                    const std::vector<ProbedRead>& reads, const AutotuneOptions& options)
+{
+    AutotuneChoice choice;
+    choice.Chemistry = name;
+    choice.Fingerprint = Fingerprint(config, options);
+    choice.ScoreDiff = config.Banding.ScoreDiff;
+
+    std::vector<std::vector<float> > reference(reads.size());
+    Trial ignored;
+    bool denseFits = true;
+    for (size_t r = 0; r < reads.size(); r++) {
+        ScoreRead<SparseSimpleQvRecursor>(config, reads[r], options.ReferenceScoreDiff, 1,
+                                          &reference[r], &ignored);
+        int64_t entries = int64_t(reads[r].Read->Length() + 1) * (reads[r].Template.length() + 1);
+        denseFits = denseFits && entries <= options.MaxDenseEntries;
+    }
+
+    std::vector<float> scoreDiffs(options.ScoreDiffs);
+    std::sort(scoreDiffs.begin(), scoreDiffs.end());
+    double bestSeconds = std::numeric_limits<double>::max();
+    const RecursorKind kinds[] = {DENSE_SIMPLE_RECURSOR, DENSE_SSE_RECURSOR,
+                                  SPARSE_SIMPLE_RECURSOR, SPARSE_SSE_RECURSOR};
+    foreach (RecursorKind kind, kinds) {
+        if (!denseFits && (kind == DENSE_SIMPLE_RECURSOR || kind == DENSE_SSE_RECURSOR)) continue;
+        foreach (float scoreDiff, scoreDiffs) {
+            Trial t = RunTrial(kind, config, reads, reference, scoreDiff, options.Repeats);
+            float flipFlopRate =
+                static_cast<float>(t.FlipFlops) / std::max<size_t>(1, reads.size());
+            if (!t.Complete || t.Drift > options.ScoreTolerance ||
+                flipFlopRate > options.MaxFlipFlopRate) {
+                continue;
+            }
+            // The tightest band that holds is this recursor's best
+            if (t.Seconds < bestSeconds) {
+                bestSeconds = t.Seconds;
+                choice.Tuned = true;
+                choice.Recursor = kind;
+                choice.ScoreDiff = scoreDiff;
+                choice.CellsPerSecond = t.Seconds > 0 ? t.Cells / t.Seconds : 0;
+                choice.FlipFlopRate = flipFlopRate;
+                choice.ScoreDrift = t.Drift;
+            }
+            break;
+        }
+    }
+    return choice;
+}
+
+// The names of the entries the samples' reads are taken as, in the
+// order of configs
+std::vector<std::string> SampledEntries(const QuiverConfigTable& configs,
+                                        const std::vector<AutotuneSample>& samples)
+{
+    std::vector<std::string> sampled, entries;
+    foreach (const AutotuneSample& sample, samples) {
+        foreach (const MappedRead& mr, sample.Reads) {
+            sampled.push_back(EntryName(configs, mr.Chemistry));
+        }
+    }
+    foreach (const std::string& name, configs.Keys()) {
+        if (std::find(sampled.begin(), sampled.end(), name) != sampled.end()) {
+            entries.push_back(name);
+        }
+    }
+    return entries;
+}
+}  // PRIVATE
+
+std::vector<AutotuneChoice> Autotune(const QuiverConfigTable& configs,
+                                     const std::vector<AutotuneSample>& samples,
+                                     const AutotuneOptions& options)
+{
+    std::map<std::string, std::vector<ProbedRead> > readsByEntry;
+    foreach (const AutotuneSample& sample, samples) {
+        foreach (const MappedRead& mr, sample.Reads) {
+            std::vector<ProbedRead>& reads = readsByEntry[EntryName(configs, mr.Chemistry)];
+            if (static_cast<int>(reads.size()) < options.MaxReadsPerChemistry) {
+                reads.push_back(Probe(sample.Template, mr));
+            }
+        }
+    }
+
+    std::vector<AutotuneChoice> choices;
+    foreach (const std::string& name, SampledEntries(configs, samples)) {
+        choices.push_back(Tune(name, configs.At(name), readsByEntry[name], options));
+    }
+    return choices;
+}
+
+QuiverConfigTable ApplyAutotune(const QuiverConfigTable& configs,
+                                const std::vector<AutotuneChoice>& choices)
+{
+    // Entries are kept newest first, so are inserted oldest first
+    QuiverConfigTable tuned;
+    std::vector<std::pair<std::string, const QuiverConfig*> > entries;
+    for (QuiverConfigTable::const_iterator it = configs.begin(); it != configs.end(); it++) {
+        entries.push_back(std::make_pair(it->first, &it->second));
+    }
+    for (int i = entries.size() - 1; i >= 0; i--) {
+        QuiverConfig config(*entries[i].second);
+        foreach (const AutotuneChoice& choice, choices) {
+            if (choice.Tuned && choice.Chemistry == entries[i].first) {
+                config.Banding.ScoreDiff = choice.ScoreDiff;
+            }
+        }
+        if (entries[i].first == "*") {
+            tuned.InsertDefault(config);
+        } else {
+            tuned.InsertAs(entries[i].first, config);
+        }
+    }
+    return tuned;
+}
+
+void SaveAutotuneChoices(const std::string& filename, const std::vector<AutotuneChoice>& choices)
+{
+    // Written aside and renamed into place, so that readers never see
+    // part of a file
+    std::string partial = filename + ".partial";
+    {
+        std::ofstream out(partial.c_str());
+        out << AUTOTUNE_HEADER << '\n' << std::setprecision(9);
+        foreach (const AutotuneChoice& c, choices) {
+            out << c.Chemistry << '\t' << c.Fingerprint << '\t' << c.Tuned << '\t' << c.Recursor
+                << '\t' << c.ScoreDiff << '\t' << c.CellsPerSecond << '\t' << c.FlipFlopRate
+                << '\t' << c.ScoreDrift << '\n';
+        }
+        out.flush();
+        if (!out) {
+            std::remove(partial.c_str());
+            throw InvalidInputError("Can't write autotune choices to " + filename);
+        }
+    }
+    if (std::rename(partial.c_str(), filename.c_str()) != 0) {
+        std::remove(partial.c_str());
+        throw InvalidInputError("Can't write autotune choices to " + filename);
+    }
+}
+
+std::vector<AutotuneChoice> LoadAutotuneChoices(const std::string& filename,
+                                                const QuiverConfigTable& configs,
+                                                const AutotuneOptions& options)
+{
+    std::vector<AutotuneChoice> choices;
+    std::ifstream in(filename.c_str());
+    std::string line;
+    if (!std::getline(in, line) || line != AUTOTUNE_HEADER) return choices;
+
+    std::vector<std::string> keys = configs.Keys();
+    while (std::getline(in, line)) {
+        AutotuneChoice c;
+        std::stringstream ss(line);
+        int recursor;
+        if (!std::getline(ss, c.Chemistry, '\t') || !std::getline(ss, c.Fingerprint, '\t') ||
+            !(ss >> c.Tuned >> recursor >> c.ScoreDiff >> c.CellsPerSecond >> c.FlipFlopRate >>
+              c.ScoreDrift) ||
+            recursor < DENSE_SIMPLE_RECURSOR || recursor > SPARSE_SSE_RECURSOR) {
+            continue;
+        }
+        c.Recursor = static_cast<RecursorKind>(recursor);
+        if (std::find(keys.begin(), keys.end(), c.Chemistry) != keys.end() &&
+            c.Fingerprint == Fingerprint(configs.At(c.Chemistry), options)) {
+            choices.push_back(c);
+        }
+    }
+    return choices;
+}
+
+std::vector<AutotuneChoice> AutotuneCached(const std::string& filename,
+                                           const QuiverConfigTable& configs,
+                                           const std::vector<AutotuneSample>& samples,
+                                           const AutotuneOptions& options)
+{
+    std::vector<AutotuneChoice> cached = LoadAutotuneChoices(filename, configs, options);
+    std::vector<AutotuneChoice> choices;
+    foreach (const std::string& name, SampledEntries(configs, samples)) {
+        foreach (const AutotuneChoice& c, cached) {
+            if (c.Chemistry == name) choices.push_back(c);
+        }
+        if (choices.empty() || choices.back().Chemistry != name) {
+            choices = Autotune(configs, samples, options);
+            // Keep what was cached for the chemistries not sampled now
+            std::vector<AutotuneChoice> kept(choices);
+            foreach (const AutotuneChoice& c, cached) {
+                bool retuned = false;
+                foreach (const AutotuneChoice& t, choices) {
+                    retuned = retuned || t.Chemistry == c.Chemistry;
+                }
+                if (!retuned) kept.push_back(c);
+            }
+            SaveAutotuneChoices(filename, kept);
+            return choices;
+        }
+    }
+    return choices;
+}
+}
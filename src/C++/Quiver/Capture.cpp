@@ -0,0 +1,560 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/Capture.hpp>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/WorkUnit.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "Sections.hpp"
+
+namespace ConsensusCore {
+using detail::SectionReader;
+using detail::SectionWriter;
+
+namespace detail {
+std::atomic<bool> capturing(false);
+}
+
+namespace {  // PRIVATE
+const char CAPTURE_MAGIC[8] = {'C', 'C', 'C', 'A', 'P', 'T', 'U', 'R'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+// The name QuiverConfigTable gives its default config
+const char* const DEFAULT_CONFIG_NAME = "*";
+
+enum RecordKind
+{
+    SCORER_RECORD = 1,
+    DESTRUCTION_RECORD = 2,
+    SETTING_RECORD = 3,
+    ADD_READ_RECORD = 4,
+    ADD_READS_RECORD = 5,
+    APPLY_MUTATIONS_RECORD = 6,
+    SLIDE_TEMPLATE_RECORD = 7,
+    REFINE_RECORD = 8,
+    QVS_RECORD = 9
+};
+
+struct CaptureHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ByteOrder;
+};
+
+struct RecordHeader
+{
+    uint32_t Kind;
+    uint32_t Reserved;
+    int64_t Scorer;
+    uint64_t Length;
+};
+
+// A config but for its names
+struct ConfigRecord
+{
+    float Match;
+    float Mismatch;
+    float MismatchS;
+    float Branch;
+    float BranchS;
+    float DeletionN;
+    float DeletionWithTag;
+    float DeletionWithTagS;
+    float Nce;
+    float NceS;
+    float Merge[4];
+    float MergeS[4];
+    int32_t MovesAvailable;
+    float ScoreDiff;
+    float FastScoreThreshold;
+    float AddThreshold;
+    int32_t MaxFlipFlops;
+    float AlphaBetaMismatchTolerance;
+    double RebandingThreshold;
+    int32_t LogAdd;
+    int32_t CheckpointInterval;
+};
+
+struct SettingRecord
+{
+    int32_t Setting;
+    int32_t Reserved;
+    int64_t Value;
+};
+
+struct AddReadRecord
+{
+    float Threshold;
+    int32_t Added;
+};
+
+struct MutationRecord
+{
+    int32_t Type;
+    int32_t Start;
+    int32_t End;
+    uint32_t NewBasesLength;
+};
+
+struct RefineRecord
+{
+    int32_t MaximumIterations;
+    int32_t MutationSeparation;
+    int32_t MutationNeighborhood;
+    int32_t MinPileupSupport;
+    int32_t Converged;
+    uint32_t Reserved;
+    uint64_t ResultLength;
+};
+
+struct QvsRecord
+{
+    int32_t BeginPos;
+    int32_t EndPos;
+    uint64_t NumQVs;
+};
+
+// The running capture.  The scorers captured are known by their
+// addresses, until they are destroyed.
+struct Capture
+{
+    std::mutex Mutex;
+    std::ofstream Out;
+    std::map<const void*, int64_t> Ids;
+    int64_t NextId;
+
+    Capture() : NextId(0) {}
+};
+
+Capture& TheCapture()
+{
+    static Capture* capture = new Capture();
+    return *capture;
+}
+
+thread_local int nestedDepth = 0;
+
+void WriteString(SectionWriter* w, const std::string& s)
+{
+    uint64_t length = s.length();
+    w->Write(&length, sizeof(length));
+    w->Write(s.data(), length);
+}
+
+std::string TakeString(SectionReader* in) { return in->TakeString(in->TakeValue<uint64_t>()); }
+
+// Reads, with the template they are mapped to, which decoding checks
+// their extents against
+void WriteReads(SectionWriter* w, const std::string& tpl, const std::vector<MappedRead>& reads)
+{
+    // Copied into place: Read has no assignment of its own
+    WorkUnit unit(0, tpl);
+    foreach (const MappedRead& mr, reads) {
+        unit.Reads.push_back(mr);
+    }
+    WriteString(w, EncodeWorkUnit(unit));
+}
+
+std::vector<MappedRead> TakeReads(SectionReader* in)
+{
+    return DecodeWorkUnit(TakeString(in)).Reads;
+}
+
+// Write a record of a call on a scorer, if it was captured; a scorer
+// record makes the scorer captured first
+void Record(RecordKind kind, const AbstractMultiReadMutationScorer* mms, const std::string& body)
+{
+    Capture& capture = TheCapture();
+    std::lock_guard<std::mutex> lock(capture.Mutex);
+    if (!capture.Out.is_open()) return;
+    if (kind == SCORER_RECORD) {
+        capture.Ids[mms] = capture.NextId++;
+    }
+    std::map<const void*, int64_t>::iterator it = capture.Ids.find(mms);
+    if (it == capture.Ids.end()) return;
+
+    RecordHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.Kind = kind;
+    h.Scorer = it->second;
+    h.Length = body.length();
+    capture.Out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    capture.Out.write(body.data(), body.length());
+    if (kind == DESTRUCTION_RECORD) {
+        capture.Ids.erase(it);
+    }
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Mismatch(ReplayReport* report, int64_t scorer, const std::string& what)
+{
+    if (report->Mismatches++ == 0) {
+        std::stringstream ss;
+        ss << "Scorer " << scorer << ": " << what;
+        report->FirstMismatch = ss.str();
+    }
+}
+
+void InsertConfig(QuiverConfigTable* configs, SectionReader* in)
+{
+    std::string name = TakeString(in);
+    std::string chemistryName = TakeString(in);
+    std::string modelName = TakeString(in);
+    ConfigRecord r = in->TakeValue<ConfigRecord>();
+    QvModelParams params(chemistryName, modelName, r.Match, r.Mismatch, r.MismatchS, r.Branch,
+                         r.BranchS, r.DeletionN, r.DeletionWithTag, r.DeletionWithTagS, r.Nce,
+                         r.NceS, 0, 0);
+    std::copy(r.Merge, r.Merge + 4, params.Merge);
+    std::copy(r.MergeS, r.MergeS + 4, params.MergeS);
+    QuiverConfig config(params, r.MovesAvailable, BandingOptions(0, r.ScoreDiff),
+                        r.FastScoreThreshold, r.AddThreshold,
+                        RecursorConfig(r.MaxFlipFlops, r.AlphaBetaMismatchTolerance,
+                                       r.RebandingThreshold, static_cast<LogAddMode>(r.LogAdd)),
+                        r.CheckpointInterval);
+    if (name == DEFAULT_CONFIG_NAME) {
+        configs->InsertDefault(config);
+    } else {
+        configs->InsertAs(name, config);
+    }
+}
+}  // PRIVATE
+
+void StartCapture(const std::string& filename)
+{
+    Capture& capture = TheCapture();
+    std::lock_guard<std::mutex> lock(capture.Mutex);
+    if (capture.Out.is_open()) {
+        throw InvalidInputError("A capture is already running");
+    }
+    capture.Out.open(filename.c_str(), std::ios::binary);
+    if (!capture.Out) {
+        capture.Out.close();
+        throw InvalidInputError("Can't create capture " + filename);
+    }
+    CaptureHeader h;
+    std::memcpy(h.Magic, CAPTURE_MAGIC, sizeof(h.Magic));
+    h.Version = CAPTURE_VERSION;
+    h.ByteOrder = BYTE_ORDER_MARK;
+    capture.Out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    capture.Ids.clear();
+    capture.NextId = 0;
+    detail::capturing.store(true, std::memory_order_relaxed);
+}
+
+void StopCapture()
+{
+    Capture& capture = TheCapture();
+    std::lock_guard<std::mutex> lock(capture.Mutex);
+    if (!capture.Out.is_open()) {
+        throw InvalidInputError("No capture is running");
+    }
+    detail::capturing.store(false, std::memory_order_relaxed);
+    capture.Out.close();
+    capture.Ids.clear();
+}
+
+ReplayReport ReplayCapture(const std::string& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    CaptureHeader h;
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) ||
+        std::memcmp(h.Magic, CAPTURE_MAGIC, sizeof(h.Magic)) != 0) {
+        throw InvalidInputError(filename + " is not a capture");
+    }
+    if (h.ByteOrder != BYTE_ORDER_MARK) {
+        throw InvalidInputError(filename + " was captured in another byte order");
+    }
+    if (h.Version != CAPTURE_VERSION) {
+        throw InvalidInputError(filename + " was captured in an unsupported version");
+    }
+
+    ReplayReport report;
+    std::map<int64_t, boost::shared_ptr<SparseSseQvMultiReadMutationScorer> > scorers;
+    RecordHeader rh;
+    std::string body;
+    while (in.read(reinterpret_cast<char*>(&rh), sizeof(rh))) {
+        body.resize(rh.Length);
+        if (!in.read(&body[0], rh.Length)) {
+            throw InvalidInputError(filename + " is truncated");
+        }
+        SectionReader r(&body[0], body.length(), "Capture " + filename);
+
+        if (rh.Kind == SCORER_RECORD) {
+            QuiverConfigTable configs;
+            uint64_t numConfigs = r.TakeValue<uint64_t>();
+            for (uint64_t c = 0; c < numConfigs; c++) {
+                InsertConfig(&configs, &r);
+            }
+            std::string tpl = TakeString(&r);
+            scorers[rh.Scorer].reset(new SparseSseQvMultiReadMutationScorer(configs, tpl));
+            report.Scorers++;
+            continue;
+        }
+        if (scorers.find(rh.Scorer) == scorers.end()) {
+            throw InvalidInputError(filename + " is corrupt");
+        }
+        SparseSseQvMultiReadMutationScorer& mms = *scorers[rh.Scorer];
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        switch (rh.Kind) {
+            case DESTRUCTION_RECORD:
+                scorers.erase(rh.Scorer);
+                break;
+            case SETTING_RECORD: {
+                SettingRecord s = r.TakeValue<SettingRecord>();
+                if (s.Setting == detail::COVERAGE_CAP_SETTING) {
+                    mms.SetCoverageCap(s.Value);
+                } else if (s.Setting == detail::MEMORY_BUDGET_SETTING) {
+                    mms.SetMemoryBudget(s.Value);
+                } else {
+                    mms.SetScoreCaching(s.Value != 0);
+                }
+                break;
+            }
+            case ADD_READ_RECORD: {
+                AddReadRecord a = r.TakeValue<AddReadRecord>();
+                std::vector<MappedRead> reads = TakeReads(&r);
+                if (reads.size() != 1) {
+                    throw InvalidInputError(filename + " is corrupt");
+                }
+                if (mms.AddRead(reads[0], a.Threshold) != (a.Added != 0)) {
+                    Mismatch(&report, rh.Scorer, "a read was taken differently");
+                }
+                report.Reads++;
+                report.AddSeconds += SecondsSince(start);
+                break;
+            }
+            case ADD_READS_RECORD: {
+                int32_t added = r.TakeValue<AddReadRecord>().Added;
+                std::vector<MappedRead> reads = TakeReads(&r);
+                if (mms.AddReads(reads) != added) {
+                    Mismatch(&report, rh.Scorer, "a different number of reads was taken");
+                }
+                report.Reads += reads.size();
+                report.AddSeconds += SecondsSince(start);
+                break;
+            }
+            case APPLY_MUTATIONS_RECORD: {
+                uint64_t numMutations = r.TakeValue<uint64_t>();
+                std::vector<Mutation> mutations;
+                for (uint64_t k = 0; k < numMutations; k++) {
+                    MutationRecord m = r.TakeValue<MutationRecord>();
+                    mutations.push_back(Mutation(static_cast<MutationType>(m.Type), m.Start,
+                                                 m.End, r.TakeString(m.NewBasesLength)));
+                }
+                mms.ApplyMutations(mutations);
+                break;
+            }
+            case SLIDE_TEMPLATE_RECORD: {
+                int32_t trimLength = r.TakeValue<int32_t>();
+                mms.SlideTemplate(trimLength, TakeString(&r));
+                break;
+            }
+            case REFINE_RECORD: {
+                RefineRecord f = r.TakeValue<RefineRecord>();
+                std::string result = r.TakeString(f.ResultLength);
+                RefineOptions options = {f.MaximumIterations, f.MutationSeparation,
+                                         f.MutationNeighborhood, f.MinPileupSupport};
+                bool converged = RefineConsensus(mms, options);
+                report.RefineSeconds += SecondsSince(start);
+                report.Refines++;
+                if (converged != (f.Converged != 0) || mms.Template() != result) {
+                    Mismatch(&report, rh.Scorer, "refinement came out differently");
+                }
+                break;
+            }
+            case QVS_RECORD: {
+                QvsRecord q = r.TakeValue<QvsRecord>();
+                std::vector<int32_t> qvs(q.NumQVs);
+                std::memcpy(qvs.data(), r.Take(q.NumQVs * sizeof(int32_t)), qvs.size() * 4);
+                std::vector<int> expected(qvs.begin(), qvs.end());
+                bool same = ConsensusQVs(mms, q.BeginPos, q.EndPos) == expected;
+                report.QvSeconds += SecondsSince(start);
+                report.QvCalls++;
+                if (!same) {
+                    Mismatch(&report, rh.Scorer, "QVs came out differently");
+                }
+                break;
+            }
+            default:
+                throw InvalidInputError(filename + " is corrupt");
+        }
+    }
+    if (!in.eof() || in.gcount() != 0) {
+        throw InvalidInputError(filename + " is truncated");
+    }
+    return report;
+}
+
+namespace detail {
+
+bool CaptureThisCall() { return nestedDepth == 0; }
+
+NestedInCapture::NestedInCapture() { nestedDepth++; }
+
+NestedInCapture::~NestedInCapture() { nestedDepth--; }
+
+void CaptureScorer(const AbstractMultiReadMutationScorer* mms, const QuiverConfigTable& configs,
+                   const std::string& tpl)
+{
+    std::string body;
+    SectionWriter w(&body);
+    uint64_t numConfigs = configs.Size();
+    w.Write(&numConfigs, sizeof(numConfigs));
+    // In reverse, so a replay inserting them in turn numbers them alike
+    std::vector<std::pair<std::string, const QuiverConfig*> > entries;
+    for (QuiverConfigTable::const_iterator it = configs.begin(); it != configs.end(); it++) {
+        entries.push_back(std::make_pair(it->first, &it->second));
+    }
+    for (int k = entries.size() - 1; k >= 0; k--) {
+        const QuiverConfig& config = *entries[k].second;
+        // The parameters as compiled, which later changes do not touch
+        const QvModelParams& p = config.Model->Params();
+        ConfigRecord r;
+        std::memset(&r, 0, sizeof(r));
+        r.Match = p.Match;
+        r.Mismatch = p.Mismatch;
+        r.MismatchS = p.MismatchS;
+        r.Branch = p.Branch;
+        r.BranchS = p.BranchS;
+        r.DeletionN = p.DeletionN;
+        r.DeletionWithTag = p.DeletionWithTag;
+        r.DeletionWithTagS = p.DeletionWithTagS;
+        r.Nce = p.Nce;
+        r.NceS = p.NceS;
+        std::copy(p.Merge, p.Merge + 4, r.Merge);
+        std::copy(p.MergeS, p.MergeS + 4, r.MergeS);
+        r.MovesAvailable = config.MovesAvailable;
+        r.ScoreDiff = config.Banding.ScoreDiff;
+        r.FastScoreThreshold = config.FastScoreThreshold;
+        r.AddThreshold = config.AddThreshold;
+        r.MaxFlipFlops = config.Recursor.MaxFlipFlops;
+        r.AlphaBetaMismatchTolerance = config.Recursor.AlphaBetaMismatchTolerance;
+        r.RebandingThreshold = config.Recursor.RebandingThreshold;
+        r.LogAdd = config.Recursor.LogAdd;
+        r.CheckpointInterval = config.CheckpointInterval;
+        WriteString(&w, entries[k].first);
+        WriteString(&w, p.ChemistryName);
+        WriteString(&w, p.ModelName);
+        w.Write(&r, sizeof(r));
+    }
+    WriteString(&w, tpl);
+    Record(SCORER_RECORD, mms, body);
+}
+
+void CaptureDestruction(const AbstractMultiReadMutationScorer* mms)
+{
+    Record(DESTRUCTION_RECORD, mms, std::string());
+}
+
+void CaptureSetting(const AbstractMultiReadMutationScorer* mms, CapturedSetting setting,
+                    int64_t value)
+{
+    std::string body;
+    SectionWriter w(&body);
+    SettingRecord s = {setting, 0, value};
+    w.Write(&s, sizeof(s));
+    Record(SETTING_RECORD, mms, body);
+}
+
+void CaptureAddRead(const AbstractMultiReadMutationScorer* mms, const MappedRead& mr,
+                    float threshold, bool added)
+{
+    std::string body;
+    SectionWriter w(&body);
+    AddReadRecord a = {threshold, added};
+    w.Write(&a, sizeof(a));
+    WriteReads(&w, mms->Template(), std::vector<MappedRead>(1, mr));
+    Record(ADD_READ_RECORD, mms, body);
+}
+
+void CaptureAddReads(const AbstractMultiReadMutationScorer* mms,
+                     const std::vector<MappedRead>& reads, int added)
+{
+    std::string body;
+    SectionWriter w(&body);
+    AddReadRecord a = {1.0f, added};
+    w.Write(&a, sizeof(a));
+    WriteReads(&w, mms->Template(), reads);
+    Record(ADD_READS_RECORD, mms, body);
+}
+
+void CaptureApplyMutations(const AbstractMultiReadMutationScorer* mms,
+                           const std::vector<Mutation>& mutations)
+{
+    std::string body;
+    SectionWriter w(&body);
+    uint64_t numMutations = mutations.size();
+    w.Write(&numMutations, sizeof(numMutations));
+    foreach (const Mutation& m, mutations) {
+        MutationRecord r = {m.Type(), m.Start(), m.End(),
+                            static_cast<uint32_t>(m.NewBasesLength())};
+        w.Write(&r, sizeof(r));
+        w.Write(m.NewBasesData(), r.NewBasesLength);
+    }
+    Record(APPLY_MUTATIONS_RECORD, mms, body);
+}
+
+void CaptureSlideTemplate(const AbstractMultiReadMutationScorer* mms, int trimLength,
+                          const std::string& extension)
+{
+    std::string body;
+    SectionWriter w(&body);
+    int32_t trim = trimLength;
+    w.Write(&trim, sizeof(trim));
+    WriteString(&w, extension);
+    Record(SLIDE_TEMPLATE_RECORD, mms, body);
+}
+
+void CaptureRefine(const AbstractMultiReadMutationScorer* mms, const RefineOptions& options,
+                   bool converged, const std::string& result)
+{
+    std::string body;
+    SectionWriter w(&body);
+    RefineRecord r = {options.MaximumIterations,
+                      options.MutationSeparation,
+                      options.MutationNeighborhood,
+                      options.MinPileupSupport,
+                      converged,
+                      0,
+                      result.length()};
+    w.Write(&r, sizeof(r));
+    w.Write(result.data(), result.length());
+    Record(REFINE_RECORD, mms, body);
+}
+
+void CaptureQVs(const AbstractMultiReadMutationScorer* mms, int beginPos, int endPos,
+                const std::vector<int>& qvs)
+{
+    std::string body;
+    SectionWriter w(&body);
+    QvsRecord q = {beginPos, endPos, qvs.size()};
+    w.Write(&q, sizeof(q));
+    std::vector<int32_t> values(qvs.begin(), qvs.end());
+    w.Write(values.data(), values.size() * sizeof(int32_t));
+    Record(QVS_RECORD, mms, body);
+}
+}
+}
@@ -0,0 +1,180 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+const Move MOVES[] = {INCORPORATE, EXTRA, DELETE, MERGE};
+
+uint32_t MoveIndex(Move move)
+{
+    switch (move) {
+        case INCORPORATE:
+            return 0;
+        case EXTRA:
+            return 1;
+        case DELETE:
+            return 2;
+        case MERGE:
+            return 3;
+        default:
+            ShouldNotReachHere();
+    }
+}
+
+// Append a CIGAR operation, joining it to the last one if they match
+void AppendCigar(char op, int count, char* lastOp, int* lastCount, std::ostringstream* cigar)
+{
+    if (op == *lastOp) {
+        *lastCount += count;
+        return;
+    }
+    if (*lastCount > 0) *cigar << *lastCount << *lastOp;
+    *lastOp = op;
+    *lastCount = count;
+}
+}
+
+CompactAlignment::CompactAlignment() {}
+
+void CompactAlignment::Append(Move move, int count)
+{
+    assert(count > 0);
+    uint32_t index = MoveIndex(move);
+    if (!runs_.empty() && (runs_.back() & 3) == index) {
+        runs_.back() += 4 * count;
+    } else {
+        runs_.push_back(4 * count + index);
+    }
+}
+
+void CompactAlignment::Reverse() { std::reverse(runs_.begin(), runs_.end()); }
+
+Move CompactAlignment::RunMove(int run) const { return MOVES[runs_[run] & 3]; }
+
+int CompactAlignment::RunLength(int run) const { return runs_[run] >> 2; }
+
+int CompactAlignment::ReadLength() const
+{
+    int length = 0;
+    for (int r = 0; r < NumRuns(); r++) {
+        if (RunMove(r) != DELETE) length += RunLength(r);
+    }
+    return length;
+}
+
+int CompactAlignment::TemplateLength() const
+{
+    int length = 0;
+    for (int r = 0; r < NumRuns(); r++) {
+        Move move = RunMove(r);
+        if (move == MERGE) {
+            length += 2 * RunLength(r);
+        } else if (move != EXTRA) {
+            length += RunLength(r);
+        }
+    }
+    return length;
+}
+
+std::string CompactAlignment::Cigar() const
+{
+    std::ostringstream cigar;
+    char lastOp = 0;
+    int lastCount = 0;
+    for (int r = 0; r < NumRuns(); r++) {
+        int n = RunLength(r);
+        switch (RunMove(r)) {
+            case INCORPORATE:
+                AppendCigar('M', n, &lastOp, &lastCount, &cigar);
+                break;
+            case EXTRA:
+                AppendCigar('I', n, &lastOp, &lastCount, &cigar);
+                break;
+            case DELETE:
+                AppendCigar('D', n, &lastOp, &lastCount, &cigar);
+                break;
+            case MERGE:
+                for (int k = 0; k < n; k++) {
+                    AppendCigar('D', 1, &lastOp, &lastCount, &cigar);
+                    AppendCigar('M', 1, &lastOp, &lastCount, &cigar);
+                }
+                break;
+            default:
+                ShouldNotReachHere();
+        }
+    }
+    if (lastCount > 0) cigar << lastCount << lastOp;
+    return cigar.str();
+}
+
+std::string CompactAlignment::Target(const std::string& tpl) const
+{
+    assert(static_cast<int>(tpl.length()) == TemplateLength());
+    std::string target;
+    int j = 0;
+    for (int r = 0; r < NumRuns(); r++) {
+        int n = RunLength(r);
+        switch (RunMove(r)) {
+            case INCORPORATE:
+            case DELETE:
+                target.append(tpl, j, n);
+                j += n;
+                break;
+            case EXTRA:
+                target.append(n, '-');
+                break;
+            case MERGE:
+                target.append(tpl, j, 2 * n);
+                j += 2 * n;
+                break;
+            default:
+                ShouldNotReachHere();
+        }
+    }
+    return target;
+}
+
+std::string CompactAlignment::Query(const std::string& read) const
+{
+    assert(static_cast<int>(read.length()) == ReadLength());
+    std::string query;
+    int i = 0;
+    for (int r = 0; r < NumRuns(); r++) {
+        int n = RunLength(r);
+        switch (RunMove(r)) {
+            case INCORPORATE:
+            case EXTRA:
+                query.append(read, i, n);
+                i += n;
+                break;
+            case DELETE:
+                query.append(n, '-');
+                break;
+            case MERGE:
+                for (int k = 0; k < n; k++) {
+                    query += '-';
+                    query += read[i++];
+                }
+                break;
+            default:
+                ShouldNotReachHere();
+        }
+    }
+    return query;
+}
+
+PairwiseAlignment* CompactAlignment::ToPairwiseAlignment(const std::string& tpl,
+                                                         const std::string& read) const
+{
+    return new PairwiseAlignment(Target(tpl), Query(read));
+}
+}
@@ -0,0 +1,377 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/ConsensusPipeline.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <boost/scoped_ptr.hpp>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ConsensusCore/Logging.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
+#include <ConsensusCore/Numa.hpp>
+#include <ConsensusCore/Poa/PoaConsensus.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+//
+// A queue of at most capacity items: Push blocks while it is full, and
+// Pop while it is empty and open.  Closing it lets Pop drain it; a
+// cancelled queue drops its items and wakes everyone waiting on it.
+//
+template <typename T>
+class BoundedQueue : private boost::noncopyable
+{
+public:
+    explicit BoundedQueue(int capacity) : capacity_(capacity), closed_(false), cancelled_(false)
+    {
+    }
+
+    // False, dropping the item, once the queue is closed or cancelled
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] {
+            return closed_ || cancelled_ || static_cast<int>(items_.size()) < capacity_;
+        });
+        if (closed_ || cancelled_) return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // False once the queue is closed and drained, or cancelled
+    bool Pop(T* item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || cancelled_ || !items_.empty(); });
+        if (cancelled_ || items_.empty()) return false;
+        *item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        items_.clear();
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    const int capacity_;
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    std::deque<T> items_;
+    bool closed_;
+    bool cancelled_;
+};
+
+// A window between the stages: its result so far, and the scorer
+// holding its reads
+struct WindowJob
+{
+    ConsensusResult Result;
+    std::unique_ptr<SparseSseQvMultiReadMutationScorer> Scorer;
+};
+
+std::string ErrorMessage(const std::exception_ptr& error)
+{
+    try {
+        std::rethrow_exception(error);
+    } catch (const ErrorBase& e) {
+        return e.Message();
+    } catch (const std::exception& e) {
+        return e.what();
+    } catch (...) {
+        return "Unknown error";
+    }
+}
+
+// Find the POA consensus of a window, and place its reads on it in a
+// scorer, counting those it takes
+std::unique_ptr<SparseSseQvMultiReadMutationScorer> Place(const QuiverConfigTable& configs,
+                                                          const ConsensusPipelineOptions& options,
+                                                          const ConsensusWindow& window,
+                                                          int* numReads)
+{
+    if (window.Reads.empty()) {
+        throw InvalidInputError("ConsensusPipeline needs reads in each window");
+    }
+    if (window.Reads.size() != window.Strands.size()) {
+        throw InvalidInputError("ConsensusPipeline needs a strand for each read");
+    }
+
+    // The POA sees each read on the forward strand of the window
+    std::vector<std::string> seqs;
+    for (size_t k = 0; k < window.Reads.size(); k++) {
+        std::string seq = window.Reads[k].Features.Sequence().ToString();
+        seqs.push_back(window.Strands[k] == REVERSE_STRAND ? ReverseComplement(seq) : seq);
+    }
+    boost::scoped_ptr<const PoaConsensus> pc(PoaConsensus::FindConsensus(
+        seqs, DefaultPoaConfig(options.PoaMode), options.PoaMinCoverage));
+
+    std::unique_ptr<SparseSseQvMultiReadMutationScorer> scorer(
+        new SparseSseQvMultiReadMutationScorer(configs, pc->Sequence));
+    *numReads = 0;
+    for (size_t k = 0; k < window.Reads.size(); k++) {
+        try {
+            if (scorer->AddRead(pc->ToMappedRead(k, window.Reads[k], window.Strands[k]))) {
+                ++*numReads;
+            }
+        } catch (const InvalidInputError&) {
+            LDEBUG << "Window " << window.Id << ": read " << k << " left out of the consensus";
+        }
+    }
+    return scorer;
+}
+}  // PRIVATE
+
+namespace detail {
+
+class ConsensusPipelineImpl : private boost::noncopyable
+{
+public:
+    ConsensusPipelineImpl(const QuiverConfigTable& configs,
+                          const ConsensusPipelineOptions& options);
+    ~ConsensusPipelineImpl();
+
+    BoundedQueue<ConsensusWindow> Windows;
+    BoundedQueue<ConsensusResult> Results;
+
+private:
+    typedef std::vector<std::unique_ptr<BoundedQueue<WindowJob> > > NodeQueues;
+
+    // Run work(node) on numWorkers threads, the i-th on node i mod
+    // numNodes_, pinned to it if asked to, calling done once all of
+    // them have returned
+    void StartStage(int numWorkers, const std::function<void(int)>& work,
+                    const std::function<void()>& done);
+
+    void PlaceWindows(int node);
+    void RefineWindows(int node);
+    void ComputeQVs(int node);
+
+    // Pass on a job that may have failed: onward if not, its scorer
+    // hibernating if memory is short, else its result straight out
+    void Forward(WindowJob* job, const std::exception_ptr& error,
+                 BoundedQueue<WindowJob>* next);
+
+private:
+    QuiverConfigTable configs_;
+    ConsensusPipelineOptions options_;
+    // The nodes the workers are spread over (1 unless pinned), and the
+    // queues between the stages, one per node
+    int numNodes_;
+    NodeQueues placed_;
+    NodeQueues refined_;
+    std::vector<std::thread> workers_;
+};
+
+ConsensusPipelineImpl::ConsensusPipelineImpl(const QuiverConfigTable& configs,
+                                             const ConsensusPipelineOptions& options)
+    : Windows(options.QueueCapacity)
+    , Results(options.QueueCapacity)
+    , configs_(configs)
+    , options_(options)
+    , numNodes_(1)
+    , placed_()
+    , refined_()
+    , workers_()
+{
+    if (options.PinToNumaNodes) {
+        numNodes_ = std::min(std::min(NumNumaNodes(), options.PoaWorkers),
+                             std::min(options.RefineWorkers, options.QvWorkers));
+    }
+    for (int node = 0; node < numNodes_; node++) {
+        placed_.push_back(std::unique_ptr<BoundedQueue<WindowJob> >(
+            new BoundedQueue<WindowJob>(options.QueueCapacity)));
+        refined_.push_back(std::unique_ptr<BoundedQueue<WindowJob> >(
+            new BoundedQueue<WindowJob>(options.QueueCapacity)));
+    }
+    StartStage(options.PoaWorkers, [this](int node) { PlaceWindows(node); }, [this] {
+        foreach (const std::unique_ptr<BoundedQueue<WindowJob> >& queue, placed_) {
+            queue->Close();
+        }
+    });
+    StartStage(options.RefineWorkers, [this](int node) { RefineWindows(node); }, [this] {
+        foreach (const std::unique_ptr<BoundedQueue<WindowJob> >& queue, refined_) {
+            queue->Close();
+        }
+    });
+    StartStage(options.QvWorkers, [this](int node) { ComputeQVs(node); },
+               [this] { Results.Close(); });
+}
+
+ConsensusPipelineImpl::~ConsensusPipelineImpl()
+{
+    Windows.Cancel();
+    for (int node = 0; node < numNodes_; node++) {
+        placed_[node]->Cancel();
+        refined_[node]->Cancel();
+    }
+    Results.Cancel();
+    foreach (std::thread& worker, workers_) {
+        worker.join();
+    }
+}
+
+void ConsensusPipelineImpl::StartStage(int numWorkers, const std::function<void(int)>& work,
+                                       const std::function<void()>& done)
+{
+    std::shared_ptr<std::atomic<int> > running(new std::atomic<int>(numWorkers));
+    for (int i = 0; i < numWorkers; i++) {
+        int node = i % numNodes_;
+        bool pin = options_.PinToNumaNodes;
+        workers_.push_back(std::thread([=] {
+            // Where pinning fails, the worker runs unpinned; the
+            // windows are still kept to their queues
+            if (pin) PinThreadToNumaNode(node);
+            work(node);
+            if (--*running == 0) done();
+        }));
+    }
+}
+
+void ConsensusPipelineImpl::Forward(WindowJob* job, const std::exception_ptr& error,
+                                    BoundedQueue<WindowJob>* next)
+{
+    if (error) {
+        job->Result.Error = ErrorMessage(error);
+        job->Scorer.reset();
+        Results.Push(std::move(job->Result));
+    } else {
+        int64_t limit = options_.HibernateAboveBytes;
+        if (limit > 0 && ProcessMemoryUsage().TotalBytes() > limit) {
+            job->Scorer->Hibernate();
+        }
+        next->Push(std::move(*job));
+    }
+}
+
+void ConsensusPipelineImpl::PlaceWindows(int node)
+{
+    ConsensusWindow window;
+    while (Windows.Pop(&window)) {
+        WindowJob job;
+        job.Result.Id = window.Id;
+        std::exception_ptr error;
+        try {
+            job.Scorer = Place(configs_, options_, window, &job.Result.NumReads);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        Forward(&job, error, placed_[node].get());
+    }
+}
+
+void ConsensusPipelineImpl::RefineWindows(int node)
+{
+    WindowJob job;
+    while (placed_[node]->Pop(&job)) {
+        std::exception_ptr error;
+        try {
+            job.Result.Converged = RefineConsensus(*job.Scorer, options_.Refine);
+            if (options_.MinDinucleotideRepeatElements > 0) {
+                RefineDinucleotideRepeats(*job.Scorer, options_.MinDinucleotideRepeatElements);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        Forward(&job, error, refined_[node].get());
+    }
+}
+
+void ConsensusPipelineImpl::ComputeQVs(int node)
+{
+    WindowJob job;
+    while (refined_[node]->Pop(&job)) {
+        try {
+            job.Result.QVs = ConsensusQVs(*job.Scorer);
+            job.Result.Sequence = job.Scorer->Template();
+        } catch (...) {
+            job.Result.QVs.clear();
+            job.Result.Error = ErrorMessage(std::current_exception());
+        }
+        job.Scorer.reset();
+        Results.Push(std::move(job.Result));
+    }
+}
+}  // namespace detail
+
+ConsensusPipeline::ConsensusPipeline(const QuiverConfigTable& configs,
+                                     const ConsensusPipelineOptions& options)
+    : impl_(NULL)
+{
+    if (options.PoaWorkers < 1 || options.RefineWorkers < 1 || options.QvWorkers < 1) {
+        throw InvalidInputError("ConsensusPipeline needs at least one worker per stage");
+    }
+    if (options.QueueCapacity < 1) {
+        throw InvalidInputError("ConsensusPipeline needs a queue capacity of at least 1");
+    }
+    impl_ = new detail::ConsensusPipelineImpl(configs, options);
+}
+
+ConsensusPipeline::~ConsensusPipeline() { delete impl_; }
+
+void ConsensusPipeline::Submit(const ConsensusWindow& window)
+{
+    if (!impl_->Windows.Push(window)) {
+        throw InvalidInputError("ConsensusPipeline is closed to new windows");
+    }
+}
+
+void ConsensusPipeline::Close() { impl_->Windows.Close(); }
+
+bool ConsensusPipeline::Next(ConsensusResult* result) { return impl_->Results.Pop(result); }
+
+ConsensusResult FindWindowConsensus(const QuiverConfigTable& configs,
+                                    const ConsensusWindow& window,
+                                    const ConsensusPipelineOptions& options)
+{
+    ConsensusResult result;
+    result.Id = window.Id;
+    try {
+        std::unique_ptr<SparseSseQvMultiReadMutationScorer> scorer =
+            Place(configs, options, window, &result.NumReads);
+        result.Converged = RefineConsensus(*scorer, options.Refine);
+        if (options.MinDinucleotideRepeatElements > 0) {
+            RefineDinucleotideRepeats(*scorer, options.MinDinucleotideRepeatElements);
+        }
+        result.QVs = ConsensusQVs(*scorer);
+        result.Sequence = scorer->Template();
+    } catch (...) {
+        std::string error = ErrorMessage(std::current_exception());
+        result = ConsensusResult();
+        result.Id = window.Id;
+        result.Error = error;
+    }
+    return result;
+}
+}
@@ -3,11 +3,16 @@
 #include <ConsensusCore/Quiver/Diploid.hpp>
 
 #include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/detail/SseMath.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
 
 #include <algorithm>
 #include <cassert>
 #include <cfloat>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <numeric>
 #include <utility>
@@ -56,7 +61,7 @@ float log1p(float x)
 namespace ConsensusCore {
 
 // This needs to be configurable.
-DEBUG_ONLY(const int MUTATIONS_PER_SITE = 9;)  // NOLINT
+const int MUTATIONS_PER_SITE = 9;
 const int LENGTH_DIFFS[] = {0, 0, 0, 0, 1, 1, 1, 1, -1};
 
 DiploidSite::DiploidSite(int allele0, int allele1, float logBayesFactor,
@@ -182,4 +187,123 @@ DiploidSite* IsSiteHeterozygous(const float* siteScores, int dim1, int dim2, flo
         return NULL;
     }
 }
+
+namespace {  // PRIVATE
+// The sum of x[i], four at a time
+float SumOver(const float* x, int n)
+{
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_add_ps(acc, _mm_loadu_ps(x + i));
+    }
+    ALIGN16_BEG float lanes[4] ALIGN16_END;
+    _mm_store_ps(lanes, acc);
+    float total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) {
+        total += x[i];
+    }
+    return total;
+}
+
+// The sum of logaddexp(x[i], y[i]), four at a time
+float SumOfLogAddExp(const float* x, const float* y, int n)
+{
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_add_ps(acc, detail::logAdd4(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    }
+    ALIGN16_BEG float lanes[4] ALIGN16_END;
+    _mm_store_ps(lanes, acc);
+    float total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) {
+        total += logaddexp(x[i], y[i]);
+    }
+    return total;
+}
+
+// Call site s of the batch, appending it to calls if heterozygous.
+// The likelihoods are those of HomozygousLogLikelihood and
+// HeterozygousLogLikelihood, over the site's scores where they lie.
+void CallSite(const float* siteScores, int s, int I, float logPriorRatio,
+              DiploidSiteCalls* calls)
+{
+    const int G = MUTATIONS_PER_SITE;
+    const float* S = siteScores + static_cast<int64_t>(s) * G * I;
+
+    float homScore = -FLT_MAX;
+    for (int g = 0; g < G; g++) {
+        homScore = logaddexp(homScore, SumOver(S + g * I, I));
+    }
+
+    float hetScore = -FLT_MAX;
+    float runningMax = -FLT_MAX;
+    int allele0 = -1, allele1 = -1;
+    for (int g0 = 0; g0 < G; g0++) {
+        for (int g1 = g0 + 1; g1 < G; g1++) {
+            if (LENGTH_DIFFS[g0] != LENGTH_DIFFS[g1]) continue;
+            float total = -I * std::log(2.0f) + SumOfLogAddExp(S + g0 * I, S + g1 * I, I);
+            hetScore = logaddexp(hetScore, total);
+            if (total > runningMax) {
+                runningMax = total;
+                allele0 = g0;
+                allele1 = g1;
+            }
+        }
+    }
+
+    float logBF = hetScore - homScore;
+    if (!(logBF - logPriorRatio > 0)) return;
+    calls->Sites.push_back(s);
+    calls->Allele0.push_back(allele0);
+    calls->Allele1.push_back(allele1);
+    calls->LogBayesFactors.push_back(logBF);
+    for (int i = 0; i < I; i++) {
+        calls->AlleleForRead.push_back(S[allele0 * I + i] > S[allele1 * I + i] ? 0 : 1);
+    }
+}
+
+void Append(DiploidSiteCalls* calls, const DiploidSiteCalls& other)
+{
+    calls->Sites.insert(calls->Sites.end(), other.Sites.begin(), other.Sites.end());
+    calls->Allele0.insert(calls->Allele0.end(), other.Allele0.begin(), other.Allele0.end());
+    calls->Allele1.insert(calls->Allele1.end(), other.Allele1.begin(), other.Allele1.end());
+    calls->LogBayesFactors.insert(calls->LogBayesFactors.end(), other.LogBayesFactors.begin(),
+                                  other.LogBayesFactors.end());
+    calls->AlleleForRead.insert(calls->AlleleForRead.end(), other.AlleleForRead.begin(),
+                                other.AlleleForRead.end());
+}
+}  // PRIVATE
+
+DiploidSiteCalls CallHeterozygousSites(const float* siteScores, int numSites, int numMutations,
+                                       int numReads, float logPriorRatio, int numThreads)
+{
+    if (numMutations != MUTATIONS_PER_SITE) {
+        throw InvalidInputError("Diploid site calling takes 9 mutations a site");
+    }
+    if (numSites < 0 || numReads < 0) {
+        throw InvalidInputError("Numbers of sites and reads must not be negative");
+    }
+
+    // The sites are dealt to the pool in contiguous chunks, several per
+    // thread to even out the load, and each chunk's calls are joined
+    // to the others in order at the end
+    DiploidSiteCalls calls;
+    calls.NumReads = numReads;
+    if (numSites == 0) return calls;
+    const int numChunks = std::min(numSites, 4 * std::max(numThreads, 1));
+    std::vector<DiploidSiteCalls> chunks(numChunks);
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(numChunks, [&](int c) {
+        for (int s = (int64_t(numSites) * c) / numChunks;
+             s < (int64_t(numSites) * (c + 1)) / numChunks; s++) {
+            CallSite(siteScores, s, numReads, logPriorRatio, &chunks[c]);
+        }
+    });
+    foreach (const DiploidSiteCalls& chunk, chunks) {
+        Append(&calls, chunk);
+    }
+    return calls;
+}
 }
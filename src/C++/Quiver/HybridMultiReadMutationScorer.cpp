@@ -0,0 +1,327 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/HybridMultiReadMutationScorer.hpp>
+
+#include <boost/format.hpp>
+#include <string>
+#include <vector>
+
+namespace ConsensusCore {
+
+HybridMultiReadMutationScorer::HybridMultiReadMutationScorer(
+    const QuiverConfigTable& paramsByChemistry, std::string tpl, float screenTolerance)
+    : viterbi_(paramsByChemistry, tpl), sumProduct_(paramsByChemistry, tpl), screenTolerance_(0)
+{
+    SetScreenTolerance(screenTolerance);
+}
+
+HybridMultiReadMutationScorer::HybridMultiReadMutationScorer(
+    const HybridMultiReadMutationScorer& other)
+    : viterbi_(other.viterbi_)
+    , sumProduct_(other.sumProduct_)
+    , screenTolerance_(other.screenTolerance_)
+{
+}
+
+HybridMultiReadMutationScorer::~HybridMultiReadMutationScorer() {}
+
+void HybridMultiReadMutationScorer::SetScreenTolerance(float screenTolerance)
+{
+    // A negative tolerance would let a screened-out score clear the
+    // favorability bar
+    if (screenTolerance < 0) {
+        throw InvalidInputError("Screen tolerance must not be negative");
+    }
+    screenTolerance_ = screenTolerance;
+}
+
+float HybridMultiReadMutationScorer::ScreenTolerance() const { return screenTolerance_; }
+
+const SparseSseQvMultiReadMutationScorer& HybridMultiReadMutationScorer::ViterbiScorer() const
+{
+    return viterbi_;
+}
+
+const SparseSseQvSumProductMultiReadMutationScorer&
+HybridMultiReadMutationScorer::SumProductScorer() const
+{
+    return sumProduct_;
+}
+
+bool HybridMultiReadMutationScorer::PassesScreen(float viterbiScore) const
+{
+    return viterbiScore > MIN_FAVORABLE_SCOREDIFF - screenTolerance_;
+}
+
+int HybridMultiReadMutationScorer::TemplateLength() const { return sumProduct_.TemplateLength(); }
+
+int HybridMultiReadMutationScorer::NumReads() const { return sumProduct_.NumReads(); }
+
+const MappedRead* HybridMultiReadMutationScorer::Read(int readIndex) const
+{
+    return sumProduct_.Read(readIndex);
+}
+
+std::string HybridMultiReadMutationScorer::Template(StrandEnum strand) const
+{
+    return sumProduct_.Template(strand);
+}
+
+std::string HybridMultiReadMutationScorer::Template(StrandEnum strand, int templateStart,
+                                                    int templateEnd) const
+{
+    return sumProduct_.Template(strand, templateStart, templateEnd);
+}
+
+void HybridMultiReadMutationScorer::ApplyMutations(const std::vector<Mutation>& mutations)
+{
+    viterbi_.ApplyMutations(mutations);
+    sumProduct_.ApplyMutations(mutations);
+}
+
+uint64_t HybridMultiReadMutationScorer::TemplateVersion() const
+{
+    return sumProduct_.TemplateVersion();
+}
+
+uint64_t HybridMultiReadMutationScorer::TemplateFingerprint() const
+{
+    return sumProduct_.TemplateFingerprint();
+}
+
+bool HybridMultiReadMutationScorer::AddRead(const MappedRead& mappedRead, float threshold)
+{
+    viterbi_.AddRead(mappedRead, threshold);
+    return sumProduct_.AddRead(mappedRead, threshold);
+}
+
+bool HybridMultiReadMutationScorer::AddRead(const MappedRead& mappedRead)
+{
+    viterbi_.AddRead(mappedRead);
+    return sumProduct_.AddRead(mappedRead);
+}
+
+float HybridMultiReadMutationScorer::Score(const Mutation& m) const { return sumProduct_.Score(m); }
+
+float HybridMultiReadMutationScorer::FastScore(const Mutation& m) const
+{
+    float viterbiScore = viterbi_.FastScore(m);
+    return PassesScreen(viterbiScore) ? sumProduct_.FastScore(m) : viterbiScore;
+}
+
+std::vector<float> HybridMultiReadMutationScorer::Scores(const Mutation& m,
+                                                         float unscoredValue) const
+{
+    return sumProduct_.Scores(m, unscoredValue);
+}
+
+bool HybridMultiReadMutationScorer::IsFavorable(const Mutation& m) const
+{
+    return sumProduct_.IsFavorable(m);
+}
+
+bool HybridMultiReadMutationScorer::FastIsFavorable(const Mutation& m) const
+{
+    return PassesScreen(viterbi_.FastScore(m)) && sumProduct_.FastIsFavorable(m);
+}
+
+std::vector<float> HybridMultiReadMutationScorer::ScoreMany(
+    const std::vector<Mutation>& mutations) const
+{
+    return sumProduct_.ScoreMany(mutations);
+}
+
+std::vector<float> HybridMultiReadMutationScorer::FastScoreMany(
+    const std::vector<Mutation>& mutations) const
+{
+    std::vector<float> scores = viterbi_.FastScoreMany(mutations);
+    std::vector<Mutation> survivors;
+    std::vector<int> survivorIdx;
+    for (int i = 0; i < static_cast<int>(mutations.size()); i++) {
+        if (PassesScreen(scores[i])) {
+            survivors.push_back(mutations[i]);
+            survivorIdx.push_back(i);
+        }
+    }
+    std::vector<float> survivorScores = sumProduct_.FastScoreMany(survivors);
+    for (int k = 0; k < static_cast<int>(survivors.size()); k++) {
+        scores[survivorIdx[k]] = survivorScores[k];
+    }
+    return scores;
+}
+
+std::vector<float> HybridMultiReadMutationScorer::ScoresMany(const std::vector<Mutation>& mutations,
+                                                             float unscoredValue) const
+{
+    return sumProduct_.ScoresMany(mutations, unscoredValue);
+}
+
+void HybridMultiReadMutationScorer::ScoresManyInto(const std::vector<Mutation>& mutations,
+                                                   float unscoredValue, float* scores,
+                                                   int nMutations, int nReads) const
+{
+    sumProduct_.ScoresManyInto(mutations, unscoredValue, scores, nMutations, nReads);
+}
+
+std::vector<int> HybridMultiReadMutationScorer::AllocatedMatrixEntries() const
+{
+    std::vector<int> entries = sumProduct_.AllocatedMatrixEntries();
+    std::vector<int> viterbiEntries = viterbi_.AllocatedMatrixEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i] += viterbiEntries[i];
+    }
+    return entries;
+}
+
+std::vector<int> HybridMultiReadMutationScorer::UsedMatrixEntries() const
+{
+    std::vector<int> entries = sumProduct_.UsedMatrixEntries();
+    std::vector<int> viterbiEntries = viterbi_.UsedMatrixEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i] += viterbiEntries[i];
+    }
+    return entries;
+}
+
+MemoryUsage HybridMultiReadMutationScorer::Memory() const
+{
+    MemoryUsage usage = sumProduct_.Memory();
+    MemoryUsage viterbiUsage = viterbi_.Memory();
+    usage.MatrixBytes += viterbiUsage.MatrixBytes;
+    usage.FeatureBytes += viterbiUsage.FeatureBytes;
+    usage.ScorerBytes += viterbiUsage.ScorerBytes;
+
+    // The scorers' copies of a read share its features
+    for (int i = 0; i < viterbi_.NumReads(); i++) {
+        const MappedRead* mr = viterbi_.Read(i);
+        if (mr != NULL && sumProduct_.Read(i) != NULL) {
+            usage.FeatureBytes -= mr->Features.AllocatedBytes();
+        }
+    }
+    return usage;
+}
+
+const AbstractMatrix* HybridMultiReadMutationScorer::AlphaMatrix(int i) const
+{
+    return sumProduct_.AlphaMatrix(i);
+}
+
+const AbstractMatrix* HybridMultiReadMutationScorer::BetaMatrix(int i) const
+{
+    return sumProduct_.BetaMatrix(i);
+}
+
+std::vector<int> HybridMultiReadMutationScorer::NumFlipFlops() const
+{
+    return sumProduct_.NumFlipFlops();
+}
+
+std::vector<FillStatistics> HybridMultiReadMutationScorer::FillStats() const
+{
+    return sumProduct_.FillStats();
+}
+
+std::vector<CompactAlignment> HybridMultiReadMutationScorer::Alignments() const
+{
+    return viterbi_.Alignments();
+}
+
+void HybridMultiReadMutationScorer::SetNumThreads(int numThreads)
+{
+    if (numThreads <= 1) {
+        viterbi_.SetNumThreads(1);
+        sumProduct_.SetNumThreads(1);
+    } else if (NumThreads() != numThreads) {
+        SetThreadPool(boost::shared_ptr<ThreadPool>(new ThreadPool(numThreads)));
+    }
+}
+
+int HybridMultiReadMutationScorer::NumThreads() const { return sumProduct_.NumThreads(); }
+
+void HybridMultiReadMutationScorer::SetThreadPool(const boost::shared_ptr<ThreadPool>& pool)
+{
+    viterbi_.SetThreadPool(pool);
+    sumProduct_.SetThreadPool(pool);
+}
+
+void HybridMultiReadMutationScorer::SetMemoryBudget(int64_t bytes)
+{
+    viterbi_.SetMemoryBudget(bytes);
+    sumProduct_.SetMemoryBudget(bytes);
+}
+
+int64_t HybridMultiReadMutationScorer::MemoryBudget() const { return sumProduct_.MemoryBudget(); }
+
+std::vector<int> HybridMultiReadMutationScorer::DroppedReads() const
+{
+    return sumProduct_.DroppedReads();
+}
+
+void HybridMultiReadMutationScorer::SetCoverageCap(int maxCoverage)
+{
+    viterbi_.SetCoverageCap(maxCoverage);
+    sumProduct_.SetCoverageCap(maxCoverage);
+}
+
+int HybridMultiReadMutationScorer::CoverageCap() const { return sumProduct_.CoverageCap(); }
+
+int HybridMultiReadMutationScorer::AddReads(const std::vector<MappedRead>& mappedReads)
+{
+    viterbi_.AddReads(mappedReads);
+    return sumProduct_.AddReads(mappedReads);
+}
+
+std::vector<int> HybridMultiReadMutationScorer::StandbyReads() const
+{
+    return sumProduct_.StandbyReads();
+}
+
+void HybridMultiReadMutationScorer::SetScoreCaching(bool cacheScores)
+{
+    viterbi_.SetScoreCaching(cacheScores);
+    sumProduct_.SetScoreCaching(cacheScores);
+}
+
+bool HybridMultiReadMutationScorer::ScoreCaching() const { return sumProduct_.ScoreCaching(); }
+
+void HybridMultiReadMutationScorer::Hibernate()
+{
+    viterbi_.Hibernate();
+    sumProduct_.Hibernate();
+}
+
+void HybridMultiReadMutationScorer::Wake()
+{
+    viterbi_.Wake();
+    sumProduct_.Wake();
+}
+
+bool HybridMultiReadMutationScorer::IsHibernating() const
+{
+    return viterbi_.IsHibernating() || sumProduct_.IsHibernating();
+}
+
+float HybridMultiReadMutationScorer::Score(MutationType mutationType, int position, char base) const
+{
+    return sumProduct_.Score(mutationType, position, base);
+}
+
+std::vector<float> HybridMultiReadMutationScorer::Scores(MutationType mutationType, int position,
+                                                         char base, float unscoredValue) const
+{
+    return sumProduct_.Scores(mutationType, position, base, unscoredValue);
+}
+
+float HybridMultiReadMutationScorer::BaselineScore() const { return sumProduct_.BaselineScore(); }
+
+std::vector<float> HybridMultiReadMutationScorer::BaselineScores() const
+{
+    return sumProduct_.BaselineScores();
+}
+
+std::string HybridMultiReadMutationScorer::ToString() const
+{
+    return (boost::format("Screen tolerance: %0.2f\n") % screenTolerance_).str() +
+           sumProduct_.ToString();
+}
+}
@@ -0,0 +1,209 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/Int16Recursor.hpp>
+
+#include <emmintrin.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+
+#define FLOOR SHRT_MIN
+#define CEILING SHRT_MAX
+
+namespace ConsensusCore {
+
+const int Int16ViterbiRecursor::Scale;
+
+namespace {  // PRIVATE
+
+// One alpha column: the scores of rows [begin, end), stored in units
+// of 1/Scale, relative to base.
+struct Column
+{
+    std::vector<int16_t> values;
+    int begin;
+    int end;
+    int base;
+    int max;
+};
+
+inline int Saturate(int v) { return std::min(std::max(v, FLOOR), CEILING); }
+
+inline int Quantize(float v)
+{
+    float scaled = v * Int16ViterbiRecursor::Scale;
+    if (scaled <= FLOOR) return FLOOR;
+    if (scaled >= CEILING) return CEILING;
+    return static_cast<int>(lrintf(scaled));
+}
+
+inline __m128i Quantize8(__m128 lo, __m128 hi)
+{
+    // Rounds to nearest like lrintf; -FLT_MAX overflows to INT_MIN,
+    // which the saturating pack takes to FLOOR.
+    const __m128 scale = _mm_set1_ps(Int16ViterbiRecursor::Scale);
+    return _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(lo, scale)),
+                           _mm_cvtps_epi32(_mm_mul_ps(hi, scale)));
+}
+
+inline int At(const Column& c, int i)
+{
+    return (i >= c.begin && i < c.end) ? c.values[i - c.begin] : FLOOR;
+}
+
+// Shift a score of column c to be relative to base; FLOOR is kept,
+// as it stands for an unreachable cell.
+inline int Rebase(int v, const Column& c, int base)
+{
+    return v == FLOOR ? FLOOR : Saturate(v + c.base - base);
+}
+
+inline __m128i Rebase8(__m128i v, const Column& c, int base)
+{
+    __m128i shifted = _mm_adds_epi16(v, _mm_set1_epi16(Saturate(c.base - base)));
+    __m128i isFloor = _mm_cmpeq_epi16(v, _mm_set1_epi16(FLOOR));
+    return _mm_or_si128(_mm_and_si128(isFloor, v), _mm_andnot_si128(isFloor, shifted));
+}
+
+inline __m128i At8(const Column& c, int i, int base)
+{
+    __m128i v;
+    if (i >= c.begin && i + 8 <= c.end) {
+        v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&c.values[i - c.begin]));
+    } else {
+        int16_t buf[8];
+        for (int k = 0; k < 8; k++) {
+            buf[k] = At(c, i + k);
+        }
+        v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+    }
+    return Rebase8(v, c, base);
+}
+}
+
+Int16ViterbiRecursor::Int16ViterbiRecursor(int movesAvailable, const BandingOptions& banding)
+    : movesAvailable_(movesAvailable), bandingOptions_(banding)
+{
+}
+
+float Int16ViterbiRecursor::Score(const QvEvaluator& e) const
+{
+    int I = e.ReadLength();
+    int J = e.TemplateLength();
+    int scoreDiff = Quantize(bandingOptions_.ScoreDiff);
+
+    // The recursion reaches back at most two columns (for merges)
+    Column columns[3];
+    int hintBeginRow = 0, hintEndRow = 0;
+
+    for (int j = 0; j <= J; ++j) {
+        Column& cur = columns[j % 3];
+        const Column* prev = (j >= 1) ? &columns[(j - 1) % 3] : NULL;
+        const Column* prev2 = (j >= 2) ? &columns[(j - 2) % 3] : NULL;
+
+        cur.values.clear();
+        cur.begin = cur.end = hintBeginRow;
+        cur.base =
+            (prev == NULL || prev->max == FLOOR) ? (prev ? prev->base : 0) : prev->base + prev->max;
+        cur.max = FLOOR;
+
+        int requiredEndRow = std::min(I + 1, hintEndRow);
+        int score = FLOOR;
+        int thresholdScore = FLOOR;
+        int maxScore = FLOOR;
+
+        // Leading rows one at a time, as in SimdRecursor::FillAlpha,
+        // until a multiple of eight rows remains.
+        int i;
+        for (i = cur.begin; (i == 0 || (I - i + 1) % 8 != 0) && i <= I; i++) {
+            score = FLOOR;
+            if (i == 0 && j == 0) {
+                score = -cur.base;
+            }
+            if (i > 0 && j > 0) {
+                score = std::max(score, Saturate(Rebase(At(*prev, i - 1), *prev, cur.base) +
+                                                 Quantize(e.Inc(i - 1, j - 1))));
+            }
+            if ((movesAvailable_ & MERGE) && (i > 0 && j > 1)) {
+                score = std::max(score, Saturate(Rebase(At(*prev2, i - 1), *prev2, cur.base) +
+                                                 Quantize(e.Merge(i - 1, j - 2))));
+            }
+            if (j > 0) {
+                score = std::max(score, Saturate(Rebase(At(*prev, i), *prev, cur.base) +
+                                                 Quantize(e.Del(i, j - 1))));
+            }
+            if (i > 0) {
+                score = std::max(score, Saturate(At(cur, i - 1) + Quantize(e.Extra(i - 1, j))));
+            }
+            cur.values.push_back(score);
+            cur.end++;
+
+            if (score > maxScore) {
+                maxScore = score;
+                thresholdScore = maxScore - scoreDiff;
+            }
+        }
+
+        // Main SIMD loop, eight rows at a time
+        for (; i <= I && (score >= thresholdScore || i < requiredEndRow); i += 8) {
+            __m128i score8 = _mm_set1_epi16(FLOOR);
+            if (j > 0) {
+                __m128i inc = Quantize8(e.Inc4(i - 1, j - 1), e.Inc4(i + 3, j - 1));
+                score8 = _mm_max_epi16(score8, _mm_adds_epi16(At8(*prev, i - 1, cur.base), inc));
+            }
+            if ((movesAvailable_ & MERGE) && j >= 2) {
+                __m128i merge = Quantize8(e.Merge4(i - 1, j - 2), e.Merge4(i + 3, j - 2));
+                score8 = _mm_max_epi16(score8, _mm_adds_epi16(At8(*prev2, i - 1, cur.base), merge));
+            }
+            if (j > 0) {
+                __m128i del = Quantize8(e.Del4(i, j - 1), e.Del4(i + 4, j - 1));
+                score8 = _mm_max_epi16(score8, _mm_adds_epi16(At8(*prev, i, cur.base), del));
+            }
+
+            // Extra (non-SIMD cascade)
+            int16_t extra_[8], scores_[8];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(extra_),
+                             Quantize8(e.Extra4(i - 1, j), e.Extra4(i + 3, j)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(scores_), score8);
+
+            int above = At(cur, i - 1);
+            int potentialNewMax = FLOOR;
+            score = CEILING;
+            for (int k = 0; k < 8; k++) {
+                int v = std::max<int>(scores_[k], Saturate(above + extra_[k]));
+                cur.values.push_back(v);
+                above = v;
+                potentialNewMax = std::max(potentialNewMax, v);
+                score = std::min(score, v);
+            }
+            cur.end += 8;
+
+            if (potentialNewMax > maxScore) {
+                maxScore = potentialNewMax;
+                thresholdScore = maxScore - scoreDiff;
+            }
+        }
+        cur.max = maxScore;
+
+        // Revise the hints to where the mass of the column lived
+        hintEndRow = cur.end;
+        for (i = cur.begin; i < cur.end && At(cur, i) < thresholdScore; ++i)
+            ;
+        hintBeginRow = i;
+    }
+
+    const Column& last = columns[J % 3];
+    int end = At(last, I);
+    if (end == FLOOR) {
+        return -FLT_MAX;
+    }
+    return static_cast<float>(end + last.base) / Scale;
+}
+}
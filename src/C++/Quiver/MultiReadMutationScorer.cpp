@@ -1,30 +1,69 @@
 // Author: David Alexander
 
-#include <ConsensusCore/Checksum.hpp>
+#include <ConsensusCore/Coverage.hpp>
 #include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/Quiver/Capture.hpp>
 #include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
 #include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/WorkUnit.hpp>
 #include <ConsensusCore/Sequence.hpp>
 #include <ConsensusCore/Utils.hpp>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <boost/format.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits.hpp>
 #include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
-#define MIN_FAVORABLE_SCOREDIFF 0.04f  // Chosen such that 0.49 = 1 / (1 + exp(minScoreDiff))
+#include "Sections.hpp"
+
+// Work granularity when scoring across a thread pool: reads are split
+// into CHUNKS_PER_THREAD contiguous chunks per thread, and the fast
+// rejection paths score READS_PER_THREAD_PER_WAVE reads per thread
+// before checking whether the running sum allows an early exit.
+#define CHUNKS_PER_THREAD 4
+#define READS_PER_THREAD_PER_WAVE 4
+
+// Bound on the number of mutations scored together by the batched
+// entry points, which bounds their scratch space.
+#define MUTATIONS_PER_BLOCK 1024
+
+// When more than 1/DENSE_READS_FRACTION of the reads may meet an
+// interval, ReadsNear scans all reads in order rather than sorting
+// the candidates found through the index.
+#define DENSE_READS_FRACTION 4
+
+// The batched entry points score disjoint stretches of the template
+// concurrently when there are at least this many stretches per thread
+#define MIN_STRIPES_PER_THREAD 2
+
+// Bound on the scores cached for a read, per base of its template
+// slice: enough for every single base mutation of the slice, after
+// which the cache starts over.
+#define MAX_CACHED_SCORES_PER_BASE 10
 
 namespace ConsensusCore {
+namespace {  // PRIVATE
 //
-// Could the mutation change the contents of the portion of the
-// template that is mapped to the read?
+// ReadScoresMutation and OrientedMutation for a read mapped to template
+// extent [ts, te), on the reverse strand if reverse is set
 //
-bool ReadScoresMutation(const MappedRead& read, const Mutation& mut)
+bool ExtentScoresMutation(int ts, int te, const Mutation& mut)
 {
-    int ts = read.TemplateStart;
-    int te = read.TemplateEnd;
     int ms = mut.Start();
     int me = mut.End();
     if (mut.IsInsertion()) {
@@ -34,45 +73,208 @@ bool ReadScoresMutation(const MappedRead& read, const Mutation& mut)
     }
 }
 
-//
-// Logic for turning a mutation to the global template space to
-// one in the coordinates understood by each individual mutation
-// scorer.  This involves translation, complementation, and also
-// possible clipping, if the mutation is not wholly within the
-// mapped read.
-//
-Mutation OrientedMutation(const MappedRead& mr, const Mutation& mut)
+Mutation OrientToExtent(bool reverse, int ts, int te, const Mutation& mut)
 {
     using std::min;
     using std::max;
 
     // Clip mutation to bounds of mapped read, so that overhanging
     // multibase changes are handled correctly
-    Mutation cmut(INSERTION, 0, 0, "N");
-    if (mut.End() - mut.Start() > 1) {
-        int cs, ce;
-        cs = max(mut.Start(), mr.TemplateStart);
-        ce = min(mut.End(), mr.TemplateEnd);
+    int start = mut.Start();
+    int end = mut.End();
+    const char* bases = mut.NewBasesData();
+    int nBases = mut.NewBasesLength();
+    if (end - start > 1) {
+        int cs = max(start, ts);
+        int ce = min(end, te);
         if (mut.IsSubstitution()) {
-            std::string cNewBases = mut.NewBases().substr(cs - mut.Start(), ce - cs);
-            cmut = Mutation(mut.Type(), cs, ce, cNewBases);
-        } else {
-            cmut = Mutation(mut.Type(), cs, ce, mut.NewBases());
+            bases += cs - start;
+            nBases = ce - cs;
         }
-    } else {
-        cmut = mut;
+        start = cs;
+        end = ce;
     }
 
     // Now orient
-    if (mr.Strand == FORWARD_STRAND) {
-        return Mutation(cmut.Type(), cmut.Start() - mr.TemplateStart, cmut.End() - mr.TemplateStart,
-                        cmut.NewBases());
+    if (!reverse) {
+        return Mutation(mut.Type(), start - ts, end - ts, bases, nBases);
     } else {
         // This is tricky business
-        int end = mr.TemplateEnd - cmut.Start();
-        int start = mr.TemplateEnd - cmut.End();
-        return Mutation(cmut.Type(), start, end, ReverseComplement(cmut.NewBases()));
+        int rcStart = te - end;
+        int rcEnd = te - start;
+        // Complement the bases on the stack unless there are many
+        char rcInline[8];
+        std::string rcHeap;
+        char* rc = rcInline;
+        if (nBases > static_cast<int>(sizeof(rcInline))) {
+            rcHeap.resize(nBases);
+            rc = &rcHeap[0];
+        }
+        ReverseComplement(bases, nBases, rc);
+        return Mutation(mut.Type(), rcStart, rcEnd, rc, nBases);
+    }
+}
+}  // PRIVATE
+
+//
+// Could the mutation change the contents of the portion of the
+// template that is mapped to the read?
+//
+bool ReadScoresMutation(const MappedRead& read, const Mutation& mut)
+{
+    return ExtentScoresMutation(read.TemplateStart, read.TemplateEnd, mut);
+}
+
+//
+// Logic for turning a mutation to the global template space to
+// one in the coordinates understood by each individual mutation
+// scorer.  This involves translation, complementation, and also
+// possible clipping, if the mutation is not wholly within the
+// mapped read.
+//
+Mutation OrientedMutation(const MappedRead& mr, const Mutation& mut)
+{
+    return OrientToExtent(mr.Strand == REVERSE_STRAND, mr.TemplateStart, mr.TemplateEnd, mut);
+}
+
+namespace {  // PRIVATE
+// A copy of v, allocated with malloc, for numpy to take over
+template <typename T>
+void MallocCopy(const std::vector<T>& v, T** array, int* n)
+{
+    *n = v.size();
+    *array = static_cast<T*>(malloc(std::max<size_t>(1, v.size()) * sizeof(T)));
+    std::copy(v.begin(), v.end(), *array);
+}
+
+// The mutations given as parallel arrays, for the *ManyArrays entry
+// points
+std::vector<Mutation> MutationsFromArrays(int nTypes, const int* types, int nStarts,
+                                          const int* starts, int nEnds, const int* ends,
+                                          int nCounts, const int* baseCounts,
+                                          const std::string& newBases)
+{
+    if (nStarts != nTypes || nEnds != nTypes || nCounts != nTypes) {
+        throw InvalidInputError("Mutation arrays must be of one length");
+    }
+    std::vector<Mutation> mutations;
+    mutations.reserve(nTypes);
+    size_t used = 0;
+    for (int i = 0; i < nTypes; i++) {
+        if (types[i] < INSERTION || types[i] > SUBSTITUTION || starts[i] > ends[i] ||
+            baseCounts[i] < 0 || used + baseCounts[i] > newBases.length()) {
+            throw InvalidInputError("Invalid mutation in arrays");
+        }
+        mutations.push_back(Mutation(static_cast<MutationType>(types[i]), starts[i], ends[i],
+                                     newBases.data() + used, baseCounts[i]));
+        used += baseCounts[i];
+    }
+    if (used != newBases.length()) {
+        throw InvalidInputError("Mutation arrays must account for every new base");
+    }
+    return mutations;
+}
+}
+
+void AbstractMultiReadMutationScorer::ScoreManyArrays(int nTypes, int* types, int nStarts,
+                                                      int* starts, int nEnds, int* ends,
+                                                      int nCounts, int* baseCounts,
+                                                      const std::string& newBases, float* scores,
+                                                      int nScores) const
+{
+    std::vector<Mutation> mutations = MutationsFromArrays(nTypes, types, nStarts, starts, nEnds,
+                                                          ends, nCounts, baseCounts, newBases);
+    if (nScores != nTypes) throw InvalidInputError("Scores array must be one per mutation");
+    std::vector<float> sums = ScoreMany(mutations);
+    std::copy(sums.begin(), sums.end(), scores);
+}
+
+void AbstractMultiReadMutationScorer::FastScoreManyArrays(int nTypes, int* types, int nStarts,
+                                                          int* starts, int nEnds, int* ends,
+                                                          int nCounts, int* baseCounts,
+                                                          const std::string& newBases,
+                                                          float* scores, int nScores) const
+{
+    std::vector<Mutation> mutations = MutationsFromArrays(nTypes, types, nStarts, starts, nEnds,
+                                                          ends, nCounts, baseCounts, newBases);
+    if (nScores != nTypes) throw InvalidInputError("Scores array must be one per mutation");
+    std::vector<float> sums = FastScoreMany(mutations);
+    std::copy(sums.begin(), sums.end(), scores);
+}
+
+void AbstractMultiReadMutationScorer::ScoresManyArrays(int nTypes, int* types, int nStarts,
+                                                       int* starts, int nEnds, int* ends,
+                                                       int nCounts, int* baseCounts,
+                                                       const std::string& newBases,
+                                                       float unscoredValue, float* scores,
+                                                       int nMutations, int nReads) const
+{
+    std::vector<Mutation> mutations = MutationsFromArrays(nTypes, types, nStarts, starts, nEnds,
+                                                          ends, nCounts, baseCounts, newBases);
+    ScoresManyInto(mutations, unscoredValue, scores, nMutations, nReads);
+}
+
+void AbstractMultiReadMutationScorer::ScoresArray(const Mutation& m, float unscoredValue,
+                                                  float** scores, int* nScores) const
+{
+    MallocCopy(Scores(m, unscoredValue), scores, nScores);
+}
+
+void AbstractMultiReadMutationScorer::BaselineScoresArray(float** scores, int* nScores) const
+{
+    MallocCopy(BaselineScores(), scores, nScores);
+}
+
+void AbstractMultiReadMutationScorer::AllocatedMatrixEntriesArray(int** entries,
+                                                                  int* nEntries) const
+{
+    MallocCopy(AllocatedMatrixEntries(), entries, nEntries);
+}
+
+void AbstractMultiReadMutationScorer::UsedMatrixEntriesArray(int** entries, int* nEntries) const
+{
+    MallocCopy(UsedMatrixEntries(), entries, nEntries);
+}
+
+namespace {  // PRIVATE
+//
+// The reverse strand of a template after mutations are applied to its
+// forward strand, assembled from the stretches of the old reverse
+// strand that they leave alone rather than by complementing the whole
+// new template.  The mutations must be sorted and must not overlap.
+//
+std::string EditReverseStrand(const std::vector<Mutation>& sortedMuts, const std::string& oldRev,
+                              int newLength)
+{
+    int oldLength = oldRev.length();
+    std::string rev;
+    rev.reserve(newLength);
+    // Walk the forward strand from its end; the forward template from
+    // pos onwards has been laid down
+    int pos = oldLength;
+    for (int k = sortedMuts.size() - 1; k >= 0; k--) {
+        const Mutation& m = sortedMuts[k];
+        rev.append(oldRev, oldLength - pos, pos - m.End());
+        int at = rev.length();
+        rev.resize(at + m.NewBasesLength());
+        ReverseComplement(m.NewBasesData(), m.NewBasesLength(), &rev[at]);
+        pos = m.Start();
+    }
+    rev.append(oldRev, oldLength - pos, pos);
+    return rev;
+}
+
+// Set positions to the positions in reads, ordered by the read indices
+// they hold
+void PositionsByRead(const std::vector<int>& reads, std::vector<int>* positions)
+{
+    positions->resize(reads.size());
+    for (int k = 0; k < static_cast<int>(reads.size()); k++) {
+        (*positions)[k] = k;
     }
+    std::sort(positions->begin(), positions->end(),
+              [&](int a, int b) { return reads[a] < reads[b]; });
+}
 }
 
 template <typename R>
@@ -81,7 +283,27 @@ MultiReadMutationScorer<R>::MultiReadMutationScorer(
     : quiverConfigByChemistry_(quiverConfigByChemistry)
     , fwdTemplate_(tpl)
     , revTemplate_(ReverseComplement(tpl))
+    , templateVersion_(0)
+    , templateFingerprint_(ConsensusCore::TemplateFingerprint(tpl))
     , reads_()
+    , readIndices_()
+    , numReadsAdded_(0)
+    , readsByStart_()
+    , readStarts_()
+    , maxReadExtent_(0)
+    , rejectPriority_()
+    , isActive_()
+    , isReverse_()
+    , extentStarts_()
+    , extentEnds_()
+    , baselineScores_()
+    , memoryBudget_(0)
+    , droppedReads_()
+    , coverageCap_(0)
+    , standbys_()
+    , cacheScores_(true)
+    , scorerCache_()
+    , hibernating_(false)
 {
     DEBUG_ONLY(CheckInvariants());
     fastScoreThreshold_ = 0;
@@ -89,6 +311,7 @@ MultiReadMutationScorer<R>::MultiReadMutationScorer(
     for (it = quiverConfigByChemistry_.begin(); it != quiverConfigByChemistry_.end(); it++) {
         fastScoreThreshold_ = std::min(fastScoreThreshold_, it->second.FastScoreThreshold);
     }
+    if (CAPTURE_THIS_CALL()) detail::CaptureScorer(this, quiverConfigByChemistry_, tpl);
 }
 
 template <typename R>
@@ -97,10 +320,31 @@ MultiReadMutationScorer<R>::MultiReadMutationScorer(const MultiReadMutationScore
     , fastScoreThreshold_(other.fastScoreThreshold_)
     , fwdTemplate_(other.fwdTemplate_)
     , revTemplate_(other.revTemplate_)
+    , templateVersion_(other.templateVersion_)
+    , templateFingerprint_(other.templateFingerprint_)
     , reads_()
+    , readIndices_(other.readIndices_)
+    , numReadsAdded_(other.numReadsAdded_)
+    , threadPool_(other.threadPool_)
+    , readsByStart_(other.readsByStart_)
+    , readStarts_(other.readStarts_)
+    , maxReadExtent_(other.maxReadExtent_)
+    , rejectPriority_(other.rejectPriority_)
+    , isActive_(other.isActive_)
+    , isReverse_(other.isReverse_)
+    , extentStarts_(other.extentStarts_)
+    , extentEnds_(other.extentEnds_)
+    , baselineScores_(other.baselineScores_)
+    , memoryBudget_(other.memoryBudget_)
+    , droppedReads_(other.droppedReads_)
+    , coverageCap_(other.coverageCap_)
+    , standbys_(other.standbys_)
+    , cacheScores_(other.cacheScores_)
+    , scorerCache_(other.scorerCache_)
+    , hibernating_(other.hibernating_)
 {
     // Make a deep copy of the readsAndScorers
-    foreach (const ReadStateType& read, reads_) {
+    foreach (const ReadStateType& read, other.reads_) {
         reads_.push_back(ReadStateType(read));
     }
 
@@ -110,6 +354,8 @@ MultiReadMutationScorer<R>::MultiReadMutationScorer(const MultiReadMutationScore
 template <typename R>
 MultiReadMutationScorer<R>::~MultiReadMutationScorer()
 {
+    // Even within a captured call, so a captured scorer is forgotten
+    if (detail::capturing.load(std::memory_order_relaxed)) detail::CaptureDestruction(this);
 }
 
 template <typename R>
@@ -121,13 +367,14 @@ int MultiReadMutationScorer<R>::TemplateLength() const
 template <typename R>
 int MultiReadMutationScorer<R>::NumReads() const
 {
-    return reads_.size();
+    return numReadsAdded_;
 }
 
 template <typename R>
-const MappedRead* MultiReadMutationScorer<R>::Read(int readIdx) const
+const MappedRead* MultiReadMutationScorer<R>::Read(int readIndex) const
 {
-    return reads_[readIdx].IsActive ? reads_[readIdx].Read : NULL;
+    int r = LivePosition(readIndex);
+    return r >= 0 && reads_[r].IsActive ? reads_[r].Read.get() : NULL;
 }
 
 template <typename R>
@@ -148,283 +395,1647 @@ std::string MultiReadMutationScorer<R>::Template(StrandEnum strand, int template
     }
 }
 
+template <typename R>
+uint64_t MultiReadMutationScorer<R>::TemplateVersion() const
+{
+    return templateVersion_;
+}
+
+template <typename R>
+uint64_t MultiReadMutationScorer<R>::TemplateFingerprint() const
+{
+    return templateFingerprint_;
+}
+
 template <typename R>
 void MultiReadMutationScorer<R>::ApplyMutations(const std::vector<Mutation>& mutations)
 {
     DEBUG_ONLY(CheckInvariants());
+    PERF_SCOPE(PERF_APPLY_MUTATIONS);
+    if (CAPTURE_THIS_CALL()) detail::CaptureApplyMutations(this, mutations);
+    WakeReads();
     std::vector<int> mtp = TargetToQueryPositions(mutations, fwdTemplate_);
-    fwdTemplate_ = ConsensusCore::ApplyMutations(mutations, fwdTemplate_);
-    revTemplate_ = ReverseComplement(fwdTemplate_);
+    std::vector<Mutation> sortedMuts(mutations);
+    std::sort(sortedMuts.begin(), sortedMuts.end());
+    std::string newTemplate;
+    ConsensusCore::ApplyMutations(sortedMuts, fwdTemplate_, &newTemplate);
+    templateFingerprint_ =
+        MutatedTemplateFingerprint(templateFingerprint_, sortedMuts, fwdTemplate_);
+    templateVersion_++;
+    fwdTemplate_.swap(newTemplate);
+
+    bool disjoint = true;
+    for (int k = 1; k < static_cast<int>(sortedMuts.size()); k++) {
+        disjoint = disjoint && sortedMuts[k - 1].End() <= sortedMuts[k].Start();
+    }
+    if (disjoint) {
+        revTemplate_ = EditReverseStrand(sortedMuts, revTemplate_, fwdTemplate_.length());
+    } else {
+        revTemplate_.resize(fwdTemplate_.length());
+        ReverseComplement(fwdTemplate_.data(), fwdTemplate_.length(), &revTemplate_[0]);
+    }
 
+    bool lostReads = false;
     foreach (ReadStateType& rs, reads_) {
         try {
-            int newTemplateStart = mtp[rs.Read->TemplateStart];
-            int newTemplateEnd = mtp[rs.Read->TemplateEnd];
+            int oldTemplateStart = rs.Read->TemplateStart;
+            int oldTemplateEnd = rs.Read->TemplateEnd;
+            int newTemplateStart = mtp[oldTemplateStart];
+            int newTemplateEnd = mtp[oldTemplateEnd];
 
-            // reads (even inactive reads) will have their mapping coords updated
+            // reads (even inactive reads) will have their mapping coords
+            // updated; band hints are for the template as it was
             rs.Read->TemplateStart = newTemplateStart;
             rs.Read->TemplateEnd = newTemplateEnd;
+            rs.Read->BandHint.clear();
 
-            if (rs.IsActive) {
-                rs.Scorer->Template(Template(rs.Read->Strand, newTemplateStart, newTemplateEnd));
+            // The scorers copy their slice of the template straight
+            // out of ours, into the storage of their old one.  A read
+            // whose slice the mutations left alone keeps its matrices,
+            // and the scores cached against them.
+            if (!rs.IsActive) continue;
+            int len = newTemplateEnd - newTemplateStart;
+            const std::string& strand =
+                rs.Read->Strand == FORWARD_STRAND ? fwdTemplate_ : revTemplate_;
+            int start = rs.Read->Strand == FORWARD_STRAND ? newTemplateStart
+                                                          : TemplateLength() - newTemplateEnd;
+            if (strand.compare(start, len, rs.Scorer->Template()) != 0) {
+                // Where the columns of the scorer's matrices go, so
+                // that it can refill within their old bands
+                std::vector<int> columns(oldTemplateEnd - oldTemplateStart + 1);
+                for (int c = 0; c < static_cast<int>(columns.size()); c++) {
+                    columns[c] = rs.Read->Strand == FORWARD_STRAND
+                                     ? mtp[oldTemplateStart + c] - newTemplateStart
+                                     : newTemplateEnd - mtp[oldTemplateEnd - c];
+                }
+                rs.ScoreCache.clear();
+                rs.Scorer->Template(strand, start, len, columns);
             }
         } catch (AlphaBetaMismatchException& e) {
+            rs.ScoreCache.clear();
+            delete rs.Scorer;
+            rs.Scorer = NULL;
             rs.IsActive = false;
+            lostReads = true;
         }
     }
+    RebuildReadIndex();
+    if (lostReads) {
+        ActivateStandbys();
+        ReleaseDeadReads();
+    }
     DEBUG_ONLY(CheckInvariants());
 }
 
 template <typename R>
-bool MultiReadMutationScorer<R>::AddRead(const MappedRead& mr, float threshold)
+void MultiReadMutationScorer<R>::SlideTemplate(int trimLength, const std::string& extension)
 {
     DEBUG_ONLY(CheckInvariants());
+    if (trimLength < 0 || trimLength > TemplateLength()) {
+        throw InvalidInputError("Can't trim more than the whole template");
+    }
+    if (CAPTURE_THIS_CALL()) detail::CaptureSlideTemplate(this, trimLength, extension);
+    WakeReads();
+    int oldLength = TemplateLength();
+    fwdTemplate_ = fwdTemplate_.substr(trimLength) + extension;
+    templateFingerprint_ = ConsensusCore::TemplateFingerprint(fwdTemplate_);
+    templateVersion_++;
+    int kept = oldLength - trimLength;
+    std::string rev(fwdTemplate_.length(), 'N');
+    ReverseComplement(extension.data(), extension.length(), &rev[0]);
+    rev.replace(extension.length(), kept, revTemplate_, 0, kept);
+    revTemplate_.swap(rev);
+
+    std::vector<bool> dropped(reads_.size(), false);
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        ReadStateType& rs = reads_[r];
+        if (rs.Read->TemplateStart < trimLength) {
+            delete rs.Scorer;
+            rs.Scorer = NULL;
+            rs.IsActive = false;
+            rs.ScoreCache.clear();
+            dropped[r] = true;
+        } else {
+            rs.Read->TemplateStart -= trimLength;
+            rs.Read->TemplateEnd -= trimLength;
+        }
+    }
+    std::vector<std::pair<int, float> > standbys;
+    for (size_t k = 0; k < standbys_.size(); k++) {
+        if (!dropped[standbys_[k].first]) standbys.push_back(standbys_[k]);
+    }
+    standbys_.swap(standbys);
+
+    RebuildReadIndex();
+    ActivateStandbys();
+    ReleaseDeadReads();
+    DEBUG_ONLY(CheckInvariants());
+}
+
+template <typename R>
+typename MultiReadMutationScorer<R>::ScorerType* MultiReadMutationScorer<R>::NewScorer(
+    const boost::shared_ptr<MappedRead>& read, float threshold) const
+{
+    const MappedRead& mr = *read;
     const QuiverConfig* config = &quiverConfigByChemistry_.At(mr.Chemistry);
-    EvaluatorType ev(mr, Template(mr.Strand, mr.TemplateStart, mr.TemplateEnd), config->QvParams);
-    RecursorType recursor(config->MovesAvailable, config->Banding);
+    std::string tpl = Template(mr.Strand, mr.TemplateStart, mr.TemplateEnd);
 
-    ScorerType* scorer;
-    try {
-        scorer = new MutationScorer<R>(ev, recursor);
-    } catch (AlphaBetaMismatchException& e) {
-        scorer = NULL;
+    EvaluatorType ev(boost::shared_ptr<const ConsensusCore::Read>(read), tpl, config->Model);
+    BandingOptions banding = ReadBanding(config->Banding, mr.Features, tpl.length());
+    auto fill = [&]() -> ScorerType* {
+        RecursorType recursor(config->MovesAvailable, banding, config->Recursor);
+        try {
+            return new MutationScorer<R>(ev, recursor, config->CheckpointInterval, mr.BandHint);
+        } catch (AlphaBetaMismatchException& e) {
+            return NULL;
+        }
+    };
+
+    ScorerType* scorer = scorerCache_ ? scorerCache_->Find(mr, tpl) : NULL;
+    if (scorer == NULL) {
+        scorer = fill();
+        // An adaptive band too narrow to mate alpha and beta widens
+        while (scorer == NULL && banding.Adaptive && banding.ScoreDiff < banding.MaxScoreDiff) {
+            banding.ScoreDiff = std::min(2 * banding.ScoreDiff, banding.MaxScoreDiff);
+            scorer = fill();
+        }
+        if (scorer != NULL && scorerCache_) {
+            scorerCache_->Insert(mr, tpl, *scorer);
+        }
     }
 
     if (scorer != NULL && threshold < 1.0f) {
-        int I = ev.ReadLength();
-        int J = ev.TemplateLength();
+        int I = mr.Length();
+        int J = tpl.length();
         int maxSize = static_cast<int>(0.5f + threshold * (I + 1) * (J + 1));
 
-        if (scorer->Alpha()->AllocatedEntries() >= maxSize ||
-            scorer->Beta()->AllocatedEntries() >= maxSize) {
+        // As filled, before any checkpointing
+        auto tooBig = [maxSize](const ScorerType* s) {
+            const FillStatistics& stats = s->FillStats();
+            return stats.AlphaAllocatedEntries >= maxSize || stats.BetaAllocatedEntries >= maxSize;
+        };
+        // An adaptive band narrows, at least by half and otherwise by
+        // how far over its matrices ran, until they fit
+        while (scorer != NULL && tooBig(scorer)) {
+            const FillStatistics& stats = scorer->FillStats();
+            float over = static_cast<float>(std::max(stats.AlphaAllocatedEntries,
+                                                     stats.BetaAllocatedEntries)) / maxSize;
             delete scorer;
             scorer = NULL;
+            if (banding.Adaptive && banding.ScoreDiff > banding.MinScoreDiff) {
+                banding.ScoreDiff = std::max(std::min(0.5f, 0.8f / over) * banding.ScoreDiff,
+                                             banding.MinScoreDiff);
+                scorer = fill();
+            }
         }
     }
+    return scorer;
+}
 
-    bool isActive = scorer != NULL;
-    reads_.push_back(ReadStateType(new MappedRead(mr), scorer, isActive));
-    DEBUG_ONLY(CheckInvariants());
-    return isActive;
+template <typename R>
+bool MultiReadMutationScorer<R>::ActivateRead(int readIdx, float threshold)
+{
+    return ActivateRead(readIdx, NewScorer(reads_[readIdx].Read, threshold));
 }
 
 template <typename R>
-bool MultiReadMutationScorer<R>::AddRead(const MappedRead& mr)
+bool MultiReadMutationScorer<R>::ActivateRead(int readIdx, ScorerType* scorer)
 {
-    DEBUG_ONLY(CheckInvariants());
-    const QuiverConfig* config = &quiverConfigByChemistry_.At(mr.Chemistry);
-    return AddRead(mr, config->AddThreshold);
+    ReadStateType& rs = reads_[readIdx];
+    rs.ScoreCache.clear();
+    rs.Scorer = scorer;
+    rs.IsActive = rs.Scorer != NULL;
+    if (rs.IsActive) {
+        IndexRead(readIdx);
+    }
+    return rs.IsActive;
 }
 
 template <typename R>
-float MultiReadMutationScorer<R>::Score(const Mutation& m) const
+std::vector<typename MultiReadMutationScorer<R>::ScorerType*>
+MultiReadMutationScorer<R>::NewScorers(const std::vector<int>& readIdxs) const
 {
-    float sum = 0;
-    foreach (const ReadStateType& rs, reads_) {
-        if (rs.IsActive && ReadScoresMutation(*rs.Read, m)) {
-            Mutation orientedMut = OrientedMutation(*rs.Read, m);
-            sum += (rs.Scorer->ScoreMutation(orientedMut) - rs.Scorer->Score());
+    std::vector<ScorerType*> scorers(readIdxs.size(), NULL);
+    std::function<void(int)> fill = [&](int k) {
+        const boost::shared_ptr<MappedRead>& mr = reads_[readIdxs[k]].Read;
+        scorers[k] = NewScorer(mr, quiverConfigByChemistry_.At(mr->Chemistry).AddThreshold);
+    };
+    try {
+        if (NumThreads() == 1 || readIdxs.size() < 2) {
+            for (size_t k = 0; k < readIdxs.size(); k++) {
+                fill(k);
+            }
+        } else {
+            // Fills vary too much in cost to hand out in chunks
+            threadPool_->ParallelFor(readIdxs.size(), fill);
         }
+    } catch (...) {
+        foreach (ScorerType* scorer, scorers) {
+            delete scorer;
+        }
+        throw;
     }
-    return sum;
+    return scorers;
 }
 
 template <typename R>
-float MultiReadMutationScorer<R>::Score(MutationType mutationType, int position, char base) const
+bool MultiReadMutationScorer<R>::BelowCoverageCap(const MappedRead& mr,
+                                                  const std::vector<int>& pending) const
 {
-    Mutation m(mutationType, position, base);
-    return Score(m);
+    if (coverageCap_ <= 0) return true;
+    int winStart = mr.TemplateStart;
+    int winLen = mr.TemplateEnd - mr.TemplateStart;
+    if (winLen <= 0) return false;
+
+    std::vector<int> near;
+    ReadsNear(winStart, mr.TemplateEnd - 1, &near);
+    std::vector<int> tStart, tEnd;
+    foreach (int r, near) {
+        tStart.push_back(extentStarts_[r]);
+        tEnd.push_back(extentEnds_[r]);
+    }
+    foreach (int r, pending) {
+        const MappedRead& pr = *reads_[r].Read;
+        if (pr.TemplateStart < mr.TemplateEnd && winStart < pr.TemplateEnd) {
+            tStart.push_back(pr.TemplateStart);
+            tEnd.push_back(pr.TemplateEnd);
+        }
+    }
+    if (static_cast<int>(tStart.size()) < coverageCap_) return true;
+    std::vector<int> coverage(winLen);
+    CoverageInWindow(tStart.size(), &tStart[0], tEnd.size(), &tEnd[0], winStart, winLen,
+                     &coverage[0]);
+    return *std::min_element(coverage.begin(), coverage.end()) < coverageCap_;
 }
 
 template <typename R>
-float MultiReadMutationScorer<R>::FastScore(const Mutation& m) const
+bool MultiReadMutationScorer<R>::AdmitRead(int readIdx, float threshold)
 {
-    float sum = 0;
-    foreach (const ReadStateType& rs, reads_) {
-        if (rs.IsActive && ReadScoresMutation(*rs.Read, m)) {
-            Mutation orientedMut = OrientedMutation(*rs.Read, m);
-            sum += (rs.Scorer->ScoreMutation(orientedMut) - rs.Scorer->Score());
-            if (sum < fastScoreThreshold_) {
-                return sum;
-            }
-        }
+    if (!BelowCoverageCap(*reads_[readIdx].Read)) {
+        standbys_.push_back(std::make_pair(readIdx, threshold));
+        return false;
     }
-    return sum;
+    return ActivateRead(readIdx, threshold);
 }
 
 template <typename R>
-std::vector<float> MultiReadMutationScorer<R>::Scores(const Mutation& m, float unscoredValue) const
+void MultiReadMutationScorer<R>::ActivateStandbys()
 {
-    std::vector<float> scoreByRead;
-    foreach (const ReadStateType& rs, reads_) {
-        if (rs.IsActive && ReadScoresMutation(*rs.Read, m)) {
-            Mutation orientedMut = OrientedMutation(*rs.Read, m);
-            scoreByRead.push_back(rs.Scorer->ScoreMutation(orientedMut) - rs.Scorer->Score());
+    std::vector<std::pair<int, float> > remaining;
+    bool activated = false;
+    for (size_t k = 0; k < standbys_.size(); k++) {
+        int r = standbys_[k].first;
+        if (BelowCoverageCap(*reads_[r].Read)) {
+            // A standby that fails to score is dropped for good, as
+            // AddRead would have
+            activated = ActivateRead(r, standbys_[k].second) || activated;
         } else {
-            scoreByRead.push_back(unscoredValue);
+            remaining.push_back(standbys_[k]);
         }
     }
-    return scoreByRead;
+    standbys_.swap(remaining);
+    if (activated) EnforceMemoryBudget();
 }
 
 template <typename R>
-std::vector<float> MultiReadMutationScorer<R>::Scores(MutationType mutationType, int position,
-                                                      char base, float unscoredValue) const
+bool MultiReadMutationScorer<R>::AddRead(const MappedRead& mr, float threshold)
 {
-    Mutation m(mutationType, position, base);
-    return Scores(m, unscoredValue);
+    DEBUG_ONLY(CheckInvariants());
+    int readIndex = numReadsAdded_;
+    AppendRead(mr);
+    if (AdmitRead(reads_.size() - 1, threshold)) {
+        EnforceMemoryBudget();
+    }
+    ReleaseDeadReads();
+    DEBUG_ONLY(CheckInvariants());
+    // The read may have been dropped for the memory budget
+    bool added = Read(readIndex) != NULL;
+    if (CAPTURE_THIS_CALL()) detail::CaptureAddRead(this, mr, threshold, added);
+    return added;
 }
 
 template <typename R>
-bool MultiReadMutationScorer<R>::IsFavorable(const Mutation& m) const
+int MultiReadMutationScorer<R>::AddReads(const std::vector<MappedRead>& mappedReads)
 {
-    float sum = 0;
-    foreach (const ReadStateType& rs, reads_) {
-        if (rs.IsActive && ReadScoresMutation(*rs.Read, m)) {
-            Mutation orientedMut = OrientedMutation(*rs.Read, m);
-            sum += (rs.Scorer->ScoreMutation(orientedMut) - rs.Scorer->Score());
+    DEBUG_ONLY(CheckInvariants());
+    int first = reads_.size();
+    int firstIndex = numReadsAdded_;
+    foreach (const MappedRead& mr, mappedReads) {
+        AppendRead(mr);
+    }
+
+    // Offer the reads best first: spanning, long, and with few indels
+    // implied by the mismatch of their length and template extent.
+    int L = TemplateLength();
+    std::vector<int> order;
+    std::vector<double> lengthMismatch(reads_.size(), 0.0);
+    for (int r = first; r < static_cast<int>(reads_.size()); r++) {
+        const MappedRead& mr = *reads_[r].Read;
+        int extent = mr.TemplateEnd - mr.TemplateStart;
+        lengthMismatch[r] =
+            std::abs(mr.Length() - extent) / static_cast<double>(std::max(1, extent));
+        order.push_back(r);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        const MappedRead& ma = *reads_[a].Read;
+        const MappedRead& mb = *reads_[b].Read;
+        bool aSpans = ma.TemplateStart == 0 && ma.TemplateEnd == L;
+        bool bSpans = mb.TemplateStart == 0 && mb.TemplateEnd == L;
+        int aExtent = ma.TemplateEnd - ma.TemplateStart;
+        int bExtent = mb.TemplateEnd - mb.TemplateStart;
+        if (aSpans != bSpans) return aSpans;
+        if (aExtent != bExtent) return aExtent > bExtent;
+        return lengthMismatch[a] < lengthMismatch[b];
+    });
+
+    // Fill a wave of reads together, admitting them as though each of
+    // the wave's fills will succeed.  Without a cap, every read is
+    // admitted whatever becomes of the others, so the wave is all of
+    // them; with one, a failed fill may admit reads after it, so the
+    // wave is committed only through the first that fails.
+    bool speculative = coverageCap_ > 0;
+    size_t waveSize = speculative ? NumThreads() * CHUNKS_PER_THREAD : order.size();
+    size_t p = 0;
+    while (p < order.size()) {
+        std::vector<int> pending;
+        size_t end = p;
+        for (; end < order.size() && pending.size() < waveSize; end++) {
+            if (BelowCoverageCap(*reads_[order[end]].Read, pending)) {
+                pending.push_back(order[end]);
+            }
+        }
+        std::vector<ScorerType*> scorers = NewScorers(pending);
+        size_t k = 0;
+        while (p < end) {
+            int r = order[p++];
+            if (k < pending.size() && pending[k] == r) {
+                if (!ActivateRead(r, scorers[k++]) && speculative) break;
+            } else {
+                const MappedRead& mr = *reads_[r].Read;
+                standbys_.push_back(
+                    std::make_pair(r, quiverConfigByChemistry_.At(mr.Chemistry).AddThreshold));
+            }
         }
+        for (; k < scorers.size(); k++) {
+            delete scorers[k];
+        }
+    }
+    EnforceMemoryBudget();
+    ReleaseDeadReads();
+
+    int nActive = 0;
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        nActive += readIndices_[r] >= firstIndex && reads_[r].IsActive;
     }
-    return (sum > MIN_FAVORABLE_SCOREDIFF);
+    DEBUG_ONLY(CheckInvariants());
+    if (CAPTURE_THIS_CALL()) detail::CaptureAddReads(this, mappedReads, nActive);
+    return nActive;
 }
 
 template <typename R>
-bool MultiReadMutationScorer<R>::FastIsFavorable(const Mutation& m) const
+void MultiReadMutationScorer<R>::SetCoverageCap(int maxCoverage)
 {
-    float sum = 0;
-    foreach (const ReadStateType& rs, reads_) {
-        if (rs.IsActive && ReadScoresMutation(*rs.Read, m)) {
-            Mutation orientedMut = OrientedMutation(*rs.Read, m);
-            sum += (rs.Scorer->ScoreMutation(orientedMut) - rs.Scorer->Score());
-            if (sum < fastScoreThreshold_) {
-                return false;
-            }
-        }
+    if (CAPTURE_THIS_CALL()) {
+        detail::CaptureSetting(this, detail::COVERAGE_CAP_SETTING, maxCoverage);
     }
-    return (sum > MIN_FAVORABLE_SCOREDIFF);
+    coverageCap_ = maxCoverage;
+    ActivateStandbys();
+    ReleaseDeadReads();
 }
 
 template <typename R>
-std::vector<int> MultiReadMutationScorer<R>::AllocatedMatrixEntries() const
+int MultiReadMutationScorer<R>::CoverageCap() const
 {
-    std::vector<int> allocatedCounts;
-    for (int i = 0; i < static_cast<int>(reads_.size()); i++) {
-        int n = AlphaMatrix(i)->AllocatedEntries() + BetaMatrix(i)->AllocatedEntries();
-        allocatedCounts.push_back(n);
-    }
-    return allocatedCounts;
+    return coverageCap_;
 }
 
 template <typename R>
-std::vector<int> MultiReadMutationScorer<R>::UsedMatrixEntries() const
+std::vector<int> MultiReadMutationScorer<R>::StandbyReads() const
 {
-    std::vector<int> usedCounts;
-    for (int i = 0; i < static_cast<int>(reads_.size()); i++) {
-        int n = AlphaMatrix(i)->UsedEntries() + BetaMatrix(i)->UsedEntries();
-        usedCounts.push_back(n);
+    std::vector<int> standbys;
+    for (size_t k = 0; k < standbys_.size(); k++) {
+        standbys.push_back(readIndices_[standbys_[k].first]);
     }
-    return usedCounts;
+    return standbys;
 }
 
 template <typename R>
-const AbstractMatrix* MultiReadMutationScorer<R>::AlphaMatrix(int i) const
+int64_t MultiReadMutationScorer<R>::MatrixBytes(const ReadStateType& rs) const
 {
-    return reads_[i].Scorer->Alpha();
+    int64_t entries =
+        rs.Scorer->Alpha()->AllocatedEntries() + rs.Scorer->Beta()->AllocatedEntries();
+    return entries * R::MatrixType::EntryBytes();
 }
 
 template <typename R>
-const AbstractMatrix* MultiReadMutationScorer<R>::BetaMatrix(int i) const
+void MultiReadMutationScorer<R>::EnforceMemoryBudget()
 {
-    return reads_[i].Scorer->Beta();
+    if (memoryBudget_ <= 0) return;
+    WakeReads();
+
+    std::vector<int> active;
+    std::vector<int64_t> bytes(reads_.size(), 0);
+    int64_t totalBytes = 0;
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        if (reads_[r].IsActive) {
+            active.push_back(r);
+            bytes[r] = MatrixBytes(reads_[r]);
+            totalBytes += bytes[r];
+        }
+    }
+    if (totalBytes <= memoryBudget_) return;
+
+    // A read's information is taken to be the template bases it
+    // covers; among reads of equal cost, the latest added goes first.
+    std::vector<double> cost(reads_.size(), 0.0);
+    foreach (int r, active) {
+        const MappedRead& mr = *reads_[r].Read;
+        cost[r] = static_cast<double>(bytes[r]) / std::max(1, mr.TemplateEnd - mr.TemplateStart);
+    }
+    std::sort(active.begin(), active.end(),
+              [&](int a, int b) { return cost[a] != cost[b] ? cost[a] > cost[b] : a > b; });
+
+    for (size_t k = 0; k < active.size() && totalBytes > memoryBudget_; k++) {
+        ReadStateType& rs = reads_[active[k]];
+        totalBytes -= bytes[active[k]];
+        delete rs.Scorer;
+        rs.Scorer = NULL;
+        rs.IsActive = false;
+        rs.ScoreCache.clear();
+        droppedReads_.push_back(readIndices_[active[k]]);
+    }
+    RebuildReadIndex();
 }
 
 template <typename R>
-std::vector<int> MultiReadMutationScorer<R>::NumFlipFlops() const
+void MultiReadMutationScorer<R>::SetMemoryBudget(int64_t bytes)
 {
-    std::vector<int> nFlipFlops;
-    foreach (const ReadStateType& rs, reads_) {
-        nFlipFlops.push_back(rs.Scorer->NumFlipFlops());
-    }
-    return nFlipFlops;
+    if (CAPTURE_THIS_CALL()) detail::CaptureSetting(this, detail::MEMORY_BUDGET_SETTING, bytes);
+    memoryBudget_ = bytes;
+    EnforceMemoryBudget();
+    ReleaseDeadReads();
 }
 
 template <typename R>
-float MultiReadMutationScorer<R>::BaselineScore() const
+int64_t MultiReadMutationScorer<R>::MemoryBudget() const
 {
-    float sum = 0;
-    foreach (const ReadStateType& rs, reads_) {
-        if (rs.IsActive) sum += rs.Scorer->Score();
-    }
-    return sum;
+    return memoryBudget_;
 }
 
 template <typename R>
-std::vector<float> MultiReadMutationScorer<R>::BaselineScores() const
+std::vector<int> MultiReadMutationScorer<R>::DroppedReads() const
 {
-    std::vector<float> scoreByRead;
-    foreach (const ReadStateType& rs, reads_) {
-        if (rs.IsActive) scoreByRead.push_back(rs.Scorer->Score());
-    }
-    return scoreByRead;
+    return droppedReads_;
 }
 
 template <typename R>
-void MultiReadMutationScorer<R>::CheckInvariants() const
+void MultiReadMutationScorer<R>::SetScoreCaching(bool cacheScores)
 {
-#ifndef NDEBUG
-    assert(revTemplate_ == ReverseComplement(fwdTemplate_));
-    foreach (const ReadStateType& rs, reads_) {
-        rs.CheckInvariants();
-        if (rs.IsActive) {
-            assert(rs.Scorer->Template() ==
-                   Template(rs.Read->Strand, rs.Read->TemplateStart, rs.Read->TemplateEnd));
-            assert(0 <= rs.Read->TemplateStart &&
-                   rs.Read->TemplateStart <= static_cast<int>(fwdTemplate_.size()));
-            assert(0 <= rs.Read->TemplateEnd &&
-                   rs.Read->TemplateEnd <= static_cast<int>(fwdTemplate_.size()));
-            assert(rs.Read->TemplateStart <= rs.Read->TemplateEnd);
+    if (CAPTURE_THIS_CALL()) {
+        detail::CaptureSetting(this, detail::SCORE_CACHING_SETTING, cacheScores);
+    }
+    cacheScores_ = cacheScores;
+    if (!cacheScores_) {
+        foreach (ReadStateType& rs, reads_) {
+            std::map<Mutation, float>().swap(rs.ScoreCache);
         }
     }
-#endif  // !NDEBUG
 }
 
 template <typename R>
-std::string MultiReadMutationScorer<R>::ToString() const
+bool MultiReadMutationScorer<R>::ScoreCaching() const
 {
-    std::stringstream ss;
-
-    ss << "Template: " << Template() << std::endl;
-    ss << "Score: " << BaselineScore() << std::endl;
+    return cacheScores_;
+}
 
-    ss << "Reads:" << std::endl;
-    foreach (const ReadStateType& rs, reads_) {
-        ss << "\t" << rs.ToString() << std::endl;
+template <typename R>
+float MultiReadMutationScorer<R>::ScoreDelta(int readIdx, const Mutation& orientedMut,
+                                             bool remember) const
+{
+    const ReadStateType& rs = reads_[readIdx];
+    if (!cacheScores_) {
+        return rs.Scorer->ScoreMutation(orientedMut) - baselineScores_[readIdx];
     }
-    return ss.str();
+    std::map<Mutation, float>::const_iterator it = rs.ScoreCache.find(orientedMut);
+    if (it != rs.ScoreCache.end()) {
+        return it->second;
+    }
+    float delta = rs.Scorer->ScoreMutation(orientedMut) - baselineScores_[readIdx];
+    if (!remember) return delta;
+    int sliceLength = extentEnds_[readIdx] - extentStarts_[readIdx];
+    if (static_cast<int>(rs.ScoreCache.size()) >=
+        MAX_CACHED_SCORES_PER_BASE * std::max(1, sliceLength)) {
+        rs.ScoreCache.clear();
+    }
+    rs.ScoreCache.insert(std::make_pair(orientedMut, delta));
+    return delta;
 }
 
-namespace detail {
+template <typename R>
+void MultiReadMutationScorer<R>::IndexRead(int readIdx)
+{
+    RecordRead(readIdx);
+    int start = extentStarts_[readIdx];
+    int extent = extentEnds_[readIdx] - start;
+    // Reads tend to arrive in template order, so this is mostly an append
+    int k = std::upper_bound(readStarts_.begin(), readStarts_.end(), start) - readStarts_.begin();
+    readStarts_.insert(readStarts_.begin() + k, start);
+    readsByStart_.insert(readsByStart_.begin() + k, readIdx);
+    maxReadExtent_ = std::max(maxReadExtent_, extent);
+    rejectPriority_.resize(reads_.size(), 0.0f);
+    rejectPriority_[readIdx] = baselineScores_[readIdx] / std::max(1, extent);
+}
 
-template <typename ScorerType>
-ReadState<ScorerType>::ReadState(MappedRead* read, ScorerType* scorer, bool isActive)
-    : Read(read), Scorer(scorer), IsActive(isActive)
+template <typename R>
+void MultiReadMutationScorer<R>::RebuildReadIndex()
 {
-    CheckInvariants();
+    readsByStart_.clear();
+    readStarts_.clear();
+    maxReadExtent_ = 0;
+    // Cleared, so they are sized afresh even when no read is left
+    isActive_.clear();
+    isReverse_.clear();
+    extentStarts_.clear();
+    extentEnds_.clear();
+    baselineScores_.clear();
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        RecordRead(r);
+        if (isActive_[r]) {
+            readsByStart_.push_back(r);
+        }
+    }
+    std::stable_sort(readsByStart_.begin(), readsByStart_.end(),
+                     [&](int a, int b) { return extentStarts_[a] < extentStarts_[b]; });
+    rejectPriority_.assign(reads_.size(), 0.0f);
+    foreach (int r, readsByStart_) {
+        int extent = extentEnds_[r] - extentStarts_[r];
+        readStarts_.push_back(extentStarts_[r]);
+        maxReadExtent_ = std::max(maxReadExtent_, extent);
+        rejectPriority_[r] = baselineScores_[r] / std::max(1, extent);
+    }
 }
 
-template <typename ScorerType>
-ReadState<ScorerType>::ReadState(const ReadState& other)
-    : Read(NULL), Scorer(NULL), IsActive(other.IsActive)
+template <typename R>
+void MultiReadMutationScorer<R>::RecordRead(int readIdx)
 {
-    if (other.Read != NULL) Read = new MappedRead(*other.Read);
-    if (other.Scorer != NULL) Scorer = new ScorerType(*other.Scorer);
-    CheckInvariants();
+    int n = reads_.size();
+    if (static_cast<int>(isActive_.size()) != n) {
+        isActive_.resize(n, false);
+        isReverse_.resize(n, false);
+        extentStarts_.resize(n, 0);
+        extentEnds_.resize(n, 0);
+        baselineScores_.resize(n, 0.0f);
+    }
+    const ReadStateType& rs = reads_[readIdx];
+    isActive_[readIdx] = rs.IsActive;
+    isReverse_[readIdx] = rs.Read->Strand == REVERSE_STRAND;
+    extentStarts_[readIdx] = rs.IsActive ? rs.Read->TemplateStart : 0;
+    extentEnds_[readIdx] = rs.IsActive ? rs.Read->TemplateEnd : 0;
+    baselineScores_[readIdx] = rs.IsActive ? rs.Scorer->Score() : 0.0f;
+}
+
+template <typename R>
+bool MultiReadMutationScorer<R>::ScoresMutation(int readIdx, const Mutation& m) const
+{
+    return isActive_[readIdx] &&
+           ExtentScoresMutation(extentStarts_[readIdx], extentEnds_[readIdx], m);
+}
+
+template <typename R>
+Mutation MultiReadMutationScorer<R>::OrientMutation(int readIdx, const Mutation& m) const
+{
+    return OrientToExtent(isReverse_[readIdx], extentStarts_[readIdx], extentEnds_[readIdx], m);
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::AppendRead(const MappedRead& mr)
+{
+    reads_.push_back(ReadStateType(new MappedRead(mr), NULL, false));
+    readIndices_.push_back(numReadsAdded_++);
+    RecordRead(reads_.size() - 1);
+}
+
+template <typename R>
+int MultiReadMutationScorer<R>::LivePosition(int readIndex) const
+{
+    std::vector<int>::const_iterator it =
+        std::lower_bound(readIndices_.begin(), readIndices_.end(), readIndex);
+    if (it == readIndices_.end() || *it != readIndex) return -1;
+    return it - readIndices_.begin();
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::ReleaseDeadReads()
+{
+    std::vector<bool> standby(reads_.size(), false);
+    for (size_t k = 0; k < standbys_.size(); k++) {
+        standby[standbys_[k].first] = true;
+    }
+    // Closing up keeps the live reads in order, so sums over them in
+    // read order do not change
+    std::vector<int> newPosition(reads_.size(), -1);
+    int nLive = 0;
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        if (!reads_[r].IsActive && !standby[r]) continue;
+        newPosition[r] = nLive;
+        if (r != nLive) {
+            reads_[nLive] = std::move(reads_[r]);
+            readIndices_[nLive] = readIndices_[r];
+        }
+        nLive++;
+    }
+    if (nLive == static_cast<int>(reads_.size())) return;
+
+    // Their ReadStates let go of the dead reads' scorers and matrices
+    reads_.erase(reads_.begin() + nLive, reads_.end());
+    readIndices_.resize(nLive);
+    for (size_t k = 0; k < standbys_.size(); k++) {
+        standbys_[k].first = newPosition[standbys_[k].first];
+    }
+    RebuildReadIndex();
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::OrderForRejection(std::vector<int>* reads) const
+{
+    std::sort(reads->begin(), reads->end(), [&](int a, int b) {
+        return rejectPriority_[a] != rejectPriority_[b] ? rejectPriority_[a] > rejectPriority_[b]
+                                                        : a < b;
+    });
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::ReadsNear(int begin, int end, std::vector<int>* reads) const
+{
+    reads->clear();
+    std::vector<int>::const_iterator lo =
+        std::lower_bound(readStarts_.begin(), readStarts_.end(), begin - maxReadExtent_);
+    std::vector<int>::const_iterator hi = std::upper_bound(lo, readStarts_.end(), end);
+    int nCandidates = hi - lo;
+
+    if (nCandidates * DENSE_READS_FRACTION > static_cast<int>(reads_.size())) {
+        for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+            if (isActive_[r] && extentStarts_[r] <= end && extentEnds_[r] >= begin) {
+                reads->push_back(r);
+            }
+        }
+    } else {
+        for (int k = lo - readStarts_.begin(); k < hi - readStarts_.begin(); k++) {
+            int r = readsByStart_[k];
+            if (extentEnds_[r] >= begin) {
+                reads->push_back(r);
+            }
+        }
+        std::sort(reads->begin(), reads->end());
+    }
+}
+
+template <typename R>
+bool MultiReadMutationScorer<R>::AddRead(const MappedRead& mr)
+{
+    DEBUG_ONLY(CheckInvariants());
+    const QuiverConfig* config = &quiverConfigByChemistry_.At(mr.Chemistry);
+    return AddRead(mr, config->AddThreshold);
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::ForEachRead(int begin, int end,
+                                             const std::function<void(int)>& fn) const
+{
+    int n = end - begin;
+    if (NumThreads() == 1 || n < 2) {
+        for (int i = begin; i < end; i++) {
+            fn(i);
+        }
+    } else {
+        // Each read is only ever touched by one worker, and the
+        // MutationScorers share no mutable state, so this is safe.
+        int nChunks = std::min(n, NumThreads() * CHUNKS_PER_THREAD);
+        threadPool_->ParallelFor(nChunks, [&](int c) {
+            int chunkEnd = begin + (n * (c + 1)) / nChunks;
+            for (int i = begin + (n * c) / nChunks; i < chunkEnd; i++) {
+                fn(i);
+            }
+        });
+    }
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::ScoreReads(const Mutation& m, const std::vector<int>& reads,
+                                            int begin, int end, float unscoredValue,
+                                            float* scores) const
+{
+    ForEachRead(begin, end, [&](int k) {
+        int r = reads[k];
+        if (ScoresMutation(r, m)) {
+            scores[k - begin] = ScoreDelta(r, OrientMutation(r, m));
+        } else {
+            scores[k - begin] = unscoredValue;
+        }
+    });
+}
+
+template <typename R>
+float MultiReadMutationScorer<R>::SumScores(const Mutation& m, bool fastReject) const
+{
+    WakeReads();
+
+    // Reads away from m do not score it, and would contribute nothing.
+    // Fast rejection visits first the reads likeliest to sink the sum.
+    std::vector<int> reads;
+    ReadsNear(m.Start(), m.End(), &reads);
+    if (fastReject) OrderForRejection(&reads);
+
+    // Score the reads in waves across the pool (one at a time without
+    // one), then reduce serially in visiting order.  Unscored reads
+    // contribute an exact zero, so the running sum---and hence the
+    // point of early exit---does not depend on the number of threads.
+    int nReads = static_cast<int>(reads.size());
+    int waveSize = nReads;
+    if (fastReject) {
+        waveSize = NumThreads() == 1 ? 1 : NumThreads() * READS_PER_THREAD_PER_WAVE;
+    }
+    std::vector<float> scores(nReads);
+    float sum = 0;
+    for (int begin = 0; begin < nReads; begin += waveSize) {
+        int end = std::min(nReads, begin + waveSize);
+        ScoreReads(m, reads, begin, end, 0.0f, &scores[begin]);
+        for (int i = begin; i < end; i++) {
+            sum += scores[i];
+            if (fastReject && sum < fastScoreThreshold_) {
+                return sum;
+            }
+        }
+    }
+    if (!fastReject) return sum;
+
+    // A mutation that is not rejected gets its sum in read order, as
+    // Score would give it
+    std::vector<int> positions;
+    PositionsByRead(reads, &positions);
+    sum = 0;
+    foreach (int k, positions) {
+        sum += scores[k];
+    }
+    return sum;
+}
+
+template <typename R>
+float MultiReadMutationScorer<R>::Score(const Mutation& m) const
+{
+    return SumScores(m, false);
+}
+
+template <typename R>
+float MultiReadMutationScorer<R>::Score(MutationType mutationType, int position, char base) const
+{
+    Mutation m(mutationType, position, base);
+    return Score(m);
+}
+
+template <typename R>
+float MultiReadMutationScorer<R>::FastScore(const Mutation& m) const
+{
+    return SumScores(m, true);
+}
+
+template <typename R>
+std::vector<float> MultiReadMutationScorer<R>::Scores(const Mutation& m, float unscoredValue) const
+{
+    WakeReads();
+    std::vector<float> scoreByRead(NumReads(), unscoredValue);
+    std::vector<int> reads;
+    ReadsNear(m.Start(), m.End(), &reads);
+    if (!reads.empty()) {
+        std::vector<float> scores(reads.size());
+        ScoreReads(m, reads, 0, static_cast<int>(reads.size()), unscoredValue, &scores[0]);
+        for (int k = 0; k < static_cast<int>(reads.size()); k++) {
+            scoreByRead[readIndices_[reads[k]]] = scores[k];
+        }
+    }
+    return scoreByRead;
+}
+
+template <typename R>
+std::vector<float> MultiReadMutationScorer<R>::Scores(MutationType mutationType, int position,
+                                                      char base, float unscoredValue) const
+{
+    Mutation m(mutationType, position, base);
+    return Scores(m, unscoredValue);
+}
+
+template <typename R>
+bool MultiReadMutationScorer<R>::IsFavorable(const Mutation& m) const
+{
+    return (SumScores(m, false) > MIN_FAVORABLE_SCOREDIFF);
+}
+
+template <typename R>
+bool MultiReadMutationScorer<R>::FastIsFavorable(const Mutation& m) const
+{
+    // An early exit leaves the sum below fastScoreThreshold_ <= 0, so
+    // the comparison below rejects it.
+    return (SumScores(m, true) > MIN_FAVORABLE_SCOREDIFF);
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::ScoreBatch(const std::vector<Mutation>& mutations, bool fastReject,
+                                            float* sums, float unscoredValue,
+                                            float* scoresByRead) const
+{
+    WakeReads();
+    int nMuts = mutations.size();
+    int nReads = NumReads();
+
+    std::fill(sums, sums + nMuts, 0.0f);
+    if (scoresByRead != NULL) {
+        std::fill(scoresByRead, scoresByRead + nMuts * nReads, unscoredValue);
+    }
+
+    std::vector<int> order(nMuts);
+    for (int i = 0; i < nMuts; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return mutations[a].Start() < mutations[b].Start(); });
+
+    // Cut the template into stripes so wide that no read meets
+    // mutations in two stripes that are not neighbors.  The even
+    // stripes can then be scored concurrently, each on one thread, and
+    // then the odd ones; when there are too few stripes to keep the
+    // pool busy, the reads near each block are spread over it instead.
+    // Either way each sum is folded in read order, so the results do
+    // not depend on the split.
+    int maxSpan = 0;
+    foreach (const Mutation& m, mutations) {
+        maxSpan = std::max(maxSpan, m.End() - m.Start());
+    }
+    int stripeWidth = maxReadExtent_ + maxSpan + 1;
+    std::vector<int> stripeBegins;
+    for (int k = 0; k < nMuts; k++) {
+        if (k == 0 ||
+            mutations[order[k]].Start() / stripeWidth !=
+                mutations[order[k - 1]].Start() / stripeWidth) {
+            stripeBegins.push_back(k);
+        }
+    }
+    stripeBegins.push_back(nMuts);
+    int nStripes = stripeBegins.size() - 1;
+
+    if (NumThreads() == 1 || nStripes < MIN_STRIPES_PER_THREAD * NumThreads()) {
+        ScoreBlocks(mutations, order, 0, nMuts, fastReject, true, sums, scoresByRead);
+        return;
+    }
+    std::vector<int> phaseStripes;
+    for (int parity = 0; parity < 2; parity++) {
+        phaseStripes.clear();
+        for (int s = 0; s < nStripes; s++) {
+            int stripe = mutations[order[stripeBegins[s]]].Start() / stripeWidth;
+            if (stripe % 2 == parity) phaseStripes.push_back(s);
+        }
+        threadPool_->ParallelFor(phaseStripes.size(), [&](int p) {
+            int s = phaseStripes[p];
+            ScoreBlocks(mutations, order, stripeBegins[s], stripeBegins[s + 1], fastReject, false,
+                        sums, scoresByRead);
+        });
+    }
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::ScoreBlocks(const std::vector<Mutation>& mutations,
+                                             const std::vector<int>& order, int begin, int end,
+                                             bool fastReject, bool parallelReads, float* sums,
+                                             float* scoresByRead) const
+{
+    int nReads = NumReads();
+
+    // Score a block of mutations against a wave of reads, each read
+    // working through the block in template order, then fold the wave
+    // into the running sums in visiting order---so sums agree exactly
+    // with Score/FastScore.  With fastReject, the reads are visited in
+    // the order FastScore visits them, a mutation whose running sum
+    // has dropped below the threshold is not scored by later waves, and
+    // a mutation never rejected has its sum refolded in read order.
+    // Only the reads near a block are visited.
+    std::vector<int> reads;
+    std::vector<int> positions;
+    std::vector<int> live;
+    std::vector<float> deltas;
+    std::vector<float> blockDeltas;
+    for (int mBegin = begin; mBegin < end; mBegin += MUTATIONS_PER_BLOCK) {
+        int mEnd = std::min(end, mBegin + MUTATIONS_PER_BLOCK);
+        // live holds positions in the block, order[mBegin + k]
+        // indexing the mutation at position k
+        const int* block = &order[mBegin];
+        live.resize(mEnd - mBegin);
+        for (int k = 0; k < mEnd - mBegin; k++) {
+            live[k] = k;
+        }
+
+        int blockStart = mutations[block[0]].Start();
+        int blockEnd = blockStart;
+        for (int k = 0; k < mEnd - mBegin; k++) {
+            blockEnd = std::max(blockEnd, mutations[block[k]].End());
+        }
+        ReadsNear(blockStart, blockEnd, &reads);
+        int nNear = reads.size();
+        if (fastReject) {
+            OrderForRejection(&reads);
+            blockDeltas.assign((mEnd - mBegin) * nNear, 0.0f);
+        }
+        int waveThreads = parallelReads ? NumThreads() : 1;
+        int waveSize = fastReject ? waveThreads * READS_PER_THREAD_PER_WAVE : nNear;
+
+        for (int rBegin = 0; rBegin < nNear && !live.empty(); rBegin += waveSize) {
+            int rEnd = std::min(nNear, rBegin + waveSize);
+            int nLive = live.size();
+            deltas.assign(nLive * (rEnd - rBegin), 0.0f);
+
+            auto scorePair = [&](int j, int k, bool remember) {
+                int r = reads[j];
+                int i = block[live[k]];
+                const Mutation& m = mutations[i];
+                if (ScoresMutation(r, m)) {
+                    float delta = ScoreDelta(r, OrientMutation(r, m), remember);
+                    deltas[(j - rBegin) * nLive + k] = delta;
+                    if (scoresByRead != NULL) {
+                        scoresByRead[i * nReads + readIndices_[r]] = delta;
+                    }
+                    if (fastReject) {
+                        blockDeltas[live[k] * nNear + j] = delta;
+                    }
+                }
+            };
+            std::function<void(int)> scoreRead = [&](int j) {
+                for (int k = 0; k < nLive; k++) {
+                    scorePair(j, k, true);
+                }
+            };
+            if (parallelReads && rEnd - rBegin < NumThreads() && nLive > 1) {
+                // Too few reads to go round the pool (a low-coverage
+                // window with many candidates): spread the (read,
+                // mutation) pairs over it instead, scoring each read's
+                // mutations on several threads at once.  The reads'
+                // score caches are then only looked in.
+                int nWave = rEnd - rBegin;
+                threadPool_->ParallelFor(nWave * nLive, [&](int p) {
+                    scorePair(rBegin + p % nWave, p / nWave, false);
+                });
+            } else if (parallelReads) {
+                ForEachRead(rBegin, rEnd, scoreRead);
+            } else {
+                for (int j = rBegin; j < rEnd; j++) {
+                    scoreRead(j);
+                }
+            }
+
+            int nKept = 0;
+            for (int k = 0; k < nLive; k++) {
+                int i = block[live[k]];
+                float sum = sums[i];
+                bool rejected = false;
+                for (int j = rBegin; j < rEnd && !rejected; j++) {
+                    sum += deltas[(j - rBegin) * nLive + k];
+                    rejected = fastReject && sum < fastScoreThreshold_;
+                }
+                sums[i] = sum;
+                if (!rejected) live[nKept++] = live[k];
+            }
+            live.resize(nKept);
+        }
+
+        if (fastReject && !live.empty()) {
+            PositionsByRead(reads, &positions);
+            foreach (int k, live) {
+                float sum = 0;
+                foreach (int j, positions) {
+                    sum += blockDeltas[k * nNear + j];
+                }
+                sums[block[k]] = sum;
+            }
+        }
+    }
+}
+
+template <typename R>
+std::vector<float> MultiReadMutationScorer<R>::ScoreMany(
+    const std::vector<Mutation>& mutations) const
+{
+    std::vector<float> scores(mutations.size());
+    if (!mutations.empty()) ScoreBatch(mutations, false, &scores[0], 0.0f, NULL);
+    return scores;
+}
+
+template <typename R>
+std::vector<float> MultiReadMutationScorer<R>::FastScoreMany(
+    const std::vector<Mutation>& mutations) const
+{
+    std::vector<float> scores(mutations.size());
+    if (!mutations.empty()) ScoreBatch(mutations, true, &scores[0], 0.0f, NULL);
+    return scores;
+}
+
+template <typename R>
+std::vector<float> MultiReadMutationScorer<R>::ScoresMany(const std::vector<Mutation>& mutations,
+                                                          float unscoredValue) const
+{
+    std::vector<float> sums(mutations.size());
+    std::vector<float> scoresByRead(mutations.size() * NumReads());
+    if (!scoresByRead.empty()) {
+        ScoreBatch(mutations, false, &sums[0], unscoredValue, &scoresByRead[0]);
+    }
+    return scoresByRead;
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::ScoresManyInto(const std::vector<Mutation>& mutations,
+                                                float unscoredValue, float* scores,
+                                                int nMutations, int nReads) const
+{
+    if (nMutations != static_cast<int>(mutations.size()) || nReads != NumReads()) {
+        throw InvalidInputError("Scores array must be mutations x reads");
+    }
+    std::vector<float> sums(nMutations);
+    if (nMutations > 0 && nReads > 0) {
+        ScoreBatch(mutations, false, &sums[0], unscoredValue, scores);
+    }
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::SetNumThreads(int numThreads)
+{
+    if (numThreads <= 1) {
+        threadPool_.reset();
+    } else if (NumThreads() != numThreads) {
+        threadPool_.reset(new ThreadPool(numThreads));
+    }
+}
+
+template <typename R>
+int MultiReadMutationScorer<R>::NumThreads() const
+{
+    return threadPool_ ? threadPool_->NumThreads() : 1;
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::SetScorerCache(
+    const boost::shared_ptr<ReadScorerCache<ScorerType> >& cache)
+{
+    scorerCache_ = cache;
+}
+
+template <typename R>
+const boost::shared_ptr<ReadScorerCache<typename MultiReadMutationScorer<R>::ScorerType> >&
+MultiReadMutationScorer<R>::ScorerCache() const
+{
+    return scorerCache_;
+}
+
+namespace {  // PRIVATE
+const char SCORER_MAGIC[8] = {'C', 'C', 'S', 'C', 'O', 'R', 'E', 0};
+const uint32_t SCORER_VERSION = 2;
+const uint32_t SCORER_BYTE_ORDER_MARK = 0x01020304;
+
+struct ScorerHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ByteOrder;
+    uint64_t UnitBytes;
+    int64_t NumReadsAdded;
+    uint64_t NumDropped;
+    uint64_t NumStandbys;
+    int64_t MemoryBudget;
+    int32_t CoverageCap;
+    uint32_t CacheScores;
+};
+
+struct SavedStandby
+{
+    int32_t Read;
+    float Threshold;
+};
+
+// Whether a read is active, and its FillStatistics, field by field
+struct SavedRead
+{
+    uint32_t IsActive;
+    int32_t Passes;
+    int32_t FlipFlops;
+    int32_t AlphaUsedEntries;
+    int32_t AlphaAllocatedEntries;
+    int32_t BetaUsedEntries;
+    int32_t BetaAllocatedEntries;
+    float Seconds;
+};
+
+// A private, read-only mapping of a whole file
+class FileMapping : private boost::noncopyable
+{
+public:
+    explicit FileMapping(const std::string& filename) : Data(NULL), Size(0)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw InvalidInputError("Can't open saved scorer " + filename);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ScorerHeader))) {
+            close(fd);
+            throw InvalidInputError(filename + " is not a saved scorer");
+        }
+        Size = st.st_size;
+        void* data = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw InvalidInputError("Can't map saved scorer " + filename);
+        }
+        Data = static_cast<char*>(data);
+    }
+
+    ~FileMapping() { munmap(Data, Size); }
+
+    char* Data;
+    uint64_t Size;
+};
+
+// The shape of m, the used rows of each of its columns, and the used
+// entries, packed column after column as ToHostBand packs them
+template <typename M>
+void WriteBands(detail::SectionWriter* out, const M& m)
+{
+    int32_t shape[2] = {m.Rows(), m.Columns()};
+    std::vector<int32_t> ranges;
+    std::vector<float> values;
+    for (int j = 0; j < m.Columns(); j++) {
+        Interval used = m.UsedRowRange(j);
+        ranges.push_back(used.Begin);
+        ranges.push_back(used.End);
+        for (int i = used.Begin; i < used.End; i++) {
+            values.push_back(m.Get(i, j));
+        }
+    }
+    uint64_t numValues = values.size();
+    out->Write(shape, sizeof(shape));
+    out->Write(&numValues, sizeof(numValues));
+    out->Write(ranges.data(), ranges.size() * sizeof(int32_t));
+    out->Write(values.data(), numValues * sizeof(float));
+}
+
+// Fill m, already of the shape WriteBands wrote, from the bands it wrote
+template <typename M>
+void ReadBands(detail::SectionReader* in, M* m)
+{
+    int32_t shape[2];
+    std::memcpy(shape, in->Take(sizeof(shape)), sizeof(shape));
+    uint64_t numValues = in->TakeValue<uint64_t>();
+    if (shape[0] != m->Rows() || shape[1] != m->Columns()) {
+        throw InvalidInputError("Saved scorer does not match its reads");
+    }
+    std::vector<int32_t> ranges = in->TakeValues<int32_t>(2 * m->Columns());
+    std::vector<float> values = in->TakeValues<float>(numValues);
+    uint64_t offset = 0;
+    for (int j = 0; j < m->Columns(); j++) {
+        int begin = ranges[2 * j];
+        int end = ranges[2 * j + 1];
+        if (begin < 0 || begin > end || end > m->Rows() ||
+            static_cast<uint64_t>(end - begin) > numValues - offset) {
+            throw InvalidInputError("Saved scorer is corrupt");
+        }
+        if (begin == end) continue;
+        const float* column = values.data() + offset - begin;
+        m->StartEditingColumn(j, begin, end);
+        int i = begin;
+        for (; i + 4 <= end; i += 4) {
+            m->Set4(i, j, _mm_loadu_ps(column + i));
+        }
+        for (; i < end; i++) {
+            m->Set(i, j, column[i]);
+        }
+        m->FinishEditingColumn(j, begin, end);
+        offset += end - begin;
+    }
+    if (offset != numValues) {
+        throw InvalidInputError("Saved scorer is corrupt");
+    }
+}
+}  // PRIVATE
+
+template <typename R>
+void MultiReadMutationScorer<R>::Save(const std::string& filename) const
+{
+    WakeReads();
+    WorkUnit unit(0, fwdTemplate_);
+    foreach (const ReadStateType& rs, reads_) {
+        if (rs.IsActive && rs.Scorer->CheckpointInterval() != 0) {
+            throw UnsupportedFeatureError("Can't save scorers that keep checkpoints only");
+        }
+        unit.Reads.push_back(*rs.Read);
+    }
+    std::string unitBytes = EncodeWorkUnit(unit);
+
+    ScorerHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.Magic, SCORER_MAGIC, sizeof(h.Magic));
+    h.Version = SCORER_VERSION;
+    h.ByteOrder = SCORER_BYTE_ORDER_MARK;
+    h.UnitBytes = unitBytes.size();
+    h.NumReadsAdded = numReadsAdded_;
+    h.NumDropped = droppedReads_.size();
+    h.NumStandbys = standbys_.size();
+    h.MemoryBudget = memoryBudget_;
+    h.CoverageCap = coverageCap_;
+    h.CacheScores = cacheScores_;
+
+    std::vector<int32_t> indices(readIndices_.begin(), readIndices_.end());
+    std::vector<int32_t> dropped(droppedReads_.begin(), droppedReads_.end());
+    std::vector<SavedStandby> standbys;
+    for (size_t k = 0; k < standbys_.size(); k++) {
+        SavedStandby s = {standbys_[k].first, standbys_[k].second};
+        standbys.push_back(s);
+    }
+
+    std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw InvalidInputError("Can't create saved scorer " + filename);
+    }
+    detail::SectionWriter out(&file);
+    out.Write(&h, sizeof(h));
+    out.Write(unitBytes.data(), unitBytes.size());
+    out.Write(indices.data(), indices.size() * sizeof(int32_t));
+    out.Write(dropped.data(), dropped.size() * sizeof(int32_t));
+    out.Write(standbys.data(), standbys.size() * sizeof(SavedStandby));
+    foreach (const ReadStateType& rs, reads_) {
+        FillStatistics stats = rs.IsActive ? rs.Scorer->FillStats() : FillStatistics();
+        SavedRead r = SavedRead();
+        r.IsActive = rs.IsActive;
+        r.Passes = stats.Passes;
+        r.FlipFlops = stats.FlipFlops;
+        r.AlphaUsedEntries = stats.AlphaUsedEntries;
+        r.AlphaAllocatedEntries = stats.AlphaAllocatedEntries;
+        r.BetaUsedEntries = stats.BetaUsedEntries;
+        r.BetaAllocatedEntries = stats.BetaAllocatedEntries;
+        r.Seconds = stats.Seconds;
+        out.Write(&r, sizeof(r));
+        if (rs.IsActive) {
+            WriteBands(&out, *rs.Scorer->Alpha());
+            WriteBands(&out, *rs.Scorer->Beta());
+        }
+    }
+    if (!file.flush()) {
+        throw InvalidInputError("Can't write saved scorer " + filename);
+    }
+}
+
+template <typename R>
+MultiReadMutationScorer<R>* MultiReadMutationScorer<R>::Restore(const QuiverConfigTable& configs,
+                                                                const std::string& filename)
+{
+    FileMapping mapping(filename);
+    detail::SectionReader in(mapping.Data, mapping.Size, filename);
+    ScorerHeader h = in.TakeValue<ScorerHeader>();
+    if (std::memcmp(h.Magic, SCORER_MAGIC, sizeof(h.Magic)) != 0) {
+        throw InvalidInputError(filename + " is not a saved scorer");
+    }
+    if (h.ByteOrder != SCORER_BYTE_ORDER_MARK) {
+        throw InvalidInputError(filename + " was written in another byte order");
+    }
+    if (h.Version != SCORER_VERSION) {
+        throw InvalidInputError(filename + " was written in an unsupported version");
+    }
+    if (h.NumReadsAdded < 0 || h.NumReadsAdded > INT32_MAX || h.NumDropped > mapping.Size ||
+        h.NumStandbys > mapping.Size) {
+        throw InvalidInputError(filename + " is truncated");
+    }
+
+    // The reads are copied out of the mapping, which goes with this call
+    WorkUnit unit = DecodeWorkUnit(
+        boost::shared_ptr<std::string>(new std::string(in.TakeString(h.UnitBytes))));
+    int numLive = unit.Reads.size();
+    std::vector<int32_t> indices = in.TakeValues<int32_t>(numLive);
+    std::vector<int32_t> dropped = in.TakeValues<int32_t>(h.NumDropped);
+    std::vector<SavedStandby> standbys = in.TakeValues<SavedStandby>(h.NumStandbys);
+
+    std::unique_ptr<MultiReadMutationScorer<R> > mms(
+        new MultiReadMutationScorer<R>(configs, unit.Template));
+    int L = unit.Template.length();
+    for (int k = 0; k < numLive; k++) {
+        const MappedRead& mr = unit.Reads[k];
+        if (indices[k] < 0 || indices[k] >= h.NumReadsAdded ||
+            (k > 0 && indices[k] <= indices[k - 1]) || mr.TemplateStart < 0 ||
+            mr.TemplateStart > mr.TemplateEnd || mr.TemplateEnd > L) {
+            throw InvalidInputError(filename + " is corrupt");
+        }
+        SavedRead r = in.TakeValue<SavedRead>();
+        mms->reads_.push_back(ReadStateType(new MappedRead(mr), NULL, false));
+        mms->readIndices_.push_back(indices[k]);
+        if (!r.IsActive) continue;
+        FillStatistics stats;
+        stats.Passes = r.Passes;
+        stats.FlipFlops = r.FlipFlops;
+        stats.AlphaUsedEntries = r.AlphaUsedEntries;
+        stats.AlphaAllocatedEntries = r.AlphaAllocatedEntries;
+        stats.BetaUsedEntries = r.BetaUsedEntries;
+        stats.BetaAllocatedEntries = r.BetaAllocatedEntries;
+        stats.Seconds = r.Seconds;
+
+        const boost::shared_ptr<MappedRead>& read = mms->reads_.back().Read;
+        const QuiverConfig& config = configs.At(read->Chemistry);
+        std::string tpl = mms->Template(read->Strand, read->TemplateStart, read->TemplateEnd);
+        EvaluatorType ev(boost::shared_ptr<const ConsensusCore::Read>(read), tpl, config.Model);
+        RecursorType recursor(config.MovesAvailable,
+                              ReadBanding(config.Banding, read->Features, tpl.length()),
+                              config.Recursor);
+        ScorerType* scorer = new ScorerType(
+            ev, recursor,
+            [&in](typename ScorerType::MatrixType* alpha, typename ScorerType::MatrixType* beta) {
+                ReadBands(&in, alpha);
+                ReadBands(&in, beta);
+            },
+            stats, config.CheckpointInterval);
+        mms->ActivateRead(k, scorer);
+    }
+    if (!in.AtEnd()) {
+        throw InvalidInputError(filename + " is corrupt");
+    }
+    mms->RebuildReadIndex();
+
+    for (uint64_t k = 0; k < h.NumDropped; k++) {
+        if (dropped[k] < 0 || dropped[k] >= h.NumReadsAdded) {
+            throw InvalidInputError(filename + " is corrupt");
+        }
+        mms->droppedReads_.push_back(dropped[k]);
+    }
+    for (uint64_t k = 0; k < h.NumStandbys; k++) {
+        if (standbys[k].Read < 0 || standbys[k].Read >= numLive ||
+            mms->reads_[standbys[k].Read].IsActive) {
+            throw InvalidInputError(filename + " is corrupt");
+        }
+        mms->standbys_.push_back(std::make_pair(standbys[k].Read, standbys[k].Threshold));
+    }
+    mms->numReadsAdded_ = h.NumReadsAdded;
+    mms->memoryBudget_ = h.MemoryBudget;
+    mms->coverageCap_ = h.CoverageCap;
+    mms->cacheScores_ = h.CacheScores;
+    DEBUG_ONLY(mms->CheckInvariants());
+    return mms.release();
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::SetThreadPool(const boost::shared_ptr<ThreadPool>& pool)
+{
+    threadPool_ = pool;
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::Hibernate()
+{
+    foreach (ReadStateType& rs, reads_) {
+        if (rs.Scorer != NULL) rs.Scorer->Hibernate();
+    }
+    hibernating_ = true;
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::Wake()
+{
+    WakeReads();
+}
+
+template <typename R>
+bool MultiReadMutationScorer<R>::IsHibernating() const
+{
+    return hibernating_;
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::WakeReads() const
+{
+    if (!hibernating_) return;
+    // The refills, like the first fills, are independent, and are
+    // spread over the pool
+    ForEachRead(0, reads_.size(), [&](int r) {
+        if (reads_[r].Scorer != NULL) reads_[r].Scorer->Wake();
+    });
+    hibernating_ = false;
+}
+
+template <typename R>
+std::vector<int> MultiReadMutationScorer<R>::AllocatedMatrixEntries() const
+{
+    // Reads on standby, rejected or dropped have no matrices
+    std::vector<int> allocatedCounts(NumReads(), 0);
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        const ScorerType* scorer = reads_[r].Scorer;
+        if (scorer != NULL && !scorer->IsHibernating()) {
+            allocatedCounts[readIndices_[r]] =
+                scorer->Alpha()->AllocatedEntries() + scorer->Beta()->AllocatedEntries();
+        }
+    }
+    return allocatedCounts;
+}
+
+template <typename R>
+MemoryUsage MultiReadMutationScorer<R>::Memory() const
+{
+    // A score cache entry is a node of a red-black tree: the entry, and
+    // three links and a colour
+    const int64_t cacheEntryBytes = sizeof(std::pair<const Mutation, float>) + 4 * sizeof(void*);
+
+    MemoryUsage usage;
+    usage.ScorerBytes = sizeof(*this) + fwdTemplate_.capacity() + revTemplate_.capacity() +
+                        reads_.capacity() * sizeof(ReadStateType) +
+                        (readIndices_.capacity() + readsByStart_.capacity() +
+                         readStarts_.capacity() + extentStarts_.capacity() +
+                         extentEnds_.capacity() + droppedReads_.capacity()) *
+                            sizeof(int) +
+                        (rejectPriority_.capacity() + baselineScores_.capacity()) * sizeof(float) +
+                        isActive_.capacity() + isReverse_.capacity() +
+                        standbys_.capacity() * sizeof(std::pair<int, float>);
+    foreach (const ReadStateType& rs, reads_) {
+        const MappedRead& mr = *rs.Read;
+        usage.FeatureBytes += mr.Features.AllocatedBytes();
+        usage.ScorerBytes += sizeof(MappedRead) + mr.Name.capacity() + mr.Chemistry.capacity() +
+                             mr.BandHint.capacity() * sizeof(Interval) +
+                             rs.ScoreCache.size() * cacheEntryBytes;
+        if (rs.Scorer != NULL) rs.Scorer->AddMemoryUsage(&usage);
+    }
+    return usage;
+}
+
+template <typename R>
+std::vector<int> MultiReadMutationScorer<R>::UsedMatrixEntries() const
+{
+    std::vector<int> usedCounts(NumReads(), 0);
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        const ScorerType* scorer = reads_[r].Scorer;
+        if (scorer != NULL && !scorer->IsHibernating()) {
+            usedCounts[readIndices_[r]] =
+                scorer->Alpha()->UsedEntries() + scorer->Beta()->UsedEntries();
+        }
+    }
+    return usedCounts;
+}
+
+template <typename R>
+const AbstractMatrix* MultiReadMutationScorer<R>::AlphaMatrix(int i) const
+{
+    WakeReads();
+    int r = LivePosition(i);
+    return r >= 0 && reads_[r].Scorer != NULL ? reads_[r].Scorer->Alpha() : NULL;
+}
+
+template <typename R>
+const AbstractMatrix* MultiReadMutationScorer<R>::BetaMatrix(int i) const
+{
+    WakeReads();
+    int r = LivePosition(i);
+    return r >= 0 && reads_[r].Scorer != NULL ? reads_[r].Scorer->Beta() : NULL;
+}
+
+template <typename R>
+std::vector<int> MultiReadMutationScorer<R>::NumFlipFlops() const
+{
+    std::vector<int> nFlipFlops(NumReads(), 0);
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        if (reads_[r].Scorer != NULL) {
+            nFlipFlops[readIndices_[r]] = reads_[r].Scorer->NumFlipFlops();
+        }
+    }
+    return nFlipFlops;
+}
+
+template <typename R>
+std::vector<FillStatistics> MultiReadMutationScorer<R>::FillStats() const
+{
+    std::vector<FillStatistics> stats(NumReads());
+    for (int r = 0; r < static_cast<int>(reads_.size()); r++) {
+        if (reads_[r].Scorer != NULL) {
+            stats[readIndices_[r]] = reads_[r].Scorer->FillStats();
+        }
+    }
+    return stats;
+}
+
+template <typename R>
+std::vector<CompactAlignment> MultiReadMutationScorer<R>::Alignments() const
+{
+    if (!boost::is_same<typename R::CombinerType, detail::ViterbiCombiner>::value) {
+        throw InvalidInputError("Alignments need a Viterbi recursor");
+    }
+    WakeReads();
+    std::vector<CompactAlignment> alignments(NumReads());
+    ForEachRead(0, reads_.size(), [&](int r) {
+        if (reads_[r].IsActive) alignments[readIndices_[r]] = reads_[r].Scorer->Traceback();
+    });
+    return alignments;
+}
+
+template <typename R>
+float MultiReadMutationScorer<R>::BaselineScore() const
+{
+    float sum = 0;
+    for (size_t r = 0; r < baselineScores_.size(); r++) {
+        if (isActive_[r]) sum += baselineScores_[r];
+    }
+    return sum;
+}
+
+template <typename R>
+std::vector<float> MultiReadMutationScorer<R>::BaselineScores() const
+{
+    std::vector<float> scoreByRead;
+    for (size_t r = 0; r < baselineScores_.size(); r++) {
+        if (isActive_[r]) scoreByRead.push_back(baselineScores_[r]);
+    }
+    return scoreByRead;
+}
+
+template <typename R>
+void MultiReadMutationScorer<R>::CheckInvariants() const
+{
+#ifndef NDEBUG
+    assert(revTemplate_ == ReverseComplement(fwdTemplate_));
+    assert(readIndices_.size() == reads_.size());
+    assert(std::is_sorted(readIndices_.begin(), readIndices_.end()));
+    assert(readIndices_.empty() || readIndices_.back() < numReadsAdded_);
+    assert(isActive_.size() == reads_.size() && baselineScores_.size() == reads_.size());
+    foreach (const ReadStateType& rs, reads_) {
+        rs.CheckInvariants();
+        if (rs.IsActive) {
+            int r = &rs - &reads_[0];
+            assert(isActive_[r] && baselineScores_[r] == rs.Scorer->Score());
+            assert(extentStarts_[r] == rs.Read->TemplateStart);
+            assert(extentEnds_[r] == rs.Read->TemplateEnd);
+            assert(rs.Scorer->Template() ==
+                   Template(rs.Read->Strand, rs.Read->TemplateStart, rs.Read->TemplateEnd));
+            assert(0 <= rs.Read->TemplateStart &&
+                   rs.Read->TemplateStart <= static_cast<int>(fwdTemplate_.size()));
+            assert(0 <= rs.Read->TemplateEnd &&
+                   rs.Read->TemplateEnd <= static_cast<int>(fwdTemplate_.size()));
+            assert(rs.Read->TemplateStart <= rs.Read->TemplateEnd);
+        }
+    }
+#endif  // !NDEBUG
+}
+
+template <typename R>
+std::string MultiReadMutationScorer<R>::ToString() const
+{
+    std::stringstream ss;
+
+    ss << "Template: " << Template() << std::endl;
+    ss << "Score: " << BaselineScore() << std::endl;
+
+    ss << "Reads:" << std::endl;
+    foreach (const ReadStateType& rs, reads_) {
+        ss << "\t" << rs.ToString() << std::endl;
+    }
+    return ss.str();
+}
+
+namespace detail {
+
+template <typename ScorerType>
+ReadState<ScorerType>::ReadState(MappedRead* read, ScorerType* scorer, bool isActive)
+    : Read(read), Scorer(scorer), IsActive(isActive), ScoreCache()
+{
+    CheckInvariants();
+}
+
+template <typename ScorerType>
+ReadState<ScorerType>::ReadState(const ReadState& other)
+    : Read(), Scorer(NULL), IsActive(other.IsActive), ScoreCache(other.ScoreCache)
+{
+    // The copy's mapping changes with its own template
+    if (other.Read) Read.reset(new MappedRead(*other.Read));
+    if (other.Scorer != NULL) Scorer = new ScorerType(*other.Scorer);
+    CheckInvariants();
+}
+
+template <typename ScorerType>
+ReadState<ScorerType>::ReadState(ReadState&& other) noexcept
+    : Read(), Scorer(other.Scorer), IsActive(other.IsActive), ScoreCache()
+{
+    Read.swap(other.Read);
+    ScoreCache.swap(other.ScoreCache);
+    other.Scorer = NULL;
+}
+
+template <typename ScorerType>
+ReadState<ScorerType>& ReadState<ScorerType>::operator=(ReadState&& other) noexcept
+{
+    // other takes our scorer, for its destructor to delete
+    Read.swap(other.Read);
+    std::swap(Scorer, other.Scorer);
+    IsActive = other.IsActive;
+    ScoreCache.swap(other.ScoreCache);
+    return *this;
 }
 
 template <typename ScorerType>
 ReadState<ScorerType>::~ReadState()
 {
-    if (Read != NULL) delete Read;
     if (Scorer != NULL) delete Scorer;
 }
 
@@ -433,7 +2044,7 @@ void ReadState<ScorerType>::CheckInvariants() const
 {
 #ifndef NDEBUG
     if (IsActive) {
-        assert(Read != NULL && Scorer != NULL);
+        assert(Read && Scorer != NULL);
         assert(static_cast<int>(Scorer->Template().length()) ==
                Read->TemplateEnd - Read->TemplateStart);
     }
@@ -0,0 +1,341 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/MultiTemplateScorer.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include <ConsensusCore/Quiver/Int16Recursor.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/ScaledRecursor.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+// The likelihood of a read whose matrices are too big to keep, or
+// -FLT_MAX, from a recursor that needs only a few columns at a time
+template <typename R>
+float ColumnScore(const QuiverConfig& config, const BandingOptions& banding,
+                  const QvEvaluator& ev);
+
+template <>
+float ColumnScore<SparseSseQvRecursor>(const QuiverConfig& config, const BandingOptions& banding,
+                                       const QvEvaluator& ev)
+{
+    return Int16ViterbiRecursor(config.MovesAvailable, banding).Score(ev);
+}
+
+template <>
+float ColumnScore<SparseSseQvSumProductRecursor>(const QuiverConfig& config,
+                                                 const BandingOptions& banding,
+                                                 const QvEvaluator& ev)
+{
+    return ScaledSumProductRecursor(config.MovesAvailable, banding).Score(ev);
+}
+}
+
+template <typename R>
+MultiTemplateScorer<R>::MultiTemplateScorer(const QuiverConfigTable& configs,
+                                            const std::vector<std::string>& templates)
+    : configs_(configs), fwdTemplates_(templates), scoreUnheldReads_(false)
+{
+    foreach (const std::string& tpl, templates) {
+        revTemplates_.push_back(ReverseComplement(tpl));
+    }
+}
+
+template <typename R>
+MultiTemplateScorer<R>::~MultiTemplateScorer()
+{
+    foreach (ReadEntry& entry, reads_) {
+        foreach (ScorerType* scorer, entry.Scorers) {
+            delete scorer;
+        }
+    }
+}
+
+template <typename R>
+int MultiTemplateScorer<R>::NumTemplates() const
+{
+    return fwdTemplates_.size();
+}
+
+template <typename R>
+std::string MultiTemplateScorer<R>::Template(int templateIdx) const
+{
+    CheckTemplateIdx(templateIdx);
+    return fwdTemplates_[templateIdx];
+}
+
+template <typename R>
+int MultiTemplateScorer<R>::NumReads() const
+{
+    return reads_.size();
+}
+
+template <typename R>
+const MappedRead* MultiTemplateScorer<R>::Read(int readIdx) const
+{
+    return reads_.at(readIdx).Read.get();
+}
+
+template <typename R>
+void MultiTemplateScorer<R>::SetNumThreads(int numThreads)
+{
+    if (numThreads <= 1) {
+        threadPool_.reset();
+    } else if (NumThreads() != numThreads) {
+        threadPool_.reset(new ThreadPool(numThreads));
+    }
+}
+
+template <typename R>
+int MultiTemplateScorer<R>::NumThreads() const
+{
+    return threadPool_ ? threadPool_->NumThreads() : 1;
+}
+
+template <typename R>
+void MultiTemplateScorer<R>::SetScoreUnheldReads(bool scoreUnheldReads)
+{
+    scoreUnheldReads_ = scoreUnheldReads;
+}
+
+template <typename R>
+bool MultiTemplateScorer<R>::ScoreUnheldReads() const
+{
+    return scoreUnheldReads_;
+}
+
+template <typename R>
+void MultiTemplateScorer<R>::CheckTemplateIdx(int templateIdx) const
+{
+    if (templateIdx < 0 || templateIdx >= NumTemplates()) {
+        throw InvalidInputError("No such template");
+    }
+}
+
+template <typename R>
+void MultiTemplateScorer<R>::ForEach(int n, const std::function<void(int)>& fn) const
+{
+    if (NumThreads() == 1 || n < 2) {
+        for (int i = 0; i < n; i++) {
+            fn(i);
+        }
+    } else {
+        threadPool_->ParallelFor(n, fn);
+    }
+}
+
+template <typename R>
+void MultiTemplateScorer<R>::Fill(const std::vector<std::pair<int, int> >& pairs)
+{
+    // Each pair's scorer slot is written by the one worker filling it,
+    // and the evaluators' copies only read the tracks they share
+    ForEach(pairs.size(), [&](int k) {
+        ReadEntry& entry = reads_[pairs[k].first];
+        int t = pairs[k].second;
+        const QuiverConfig& config = configs_.At(entry.Read->Chemistry);
+        const std::string& tpl =
+            (entry.Read->Strand == FORWARD_STRAND) ? fwdTemplates_[t] : revTemplates_[t];
+        EvaluatorType ev(*entry.Evaluator);
+        ev.Template(tpl);
+        BandingOptions banding = ReadBanding(config.Banding, entry.Read->Features, tpl.length());
+        R recursor(config.MovesAvailable, banding, config.Recursor);
+
+        delete entry.Scorers[t];
+        entry.Scorers[t] = NULL;
+        entry.ColumnScores[t] = -FLT_MAX;
+        ScorerType* scorer = NULL;
+        try {
+            scorer = new ScorerType(ev, recursor, config.CheckpointInterval);
+        } catch (AlphaBetaMismatchException&) {
+            return;
+        }
+        int maxSize = static_cast<int>(0.5f + config.AddThreshold * (entry.Read->Length() + 1) *
+                                                  (tpl.length() + 1));
+        const FillStatistics& stats = scorer->FillStats();
+        if (config.AddThreshold < 1.0f &&
+            (stats.AlphaAllocatedEntries >= maxSize || stats.BetaAllocatedEntries >= maxSize)) {
+            delete scorer;
+            if (scoreUnheldReads_) entry.ColumnScores[t] = ColumnScore<R>(config, banding, ev);
+            return;
+        }
+        entry.Scorers[t] = scorer;
+    });
+}
+
+template <typename R>
+int MultiTemplateScorer<R>::AddRead(const MappedRead& mr)
+{
+    AddReads(std::vector<MappedRead>(1, mr));
+    int scored = 0;
+    for (int t = 0; t < NumTemplates(); t++) {
+        if (IsScored(NumReads() - 1, t)) scored++;
+    }
+    return scored;
+}
+
+template <typename R>
+void MultiTemplateScorer<R>::AddReads(const std::vector<MappedRead>& reads)
+{
+    std::vector<std::pair<int, int> > pairs;
+    foreach (const MappedRead& mr, reads) {
+        const QuiverConfig& config = configs_.At(mr.Chemistry);
+        ReadEntry entry;
+        entry.Read = boost::make_shared<const MappedRead>(mr);
+        // The move scores are computed here, once for every template
+        entry.Evaluator = boost::make_shared<EvaluatorType>(
+            boost::shared_ptr<const ConsensusCore::Read>(entry.Read), "", config.Model,
+            mr.PinStart, mr.PinEnd);
+        entry.Scorers.assign(NumTemplates(), NULL);
+        entry.ColumnScores.assign(NumTemplates(), -FLT_MAX);
+        for (int t = 0; t < NumTemplates(); t++) {
+            pairs.push_back(std::make_pair(static_cast<int>(reads_.size()), t));
+        }
+        reads_.push_back(entry);
+    }
+    Fill(pairs);
+}
+
+template <typename R>
+std::vector<float> MultiTemplateScorer<R>::Scores(float unscoredValue) const
+{
+    std::vector<float> scores;
+    scores.reserve(NumReads() * NumTemplates());
+    for (int r = 0; r < NumReads(); r++) {
+        std::vector<float> readScores = ReadScores(r, unscoredValue);
+        scores.insert(scores.end(), readScores.begin(), readScores.end());
+    }
+    return scores;
+}
+
+template <typename R>
+std::vector<float> MultiTemplateScorer<R>::ReadScores(int readIdx, float unscoredValue) const
+{
+    const ReadEntry& entry = reads_.at(readIdx);
+    std::vector<float> scores(NumTemplates(), unscoredValue);
+    for (int t = 0; t < NumTemplates(); t++) {
+        if (entry.Scorers[t] != NULL) {
+            scores[t] = entry.Scorers[t]->Score();
+        } else if (entry.ColumnScores[t] > -FLT_MAX) {
+            scores[t] = entry.ColumnScores[t];
+        }
+    }
+    return scores;
+}
+
+template <typename R>
+std::vector<int> MultiTemplateScorer<R>::AssignReads(float minMargin) const
+{
+    std::vector<int> assignment(NumReads(), -1);
+    for (int r = 0; r < NumReads(); r++) {
+        std::vector<float> scores = ReadScores(r, -FLT_MAX);
+        int best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+        if (best >= NumTemplates() || !IsScored(r, best)) continue;
+        float runnerUp = -FLT_MAX;
+        for (int t = 0; t < NumTemplates(); t++) {
+            if (t != best && IsScored(r, t)) runnerUp = std::max(runnerUp, scores[t]);
+        }
+        if (runnerUp == -FLT_MAX || scores[best] - runnerUp >= minMargin) {
+            assignment[r] = best;
+        }
+    }
+    return assignment;
+}
+
+template <typename R>
+bool MultiTemplateScorer<R>::IsScored(int readIdx, int templateIdx) const
+{
+    const ReadEntry& entry = reads_[readIdx];
+    return entry.Scorers[templateIdx] != NULL || entry.ColumnScores[templateIdx] > -FLT_MAX;
+}
+
+template <typename R>
+Mutation MultiTemplateScorer<R>::Oriented(int templateIdx, const MappedRead& mr,
+                                          const Mutation& m) const
+{
+    if (mr.Strand == FORWARD_STRAND) return m;
+    int L = fwdTemplates_[templateIdx].length();
+    std::string rc(m.NewBasesLength(), 'N');
+    ReverseComplement(m.NewBasesData(), m.NewBasesLength(), &rc[0]);
+    return Mutation(m.Type(), L - m.End(), L - m.Start(), rc);
+}
+
+template <typename R>
+float MultiTemplateScorer<R>::Score(int templateIdx, const Mutation& m) const
+{
+    std::vector<int> reads(NumReads());
+    for (int r = 0; r < NumReads(); r++) {
+        reads[r] = r;
+    }
+    return Score(templateIdx, m, reads);
+}
+
+template <typename R>
+float MultiTemplateScorer<R>::Score(int templateIdx, const Mutation& m,
+                                    const std::vector<int>& reads) const
+{
+    CheckTemplateIdx(templateIdx);
+    float sum = 0;
+    foreach (int r, reads) {
+        const ReadEntry& entry = reads_.at(r);
+        const ScorerType* scorer = entry.Scorers[templateIdx];
+        if (scorer == NULL) continue;
+        sum += scorer->ScoreMutation(Oriented(templateIdx, *entry.Read, m)) - scorer->Score();
+    }
+    return sum;
+}
+
+template <typename R>
+std::vector<float> MultiTemplateScorer<R>::ScoreMany(int templateIdx,
+                                                     const std::vector<Mutation>& mutations,
+                                                     const std::vector<int>& reads) const
+{
+    CheckTemplateIdx(templateIdx);
+    std::vector<float> scores(mutations.size());
+    ForEach(mutations.size(), [&](int k) { scores[k] = Score(templateIdx, mutations[k], reads); });
+    return scores;
+}
+
+template <typename R>
+void MultiTemplateScorer<R>::ApplyMutations(int templateIdx, const std::vector<Mutation>& mutations)
+{
+    CheckTemplateIdx(templateIdx);
+    std::string& tpl = fwdTemplates_[templateIdx];
+    tpl = ConsensusCore::ApplyMutations(mutations, tpl);
+    revTemplates_[templateIdx] = ReverseComplement(tpl);
+
+    std::vector<std::pair<int, int> > pairs;
+    for (int r = 0; r < NumReads(); r++) {
+        pairs.push_back(std::make_pair(r, templateIdx));
+    }
+    Fill(pairs);
+}
+
+template <typename R>
+int64_t MultiTemplateScorer<R>::AllocatedMatrixEntries() const
+{
+    int64_t entries = 0;
+    foreach (const ReadEntry& entry, reads_) {
+        foreach (const ScorerType* scorer, entry.Scorers) {
+            if (scorer == NULL) continue;
+            const FillStatistics& stats = scorer->FillStats();
+            entries += stats.AlphaAllocatedEntries + stats.BetaAllocatedEntries;
+        }
+    }
+    return entries;
+}
+
+template class MultiTemplateScorer<SparseSseQvRecursor>;
+template class MultiTemplateScorer<SparseSseQvSumProductRecursor>;
+}
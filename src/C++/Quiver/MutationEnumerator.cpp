@@ -1,28 +1,114 @@
 // Author: David Alexander
 
 #include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
 #include <ConsensusCore/Quiver/MutationEnumerator.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
 #include <ConsensusCore/Types.hpp>
 #include <ConsensusCore/Utils.hpp>
 
-#include <boost/range/as_array.hpp>
-#include <boost/tuple/tuple.hpp>
+#include <algorithm>
 #include <string>
-#include <utility>
 #include <vector>
 
 namespace ConsensusCore {
 namespace {  // PRIVATE
 const char BASES[] = {'A', 'C', 'G', 'T'};
 
-inline int BoundPosition(const std::string& tpl, int pos)
+// A pileup counts, at each template position, the reads showing each
+// of its nine possible mutations: substitutions and insertions of each
+// base, then the deletion, in the order they are listed in
+enum
 {
-    return pos < 0 ? 0 : (pos > static_cast<int>(tpl.length()) ? tpl.length() : pos);
+    SUBSTITUTION_EVENT = 0,
+    INSERTION_EVENT = 4,
+    DELETION_EVENT = 8,
+    SITE_EVENTS = 9
+};
+
+int BaseIndex(char base)
+{
+    switch (base) {
+        case 'A':
+            return 0;
+        case 'C':
+            return 1;
+        case 'G':
+            return 2;
+        case 'T':
+            return 3;
+        default:
+            return -1;
+    }
 }
 
-inline std::pair<int, int> BoundInterval(const std::string& tpl, int beginPos, int endPos)
+// The start of the homopolymer holding position pos
+int HomopolymerStart(const std::string& tpl, int pos)
 {
-    return std::make_pair(BoundPosition(tpl, beginPos), BoundPosition(tpl, endPos));
+    while (pos > 0 && tpl[pos - 1] == tpl[pos]) {
+        pos--;
+    }
+    return pos;
+}
+
+// Add to *events the mutations the alignment of read mr shows, each
+// as its index in the pileup.  The alignment is of the read to the
+// template in the read's orientation; the events are in forward
+// template coordinates.
+void PileupEvents(const std::string& tpl, const MappedRead& mr, const CompactAlignment& aln,
+                  std::vector<int>* events)
+{
+    const bool forward = (mr.Strand == FORWARD_STRAND);
+    const int length = tpl.length();
+    int i = 0;  // read position
+    int j = 0;  // oriented template position
+    for (int r = 0; r < aln.NumRuns(); r++) {
+        for (int k = 0; k < aln.RunLength(r); k++) {
+            // the forward template position of j, and the read base, as
+            // on the forward strand
+            int pos = forward ? mr.TemplateStart + j : mr.TemplateEnd - 1 - j;
+            char base = i < mr.Features.Length() ? mr.Features[i] : 'N';
+            base = forward ? base : ComplementaryBase(base);
+            switch (aln.RunMove(r)) {
+                case INCORPORATE:
+                    if (base != tpl[pos] && BaseIndex(base) >= 0) {
+                        events->push_back(SITE_EVENTS * pos + SUBSTITUTION_EVENT +
+                                          BaseIndex(base));
+                    }
+                    i++;
+                    j++;
+                    break;
+                case EXTRA: {
+                    // The base goes in before template position j; on
+                    // the reverse strand that is after pos
+                    int insPos = forward ? pos : pos + 1;
+                    while (insPos > 0 && tpl[insPos - 1] == base) {
+                        insPos--;
+                    }
+                    if (insPos < length && BaseIndex(base) >= 0) {
+                        events->push_back(SITE_EVENTS * insPos + INSERTION_EVENT +
+                                          BaseIndex(base));
+                    }
+                    i++;
+                    break;
+                }
+                case DELETE:
+                    events->push_back(SITE_EVENTS * HomopolymerStart(tpl, pos) + DELETION_EVENT);
+                    j++;
+                    break;
+                case MERGE:
+                    events->push_back(SITE_EVENTS * HomopolymerStart(tpl, pos) + DELETION_EVENT);
+                    i++;
+                    j += 2;
+                    break;
+                default:
+                    ShouldNotReachHere();
+            }
+        }
+    }
 }
 }  // PRIVATE
 
@@ -45,19 +131,9 @@ std::vector<Mutation> AllSingleBaseMutationEnumerator::Mutations() const
 
 std::vector<Mutation> AllSingleBaseMutationEnumerator::Mutations(int beginPos, int endPos) const
 {
+    PERF_SCOPE(PERF_ENUMERATE_MUTATIONS);
     std::vector<Mutation> result;
-    boost::tie(beginPos, endPos) = BoundInterval(tpl_, beginPos, endPos);
-    for (int pos = beginPos; pos < endPos; pos++) {
-        foreach (char base, boost::as_array(BASES)) {
-            if (base != tpl_[pos]) {
-                result.push_back(Mutation(SUBSTITUTION, pos, base));
-            }
-        }
-        foreach (char base, boost::as_array(BASES)) {
-            result.push_back(Mutation(INSERTION, pos, base));
-        }
-        result.push_back(Mutation(DELETION, pos, '-'));
-    }
+    ForEachMutation(beginPos, endPos, [&](const Mutation& m) { result.push_back(m); });
     return result;
 }
 
@@ -73,89 +149,100 @@ std::vector<Mutation> UniqueSingleBaseMutationEnumerator::Mutations() const
 
 std::vector<Mutation> UniqueSingleBaseMutationEnumerator::Mutations(int beginPos, int endPos) const
 {
+    PERF_SCOPE(PERF_ENUMERATE_MUTATIONS);
     std::vector<Mutation> result;
-    boost::tie(beginPos, endPos) = BoundInterval(tpl_, beginPos, endPos);
-    for (int pos = beginPos; pos < endPos; pos++) {
-        char prevTplBase = pos > 0 ? tpl_[pos - 1] : '-';
-        foreach (char base, boost::as_array(BASES)) {
-            if (base != tpl_[pos]) {
-                result.push_back(Mutation(SUBSTITUTION, pos, base));
-            }
-        }
-        // Insertions only allowed at the beginning of homopolymers
-        foreach (char base, boost::as_array(BASES)) {
-            if (base != prevTplBase) {
-                result.push_back(Mutation(INSERTION, pos, base));
-            }
-        }
-        // Deletions only allowed at the beginning of homopolymers
-        if (tpl_[pos] != prevTplBase) {
-            result.push_back(Mutation(DELETION, pos, '-'));
-        }
-    }
+    ForEachMutation(beginPos, endPos, [&](const Mutation& m) { result.push_back(m); });
     return result;
 }
 
-DinucleotideRepeatMutationEnumerator::DinucleotideRepeatMutationEnumerator(
-    const std::string& tpl, int minDinucRepeatElements)
-    : detail::AbstractMutationEnumerator(tpl), minDinucRepeatElements_(minDinucRepeatElements)
+TandemRepeatMutationEnumerator::TandemRepeatMutationEnumerator(const std::string& tpl,
+                                                               int unitLength, int minElements)
+    : detail::AbstractMutationEnumerator(tpl)
+    , unitLength_(unitLength)
+    , minElements_(minElements)
+    , index_(tpl, unitLength)
 {
 }
 
-std::vector<Mutation> DinucleotideRepeatMutationEnumerator::Mutations() const
+std::vector<Mutation> TandemRepeatMutationEnumerator::Mutations() const
 {
     return Mutations(0, tpl_.length());
 }
 
-std::vector<Mutation> DinucleotideRepeatMutationEnumerator::Mutations(int beginPos,
-                                                                      int endPos) const
+std::vector<Mutation> TandemRepeatMutationEnumerator::Mutations(int beginPos, int endPos) const
 {
+    PERF_SCOPE(PERF_ENUMERATE_MUTATIONS);
     std::vector<Mutation> result;
+    ForEachMutation(beginPos, endPos, [&](const Mutation& m) { result.push_back(m); });
+    return result;
+}
 
-    if (minDinucRepeatElements_ <= 0) return result;
-
-    //
-    // Consider all dinucleotide repeats that _start_ in the window
-    // and don't increment pos here, that happens later
-    //
-    boost::tie(beginPos, endPos) = BoundInterval(tpl_, beginPos, endPos);
-    for (int pos = beginPos; pos + 1 < endPos;) {
-        char x = tpl_[pos];
-        char y = tpl_[pos + 1];
-        int numElements = 1;
-
-        for (int i = pos + 2; i + 1 < static_cast<int>(tpl_.length()); i += 2) {
-            //
-            // if we're beyond the window and have enough elements, stop
-            //
-            if (numElements >= minDinucRepeatElements_ && i >= endPos)
-                break;
-
-            else if (tpl_[i] == x && tpl_[i + 1] == y)
-                numElements++;
-            else
-                break;
-        }
+void TandemRepeatMutationEnumerator::ApplyMutations(const std::vector<Mutation>& mutations)
+{
+    std::string newTpl;
+    ConsensusCore::ApplyMutations(mutations, tpl_, &newTpl);
+    index_.ApplyMutations(mutations, tpl_, newTpl);
+    tpl_.swap(newTpl);
+}
+
+DinucleotideRepeatMutationEnumerator::DinucleotideRepeatMutationEnumerator(
+    const std::string& tpl, int minDinucRepeatElements)
+    : TandemRepeatMutationEnumerator(tpl, 2, minDinucRepeatElements)
+{
+}
 
-        if (numElements >= minDinucRepeatElements_) {
-            std::string dinuc;
-            dinuc.push_back(x);
-            dinuc.push_back(y);
-            result.push_back(Mutation(INSERTION, pos, pos, dinuc));
-            result.push_back(Mutation(DELETION, pos, pos + 2, std::string()));
+PileupMutationEnumerator::PileupMutationEnumerator(const AbstractMultiReadMutationScorer& mms,
+                                                   int minSupport)
+    : detail::AbstractMutationEnumerator(mms.Template()), mutations_()
+{
+    PERF_SCOPE(PERF_ENUMERATE_MUTATIONS);
+    const int length = tpl_.length();
+    std::vector<int> support(SITE_EVENTS * length, 0);
+    std::vector<CompactAlignment> alignments = mms.Alignments();
+    std::vector<int> events;
+    int alignedReads = 0;
+    for (int r = 0; r < static_cast<int>(alignments.size()); r++) {
+        if (alignments[r].Empty()) continue;
+        alignedReads++;
+        events.clear();
+        PileupEvents(tpl_, *mms.Read(r), alignments[r], &events);
+        // a read supports each mutation once, however many of its
+        // bases call for it
+        std::sort(events.begin(), events.end());
+        events.erase(std::unique(events.begin(), events.end()), events.end());
+        foreach (int event, events) {
+            support[event]++;
         }
+    }
 
-        //
-        // Increment by the number of repeats found (if > 1),
-        // less 1 so that we resume on the last base of the repeat,
-        // otherwise just move ahead by 1
-        //
-        if (numElements > 1)
-            pos += 2 * numElements - 1;
-        else
-            pos++;
+    const int threshold = std::max(1, std::min(minSupport, alignedReads));
+    for (int pos = 0; pos < length; pos++) {
+        const int* site = &support[SITE_EVENTS * pos];
+        bool homopolymer =
+            HomopolymerStart(tpl_, pos) == pos && pos + 1 < length && tpl_[pos + 1] == tpl_[pos];
+        for (int b = 0; b < 4; b++) {
+            if (site[SUBSTITUTION_EVENT + b] >= threshold) {
+                mutations_.push_back(Mutation(SUBSTITUTION, pos, BASES[b]));
+            }
+        }
+        for (int b = 0; b < 4; b++) {
+            if (site[INSERTION_EVENT + b] >= threshold ||
+                (homopolymer && BASES[b] == tpl_[pos])) {
+                mutations_.push_back(Mutation(INSERTION, pos, BASES[b]));
+            }
+        }
+        if (site[DELETION_EVENT] >= threshold || homopolymer) {
+            mutations_.push_back(Mutation(DELETION, pos, '-'));
+        }
     }
+}
+
+std::vector<Mutation> PileupMutationEnumerator::Mutations() const { return mutations_; }
 
+std::vector<Mutation> PileupMutationEnumerator::Mutations(int beginPos, int endPos) const
+{
+    std::vector<Mutation> result;
+    ForEachMutation(beginPos, endPos, [&](const Mutation& m) { result.push_back(m); });
     return result;
 }
 }
@@ -4,56 +4,407 @@
 
 #include <ConsensusCore/Edna/EdnaEvaluator.hpp>
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/MatrixPool.hpp>
 #include <ConsensusCore/Matrix/SparseMatrix.hpp>
 #include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/PerfStats.hpp>
 #include <ConsensusCore/Quiver/QvEvaluator.hpp>
 #include <ConsensusCore/Quiver/SimpleRecursor.hpp>
 #include <ConsensusCore/Quiver/SseRecursor.hpp>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/type_traits.hpp>
+
+#include <algorithm>
+#include <atomic>
 #include <string>
+#include <vector>
 
+// Columns of the scratch space ScoreMutation extends alpha or beta into
 #define EXTEND_BUFFER_COLUMNS 8
 
+// Refills of checkpointed columns each thread keeps, and the columns
+// a refill reaches past the checkpoint interval, so that the columns
+// a mutation near the end of the interval reads are refilled with it
+#define REFILL_CACHE_SIZE 8
+#define REFILL_OVERLAP EXTEND_BUFFER_COLUMNS
+
 namespace ConsensusCore {
+
+namespace {  // PRIVATE
+
+// The calling thread's scratch space to extend into, for reads of
+// rows - 1 bases.  Extending overwrites the columns it reads back, so
+// the buffer is only reshaped when the read length changes.
+template <typename M>
+M& ExtendBuffer(int rows)
+{
+    static thread_local boost::scoped_ptr<M> buffer;
+    if (!buffer) {
+        buffer.reset(new M(rows, EXTEND_BUFFER_COLUMNS));
+        buffer->SetMemoryCategory(SCRATCH_MEMORY);
+    } else if (buffer->Rows() != rows) {
+        buffer->Reset(rows, EXTEND_BUFFER_COLUMNS);
+    }
+    return *buffer;
+}
+
+// Alpha or beta columns refilled from the checkpoints of a scorer
+template <typename M>
+struct RefilledColumns
+{
+    // Serial of the checkpoints refilled from; 0 if none
+    uint64_t Serial;
+    bool IsBeta;
+    int BeginColumn;
+    int EndColumn;
+    uint64_t LastUse;
+    boost::scoped_ptr<M> Columns;
+
+    RefilledColumns() : Serial(0), IsBeta(false), BeginColumn(0), EndColumn(0), LastUse(0) {}
+};
+
+// The calling thread's refill holding columns [beginColumn, endColumn]
+// of the given checkpoints, if it has one; otherwise the least
+// recently used refill, to be overwritten.  Either way, this is now
+// the most recently used.
+template <typename M>
+RefilledColumns<M>& CachedRefill(uint64_t serial, bool isBeta, int beginColumn, int endColumn,
+                                 bool* cached)
+{
+    static thread_local RefilledColumns<M> cache[REFILL_CACHE_SIZE];
+    static thread_local uint64_t uses = 0;
+    RefilledColumns<M>* refill = &cache[0];
+    *cached = false;
+    for (int n = 0; n < REFILL_CACHE_SIZE && !*cached; n++) {
+        RefilledColumns<M>& r = cache[n];
+        if (r.Serial == serial && r.IsBeta == isBeta && r.BeginColumn <= beginColumn &&
+            endColumn <= r.EndColumn) {
+            refill = &r;
+            *cached = true;
+        } else if (r.LastUse < refill->LastUse) {
+            refill = &r;
+        }
+    }
+    refill->LastUse = ++uses;
+    return *refill;
+}
+
+// Reshape m to store just columns [beginColumn, endColumn) of a rows x
+// cols matrix.  Dense matrices store every column.
+void ResetColumns(SparseMatrix* m, int rows, int cols, int beginColumn, int endColumn)
+{
+    m->Reset(rows, cols, beginColumn, endColumn);
+}
+
+void ResetColumns(DenseMatrix* m, int rows, int cols, int, int) { m->Reset(rows, cols); }
+
+// Make refill hold columns [beginColumn, endColumn] of a rows x cols
+// matrix, all empty
+template <typename M>
+M& ResetRefill(RefilledColumns<M>* refill, uint64_t serial, bool isBeta, int rows, int cols,
+               int beginColumn, int endColumn)
+{
+    refill->Serial = serial;
+    refill->IsBeta = isBeta;
+    refill->BeginColumn = beginColumn;
+    refill->EndColumn = endColumn;
+    if (!refill->Columns) {
+        refill->Columns.reset(new M(rows, 0));
+        refill->Columns->SetMemoryCategory(SCRATCH_MEMORY);
+    }
+    ResetColumns(refill->Columns.get(), rows, cols, beginColumn, endColumn + 1);
+    return *refill->Columns;
+}
+
+// The rows each column of m spans
+template <typename M>
+boost::shared_ptr<const std::vector<Interval> > Bands(const M& m)
+{
+    boost::shared_ptr<std::vector<Interval> > bands(new std::vector<Interval>(m.Columns()));
+    for (int j = 0; j < m.Columns(); j++) {
+        (*bands)[j] = m.UsedRowRange(j);
+    }
+    return bands;
+}
+
+// Have columns [beginColumn, endColumn] of m span the given rows, all
+// alike, so that a fill of those columns, banding them to at least the
+// rows they already span, spans those rows again
+template <typename M>
+void SeedBands(M* m, const std::vector<Interval>& bands, int beginColumn, int endColumn)
+{
+    for (int j = beginColumn; j <= endColumn; j++) {
+        int beginRow = bands[j].Begin, endRow = bands[j].End;
+        m->StartEditingColumn(j, beginRow, endRow);
+        for (int i = beginRow; i < endRow; i++) {
+            m->Set(i, j, 0.0f);
+        }
+        m->FinishEditingColumn(j, beginRow, endRow);
+    }
+}
+
+// Whether bands has a nonempty range of rows in [0, rows) for each of
+// cols columns
+bool ValidBandHint(const std::vector<Interval>& bands, int rows, int cols)
+{
+    if (static_cast<int>(bands.size()) != cols) return false;
+    foreach (const Interval& band, bands) {
+        if (band.Begin < 0 || band.Begin >= band.End || band.End > rows) return false;
+    }
+    return true;
+}
+
+// The column of the new template each column of the old one's
+// matrices goes to, knowing only that an edit to newLength bases left
+// the last suffix bases alone: the columns before them stay put, up to
+// the start of the suffix.  Those of an unchanged prefix so stay put
+// too, as a prefix never reaches past the start of the suffix.
+std::vector<int> EditedColumns(int oldLength, int newLength, int suffix)
+{
+    std::vector<int> columns(oldLength + 1);
+    for (int c = 0; c <= oldLength; c++) {
+        columns[c] = (c >= oldLength - suffix) ? c + newLength - oldLength
+                                               : std::min(c, newLength - suffix);
+    }
+    return columns;
+}
+
+// The bands of an old template's columns, moved to the newColumns
+// columns of the new one that columns takes them to; a column none
+// goes to (that of an inserted base, say) takes the hull of the bands
+// of its nearest neighbors either side that one does.  Empty if none
+// does.
+std::vector<Interval> MovedBands(const std::vector<Interval>& bands,
+                                 const std::vector<int>& columns, int newColumns)
+{
+    std::vector<Interval> moved(newColumns);
+    std::vector<bool> landed(newColumns, false);
+    int first = newColumns;
+    for (size_t c = 0; c < bands.size(); c++) {
+        int n = columns[c];
+        if (n < 0 || n >= newColumns || bands[c].Begin >= bands[c].End) continue;
+        moved[n] = landed[n] ? RangeUnion(moved[n], bands[c]) : bands[c];
+        landed[n] = true;
+        first = std::min(first, n);
+    }
+    if (first == newColumns) return std::vector<Interval>();
+    for (int n = first + 1; n < newColumns; n++) {
+        if (!landed[n]) moved[n] = moved[n - 1];
+    }
+    for (int n = newColumns - 2, next = -1; n >= 0; n--) {
+        if (landed[n + 1]) next = n + 1;
+        if (landed[n] || next < 0) continue;
+        moved[n] = (n > first) ? RangeUnion(moved[n], moved[next]) : moved[next];
+    }
+    return moved;
+}
+
+// Whether a scorer of matrices M may checkpoint at interval k
+template <typename M>
+bool ValidCheckpointInterval(int k)
+{
+    bool dense = boost::is_same<M, DenseMatrix>::value;
+    return k == 0 || (k >= MIN_CHECKPOINT_INTERVAL && !dense);
+}
+
+uint64_t NewCheckpointSerial()
+{
+    static std::atomic<uint64_t> serial(0);
+    return ++serial;
+}
+}
+
+template <typename R>
+boost::shared_ptr<const typename R::MatrixType> MutationScorer<R>::Shared(MatrixType* m)
+{
+    return boost::shared_ptr<const MatrixType>(m, &Pool::Release);
+}
+
 template <typename R>
-MutationScorer<R>::MutationScorer(const EvaluatorType& evaluator, const R& recursor)
-    : evaluator_(new EvaluatorType(evaluator)), recursor_(new R(recursor))
+MutationScorer<R>::MutationScorer(const EvaluatorType& evaluator, const R& recursor,
+                                  int checkpointInterval, const std::vector<Interval>& bandHint)
+    : evaluator_(new EvaluatorType(evaluator))
+    , recursor_(new R(recursor))
+    , checkpointInterval_(checkpointInterval)
+    , checkpointSerial_(0)
+    , scratch_()
 {
+    if (!ValidCheckpointInterval<MatrixType>(checkpointInterval)) {
+        delete recursor_;
+        delete evaluator_;
+        throw InvalidInputError("Invalid checkpoint interval");
+    }
+    if (!bandHint.empty() && !ValidBandHint(bandHint, evaluator.ReadLength() + 1,
+                                            evaluator.TemplateLength() + 1)) {
+        delete recursor_;
+        delete evaluator_;
+        throw InvalidInputError("Invalid band hint");
+    }
     try {
-        // Allocate alpha and beta
-        alpha_ = new MatrixType(evaluator.ReadLength() + 1, evaluator.TemplateLength() + 1);
-        beta_ = new MatrixType(evaluator.ReadLength() + 1, evaluator.TemplateLength() + 1);
-        // Buffer where we extend into
-        extendBuffer_ = new MatrixType(evaluator.ReadLength() + 1, EXTEND_BUFFER_COLUMNS);
-        // Initial alpha and beta
-        numFlipFlops_ = recursor.FillAlphaBeta(*evaluator_, *alpha_, *beta_);
+        Fill(bandHint.empty() ? NULL : &bandHint);
     } catch (AlphaBetaMismatchException e) {
-        delete alpha_;
-        delete beta_;
-        delete extendBuffer_;
         delete recursor_;
+        delete evaluator_;
+        throw;
+    }
+}
+
+template <typename R>
+MutationScorer<R>::MutationScorer(const EvaluatorType& evaluator, const R& recursor,
+                                  const std::function<void(MatrixType*, MatrixType*)>& restore,
+                                  const FillStatistics& fillStats, int checkpointInterval)
+    : evaluator_(new EvaluatorType(evaluator))
+    , recursor_(new R(recursor))
+    , checkpointInterval_(checkpointInterval)
+    , checkpointSerial_(0)
+    , fillStats_(fillStats)
+    , scratch_()
+{
+    try {
+        if (!ValidCheckpointInterval<MatrixType>(checkpointInterval)) {
+            throw InvalidInputError("Invalid checkpoint interval");
+        }
+        int rows = evaluator_->ReadLength() + 1;
+        int cols = evaluator_->TemplateLength() + 1;
+        MatrixType* alpha = Pool::Acquire(rows, cols);
+        boost::shared_ptr<const MatrixType> sharedAlpha = Shared(alpha);
+        MatrixType* beta = Pool::Acquire(rows, cols);
+        boost::shared_ptr<const MatrixType> sharedBeta = Shared(beta);
+        restore(alpha, beta);
+        Keep(sharedAlpha, sharedBeta);
+    } catch (...) {
+        delete recursor_;
+        delete evaluator_;
         throw;
     }
 }
 
 template <typename R>
 MutationScorer<R>::MutationScorer(const MutationScorer<R>& other)
+    : evaluator_(new EvaluatorType(*other.evaluator_))
+    , recursor_(new R(*other.recursor_))
+    , checkpointInterval_(other.checkpointInterval_)
+    , alpha_(other.alpha_)
+    , beta_(other.beta_)
+    , checkpointSerial_(other.checkpointSerial_)
+    , alphaBands_(other.alphaBands_)
+    , betaBands_(other.betaBands_)
+    , score_(other.score_)
+    , fillStats_(other.fillStats_)
+    , scratch_()
 {
-    evaluator_ = new EvaluatorType(*other.evaluator_);
-    recursor_ = new R(*other.recursor_);
+}
 
-    // Copy alpha and beta
-    alpha_ = new MatrixType(*other.alpha_);
-    beta_ = new MatrixType(*other.beta_);
-    // Buffer where we extend into
-    extendBuffer_ = new MatrixType(*other.extendBuffer_);
-    numFlipFlops_ = other.numFlipFlops_;
+template <typename R>
+void MutationScorer<R>::Fill(const std::vector<Interval>* bandHint)
+{
+    int rows = evaluator_->ReadLength() + 1;
+    int cols = evaluator_->TemplateLength() + 1;
+    MatrixType* alpha = Pool::Acquire(rows, cols);
+    boost::shared_ptr<const MatrixType> sharedAlpha = Shared(alpha);
+    MatrixType* beta = Pool::Acquire(rows, cols);
+    boost::shared_ptr<const MatrixType> sharedBeta = Shared(beta);
+    if (bandHint != NULL) {
+        SeedBands(alpha, *bandHint, 0, cols - 1);
+    }
+    recursor_->FillAlphaBeta(*evaluator_, *alpha, *beta, &fillStats_);
+    Keep(sharedAlpha, sharedBeta);
+}
+
+template <typename R>
+void MutationScorer<R>::Keep(const boost::shared_ptr<const MatrixType>& alpha,
+                             const boost::shared_ptr<const MatrixType>& beta)
+{
+    score_ = (*beta)(0, 0);
+    int k = checkpointInterval_;
+    if (k == 0) {
+        alpha_ = alpha;
+        beta_ = beta;
+        return;
+    }
+
+    // The checkpoints are columns bk - 2 and bk - 1, for b = 1, 2, ...,
+    // B; alpha is refilled forward from them, and beta back.  Two
+    // columns apiece, as merges reach two columns back.
+    int rows = alpha->Rows();
+    int B = alpha->Columns() / k;
+    MatrixType* alphaCheckpoints = Pool::Acquire(rows, 2 * B);
+    alpha_ = Shared(alphaCheckpoints);
+    MatrixType* betaCheckpoints = Pool::Acquire(rows, 2 * B);
+    beta_ = Shared(betaCheckpoints);
+    for (int b = 1; b <= B; b++) {
+        for (int c = 0; c < 2; c++) {
+            detail::CopyColumn(*alpha, b * k - 2 + c, *alphaCheckpoints, 2 * b - 2 + c);
+            detail::CopyColumn(*beta, b * k - 2 + c, *betaCheckpoints, 2 * b - 2 + c);
+        }
+    }
+    alphaBands_ = Bands(*alpha);
+    betaBands_ = Bands(*beta);
+    checkpointSerial_ = NewCheckpointSerial();
+}
+
+template <typename R>
+const typename R::MatrixType& MutationScorer<R>::AlphaColumns(int beginColumn, int endColumn) const
+{
+    int k = checkpointInterval_;
+    if (k == 0) return *alpha_;
+
+    bool cached;
+    RefilledColumns<MatrixType>& refill =
+        CachedRefill<MatrixType>(checkpointSerial_, false, beginColumn, endColumn, &cached);
+    if (!cached) {
+        // Fill forward from the last checkpoints at or before
+        // beginColumn, or from scratch
+        int J = evaluator_->TemplateLength();
+        int b = std::min((beginColumn + 2) / k, alpha_->Columns() / 2);
+        int fillBegin = b * k;
+        int fillEnd = std::min(J, std::max(endColumn, fillBegin + k + REFILL_OVERLAP - 1));
+        MatrixType& alpha = ResetRefill(&refill, checkpointSerial_, false, alpha_->Rows(), J + 1,
+                                        std::max(0, fillBegin - 2), fillEnd);
+        if (b > 0) {
+            detail::CopyColumn(*alpha_, 2 * b - 2, alpha, fillBegin - 2);
+            detail::CopyColumn(*alpha_, 2 * b - 1, alpha, fillBegin - 1);
+        }
+        SeedBands(&alpha, *alphaBands_, fillBegin, fillEnd);
+        recursor_->FillAlpha(*evaluator_, MatrixType::Null(), alpha, fillBegin, fillEnd);
+    }
+    return *refill.Columns;
+}
+
+template <typename R>
+const typename R::MatrixType& MutationScorer<R>::BetaColumns(int beginColumn, int endColumn) const
+{
+    int k = checkpointInterval_;
+    if (k == 0) return *beta_;
+
+    bool cached;
+    RefilledColumns<MatrixType>& refill =
+        CachedRefill<MatrixType>(checkpointSerial_, true, beginColumn, endColumn, &cached);
+    if (!cached) {
+        // Fill back from the first checkpoints past endColumn + 2, or
+        // from scratch
+        int J = evaluator_->TemplateLength();
+        int b = (endColumn + 3 + k - 1) / k;
+        bool fromCheckpoints = (b <= beta_->Columns() / 2);
+        int fillEnd = fromCheckpoints ? b * k - 3 : J;
+        int fillBegin = std::max(0, std::min(beginColumn, fillEnd - k - REFILL_OVERLAP + 1));
+        MatrixType& beta = ResetRefill(&refill, checkpointSerial_, true, beta_->Rows(), J + 1,
+                                       fillBegin, fromCheckpoints ? fillEnd + 2 : J);
+        if (fromCheckpoints) {
+            detail::CopyColumn(*beta_, 2 * b - 2, beta, fillEnd + 1);
+            detail::CopyColumn(*beta_, 2 * b - 1, beta, fillEnd + 2);
+        }
+        SeedBands(&beta, *betaBands_, fillBegin, fillEnd);
+        recursor_->FillBeta(*evaluator_, MatrixType::Null(), beta, fillBegin, fillEnd);
+    }
+    return *refill.Columns;
 }
 
 template <typename R>
 float MutationScorer<R>::Score() const
 {
-    return (*beta_)(0, 0);
+    return score_;
 }
 
 template <typename R>
@@ -65,24 +416,117 @@ std::string MutationScorer<R>::Template() const
 template <typename R>
 void MutationScorer<R>::Template(std::string tpl)
 {
-    delete alpha_;
-    delete beta_;
-    evaluator_->Template(tpl);
-    alpha_ = new MatrixType(evaluator_->ReadLength() + 1, evaluator_->TemplateLength() + 1);
-    beta_ = new MatrixType(evaluator_->ReadLength() + 1, evaluator_->TemplateLength() + 1);
-    recursor_->FillAlphaBeta(*evaluator_, *alpha_, *beta_);
+    Template(tpl, 0, tpl.length());
+}
+
+template <typename R>
+void MutationScorer<R>::Template(const std::string& buffer, int start, int length,
+                                 const std::vector<int>& columnMap)
+{
+    // Find the stretches at either end of the template that the edit
+    // left alone; the alpha columns over the unchanged prefix and the
+    // beta columns over the unchanged suffix need not be recomputed.
+    const std::string& oldTpl = evaluator_->Template();
+    const char* tpl = buffer.data() + start;
+    int oldLength = oldTpl.length();
+    int newLength = length;
+    int maxUnchanged = std::min(oldLength, newLength);
+    int prefix = 0, suffix = 0;
+    while (prefix < maxUnchanged && oldTpl[prefix] == tpl[prefix]) {
+        prefix++;
+    }
+    while (suffix < maxUnchanged - prefix &&
+           oldTpl[oldLength - 1 - suffix] == tpl[newLength - 1 - suffix]) {
+        suffix++;
+    }
+
+    if (!columnMap.empty() && static_cast<int>(columnMap.size()) != oldLength + 1) {
+        throw InvalidInputError("Invalid column map");
+    }
+
+    // The new matrices are this scorer's own; the old ones may still
+    // be shared with copies, and are only read from.  Checkpoints
+    // cannot be refilled from, so are filled from scratch.  Either way
+    // alpha is seeded with the bands of the old one, moved to the new
+    // template's columns, so that the fill need not find its band anew
+    // by rebanding back and forth.  Dense matrices have no band to find.
+    Wake();
+    std::vector<Interval> seed;
+    if (!boost::is_same<MatrixType, DenseMatrix>::value) {
+        seed = MovedBands((checkpointInterval_ != 0) ? *alphaBands_ : *Bands(*alpha_),
+                          columnMap.empty() ? EditedColumns(oldLength, newLength, suffix)
+                                            : columnMap,
+                          newLength + 1);
+    }
+    evaluator_->Template(buffer, start, length);
+    for (int k = 0; k < SCRATCH_EVALUATORS; k++) {
+        EvaluatorType* ev = scratch_[k].load(std::memory_order_relaxed);
+        if (ev != NULL) ev->Template(buffer, start, length);
+    }
+    if (checkpointInterval_ != 0) {
+        Fill(seed.empty() ? NULL : &seed);
+        return;
+    }
+    MatrixType* alpha = Pool::Acquire(evaluator_->ReadLength() + 1, newLength + 1);
+    boost::shared_ptr<const MatrixType> newAlpha = Shared(alpha);
+    MatrixType* beta = Pool::Acquire(evaluator_->ReadLength() + 1, newLength + 1);
+    boost::shared_ptr<const MatrixType> newBeta = Shared(beta);
+    if (!seed.empty()) SeedBands(alpha, seed, prefix, newLength);
+    bool refilled =
+        recursor_->RefillAlphaBeta(*evaluator_, *alpha_, *beta_, prefix, suffix, *alpha, *beta);
+
+    if (!refilled) {
+        alpha->Reset(evaluator_->ReadLength() + 1, newLength + 1);
+        beta->Reset(evaluator_->ReadLength() + 1, newLength + 1);
+        if (!seed.empty()) SeedBands(alpha, seed, 0, newLength);
+        recursor_->FillAlphaBeta(*evaluator_, *alpha, *beta, &fillStats_);
+    }
+    Keep(newAlpha, newBeta);
+}
+
+template <typename R>
+void MutationScorer<R>::Hibernate()
+{
+    if (IsHibernating()) return;
+    if (checkpointInterval_ == 0) {
+        alphaBands_ = Bands(*alpha_);
+        betaBands_ = Bands(*beta_);
+    }
+    alpha_.reset();
+    beta_.reset();
+}
+
+template <typename R>
+void MutationScorer<R>::Wake()
+{
+    if (!IsHibernating()) return;
+    int rows = evaluator_->ReadLength() + 1;
+    int cols = evaluator_->TemplateLength() + 1;
+    MatrixType* alpha = Pool::Acquire(rows, cols);
+    boost::shared_ptr<const MatrixType> sharedAlpha = Shared(alpha);
+    MatrixType* beta = Pool::Acquire(rows, cols);
+    boost::shared_ptr<const MatrixType> sharedBeta = Shared(beta);
+    SeedBands(alpha, *alphaBands_, 0, cols - 1);
+    recursor_->FillAlpha(*evaluator_, MatrixType::Null(), *alpha, 0, cols - 1);
+    SeedBands(beta, *betaBands_, 0, cols - 1);
+    recursor_->FillBeta(*evaluator_, MatrixType::Null(), *beta, 0, cols - 1);
+    Keep(sharedAlpha, sharedBeta);
+    if (checkpointInterval_ == 0) {
+        alphaBands_.reset();
+        betaBands_.reset();
+    }
 }
 
 template <typename R>
 const typename R::MatrixType* MutationScorer<R>::Alpha() const
 {
-    return alpha_;
+    return alpha_.get();
 }
 
 template <typename R>
 const typename R::MatrixType* MutationScorer<R>::Beta() const
 {
-    return beta_;
+    return beta_.get();
 }
 
 template <typename R>
@@ -91,28 +535,102 @@ const typename R::EvaluatorType* MutationScorer<R>::Evaluator() const
     return evaluator_;
 }
 
+template <typename R>
+void MutationScorer<R>::AddMemoryUsage(MemoryUsage* usage) const
+{
+    if (!IsHibernating()) {
+        usage->MatrixBytes += alpha_->AllocatedBytes() + beta_->AllocatedBytes();
+    }
+    usage->FeatureBytes += evaluator_->FeatureBytes();
+    usage->ScorerBytes += sizeof(*this) + sizeof(*evaluator_) + sizeof(*recursor_) +
+                          evaluator_->Template().capacity();
+    for (int k = 0; k < SCRATCH_EVALUATORS; k++) {
+        const EvaluatorType* ev = scratch_[k].load(std::memory_order_relaxed);
+        if (ev != NULL) usage->ScorerBytes += sizeof(*ev) + ev->Template().capacity();
+    }
+    if (alphaBands_) usage->ScorerBytes += alphaBands_->capacity() * sizeof(Interval);
+    if (betaBands_) usage->ScorerBytes += betaBands_->capacity() * sizeof(Interval);
+}
+
 template <typename R>
 const PairwiseAlignment* MutationScorer<R>::Alignment() const
 {
-    return recursor_->Alignment(*evaluator_, *alpha_);
+    if (checkpointInterval_ == 0) {
+        return recursor_->Alignment(*evaluator_, *alpha_);
+    }
+    MatrixType alpha(evaluator_->ReadLength() + 1, evaluator_->TemplateLength() + 1);
+    recursor_->FillAlpha(*evaluator_, MatrixType::Null(), alpha);
+    return recursor_->Alignment(*evaluator_, alpha);
+}
+
+template <typename R>
+CompactAlignment MutationScorer<R>::Traceback() const
+{
+    if (checkpointInterval_ == 0) {
+        return recursor_->Traceback(*evaluator_, *alpha_);
+    }
+    MatrixType alpha(evaluator_->ReadLength() + 1, evaluator_->TemplateLength() + 1);
+    recursor_->FillAlpha(*evaluator_, MatrixType::Null(), alpha);
+    return recursor_->Traceback(*evaluator_, alpha);
 }
 
 template <typename R>
 float MutationScorer<R>::ScoreMutation(const Mutation& m) const
+{
+    PERF_SCOPE(PERF_SCORE_MUTATION);
+    int betaLinkCol = 1 + m.End();
+    float score;
+
+    int J = evaluator_->TemplateLength();
+    bool atBegin = (m.Start() < 3);
+    bool atEnd = (m.End() > J - 2);
+
+    // The alpha and beta columns read below.  Refilling them from
+    // checkpoints needs the template as it is, so comes first.
+    const MatrixType* alpha = NULL;
+    const MatrixType* beta = NULL;
+    if (!atBegin) {
+        int lastColumn = atEnd ? J : std::min<int>(J, m.Start() + m.NewBasesLength());
+        alpha = &AlphaColumns(m.Start() - 3, lastColumn);
+    }
+    if (!atEnd) {
+        beta = &BetaColumns(atBegin ? 0 : betaLinkCol, m.End() + 2);
+    }
+
+    // The copy of the evaluator is only mutated by this call; should
+    // scoring throw, it is not handed back with its template mutated
+    EvaluatorType* ev = TakeScratchEvaluator();
+    try {
+        score = ScoreMutated(ev, m, alpha, beta);
+    } catch (...) {
+        delete ev;
+        throw;
+    }
+    ReturnScratchEvaluator(ev);
+    return score;
+}
+
+template <typename R>
+float MutationScorer<R>::ScoreMutated(EvaluatorType* ev, const Mutation& m,
+                                      const MatrixType* alpha, const MatrixType* beta) const
 {
     int betaLinkCol = 1 + m.End();
     int absoluteLinkColumn = 1 + m.End() + m.LengthDiff();
-    std::string oldTpl = evaluator_->Template();
-    std::string newTpl = ApplyMutation(m, oldTpl);
     float score;
 
+    int J = ev->TemplateLength();
     bool atBegin = (m.Start() < 3);
-    bool atEnd = (m.End() > static_cast<int>(oldTpl.length()) - 2);
+    bool atEnd = (m.End() > J - 2);
 
-    if (!atBegin && !atEnd) {
-        // Install mutated template
-        evaluator_->Template(newTpl);
+    // Install the mutated template.  This edits the copy's template in
+    // place rather than building a new string, so scoring does not
+    // allocate.
+    ev->ApplyMutation(m);
+    int newTplLength = ev->TemplateLength();
 
+    MatrixType& extendBuffer = ExtendBuffer<MatrixType>(ev->ReadLength() + 1);
+
+    if (!atBegin && !atEnd) {
         int extendStartCol, extendLength;
 
         if (m.Type() == DELETION) {
@@ -123,24 +641,33 @@ float MutationScorer<R>::ScoreMutation(const Mutation& m) const
             extendLength = 2;
         } else {
             extendStartCol = m.Start();
-            extendLength = 1 + m.NewBases().length();
+            extendLength = 1 + m.NewBasesLength();
             assert(extendLength <= EXTEND_BUFFER_COLUMNS);
         }
 
-        recursor_->ExtendAlpha(*evaluator_, *alpha_, extendStartCol, *extendBuffer_, extendLength);
-        score = recursor_->LinkAlphaBeta(*evaluator_, *extendBuffer_, extendLength, *beta_,
-                                         betaLinkCol, absoluteLinkColumn);
+        {
+            PERF_SCOPE(PERF_EXTEND);
+            recursor_->ExtendAlpha(*ev, *alpha, extendStartCol, extendBuffer, extendLength);
+            PERF_CELLS(PERF_EXTEND, detail::UsedCells(extendBuffer, 0, extendLength));
+        }
+        {
+            PERF_SCOPE(PERF_LINK_ALPHA_BETA);
+            score = recursor_->LinkAlphaBeta(*ev, extendBuffer, extendLength, *beta,
+                                             betaLinkCol, absoluteLinkColumn);
+        }
     } else if (!atBegin && atEnd) {
         //
         // Extend alpha to end
         //
-        evaluator_->Template(newTpl);
-
         int extendStartCol = m.Start() - 1;
-        int extendLength = newTpl.length() - extendStartCol + 1;
+        int extendLength = newTplLength - extendStartCol + 1;
 
-        recursor_->ExtendAlpha(*evaluator_, *alpha_, extendStartCol, *extendBuffer_, extendLength);
-        score = (*extendBuffer_)(evaluator_->ReadLength(), extendLength - 1);
+        {
+            PERF_SCOPE(PERF_EXTEND);
+            recursor_->ExtendAlpha(*ev, *alpha, extendStartCol, extendBuffer, extendLength);
+            PERF_CELLS(PERF_EXTEND, detail::UsedCells(extendBuffer, 0, extendLength));
+        }
+        score = extendBuffer(ev->ReadLength(), extendLength - 1);
 
         // if (fabs(score - Score()) > 50) {
         //     // FIXME!  This happens on fluidigm amplicons, figure out why
@@ -150,39 +677,66 @@ float MutationScorer<R>::ScoreMutation(const Mutation& m) const
         //
         // Extend beta back
         //
-        evaluator_->Template(newTpl);
-
         int extendLastCol = m.End();
         int extendLength = m.End() + m.LengthDiff() + 1;
 
-        recursor_->ExtendBeta(*evaluator_, *beta_, extendLastCol, *extendBuffer_, extendLength,
-                              m.LengthDiff());
-        score = (*extendBuffer_)(0, 0);
+        {
+            PERF_SCOPE(PERF_EXTEND);
+            recursor_->ExtendBeta(*ev, *beta, extendLastCol, extendBuffer, extendLength,
+                                  m.LengthDiff());
+            PERF_CELLS(PERF_EXTEND, detail::UsedCells(extendBuffer, 0, extendLength));
+        }
+        score = extendBuffer(0, 0);
     } else {
         assert(atBegin && atEnd);
         //
         // Just do the whole fill
         //
-        MatrixType alphaP(evaluator_->ReadLength() + 1, newTpl.length() + 1);
-        evaluator_->Template(newTpl);
-        recursor_->FillAlpha(*evaluator_, MatrixType::Null(), alphaP);
-        score = alphaP(evaluator_->ReadLength(), newTpl.length());
+        MatrixType alphaP(ev->ReadLength() + 1, newTplLength + 1);
+        recursor_->FillAlpha(*ev, MatrixType::Null(), alphaP);
+        score = alphaP(ev->ReadLength(), newTplLength);
     }
 
     // Restore the original template.
-    evaluator_->Template(oldTpl);
+    ev->UndoMutation(m);
 
     // if (fabs(score - Score()) > 50) { Breakpoint(); }
 
     return score;
 }
 
+template <typename R>
+typename R::EvaluatorType* MutationScorer<R>::TakeScratchEvaluator() const
+{
+    for (int k = 0; k < SCRATCH_EVALUATORS; k++) {
+        EvaluatorType* ev = scratch_[k].exchange(NULL, std::memory_order_acquire);
+        if (ev != NULL) return ev;
+    }
+    return new EvaluatorType(*evaluator_);
+}
+
+template <typename R>
+void MutationScorer<R>::ReturnScratchEvaluator(EvaluatorType* ev) const
+{
+    for (int k = 0; k < SCRATCH_EVALUATORS; k++) {
+        EvaluatorType* empty = NULL;
+        if (scratch_[k].compare_exchange_strong(empty, ev, std::memory_order_release)) return;
+    }
+    delete ev;
+}
+
+template <typename R>
+void MutationScorer<R>::DeleteScratchEvaluators()
+{
+    for (int k = 0; k < SCRATCH_EVALUATORS; k++) {
+        delete scratch_[k].exchange(NULL);
+    }
+}
+
 template <typename R>
 MutationScorer<R>::~MutationScorer()
 {
-    delete extendBuffer_;
-    delete beta_;
-    delete alpha_;
+    DeleteScratchEvaluators();
     delete recursor_;
     delete evaluator_;
 }
@@ -2,21 +2,78 @@
 
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
 
+#include <algorithm>
+#include <cstdlib>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/make_shared.hpp>
 
 namespace ConsensusCore {
+BandingOptions ReadBanding(const BandingOptions& banding, const QvSequenceFeatures& features,
+                           int templateLength)
+{
+    BandingOptions adapted(banding);
+    int length = features.Length();
+    if (!banding.Adaptive || length == 0) return adapted;
+
+    double errorRate = 0;
+    for (int i = 0; i < length; i++) {
+        double p = std::pow(10.0, -static_cast<double>(features.InsQv[i]) / 10.0) +
+                   std::pow(10.0, -static_cast<double>(features.SubsQv[i]) / 10.0) +
+                   std::pow(10.0, -static_cast<double>(features.DelQv[i]) / 10.0);
+        errorRate += std::min(p, 1.0);
+    }
+    errorRate /= length;
+
+    double lengthDiff =
+        std::abs(length - templateLength) / static_cast<double>(std::max(templateLength, 1));
+    double scoreDiff = static_cast<double>(banding.ScoreDiff) *
+                       std::sqrt(errorRate / static_cast<double>(ADAPTIVE_BANDING_ERROR_RATE)) *
+                       (1 + 2 * lengthDiff);
+    adapted.ScoreDiff = std::min(std::max(static_cast<float>(scoreDiff), banding.MinScoreDiff),
+                                 banding.MaxScoreDiff);
+    return adapted;
+}
+
+QvScoreTable::QvScoreTable(float intercept, float slope) : intercept_(intercept), slope_(slope)
+{
+    for (int q = 0; q < NUM_TABULATED_QVS; q++) {
+        scores_[q] = intercept_ + slope_ * static_cast<float>(q);
+        probs_[q] = std::exp(scores_[q]);
+    }
+}
+
+QvModel::QvModel(const QvModelParams& params, int chemistryId)
+    : params_(params)
+    , chemistryId_(chemistryId)
+    , matchProb_(std::exp(params.Match))
+    , deletionNProb_(std::exp(params.DeletionN))
+    , mismatch_(params.Mismatch, params.MismatchS)
+    , deletionWithTag_(params.DeletionWithTag, params.DeletionWithTagS)
+    , branch_(params.Branch, params.BranchS)
+    , nce_(params.Nce, params.NceS)
+    , merge_{QvScoreTable(params.Merge[0], params.MergeS[0]),
+             QvScoreTable(params.Merge[1], params.MergeS[1]),
+             QvScoreTable(params.Merge[2], params.MergeS[2]),
+             QvScoreTable(params.Merge[3], params.MergeS[3])}
+{
+}
+
 QuiverConfig::QuiverConfig(const QvModelParams& qvParams, int movesAvailable,
                            const BandingOptions& bandingOptions, float fastScoreThreshold,
-                           float addThreshold)
+                           float addThreshold, const RecursorConfig& recursorConfig,
+                           int checkpointInterval)
     : QvParams(qvParams)
     , MovesAvailable(movesAvailable)
     , Banding(bandingOptions)
     , FastScoreThreshold(fastScoreThreshold)
     , AddThreshold(addThreshold)
+    , Recursor(recursorConfig)
+    , CheckpointInterval(checkpointInterval)
+    , Model(boost::make_shared<const QvModel>(qvParams))
 {
 }
 
@@ -26,6 +83,9 @@ QuiverConfig::QuiverConfig(const QuiverConfig& qvConfig)
     , Banding(qvConfig.Banding)
     , FastScoreThreshold(qvConfig.FastScoreThreshold)
     , AddThreshold(qvConfig.AddThreshold)
+    , Recursor(qvConfig.Recursor)
+    , CheckpointInterval(qvConfig.CheckpointInterval)
+    , Model(qvConfig.Model)
 {
 }
 
@@ -38,7 +98,10 @@ bool QuiverConfigTable::InsertAs_(const std::string& name, const QuiverConfig& c
     for (it = table.begin(); it != table.end(); it++)
         if (name.compare(it->first) == 0) return false;
 
-    table.push_front(std::make_pair(name, config));
+    // Compile the parameters as they are now, under the next id
+    QuiverConfig compiled(config);
+    compiled.Model = boost::make_shared<const QvModel>(config.QvParams, Size());
+    table.push_front(std::make_pair(name, compiled));
 
     return true;
 }
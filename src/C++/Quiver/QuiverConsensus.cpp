@@ -2,16 +2,21 @@
 
 #include <ConsensusCore/Quiver/QuiverConsensus.hpp>
 
+#include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/Logging.hpp>
 #include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/Quiver/Capture.hpp>
 #include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
 #include <ConsensusCore/Quiver/MutationEnumerator.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 #include <ConsensusCore/Utils.hpp>
 
 #include <algorithm>
-#include <boost/functional/hash.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <set>
 #include <string>
 #include <utility>
@@ -21,36 +26,20 @@ namespace ConsensusCore {
 using std::vector;
 
 namespace {  // PRIVATE
-using std::max_element;
 
-struct RefineDinucleotideRepeatOptions : RefineOptions
+struct RefineTandemRepeatOptions : RefineOptions
 {
-    explicit RefineDinucleotideRepeatOptions(int minDinucleotideRepeatElements)
-        : MinDinucleotideRepeatElements(minDinucleotideRepeatElements)
+    RefineTandemRepeatOptions(int unitLength, int minElements)
+        : UnitLength(unitLength), MinElements(minElements)
     {
         MaximumIterations = 1;
+        MinPileupSupport = 0;
     }
 
-    int MinDinucleotideRepeatElements;
+    int UnitLength;
+    int MinElements;
 };
 
-vector<ScoredMutation> DeleteRange(vector<ScoredMutation> input, int rStart, int rEnd)
-{
-    vector<ScoredMutation> output;
-    foreach (ScoredMutation s, input) {
-        int pos = s.Start();
-        if (!(rStart <= pos && pos <= rEnd)) {
-            output.push_back(s);
-        }
-    }
-    return output;
-}
-
-bool ScoreComparer(const ScoredMutation& i, const ScoredMutation& j)
-{
-    return i.Score() < j.Score();
-}
-
 //    Given a list of (mutation, score) tuples, this utility method
 //    greedily chooses the highest scoring well-separated elements.  We
 //    use this to avoid applying adjacent high scoring mutations, which
@@ -58,22 +47,59 @@ bool ScoreComparer(const ScoredMutation& i, const ScoredMutation& j)
 //    in each neighborhood, and then revisit the neighborhoods after
 //    applying the mutations.
 //
-//    This is highly unoptimized.  It is not in the critical path.
-vector<ScoredMutation> BestSubset(vector<ScoredMutation> input, int mutationSeparation)
+//    The candidates are visited best first (ties in input order), and
+//    one is chosen unless a chosen one starts within mutationSeparation
+//    of it; the starts chosen so far are kept ordered, so each check is
+//    a lookup.
+vector<ScoredMutation> BestSubset(const vector<ScoredMutation>& input, int mutationSeparation)
 {
     if (mutationSeparation == 0) return input;
 
+    vector<int> order(input.size());
+    for (size_t i = 0; i < input.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return input[a].Score() > input[b].Score(); });
+
     vector<ScoredMutation> output;
+    std::set<int> chosenStarts;
+    foreach (int i, order) {
+        int pos = input[i].Start();
+        std::set<int>::const_iterator nearest = chosenStarts.lower_bound(pos - mutationSeparation);
+        if (nearest == chosenStarts.end() || *nearest > pos + mutationSeparation) {
+            output.push_back(input[i]);
+            chosenStarts.insert(pos);
+        }
+    }
+    return output;
+}
 
-    while (!input.empty()) {
-        ScoredMutation& best = *max_element(input.begin(), input.end(), ScoreComparer);
-        output.push_back(best);
-        int nStart = best.Start() - mutationSeparation;
-        int nEnd = best.Start() + mutationSeparation;
-        input = DeleteRange(input, nStart, nEnd);
+//    The template intervals to revisit once the mutations `applied` have
+//    changed oldTpl: the neighborhoods of the last round's favorable
+//    mutations, moved to the new template's coordinates and merged.
+//    As in UniqueNearbyMutations, a neighborhood is [c - size, c + size).
+vector<Interval> DirtyRegions(const vector<ScoredMutation>& favorable,
+                              const vector<Mutation>& applied, const std::string& oldTpl,
+                              int neighborhoodSize)
+{
+    vector<int> mtp = TargetToQueryPositions(applied, oldTpl);
+    vector<int> centers;
+    foreach (const ScoredMutation& smut, favorable) {
+        centers.push_back(mtp[smut.Start()]);
     }
+    std::sort(centers.begin(), centers.end());
 
-    return output;
+    vector<Interval> regions;
+    foreach (int c, centers) {
+        Interval nbhd(c - neighborhoodSize, c + neighborhoodSize);
+        if (!regions.empty() && nbhd.Begin <= regions.back().End) {
+            regions.back().End = nbhd.End;
+        } else {
+            regions.push_back(nbhd);
+        }
+    }
+    return regions;
 }
 
 // Sadly and annoyingly there is no covariance on std::vector in C++, so we have
@@ -103,10 +129,27 @@ E MutationEnumerator(const std::string& tpl, const O&)
 // this MUST go last to properly specialize the MutationEnumerator
 //
 template <>
-DinucleotideRepeatMutationEnumerator MutationEnumerator<>(
-    const std::string& tpl, const RefineDinucleotideRepeatOptions& opts)
+TandemRepeatMutationEnumerator MutationEnumerator<>(const std::string& tpl,
+                                                    const RefineTandemRepeatOptions& opts)
+{
+    return TandemRepeatMutationEnumerator(tpl, opts.UnitLength, opts.MinElements);
+}
+
+// Bring the enumerator up to date with the template after the mutations
+// were applied to it: in general by enumerating the new template afresh,
+// but a tandem repeat enumerator updates its index about the mutations.
+template <typename E, typename O>
+void UpdateMutationEnumerator(E* mutationEnumerator, const vector<Mutation>&,
+                              const std::string& newTpl, const O& opts)
 {
-    return DinucleotideRepeatMutationEnumerator(tpl, opts.MinDinucleotideRepeatElements);
+    *mutationEnumerator = MutationEnumerator<E, O>(newTpl, opts);
+}
+
+void UpdateMutationEnumerator(TandemRepeatMutationEnumerator* mutationEnumerator,
+                              const vector<Mutation>& applied, const std::string&,
+                              const RefineTandemRepeatOptions&)
+{
+    mutationEnumerator->ApplyMutations(applied);
 }
 
 template <typename E, typename O>
@@ -114,16 +157,22 @@ bool AbstractRefineConsensus(AbstractMultiReadMutationScorer& mms, const O& opts
 {
     bool isConverged = false;
     float score = mms.BaselineScore();
-    boost::hash<std::string> hash;
-    std::set<size_t> tplHistory;
+    // Templates are told apart by their fingerprints, which the scorer
+    // keeps up to date, and the one copy of the template made each
+    // round is kept to the next
+    std::set<uint64_t> tplHistory;
+    std::string tpl = mms.Template();
 
     vector<ScoredMutation> favorableMutsAndScores;
+    vector<Interval> dirtyRegions;
+    E mutationEnumerator = MutationEnumerator<E, O>(tpl, opts);
 
     for (int iter = 0; iter < opts.MaximumIterations; iter++) {
+        PERF_SCOPE(PERF_REFINE_ITERATION);
         LDEBUG << "Round " << iter;
         LDEBUG << "State of MMS: " << std::endl << mms.ToString();
 
-        if (tplHistory.find(hash(mms.Template())) != tplHistory.end()) {
+        if (tplHistory.find(mms.TemplateFingerprint()) != tplHistory.end()) {
             LDEBUG << "Cycle detected!";
         }
 
@@ -133,27 +182,38 @@ bool AbstractRefineConsensus(AbstractMultiReadMutationScorer& mms, const O& opts
         score = mms.BaselineScore();
 
         //
-        // Try all mutations in iteration 0.  In subsequent iterations, try
-        // mutations
-        // nearby those used in previous iteration.
+        // Try all mutations in iteration 0 (or, if asked, just those the
+        // reads' alignments show).  In subsequent iterations, try
+        // only the mutations in the dirty regions, nearby those found
+        // favorable in the previous iteration.  The regions are disjoint,
+        // and the enumerators used past iteration 0 list each position's
+        // mutations regardless of the range asked for, so each mutation
+        // is listed once.
         //
-        E mutationEnumerator = MutationEnumerator<E, O>(mms.Template(), opts);
         vector<Mutation> mutationsToTry;
-        if (iter == 0) {
+        if (iter == 0 && opts.MinPileupSupport > 0) {
+            mutationsToTry = PileupMutationEnumerator(mms, opts.MinPileupSupport).Mutations();
+        } else if (iter == 0) {
             mutationsToTry = mutationEnumerator.Mutations();
         } else {
-            mutationsToTry = UniqueNearbyMutations(
-                mutationEnumerator, ProjectDown(favorableMutsAndScores), opts.MutationNeighborhood);
+            foreach (const Interval& region, dirtyRegions) {
+                mutationEnumerator.ForEachMutation(
+                    region.Begin, region.End,
+                    [&](const Mutation& m) { mutationsToTry.push_back(m); });
+            }
+            std::sort(mutationsToTry.begin(), mutationsToTry.end());
         }
 
         //
         // Screen for favorable mutations.  If none, we are done (converged).
+        // FastScore clears the favorability bar exactly when
+        // FastIsFavorable holds, in which case it equals the full Score.
         //
         favorableMutsAndScores.clear();
-        foreach (const Mutation& m, mutationsToTry) {
-            if (mms.FastIsFavorable(m)) {
-                float mutScore = mms.Score(m);
-                favorableMutsAndScores.push_back(m.WithScore(mutScore));
+        vector<float> mutScores = mms.FastScoreMany(mutationsToTry);
+        for (size_t i = 0; i < mutationsToTry.size(); i++) {
+            if (mutScores[i] > MIN_FAVORABLE_SCOREDIFF) {
+                favorableMutsAndScores.push_back(mutationsToTry[i].WithScore(mutScores[i]));
             }
         }
         if (favorableMutsAndScores.empty()) {
@@ -171,8 +231,9 @@ bool AbstractRefineConsensus(AbstractMultiReadMutationScorer& mms, const O& opts
         // Attempt to avoid cycling.  We could do a better job here.
         //
         if (bestSubset.size() > 1) {
-            std::string nextTpl = ApplyMutations(ProjectDown(bestSubset), mms.Template());
-            if (tplHistory.find(hash(nextTpl)) != tplHistory.end()) {
+            uint64_t next = MutatedTemplateFingerprint(mms.TemplateFingerprint(),
+                                                       ProjectDown(bestSubset), tpl);
+            if (tplHistory.find(next) != tplHistory.end()) {
                 LDEBUG << "Attempting to avoid cycle";
                 bestSubset =
                     std::vector<ScoredMutation>(bestSubset.begin(), bestSubset.begin() + 1);
@@ -184,50 +245,171 @@ bool AbstractRefineConsensus(AbstractMultiReadMutationScorer& mms, const O& opts
             LDEBUG << "\t" << smut;
         }
 
-        tplHistory.insert(hash(mms.Template()));
-        mms.ApplyMutations(ProjectDown(bestSubset));
+        tplHistory.insert(mms.TemplateFingerprint());
+        vector<Mutation> applied = ProjectDown(bestSubset);
+        mms.ApplyMutations(applied);
+        std::string newTpl = mms.Template();
+        UpdateMutationEnumerator(&mutationEnumerator, applied, newTpl, opts);
+        dirtyRegions =
+            DirtyRegions(favorableMutsAndScores, applied, tpl, opts.MutationNeighborhood);
+        tpl.swap(newTpl);
     }
 
     return isConverged;
 }
+
+//    Raises a scorer's thread count to at least numThreads for the
+//    guard's lifetime, restoring it however the scope is left.
+class AtLeastThreads
+{
+public:
+    AtLeastThreads(AbstractMultiReadMutationScorer* mms, int numThreads)
+        : mms_(mms), ownThreads_(mms->NumThreads())
+    {
+        if (ownThreads_ < numThreads) mms_->SetNumThreads(numThreads);
+    }
+
+    ~AtLeastThreads()
+    {
+        if (mms_->NumThreads() != ownThreads_) mms_->SetNumThreads(ownThreads_);
+    }
+
+private:
+    AtLeastThreads(const AtLeastThreads&);
+    AtLeastThreads& operator=(const AtLeastThreads&);
+
+    AbstractMultiReadMutationScorer* mms_;
+    int ownThreads_;
+};
 }  // PRIVATE
 
 bool RefineConsensus(AbstractMultiReadMutationScorer& mms, const RefineOptions& opts)
 {
-    return AbstractRefineConsensus<UniqueSingleBaseMutationEnumerator>(mms, opts);
+    bool capture = CAPTURE_THIS_CALL();
+    bool converged;
+    {
+        detail::NestedInCapture nested;
+        converged = AbstractRefineConsensus<UniqueSingleBaseMutationEnumerator>(mms, opts);
+    }
+    if (capture) detail::CaptureRefine(&mms, opts, converged, mms.Template());
+    return converged;
+}
+
+int64_t RefineCost(const AbstractMultiReadMutationScorer& mms)
+{
+    int64_t cost = 0;
+    foreach (int entries, mms.UsedMatrixEntries()) {
+        cost += entries;
+    }
+    return cost;
+}
+
+std::vector<bool> RefineConsensusBatch(const std::vector<AbstractMultiReadMutationScorer*>& scorers,
+                                       const RefineOptions& opts, int numThreads)
+{
+    int n = scorers.size();
+    vector<int64_t> costs(n);
+    int64_t totalCost = 0;
+    for (int i = 0; i < n; i++) {
+        costs[i] = RefineCost(*scorers[i]);
+        totalCost += costs[i];
+    }
+    vector<int> order(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return costs[a] > costs[b]; });
+
+    vector<char> converged(n, false);  // not vector<bool>, whose bits threads share
+    int split = 0;
+    for (; split < n && numThreads > 1 && costs[order[split]] * numThreads > totalCost; split++) {
+        AtLeastThreads threads(scorers[order[split]], numThreads);
+        converged[order[split]] = RefineConsensus(*scorers[order[split]], opts);
+    }
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(n - split, [&](int k) {
+        int i = order[split + k];
+        converged[i] = RefineConsensus(*scorers[i], opts);
+    });
+    return std::vector<bool>(converged.begin(), converged.end());
 }
 
 void RefineDinucleotideRepeats(AbstractMultiReadMutationScorer& mms,
                                int minDinucleotideRepeatElements)
 {
-    RefineDinucleotideRepeatOptions opts(minDinucleotideRepeatElements);
-    AbstractRefineConsensus<DinucleotideRepeatMutationEnumerator>(mms, opts);
+    RefineTandemRepeatOptions opts(2, minDinucleotideRepeatElements);
+    AbstractRefineConsensus<TandemRepeatMutationEnumerator>(mms, opts);
+}
+
+void RefineTrinucleotideRepeats(AbstractMultiReadMutationScorer& mms,
+                                int minTrinucleotideRepeatElements)
+{
+    RefineTandemRepeatOptions opts(3, minTrinucleotideRepeatElements);
+    AbstractRefineConsensus<TandemRepeatMutationEnumerator>(mms, opts);
 }
 
 std::vector<int> ConsensusQVs(AbstractMultiReadMutationScorer& mms)
 {
-    std::vector<int> QVs;
+    return ConsensusQVs(mms, 0, mms.TemplateLength());
+}
+
+std::vector<int> ConsensusQVs(AbstractMultiReadMutationScorer& mms, int beginPos, int endPos)
+{
+    // Score every site's mutations in one batch.  The enumerator lists
+    // them site by site, and every site has its substitutions, so the
+    // sites are the runs of equal Start() in the batch.
     UniqueSingleBaseMutationEnumerator mutationEnumerator(mms.Template());
-    for (size_t pos = 0; pos < mms.Template().length(); pos++) {
+    vector<Mutation> mutations;
+    mutations.reserve(8 * (endPos - beginPos));
+    mutationEnumerator.ForEachMutation(beginPos, endPos,
+                                       [&](const Mutation& m) { mutations.push_back(m); });
+    vector<float> scores = mms.FastScoreMany(mutations);
+
+    std::vector<int> QVs;
+    QVs.reserve(endPos - beginPos);
+    size_t i = 0;
+    while (i < mutations.size()) {
+        int site = mutations[i].Start();
         double scoreSum = 0.0;
-        foreach (const Mutation& m, mutationEnumerator.Mutations(pos, pos + 1)) {
-            scoreSum += std::exp(static_cast<double>(mms.FastScore(m)));
+        for (; i < mutations.size() && mutations[i].Start() == site; i++) {
+            scoreSum += std::exp(static_cast<double>(scores[i]));
         }
         QVs.push_back(ProbabilityToQV(1.0 - 1.0 / (1.0 + scoreSum)));
     }
+    assert(static_cast<int>(QVs.size()) == endPos - beginPos);
+    if (CAPTURE_THIS_CALL()) detail::CaptureQVs(&mms, beginPos, endPos, QVs);
     return QVs;
 }
 
-#if 0
-    Matrix<float> MutationScoresMatrix(mms)
-    {
-        NotYetImplemented();
-    }
+std::vector<float> MutationScoresMatrix(const AbstractMultiReadMutationScorer& mms)
+{
+    UniqueSingleBaseMutationEnumerator mutationEnumerator(mms.Template());
+    return mms.ScoresMany(mutationEnumerator.Mutations());
+}
+
+std::vector<float> MutationScoresMatrix(const AbstractMultiReadMutationScorer& mms,
+                                        const std::vector<Mutation>& mutationsToScore)
+{
+    return mms.ScoresMany(mutationsToScore);
+}
 
+void ConsensusQVsArray(AbstractMultiReadMutationScorer& mms, int** qvs, int* nQvs)
+{
+    std::vector<int> QVs = ConsensusQVs(mms);
+    *nQvs = QVs.size();
+    *qvs = static_cast<int*>(malloc(std::max(1, *nQvs) * sizeof(int)));
+    std::copy(QVs.begin(), QVs.end(), *qvs);
+}
 
-    Matrix<float> MutationScoresMatrix(mms, mutationsToScore)
-    {
-        NotYetImplemented();
-    }
-#endif
+void MutationScoresMatrixArray(const AbstractMultiReadMutationScorer& mms, float** scores,
+                               int* nMutations, int* nReads)
+{
+    UniqueSingleBaseMutationEnumerator mutationEnumerator(mms.Template());
+    std::vector<Mutation> mutations = mutationEnumerator.Mutations();
+    *nMutations = mutations.size();
+    *nReads = mms.NumReads();
+    *scores = static_cast<float*>(malloc(std::max(1, *nMutations * *nReads) * sizeof(float)));
+    mms.ScoresManyInto(mutations, 0.0f, *scores, *nMutations, *nReads);
+}
 }
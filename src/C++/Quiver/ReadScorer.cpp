@@ -20,8 +20,10 @@ ReadScorer::ReadScorer(QuiverConfig& config) : _quiverConfig(config) {}
 float ReadScorer::Score(const string& tpl, const Read& read) const
 {
     int I, J;
-    SparseSseQvRecursor r(_quiverConfig.MovesAvailable, _quiverConfig.Banding);
-    QvEvaluator e(read, tpl, _quiverConfig.QvParams);
+    SparseSseQvRecursor r(_quiverConfig.MovesAvailable,
+                          ReadBanding(_quiverConfig.Banding, read.Features, tpl.length()),
+                          _quiverConfig.Recursor);
+    QvEvaluator e(read, tpl, _quiverConfig.Model);
 
     I = read.Length();
     J = tpl.length();
@@ -34,8 +36,10 @@ float ReadScorer::Score(const string& tpl, const Read& read) const
 const PairwiseAlignment* ReadScorer::Align(const string& tpl, const Read& read) const
 {
     int I, J;
-    SparseSseQvRecursor r(_quiverConfig.MovesAvailable, _quiverConfig.Banding);
-    QvEvaluator e(read, tpl, _quiverConfig.QvParams);
+    SparseSseQvRecursor r(_quiverConfig.MovesAvailable,
+                          ReadBanding(_quiverConfig.Banding, read.Features, tpl.length()),
+                          _quiverConfig.Recursor);
+    QvEvaluator e(read, tpl, _quiverConfig.Model);
 
     I = read.Length();
     J = tpl.length();
@@ -47,8 +51,10 @@ const PairwiseAlignment* ReadScorer::Align(const string& tpl, const Read& read)
 const SparseMatrix* ReadScorer::Alpha(const string& tpl, const Read& read) const
 {
     int I, J;
-    SparseSseQvRecursor r(_quiverConfig.MovesAvailable, _quiverConfig.Banding);
-    QvEvaluator e(read, tpl, _quiverConfig.QvParams);
+    SparseSseQvRecursor r(_quiverConfig.MovesAvailable,
+                          ReadBanding(_quiverConfig.Banding, read.Features, tpl.length()),
+                          _quiverConfig.Recursor);
+    QvEvaluator e(read, tpl, _quiverConfig.Model);
 
     I = read.Length();
     J = tpl.length();
@@ -61,8 +67,10 @@ const SparseMatrix* ReadScorer::Alpha(const string& tpl, const Read& read) const
 const SparseMatrix* ReadScorer::Beta(const string& tpl, const Read& read) const
 {
     int I, J;
-    SparseSseQvRecursor r(_quiverConfig.MovesAvailable, _quiverConfig.Banding);
-    QvEvaluator e(read, tpl, _quiverConfig.QvParams);
+    SparseSseQvRecursor r(_quiverConfig.MovesAvailable,
+                          ReadBanding(_quiverConfig.Banding, read.Features, tpl.length()),
+                          _quiverConfig.Recursor);
+    QvEvaluator e(read, tpl, _quiverConfig.Model);
 
     I = read.Length();
     J = tpl.length();
@@ -0,0 +1,167 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/ReadScorerCache.hpp>
+
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <ConsensusCore/Checksum.hpp>
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Types.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+template <typename T>
+bool SameFeature(const Feature<T>& a, const Feature<T>& b, int length)
+{
+    return length == 0 || std::memcmp(a.get(), b.get(), length * sizeof(T)) == 0;
+}
+
+bool SameFeatures(const QvSequenceFeatures& a, const QvSequenceFeatures& b)
+{
+    int len = a.Length();
+    return len == b.Length() && SameFeature(a.Sequence(), b.Sequence(), len) &&
+           SameFeature(a.SequenceAsFloat, b.SequenceAsFloat, len) &&
+           SameFeature(a.InsQv, b.InsQv, len) && SameFeature(a.SubsQv, b.SubsQv, len) &&
+           SameFeature(a.DelQv, b.DelQv, len) && SameFeature(a.DelTag, b.DelTag, len) &&
+           SameFeature(a.MergeQv, b.MergeQv, len);
+}
+
+// Would a and b, against the same template bases, be filled alike?
+bool SameFill(const MappedRead& a, const MappedRead& b)
+{
+    return a.Chemistry == b.Chemistry && a.Strand == b.Strand && a.PinStart == b.PinStart &&
+           a.PinEnd == b.PinEnd && a.BandHint == b.BandHint && SameFeatures(a.Features, b.Features);
+}
+}
+
+template <typename ScorerType>
+ReadScorerCache<ScorerType>::Entry::Entry(uint64_t key, const MappedRead& mr,
+                                          const std::string& tpl,
+                                          const boost::shared_ptr<const ScorerType>& scorer)
+    : Key(key), Read(mr), Template(tpl), Scorer(scorer)
+{
+}
+
+template <typename ScorerType>
+ReadScorerCache<ScorerType>::ReadScorerCache(int capacity)
+    : capacity_(capacity), hits_(0), misses_(0), entries_(), byKey_(), mutex_()
+{
+    if (capacity < 1) {
+        throw InvalidInputError("ReadScorerCache needs room for at least one scorer");
+    }
+}
+
+template <typename ScorerType>
+int ReadScorerCache<ScorerType>::Capacity() const
+{
+    return capacity_;
+}
+
+template <typename ScorerType>
+int ReadScorerCache<ScorerType>::Size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return byKey_.size();
+}
+
+template <typename ScorerType>
+int ReadScorerCache<ScorerType>::Hits() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+template <typename ScorerType>
+int ReadScorerCache<ScorerType>::Misses() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+template <typename ScorerType>
+uint64_t ReadScorerCache<ScorerType>::Key(const MappedRead& mr, const std::string& tpl)
+{
+    // The features' CRC-32C, and one of the rest of what the fill
+    // depends on
+    uint32_t crc = Checksum::Crc32c(tpl.data(), tpl.length());
+    crc = Checksum::Crc32c(mr.Chemistry.data(), mr.Chemistry.length(), crc);
+    crc = Checksum::Crc32c(&mr.Strand, sizeof(mr.Strand), crc);
+    return (static_cast<uint64_t>(Checksum::Crc32c(mr.Features)) << 32) | crc;
+}
+
+template <typename ScorerType>
+typename ReadScorerCache<ScorerType>::EntryList::iterator ReadScorerCache<ScorerType>::Lookup(
+    uint64_t key, const MappedRead& mr, const std::string& tpl)
+{
+    std::pair<typename KeyIndex::iterator, typename KeyIndex::iterator> range =
+        byKey_.equal_range(key);
+    for (typename KeyIndex::iterator it = range.first; it != range.second; ++it) {
+        const Entry& entry = *it->second;
+        if (entry.Template == tpl && SameFill(entry.Read, mr)) {
+            return it->second;
+        }
+    }
+    return entries_.end();
+}
+
+template <typename ScorerType>
+ScorerType* ReadScorerCache<ScorerType>::Find(const MappedRead& mr, const std::string& tpl)
+{
+    uint64_t key = Key(mr, tpl);
+    std::lock_guard<std::mutex> lock(mutex_);
+    typename EntryList::iterator it = Lookup(key, mr, tpl);
+    if (it == entries_.end()) {
+        misses_++;
+        return NULL;
+    }
+    hits_++;
+    entries_.splice(entries_.begin(), entries_, it);
+    return new ScorerType(*it->Scorer);
+}
+
+template <typename ScorerType>
+void ReadScorerCache<ScorerType>::Insert(const MappedRead& mr, const std::string& tpl,
+                                         const ScorerType& scorer)
+{
+    uint64_t key = Key(mr, tpl);
+    boost::shared_ptr<const ScorerType> copy(new ScorerType(scorer));
+    std::lock_guard<std::mutex> lock(mutex_);
+    typename EntryList::iterator it = Lookup(key, mr, tpl);
+    if (it != entries_.end()) {
+        // Filled again on another thread meanwhile; keep the newer
+        it->Scorer = copy;
+        entries_.splice(entries_.begin(), entries_, it);
+        return;
+    }
+    entries_.push_front(Entry(key, mr, tpl, copy));
+    byKey_.insert(std::make_pair(key, entries_.begin()));
+    while (static_cast<int>(entries_.size()) > capacity_) {
+        typename EntryList::iterator last = --entries_.end();
+        std::pair<typename KeyIndex::iterator, typename KeyIndex::iterator> range =
+            byKey_.equal_range(last->Key);
+        for (typename KeyIndex::iterator k = range.first; k != range.second; ++k) {
+            if (k->second == last) {
+                byKey_.erase(k);
+                break;
+            }
+        }
+        entries_.erase(last);
+    }
+}
+
+template <typename ScorerType>
+void ReadScorerCache<ScorerType>::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    byKey_.clear();
+}
+
+template class ReadScorerCache<MutationScorer<SparseSseQvRecursor> >;
+template class ReadScorerCache<MutationScorer<SparseSseQvSumProductRecursor> >;
+}
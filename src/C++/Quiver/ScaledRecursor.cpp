@@ -0,0 +1,189 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/ScaledRecursor.hpp>
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Simd.hpp>
+
+// The deepest band, in nats, a float probability can hold: cells
+// below FLT_MIN relative to the best of their column are not kept
+#define MAX_SCALED_SCORE_DIFF 87.0f
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+
+typedef Simd<4> S;
+
+// One alpha column: the probabilities of rows [begin, end), in units
+// of exp(logScale).
+struct Column
+{
+    std::vector<float> values;
+    int begin;
+    int end;
+    double logScale;
+};
+
+inline float At(const Column& c, int i)
+{
+    return (i >= c.begin && i < c.end) ? c.values[i - c.begin] : 0.0f;
+}
+
+inline __m128 At4(const Column& c, int i)
+{
+    if (i >= c.begin && i + 4 <= c.end) {
+        return S::Load(&c.values[i - c.begin]);
+    }
+    float buf[4];
+    for (int k = 0; k < 4; k++) {
+        buf[k] = At(c, i + k);
+    }
+    return S::Load(buf);
+}
+
+// The factor taking probabilities of column c to units of
+// exp(logScale)
+inline float Rescale(const Column& c, double logScale)
+{
+    return static_cast<float>(std::exp(c.logScale - logScale));
+}
+}
+
+ScaledSumProductRecursor::ScaledSumProductRecursor(int movesAvailable,
+                                                   const BandingOptions& banding)
+    : movesAvailable_(movesAvailable), bandingOptions_(banding)
+{
+}
+
+float ScaledSumProductRecursor::Score(const QvEvaluator& e) const
+{
+    int I = e.ReadLength();
+    int J = e.TemplateLength();
+    const QvMoveProbs p(e);
+    float bandRatio = std::exp(-std::min(bandingOptions_.ScoreDiff, MAX_SCALED_SCORE_DIFF));
+
+    // The recursion reaches back at most two columns (for merges)
+    Column columns[3];
+    int hintBeginRow = 0, hintEndRow = 0;
+
+    for (int j = 0; j <= J; ++j) {
+        Column& cur = columns[j % 3];
+        const Column* prev = (j >= 1) ? &columns[(j - 1) % 3] : NULL;
+        const Column* prev2 = (j >= 2) ? &columns[(j - 2) % 3] : NULL;
+
+        // The column is computed in the units of the one before it,
+        // whose best cell is then one
+        cur.values.clear();
+        cur.begin = cur.end = hintBeginRow;
+        cur.logScale = prev ? prev->logScale : 0.0;
+        float merge2 = prev2 ? Rescale(*prev2, cur.logScale) : 0.0f;
+
+        int requiredEndRow = std::min(I + 1, hintEndRow);
+        float score = 0.0f;
+        float thresholdScore = 0.0f;
+        float maxScore = 0.0f;
+
+        // Leading rows one at a time, as in SimdRecursor::FillAlpha,
+        // until a multiple of four rows remains.
+        int i;
+        for (i = cur.begin; (i == 0 || (I - i + 1) % 4 != 0) && i <= I; i++) {
+            score = 0.0f;
+            if (i == 0 && j == 0) {
+                score = 1.0f;
+            }
+            if (i > 0 && j > 0) {
+                score += At(*prev, i - 1) * p.Inc(i - 1, j - 1);
+            }
+            if ((movesAvailable_ & MERGE) && (i > 0 && j > 1)) {
+                score += merge2 * At(*prev2, i - 1) * p.Merge(i - 1, j - 2);
+            }
+            if (j > 0) {
+                score += At(*prev, i) * p.Del(i, j - 1);
+            }
+            if (i > 0) {
+                score += At(cur, i - 1) * p.Extra(i - 1, j);
+            }
+            cur.values.push_back(score);
+            cur.end++;
+
+            if (score > maxScore) {
+                maxScore = score;
+                thresholdScore = std::max(maxScore * bandRatio, FLT_MIN);
+            }
+        }
+
+        // Main SIMD loop, four rows at a time
+        for (; i <= I && (score >= thresholdScore || i < requiredEndRow); i += 4) {
+            __m128 score4 = S::Set1(0.0f);
+            if (j > 0) {
+                score4 = S::Add(score4, S::Mul(At4(*prev, i - 1), p.IncN<4>(i - 1, j - 1)));
+            }
+            if ((movesAvailable_ & MERGE) && j >= 2) {
+                score4 = S::Add(score4, S::Mul(S::Mul(S::Set1(merge2), At4(*prev2, i - 1)),
+                                               p.MergeN<4>(i - 1, j - 2)));
+            }
+            if (j > 0) {
+                score4 = S::Add(score4, S::Mul(At4(*prev, i), p.DelN<4>(i, j - 1)));
+            }
+
+            // Extra (non-SIMD cascade)
+            float extra_[4], scores_[4];
+            S::Store(extra_, p.ExtraN<4>(i - 1, j));
+            S::Store(scores_, score4);
+
+            float above = At(cur, i - 1);
+            float potentialNewMax = 0.0f;
+            score = FLT_MAX;
+            for (int k = 0; k < 4; k++) {
+                float v = scores_[k] + above * extra_[k];
+                cur.values.push_back(v);
+                above = v;
+                potentialNewMax = std::max(potentialNewMax, v);
+                score = std::min(score, v);
+            }
+            cur.end += 4;
+
+            if (potentialNewMax > maxScore) {
+                maxScore = potentialNewMax;
+                thresholdScore = std::max(maxScore * bandRatio, FLT_MIN);
+            }
+        }
+
+        // Scale the best cell to one
+        if (maxScore > 0.0f) {
+            const __m128 scale = S::Set1(1.0f / maxScore);
+            size_t k = 0;
+            for (; k + 4 <= cur.values.size(); k += 4) {
+                S::Store(&cur.values[k], S::Mul(S::Load(&cur.values[k]), scale));
+            }
+            for (; k < cur.values.size(); k++) {
+                cur.values[k] /= maxScore;
+            }
+            cur.logScale += std::log(static_cast<double>(maxScore));
+            thresholdScore /= maxScore;
+        }
+
+        // Revise the hints to where the mass of the column lived
+        hintEndRow = cur.end;
+        for (i = cur.begin; i < cur.end && At(cur, i) < thresholdScore; ++i)
+            ;
+        hintBeginRow = i;
+    }
+
+    const Column& last = columns[J % 3];
+    float end = At(last, I);
+    if (end <= 0.0f) {
+        return -FLT_MAX;
+    }
+    return static_cast<float>(std::log(static_cast<double>(end)) + last.logScale);
+}
+}
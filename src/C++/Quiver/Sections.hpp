@@ -0,0 +1,112 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Types.hpp>
+
+namespace ConsensusCore {
+namespace detail {
+
+inline uint64_t Align8(uint64_t offset) { return (offset + 7) & ~static_cast<uint64_t>(7); }
+
+//
+// Writes the sections of a binary encoding, each padded to eight bytes,
+// so that every section starts as aligned as the encoding does, to a
+// string or a stream.
+//
+class SectionWriter
+{
+public:
+    explicit SectionWriter(std::string* out) : str_(out), stream_(NULL), offset_(0) {}
+    explicit SectionWriter(std::ostream* out) : str_(NULL), stream_(out), offset_(0) {}
+
+    void Write(const void* data, uint64_t bytes)
+    {
+        static const char zeros[8] = {0};
+        Append(data, bytes);
+        Append(zeros, Align8(offset_) - offset_);
+    }
+
+    uint64_t Offset() const { return offset_; }
+
+private:
+    void Append(const void* data, uint64_t bytes)
+    {
+        if (str_ != NULL) {
+            str_->append(static_cast<const char*>(data), bytes);
+        } else {
+            stream_->write(static_cast<const char*>(data), bytes);
+        }
+        offset_ += bytes;
+    }
+
+    std::string* str_;
+    std::ostream* stream_;
+    uint64_t offset_;
+};
+
+//
+// Takes the sections SectionWriter wrote in turn, throwing
+// InvalidInputError if one runs past the end of the encoding, which
+// what names.
+//
+class SectionReader
+{
+public:
+    SectionReader(char* data, uint64_t size, const std::string& what)
+        : data_(data), size_(size), offset_(0), what_(what)
+    {
+    }
+
+    char* Take(uint64_t bytes)
+    {
+        if (bytes > size_ - offset_) {
+            throw InvalidInputError(what_ + " is truncated");
+        }
+        char* section = data_ + offset_;
+        offset_ = std::min(size_, Align8(offset_ + bytes));
+        return section;
+    }
+
+    template <typename T>
+    T TakeValue()
+    {
+        T value;
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // n values, copied out, as the encoding need not be aligned for T
+    template <typename T>
+    std::vector<T> TakeValues(uint64_t n)
+    {
+        // Checked before multiplying, which could wrap for a corrupt n
+        if (n > (size_ - offset_) / sizeof(T)) {
+            throw InvalidInputError(what_ + " is truncated");
+        }
+        const char* section = Take(n * sizeof(T));
+        std::vector<T> values(n);
+        if (n > 0) std::memcpy(values.data(), section, n * sizeof(T));
+        return values;
+    }
+
+    std::string TakeString(uint64_t length) { return std::string(Take(length), length); }
+
+    bool AtEnd() const { return offset_ == size_; }
+
+private:
+    char* data_;
+    uint64_t size_;
+    uint64_t offset_;
+    std::string what_;
+};
+}
+}
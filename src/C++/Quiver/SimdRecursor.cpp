@@ -0,0 +1,54 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+
+#include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/detail/Combiner.hpp>
+#include <ConsensusCore/Types.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+#include "SimdRecursorImpl.hpp"
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+std::atomic<int> maxSimdWidth(16);
+
+int CpuSimdWidth()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (__builtin_cpu_supports("avx512f")) return 16;
+    if (__builtin_cpu_supports("avx2")) return 8;
+#endif
+    return 4;
+}
+}
+
+int SimdWidth()
+{
+    static const int cpuWidth = CpuSimdWidth();
+    return std::min(cpuWidth, maxSimdWidth.load());
+}
+
+void SetMaxSimdWidth(int width)
+{
+    if (width != 4 && width != 8 && width != 16) {
+        throw InvalidInputError("SIMD width must be 4, 8 or 16");
+    }
+    maxSimdWidth = width;
+}
+
+template class SimdRecursor<DenseMatrix, QvEvaluator, detail::ViterbiCombiner, 4>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::ViterbiCombiner, 4>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 4>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 4,
+                            detail::TableSumProductCombiner>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 4,
+                            detail::PolynomialSumProductCombiner>;
+template class SimdRecursor<SparseMatrix, EdnaEvaluator, detail::SumProductCombiner, 4>;
+}
@@ -0,0 +1,57 @@
+// Author: David Alexander
+
+// The 8-wide (AVX2) recursor kernels.  Only the width-generic kernels
+// are compiled for AVX2 (see CONSENSUSCORE_SIMD_TARGET); nothing here
+// may be called unless the CPU supports it.
+
+#define CONSENSUSCORE_SIMD_TARGET CONSENSUSCORE_TARGET("avx2")
+
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+
+#include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/detail/Combiner.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "SimdRecursorImpl.hpp"
+
+namespace ConsensusCore {
+namespace detail {
+
+template <typename M, typename E, typename C, typename K>
+RecursorBase<M, E, C>* NewAvx2Recursor(int movesAvailable, const BandingOptions& banding)
+{
+    return new SimdRecursor<M, E, C, 8, K>(movesAvailable, banding);
+}
+
+template RecursorBase<DenseMatrix, QvEvaluator, ViterbiCombiner>*
+NewAvx2Recursor<DenseMatrix, QvEvaluator, ViterbiCombiner, ViterbiCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, ViterbiCombiner>*
+NewAvx2Recursor<SparseMatrix, QvEvaluator, ViterbiCombiner, ViterbiCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, SumProductCombiner>*
+NewAvx2Recursor<SparseMatrix, QvEvaluator, SumProductCombiner, SumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, SumProductCombiner>*
+NewAvx2Recursor<SparseMatrix, QvEvaluator, SumProductCombiner, TableSumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, SumProductCombiner>*
+NewAvx2Recursor<SparseMatrix, QvEvaluator, SumProductCombiner, PolynomialSumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, EdnaEvaluator, SumProductCombiner>*
+NewAvx2Recursor<SparseMatrix, EdnaEvaluator, SumProductCombiner, SumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+}
+
+template class SimdRecursor<DenseMatrix, QvEvaluator, detail::ViterbiCombiner, 8>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::ViterbiCombiner, 8>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 8>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 8,
+                            detail::TableSumProductCombiner>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 8,
+                            detail::PolynomialSumProductCombiner>;
+template class SimdRecursor<SparseMatrix, EdnaEvaluator, detail::SumProductCombiner, 8>;
+}
@@ -0,0 +1,57 @@
+// Author: David Alexander
+
+// The 16-wide (AVX-512F) recursor kernels.  Only the width-generic kernels
+// are compiled for AVX-512F (see CONSENSUSCORE_SIMD_TARGET); nothing here
+// may be called unless the CPU supports it.
+
+#define CONSENSUSCORE_SIMD_TARGET CONSENSUSCORE_TARGET("avx512f")
+
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+
+#include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/detail/Combiner.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "SimdRecursorImpl.hpp"
+
+namespace ConsensusCore {
+namespace detail {
+
+template <typename M, typename E, typename C, typename K>
+RecursorBase<M, E, C>* NewAvx512Recursor(int movesAvailable, const BandingOptions& banding)
+{
+    return new SimdRecursor<M, E, C, 16, K>(movesAvailable, banding);
+}
+
+template RecursorBase<DenseMatrix, QvEvaluator, ViterbiCombiner>*
+NewAvx512Recursor<DenseMatrix, QvEvaluator, ViterbiCombiner, ViterbiCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, ViterbiCombiner>*
+NewAvx512Recursor<SparseMatrix, QvEvaluator, ViterbiCombiner, ViterbiCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, SumProductCombiner>*
+NewAvx512Recursor<SparseMatrix, QvEvaluator, SumProductCombiner, SumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, SumProductCombiner>*
+NewAvx512Recursor<SparseMatrix, QvEvaluator, SumProductCombiner, TableSumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, QvEvaluator, SumProductCombiner>*
+NewAvx512Recursor<SparseMatrix, QvEvaluator, SumProductCombiner, PolynomialSumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+template RecursorBase<SparseMatrix, EdnaEvaluator, SumProductCombiner>*
+NewAvx512Recursor<SparseMatrix, EdnaEvaluator, SumProductCombiner, SumProductCombiner>(
+    int movesAvailable, const BandingOptions& banding);
+}
+
+template class SimdRecursor<DenseMatrix, QvEvaluator, detail::ViterbiCombiner, 16>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::ViterbiCombiner, 16>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 16>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 16,
+                            detail::TableSumProductCombiner>;
+template class SimdRecursor<SparseMatrix, QvEvaluator, detail::SumProductCombiner, 16,
+                            detail::PolynomialSumProductCombiner>;
+template class SimdRecursor<SparseMatrix, EdnaEvaluator, detail::SumProductCombiner, 16>;
+}
@@ -0,0 +1,640 @@
+// Author: David Alexander
+
+// The SimdRecursor member definitions.  This is included by one
+// translation unit per instruction set (SimdRecursor.cpp,
+// SimdRecursorAvx2.cpp, SimdRecursorAvx512.cpp), each of which
+// instantiates its width, the wider two with CONSENSUSCORE_SIMD_TARGET
+// set to their instruction set.
+
+#pragma once
+
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+
+#include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Interval.hpp>
+#include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/detail/Combiner.hpp>
+#include <ConsensusCore/Simd.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include <algorithm>
+#include <boost/tuple/tuple.hpp>
+#include <climits>
+#include <numeric>
+#include <utility>
+
+using std::max;
+using std::min;
+
+#define NEG_INF -FLT_MAX
+#define POS_INF FLT_MAX
+#define NEG_INF_N (S::Set1(Zero<lfloat>()))
+
+namespace ConsensusCore {
+
+template <typename M, typename E, typename C, int W, typename K>
+template <bool Merge>
+CONSENSUSCORE_SIMD_TARGET void SimdRecursor<M, E, C, W, K>::FillAlphaImpl(const E& e,
+                                                                          const M& guide, M& alpha,
+                                                                          int beginColumn,
+                                                                          int endColumn) const
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+
+    int I = e.ReadLength();
+
+    assert(alpha.Rows() == I + 1 && alpha.Columns() == e.TemplateLength() + 1);
+    assert(guide.IsNull() || (guide.Rows() == alpha.Rows() && guide.Columns() == alpha.Columns()));
+    assert(0 <= beginColumn && beginColumn <= endColumn + 1 && endColumn <= e.TemplateLength());
+
+    int hintBeginRow = 0, hintEndRow = 0;
+    if (beginColumn > 0) {
+        boost::tie(hintBeginRow, hintEndRow) = alpha.UsedRowRange(beginColumn - 1);
+    }
+
+    for (int j = beginColumn; j <= endColumn; ++j) {
+        this->RangeGuide(j, guide, alpha, &hintBeginRow, &hintEndRow);
+
+        int requiredEndRow = min(I + 1, hintEndRow);
+
+        float score = NEG_INF;
+        float thresholdScore = NEG_INF;
+        float maxScore = NEG_INF;
+
+        alpha.StartEditingColumn(j, hintBeginRow, hintEndRow);
+
+        int i;
+        int beginRow = hintBeginRow, endRow;
+        // Handle beginning rows non-SIMD.  Must handle row 0 this
+        // way (if row 0 is to be filled), and must terminate with
+        // (I - i + 1) divisible by W, so that the SIMD loop can
+        // run safely to the end.  Banding optimizations not applied
+        // here.
+        for (i = beginRow; (i == 0 || (I - i + 1) % W != 0) && i <= I; i++) {
+            score = NEG_INF;
+
+            // Start:
+            if (i == 0 && j == 0) {
+                score = 0.0f;
+            }
+            // Inc
+            if (i > 0 && j > 0) {
+                score = K::Combine(score, alpha(i - 1, j - 1) + e.Inc(i - 1, j - 1));
+            }
+            // Merge
+            if (Merge && (i > 0 && j > 1)) {
+                score = K::Combine(score, alpha(i - 1, j - 2) + e.Merge(i - 1, j - 2));
+            }
+            // Delete
+            if (j > 0) {
+                score = K::Combine(score, alpha(i, j - 1) + e.Del(i, j - 1));
+            }
+            // Extra
+            if (i > 0) {
+                score = K::Combine(score, alpha(i - 1, j) + e.Extra(i - 1, j));
+            }
+            alpha.Set(i, j, score);
+
+            if (score > maxScore) {
+                maxScore = score;
+                thresholdScore = maxScore - this->bandingOptions_.ScoreDiff;
+            }
+        }
+        //
+        // Main SIMD loop
+        //
+        assert(i > 0);
+        for (; i <= I && (score >= thresholdScore || i < requiredEndRow); i += W) {
+            Vec scoreN = NEG_INF_N;
+            // Incorporation:
+            if (j > 0) {
+                scoreN = K::template CombineN<W>(
+                    scoreN,
+                    S::Add(alpha.template GetN<W>(i - 1, j - 1), e.template IncN<W>(i - 1, j - 1)));
+            }
+            // Merge
+            if (Merge && j >= 2) {
+                scoreN =
+                    K::template CombineN<W>(scoreN, S::Add(alpha.template GetN<W>(i - 1, j - 2),
+                                                           e.template MergeN<W>(i - 1, j - 2)));
+            }
+            // Deletion:
+            if (j > 0) {
+                scoreN = K::template CombineN<W>(
+                    scoreN, S::Add(alpha.template GetN<W>(i, j - 1), e.template DelN<W>(i, j - 1)));
+            }
+
+            //
+            // Extra (non-SIMD cascade)
+            //
+            float insScores_[W], scores_[W + 1];
+
+            S::Store(insScores_, e.template ExtraN<W>(i - 1, j));
+
+            scores_[0] = alpha.Get(i - 1, j);
+            S::Store(&scores_[1], scoreN);
+
+            for (int ii = 1; ii < W + 1; ii++) {
+                float v = K::Combine(scores_[ii], scores_[ii - 1] + insScores_[ii - 1]);
+                scores_[ii] = v;
+            }
+            alpha.template SetN<W>(i, j, S::Load(&scores_[1]));
+
+            // Update score, potentialNewMax
+            float potentialNewMax = *std::max_element(scores_ + 1, scores_ + W + 1);
+            score = *std::min_element(scores_ + 1, scores_ + W + 1);
+
+            if (potentialNewMax > maxScore) {
+                maxScore = potentialNewMax;
+                thresholdScore = maxScore - this->bandingOptions_.ScoreDiff;
+            }
+        }
+
+        endRow = i;
+        alpha.FinishEditingColumn(j, beginRow, endRow);
+
+        // Now, revise the hints to tell the caller where the mass of the
+        // distribution really lived in this column.
+        hintEndRow = endRow;
+        for (i = beginRow; i < endRow && alpha(i, j) < thresholdScore; ++i)
+            ;
+        hintBeginRow = i;
+    }
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+template <bool Merge>
+CONSENSUSCORE_SIMD_TARGET void SimdRecursor<M, E, C, W, K>::FillBetaImpl(const E& e, const M& guide,
+                                                                         M& beta, int beginColumn,
+                                                                         int endColumn) const
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+
+    int I = e.ReadLength();
+    int J = e.TemplateLength();
+
+    assert(beta.Rows() == I + 1 && beta.Columns() == J + 1);
+    assert(guide.IsNull() || (guide.Rows() == beta.Rows() && guide.Columns() == beta.Columns()));
+    assert(0 <= beginColumn && beginColumn - 1 <= endColumn && endColumn <= J);
+
+    int hintBeginRow = I + 1, hintEndRow = I + 1;
+    if (endColumn < J) {
+        boost::tie(hintBeginRow, hintEndRow) = beta.UsedRowRange(endColumn + 1);
+    }
+
+    for (int j = endColumn; j >= beginColumn; --j) {
+        this->RangeGuide(j, guide, beta, &hintBeginRow, &hintEndRow);
+
+        int requiredBeginRow = max(0, hintBeginRow);
+
+        float score = NEG_INF;
+        float thresholdScore = NEG_INF;
+        float maxScore = NEG_INF;
+
+        beta.StartEditingColumn(j, hintBeginRow, hintEndRow);
+        //
+        // See comment in FillAlpha---we are doing the same thing here.
+        // An initial non-SIMD loop, terminating when a multiple of W
+        // rows remain.
+        //
+        int i, beginRow, endRow = hintEndRow;
+        for (i = endRow - 1; (i == I || (i + 1) % W != 0) && i >= 0; i--) {
+            score = NEG_INF;
+
+            // Start:
+            if (i == I && j == J) {
+                score = 0.0f;
+            }
+            // Inc
+            if (i < I && j < J) {
+                score = K::Combine(score, beta(i + 1, j + 1) + e.Inc(i, j));
+            }
+            // Merge
+            if (Merge && j < J - 1 && i < I) {
+                score = K::Combine(score, beta(i + 1, j + 2) + e.Merge(i, j));
+            }
+            // Delete
+            if (j < J) {
+                score = K::Combine(score, beta(i, j + 1) + e.Del(i, j));
+            }
+            // Extra
+            if (i < I) {
+                score = K::Combine(score, beta(i + 1, j) + e.Extra(i, j));
+            }
+
+            beta.Set(i, j, score);
+
+            if (score > maxScore) {
+                maxScore = score;
+                thresholdScore = maxScore - this->bandingOptions_.ScoreDiff;
+            }
+        }
+        //
+        // SIMD loop
+        //
+        i = i - (W - 1);
+        for (; i >= 0 && (score >= thresholdScore || i >= requiredBeginRow); i -= W) {
+            Vec scoreN = NEG_INF_N;
+
+            // Incorporation:
+            if (i < I && j < J) {
+                scoreN = K::template CombineN<W>(
+                    scoreN, S::Add(beta.template GetN<W>(i + 1, j + 1), e.template IncN<W>(i, j)));
+            }
+            // Merge
+            if (Merge && j < J - 1 && i < I) {
+                scoreN = K::template CombineN<W>(scoreN, S::Add(beta.template GetN<W>(i + 1, j + 2),
+                                                                e.template MergeN<W>(i, j)));
+            }
+            // Deletion:
+            if (j < J) {
+                scoreN = K::template CombineN<W>(
+                    scoreN, S::Add(beta.template GetN<W>(i, j + 1), e.template DelN<W>(i, j)));
+            }
+
+            //
+            // Extra (non-SIMD cascade)
+            //
+            float insScores_[W], scores_[W + 1];
+
+            S::Store(insScores_, e.template ExtraN<W>(i, j));
+
+            scores_[W] = beta.Get(i + W, j);
+            S::Store(scores_, scoreN);
+
+            for (int ii = W - 1; ii >= 0; ii--) {
+                float v = K::Combine(scores_[ii], scores_[ii + 1] + insScores_[ii]);
+                scores_[ii] = v;
+            }
+            beta.template SetN<W>(i, j, S::Load(scores_));
+
+            // Update score, potentialNewMax
+            float potentialNewMax = *std::max_element(scores_, scores_ + W);
+            score = *std::min_element(scores_, scores_ + W);
+
+            if (potentialNewMax > maxScore) {
+                maxScore = potentialNewMax;
+                thresholdScore = maxScore - this->bandingOptions_.ScoreDiff;
+            }
+        }
+
+        beginRow = i + W;
+        beta.FinishEditingColumn(j, beginRow, endRow);
+
+        // Now, revise the hints to tell the caller where the mass of the
+        // distribution really lived in this column.
+        hintBeginRow = beginRow;
+        for (i = endRow; i > beginRow && beta(i - 1, j) < thresholdScore; i--)
+            ;
+        hintEndRow = i;
+    }
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+template <bool Merge>
+INLINE_CALLEES CONSENSUSCORE_SIMD_TARGET float
+SimdRecursor<M, E, C, W, K>::LinkAlphaBetaImpl(const E& e, const M& alpha, int alphaColumn,
+                                               const M& beta, int betaColumn,
+                                               int absoluteColumn) const
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+
+    const int I = e.ReadLength();
+
+    assert(alphaColumn > 1 && absoluteColumn > 1);
+    assert(absoluteColumn < e.TemplateLength());
+
+    int usedBegin, usedEnd;
+    boost::tie(usedBegin, usedEnd) =
+        RangeUnion(alpha.UsedRowRange(alphaColumn - 2), alpha.UsedRowRange(alphaColumn - 1),
+                   beta.UsedRowRange(betaColumn), beta.UsedRowRange(betaColumn + 1));
+
+    float v = NEG_INF;
+    Vec vN = NEG_INF_N;
+
+    // SIMD loop
+    int i;
+    for (i = usedBegin; i < usedEnd - W; i += W) {
+        // Incorporate
+        vN = K::template CombineN<W>(vN, S::Add(S::Add(alpha.template GetN<W>(i, alphaColumn - 1),
+                                                       e.template IncN<W>(i, absoluteColumn - 1)),
+                                                beta.template GetN<W>(i + 1, betaColumn)));
+        // Merge (2 possible ways):
+        if (Merge) {
+            vN = K::template CombineN<W>(vN,
+                                         S::Add(S::Add(alpha.template GetN<W>(i, alphaColumn - 2),
+                                                       e.template MergeN<W>(i, absoluteColumn - 2)),
+                                                beta.template GetN<W>(i + 1, betaColumn)));
+            vN = K::template CombineN<W>(vN,
+                                         S::Add(S::Add(alpha.template GetN<W>(i, alphaColumn - 1),
+                                                       e.template MergeN<W>(i, absoluteColumn - 1)),
+                                                beta.template GetN<W>(i + 1, betaColumn + 1)));
+        }
+        // Delete
+        vN = K::template CombineN<W>(vN, S::Add(S::Add(alpha.template GetN<W>(i, alphaColumn - 1),
+                                                       e.template DelN<W>(i, absoluteColumn - 1)),
+                                                beta.template GetN<W>(i, betaColumn)));
+    }
+    // Handle the remaining rows non-SIMD
+    for (; i < usedEnd; i++) {
+        if (i < I) {
+            // Incorporate
+            v = K::Combine(v, alpha(i, alphaColumn - 1) + e.Inc(i, absoluteColumn - 1) +
+                                  beta(i + 1, betaColumn));
+            // Merge (2 possible ways):
+            if (Merge) {
+                v = K::Combine(v, alpha(i, alphaColumn - 2) + e.Merge(i, absoluteColumn - 2) +
+                                      beta(i + 1, betaColumn));
+                v = K::Combine(v, alpha(i, alphaColumn - 1) + e.Merge(i, absoluteColumn - 1) +
+                                      beta(i + 1, betaColumn + 1));
+            }
+        }
+        // Delete:
+        v = K::Combine(
+            v, alpha(i, alphaColumn - 1) + e.Del(i, absoluteColumn - 1) + beta(i, betaColumn));
+    }
+    // Combine vN and v
+    float v_array[W + 1];
+    S::Store(v_array, vN);
+    v_array[W] = v;
+    v = std::accumulate(v_array, v_array + W + 1, NEG_INF, K::Combine);
+    return v;
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+template <bool Merge>
+INLINE_CALLEES CONSENSUSCORE_SIMD_TARGET void
+SimdRecursor<M, E, C, W, K>::ExtendAlphaImpl(const E& e, const M& alpha, int beginColumn, M& ext,
+                                             int numExtColumns) const
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+
+    assert(numExtColumns >= 2);
+    assert(alpha.Rows() == e.ReadLength() + 1 && ext.Rows() == e.ReadLength() + 1);
+
+    // The new template may not be the same length as the old template.
+    // Just make sure that we have anough room to fill out the extend buffer
+    assert(beginColumn + 1 < e.TemplateLength() + 1);
+    assert(ext.Columns() >= numExtColumns);
+    assert(beginColumn >= 2);
+
+    for (int extCol = 0; extCol < numExtColumns; extCol++) {
+        int j = beginColumn + extCol;
+        int beginRow, endRow;
+
+        //
+        // If this extend is contained within the column bounds of
+        // the original alpha, we use the row range that was
+        // previously determined.  Otherwise start at alpha's last
+        // UsedRow beginRow and go to the end.
+        //
+        if (j < alpha.Columns()) {
+            boost::tie(beginRow, endRow) = alpha.UsedRowRange(j);
+        } else {
+            beginRow = alpha.UsedRowRange(alpha.Columns() - 1).Begin;
+            endRow = alpha.Rows();
+        }
+
+        ext.StartEditingColumn(extCol, beginRow, endRow);
+        int i;
+        // Handle the first rows non-SIMD, leaving a multiple of W
+        // entries to be handed off to the SIMD loop.  Need to always
+        // handle at least row 0 this way, so that we don't have
+        // to check for (i > 0) in the SIMD loop.
+        for (i = beginRow; (i == 0 || (endRow - i) % W != 0) && i < endRow; i++) {
+            float prev, score = NEG_INF;
+            if (i > 0) {
+                // Inc
+                prev = (extCol == 0 ? alpha(i - 1, j - 1) : ext(i - 1, extCol - 1));
+                score = K::Combine(score, prev + e.Inc(i - 1, j - 1));
+
+                // Extra
+                prev = ext(i - 1, extCol);
+                score = K::Combine(score, prev + e.Extra(i - 1, j));
+
+                // Merge
+                if (Merge) {
+                    prev = alpha(i - 1, j - 2);
+                    score = K::Combine(score, prev + e.Merge(i - 1, j - 2));
+                }
+            }
+            // Delete
+            prev = (extCol == 0 ? alpha(i, j - 1) : ext(i, extCol - 1));
+            score = K::Combine(score, prev + e.Del(i, j - 1));
+            ext.Set(i, extCol, score);
+        }
+        for (; i < endRow - (W - 1); i += W) {
+            Vec prevN, scoreN = NEG_INF_N;
+
+            // Incorporation:
+            prevN = (extCol == 0 ? alpha.template GetN<W>(i - 1, j - 1)
+                                 : ext.template GetN<W>(i - 1, extCol - 1));
+            scoreN =
+                K::template CombineN<W>(scoreN, S::Add(prevN, e.template IncN<W>(i - 1, j - 1)));
+
+            // Merge
+            if (Merge && j >= 2) {
+                prevN = alpha.template GetN<W>(i - 1, j - 2);
+                scoreN = K::template CombineN<W>(scoreN,
+                                                 S::Add(prevN, e.template MergeN<W>(i - 1, j - 2)));
+            }
+
+            // Deletion:
+            prevN = (extCol == 0 ? alpha.template GetN<W>(i, j - 1)
+                                 : ext.template GetN<W>(i, extCol - 1));
+            scoreN = K::template CombineN<W>(scoreN, S::Add(prevN, e.template DelN<W>(i, j - 1)));
+
+            // Extras:
+            float insScores_[W], scores_[W + 1];
+
+            S::Store(insScores_, e.template ExtraN<W>(i - 1, j));
+
+            scores_[0] = ext.Get(i - 1, extCol);
+            S::Store(&scores_[1], scoreN);
+
+            for (int ii = 1; ii < W + 1; ii++) {
+                float v = K::Combine(scores_[ii], scores_[ii - 1] + insScores_[ii - 1]);
+                scores_[ii] = v;
+            }
+            ext.template SetN<W>(i, extCol, S::Load(&scores_[1]));
+        }
+        assert(i == endRow);
+
+        ext.FinishEditingColumn(extCol, beginRow, endRow);
+    }
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+template <bool Merge>
+INLINE_CALLEES CONSENSUSCORE_SIMD_TARGET void
+SimdRecursor<M, E, C, W, K>::ExtendBetaImpl(const E& e, const M& beta, int lastColumn, M& ext,
+                                            int numExtColumns, int lengthDiff) const
+{
+    typedef Simd<W> S;
+    typedef typename S::Vec Vec;
+
+    int I = beta.Rows() - 1;
+    int J = beta.Columns() - 1;
+
+    int lastExtColumn = numExtColumns - 1;
+
+    assert(beta.Rows() == I + 1 && ext.Rows() == I + 1);
+
+    // The new template may not be the same length as the old template.
+    // Just make sure that we have anough room to fill out the extend buffer
+    assert(lastColumn + 2 <= J);
+    assert(lastColumn >= 0);
+    assert(ext.Columns() >= numExtColumns);
+
+    for (int j = lastColumn; j > lastColumn - numExtColumns; j--) {
+        int jp = j + lengthDiff;
+        int extCol = lastExtColumn - (lastColumn - j);
+        int beginRow, endRow;
+
+        if (j < 0) {
+            beginRow = 0;
+            endRow = beta.UsedRowRange(0).End;
+        } else {
+            boost::tie(beginRow, endRow) = beta.UsedRowRange(j);
+        }
+
+        ext.StartEditingColumn(extCol, beginRow, endRow);
+        int i;
+        // Handle the last rows non-SIMD, leaving a multiple of W
+        // entries to be handed off to the SIMD loop.  Need to always
+        // handle row I this way, so that we don't have to check for
+        // (i < I) in the SIMD loop.
+        for (i = endRow - 1; (i == I || (i - beginRow + 1) % W != 0) && i >= beginRow; i--) {
+            float prev, score = NEG_INF;
+            if (i < I) {
+                // Inc
+                prev = (extCol == lastExtColumn ? beta(i + 1, j + 1) : ext(i + 1, extCol + 1));
+                score = K::Combine(score, prev + e.Inc(i, jp));
+
+                // Extra
+                prev = ext(i + 1, extCol);
+                score = K::Combine(score, prev + e.Extra(i, jp));
+            }
+            // Delete
+            prev = (extCol == lastExtColumn ? beta(i, j + 1) : ext(i, extCol + 1));
+            score = K::Combine(score, prev + e.Del(i, jp));
+
+            // Merge (from beta, as in SimpleRecursor)
+            if (Merge && j < J - 1 && i < I) {
+                prev = beta(i + 1, j + 2);
+                score = K::Combine(score, prev + e.Merge(i, jp));
+            }
+            ext.Set(i, extCol, score);
+        }
+        for (i -= W - 1; i >= beginRow; i -= W) {
+            Vec prevN, scoreN = NEG_INF_N;
+
+            // Incorporation:
+            prevN = (extCol == lastExtColumn ? beta.template GetN<W>(i + 1, j + 1)
+                                             : ext.template GetN<W>(i + 1, extCol + 1));
+            scoreN = K::template CombineN<W>(scoreN, S::Add(prevN, e.template IncN<W>(i, jp)));
+
+            // Merge
+            if (Merge && j < J - 1) {
+                prevN = beta.template GetN<W>(i + 1, j + 2);
+                scoreN =
+                    K::template CombineN<W>(scoreN, S::Add(prevN, e.template MergeN<W>(i, jp)));
+            }
+
+            // Deletion:
+            prevN = (extCol == lastExtColumn ? beta.template GetN<W>(i, j + 1)
+                                             : ext.template GetN<W>(i, extCol + 1));
+            scoreN = K::template CombineN<W>(scoreN, S::Add(prevN, e.template DelN<W>(i, jp)));
+
+            // Extras:
+            float insScores_[W], scores_[W + 1];
+
+            S::Store(insScores_, e.template ExtraN<W>(i, jp));
+
+            scores_[W] = ext.Get(i + W, extCol);
+            S::Store(scores_, scoreN);
+
+            for (int ii = W - 1; ii >= 0; ii--) {
+                float v = K::Combine(scores_[ii], scores_[ii + 1] + insScores_[ii]);
+                scores_[ii] = v;
+            }
+            ext.template SetN<W>(i, extCol, S::Load(scores_));
+        }
+        assert(i == beginRow - W);
+
+        ext.FinishEditingColumn(extCol, beginRow, endRow);
+    }
+}
+
+//
+// The public entry points pick the instantiation for the moves
+// available, so that the inner loops do not test for merges
+//
+template <typename M, typename E, typename C, int W, typename K>
+void SimdRecursor<M, E, C, W, K>::FillAlpha(const E& e, const M& guide, M& alpha, int beginColumn,
+                                            int endColumn) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        FillAlphaImpl<true>(e, guide, alpha, beginColumn, endColumn);
+    } else {
+        FillAlphaImpl<false>(e, guide, alpha, beginColumn, endColumn);
+    }
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+void SimdRecursor<M, E, C, W, K>::FillBeta(const E& e, const M& guide, M& beta, int beginColumn,
+                                           int endColumn) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        FillBetaImpl<true>(e, guide, beta, beginColumn, endColumn);
+    } else {
+        FillBetaImpl<false>(e, guide, beta, beginColumn, endColumn);
+    }
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+float SimdRecursor<M, E, C, W, K>::LinkAlphaBeta(const E& e, const M& alpha, int alphaColumn,
+                                                 const M& beta, int betaColumn,
+                                                 int absoluteColumn) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        return LinkAlphaBetaImpl<true>(e, alpha, alphaColumn, beta, betaColumn, absoluteColumn);
+    }
+    return LinkAlphaBetaImpl<false>(e, alpha, alphaColumn, beta, betaColumn, absoluteColumn);
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+void SimdRecursor<M, E, C, W, K>::ExtendAlpha(const E& e, const M& alpha, int beginColumn, M& ext,
+                                              int numExtColumns) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        ExtendAlphaImpl<true>(e, alpha, beginColumn, ext, numExtColumns);
+    } else {
+        ExtendAlphaImpl<false>(e, alpha, beginColumn, ext, numExtColumns);
+    }
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+void SimdRecursor<M, E, C, W, K>::ExtendBeta(const E& e, const M& beta, int lastColumn, M& ext,
+                                             int numExtColumns, int lengthDiff) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        ExtendBetaImpl<true>(e, beta, lastColumn, ext, numExtColumns, lengthDiff);
+    } else {
+        ExtendBetaImpl<false>(e, beta, lastColumn, ext, numExtColumns, lengthDiff);
+    }
+}
+
+template <typename M, typename E, typename C, int W, typename K>
+SimdRecursor<M, E, C, W, K>::SimdRecursor(int movesAvailable, const BandingOptions& banding,
+                                          const RecursorConfig& config)
+    : detail::RecursorBase<M, E, C>(movesAvailable, banding, config)
+{
+}
+}
@@ -24,17 +24,22 @@ using std::max;
 namespace ConsensusCore {
 
 template <typename M, typename E, typename C>
-void SimpleRecursor<M, E, C>::FillAlpha(const E& e, const M& guide, M& alpha) const
+template <bool Merge>
+void SimpleRecursor<M, E, C>::FillAlphaImpl(const E& e, const M& guide, M& alpha, int beginColumn,
+                                            int endColumn) const
 {
     int I = e.ReadLength();
-    int J = e.TemplateLength();
 
-    assert(alpha.Rows() == I + 1 && alpha.Columns() == J + 1);
+    assert(alpha.Rows() == I + 1 && alpha.Columns() == e.TemplateLength() + 1);
     assert(guide.IsNull() || (guide.Rows() == alpha.Rows() && guide.Columns() == alpha.Columns()));
+    assert(0 <= beginColumn && beginColumn <= endColumn + 1 && endColumn <= e.TemplateLength());
 
     int hintBeginRow = 0, hintEndRow = 0;
+    if (beginColumn > 0) {
+        boost::tie(hintBeginRow, hintEndRow) = alpha.UsedRowRange(beginColumn - 1);
+    }
 
-    for (int j = 0; j <= J; ++j) {
+    for (int j = beginColumn; j <= endColumn; ++j) {
         this->RangeGuide(j, guide, alpha, &hintBeginRow, &hintEndRow);
 
         int requiredEndRow = min(I + 1, hintEndRow);
@@ -75,7 +80,7 @@ void SimpleRecursor<M, E, C>::FillAlpha(const E& e, const M& guide, M& alpha) co
             }
 
             // Merge:
-            if ((this->movesAvailable_ & MERGE) && j > 1 && i > 0) {
+            if (Merge && j > 1 && i > 0) {
                 thisMoveScore = alpha(i - 1, j - 2) + e.Merge(i - 1, j - 2);
                 score = C::Combine(score, thisMoveScore);
             }
@@ -102,17 +107,23 @@ void SimpleRecursor<M, E, C>::FillAlpha(const E& e, const M& guide, M& alpha) co
 }
 
 template <typename M, typename E, typename C>
-void SimpleRecursor<M, E, C>::FillBeta(const E& e, const M& guide, M& beta) const
+template <bool Merge>
+void SimpleRecursor<M, E, C>::FillBetaImpl(const E& e, const M& guide, M& beta, int beginColumn,
+                                           int endColumn) const
 {
     int I = e.ReadLength();
     int J = e.TemplateLength();
 
     assert(beta.Rows() == I + 1 && beta.Columns() == J + 1);
     assert(guide.IsNull() || (guide.Rows() == beta.Rows() && guide.Columns() == beta.Columns()));
+    assert(0 <= beginColumn && beginColumn - 1 <= endColumn && endColumn <= J);
 
     int hintBeginRow = I + 1, hintEndRow = I + 1;
+    if (endColumn < J) {
+        boost::tie(hintBeginRow, hintEndRow) = beta.UsedRowRange(endColumn + 1);
+    }
 
-    for (int j = J; j >= 0; --j) {
+    for (int j = endColumn; j >= beginColumn; --j) {
         this->RangeGuide(j, guide, beta, &hintBeginRow, &hintEndRow);
 
         int requiredBeginRow = max(0, hintBeginRow);
@@ -153,7 +164,7 @@ void SimpleRecursor<M, E, C>::FillBeta(const E& e, const M& guide, M& beta) cons
             }
 
             // Merge:
-            if ((this->movesAvailable_ & MERGE) && j < J - 1 && i < I) {
+            if (Merge && j < J - 1 && i < I) {
                 thisMoveScore = beta(i + 1, j + 2) + e.Merge(i, j);
                 score = C::Combine(score, thisMoveScore);
             }
@@ -234,8 +245,9 @@ float SimpleRecursor<M, E, C>::LinkAlphaBeta(const E& e, const M& alpha, int alp
 // Reads: alpha(:, (beginColumn-2)..)
 //
 template <typename M, typename E, typename C>
-void SimpleRecursor<M, E, C>::ExtendAlpha(const E& e, const M& alpha, int beginColumn, M& ext,
-                                          int numExtColumns) const
+template <bool Merge>
+void SimpleRecursor<M, E, C>::ExtendAlphaImpl(const E& e, const M& alpha, int beginColumn, M& ext,
+                                              int numExtColumns) const
 {
     assert(numExtColumns >= 2);
     assert(alpha.Rows() == e.ReadLength() + 1 && ext.Rows() == e.ReadLength() + 1);
@@ -294,7 +306,7 @@ void SimpleRecursor<M, E, C>::ExtendAlpha(const E& e, const M& alpha, int beginC
 
             // FIXME: is the merge code below incorrect for numExtColumns > 2?
             // Merge:
-            if ((this->movesAvailable_ & MERGE) && j > 1 && i > 0) {
+            if (Merge && j > 1 && i > 0) {
                 float prev = alpha(i - 1, j - 2);
                 thisMoveScore = prev + e.Merge(i - 1, j - 2);
                 score = C::Combine(score, thisMoveScore);
@@ -317,8 +329,9 @@ void SimpleRecursor<M, E, C>::ExtendAlpha(const E& e, const M& alpha, int beginC
 //
 // Accesses B(:, ..(j+2))
 template <typename M, typename E, typename C>
-void SimpleRecursor<M, E, C>::ExtendBeta(const E& e, const M& beta, int lastColumn, M& ext,
-                                         int numExtColumns, int lengthDiff) const
+template <bool Merge>
+void SimpleRecursor<M, E, C>::ExtendBetaImpl(const E& e, const M& beta, int lastColumn, M& ext,
+                                             int numExtColumns, int lengthDiff) const
 {
     int I = beta.Rows() - 1;
     int J = beta.Columns() - 1;
@@ -377,7 +390,7 @@ void SimpleRecursor<M, E, C>::ExtendBeta(const E& e, const M& beta, int lastColu
 
             // FIXME: is the merge code below incorrect for numExtColumns > 2?
             // Merge:
-            if ((this->movesAvailable_ & MERGE) && j < J - 1 && i < I) {
+            if (Merge && j < J - 1 && i < I) {
                 thisMoveScore = beta(i + 1, j + 2) + e.Merge(i, jp);
                 score = C::Combine(score, thisMoveScore);
             }
@@ -388,9 +401,58 @@ void SimpleRecursor<M, E, C>::ExtendBeta(const E& e, const M& beta, int lastColu
     }
 }
 
+//
+// The public entry points pick the instantiation for the moves
+// available, so that the inner loops do not test for merges
+//
+template <typename M, typename E, typename C>
+void SimpleRecursor<M, E, C>::FillAlpha(const E& e, const M& guide, M& alpha, int beginColumn,
+                                        int endColumn) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        FillAlphaImpl<true>(e, guide, alpha, beginColumn, endColumn);
+    } else {
+        FillAlphaImpl<false>(e, guide, alpha, beginColumn, endColumn);
+    }
+}
+
+template <typename M, typename E, typename C>
+void SimpleRecursor<M, E, C>::FillBeta(const E& e, const M& guide, M& beta, int beginColumn,
+                                       int endColumn) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        FillBetaImpl<true>(e, guide, beta, beginColumn, endColumn);
+    } else {
+        FillBetaImpl<false>(e, guide, beta, beginColumn, endColumn);
+    }
+}
+
+template <typename M, typename E, typename C>
+void SimpleRecursor<M, E, C>::ExtendAlpha(const E& e, const M& alpha, int beginColumn, M& ext,
+                                          int numExtColumns) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        ExtendAlphaImpl<true>(e, alpha, beginColumn, ext, numExtColumns);
+    } else {
+        ExtendAlphaImpl<false>(e, alpha, beginColumn, ext, numExtColumns);
+    }
+}
+
+template <typename M, typename E, typename C>
+void SimpleRecursor<M, E, C>::ExtendBeta(const E& e, const M& beta, int lastColumn, M& ext,
+                                         int numExtColumns, int lengthDiff) const
+{
+    if (this->movesAvailable_ & MERGE) {
+        ExtendBetaImpl<true>(e, beta, lastColumn, ext, numExtColumns, lengthDiff);
+    } else {
+        ExtendBetaImpl<false>(e, beta, lastColumn, ext, numExtColumns, lengthDiff);
+    }
+}
+
 template <typename M, typename E, typename C>
-SimpleRecursor<M, E, C>::SimpleRecursor(int movesAvailable, const BandingOptions& banding)
-    : detail::RecursorBase<M, E, C>(movesAvailable, banding)
+SimpleRecursor<M, E, C>::SimpleRecursor(int movesAvailable, const BandingOptions& banding,
+                                        const RecursorConfig& config)
+    : detail::RecursorBase<M, E, C>(movesAvailable, banding, config)
 {
 }
 
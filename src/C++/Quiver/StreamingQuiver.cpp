@@ -0,0 +1,128 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/StreamingQuiver.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+StreamingQuiver::StreamingQuiver(const QuiverConfigTable& configs, const std::string& reference,
+                                 int step, const RefineOptions& options)
+    : reference_(reference)
+    , step_(step)
+    , options_(options)
+    , mms_(configs, "")
+    , placed_()
+    , refEnd_(0)
+    , lastStart_(0)
+    , advancedAt_(0)
+    , finished_(false)
+    , settled_()
+{
+    if (step <= 0) {
+        throw InvalidInputError("The step of a StreamingQuiver must be positive");
+    }
+    settled_.Converged = true;
+}
+
+void StreamingQuiver::AddRead(const MappedRead& mr)
+{
+    if (finished_) {
+        throw InvalidInputError("Can't add reads to a finished StreamingQuiver");
+    }
+    if (mr.TemplateStart < lastStart_ || mr.TemplateEnd < mr.TemplateStart ||
+        mr.TemplateEnd > static_cast<int>(reference_.length())) {
+        throw InvalidInputError("Reads must lie on the reference, in order of their start");
+    }
+
+    if (mr.TemplateStart - advancedAt_ >= step_) {
+        Advance(mr.TemplateStart);
+    }
+    if (mr.TemplateEnd > refEnd_) {
+        mms_.SlideTemplate(0, reference_.substr(refEnd_, mr.TemplateEnd - refEnd_));
+        refEnd_ = mr.TemplateEnd;
+    }
+
+    // Band hints are for the reference, not the template
+    MappedRead placed(mr);
+    placed.TemplateStart = TemplatePosition(mr.TemplateStart);
+    placed.TemplateEnd = std::max(placed.TemplateStart, TemplatePosition(mr.TemplateEnd));
+    placed.BandHint.clear();
+    if (mms_.AddRead(placed)) settled_.NumReads++;
+
+    PlacedRead p = {mms_.NumReads() - 1, mr.TemplateStart, mr.TemplateEnd};
+    placed_.push_back(p);
+    lastStart_ = mr.TemplateStart;
+}
+
+void StreamingQuiver::Finish()
+{
+    if (finished_) return;
+    int refLength = reference_.length();
+    if (refEnd_ < refLength) {
+        mms_.SlideTemplate(0, reference_.substr(refEnd_));
+        refEnd_ = refLength;
+    }
+    Advance(refLength);
+    finished_ = true;
+}
+
+ConsensusResult StreamingQuiver::Take()
+{
+    ConsensusResult result;
+    std::swap(result, settled_);
+    settled_.Converged = true;
+    return result;
+}
+
+int StreamingQuiver::WindowLength() const { return mms_.TemplateLength(); }
+
+int StreamingQuiver::TemplatePosition(int refPos) const
+{
+    int bestRef = refEnd_;
+    int bestPos = mms_.TemplateLength();
+    foreach (const PlacedRead& p, placed_) {
+        const MappedRead* mr = mms_.Read(p.Index);
+        if (mr == NULL) continue;
+        if (std::abs(p.RefStart - refPos) < std::abs(bestRef - refPos)) {
+            bestRef = p.RefStart;
+            bestPos = mr->TemplateStart;
+        }
+        if (std::abs(p.RefEnd - refPos) < std::abs(bestRef - refPos)) {
+            bestRef = p.RefEnd;
+            bestPos = mr->TemplateEnd;
+        }
+    }
+    return std::min(std::max(0, bestPos + refPos - bestRef), mms_.TemplateLength());
+}
+
+void StreamingQuiver::Advance(int refPos)
+{
+    settled_.Converged = RefineConsensus(mms_, options_) && settled_.Converged;
+
+    // No read yet to come starts before refPos, so what lies before it
+    // and before every read reaching past it is settled
+    int cut = TemplatePosition(refPos);
+    foreach (const PlacedRead& p, placed_) {
+        const MappedRead* mr = mms_.Read(p.Index);
+        if (mr != NULL && p.RefEnd > refPos) cut = std::min(cut, mr->TemplateStart);
+    }
+    std::vector<int> qvs = ConsensusQVs(mms_, 0, cut);
+    settled_.Sequence += mms_.Template().substr(0, cut);
+    settled_.QVs.insert(settled_.QVs.end(), qvs.begin(), qvs.end());
+    mms_.SlideTemplate(cut, "");
+
+    // The reads ending before refPos lie on what was trimmed, or soon
+    // will; forget them as they leave the front
+    while (!placed_.empty() && placed_.front().RefEnd <= refPos) {
+        placed_.pop_front();
+    }
+    advancedAt_ = refPos;
+}
+}
@@ -0,0 +1,150 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/TandemRepeatIndex.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Interval.hpp>
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+//
+// The template has period k over [s, e) exactly when Periodic(tpl, k, i)
+// for every i in [s, e - k), so the repeats of unit length k are the
+// runs of k or more periodic positions, each extended by k bases.
+//
+inline bool Periodic(const std::string& tpl, int k, int i) { return tpl[i] == tpl[i + k]; }
+
+// The number of positions i that Periodic may be asked of
+inline int PeriodicPositions(const std::string& tpl, int k)
+{
+    return std::max(0, static_cast<int>(tpl.length()) - k);
+}
+
+// Add to *out the repeats of unit length k whose periodic runs lie in
+// [begin, end), in order
+void ScanRepeats(const std::string& tpl, int k, int begin, int end,
+                 std::vector<TandemRepeat>* out)
+{
+    int i = begin;
+    while (i < end) {
+        if (!Periodic(tpl, k, i)) {
+            i++;
+            continue;
+        }
+        int runStart = i;
+        while (i < end && Periodic(tpl, k, i)) {
+            i++;
+        }
+        if (i - runStart >= k) {
+            out->push_back(TandemRepeat(runStart, i + k, k));
+        }
+    }
+}
+}  // PRIVATE
+
+TandemRepeatIndex::TandemRepeatIndex(const std::string& tpl, int maxUnitLength)
+    : repeats_(maxUnitLength)
+{
+    if (maxUnitLength < 1) {
+        throw InvalidInputError("TandemRepeatIndex needs a unit length of at least 1");
+    }
+    for (int k = 1; k <= maxUnitLength; k++) {
+        ScanRepeats(tpl, k, 0, PeriodicPositions(tpl, k), &repeats_[k - 1]);
+    }
+}
+
+std::vector<TandemRepeat> TandemRepeatIndex::Repeats(int unitLength, int beginPos,
+                                                     int endPos) const
+{
+    std::vector<TandemRepeat> result;
+    ForEachRepeat(unitLength, beginPos, endPos,
+                  [&](const TandemRepeat& r) { result.push_back(r); });
+    return result;
+}
+
+void TandemRepeatIndex::ApplyMutations(const std::vector<Mutation>& mutations,
+                                       const std::string& oldTpl, const std::string& newTpl)
+{
+    std::vector<Mutation> sortedMuts(mutations);
+    std::sort(sortedMuts.begin(), sortedMuts.end());
+    std::vector<int> mtp = TargetToQueryPositions(sortedMuts, oldTpl);
+
+    for (int k = 1; k <= MaxUnitLength(); k++) {
+        const int positions = PeriodicPositions(newTpl, k);
+
+        // The periodic positions of the new template to rescan: those
+        // about each mutation, and those of the repeats it touches.
+        // The rest of the repeats keep their extents, moved over.
+        std::vector<Interval> windows;
+        foreach (const Mutation& m, sortedMuts) {
+            int pad = k + 1 + m.NewBasesLength();
+            windows.push_back(Interval(mtp[m.Start()] - pad, mtp[m.End()] + pad));
+        }
+        std::vector<TandemRepeat> kept;
+        size_t next = 0;  // the first mutation that may touch the repeat
+        foreach (const TandemRepeat& r, repeats_[k - 1]) {
+            while (next < sortedMuts.size() && sortedMuts[next].End() < r.Start) {
+                next++;
+            }
+            if (next < sortedMuts.size() && sortedMuts[next].Start() <= r.End) {
+                windows.push_back(Interval(mtp[r.Start], std::max(mtp[r.Start], mtp[r.End] - k)));
+            } else {
+                kept.push_back(TandemRepeat(mtp[r.Start], mtp[r.Start] + r.End - r.Start, k));
+            }
+        }
+
+        // Widen each window to the ends of the periodic runs at its
+        // edges, so that it holds whole runs, then merge them
+        foreach (Interval& w, windows) {
+            w.Begin = std::max(0, w.Begin);
+            w.End = std::min(positions, std::max(w.Begin, w.End));
+            while (w.Begin > 0 && Periodic(newTpl, k, w.Begin - 1)) {
+                w.Begin--;
+            }
+            while (w.End < positions && Periodic(newTpl, k, w.End)) {
+                w.End++;
+            }
+        }
+        std::sort(windows.begin(), windows.end(),
+                  [](const Interval& a, const Interval& b) { return a.Begin < b.Begin; });
+        std::vector<Interval> merged;
+        foreach (const Interval& w, windows) {
+            if (!merged.empty() && w.Begin <= merged.back().End) {
+                merged.back().End = std::max(merged.back().End, w.End);
+            } else {
+                merged.push_back(w);
+            }
+        }
+
+        std::vector<TandemRepeat> repeats;
+        repeats.reserve(kept.size() + merged.size());
+        size_t w = 0;
+        foreach (const TandemRepeat& r, kept) {
+            // the windows wholly before this repeat are rescanned first
+            while (w < merged.size() && merged[w].End <= r.Start) {
+                ScanRepeats(newTpl, k, merged[w].Begin, merged[w].End, &repeats);
+                w++;
+            }
+            bool rescanned = (w < merged.size() && merged[w].Begin < r.End - k);
+            if (!rescanned) {
+                repeats.push_back(r);
+            }
+        }
+        for (; w < merged.size(); w++) {
+            ScanRepeats(newTpl, k, merged[w].Begin, merged[w].End, &repeats);
+        }
+        assert(std::is_sorted(
+            repeats.begin(), repeats.end(),
+            [](const TandemRepeat& a, const TandemRepeat& b) { return a.Start < b.Start; }));
+        repeats_[k - 1].swap(repeats);
+    }
+}
+}
@@ -0,0 +1,634 @@
+// Author: David Alexander
+
+#include <ConsensusCore/Quiver/WorkUnit.hpp>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ConsensusCore/Feature.hpp>
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "Sections.hpp"
+
+// The tracks, in encoding order
+#define NUM_TRACKS 6
+
+// Flags of a read
+#define REVERSE_FLAG 1
+#define PIN_START_FLAG 2
+#define PIN_END_FLAG 4
+
+namespace ConsensusCore {
+using detail::SectionReader;
+using detail::SectionWriter;
+
+namespace {  // PRIVATE
+const char UNIT_MAGIC[8] = {'C', 'C', 'W', 'U', 'N', 'I', 'T', 0};
+const char RESULT_MAGIC[8] = {'C', 'C', 'W', 'R', 'S', 'L', 'T', 0};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ByteOrder;
+};
+
+struct UnitHeader
+{
+    Header H;
+    int64_t Id;
+    uint64_t TemplateLength;
+    uint64_t NumReads;
+    uint64_t NumChemistries;
+};
+
+struct ReadRecord
+{
+    uint64_t Length;
+    int32_t TemplateStart;
+    int32_t TemplateEnd;
+    uint32_t NameLength;
+    uint16_t Chemistry;
+    uint8_t Flags;
+    uint8_t ByteTracks;  // bit t is set if track t takes a byte a base
+};
+
+struct ResultHeader
+{
+    Header H;
+    int64_t Id;
+    uint64_t SequenceLength;
+    uint64_t NumQVs;
+    uint64_t ErrorLength;
+    int32_t NumReads;
+    uint32_t Converged;
+};
+
+Header MakeHeader(const char* magic)
+{
+    Header h;
+    std::memcpy(h.Magic, magic, sizeof(h.Magic));
+    h.Version = WORK_UNIT_VERSION;
+    h.ByteOrder = BYTE_ORDER_MARK;
+    return h;
+}
+
+void CheckHeader(const Header& h, const char* magic)
+{
+    if (std::memcmp(h.Magic, magic, sizeof(h.Magic)) != 0) {
+        throw InvalidInputError("Not a work unit encoding of the expected kind");
+    }
+    if (h.ByteOrder != BYTE_ORDER_MARK) {
+        throw InvalidInputError("Work unit was encoded in another byte order");
+    }
+    if (h.Version != WORK_UNIT_VERSION) {
+        throw InvalidInputError("Work unit was encoded in an unsupported version");
+    }
+}
+
+bool FitsInByte(const Feature<float>& track)
+{
+    for (int i = 0; i < track.Length(); i++) {
+        float v = track[i];
+        if (!(v >= 0.0f && v <= 255.0f && v == std::floor(v))) return false;
+    }
+    return true;
+}
+
+void WriteRead(SectionWriter* w, const MappedRead& mr, uint16_t chemistry)
+{
+    const QvSequenceFeatures& f = mr.Features;
+    const Feature<float>* tracks[NUM_TRACKS] = {&f.SequenceAsFloat, &f.InsQv,  &f.SubsQv,
+                                                &f.DelQv,           &f.DelTag, &f.MergeQv};
+    ReadRecord r;
+    std::memset(&r, 0, sizeof(r));
+    r.Length = mr.Length();
+    r.TemplateStart = mr.TemplateStart;
+    r.TemplateEnd = mr.TemplateEnd;
+    r.NameLength = mr.Name.length();
+    r.Chemistry = chemistry;
+    r.Flags = (mr.Strand == REVERSE_STRAND ? REVERSE_FLAG : 0) |
+              (mr.PinStart ? PIN_START_FLAG : 0) | (mr.PinEnd ? PIN_END_FLAG : 0);
+    for (int t = 0; t < NUM_TRACKS; t++) {
+        if (FitsInByte(*tracks[t])) r.ByteTracks |= 1 << t;
+    }
+
+    w->Write(&r, sizeof(r));
+    w->Write(mr.Name.data(), mr.Name.length());
+    w->Write(f.Sequence().get(), r.Length);
+    for (int t = 0; t < NUM_TRACKS; t++) {
+        if (r.ByteTracks & (1 << t)) {
+            std::vector<uint8_t> bytes(tracks[t]->get(), tracks[t]->get() + r.Length);
+            w->Write(bytes.data(), bytes.size());
+        } else {
+            w->Write(tracks[t]->get(), r.Length * sizeof(float));
+        }
+    }
+}
+
+MappedRead ReadRead(SectionReader* in, const std::vector<std::string>& chemistries,
+                    uint64_t templateLength, const boost::shared_ptr<void>& owner)
+{
+    ReadRecord r = in->TakeValue<ReadRecord>();
+    if (r.Chemistry >= chemistries.size() || r.Length > INT32_MAX || r.TemplateStart < 0 ||
+        r.TemplateStart > r.TemplateEnd || static_cast<uint64_t>(r.TemplateEnd) > templateLength) {
+        throw InvalidInputError("Work unit encoding is corrupt");
+    }
+    int length = r.Length;
+    std::string name = in->TakeString(r.NameLength);
+    CharFeature seq(in->Take(length), length, owner);
+    std::vector<FloatFeature> tracks;
+    for (int t = 0; t < NUM_TRACKS; t++) {
+        if (r.ByteTracks & (1 << t)) {
+            const unsigned char* bytes = reinterpret_cast<unsigned char*>(in->Take(length));
+            tracks.push_back(FloatFeature(bytes, length));
+            continue;
+        }
+        char* floats = in->Take(static_cast<uint64_t>(length) * sizeof(float));
+        if (reinterpret_cast<uintptr_t>(floats) % sizeof(float) == 0) {
+            tracks.push_back(FloatFeature(reinterpret_cast<float*>(floats), length, owner));
+        } else {
+            FloatFeature track(length);
+            std::memcpy(track.get(), floats, length * sizeof(float));
+            tracks.push_back(track);
+        }
+    }
+    QvSequenceFeatures f(seq, tracks[0], tracks[1], tracks[2], tracks[3], tracks[4], tracks[5]);
+    return MappedRead(Read(f, name, chemistries[r.Chemistry]),
+                      (r.Flags & REVERSE_FLAG) ? REVERSE_STRAND : FORWARD_STRAND,
+                      r.TemplateStart, r.TemplateEnd, r.Flags & PIN_START_FLAG,
+                      r.Flags & PIN_END_FLAG);
+}
+}  // PRIVATE
+
+std::string EncodeWorkUnit(const WorkUnit& unit)
+{
+    std::vector<std::string> chemistries;
+    std::map<std::string, uint16_t> chemistryIndex;
+    std::vector<uint16_t> readChemistries;
+    foreach (const MappedRead& mr, unit.Reads) {
+        if (chemistryIndex.find(mr.Chemistry) == chemistryIndex.end()) {
+            if (chemistries.size() > UINT16_MAX) {
+                throw UnsupportedFeatureError("Too many chemistries for a work unit");
+            }
+            chemistryIndex[mr.Chemistry] = chemistries.size();
+            chemistries.push_back(mr.Chemistry);
+        }
+        readChemistries.push_back(chemistryIndex[mr.Chemistry]);
+    }
+
+    UnitHeader h;
+    h.H = MakeHeader(UNIT_MAGIC);
+    h.Id = unit.Id;
+    h.TemplateLength = unit.Template.length();
+    h.NumReads = unit.Reads.size();
+    h.NumChemistries = chemistries.size();
+
+    std::string out;
+    SectionWriter w(&out);
+    w.Write(&h, sizeof(h));
+    foreach (const std::string& chemistry, chemistries) {
+        uint64_t length = chemistry.length();
+        w.Write(&length, sizeof(length));
+        w.Write(chemistry.data(), length);
+    }
+    w.Write(unit.Template.data(), unit.Template.length());
+    for (size_t k = 0; k < unit.Reads.size(); k++) {
+        WriteRead(&w, unit.Reads[k], readChemistries[k]);
+    }
+    return out;
+}
+
+WorkUnit DecodeWorkUnit(const std::string& bytes)
+{
+    return DecodeWorkUnit(boost::shared_ptr<std::string>(new std::string(bytes)));
+}
+
+WorkUnit DecodeWorkUnit(const boost::shared_ptr<std::string>& buffer)
+{
+    SectionReader in(&(*buffer)[0], buffer->size(), "Work unit encoding");
+    UnitHeader h = in.TakeValue<UnitHeader>();
+    CheckHeader(h.H, UNIT_MAGIC);
+    // Bounding the counts by the size keeps a corrupt header from
+    // reserving too much
+    if (h.NumReads > buffer->size() || h.NumChemistries > buffer->size()) {
+        throw InvalidInputError("Work unit encoding is truncated");
+    }
+
+    std::vector<std::string> chemistries;
+    for (uint64_t c = 0; c < h.NumChemistries; c++) {
+        chemistries.push_back(in.TakeString(in.TakeValue<uint64_t>()));
+    }
+    WorkUnit unit(h.Id, in.TakeString(h.TemplateLength));
+    unit.Reads.reserve(h.NumReads);
+    boost::shared_ptr<void> owner(buffer);
+    for (uint64_t k = 0; k < h.NumReads; k++) {
+        unit.Reads.push_back(ReadRead(&in, chemistries, h.TemplateLength, owner));
+    }
+    if (!in.AtEnd()) {
+        throw InvalidInputError("Work unit encoding is corrupt");
+    }
+    return unit;
+}
+
+std::string EncodeConsensusResult(const ConsensusResult& result)
+{
+    std::vector<uint8_t> qvs;
+    foreach (int qv, result.QVs) {
+        if (qv < 0 || qv > 255) {
+            throw InvalidInputError("QVs must be from 0 to 255 to be encoded");
+        }
+        qvs.push_back(qv);
+    }
+
+    ResultHeader h;
+    h.H = MakeHeader(RESULT_MAGIC);
+    h.Id = result.Id;
+    h.SequenceLength = result.Sequence.length();
+    h.NumQVs = qvs.size();
+    h.ErrorLength = result.Error.length();
+    h.NumReads = result.NumReads;
+    h.Converged = result.Converged;
+
+    std::string out;
+    SectionWriter w(&out);
+    w.Write(&h, sizeof(h));
+    w.Write(result.Sequence.data(), result.Sequence.length());
+    w.Write(qvs.data(), qvs.size());
+    w.Write(result.Error.data(), result.Error.length());
+    return out;
+}
+
+ConsensusResult DecodeConsensusResult(const std::string& bytes)
+{
+    // The reader only ever reads through this pointer
+    SectionReader in(const_cast<char*>(bytes.data()), bytes.size(), "Work unit result encoding");
+    ResultHeader h = in.TakeValue<ResultHeader>();
+    CheckHeader(h.H, RESULT_MAGIC);
+
+    ConsensusResult result;
+    result.Id = h.Id;
+    result.NumReads = h.NumReads;
+    result.Converged = h.Converged;
+    result.Sequence = in.TakeString(h.SequenceLength);
+    const uint8_t* qvs = reinterpret_cast<const uint8_t*>(in.Take(h.NumQVs));
+    result.QVs.assign(qvs, qvs + h.NumQVs);
+    result.Error = in.TakeString(h.ErrorLength);
+    if (!in.AtEnd()) {
+        throw InvalidInputError("Work unit result encoding is corrupt");
+    }
+    return result;
+}
+
+ConsensusResult RefineWorkUnit(const QuiverConfigTable& configs, const WorkUnit& unit,
+                               const ConsensusPipelineOptions& options)
+{
+    ConsensusResult result;
+    result.Id = unit.Id;
+    try {
+        SparseSseQvMultiReadMutationScorer mms(configs, unit.Template);
+        foreach (const MappedRead& mr, unit.Reads) {
+            if (mms.AddRead(mr)) result.NumReads++;
+        }
+        result.Converged = RefineConsensus(mms, options.Refine);
+        if (options.MinDinucleotideRepeatElements > 0) {
+            RefineDinucleotideRepeats(mms, options.MinDinucleotideRepeatElements);
+        }
+        result.QVs = ConsensusQVs(mms);
+        result.Sequence = mms.Template();
+    } catch (const ErrorBase& e) {
+        result = ConsensusResult();
+        result.Id = unit.Id;
+        result.Error = e.Message();
+    }
+    return result;
+}
+
+BatchRefiner::BatchRefiner(const QuiverConfigTable& configs, int numThreads,
+                           const ConsensusPipelineOptions& options)
+    : configs_(configs), options_(options), pool_()
+{
+    if (numThreads < 1) {
+        throw InvalidInputError("BatchRefiner needs at least one thread");
+    }
+    if (numThreads > 1) pool_.reset(new ThreadPool(numThreads));
+}
+
+BatchRefiner::~BatchRefiner() {}
+
+int BatchRefiner::NumThreads() const { return pool_ ? pool_->NumThreads() : 1; }
+
+std::vector<ConsensusResult> BatchRefiner::Refine(const std::vector<WorkUnit>& units)
+{
+    // Costliest first
+    std::vector<std::pair<int64_t, int> > order;
+    for (size_t k = 0; k < units.size(); k++) {
+        int64_t readBases = 0;
+        foreach (const MappedRead& mr, units[k].Reads) {
+            readBases += mr.Length();
+        }
+        int64_t cost = readBases * static_cast<int64_t>(units[k].Template.length());
+        order.push_back(std::make_pair(-cost, k));
+    }
+    std::sort(order.begin(), order.end());
+
+    std::vector<ConsensusResult> results(units.size());
+    std::function<void(int)> refine = [&](int i) {
+        int k = order[i].second;
+        results[k] = RefineWorkUnit(configs_, units[k], options_);
+    };
+    if (pool_) {
+        pool_->ParallelFor(order.size(), refine);
+    } else {
+        for (size_t i = 0; i < order.size(); i++) {
+            refine(i);
+        }
+    }
+    return results;
+}
+
+std::vector<ConsensusResult> RefineConsensusBatch(const QuiverConfigTable& configs,
+                                                  const std::vector<WorkUnit>& units,
+                                                  int numThreads,
+                                                  const ConsensusPipelineOptions& options)
+{
+    BatchRefiner refiner(configs, numThreads, options);
+    return refiner.Refine(units);
+}
+
+namespace detail {
+
+struct RefineJob
+{
+    enum StateEnum
+    {
+        QUEUED,
+        RUNNING,
+        DONE,
+        CANCELLED
+    };
+
+    int Ticket;
+    // The job's input, one or the other, dropped once it is done
+    boost::scoped_ptr<WorkUnit> Unit;
+    boost::scoped_ptr<ConsensusWindow> Window;
+
+    std::mutex Mutex;
+    std::condition_variable Finished;
+    StateEnum State;
+    ConsensusResult Result;
+
+    RefineJob() : Ticket(-1), State(QUEUED) {}
+
+    // Cancel the job if it is still queued; called with Mutex held
+    bool CancelLocked()
+    {
+        if (State != QUEUED) return false;
+        State = CANCELLED;
+        Result = ConsensusResult();
+        Result.Id = Unit ? Unit->Id : Window->Id;
+        Result.Error = "Cancelled";
+        Unit.reset();
+        Window.reset();
+        Finished.notify_all();
+        return true;
+    }
+};
+
+class AsyncRefinerImpl : private boost::noncopyable
+{
+public:
+    AsyncRefinerImpl(const QuiverConfigTable& configs, int numThreads,
+                     const ConsensusPipelineOptions& options);
+    ~AsyncRefinerImpl();
+
+    int NumThreads() const { return workers_.size(); }
+
+    RefineFuture Enqueue(const boost::shared_ptr<RefineJob>& job);
+    int Pending() const;
+    int NextCompleted(double timeoutSeconds);
+
+private:
+    void WorkerLoop();
+
+private:
+    QuiverConfigTable configs_;
+    ConsensusPipelineOptions options_;
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable jobQueued_;
+    std::condition_variable jobFinished_;
+    // Guarded by mutex_
+    std::deque<boost::shared_ptr<RefineJob> > queue_;
+    std::deque<int> completed_;
+    int nextTicket_;
+    int running_;
+    bool shutdown_;
+};
+
+AsyncRefinerImpl::AsyncRefinerImpl(const QuiverConfigTable& configs, int numThreads,
+                                   const ConsensusPipelineOptions& options)
+    : configs_(configs)
+    , options_(options)
+    , workers_()
+    , nextTicket_(0)
+    , running_(0)
+    , shutdown_(false)
+{
+    for (int i = 0; i < numThreads; i++) {
+        workers_.push_back(std::thread([this] { WorkerLoop(); }));
+    }
+}
+
+AsyncRefinerImpl::~AsyncRefinerImpl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+        foreach (const boost::shared_ptr<RefineJob>& job, queue_) {
+            std::lock_guard<std::mutex> jobLock(job->Mutex);
+            job->CancelLocked();
+        }
+        queue_.clear();
+        jobQueued_.notify_all();
+        jobFinished_.notify_all();
+    }
+    foreach (std::thread& worker, workers_) {
+        worker.join();
+    }
+}
+
+RefineFuture AsyncRefinerImpl::Enqueue(const boost::shared_ptr<RefineJob>& job)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->Ticket = nextTicket_++;
+    queue_.push_back(job);
+    jobQueued_.notify_one();
+    return RefineFuture(job);
+}
+
+int AsyncRefinerImpl::Pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int pending = running_;
+    foreach (const boost::shared_ptr<RefineJob>& job, queue_) {
+        std::lock_guard<std::mutex> jobLock(job->Mutex);
+        if (job->State == RefineJob::QUEUED) pending++;
+    }
+    return pending;
+}
+
+int AsyncRefinerImpl::NextCompleted(double timeoutSeconds)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto ready = [this] { return shutdown_ || !completed_.empty(); };
+    if (timeoutSeconds < 0) {
+        jobFinished_.wait(lock, ready);
+    } else {
+        jobFinished_.wait_for(lock, std::chrono::duration<double>(timeoutSeconds), ready);
+    }
+    if (completed_.empty()) return -1;
+    int ticket = completed_.front();
+    completed_.pop_front();
+    return ticket;
+}
+
+void AsyncRefinerImpl::WorkerLoop()
+{
+    while (true) {
+        boost::shared_ptr<RefineJob> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobQueued_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
+            if (shutdown_) return;
+            job = queue_.front();
+            queue_.pop_front();
+            // Cancelled while queued
+            std::lock_guard<std::mutex> jobLock(job->Mutex);
+            if (job->State != RefineJob::QUEUED) continue;
+            job->State = RefineJob::RUNNING;
+            running_++;
+        }
+
+        // Neither throws: failures come back in the result
+        ConsensusResult result = job->Unit ? RefineWorkUnit(configs_, *job->Unit, options_)
+                                           : FindWindowConsensus(configs_, *job->Window, options_);
+        {
+            std::lock_guard<std::mutex> jobLock(job->Mutex);
+            job->Result = result;
+            job->State = RefineJob::DONE;
+            job->Unit.reset();
+            job->Window.reset();
+            job->Finished.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+        completed_.push_back(job->Ticket);
+        jobFinished_.notify_all();
+    }
+}
+}  // namespace detail
+
+RefineFuture::RefineFuture() : job_() {}
+
+RefineFuture::RefineFuture(const boost::shared_ptr<detail::RefineJob>& job) : job_(job) {}
+
+int RefineFuture::Ticket() const { return job_ ? job_->Ticket : -1; }
+
+bool RefineFuture::Done() const
+{
+    if (!job_) return false;
+    std::lock_guard<std::mutex> lock(job_->Mutex);
+    return job_->State == detail::RefineJob::DONE || job_->State == detail::RefineJob::CANCELLED;
+}
+
+bool RefineFuture::Cancelled() const
+{
+    if (!job_) return false;
+    std::lock_guard<std::mutex> lock(job_->Mutex);
+    return job_->State == detail::RefineJob::CANCELLED;
+}
+
+bool RefineFuture::Wait(double timeoutSeconds) const
+{
+    if (!job_) throw InvalidInputError("RefineFuture has no job");
+    std::unique_lock<std::mutex> lock(job_->Mutex);
+    auto done = [this] {
+        return job_->State == detail::RefineJob::DONE ||
+               job_->State == detail::RefineJob::CANCELLED;
+    };
+    if (timeoutSeconds < 0) {
+        job_->Finished.wait(lock, done);
+        return true;
+    }
+    return job_->Finished.wait_for(lock, std::chrono::duration<double>(timeoutSeconds), done);
+}
+
+ConsensusResult RefineFuture::Result() const
+{
+    Wait();
+    std::lock_guard<std::mutex> lock(job_->Mutex);
+    return job_->Result;
+}
+
+bool RefineFuture::Cancel()
+{
+    if (!job_) return false;
+    std::lock_guard<std::mutex> lock(job_->Mutex);
+    return job_->CancelLocked();
+}
+
+AsyncRefiner::AsyncRefiner(const QuiverConfigTable& configs, int numThreads,
+                           const ConsensusPipelineOptions& options)
+    : impl_(NULL)
+{
+    if (numThreads < 1) {
+        throw InvalidInputError("AsyncRefiner needs at least one thread");
+    }
+    impl_ = new detail::AsyncRefinerImpl(configs, numThreads, options);
+}
+
+AsyncRefiner::~AsyncRefiner() { delete impl_; }
+
+int AsyncRefiner::NumThreads() const { return impl_->NumThreads(); }
+
+RefineFuture AsyncRefiner::Submit(const WorkUnit& unit)
+{
+    boost::shared_ptr<detail::RefineJob> job(new detail::RefineJob());
+    job->Unit.reset(new WorkUnit(unit));
+    return impl_->Enqueue(job);
+}
+
+RefineFuture AsyncRefiner::SubmitWindow(const ConsensusWindow& window)
+{
+    boost::shared_ptr<detail::RefineJob> job(new detail::RefineJob());
+    job->Window.reset(new ConsensusWindow(window));
+    return impl_->Enqueue(job);
+}
+
+int AsyncRefiner::Pending() const { return impl_->Pending(); }
+
+int AsyncRefiner::NextCompleted(double timeoutSeconds)
+{
+    return impl_->NextCompleted(timeoutSeconds);
+}
+}
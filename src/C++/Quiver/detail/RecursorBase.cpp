@@ -4,10 +4,13 @@
 
 #include <ConsensusCore/Align/PairwiseAlignment.hpp>
 #include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Interval.hpp>
 #include <ConsensusCore/LFloat.hpp>
 #include <ConsensusCore/Logging.hpp>
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
 #include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
 #include <ConsensusCore/Quiver/QvEvaluator.hpp>
 #include <ConsensusCore/Quiver/detail/Combiner.hpp>
@@ -15,59 +18,156 @@
 #include <ConsensusCore/Utils.hpp>
 
 #include <algorithm>
+#include <boost/tuple/tuple.hpp>
 #include <boost/type_traits.hpp>
+#include <chrono>
+#include <cmath>
 #include <string>
 #include <vector>
 
-// TODO(dalexander): put these into a RecursorConfig struct
-#define MAX_FLIP_FLOPS 5
-#define ALPHA_BETA_MISMATCH_TOLERANCE 0.2f
-#define REBANDING_THRESHOLD 0.04
-
 using std::max;
 using std::min;
 
 namespace ConsensusCore {
 namespace detail {
 
+namespace {  // PRIVATE
+template <typename M>
+std::vector<Interval> UsedRowRanges(const M& m)
+{
+    std::vector<Interval> ranges(m.Columns());
+    for (int j = 0; j < m.Columns(); j++) {
+        ranges[j] = m.UsedRowRange(j);
+    }
+    return ranges;
+}
+
+// How far apart the alpha and beta scores may be, near score.  Entries
+// stored as half floats (see SparseVector) are each rounded, so the two
+// fills drift apart by up to about 2^-8 of the score's magnitude.
+template <typename M>
+float MismatchTolerance(float tolerance, float score)
+{
+    if (M::EntryBytes() < static_cast<int>(sizeof(float))) {
+        return tolerance + std::fabs(score) / 256;
+    }
+    return tolerance;
+}
+}
+
 template <typename M, typename E, typename C>
-int RecursorBase<M, E, C>::FillAlphaBeta(const E& e, M& a, M& b) const
+int RecursorBase<M, E, C>::FillAlphaBeta(const E& e, M& a, M& b, FillStatistics* stats) const
 {
+    PERF_SCOPE(PERF_FILL_ALPHA_BETA);
+    std::chrono::steady_clock::time_point start;
+    if (stats != NULL) {
+        start = std::chrono::steady_clock::now();
+    }
+
     FillAlpha(e, M::Null(), a);
     FillBeta(e, a, b);
+    PERF_CELLS(PERF_FILL_ALPHA_BETA, a.UsedEntries() + b.UsedEntries());
 
     int I = e.ReadLength();
     int J = e.TemplateLength();
     int flipflops = 0;
-    int maxSize = static_cast<int>(0.5 + REBANDING_THRESHOLD * (I + 1) * (J + 1));
+    int maxSize = static_cast<int>(0.5 + config_.RebandingThreshold * (I + 1) * (J + 1));
 
-    // if we use too much space, do at least one more round
-    // to take advantage of rebanding
-    if (a.UsedEntries() >= maxSize || b.UsedEntries() >= maxSize) {
-        FillAlpha(e, b, a);
-        FillBeta(e, a, b);
-        FillAlpha(e, b, a);
-        flipflops += 3;
-    }
-
-    while (std::fabs(a(I, J) - b(0, 0)) > ALPHA_BETA_MISMATCH_TOLERANCE &&
-           flipflops <= MAX_FLIP_FLOPS) {
-        if (flipflops % 2 == 0) {
+    // Refill alpha and beta alternately, each guided by the other.  A
+    // fill is a function of its guide alone, so once a refill leaves
+    // the band of its matrix as it was, the matrix is as it was, and
+    // so would be every refill after it: there is no use going on.
+    bool refillAlpha = true;
+    bool stable = false;
+    auto refill = [&]() {
+        M& m = refillAlpha ? a : b;
+        std::vector<Interval> before = UsedRowRanges(m);
+        if (refillAlpha) {
             FillAlpha(e, b, a);
         } else {
             FillBeta(e, a, b);
         }
+        PERF_CELLS(PERF_FILL_ALPHA_BETA, m.UsedEntries());
+        stable = (UsedRowRanges(m) == before);
+        refillAlpha = !refillAlpha;
         flipflops++;
+    };
+
+    // if we use too much space, do up to three more rounds
+    // to take advantage of rebanding
+    if (a.UsedEntries() >= maxSize || b.UsedEntries() >= maxSize) {
+        while (flipflops < 3 && !stable) {
+            refill();
+        }
     }
 
-    if (std::fabs(a(I, J) - b(0, 0)) > ALPHA_BETA_MISMATCH_TOLERANCE) {
+    float tolerance = MismatchTolerance<M>(config_.AlphaBetaMismatchTolerance, b(0, 0));
+    while (std::fabs(a(I, J) - b(0, 0)) > tolerance && flipflops <= config_.MaxFlipFlops &&
+           !stable) {
+        refill();
+        tolerance = MismatchTolerance<M>(config_.AlphaBetaMismatchTolerance, b(0, 0));
+    }
+
+    if (stats != NULL) {
+        stats->Passes = flipflops + 2;
+        stats->FlipFlops = flipflops;
+        stats->AlphaUsedEntries = a.UsedEntries();
+        stats->AlphaAllocatedEntries = a.AllocatedEntries();
+        stats->BetaUsedEntries = b.UsedEntries();
+        stats->BetaAllocatedEntries = b.AllocatedEntries();
+        stats->Seconds =
+            std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (std::fabs(a(I, J) - b(0, 0)) > tolerance) {
         LDEBUG << "Could not mate alpha, beta.  Read: " << e.ReadName() << " Tpl: " << e.Template();
         throw AlphaBetaMismatchException();
     }
 
+    // The stats describe the fill, before any compaction
+    if (config_.CompactBands) {
+        a.ShrinkToFit();
+        b.ShrinkToFit();
+    }
     return flipflops;
 }
 
+template <typename M, typename E, typename C>
+bool RecursorBase<M, E, C>::RefillAlphaBeta(const E& e, const M& oldAlpha, const M& oldBeta,
+                                            int unchangedPrefix, int unchangedSuffix, M& a,
+                                            M& b) const
+{
+    int I = e.ReadLength();
+    int J = e.TemplateLength();
+    int oldJ = oldAlpha.Columns() - 1;
+
+    assert(oldAlpha.Rows() == I + 1 && oldBeta.Rows() == I + 1);
+    assert(unchangedPrefix + unchangedSuffix <= std::min(J, oldJ));
+
+    // Alpha column j depends on template bases [0, j], and beta column
+    // j on bases [j, J), so these columns carry over verbatim (beta
+    // columns shifted by the change in template length).
+    for (int j = 0; j < unchangedPrefix; j++) {
+        CopyColumn(oldAlpha, j, a, j);
+    }
+    for (int j = J - unchangedSuffix; j <= J; j++) {
+        CopyColumn(oldBeta, j + oldJ - J, b, j);
+    }
+
+    // Fill the remainder of alpha using the carried-over beta columns
+    // as a banding guide, then finish beta using the complete alpha.
+    FillAlpha(e, b, a, unchangedPrefix);
+    FillBeta(e, a, b, J - unchangedSuffix - 1);
+
+    bool mated = std::fabs(a(I, J) - b(0, 0)) <=
+                 MismatchTolerance<M>(config_.AlphaBetaMismatchTolerance, b(0, 0));
+    if (mated && config_.CompactBands) {
+        a.ShrinkToFit();
+        b.ShrinkToFit();
+    }
+    return mated;
+}
+
 struct MoveSpec
 {
     Move MoveType;
@@ -76,7 +176,7 @@ struct MoveSpec
 };
 
 template <typename M, typename E, typename C>
-const PairwiseAlignment* RecursorBase<M, E, C>::Alignment(const E& e, const M& a) const
+CompactAlignment RecursorBase<M, E, C>::Traceback(const E& e, const M& a) const
 {
     if (!boost::is_same<C, ViterbiCombiner>::value) {
         ShouldNotReachHere();
@@ -97,7 +197,7 @@ const PairwiseAlignment* RecursorBase<M, E, C>::Alignment(const E& e, const M& a
     MoveSpec delMove = {DELETE, 0, 1};
     MoveSpec extraMove = {EXTRA, 1, 0};
     MoveSpec mergeMove = {MERGE, 1, 2};
-    std::vector<MoveSpec> moves;
+    CompactAlignment moves;
 
     while (i > 0 || j > 0) {
         MoveSpec bestMove = {INVALID_MOVE, 0, 0};
@@ -153,11 +253,13 @@ const PairwiseAlignment* RecursorBase<M, E, C>::Alignment(const E& e, const M& a
                 bestMoveScore = moveScore;
             }
         }
-        assert(AlmostEqual(a(i, j), bestScore));
+        // (entries stored as half floats are too coarse to recompute)
+        assert(M::EntryBytes() < static_cast<int>(sizeof(float)) ||
+               AlmostEqual(a(i, j), bestScore));
         assert(bestMove.MoveType != INVALID_MOVE);
         assert(bestMoveScore != lfloat());
 
-        moves.push_back(bestMove);
+        moves.Append(bestMove.MoveType);
         i -= bestMove.ReadDelta;
         j -= bestMove.ReferenceDelta;
         pathScore += bestMoveScore;
@@ -165,50 +267,20 @@ const PairwiseAlignment* RecursorBase<M, E, C>::Alignment(const E& e, const M& a
     assert(i == 0 && j == 0);
 
     // Reverse moves
-    std::reverse(moves.begin(), moves.end());
-
-    // Replay moves and stringify.
-    std::string target;
-    std::string query;
-    i = 0;
-    j = 0;
-    foreach (const MoveSpec& move, moves) {
-        switch (move.MoveType) {
-            case INCORPORATE:
-                target += e.Template()[j];
-                query += e.Basecalls()[i];
-                break;
-            case EXTRA:
-                target += '-';
-                query += e.Basecalls()[i];
-                break;
-            case DELETE:
-                target += e.Template()[j];
-                query += '-';
-                break;
-            case MERGE:
-                target += e.Template()[j];
-                target += e.Template()[j + 1];
-                query += '-';
-                query += e.Basecalls()[i];
-                break;
-            case INVALID_MOVE:
-                ShouldNotReachHere();
-                break;
-            default:
-                ShouldNotReachHere();
-        }
-        i += move.ReadDelta;
-        j += move.ReferenceDelta;
-        assert(target.length() == query.length());
-    }
+    moves.Reverse();
+    return moves;
+}
 
-    return new PairwiseAlignment(target, query);
+template <typename M, typename E, typename C>
+const PairwiseAlignment* RecursorBase<M, E, C>::Alignment(const E& e, const M& a) const
+{
+    return Traceback(e, a).ToPairwiseAlignment(e.Template(), e.Basecalls());
 }
 
 template <typename M, typename E, typename C>
-RecursorBase<M, E, C>::RecursorBase(int movesAvailable, const BandingOptions& bandingOptions)
-    : movesAvailable_(movesAvailable), bandingOptions_(bandingOptions)
+RecursorBase<M, E, C>::RecursorBase(int movesAvailable, const BandingOptions& bandingOptions,
+                                    const RecursorConfig& config)
+    : movesAvailable_(movesAvailable), bandingOptions_(bandingOptions), config_(config)
 {
 }
 
@@ -50,6 +50,7 @@ MappedRead::MappedRead(const MappedRead& other)
     , TemplateEnd(other.TemplateEnd)
     , PinStart(other.PinStart)
     , PinEnd(other.PinEnd)
+    , BandHint(other.BandHint)
 {
 }
 
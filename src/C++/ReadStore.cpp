@@ -0,0 +1,322 @@
+// Author: David Alexander
+
+#include <ConsensusCore/ReadStore.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Feature.hpp>
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+// The tracks, in file order
+#define NUM_TRACKS 6
+
+// Flags of a read
+#define REVERSE_FLAG 1
+#define PIN_START_FLAG 2
+#define PIN_END_FLAG 4
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+const char MAGIC[8] = {'C', 'C', 'R', 'E', 'A', 'D', 'S', '1'};
+const uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+
+struct Header
+{
+    char Magic[8];
+    uint64_t ByteOrder;
+    uint64_t NumReads;
+    uint64_t NumBases;
+    uint64_t NumChemistries;
+    uint64_t NameChars;
+    uint64_t ChemistryChars;
+};
+
+uint64_t Align8(uint64_t offset) { return (offset + 7) & ~static_cast<uint64_t>(7); }
+
+const float* TrackOf(const QvSequenceFeatures& f, int track)
+{
+    const Feature<float>* tracks[NUM_TRACKS] = {&f.SequenceAsFloat, &f.InsQv,  &f.SubsQv,
+                                                &f.DelQv,           &f.DelTag, &f.MergeQv};
+    return tracks[track]->get();
+}
+
+void WriteBytes(std::ofstream* out, const void* data, uint64_t bytes)
+{
+    out->write(static_cast<const char*>(data), bytes);
+}
+
+// Write zeros up to the next multiple of eight bytes
+void Pad(std::ofstream* out, uint64_t* offset, uint64_t bytes)
+{
+    static const char zeros[8] = {0};
+    *offset += bytes;
+    WriteBytes(out, zeros, Align8(*offset) - *offset);
+    *offset = Align8(*offset);
+}
+}
+
+// Where each section starts, from the counts in the header
+struct ReadStore::Layout
+{
+    Header H;
+    uint64_t BaseOffsets;
+    uint64_t NameOffsets;
+    uint64_t ChemistryOffsets;
+    uint64_t TemplateStarts;
+    uint64_t TemplateEnds;
+    uint64_t ChemistryIds;
+    uint64_t Flags;
+    uint64_t Names;
+    uint64_t ChemistryNames;
+    uint64_t Bases;
+    uint64_t Tracks;
+    uint64_t End;
+
+    explicit Layout(const Header& h) : H(h)
+    {
+        uint64_t n = h.NumReads;
+        BaseOffsets = Align8(sizeof(Header));
+        NameOffsets = BaseOffsets + (n + 1) * sizeof(uint64_t);
+        ChemistryOffsets = NameOffsets + (n + 1) * sizeof(uint64_t);
+        TemplateStarts = ChemistryOffsets + (h.NumChemistries + 1) * sizeof(uint64_t);
+        TemplateEnds = Align8(TemplateStarts + n * sizeof(int32_t));
+        ChemistryIds = Align8(TemplateEnds + n * sizeof(int32_t));
+        Flags = Align8(ChemistryIds + n * sizeof(uint16_t));
+        Names = Align8(Flags + n * sizeof(uint8_t));
+        ChemistryNames = Align8(Names + h.NameChars);
+        Bases = Align8(ChemistryNames + h.ChemistryChars);
+        Tracks = Align8(Bases + h.NumBases);
+        End = Tracks + NUM_TRACKS * h.NumBases * sizeof(float);
+    }
+};
+
+// A private mapping of a whole file: writes to the features of a view
+// go to a copy of the page, never to the file
+class ReadStore::Mapping : private boost::noncopyable
+{
+public:
+    explicit Mapping(const std::string& filename) : Data(NULL), Size(0)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw InvalidInputError("Can't open read store " + filename);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+            close(fd);
+            throw InvalidInputError(filename + " is not a read store");
+        }
+        Size = st.st_size;
+        void* data = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw InvalidInputError("Can't map read store " + filename);
+        }
+        Data = static_cast<char*>(data);
+    }
+
+    ~Mapping() { munmap(Data, Size); }
+
+    char* Data;
+    uint64_t Size;
+};
+
+ReadStore::ReadStore(const std::string& filename) : mapping_(new Mapping(filename)), layout_()
+{
+    Header h;
+    std::memcpy(&h, mapping_->Data, sizeof(Header));
+    if (std::memcmp(h.Magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw InvalidInputError(filename + " is not a read store");
+    }
+    if (h.ByteOrder != BYTE_ORDER_MARK) {
+        throw InvalidInputError(filename + " was written in another byte order");
+    }
+    // Bounding the counts by the size keeps the layout from overflowing
+    if (h.NumReads > mapping_->Size || h.NumBases > mapping_->Size ||
+        h.NumChemistries > mapping_->Size || h.NameChars > mapping_->Size ||
+        h.ChemistryChars > mapping_->Size) {
+        throw InvalidInputError(filename + " is truncated");
+    }
+    layout_.reset(new Layout(h));
+    if (layout_->End != mapping_->Size) {
+        throw InvalidInputError(filename + " is truncated");
+    }
+}
+
+void ReadStore::Write(const std::string& filename, const std::vector<MappedRead>& reads)
+{
+    Header h;
+    std::memcpy(h.Magic, MAGIC, sizeof(MAGIC));
+    h.ByteOrder = BYTE_ORDER_MARK;
+    h.NumReads = reads.size();
+    h.NumBases = 0;
+    h.NameChars = 0;
+
+    std::vector<uint64_t> baseOffsets(1, 0), nameOffsets(1, 0), chemistryOffsets(1, 0);
+    std::vector<int32_t> templateStarts, templateEnds;
+    std::vector<uint16_t> chemistryIds;
+    std::vector<uint8_t> flags;
+    std::vector<std::string> chemistries;
+    std::map<std::string, uint16_t> chemistryIndex;
+    foreach (const MappedRead& mr, reads) {
+        h.NumBases += mr.Length();
+        h.NameChars += mr.Name.length();
+        baseOffsets.push_back(h.NumBases);
+        nameOffsets.push_back(h.NameChars);
+        templateStarts.push_back(mr.TemplateStart);
+        templateEnds.push_back(mr.TemplateEnd);
+        if (chemistryIndex.find(mr.Chemistry) == chemistryIndex.end()) {
+            if (chemistries.size() > UINT16_MAX) {
+                throw UnsupportedFeatureError("Too many chemistries for a read store");
+            }
+            chemistryIndex[mr.Chemistry] = chemistries.size();
+            chemistries.push_back(mr.Chemistry);
+            chemistryOffsets.push_back(chemistryOffsets.back() + mr.Chemistry.length());
+        }
+        chemistryIds.push_back(chemistryIndex[mr.Chemistry]);
+        flags.push_back((mr.Strand == REVERSE_STRAND ? REVERSE_FLAG : 0) |
+                        (mr.PinStart ? PIN_START_FLAG : 0) | (mr.PinEnd ? PIN_END_FLAG : 0));
+    }
+    h.NumChemistries = chemistries.size();
+    h.ChemistryChars = chemistryOffsets.back();
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if (!out) {
+        throw InvalidInputError("Can't write read store " + filename);
+    }
+    uint64_t offset = 0;
+    WriteBytes(&out, &h, sizeof(h));
+    Pad(&out, &offset, sizeof(h));
+    WriteBytes(&out, &baseOffsets[0], baseOffsets.size() * sizeof(uint64_t));
+    WriteBytes(&out, &nameOffsets[0], nameOffsets.size() * sizeof(uint64_t));
+    WriteBytes(&out, &chemistryOffsets[0], chemistryOffsets.size() * sizeof(uint64_t));
+    offset += (baseOffsets.size() + nameOffsets.size() + chemistryOffsets.size()) * 8;
+    WriteBytes(&out, templateStarts.data(), templateStarts.size() * sizeof(int32_t));
+    Pad(&out, &offset, templateStarts.size() * sizeof(int32_t));
+    WriteBytes(&out, templateEnds.data(), templateEnds.size() * sizeof(int32_t));
+    Pad(&out, &offset, templateEnds.size() * sizeof(int32_t));
+    WriteBytes(&out, chemistryIds.data(), chemistryIds.size() * sizeof(uint16_t));
+    Pad(&out, &offset, chemistryIds.size() * sizeof(uint16_t));
+    WriteBytes(&out, flags.data(), flags.size());
+    Pad(&out, &offset, flags.size());
+    foreach (const MappedRead& mr, reads) {
+        WriteBytes(&out, mr.Name.data(), mr.Name.length());
+    }
+    Pad(&out, &offset, h.NameChars);
+    foreach (const std::string& chemistry, chemistries) {
+        WriteBytes(&out, chemistry.data(), chemistry.length());
+    }
+    Pad(&out, &offset, h.ChemistryChars);
+    foreach (const MappedRead& mr, reads) {
+        WriteBytes(&out, mr.Features.Sequence().get(), mr.Length());
+    }
+    Pad(&out, &offset, h.NumBases);
+    for (int track = 0; track < NUM_TRACKS; track++) {
+        foreach (const MappedRead& mr, reads) {
+            WriteBytes(&out, TrackOf(mr.Features, track), mr.Length() * sizeof(float));
+        }
+    }
+    offset += NUM_TRACKS * h.NumBases * sizeof(float);
+    assert(offset == Layout(h).End);
+    if (!out.flush()) {
+        throw InvalidInputError("Can't write read store " + filename);
+    }
+}
+
+int ReadStore::NumReads() const { return layout_->H.NumReads; }
+
+int64_t ReadStore::NumBases() const { return layout_->H.NumBases; }
+
+char* ReadStore::Section(int64_t offset) const { return mapping_->Data + offset; }
+
+std::string ReadStore::String(const uint64_t* offsets, const char* chars, uint64_t numChars,
+                              int i) const
+{
+    uint64_t begin = offsets[i];
+    uint64_t end = offsets[i + 1];
+    if (begin > end || end > numChars) {
+        throw InvalidInputError("Read store is corrupt");
+    }
+    return std::string(chars + begin, end - begin);
+}
+
+std::vector<std::string> ReadStore::Chemistries() const
+{
+    const Layout& l = *layout_;
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(Section(l.ChemistryOffsets));
+    std::vector<std::string> chemistries;
+    for (uint64_t c = 0; c < l.H.NumChemistries; c++) {
+        chemistries.push_back(
+            String(offsets, Section(l.ChemistryNames), l.H.ChemistryChars, c));
+    }
+    return chemistries;
+}
+
+MappedRead ReadStore::ReadAt(int i) const
+{
+    const Layout& l = *layout_;
+    if (i < 0 || i >= NumReads()) {
+        throw InvalidInputError("Read index out of range");
+    }
+    const uint64_t* baseOffsets = reinterpret_cast<const uint64_t*>(Section(l.BaseOffsets));
+    uint64_t begin = baseOffsets[i];
+    uint64_t end = baseOffsets[i + 1];
+    if (begin > end || end > l.H.NumBases) {
+        throw InvalidInputError("Read store is corrupt");
+    }
+    int length = end - begin;
+
+    // The features view the mapping, and hold it open
+    boost::shared_ptr<void> owner(mapping_);
+    CharFeature seq(Section(l.Bases) + begin, length, owner);
+    float* tracks = reinterpret_cast<float*>(Section(l.Tracks));
+    std::vector<FloatFeature> features;
+    for (int track = 0; track < NUM_TRACKS; track++) {
+        features.push_back(FloatFeature(tracks + track * l.H.NumBases + begin, length, owner));
+    }
+    QvSequenceFeatures f(seq, features[0], features[1], features[2], features[3], features[4],
+                         features[5]);
+
+    uint16_t chemistry = reinterpret_cast<const uint16_t*>(Section(l.ChemistryIds))[i];
+    if (chemistry >= l.H.NumChemistries) {
+        throw InvalidInputError("Read store is corrupt");
+    }
+    const uint64_t* chemistryOffsets =
+        reinterpret_cast<const uint64_t*>(Section(l.ChemistryOffsets));
+    const uint64_t* nameOffsets = reinterpret_cast<const uint64_t*>(Section(l.NameOffsets));
+    Read read(f, String(nameOffsets, Section(l.Names), l.H.NameChars, i),
+              String(chemistryOffsets, Section(l.ChemistryNames), l.H.ChemistryChars,
+                     chemistry));
+
+    uint8_t flags = reinterpret_cast<const uint8_t*>(Section(l.Flags))[i];
+    int32_t tStart = reinterpret_cast<const int32_t*>(Section(l.TemplateStarts))[i];
+    int32_t tEnd = reinterpret_cast<const int32_t*>(Section(l.TemplateEnds))[i];
+    return MappedRead(read, (flags & REVERSE_FLAG) ? REVERSE_STRAND : FORWARD_STRAND, tStart,
+                      tEnd, flags & PIN_START_FLAG, flags & PIN_END_FLAG);
+}
+
+std::vector<MappedRead> ReadStore::Reads(int begin, int end) const
+{
+    if (begin < 0 || begin > end || end > NumReads()) {
+        throw InvalidInputError("Read range out of range");
+    }
+    std::vector<MappedRead> reads;
+    reads.reserve(end - begin);
+    for (int i = begin; i < end; i++) {
+        reads.push_back(ReadAt(i));
+    }
+    return reads;
+}
+}
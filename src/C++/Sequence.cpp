@@ -1,13 +1,20 @@
 // Author: David Alexander
 
+#include <ConsensusCore/Sequence.hpp>
+
+#include <algorithm>
 #include <string>
+#include <vector>
+
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+#include <ConsensusCore/Types.hpp>
 
 //
 // For testing purposes, N and M are defined as two phony DNA bases
 // that are complementary
 //
 
-static char ComplementArray[] = {
+static const char ComplementArray[] = {
     3,   2,   1,   0,   127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
     127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
     127, 127, 127, 127, 127, 127, 127, '-', 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 127,
@@ -25,18 +32,120 @@ static char ComplementArray[] = {
 
 namespace ConsensusCore {
 
-char ComplementaryBase(char base) { return ComplementArray[static_cast<int>(base)]; }
+namespace {  // PRIVATE
+// Blocks of 32 bases are worth handing to the AVX2 kernels
+bool UseAvx2(int length)
+{
+    return length >= 32 && SimdWidth() >= 8;
+}
+
+// The code of each base as PackedSequence packs it, or -1
+int PackedCode(char base)
+{
+    switch (base) {
+        case 'A':
+            return 0;
+        case 'C':
+            return 1;
+        case 'G':
+            return 2;
+        case 'T':
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+// The 2-bit fields of x in the reverse order
+uint64_t ReverseCodes(uint64_t x)
+{
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(x);
+}
+}  // PRIVATE
+
+char ComplementaryBase(char base) { return ComplementArray[static_cast<unsigned char>(base)]; }
+
+void Complement(const char* input, int length, char* output)
+{
+    int done = UseAvx2(length) ? detail::ComplementAvx2(input, length, output) : 0;
+    for (int i = done; i < length; i++) {
+        output[i] = ComplementaryBase(input[i]);
+    }
+}
+
+void ReverseComplement(const char* input, int length, char* output)
+{
+    int done = UseAvx2(length) ? detail::ReverseComplementAvx2(input, length, output) : 0;
+    for (int i = done; i < length; i++) {
+        output[i] = ComplementaryBase(input[length - 1 - i]);
+    }
+}
 
 std::string Complement(const std::string& input)
 {
     std::string output(input.length(), 127);
-    for (unsigned int i = 0; i < input.length(); i++) {
-        output[i] = ComplementArray[static_cast<int>(input[i])];
-    }
+    Complement(input.data(), input.length(), &output[0]);
     return output;
 }
 
 std::string Reverse(const std::string& input) { return std::string(input.rbegin(), input.rend()); }
 
-std::string ReverseComplement(const std::string& input) { return Reverse(Complement(input)); }
+std::string ReverseComplement(const std::string& input)
+{
+    std::string output(input.length(), 127);
+    ReverseComplement(input.data(), input.length(), &output[0]);
+    return output;
+}
+
+PackedSequence::PackedSequence() : length_(0) {}
+
+PackedSequence::PackedSequence(const std::string& bases)
+    : words_((bases.length() + BASES_PER_WORD - 1) / BASES_PER_WORD, 0), length_(bases.length())
+{
+    for (int i = 0; i < length_; i++) {
+        int code = PackedCode(bases[i]);
+        if (code < 0) throw InvalidInputError("PackedSequence holds only ACGT");
+        words_[i / BASES_PER_WORD] |= static_cast<uint64_t>(code) << (2 * (i % BASES_PER_WORD));
+    }
+}
+
+std::string PackedSequence::ToString() const
+{
+    std::string bases(length_, 'A');
+    for (int i = 0; i < length_; i++) {
+        bases[i] = Base(i);
+    }
+    return bases;
+}
+
+PackedSequence PackedSequence::ReverseComplement() const
+{
+    // Reversing the words, and the codes within them, reverses the
+    // sequence padded out to whole words, leaving the padding first;
+    // shift it out, then complement
+    int n = words_.size();
+    std::vector<uint64_t> reversed(n + 1, 0);
+    for (int k = 0; k < n; k++) {
+        reversed[k] = ReverseCodes(words_[n - 1 - k]);
+    }
+    int shift = 2 * (n * BASES_PER_WORD - length_);
+    PackedSequence rc;
+    rc.length_ = length_;
+    rc.words_.resize(n);
+    for (int k = 0; k < n; k++) {
+        uint64_t word = (shift == 0) ? reversed[k]
+                                     : (reversed[k] >> shift) | (reversed[k + 1] << (64 - shift));
+        rc.words_[k] = ~word;
+    }
+    int tail = 2 * (length_ % BASES_PER_WORD);
+    if (tail > 0) rc.words_[n - 1] &= (1ULL << tail) - 1;
+    return rc;
+}
+
+bool PackedSequence::operator==(const PackedSequence& other) const
+{
+    return length_ == other.length_ && words_ == other.words_;
+}
 }
@@ -0,0 +1,90 @@
+// Author: David Alexander
+
+// The AVX2 complement kernels.  Each function here is compiled for
+// AVX2, and may not be called unless the CPU supports it.
+
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Simd.hpp>
+
+#include <immintrin.h>
+
+namespace ConsensusCore {
+namespace detail {
+
+namespace {
+// A, C, T and G differ in their low nibbles (1, 3, 4 and 7), which
+// index these tables of each base and its complement, the other
+// nibbles holding x; the case bit, 0x20, is carried over.
+CONSENSUSCORE_TARGET("avx2") inline __m256i Nibbles(const char* bases, char x)
+{
+    return _mm256_setr_epi8(x, bases[0], x, bases[1], bases[2], x, x, bases[3], x, x, x, x, x, x,
+                            x, x, x, bases[0], x, bases[1], bases[2], x, x, bases[3], x, x, x, x,
+                            x, x, x, x);
+}
+
+// The complements of 32 bases, in place; false, leaving them, if any
+// is not one of ACGTacgt
+CONSENSUSCORE_TARGET("avx2") inline bool ComplementBlock(__m256i* block)
+{
+    static const char upper[] = {'A', 'C', 'T', 'G'};  // by nibbles 1, 3, 4, 7
+    static const char complement[] = {'T', 'G', 'A', 'C'};
+    // No uppercased byte is 0xFF
+    const __m256i bases = Nibbles(upper, static_cast<char>(0xFF));
+    const __m256i complements = Nibbles(complement, 0);
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+
+    __m256i nibble = _mm256_and_si256(*block, lowNibble);
+    __m256i uppercase = _mm256_andnot_si256(caseBit, *block);
+    __m256i isBase = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(bases, nibble), uppercase);
+    if (_mm256_movemask_epi8(isBase) != -1) return false;
+    *block = _mm256_or_si256(_mm256_shuffle_epi8(complements, nibble),
+                             _mm256_and_si256(*block, caseBit));
+    return true;
+}
+
+// The 32 bytes in the reverse order
+CONSENSUSCORE_TARGET("avx2") inline __m256i ReverseBlock(__m256i block)
+{
+    const __m256i reverseLanes = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2,
+                                                  1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4,
+                                                  3, 2, 1, 0);
+    return _mm256_permute2x128_si256(_mm256_shuffle_epi8(block, reverseLanes),
+                                     _mm256_shuffle_epi8(block, reverseLanes), 0x01);
+}
+}
+
+CONSENSUSCORE_TARGET("avx2") int ComplementAvx2(const char* input, int length, char* output)
+{
+    int done = length - length % 32;
+    for (int i = 0; i < done; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        if (ComplementBlock(&block)) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), block);
+        } else {
+            for (int k = i; k < i + 32; k++) {
+                output[k] = ComplementaryBase(input[k]);
+            }
+        }
+    }
+    return done;
+}
+
+CONSENSUSCORE_TARGET("avx2") int ReverseComplementAvx2(const char* input, int length, char* output)
+{
+    int done = length - length % 32;
+    for (int i = 0; i < done; i += 32) {
+        const char* from = input + length - i - 32;
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from));
+        if (ComplementBlock(&block)) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), ReverseBlock(block));
+        } else {
+            for (int k = 0; k < 32; k++) {
+                output[i + k] = ComplementaryBase(from[31 - k]);
+            }
+        }
+    }
+    return done;
+}
+}
+}
@@ -3,12 +3,29 @@
 #include <ConsensusCore/Statistics/Binomial.hpp>
 
 #include <boost/math/distributions/binomial.hpp>
+#include <boost/math/special_functions/beta.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <ConsensusCore/ThreadPool.hpp>
+#include <ConsensusCore/Types.hpp>
 
 using boost::math::binomial_distribution;
 using boost::math::complement;
 using boost::math::cdf;
 
+// Sizes up to this are summed term by term off the log-factorial
+// table; larger ones go to the incomplete beta function
+#define MAX_TABLE_SIZE 16384
+
+// Sites per task of the batch
+#define SITES_PER_CHUNK 1024
+
 namespace ConsensusCore {
 double BinomialSurvival(int q, int size, double prob, bool asPhred)
 {
@@ -16,4 +33,108 @@ double BinomialSurvival(int q, int size, double prob, bool asPhred)
     double tail = q < 0 ? 1 : cdf(complement(dist, q));
     return asPhred ? -10. * log10(tail) : tail;
 }
+
+namespace {  // PRIVATE
+typedef std::vector<double> LogFactorialTable;
+
+// A table of log(n!) for n up to at least size, shared between calls;
+// a larger table replaces, rather than changes, the cached one, so the
+// tables handed out stay valid
+boost::shared_ptr<const LogFactorialTable> LogFactorials(int size)
+{
+    static std::mutex mutex;
+    static boost::shared_ptr<const LogFactorialTable> cached;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!cached || static_cast<int>(cached->size()) <= size) {
+        int length = std::max(size + 1, cached ? 2 * static_cast<int>(cached->size()) : 1024);
+        LogFactorialTable* table = new LogFactorialTable(std::min(length, MAX_TABLE_SIZE + 1));
+        (*table)[0] = 0.0;
+        for (size_t n = 1; n < table->size(); n++) {
+            (*table)[n] = (*table)[n - 1] + std::log(static_cast<double>(n));
+        }
+        cached.reset(table);
+    }
+    return cached;
+}
+
+// log P[X = k]
+inline double LogPmf(const LogFactorialTable& lf, int k, int n, double logP, double logQ)
+{
+    return lf[n] - lf[k] - lf[n - k] + k * logP + (n - k) * logQ;
+}
+
+// log P[X > q] for 0 <= q < n and 0 < p < 1, summing the terms of the
+// smaller tail outward from q, relative to the first, until they no
+// longer add to the sum
+double LogSurvival(const LogFactorialTable& lf, int q, int n, double p)
+{
+    const double logP = std::log(p), logQ = std::log1p(-p);
+    const double odds = p / (1 - p);
+    if (q + 1 >= (n + 1) * p) {
+        // the upper tail, whose terms fall from k = q + 1 on
+        double term = 1.0, sum = 1.0;
+        for (int k = q + 1; k < n && term > sum * 1e-17; k++) {
+            term *= odds * (n - k) / (k + 1);
+            sum += term;
+        }
+        return LogPmf(lf, q + 1, n, logP, logQ) + std::log(sum);
+    } else {
+        // one less the lower tail, whose terms fall from k = q down
+        double term = 1.0, sum = 1.0;
+        for (int k = q; k > 0 && term > sum * 1e-17; k--) {
+            term *= k / (odds * (n - k + 1));
+            sum += term;
+        }
+        double logLower = LogPmf(lf, q, n, logP, logQ) + std::log(sum);
+        return std::log(-std::expm1(logLower));
+    }
+}
+
+double Survival(const LogFactorialTable& lf, int q, int n, double p, bool asPhred)
+{
+    double logTail;
+    if (q < 0 || (p >= 1 && q < n)) {
+        logTail = 0.0;
+    } else if (q >= n || p <= 0) {
+        logTail = -INFINITY;
+    } else if (n < static_cast<int>(lf.size())) {
+        logTail = LogSurvival(lf, q, n, p);
+    } else {
+        // P[X > q] = I_p(q + 1, n - q)
+        logTail = std::log(boost::math::ibeta(q + 1.0, static_cast<double>(n - q), p));
+    }
+    return asPhred ? -10. / std::log(10.) * logTail : std::exp(logTail);
+}
+}  // PRIVATE
+
+void BinomialSurvivalBatch(int qDim, int* q, int sizeDim, int* size, int probDim, double* prob,
+                           double** survival, int* nSurvival, bool asPhred, int numThreads)
+{
+    if (qDim != sizeDim || qDim != probDim) {
+        throw InvalidInputError("BinomialSurvivalBatch needs as many sizes and probs as qs");
+    }
+    int maxSize = 0;
+    for (int i = 0; i < qDim; i++) {
+        if (size[i] < 0 || !(0 <= prob[i] && prob[i] <= 1)) {
+            throw InvalidInputError("Invalid binomial distribution");
+        }
+        maxSize = std::max(maxSize, size[i]);
+    }
+    boost::shared_ptr<const LogFactorialTable> lf =
+        LogFactorials(std::min(maxSize, MAX_TABLE_SIZE));
+
+    double* out = static_cast<double*>(std::malloc(std::max(qDim, 1) * sizeof(double)));
+    if (out == NULL) throw std::bad_alloc();
+    const int numChunks = (qDim + SITES_PER_CHUNK - 1) / SITES_PER_CHUNK;
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(numChunks, [&](int c) {
+        int end = std::min(qDim, (c + 1) * SITES_PER_CHUNK);
+        for (int i = c * SITES_PER_CHUNK; i < end; i++) {
+            out[i] = Survival(*lf, q[i], size[i], prob[i], asPhred);
+        }
+    });
+    *survival = out;
+    *nSurvival = qDim;
+}
 }
@@ -0,0 +1,126 @@
+// Author: David Alexander
+
+#include <ConsensusCore/ThreadPool.hpp>
+#include <ConsensusCore/Types.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+namespace ConsensusCore {
+
+namespace {  // PRIVATE
+// The pool (if any) whose job is being run on this thread
+thread_local const ThreadPool* currentPool = NULL;
+}
+
+ThreadPool::ThreadPool(int numThreads)
+    : job_(NULL)
+    , jobSize_(0)
+    , nextIndex_(0)
+    , busyWorkers_(0)
+    , generation_(0)
+    , error_()
+    , shutdown_(false)
+{
+    if (numThreads < 1) {
+        throw InvalidInputError("ThreadPool requires at least one thread");
+    }
+    for (int i = 1; i < numThreads; i++) {
+        workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    wakeCv_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++) {
+        workers_[i].join();
+    }
+}
+
+int ThreadPool::NumThreads() const { return static_cast<int>(workers_.size()) + 1; }
+
+void ThreadPool::ParallelFor(int n, const std::function<void(int)>& fn)
+{
+    if (n <= 0) return;
+
+    // Serial fallback: no helpers, trivial jobs, or nested submission
+    // from within one of our own jobs (which would otherwise deadlock).
+    if (workers_.empty() || n == 1 || currentPool == this) {
+        for (int i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        jobSize_ = n;
+        nextIndex_ = 0;
+        busyWorkers_ = 0;
+        error_ = std::exception_ptr();
+        generation_++;
+    }
+    wakeCv_.notify_all();
+
+    RunJob();
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        doneCv_.wait(lock, [this] { return busyWorkers_ == 0; });
+        job_ = NULL;
+        error = error_;
+        error_ = std::exception_ptr();
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::RunJob()
+{
+    const ThreadPool* enclosingPool = currentPool;
+    currentPool = this;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::function<void(int)>* job = job_;
+    busyWorkers_++;
+    while (job != NULL && nextIndex_ < jobSize_) {
+        int i = nextIndex_++;
+        lock.unlock();
+        try {
+            (*job)(i);
+        } catch (...) {
+            lock.lock();
+            if (!error_) error_ = std::current_exception();
+            nextIndex_ = jobSize_;
+            continue;
+        }
+        lock.lock();
+    }
+    busyWorkers_--;
+    if (busyWorkers_ == 0) doneCv_.notify_all();
+
+    currentPool = enclosingPool;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeCv_.wait(lock, [this, seen] { return shutdown_ || generation_ != seen; });
+            if (shutdown_) return;
+            seen = generation_;
+        }
+        RunJob();
+    }
+}
+}
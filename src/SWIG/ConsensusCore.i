@@ -16,6 +16,10 @@ namespace boost {
     class noncopyable {};
 }
 
+// The instruction set attribute of the SIMD kernels (see Simd.hpp),
+// which SWIG need not see
+#define CONSENSUSCORE_SIMD_TARGET
+
 %include "Types.i"
 #ifdef SWIGPYTHON
 %include "numpy.i"
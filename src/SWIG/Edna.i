@@ -4,9 +4,17 @@
 #include <ConsensusCore/Edna/EdnaConfig.hpp>
 #include <ConsensusCore/Edna/EdnaCounts.hpp>
 #include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Edna/MultiReadEdnaScorer.hpp>
 using namespace ConsensusCore;
 %}
 
+%releasegil(ConsensusCore::EdnaCounts::DoCount);
+%releasegil(ConsensusCore::MultiReadEdnaScorer::AddRead);
+%releasegil(ConsensusCore::MultiReadEdnaScorer::Template(const std::string&));
+%releasegil(ConsensusCore::MultiReadEdnaScorer::Params(const EdnaModelParams&));
+%releasegil(ConsensusCore::MultiReadEdnaScorer::Counts);
+
 %include <ConsensusCore/Edna/EdnaConfig.hpp>
 %include <ConsensusCore/Edna/EdnaCounts.hpp>
 %include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+%include <ConsensusCore/Edna/MultiReadEdnaScorer.hpp>
@@ -4,6 +4,21 @@
 #include <iostream>
 #include <ConsensusCore/Types.hpp>
 using namespace ConsensusCore;
+
+//
+// Releases the Python GIL for its lifetime.  Only calls into pure C++
+// may run under one: nothing that touches Python objects.
+//
+class ReleaseGIL
+{
+public:
+#ifdef SWIGPYTHON
+    ReleaseGIL() : state_(PyEval_SaveThread()) {}
+    ~ReleaseGIL() { PyEval_RestoreThread(state_); }
+private:
+    PyThreadState* state_;
+#endif // SWIGPYTHON
+};
 %}
 
 %include <ConsensusCore/Types.hpp>
@@ -22,3 +37,28 @@ using namespace ConsensusCore;
       SWIG_exception(SWIG_RuntimeError, e.Message().c_str());
   }
 }
+
+//
+// %releasegil(name) lets other Python threads run while the named
+// (long-running) functions are in C++.  The GIL is taken back before
+// an exception is translated, as the guard is gone by the time the
+// handler runs.
+//
+// Releasing the GIL means the caller is responsible for not sharing an
+// object between threads that use it at the same time: distinct
+// objects may be used concurrently, the same object may not.
+//
+%define %releasegil(name)
+%exception name {
+  try {
+    ReleaseGIL unlocked;
+    $action
+  } catch (const std::exception& e) {
+      SWIG_exception(SWIG_RuntimeError, e.what());
+  } catch (const ConsensusCore::ErrorBase& e) {
+      SWIG_exception(SWIG_RuntimeError, e.Message().c_str());
+  } catch (const ConsensusCore::ExceptionBase& e) {
+      SWIG_exception(SWIG_RuntimeError, e.Message().c_str());
+  }
+}
+%enddef
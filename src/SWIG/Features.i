@@ -31,6 +31,64 @@ namespace ConsensusCore {
     %template(IntFeature) Feature<int>;
 }
 
+#if SWIGPYTHON
+
+%{
+#include <boost/shared_ptr.hpp>
+#include <cstring>
+
+namespace {
+// Holds a Python buffer---and so the object exporting it---for as long
+// as a borrowed feature needs it.  Features may be destroyed with the
+// GIL released, so it is taken here.
+class PyBufferHolder
+{
+public:
+    explicit PyBufferHolder(const Py_buffer& view) : view_(view) {}
+    ~PyBufferHolder()
+    {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyBuffer_Release(&view_);
+        PyGILState_Release(gil);
+    }
+private:
+    Py_buffer view_;
+};
+
+bool IsNativeFloat(const char* format)
+{
+    if (format == NULL) return false;
+    if (*format == '@' || *format == '=' || *format == '<') format++;
+    return std::strcmp(format, "f") == 0;
+}
+}
+%}
+
+%inline %{
+namespace ConsensusCore {
+/// A FloatFeature sharing, rather than copying, the memory of a
+/// one-dimensional contiguous float32 array (e.g., a numpy array).
+/// The array is kept alive by the feature and must not be modified
+/// while the feature is in use.
+FloatFeature BorrowFloatFeature(PyObject* array)
+{
+    Py_buffer view;
+    if (PyObject_GetBuffer(array, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+        PyErr_Clear();
+        throw InvalidInputError("BorrowFloatFeature requires a contiguous float32 array");
+    }
+    if (view.ndim != 1 || view.itemsize != sizeof(float) || !IsNativeFloat(view.format)) {
+        PyBuffer_Release(&view);
+        throw InvalidInputError("BorrowFloatFeature requires a contiguous float32 array");
+    }
+    boost::shared_ptr<void> owner(new PyBufferHolder(view));
+    return FloatFeature(static_cast<float*>(view.buf), static_cast<int>(view.shape[0]), owner);
+}
+}
+%}
+
+#endif // SWIGPYTHON
+
 %include "carrays.i"
 %array_class(float, FloatArray);
 %array_class(int, IntArray);
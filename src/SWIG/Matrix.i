@@ -1,6 +1,7 @@
 %{
 /* Includes the header in the wrapper code */
 #include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
 #include <ConsensusCore/Matrix/AbstractMatrix.hpp>
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
 #include <ConsensusCore/Matrix/SparseMatrix.hpp>
@@ -13,11 +14,23 @@ using namespace ConsensusCore;
         // apply this typemap to ToHostMatrix
         %apply (float** ARGOUTVIEW_ARRAY2, int* DIM1, int* DIM2)
              { (float** mat, int* rows, int* cols) };
+
+        // the band-native and windowed exports malloc their arrays,
+        // which numpy then owns and frees
+        %apply (float** ARGOUTVIEWM_ARRAY2, int* DIM1, int* DIM2)
+             { (float** window, int* windowRows, int* windowCols) };
+        %apply (float** ARGOUTVIEWM_ARRAY1, int* DIM1)
+             { (float** values, int* nValues) };
+        %apply (int** ARGOUTVIEWM_ARRAY1, int* DIM1)
+             { (int** offsets, int* nOffsets) };
+        %apply (int** ARGOUTVIEWM_ARRAY2, int* DIM1, int* DIM2)
+             { (int** ranges, int* cols, int* two) };
 #endif // SWIGPYTHON
 
 %newobject *::UsedRowRange;
 
 
+%include <ConsensusCore/MemoryUsage.hpp>
 %include <ConsensusCore/Matrix/AbstractMatrix.hpp>
 %include <ConsensusCore/Matrix/DenseMatrix.hpp>
 %include <ConsensusCore/Matrix/SparseMatrix.hpp>
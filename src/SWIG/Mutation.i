@@ -13,6 +13,7 @@ using namespace ConsensusCore;
  // abstract classes, so we have to tell it otherwise
 %feature("notabstract") AllSingleBaseMutationEnumerator;
 %feature("notabstract") UniqueSingleBaseMutationEnumerator;
+%feature("notabstract") TandemRepeatMutationEnumerator;
 %feature("notabstract") DinucRepeatMutationEnumerator;
 
 %newobject *::Mutations();
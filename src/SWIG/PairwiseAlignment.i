@@ -3,6 +3,8 @@
 #include <ConsensusCore/Align/AlignConfig.hpp>
 #include <ConsensusCore/Align/PairwiseAlignment.hpp>
 #include <ConsensusCore/Align/AffineAlignment.hpp>
+#include <ConsensusCore/Align/BatchAlignment.hpp>
+#include <ConsensusCore/Align/EditDistance.hpp>
 #include <ConsensusCore/Align/LinearAlignment.hpp>
 using namespace ConsensusCore;
 %}
@@ -12,9 +14,28 @@ using namespace ConsensusCore;
 %newobject Align;
 %newobject AlignAffine;
 %newobject AlignAffineIupac;
+%newobject AlignAffineBanded;
+%newobject AlignEditDistance;
 %newobject AlignLinear;
+%newobject AlignBatch;
+%newobject AlignAffineBatch;
+%newobject AlignAffineIupacBatch;
+%newobject ConsensusCore::PairwiseAlignmentBatch::Alignment;
+
+%releasegil(ConsensusCore::Align);
+%releasegil(ConsensusCore::AlignAffine);
+%releasegil(ConsensusCore::AlignAffineIupac);
+%releasegil(ConsensusCore::AlignAffineBanded);
+%releasegil(ConsensusCore::EditDistance);
+%releasegil(ConsensusCore::AlignEditDistance);
+%releasegil(ConsensusCore::AlignLinear);
+%releasegil(ConsensusCore::AlignBatch);
+%releasegil(ConsensusCore::AlignAffineBatch);
+%releasegil(ConsensusCore::AlignAffineIupacBatch);
 
 %include <ConsensusCore/Align/AlignConfig.hpp>
 %include <ConsensusCore/Align/PairwiseAlignment.hpp>
 %include <ConsensusCore/Align/AffineAlignment.hpp>
+%include <ConsensusCore/Align/EditDistance.hpp>
 %include <ConsensusCore/Align/LinearAlignment.hpp>
+%include <ConsensusCore/Align/BatchAlignment.hpp>
@@ -12,8 +12,52 @@ using namespace ConsensusCore;
 %csmethodmodifiers ConsensusCore::PoaConsensus::ToString() const "public override"
 #endif // SWIGCSHARP
 
+%releasegil(ConsensusCore::PoaGraph::AddRead);
+%releasegil(ConsensusCore::PoaGraph::TryAddRead);
+%releasegil(ConsensusCore::PoaGraph::TryAddReads);
+%releasegil(ConsensusCore::PoaGraph::CommitAdd);
+%releasegil(ConsensusCore::PoaGraph::MergeConsensus);
+%releasegil(ConsensusCore::PoaGraph::FindConsensus);
+
+#ifdef SWIGPYTHON
+// Return the matrices of a batch of trial alignments as a list, handing
+// ownership of each to Python
+%typemap(out) std::vector<ConsensusCore::PoaAlignmentMatrix*> {
+    $result = PyList_New($1.size());
+    for (size_t i = 0; i < $1.size(); i++) {
+        PyObject* mat = SWIG_NewPointerObj(SWIG_as_voidptr($1[i]),
+                                           $descriptor(ConsensusCore::PoaAlignmentMatrix*),
+                                           SWIG_POINTER_OWN);
+        PyList_SET_ITEM($result, i, mat);
+    }
+}
+#endif // SWIGPYTHON
+
 %include <ConsensusCore/Poa/PoaGraph.hpp>
 
 %newobject ConsensusCore::PoaConsensus::FindConsensus;
+%newobject ConsensusCore::PoaConsensus::FindConsensusHierarchical;
+
+namespace std {
+    %template(StringVectorVector)     std::vector<std::vector<std::string> >;
+};
+
+%releasegil(ConsensusCore::PoaConsensus::FindConsensus);
+%releasegil(ConsensusCore::PoaConsensus::FindConsensusBatch);
+%releasegil(ConsensusCore::PoaConsensus::FindConsensusHierarchical);
+
+#ifdef SWIGPYTHON
+// Return the consensi of a batch as a list, handing ownership of each
+// to Python
+%typemap(out) std::vector<const ConsensusCore::PoaConsensus*> {
+    $result = PyList_New($1.size());
+    for (size_t i = 0; i < $1.size(); i++) {
+        PyObject* pc = SWIG_NewPointerObj(SWIG_as_voidptr($1[i]),
+                                          $descriptor(ConsensusCore::PoaConsensus*),
+                                          SWIG_POINTER_OWN);
+        PyList_SET_ITEM($result, i, pc);
+    }
+}
+#endif // SWIGPYTHON
 
 %include <ConsensusCore/Poa/PoaConsensus.hpp>
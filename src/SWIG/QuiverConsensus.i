@@ -3,14 +3,23 @@
 #include <ConsensusCore/Sequence.hpp>
 #include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/ReadStore.hpp>
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
 #include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/HybridMultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/MultiTemplateScorer.hpp>
 #include <ConsensusCore/Quiver/MutationScorer.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
 #include <ConsensusCore/Quiver/SimpleRecursor.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
 #include <ConsensusCore/Quiver/SseRecursor.hpp>
 #include <ConsensusCore/Quiver/ReadScorer.hpp>
 #include <ConsensusCore/Quiver/Diploid.hpp>
 #include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+#include <ConsensusCore/Quiver/ConsensusPipeline.hpp>
+#include <ConsensusCore/Quiver/WorkUnit.hpp>
+#include <ConsensusCore/Quiver/StreamingQuiver.hpp>
+#include <ConsensusCore/Quiver/Autotune.hpp>
 
 using namespace ConsensusCore;
 %}
@@ -22,31 +31,134 @@ using namespace ConsensusCore;
 
 %apply (float* IN_ARRAY2, int DIM1, int DIM2)
        { (const float *siteScores, int dim1, int dim2) }
+%apply (float* IN_ARRAY3, int DIM1, int DIM2, int DIM3)
+       { (const float* siteScores, int numSites, int numMutations, int numReads) }
+
+// Scores, QVs and matrix entries straight into numpy arrays
+%apply (float** ARGOUTVIEWM_ARRAY1, int* DIM1)
+       { (float** scores, int* nScores) }
+%apply (int** ARGOUTVIEWM_ARRAY1, int* DIM1)
+       { (int** entries, int* nEntries),
+         (int** qvs, int* nQvs) }
+%apply (float** ARGOUTVIEWM_ARRAY2, int* DIM1, int* DIM2)
+       { (float** scores, int* nMutations, int* nReads) }
+%apply (float* INPLACE_ARRAY2, int DIM1, int DIM2)
+       { (float* scores, int nMutations, int nReads) }
+
+// Mutations as parallel arrays, scored into the caller's array
+%apply (int DIM1, int* IN_ARRAY1)
+       { (int nTypes, int* types),
+         (int nStarts, int* starts),
+         (int nEnds, int* ends),
+         (int nCounts, int* baseCounts) }
+%apply (float* INPLACE_ARRAY1, int DIM1)
+       { (float* scores, int nScores) }
 
 #endif // SWIGPYTHON
 
  // SWIG now seems to be incorrectly deciding that MultiReadMutationScorer
  // is an abstract class, so we have to tell it otherwise
 %feature("notabstract") MultiReadMutationScorer;
+%feature("notabstract") HybridMultiReadMutationScorer;
+
+%newobject ConsensusCore::MultiReadMutationScorer::Restore;
 
 #ifdef SWIGCSHARP
 %csmethodmodifiers *::ToString() const "public override"
+
+// Mutations as parallel arrays, scored into the caller's array
+%include "arrays_csharp.i"
+%apply int INPUT[] { int* types, int* starts, int* ends, int* baseCounts }
+%apply float OUTPUT[] { float* scores }
 #endif // SWIGCSHARP
 
 
+// Long-running calls
+%releasegil(ConsensusCore::RefineConsensus);
+%releasegil(ConsensusCore::RefineDinucleotideRepeats);
+%releasegil(ConsensusCore::RefineTrinucleotideRepeats);
+%releasegil(ConsensusCore::ConsensusQVs);
+%releasegil(ConsensusCore::MutationScoresMatrix);
+%releasegil(ConsensusCore::ConsensusQVsArray);
+%releasegil(ConsensusCore::MutationScoresMatrixArray);
+%releasegil(ConsensusCore::IsSiteHeterozygous);
+%releasegil(ConsensusCore::CallHeterozygousSites);
+%releasegil(ConsensusCore::MultiReadMutationScorer::AddRead);
+%releasegil(ConsensusCore::MultiReadMutationScorer::ApplyMutations);
+%releasegil(ConsensusCore::MultiReadMutationScorer::ScoreMany);
+%releasegil(ConsensusCore::MultiReadMutationScorer::FastScoreMany);
+%releasegil(ConsensusCore::MultiReadMutationScorer::ScoresMany);
+%releasegil(ConsensusCore::MultiReadMutationScorer::ScoresManyInto);
+%releasegil(ConsensusCore::AbstractMultiReadMutationScorer::ScoreManyArrays);
+%releasegil(ConsensusCore::AbstractMultiReadMutationScorer::FastScoreManyArrays);
+%releasegil(ConsensusCore::AbstractMultiReadMutationScorer::ScoresManyArrays);
+%releasegil(ConsensusCore::MultiReadMutationScorer::Alignments);
+%releasegil(ConsensusCore::MultiReadMutationScorer::MultiReadMutationScorer);
+%releasegil(ConsensusCore::MultiReadMutationScorer::Save);
+%releasegil(ConsensusCore::MultiReadMutationScorer::Restore);
+%releasegil(ConsensusCore::HybridMultiReadMutationScorer::AddRead);
+%releasegil(ConsensusCore::HybridMultiReadMutationScorer::ApplyMutations);
+%releasegil(ConsensusCore::HybridMultiReadMutationScorer::ScoreMany);
+%releasegil(ConsensusCore::HybridMultiReadMutationScorer::FastScoreMany);
+%releasegil(ConsensusCore::HybridMultiReadMutationScorer::ScoresMany);
+%releasegil(ConsensusCore::HybridMultiReadMutationScorer::ScoresManyInto);
+%releasegil(ConsensusCore::HybridMultiReadMutationScorer::Alignments);
+%releasegil(ConsensusCore::MutationScorer::MutationScorer);
+%releasegil(ConsensusCore::MutationScorer::Template);
+%releasegil(ConsensusCore::ConsensusPipeline::Submit);
+%releasegil(ConsensusCore::ConsensusPipeline::Next);
+%releasegil(ConsensusCore::ConsensusPipeline::~ConsensusPipeline);
+%releasegil(ConsensusCore::RefineWorkUnit);
+%releasegil(ConsensusCore::BatchRefiner::Refine);
+%releasegil(ConsensusCore::RefineConsensusBatch);
+%releasegil(ConsensusCore::FindWindowConsensus);
+%releasegil(ConsensusCore::AsyncRefiner::Submit);
+%releasegil(ConsensusCore::AsyncRefiner::SubmitWindow);
+%releasegil(ConsensusCore::AsyncRefiner::NextCompleted);
+%releasegil(ConsensusCore::AsyncRefiner::~AsyncRefiner);
+%releasegil(ConsensusCore::RefineFuture::Wait);
+%releasegil(ConsensusCore::RefineFuture::Result);
+%releasegil(ConsensusCore::StreamingQuiver::AddRead);
+%releasegil(ConsensusCore::StreamingQuiver::Finish);
+%releasegil(ConsensusCore::MultiReadMutationScorer::SlideTemplate);
+%releasegil(ConsensusCore::Autotune);
+%releasegil(ConsensusCore::AutotuneCached);
+%releasegil(ConsensusCore::MultiTemplateScorer::AddRead);
+%releasegil(ConsensusCore::MultiTemplateScorer::AddReads);
+%releasegil(ConsensusCore::MultiTemplateScorer::ScoreMany);
+%releasegil(ConsensusCore::MultiTemplateScorer::ApplyMutations);
+
 %include <ConsensusCore/Sequence.hpp>
 %include <ConsensusCore/Mutation.hpp>
 %include <ConsensusCore/Read.hpp>
+%include <ConsensusCore/ReadStore.hpp>
+%include <ConsensusCore/Quiver/CompactAlignment.hpp>
 %include <ConsensusCore/Quiver/detail/Combiner.hpp>
 %include <ConsensusCore/Quiver/detail/RecursorBase.hpp>
 %include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
 %include <ConsensusCore/Quiver/MutationScorer.hpp>
+%include <ConsensusCore/Quiver/MultiTemplateScorer.hpp>
 %include <ConsensusCore/Quiver/QuiverConfig.hpp>
 %include <ConsensusCore/Quiver/SimpleRecursor.hpp>
+%include <ConsensusCore/Quiver/SimdRecursor.hpp>
 %include <ConsensusCore/Quiver/SseRecursor.hpp>
 %include <ConsensusCore/Quiver/ReadScorer.hpp>
 %include <ConsensusCore/Quiver/Diploid.hpp>
 %include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+%include <ConsensusCore/Quiver/ConsensusPipeline.hpp>
+%include <ConsensusCore/Quiver/WorkUnit.hpp>
+%include <ConsensusCore/Quiver/StreamingQuiver.hpp>
+%include <ConsensusCore/Quiver/Autotune.hpp>
+
+namespace std {
+    %template(FillStatisticsVector)     std::vector<ConsensusCore::FillStatistics>;
+    %template(CompactAlignmentVector)   std::vector<ConsensusCore::CompactAlignment>;
+    %template(MappedReadVector)         std::vector<ConsensusCore::MappedRead>;
+    %template(AutotuneSampleVector)     std::vector<ConsensusCore::AutotuneSample>;
+    %template(AutotuneChoiceVector)     std::vector<ConsensusCore::AutotuneChoice>;
+    %template(WorkUnitVector)           std::vector<ConsensusCore::WorkUnit>;
+    %template(ConsensusResultVector)    std::vector<ConsensusCore::ConsensusResult>;
+};
 
  
 namespace ConsensusCore {
@@ -69,6 +181,7 @@ namespace ConsensusCore {
     %template(SparseSseQvMutationScorer)      MutationScorer<SparseSseQvRecursor>;
 
     %template(SparseSseQvMultiReadMutationScorer) MultiReadMutationScorer<SparseSseQvRecursor>;
+    %template(SparseSseQvMultiTemplateScorer)     MultiTemplateScorer<SparseSseQvRecursor>;
 
     //
     // Sparse matrix sum-product support
@@ -80,6 +193,7 @@ namespace ConsensusCore {
     %template(SparseSseQvSumProductMutationScorer)      MutationScorer<SparseSseQvSumProductRecursor>;
 
     %template(SparseSseQvSumProductMultiReadMutationScorer) MultiReadMutationScorer<SparseSseQvSumProductRecursor>;
+    %template(SparseSseQvSumProductMultiTemplateScorer)     MultiTemplateScorer<SparseSseQvSumProductRecursor>;
 
     //
     // Edna evaluator support
@@ -88,3 +202,73 @@ namespace ConsensusCore {
     %template(SparseSseEdnaRecursor)            SseRecursor<SparseMatrix, EdnaEvaluator, detail::SumProductCombiner>;
     %template(SparseSseEdnaMutationScorer)      MutationScorer<SparseSseEdnaRecursor>;
 }
+
+// The hybrid scorer's tiers are instantiated above
+%include <ConsensusCore/Quiver/HybridMultiReadMutationScorer.hpp>
+
+#ifdef SWIGPYTHON
+%pythoncode %{
+class FutureRefiner(object):
+    """Submits work units and windows to an AsyncRefiner, returning a
+    concurrent.futures.Future of each one's ConsensusResult, which
+    asyncio.wrap_future makes awaitable.  A thread of the wrapper's own
+    waits on the refiner, with the GIL released, and resolves the
+    futures as their jobs finish.  Cancelling a future cancels its job
+    if no worker has started on it.  (On Python 2, concurrent.futures
+    is the "futures" backport.)"""
+
+    def __init__(self, refiner):
+        import threading
+        from concurrent.futures import Future
+        self._Future = Future
+        self._refiner = refiner
+        self._jobs = {}
+        self._lock = threading.Lock()
+        self._closed = False
+        self._collector = threading.Thread(target=self._collect)
+        self._collector.daemon = True
+        self._collector.start()
+
+    def submit(self, unit):
+        return self._track(lambda: self._refiner.Submit(unit))
+
+    def submit_window(self, window):
+        return self._track(lambda: self._refiner.SubmitWindow(window))
+
+    def close(self):
+        """Take no more jobs, and wait for those submitted."""
+        self._closed = True
+        self._collector.join()
+
+    def _track(self, submit):
+        if self._closed:
+            raise RuntimeError("FutureRefiner is closed")
+        future = self._Future()
+        # Held while submitting, so the job is known before it finishes
+        with self._lock:
+            job = submit()
+            self._jobs[job.Ticket()] = (job, future)
+
+        def cancelled(f):
+            if f.cancelled() and job.Cancel():
+                with self._lock:
+                    self._jobs.pop(job.Ticket(), None)
+        future.add_done_callback(cancelled)
+        return future
+
+    def _collect(self):
+        while not (self._closed and not self._jobs):
+            ticket = self._refiner.NextCompleted(0.1)
+            if ticket < 0:
+                continue
+            with self._lock:
+                job, future = self._jobs.pop(ticket, (None, None))
+            if future is None or future.cancelled():
+                continue
+            try:
+                future.set_result(job.Result())
+            except Exception:
+                # cancelled meanwhile
+                pass
+%}
+#endif // SWIGPYTHON
@@ -5,4 +5,16 @@
 using namespace ConsensusCore;
 %}
 
+#ifdef SWIGPYTHON
+    %apply (int DIM1, int* IN_ARRAY1)
+         { (int qDim, int* q),
+           (int sizeDim, int* size) };
+    %apply (int DIM1, double* IN_ARRAY1)
+         { (int probDim, double* prob) };
+    %apply (double** ARGOUTVIEWM_ARRAY1, int* DIM1)
+         { (double** survival, int* nSurvival) };
+#endif // SWIGPYTHON
+
+%releasegil(ConsensusCore::BinomialSurvivalBatch);
+
 %include <ConsensusCore/Statistics/Binomial.hpp>
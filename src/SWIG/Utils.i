@@ -3,6 +3,8 @@
 #include <ConsensusCore/Utils.hpp>
 #include <ConsensusCore/Coverage.hpp>
 #include <ConsensusCore/Logging.hpp>
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/ChromeTrace.hpp>
 using namespace ConsensusCore;
 %}
 
@@ -16,6 +18,17 @@ using namespace ConsensusCore;
          { (int winLen, int* coverage) };
 #endif // SWIGPYTHON
 
+%releasegil(ConsensusCore::CoverageIndex::CoveredIntervals(int, const std::vector<Interval>&, int) const);
+%releasegil(ConsensusCore::CoverageIndex::Summaries);
+
 %include <ConsensusCore/Utils.hpp>
 %include <ConsensusCore/Coverage.hpp>
 %include <ConsensusCore/Logging.hpp>
+%include <ConsensusCore/PerfStats.hpp>
+%include <ConsensusCore/ChromeTrace.hpp>
+
+namespace std {
+    %template(PhaseStatsVector)     std::vector<ConsensusCore::PhaseStats>;
+    %template(CoverageSummaryVector) std::vector<ConsensusCore::CoverageSummary>;
+    %template(IntervalVectorVector) std::vector<std::vector<ConsensusCore::Interval> >;
+};
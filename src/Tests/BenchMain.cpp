@@ -0,0 +1,8 @@
+// Author: David Alexander
+
+#include <benchmark/benchmark.h>
+
+// Run e.g. with
+//   --benchmark_out=bench.json --benchmark_out_format=json
+// to record results for tracking.
+BENCHMARK_MAIN();
@@ -0,0 +1,53 @@
+// Author: David Alexander
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Align/AffineAlignment.hpp>
+#include <ConsensusCore/Align/PairwiseAlignment.hpp>
+#include <ConsensusCore/Poa/PoaConsensus.hpp>
+
+#include "BenchUtils.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+//
+// Arguments: read length, coverage
+//
+static void BM_PoaConsensus(benchmark::State& state)
+{
+    Rng rng(42);
+    std::string tpl = RandomSequence(rng, state.range(0));
+    std::vector<std::string> reads;
+    for (int n = 0; n < state.range(1); n++) {
+        reads.push_back(NoisyCopy(rng, tpl, 0.1));
+    }
+
+    for (auto _ : state) {
+        const PoaConsensus* pc = PoaConsensus::FindConsensus(reads);
+        benchmark::DoNotOptimize(pc);
+        delete pc;
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_PoaConsensus)->ArgsProduct({{100, 500, 2000}, {5, 20}});
+
+//
+// Arguments: sequence length
+//
+static void BM_AlignAffine(benchmark::State& state)
+{
+    Rng rng(42);
+    std::string target = RandomSequence(rng, state.range(0));
+    std::string query = NoisyCopy(rng, target, 0.1);
+
+    for (auto _ : state) {
+        const PairwiseAlignment* a = AlignAffine(target, query);
+        benchmark::DoNotOptimize(a);
+        delete a;
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(target.length()) * query.length());
+}
+BENCHMARK(BM_AlignAffine)->Arg(100)->Arg(1000)->Arg(5000);
@@ -0,0 +1,172 @@
+// Author: David Alexander
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Quiver/Int16Recursor.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/ScaledRecursor.hpp>
+#include <ConsensusCore/Quiver/SimpleRecursor.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Simd.hpp>
+
+#include "BenchUtils.hpp"
+#include "KernelVariants.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+//
+// Arguments: template length, banding ScoreDiff
+//
+
+template <typename R>
+static void BM_FillAlphaBeta(benchmark::State& state)
+{
+    Rng rng(42);
+    QvEvaluator e = NoisyQvEvaluator(rng, state.range(0));
+    R recursor(BASIC_MOVES | MERGE, BandingOptions(4, state.range(1)));
+    int I = e.ReadLength(), J = e.TemplateLength();
+
+    for (auto _ : state) {
+        SparseMatrix alpha(I + 1, J + 1), beta(I + 1, J + 1);
+        recursor.FillAlphaBeta(e, alpha, beta);
+        benchmark::DoNotOptimize(beta(0, 0));
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(I + 1) * (J + 1));
+}
+BENCHMARK_TEMPLATE(BM_FillAlphaBeta, SparseSseQvRecursor)
+    ->ArgsProduct({{100, 1000, 5000}, {12, 18}});
+BENCHMARK_TEMPLATE(BM_FillAlphaBeta, SparseSseQvSumProductRecursor)
+    ->ArgsProduct({{100, 1000, 5000}, {12, 18}});
+
+static void BM_FillAlpha(benchmark::State& state)
+{
+    Rng rng(42);
+    QvEvaluator e = NoisyQvEvaluator(rng, state.range(0));
+    SparseSseQvRecursor recursor(BASIC_MOVES | MERGE, BandingOptions(4, state.range(1)));
+    int I = e.ReadLength(), J = e.TemplateLength();
+
+    for (auto _ : state) {
+        SparseMatrix alpha(I + 1, J + 1);
+        recursor.FillAlpha(e, SparseMatrix::Null(), alpha);
+        benchmark::DoNotOptimize(alpha(I, J));
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(I + 1) * (J + 1));
+}
+BENCHMARK(BM_FillAlpha)->ArgsProduct({{100, 1000, 5000}, {12, 18}});
+
+// Arguments: template length.  The cost of the four move scores alone,
+// four rows at a time over a 32-row band about the diagonal, as the
+// SSE kernels ask for them: the part of a fill's time that an encoding
+// of the read and template could hope to save.
+static void BM_MoveScores(benchmark::State& state)
+{
+    typedef Simd<4> S;
+    Rng rng(42);
+    QvEvaluator e = NoisyQvEvaluator(rng, state.range(0));
+    int I = e.ReadLength(), J = e.TemplateLength();
+    int64_t cells = 0;
+
+    for (auto _ : state) {
+        S::Vec sum = S::Set1(0.0f);
+        cells = 0;
+        for (int j = 0; j < J - 1; j++) {
+            int begin = std::max(0, std::min(j - 16, I - 36));
+            for (int i = begin; i < begin + 32; i += 4) {
+                sum = S::Add(sum, S::Add(S::Add(e.IncN<4>(i, j), e.DelN<4>(i, j)),
+                                         S::Max(e.ExtraN<4>(i, j), e.MergeN<4>(i, j))));
+                cells += 4;
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * cells);
+}
+BENCHMARK(BM_MoveScores)->Arg(1000)->Arg(5000);
+
+static void BM_Int16ViterbiScore(benchmark::State& state)
+{
+    Rng rng(42);
+    QvEvaluator e = NoisyQvEvaluator(rng, state.range(0));
+    Int16ViterbiRecursor recursor(BASIC_MOVES | MERGE, BandingOptions(4, state.range(1)));
+    int I = e.ReadLength(), J = e.TemplateLength();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(recursor.Score(e));
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(I + 1) * (J + 1));
+}
+BENCHMARK(BM_Int16ViterbiScore)->ArgsProduct({{100, 1000, 5000}, {12, 18}});
+
+static void BM_ScaledSumProductScore(benchmark::State& state)
+{
+    Rng rng(42);
+    QvEvaluator e = NoisyQvEvaluator(rng, state.range(0));
+    ScaledSumProductRecursor recursor(BASIC_MOVES | MERGE, BandingOptions(4, state.range(1)));
+    int I = e.ReadLength(), J = e.TemplateLength();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(recursor.Score(e));
+    }
+    state.SetItemsProcessed(state.iterations() * int64_t(I + 1) * (J + 1));
+}
+BENCHMARK(BM_ScaledSumProductScore)->ArgsProduct({{100, 1000, 5000}, {12, 18}});
+
+// Arguments: kernel variant (an index into SumProductKernelVariants),
+// template length; eight reads per iteration.  Beside its time, the
+// variant reports its Speedup over the reference recursion and the
+// largest drift of its scores from the reference's, per cell
+// (DriftPerCell) and as a fraction of its budget (DriftOfBudget).
+static void BM_SumProductKernelDrift(benchmark::State& state)
+{
+    KernelVariant variant = SumProductKernelVariants()[state.range(0)];
+    Rng rng(42);
+    std::vector<QvEvaluator> evaluators;
+    for (int n = 0; n < 8; n++) {
+        evaluators.push_back(NoisyQvEvaluator(rng, state.range(1)));
+    }
+    BandingOptions banding(4, 200);
+    SparseSimpleQvSumProductRecursor reference(BASIC_MOVES | MERGE, banding);
+    ScopedKernelVariant scope(variant);
+    RecursorConfig config;
+    config.LogAdd = variant.LogAdd;
+    SparseSseQvSumProductRecursor fast(BASIC_MOVES | MERGE, banding, config);
+
+    std::vector<float> expected;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const QvEvaluator& e : evaluators) {
+        int I = e.ReadLength(), J = e.TemplateLength();
+        SparseMatrix alpha(I + 1, J + 1), beta(I + 1, J + 1);
+        reference.FillAlphaBeta(e, alpha, beta);
+        expected.push_back(beta(0, 0));
+    }
+    double referenceSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double maxDrift = 0;
+    start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        for (size_t n = 0; n < evaluators.size(); n++) {
+            const QvEvaluator& e = evaluators[n];
+            int I = e.ReadLength(), J = e.TemplateLength();
+            SparseMatrix alpha(I + 1, J + 1), beta(I + 1, J + 1);
+            fast.FillAlphaBeta(e, alpha, beta);
+            double drift = std::fabs(beta(0, 0) - expected[n]) / (I + J);
+            maxDrift = std::max(maxDrift, drift);
+        }
+    }
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    state.SetLabel(variant.Name);
+    state.counters["Speedup"] = referenceSeconds * state.iterations() / seconds;
+    state.counters["DriftPerCell"] = maxDrift;
+    state.counters["DriftOfBudget"] = maxDrift / static_cast<double>(variant.CellBudget);
+}
+BENCHMARK(BM_SumProductKernelDrift)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, 3, 1), {100, 1000}});
@@ -0,0 +1,128 @@
+// Author: David Alexander
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Read.hpp>
+
+#include "BenchUtils.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+// Substitutions at random positions of a template of the given length
+template <typename RNG>
+static std::vector<Mutation> RandomMutations(RNG& rng, int tplLength, int count)
+{
+    std::vector<Mutation> mutations;
+    boost::random::uniform_int_distribution<> posDist(0, tplLength - 1);
+    for (int k = 0; k < count; k++) {
+        mutations.push_back(Mutation(SUBSTITUTION, posDist(rng), "ACGT"[k % 4]));
+    }
+    return mutations;
+}
+
+//
+// Arguments: template length, banding ScoreDiff
+//
+static void BM_ScoreMutation(benchmark::State& state)
+{
+    Rng rng(42);
+    QvEvaluator e = NoisyQvEvaluator(rng, state.range(0));
+    SparseSseQvRecursor recursor(ALL_MOVES, BandingOptions(4, state.range(1)));
+    SparseSseQvMutationScorer scorer(e, recursor);
+    std::vector<Mutation> mutations = RandomMutations(rng, e.TemplateLength(), 256);
+
+    size_t k = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scorer.ScoreMutation(mutations[k++ % mutations.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ScoreMutation)->ArgsProduct({{100, 1000, 5000}, {12, 18}});
+
+//
+// Arguments: template length, checkpoint interval.  Mutations are
+// scored in template order, as the batched entry points score them.
+//
+static void BM_CheckpointedScoreMutation(benchmark::State& state)
+{
+    Rng rng(42);
+    QvEvaluator e = NoisyQvEvaluator(rng, state.range(0));
+    SparseSseQvRecursor recursor(ALL_MOVES, BandingOptions(4, 12));
+    SparseSseQvMutationScorer scorer(e, recursor, state.range(1));
+    std::vector<Mutation> mutations = RandomMutations(rng, e.TemplateLength(), 256);
+    std::sort(mutations.begin(), mutations.end());
+
+    size_t k = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scorer.ScoreMutation(mutations[k++ % mutations.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["AlphaEntries"] = scorer.Alpha()->AllocatedEntries();
+}
+BENCHMARK(BM_CheckpointedScoreMutation)->ArgsProduct({{1000}, {0, 4, 16, 64}});
+
+//
+// Arguments: template length, coverage, banding ScoreDiff
+//
+static void BM_MultiReadScore(benchmark::State& state)
+{
+    Rng rng(42);
+    int tplLength = state.range(0);
+    int coverage = state.range(1);
+    QuiverConfigTable configs;
+    configs.InsertDefault(
+        QuiverConfig(TestingParams(), ALL_MOVES, BandingOptions(4, state.range(2)), -500));
+
+    std::string tpl = RandomSequence(rng, tplLength);
+    MultiReadMutationScorer<SparseSseQvRecursor> scorer(configs, tpl);
+    for (int n = 0; n < coverage; n++) {
+        Read read = RandomRead(rng, NoisyCopy(rng, tpl, 0.1));
+        scorer.AddRead(MappedRead(read, FORWARD_STRAND, 0, tplLength));
+    }
+    std::vector<Mutation> mutations = RandomMutations(rng, tplLength, 256);
+
+    size_t k = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scorer.Score(mutations[k++ % mutations.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MultiReadScore)->ArgsProduct({{500}, {5, 20, 50}, {12, 18}});
+
+//
+// Arguments: template length, coverage
+//
+static void BM_MultiReadAddRead(benchmark::State& state)
+{
+    Rng rng(42);
+    int tplLength = state.range(0);
+    int coverage = state.range(1);
+    QuiverConfigTable configs;
+    configs.InsertDefault(QuiverConfig(TestingParams(), ALL_MOVES, BandingOptions(4, 18), -500));
+
+    std::string tpl = RandomSequence(rng, tplLength);
+    std::vector<MappedRead> reads;
+    for (int n = 0; n < coverage; n++) {
+        Read read = RandomRead(rng, NoisyCopy(rng, tpl, 0.1));
+        reads.push_back(MappedRead(read, FORWARD_STRAND, 0, tplLength));
+    }
+
+    for (auto _ : state) {
+        MultiReadMutationScorer<SparseSseQvRecursor> scorer(configs, tpl);
+        for (size_t n = 0; n < reads.size(); n++) {
+            scorer.AddRead(reads[n]);
+        }
+        benchmark::DoNotOptimize(scorer.BaselineScore());
+    }
+    state.SetItemsProcessed(state.iterations() * coverage);
+}
+BENCHMARK(BM_MultiReadAddRead)->ArgsProduct({{500, 2000}, {5, 20}});
@@ -0,0 +1,68 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Read.hpp>
+
+#include "Random.hpp"
+
+//
+// Fixtures shared by the benchmarks
+//
+
+// A copy of tpl with substitutions, insertions and deletions, each at
+// a third of errorRate
+template <typename RNG>
+std::string NoisyCopy(RNG& rng, const std::string& tpl, float errorRate)
+{
+    const char* bases = "ACGT";
+    boost::random::uniform_real_distribution<> errorDist(0, 1);
+    boost::random::uniform_int_distribution<> baseDist(0, 3);
+    std::string read;
+    for (size_t i = 0; i < tpl.length(); i++) {
+        double u = errorDist(rng);
+        if (u < static_cast<double>(errorRate / 3)) {
+            read += bases[baseDist(rng)];
+        } else if (u < static_cast<double>(2 * errorRate / 3)) {
+            read += tpl[i];
+            read += bases[baseDist(rng)];
+        } else if (u >= static_cast<double>(errorRate)) {
+            read += tpl[i];
+        }
+    }
+    return read;
+}
+
+// A read with the given basecalls and random QVs
+template <typename RNG>
+Read RandomRead(RNG& rng, const std::string& seq)
+{
+    int length = seq.length();
+    float* insQv = RandomQvArray(rng, length);
+    float* subsQv = RandomQvArray(rng, length);
+    float* delQv = RandomQvArray(rng, length);
+    float* delTag = RandomTagArray(rng, length);
+    float* mergeQv = RandomQvArray(rng, length);
+    QvSequenceFeatures f(seq, insQv, subsQv, delQv, delTag, mergeQv);
+    delete[] insQv;
+    delete[] subsQv;
+    delete[] delQv;
+    delete[] delTag;
+    delete[] mergeQv;
+    return Read(f, "bench", "unknown");
+}
+
+// An evaluator for a noisy read of a random template
+template <typename RNG>
+QvEvaluator NoisyQvEvaluator(RNG& rng, int tplLength, float errorRate = 0.1)
+{
+    std::string tpl = RandomSequence(rng, tplLength);
+    return QvEvaluator(RandomRead(rng, NoisyCopy(rng, tpl, errorRate)), tpl, TestingParams());
+}
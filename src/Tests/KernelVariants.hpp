@@ -0,0 +1,57 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <vector>
+
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+
+//
+// The fast configurations of the sum-product recursion, as checked
+// against the exact one by TestKernelDifferential and timed against it
+// by the quiver_bench drift benchmarks
+//
+
+struct KernelVariant
+{
+    const char* Name;
+    ConsensusCore::LogAddMode LogAdd;
+    // The cap on SimdWidth the variant's recursors are built under
+    int MaxSimdWidth;
+    // How far its scores may drift from those of the reference
+    // recursion, per cell of the path through the matrix (a read of I
+    // bases against a template of J runs through about I + J cells)
+    float CellBudget;
+};
+
+// The reference, SparseSimpleQvSumProductRecursor, adds exactly and
+// one cell at a time; the SSE, AVX2 and AVX-512 kernels add exactly in
+// another order, and the table and polynomial log1p(exp(x)) within
+// their own bounds of the exact sum
+inline std::vector<KernelVariant> SumProductKernelVariants()
+{
+    using namespace ConsensusCore;  // NOLINT
+    std::vector<KernelVariant> variants;
+    KernelVariant sse = {"sse", EXACT_LOGADD, 4, 1e-5f};
+    KernelVariant widest = {"widest", EXACT_LOGADD, 16, 1e-5f};
+    KernelVariant table = {"table-logadd", TABLE_LOGADD, 16, 4 * LOG1P_EXP_TABLE_MAX_ERROR};
+    KernelVariant poly = {"polynomial-logadd", POLYNOMIAL_LOGADD, 16,
+                          4 * LOG1P_EXP_POLYNOMIAL_MAX_ERROR};
+    variants.push_back(sse);
+    variants.push_back(widest);
+    variants.push_back(table);
+    variants.push_back(poly);
+    return variants;
+}
+
+// Builds recursors, and scorers, of a variant for as long as it lives
+class ScopedKernelVariant
+{
+public:
+    explicit ScopedKernelVariant(const KernelVariant& variant)
+    {
+        ConsensusCore::SetMaxSimdWidth(variant.MaxSimdWidth);
+    }
+    ~ScopedKernelVariant() { ConsensusCore::SetMaxSimdWidth(16); }
+};
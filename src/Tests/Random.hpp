@@ -7,6 +7,7 @@
 #include <boost/random/poisson_distribution.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
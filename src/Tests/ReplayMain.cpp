@@ -0,0 +1,60 @@
+// Author: David Alexander
+
+//
+// Replay captures of Quiver workloads (see Capture.hpp), timing them
+// and checking their results; exits nonzero if any result differs.
+// Built with -Dperf_stats=true, it also reports the per-phase counters.
+//
+//   quiver_replay capture.bin [capture.bin ...]
+//
+
+#include <cstdio>
+#include <string>
+
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/Quiver/Capture.hpp>
+#include <ConsensusCore/Types.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s capture.bin [capture.bin ...]\n", argv[0]);
+        return 2;
+    }
+
+    int mismatches = 0;
+    for (int i = 1; i < argc; i++) {
+        ResetPerfStats();
+        ReplayReport report;
+        try {
+            report = ReplayCapture(argv[i]);
+        } catch (const ErrorBase& e) {
+            std::fprintf(stderr, "%s: %s\n", argv[i], e.Message().c_str());
+            return 2;
+        }
+        mismatches += report.Mismatches;
+
+        std::printf("%s\n", argv[i]);
+        std::printf("  %d scorers, %d reads, %d refines, %d QV calls\n", report.Scorers,
+                    report.Reads, report.Refines, report.QvCalls);
+        std::printf("  add %.3fs  refine %.3fs  QVs %.3fs\n", report.AddSeconds,
+                    report.RefineSeconds, report.QvSeconds);
+        PerfStats stats = CollectPerfStats();
+        if (stats.Enabled) {
+            for (size_t p = 0; p < stats.Phases.size(); p++) {
+                const PhaseStats& phase = stats.Phases[p];
+                if (phase.Calls == 0) continue;
+                std::printf("  %-20s %12lld calls %14lld cells %10.3fs\n", phase.Phase.c_str(),
+                            static_cast<long long>(phase.Calls),
+                            static_cast<long long>(phase.Cells), phase.Seconds);
+            }
+        }
+        if (report.Mismatches > 0) {
+            std::printf("  %d results differ; first: %s\n", report.Mismatches,
+                        report.FirstMismatch.c_str());
+        }
+    }
+    return mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+// Author: David Alexander
+
+//
+// End-to-end scaling benchmark: windows of noisy reads go through the
+// ConsensusPipeline (POA, Quiver refinement, consensus QVs) over a grid
+// of coverage, template length and workers per pipeline stage, and the
+// throughput, peak RSS and parallel efficiency of each point are
+// reported.  Unlike quiver_bench, which times the kernels one at a
+// time, this is for sizing jobs and catching regressions in scaling.
+//
+//   quiver_scaling [--coverage 10,100] [--length 500,5000]
+//                  [--threads 1,2,4] [--windows 8] [--json out.json]
+//
+// Parallel efficiency is the speedup over the fewest threads of the
+// grid, divided by the ratio of the thread counts.  The stages overlap,
+// so a point with t threads runs up to 3t workers, of which refinement
+// is by far the busiest.  Peak RSS includes the reads generated for
+// the point, and is per point only where /proc/self/clear_refs can
+// reset it; elsewhere it is the peak of the run so far.
+//
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ConsensusCore/Quiver/ConsensusPipeline.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "BenchUtils.hpp"
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+// Windows are submitted round-robin from at most this many distinct
+// ones, bounding the memory spent on reads at high coverage
+const int MAX_DISTINCT_WINDOWS = 4;
+
+struct ScalingPoint
+{
+    int Coverage;
+    int Length;
+    int Threads;
+    int Windows;
+    int Failed;
+    double Seconds;
+    double BasesPerSecond;
+    double WindowsPerSecond;
+    double PeakRssMB;
+    double Efficiency;
+};
+
+std::vector<int> ParseList(const std::string& arg)
+{
+    std::vector<int> values;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int value = std::atoi(item.c_str());
+        if (value <= 0) throw InvalidInputError("Expected a list of positive integers: " + arg);
+        values.push_back(value);
+    }
+    if (values.empty()) throw InvalidInputError("Expected a list of positive integers: " + arg);
+    return values;
+}
+
+// Start tracking the peak RSS afresh, where the kernel allows
+void ResetPeakRss()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs) clearRefs << "5";
+}
+
+double PeakRssMB()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::atof(line.c_str() + 6) / 1024;
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+// Noisy full-length reads of a random template, half of them reversed
+ConsensusWindow NoisyWindow(Rng& rng, int id, int length, int coverage)
+{
+    std::string tpl = RandomSequence(rng, length);
+    ConsensusWindow window(id);
+    for (int k = 0; k < coverage; k++) {
+        std::string seq = NoisyCopy(rng, tpl, 0.1);
+        if (k % 2 == 1) {
+            window.AddRead(RandomRead(rng, ReverseComplement(seq)), REVERSE_STRAND);
+        } else {
+            window.AddRead(RandomRead(rng, seq), FORWARD_STRAND);
+        }
+    }
+    return window;
+}
+
+// Run numWindows windows, drawn from those given, through a pipeline
+// with the given workers per stage
+ScalingPoint RunPoint(const QuiverConfigTable& configs, const std::vector<ConsensusWindow>& windows,
+                      int numWindows, int threads)
+{
+    ConsensusPipelineOptions options = DefaultConsensusPipelineOptions;
+    options.PoaWorkers = threads;
+    options.RefineWorkers = threads;
+    options.QvWorkers = threads;
+    options.QueueCapacity = std::max(4, threads);
+
+    ScalingPoint point = ScalingPoint();
+    point.Threads = threads;
+    point.Windows = numWindows;
+    long long bases = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        ConsensusPipeline pipeline(configs, options);
+        std::thread feeder([&] {
+            for (int id = 0; id < numWindows; id++) {
+                ConsensusWindow window = windows[id % windows.size()];
+                window.Id = id;
+                pipeline.Submit(window);
+            }
+            pipeline.Close();
+        });
+        ConsensusResult result;
+        while (pipeline.Next(&result)) {
+            if (!result.Error.empty()) point.Failed++;
+            bases += result.Sequence.length();
+        }
+        feeder.join();
+    }
+    point.Seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    point.BasesPerSecond = bases / point.Seconds;
+    point.WindowsPerSecond = numWindows / point.Seconds;
+    return point;
+}
+
+void WriteJson(const std::string& filename, const std::vector<ScalingPoint>& points)
+{
+    std::ofstream out(filename.c_str());
+    if (!out) throw InvalidInputError("Can't create " + filename);
+    out << "{\"points\": [";
+    for (size_t i = 0; i < points.size(); i++) {
+        const ScalingPoint& p = points[i];
+        out << (i == 0 ? "\n" : ",\n") << "  {\"coverage\": " << p.Coverage
+            << ", \"length\": " << p.Length << ", \"threads\": " << p.Threads
+            << ", \"windows\": " << p.Windows << ", \"failed\": " << p.Failed
+            << ", \"seconds\": " << p.Seconds << ", \"bases_per_second\": " << p.BasesPerSecond
+            << ", \"windows_per_second\": " << p.WindowsPerSecond
+            << ", \"peak_rss_mb\": " << p.PeakRssMB << ", \"efficiency\": " << p.Efficiency
+            << "}";
+    }
+    out << "\n]}\n";
+}
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<int> coverages(1, 10);
+    coverages.push_back(100);
+    std::vector<int> lengths(1, 500);
+    lengths.push_back(5000);
+    std::vector<int> threadCounts(1, 1);
+    threadCounts.push_back(2);
+    threadCounts.push_back(4);
+    int numWindows = 8;
+    std::string json;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            std::string value;
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                value = arg.substr(eq + 1);
+                arg = arg.substr(0, eq);
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            } else {
+                throw InvalidInputError("No value given for " + arg);
+            }
+
+            if (arg == "--coverage") {
+                coverages = ParseList(value);
+            } else if (arg == "--length") {
+                lengths = ParseList(value);
+            } else if (arg == "--threads") {
+                threadCounts = ParseList(value);
+            } else if (arg == "--windows") {
+                numWindows = ParseList(value).front();
+            } else if (arg == "--json") {
+                json = value;
+            } else {
+                throw InvalidInputError("Unknown option " + arg);
+            }
+        }
+    } catch (const ErrorBase& e) {
+        std::fprintf(stderr, "%s\n", e.Message().c_str());
+        std::fprintf(stderr,
+                     "usage: %s [--coverage 10,100] [--length 500,5000] [--threads 1,2,4]\n"
+                     "       [--windows 8] [--json out.json]\n",
+                     argv[0]);
+        return 2;
+    }
+    std::sort(threadCounts.begin(), threadCounts.end());
+
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+
+    std::vector<ScalingPoint> points;
+    std::printf("%8s %8s %7s %7s %6s %9s %12s %10s %10s %6s\n", "coverage", "length", "threads",
+                "windows", "failed", "seconds", "bases/s", "windows/s", "peak MB", "eff");
+    foreach (int length, lengths) {
+        foreach (int coverage, coverages) {
+            Rng rng(42);
+            std::vector<ConsensusWindow> windows;
+            for (int id = 0; id < std::min(numWindows, MAX_DISTINCT_WINDOWS); id++) {
+                windows.push_back(NoisyWindow(rng, id, length, coverage));
+            }
+
+            double baseRate = 0;
+            foreach (int threads, threadCounts) {
+                ResetPeakRss();
+                ScalingPoint p = RunPoint(configs, windows, numWindows, threads);
+                p.Coverage = coverage;
+                p.Length = length;
+                p.PeakRssMB = PeakRssMB();
+                if (baseRate == 0) baseRate = p.WindowsPerSecond / threads;
+                p.Efficiency = p.WindowsPerSecond / threads / baseRate;
+                points.push_back(p);
+
+                std::printf("%8d %8d %7d %7d %6d %9.3f %12.0f %10.3f %10.1f %6.2f\n", p.Coverage,
+                            p.Length, p.Threads, p.Windows, p.Failed, p.Seconds,
+                            p.BasesPerSecond, p.WindowsPerSecond, p.PeakRssMB, p.Efficiency);
+                std::fflush(stdout);
+            }
+        }
+    }
+
+    if (!json.empty()) {
+        try {
+            WriteJson(json, points);
+        } catch (const ErrorBase& e) {
+            std::fprintf(stderr, "%s\n", e.Message().c_str());
+            return 2;
+        }
+    }
+    return 0;
+}
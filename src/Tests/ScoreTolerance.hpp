@@ -0,0 +1,30 @@
+// Author: David Alexander
+
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+// Scores computed from sparse matrices whose entries are stored as half
+// floats (CONSENSUSCORE_HALF_MATRICES) are rounded, so they agree with
+// those of the full-precision recursion only to within about 2^-8 of
+// their magnitude.  Otherwise they agree as floats do.
+#ifdef CONSENSUSCORE_HALF_MATRICES
+inline float ScoreTolerance(float expected, float tolerance)
+{
+    return tolerance + std::fabs(expected) / 256;
+}
+#else
+inline float ScoreTolerance(float, float tolerance) { return tolerance; }
+#endif
+
+#ifdef CONSENSUSCORE_HALF_MATRICES
+#define EXPECT_SCORE_EQ(expected, actual) \
+    EXPECT_NEAR(expected, actual, ScoreTolerance(expected, 1e-3f))
+#define ASSERT_SCORE_EQ(expected, actual) \
+    ASSERT_NEAR(expected, actual, ScoreTolerance(expected, 1e-3f))
+#else
+#define EXPECT_SCORE_EQ(expected, actual) EXPECT_FLOAT_EQ(expected, actual)
+#define ASSERT_SCORE_EQ(expected, actual) ASSERT_FLOAT_EQ(expected, actual)
+#endif
@@ -0,0 +1,137 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/Autotune.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+const char* const AUTOTUNE_FILE = "/tmp/ConsensusCoreTestAutotune.txt";
+
+QuiverConfigTable TestingConfigs()
+{
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    configs.Insert(TestingConfig("A"));
+    return configs;
+}
+
+// Reads of a template, with an error apiece, of chemistries "A" and
+// "B", which has no config of its own
+std::vector<AutotuneSample> TestingSamples()
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    AutotuneSample sample(tpl);
+    for (int i = 0; i < 6; i++) {
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        int start = i, end = tpl.length() - i;
+        std::string seq = tpl.substr(start, end - start);
+        seq[(i * 7) % seq.length()] = 'T';
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        Read read(QvSequenceFeatures(seq), "read", (i < 4) ? "A" : "B");
+        sample.Reads.push_back(MappedRead(read, strand, start, end));
+    }
+    return std::vector<AutotuneSample>(1, sample);
+}
+}
+
+TEST(AutotuneTest, ChoicesKeepScoresWithinTolerance)
+{
+    AutotuneOptions options;
+    options.Repeats = 1;
+    std::vector<AutotuneChoice> choices = Autotune(TestingConfigs(), TestingSamples(), options);
+
+    // One per entry the reads are taken as, in the table's order
+    ASSERT_EQ(2, choices.size());
+    EXPECT_EQ("A", choices[0].Chemistry);
+    EXPECT_EQ("*", choices[1].Chemistry);
+    foreach (const AutotuneChoice& choice, choices) {
+        EXPECT_TRUE(choice.Tuned);
+        EXPECT_LE(choice.ScoreDrift, options.ScoreTolerance);
+        EXPECT_LE(choice.FlipFlopRate, options.MaxFlipFlopRate);
+        EXPECT_GT(choice.CellsPerSecond, 0);
+        EXPECT_NE(options.ScoreDiffs.end(), std::find(options.ScoreDiffs.begin(),
+                                                      options.ScoreDiffs.end(), choice.ScoreDiff));
+    }
+
+    // A tolerance nothing meets leaves the config as it was
+    options.ScoreTolerance = -1;
+    choices = Autotune(TestingConfigs(), TestingSamples(), options);
+    ASSERT_EQ(2, choices.size());
+    EXPECT_FALSE(choices[0].Tuned);
+    EXPECT_EQ(TestingConfig().Banding.ScoreDiff, choices[0].ScoreDiff);
+}
+
+TEST(AutotuneTest, ApplyingSetsTheBands)
+{
+    AutotuneChoice choice;
+    choice.Chemistry = "A";
+    choice.Tuned = true;
+    choice.ScoreDiff = 14;
+    QuiverConfigTable tuned =
+        ApplyAutotune(TestingConfigs(), std::vector<AutotuneChoice>(1, choice));
+    EXPECT_EQ(TestingConfigs().Keys(), tuned.Keys());
+    EXPECT_EQ(14, tuned.At("A").Banding.ScoreDiff);
+    EXPECT_EQ(TestingConfig().Banding.ScoreDiff, tuned.At("*").Banding.ScoreDiff);
+    EXPECT_EQ(TestingConfig().MovesAvailable, tuned.At("A").MovesAvailable);
+}
+
+TEST(AutotuneTest, CachedChoicesAreReusedWhileFresh)
+{
+    std::remove(AUTOTUNE_FILE);
+    AutotuneOptions options;
+    options.Repeats = 1;
+    QuiverConfigTable configs = TestingConfigs();
+    EXPECT_TRUE(LoadAutotuneChoices(AUTOTUNE_FILE, configs, options).empty());
+
+    std::vector<AutotuneChoice> tuned =
+        AutotuneCached(AUTOTUNE_FILE, configs, TestingSamples(), options);
+    std::vector<AutotuneChoice> cached =
+        AutotuneCached(AUTOTUNE_FILE, configs, TestingSamples(), options);
+    ASSERT_EQ(tuned.size(), cached.size());
+    for (size_t i = 0; i < tuned.size(); i++) {
+        EXPECT_EQ(tuned[i].Chemistry, cached[i].Chemistry);
+        EXPECT_EQ(tuned[i].Fingerprint, cached[i].Fingerprint);
+        EXPECT_EQ(tuned[i].Recursor, cached[i].Recursor);
+        EXPECT_EQ(tuned[i].ScoreDiff, cached[i].ScoreDiff);
+        // measured once, so timings match too
+        EXPECT_FLOAT_EQ(tuned[i].CellsPerSecond, cached[i].CellsPerSecond);
+    }
+
+    // Other options, or another model, make them stale
+    AutotuneOptions looser(options);
+    looser.ScoreTolerance = 1;
+    EXPECT_TRUE(LoadAutotuneChoices(AUTOTUNE_FILE, configs, looser).empty());
+    QuiverConfig retrained = TestingConfig("A");
+    retrained.QvParams.Mismatch = -11;
+    QuiverConfigTable retrainedConfigs;
+    retrainedConfigs.InsertDefault(TestingConfig());
+    retrainedConfigs.Insert(retrained);
+    std::vector<AutotuneChoice> fresh =
+        LoadAutotuneChoices(AUTOTUNE_FILE, retrainedConfigs, options);
+    ASSERT_EQ(1, fresh.size());
+    EXPECT_EQ("*", fresh[0].Chemistry);
+
+    // as does a file of another kind
+    {
+        std::ofstream out(AUTOTUNE_FILE);
+        out << "something else\n";
+    }
+    EXPECT_TRUE(LoadAutotuneChoices(AUTOTUNE_FILE, configs, options).empty());
+    std::remove(AUTOTUNE_FILE);
+}
@@ -0,0 +1,77 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <ConsensusCore/Statistics/Binomial.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+TEST(BinomialTest, BatchMatchesBinomialSurvival)
+{
+    std::vector<int> q, size;
+    std::vector<double> prob;
+    const int sizes[] = {0, 1, 7, 30, 1000, 20000, 100000};
+    const double probs[] = {0.0, 0.001, 0.05, 0.5, 0.97, 1.0};
+    foreach (int s, sizes) {
+        foreach (double p, probs) {
+            const int qs[] = {-1, 0, 1, s / 20, s / 2, s - 2, s - 1, s};
+            foreach (int k, qs) {
+                if (k > s) continue;
+                q.push_back(k);
+                size.push_back(s);
+                prob.push_back(p);
+            }
+        }
+    }
+
+    for (int asPhred = 0; asPhred < 2; asPhred++) {
+        double* survival;
+        int n;
+        BinomialSurvivalBatch(q.size(), &q[0], size.size(), &size[0], prob.size(), &prob[0],
+                              &survival, &n, asPhred, 3);
+        ASSERT_EQ(static_cast<int>(q.size()), n);
+        for (int i = 0; i < n; i++) {
+            double expected = BinomialSurvival(q[i], size[i], prob[i], asPhred);
+            if (asPhred && std::isinf(expected)) {
+                // underflowed in BinomialSurvival, but not in log space
+                EXPECT_GT(survival[i], 2900) << q[i] << " " << size[i] << " " << prob[i];
+            } else if (expected < 1e-300) {
+                EXPECT_LT(survival[i], 1e-290) << q[i] << " " << size[i] << " " << prob[i];
+            } else {
+                EXPECT_NEAR(expected, survival[i], 1e-9 * std::fabs(expected) + 1e-12)
+                    << q[i] << " " << size[i] << " " << prob[i];
+            }
+        }
+        std::free(survival);
+    }
+}
+
+TEST(BinomialTest, BatchBeyondSize)
+{
+    int q[] = {10, 12}, size[] = {10, 10};
+    double prob[] = {0.5, 0.5};
+    double* survival;
+    int n;
+    BinomialSurvivalBatch(2, q, 2, size, 2, prob, &survival, &n);
+    EXPECT_EQ(0.0, survival[0]);
+    EXPECT_EQ(0.0, survival[1]);
+    std::free(survival);
+}
+
+TEST(BinomialTest, BatchRejectsInvalidSites)
+{
+    int q[] = {1, 2}, size[] = {10, 10};
+    double prob[] = {0.5, 1.5};
+    double* survival;
+    int n;
+    EXPECT_THROW(BinomialSurvivalBatch(2, q, 2, size, 2, prob, &survival, &n),
+                 InvalidInputError);
+    EXPECT_THROW(BinomialSurvivalBatch(2, q, 1, size, 2, prob, &survival, &n),
+                 InvalidInputError);
+}
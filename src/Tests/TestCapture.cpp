@@ -0,0 +1,82 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/Capture.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+#include <ConsensusCore/Quiver/WorkUnit.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+const char* const CAPTURE_FILE = "/tmp/ConsensusCoreTestCapture.bin";
+
+WorkUnit TestUnit(int id)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    std::string draft = truth.substr(0, 20) + truth.substr(21);
+    WorkUnit unit(id, draft);
+    for (int i = 0; i < 6; i++) {
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        std::string seq = (strand == FORWARD_STRAND) ? truth : ReverseComplement(truth);
+        unit.Reads.push_back(
+            MappedRead(Read(QvSequenceFeatures(seq), "read", "test"), strand, 0, draft.length()));
+    }
+    return unit;
+}
+}
+
+TEST(CaptureTest, ReplaysWhatWasCaptured)
+{
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    SparseSseQvMultiReadMutationScorer before(configs, "GATTACA");
+
+    StartCapture(CAPTURE_FILE);
+    EXPECT_THROW(StartCapture(CAPTURE_FILE), InvalidInputError);
+    // Not captured, as it was made before the capture started
+    before.AddRead(
+        MappedRead(Read(QvSequenceFeatures("GATTACA"), "read", "test"), FORWARD_STRAND, 0, 7));
+
+    EXPECT_EQ("", RefineWorkUnit(configs, TestUnit(1)).Error);
+    {
+        WorkUnit unit = TestUnit(2);
+        SparseSseQvMultiReadMutationScorer mms(configs, unit.Template);
+        mms.SetCoverageCap(4);
+        mms.AddReads(unit.Reads);
+        mms.ApplyMutations(std::vector<Mutation>(1, Mutation(INSERTION, 20, 'C')));
+        RefineConsensus(mms);
+        ConsensusQVs(mms, 10, 30);
+    }
+    StopCapture();
+    EXPECT_THROW(StopCapture(), InvalidInputError);
+
+    ReplayReport report = ReplayCapture(CAPTURE_FILE);
+    EXPECT_EQ(2, report.Scorers);
+    EXPECT_EQ(12, report.Reads);
+    EXPECT_EQ(2, report.Refines);
+    EXPECT_EQ(2, report.QvCalls);
+    EXPECT_EQ(0, report.Mismatches) << report.FirstMismatch;
+
+    // A truncated capture is caught
+    std::ifstream in(CAPTURE_FILE, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream out(CAPTURE_FILE, std::ios::binary);
+    out.write(bytes.data(), bytes.size() - 12);
+    out.close();
+    EXPECT_THROW(ReplayCapture(CAPTURE_FILE), InvalidInputError);
+    std::remove(CAPTURE_FILE);
+}
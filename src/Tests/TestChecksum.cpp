@@ -0,0 +1,59 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Checksum.hpp>
+#include <ConsensusCore/Features.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+TEST(ChecksumTest, Crc32cCheckValue)
+{
+    // The standard check value of CRC-32C
+    std::string check = "123456789";
+    EXPECT_EQ(0xe3069283u, Checksum::Crc32c(check.data(), check.length()));
+    EXPECT_EQ(0u, Checksum::Crc32c(check.data(), 0));
+
+    // Continuing over the bytes in pieces
+    uint32_t crc = Checksum::Crc32c(check.data(), 4);
+    EXPECT_EQ(0xe3069283u, Checksum::Crc32c(check.data() + 4, 5, crc));
+}
+
+TEST(ChecksumTest, Sse42MatchesSoftware)
+{
+    if (!__builtin_cpu_supports("sse4.2")) return;
+    std::vector<unsigned char> bytes(1031);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = static_cast<unsigned char>(i * 131 + 7);
+    }
+    // Every length and alignment about the word sizes
+    for (size_t begin = 0; begin < 9; begin++) {
+        for (size_t length = 0; begin + length <= bytes.size(); length += 1 + length / 4) {
+            ASSERT_EQ(detail::Crc32cSoftware(~0u, &bytes[begin], length),
+                      detail::Crc32cSse42(~0u, &bytes[begin], length));
+        }
+    }
+}
+
+TEST(ChecksumTest, FeaturesChecksumCoversEveryTrack)
+{
+    std::string seq = "GATTACA";
+    std::vector<float> qvs(seq.length(), 20.0f);
+    std::vector<float> tags(seq.length(), 'N');
+    QvSequenceFeatures f(seq, &qvs[0], &qvs[0], &qvs[0], &tags[0], &qvs[0]);
+    QvSequenceFeatures same(seq, &qvs[0], &qvs[0], &qvs[0], &tags[0], &qvs[0]);
+    EXPECT_EQ(Checksum::Crc32c(f), Checksum::Crc32c(same));
+    EXPECT_EQ(Checksum::Of(f), Checksum::Of(same));
+
+    std::vector<float> other(qvs);
+    other[3] = 21.0f;
+    QvSequenceFeatures otherMergeQv(seq, &qvs[0], &qvs[0], &qvs[0], &tags[0], &other[0]);
+    QvSequenceFeatures otherSeq("GATTACT", &qvs[0], &qvs[0], &qvs[0], &tags[0], &qvs[0]);
+    EXPECT_NE(Checksum::Crc32c(f), Checksum::Crc32c(otherMergeQv));
+    EXPECT_NE(Checksum::Crc32c(f), Checksum::Crc32c(otherSeq));
+}
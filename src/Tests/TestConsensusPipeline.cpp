@@ -0,0 +1,166 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/ConsensusPipeline.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+const std::string TPL = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGATCCAAGTTCAGGTTACACATGATTAC";
+
+QuiverConfigTable TestingConfigs()
+{
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    return configs;
+}
+
+Read TestingRead(const std::string& seq) { return Read(QvSequenceFeatures(seq), "read", "test"); }
+
+// Reads of TPL with an error apiece, alternating strands
+ConsensusWindow ErroredWindow(int id)
+{
+    ConsensusWindow window(id);
+    for (int k = 0; k < 8; k++) {
+        std::string seq = TPL;
+        int pos = 5 + 7 * k;
+        if (k % 2 == 0) {
+            seq.erase(pos, 1);
+        } else {
+            seq.insert(pos, 1, 'T');
+        }
+        if (k % 3 == 1) {
+            window.AddRead(TestingRead(ReverseComplement(seq)), REVERSE_STRAND);
+        } else {
+            window.AddRead(TestingRead(seq), FORWARD_STRAND);
+        }
+    }
+    return window;
+}
+}
+
+TEST(ConsensusPipelineTest, StreamsTheConsensusOfEachWindow)
+{
+    ConsensusPipelineOptions options = DefaultConsensusPipelineOptions;
+    options.PoaWorkers = 2;
+    options.RefineWorkers = 3;
+    options.QvWorkers = 2;
+    options.QueueCapacity = 1;
+    ConsensusPipeline pipeline(TestingConfigs(), options);
+
+    const int numWindows = 12;
+    std::thread feeder([&] {
+        for (int id = 0; id < numWindows; id++) {
+            pipeline.Submit(ErroredWindow(id));
+        }
+        pipeline.Close();
+    });
+
+    std::set<int> ids;
+    ConsensusResult result;
+    while (pipeline.Next(&result)) {
+        EXPECT_EQ("", result.Error);
+        EXPECT_EQ(TPL, result.Sequence);
+        EXPECT_EQ(TPL.length(), result.QVs.size());
+        EXPECT_EQ(8, result.NumReads);
+        ids.insert(result.Id);
+    }
+    feeder.join();
+    EXPECT_EQ(numWindows, static_cast<int>(ids.size()));
+    EXPECT_THROW(pipeline.Submit(ErroredWindow(numWindows)), InvalidInputError);
+}
+
+TEST(ConsensusPipelineTest, HibernatingScorersGiveTheSameConsensus)
+{
+    // Any bytes held count as pressure, so every queued scorer sleeps
+    ConsensusPipelineOptions options = DefaultConsensusPipelineOptions;
+    options.HibernateAboveBytes = 1;
+    ConsensusPipeline pipeline(TestingConfigs(), options);
+    ConsensusPipeline plain(TestingConfigs());
+    pipeline.Submit(ErroredWindow(1));
+    plain.Submit(ErroredWindow(1));
+    pipeline.Close();
+    plain.Close();
+
+    ConsensusResult result, plainResult;
+    ASSERT_TRUE(pipeline.Next(&result));
+    ASSERT_TRUE(plain.Next(&plainResult));
+    EXPECT_EQ("", result.Error);
+    EXPECT_EQ(TPL, result.Sequence);
+    EXPECT_EQ(plainResult.QVs, result.QVs);
+    EXPECT_FALSE(pipeline.Next(&result));
+}
+
+TEST(ConsensusPipelineTest, PinnedWorkersKeepWindowsToTheirNode)
+{
+    ConsensusPipelineOptions options = DefaultConsensusPipelineOptions;
+    options.PoaWorkers = 2;
+    options.RefineWorkers = 2;
+    options.QvWorkers = 2;
+    options.PinToNumaNodes = true;
+    ConsensusPipeline pipeline(TestingConfigs(), options);
+
+    const int numWindows = 6;
+    std::thread feeder([&] {
+        for (int id = 0; id < numWindows; id++) {
+            pipeline.Submit(ErroredWindow(id));
+        }
+        pipeline.Close();
+    });
+    std::set<int> ids;
+    ConsensusResult result;
+    while (pipeline.Next(&result)) {
+        EXPECT_EQ(TPL, result.Sequence);
+        ids.insert(result.Id);
+    }
+    feeder.join();
+    EXPECT_EQ(numWindows, static_cast<int>(ids.size()));
+}
+
+TEST(ConsensusPipelineTest, FailedWindowsCarryTheirError)
+{
+    ConsensusPipeline pipeline(TestingConfigs());
+    pipeline.Submit(ConsensusWindow(1));
+    pipeline.Submit(ErroredWindow(2));
+    pipeline.Close();
+
+    std::vector<ConsensusResult> results(3);
+    EXPECT_TRUE(pipeline.Next(&results[0]));
+    EXPECT_TRUE(pipeline.Next(&results[1]));
+    EXPECT_FALSE(pipeline.Next(&results[2]));
+    foreach (const ConsensusResult& r, results) {
+        if (r.Id == 1) {
+            EXPECT_NE("", r.Error);
+            EXPECT_EQ("", r.Sequence);
+        } else if (r.Id == 2) {
+            EXPECT_EQ(TPL, r.Sequence);
+        }
+    }
+}
+
+TEST(ConsensusPipelineTest, AbandonsWindowsInFlight)
+{
+    ConsensusPipelineOptions options = DefaultConsensusPipelineOptions;
+    options.QueueCapacity = 1;
+    ConsensusPipeline* pipeline = new ConsensusPipeline(TestingConfigs(), options);
+    for (int id = 0; id < 3; id++) {
+        pipeline->Submit(ErroredWindow(id));
+    }
+    delete pipeline;
+
+    options.QvWorkers = 0;
+    EXPECT_THROW(ConsensusPipeline(TestingConfigs(), options), InvalidInputError);
+}
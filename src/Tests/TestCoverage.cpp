@@ -3,6 +3,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
 #include <ConsensusCore/Coverage.hpp>
 #include <ConsensusCore/Interval.hpp>
 
@@ -59,3 +64,86 @@ TEST(CoverageTests, CoveredIntervalsTest2)
     int tEnd[] = {50687};
     ASSERT_THAT(CoveredIntervals(1, 1, tStart, 1, tEnd, 50000, 500), ElementsAre(t(50000, 50500)));
 }
+
+TEST(CoverageTests, CoveredIntervalsMatchCoverage)
+{
+    // Many overlapping reads, in sorted and shuffled order, against the
+    // coverage counted base by base
+    const int nReads = 300;
+    std::vector<std::pair<int, int> > reads;
+    for (int read = 0; read < nReads; read++) {
+        int start = (read * 37) % 997 + read;
+        reads.push_back(std::make_pair(start, start + 1 + (read * 53) % 211));
+    }
+    int shuffledStart[nReads], shuffledEnd[nReads];
+    for (int read = 0; read < nReads; read++) {
+        shuffledStart[read] = reads[read].first;
+        shuffledEnd[read] = reads[read].second;
+    }
+    std::sort(reads.begin(), reads.end());
+    int tStart[nReads], tEnd[nReads];
+    for (int read = 0; read < nReads; read++) {
+        tStart[read] = reads[read].first;
+        tEnd[read] = reads[read].second;
+    }
+
+    const int winStart = 50, winLen = 1203;
+    std::vector<int> coverage(winLen);
+    CoverageInWindow(nReads, shuffledStart, nReads, shuffledEnd, winStart, winLen, &coverage[0]);
+    for (int pos = winStart; pos < winStart + winLen; pos++) {
+        int expected = 0;
+        for (int read = 0; read < nReads; read++) {
+            expected += (shuffledStart[read] <= pos && pos < shuffledEnd[read]);
+        }
+        ASSERT_EQ(expected, coverage[pos - winStart]) << pos;
+    }
+
+    for (int minCoverage = 0; minCoverage < 30; minCoverage += 3) {
+        std::vector<Interval> expected;
+        for (int pos = winStart; pos < winStart + winLen; pos++) {
+            if (coverage[pos - winStart] < minCoverage) continue;
+            if (!expected.empty() && expected.back().End == pos) {
+                expected.back().End++;
+            } else {
+                expected.push_back(Interval(pos, pos + 1));
+            }
+        }
+        EXPECT_EQ(expected, CoveredIntervals(minCoverage, nReads, tStart, nReads, tEnd, winStart,
+                                             winLen));
+        EXPECT_EQ(expected, CoveredIntervals(minCoverage, nReads, shuffledStart, nReads,
+                                             shuffledEnd, winStart, winLen));
+    }
+}
+
+TEST(CoverageTests, CoverageIndexMatchesCoveredIntervals)
+{
+    const int nReads = 200;
+    int tStart[nReads], tEnd[nReads];
+    for (int read = 0; read < nReads; read++) {
+        tStart[read] = (read * 41) % 1500;
+        tEnd[read] = tStart[read] + (read * 29) % 300;
+    }
+    CoverageIndex index(nReads, tStart, nReads, tEnd);
+
+    std::vector<Interval> windows;
+    for (int winStart = 0; winStart < 2000; winStart += 170) {
+        windows.push_back(Interval(winStart, winStart + 250));
+    }
+    std::vector<std::vector<Interval> > intervals = index.CoveredIntervals(4, windows, 3);
+    std::vector<CoverageSummary> summaries = index.Summaries(windows, 3);
+    ASSERT_EQ(windows.size(), intervals.size());
+    ASSERT_EQ(windows.size(), summaries.size());
+    for (size_t w = 0; w < windows.size(); w++) {
+        int winStart = windows[w].Begin, winLen = windows[w].End - windows[w].Begin;
+        EXPECT_EQ(CoveredIntervals(4, nReads, tStart, nReads, tEnd, winStart, winLen),
+                  intervals[w]);
+
+        std::vector<int> coverage(winLen);
+        CoverageInWindow(nReads, tStart, nReads, tEnd, winStart, winLen, &coverage[0]);
+        EXPECT_EQ(coverage[0], index.Coverage(winStart));
+        EXPECT_EQ(*std::min_element(coverage.begin(), coverage.end()), summaries[w].MinCoverage);
+        EXPECT_EQ(*std::max_element(coverage.begin(), coverage.end()), summaries[w].MaxCoverage);
+        float total = std::accumulate(coverage.begin(), coverage.end(), 0);
+        EXPECT_FLOAT_EQ(total / winLen, summaries[w].MeanCoverage);
+    }
+}
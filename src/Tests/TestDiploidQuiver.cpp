@@ -4,8 +4,10 @@
 #include <gtest/gtest.h>
 
 #include <utility>
+#include <vector>
 
 #include <ConsensusCore/Quiver/Diploid.hpp>
+#include <ConsensusCore/Types.hpp>
 
 using namespace ConsensusCore;  // NOLINT
 using std::pair;
@@ -19,3 +21,69 @@ using std::pair;
 //                              10, 11, 12 };
 //     DiploidSite* ds = IsSiteHeterozygous(siteScores, dim1, dim2, 0);
 // }
+
+namespace {
+// Scores of a (sites x 9 mutations x reads) batch.  At the odd sites
+// half the reads favor the no-op and half the first substitution; at
+// the even sites every read favors the no-op.
+std::vector<float> BatchScores(int numSites, int numReads)
+{
+    std::vector<float> scores;
+    unsigned int seed = 5;
+    for (int s = 0; s < numSites; s++) {
+        for (int g = 0; g < 9; g++) {
+            for (int i = 0; i < numReads; i++) {
+                seed = seed * 1103515245 + 12345;
+                float noise = ((seed >> 16) % 100) / 100.0f;
+                bool favored = (g == 0 && (s % 2 == 0 || i % 2 == 0)) ||
+                               (g == 1 && s % 2 == 1 && i % 2 == 1);
+                scores.push_back(favored ? -noise : -10.0f - noise);
+            }
+        }
+    }
+    return scores;
+}
+}
+
+TEST(DiploidQuiverTests, BatchCallsMatchSiteBySiteCalls)
+{
+    const int numSites = 37, numReads = 11;
+    std::vector<float> scores = BatchScores(numSites, numReads);
+    DiploidSiteCalls calls =
+        CallHeterozygousSites(&scores[0], numSites, 9, numReads, 0.0f, 3);
+    EXPECT_EQ(numReads, calls.NumReads);
+
+    std::vector<int> expectedSites;
+    for (int s = 0; s < numSites; s++) {
+        // IsSiteHeterozygous takes a (reads x mutations) matrix
+        std::vector<float> site(numReads * 9);
+        for (int g = 0; g < 9; g++) {
+            for (int i = 0; i < numReads; i++) {
+                site[i * 9 + g] = scores[(s * 9 + g) * numReads + i];
+            }
+        }
+        DiploidSite* ds = IsSiteHeterozygous(&site[0], numReads, 9, 0.0f);
+        if (ds == NULL) continue;
+        int k = expectedSites.size();
+        expectedSites.push_back(s);
+        ASSERT_LT(k, static_cast<int>(calls.Sites.size()));
+        EXPECT_EQ(ds->Allele0, calls.Allele0[k]);
+        EXPECT_EQ(ds->Allele1, calls.Allele1[k]);
+        EXPECT_NEAR(ds->LogBayesFactor, calls.LogBayesFactors[k], 1e-3);
+        std::vector<int> alleles(calls.AlleleForRead.begin() + k * numReads,
+                                 calls.AlleleForRead.begin() + (k + 1) * numReads);
+        EXPECT_EQ(ds->AlleleForRead, alleles);
+        delete ds;
+    }
+    EXPECT_EQ(expectedSites, calls.Sites);
+    EXPECT_EQ(18u, calls.Sites.size());
+    EXPECT_EQ(calls.Sites.size() * numReads, calls.AlleleForRead.size());
+
+    // The calls do not depend on the threads
+    DiploidSiteCalls serial = CallHeterozygousSites(&scores[0], numSites, 9, numReads, 0.0f);
+    EXPECT_EQ(calls.Sites, serial.Sites);
+    EXPECT_EQ(calls.LogBayesFactors, serial.LogBayesFactors);
+
+    EXPECT_THROW(CallHeterozygousSites(&scores[0], numSites, 8, numReads, 0.0f),
+                 InvalidInputError);
+}
@@ -0,0 +1,204 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <cfloat>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Edna/EdnaConfig.hpp>
+#include <ConsensusCore/Edna/EdnaCounts.hpp>
+#include <ConsensusCore/Edna/EdnaEvaluator.hpp>
+#include <ConsensusCore/Edna/MultiReadEdnaScorer.hpp>
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Quiver/detail/SseMath.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "Random.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+std::vector<int> Channels(const std::string& seq)
+{
+    std::vector<int> channels;
+    foreach (char b, seq) {
+        channels.push_back(std::string("ACGT").find(b) + 1);
+    }
+    return channels;
+}
+
+EdnaModelParams TestingEdnaParams()
+{
+    std::vector<float> pStay(4, 0.1f), pMerge(4, 0.2f), moveDists, stayDists;
+    for (int tplBase = 1; tplBase <= 4; tplBase++) {
+        moveDists.push_back(0.04f);
+        stayDists.push_back(0.01f);
+        for (int obs = 1; obs <= 4; obs++) {
+            moveDists.push_back(obs == tplBase ? 0.9f : 0.02f);
+            stayDists.push_back(obs == tplBase ? 0.49f : 0.17f);
+        }
+    }
+    return EdnaModelParams(pStay, pMerge, moveDists, stayDists);
+}
+
+// DoCount, as it was computed one entry at a time
+void ScalarCount(const std::vector<int>& channelRead, EdnaEvaluator& eval,
+                 const SparseSseEdnaMutationScorer& scorer, int j1, int j2, float* results)
+{
+    const SparseMatrix* alpha = scorer.Alpha();
+    const SparseMatrix* beta = scorer.Beta();
+    int usedBegin, usedEnd;
+    boost::tie(usedBegin, usedEnd) = RangeUnion(alpha->UsedRowRange(j1), beta->UsedRowRange(j2));
+    for (int k = 0; k < 5; k++)
+        results[k] = -FLT_MAX;
+    for (int i = usedBegin; i < usedEnd; i++) {
+        results[0] = detail::logAdd(
+            results[0], alpha->Get(i, j1) + eval.ScoreMove(j1, j2, 0) + beta->Get(i, j2));
+    }
+    int usedCap = std::min(usedEnd, alpha->Rows() - 1);
+    for (int i = usedBegin; i < usedCap; i++) {
+        int readBase = channelRead[i];
+        results[readBase] =
+            detail::logAdd(results[readBase], alpha->Get(i, j1) + eval.ScoreMove(j1, j2, readBase) +
+                                                  beta->Get(i + 1, j2));
+    }
+}
+
+struct EdnaRead
+{
+    std::vector<int> Channel;
+    boost::scoped_ptr<EdnaEvaluator> Evaluator;
+    boost::scoped_ptr<SparseSseEdnaMutationScorer> Scorer;
+
+    EdnaRead(const std::string& tpl, const std::string& seq)
+        : Channel(Channels(seq))
+        , Evaluator(new EdnaEvaluator(ChannelSequenceFeatures(seq, Channel), tpl, Channels(tpl),
+                                      TestingEdnaParams()))
+        , Scorer(new SparseSseEdnaMutationScorer(
+              *Evaluator, SparseSseEdnaRecursor(ALL_MOVES, BandingOptions(4, 200))))
+    {
+    }
+};
+}
+
+TEST(EdnaCountsTest, DoCountMatchesScalar)
+{
+    Rng rng(7);
+    std::string tpl = RandomSequence(rng, 60);
+    std::string seq = tpl;
+    seq.erase(41, 1);
+    seq.insert(17, "T");
+    seq[30] = (seq[30] == 'A') ? 'G' : 'A';
+    EdnaRead read(tpl, seq);
+
+    EdnaCounts counts;
+    Feature<int> channelRead(&read.Channel[0], read.Channel.size());
+    for (int j1 = 0; j1 < static_cast<int>(tpl.length()); j1++) {
+        for (int j2 = j1; j2 <= j1 + 2 && j2 <= static_cast<int>(tpl.length()); j2++) {
+            float expected[5], results[5];
+            ScalarCount(read.Channel, *read.Evaluator, *read.Scorer, j1, j2, expected);
+            counts.DoCount(channelRead, *read.Evaluator, *read.Scorer, j1, j2, results);
+            for (int k = 0; k < 5; k++) {
+                if (expected[k] < -1e30f) {
+                    EXPECT_LT(results[k], -1e30f);
+                } else {
+                    EXPECT_NEAR(expected[k], results[k], 1e-3f + 1e-5f * std::fabs(expected[k]))
+                        << "j1 " << j1 << " j2 " << j2 << " obs " << k;
+                }
+            }
+        }
+    }
+}
+
+TEST(EdnaCountsTest, DoCountBatchIsThreadIndependent)
+{
+    Rng rng(11);
+    std::string tpl = RandomSequence(rng, 50);
+    std::vector<Feature<int> > channelReads;
+    std::vector<const SparseSseEdnaMutationScorer*> scorers;
+    std::vector<EdnaRead*> reads;
+    for (int n = 0; n < 9; n++) {
+        std::string seq = tpl;
+        seq.erase(5 + 4 * n, 1);
+        seq[30 - n] = (seq[30 - n] == 'C') ? 'T' : 'C';
+        reads.push_back(new EdnaRead(tpl, seq));
+        channelReads.push_back(Feature<int>(&reads.back()->Channel[0], seq.length()));
+        scorers.push_back(reads.back()->Scorer.get());
+    }
+
+    EdnaCounts counts;
+    std::vector<float> serial(EdnaCounts::BATCH_COUNTS, 0.0f);
+    std::vector<float> parallel(EdnaCounts::BATCH_COUNTS, 0.0f);
+    counts.DoCountBatch(channelReads, scorers, 1, &serial[0]);
+    counts.DoCountBatch(channelReads, scorers, 4, &parallel[0]);
+    EXPECT_EQ(serial, parallel);
+
+    // Each read takes one step per template position, give or take
+    // the merges, which take two
+    float steps = 0;
+    for (int k = 0; k < EdnaCounts::BATCH_COUNTS; k++) {
+        int move = k / 20;
+        if (move == EdnaCounts::STEP_COUNTS) steps += serial[k];
+        if (move == EdnaCounts::MERGE_COUNTS) steps += 2 * serial[k];
+    }
+    EXPECT_NEAR(9 * 50, steps, 1.0);
+
+    for (size_t n = 0; n < reads.size(); n++) {
+        delete reads[n];
+    }
+}
+
+TEST(MultiReadEdnaScorerTest, TrainingImprovesLikelihood)
+{
+    Rng rng(3);
+    std::vector<ChannelSequenceFeatures> reads;
+    std::string tpl = RandomSequence(rng, 80);
+    for (int n = 0; n < 12; n++) {
+        std::string seq = tpl;
+        seq.insert(10 + 5 * n, 1, seq[10 + 5 * n]);
+        seq.erase(70 - 3 * n, 1);
+        seq[40 + n] = (seq[40 + n] == 'G') ? 'T' : 'G';
+        reads.push_back(ChannelSequenceFeatures(seq, Channels(seq)));
+    }
+
+    MultiReadEdnaScorer serial(tpl, TestingEdnaParams(), BandingOptions(4, 200), 1);
+    MultiReadEdnaScorer parallel(tpl, TestingEdnaParams(), BandingOptions(4, 200), 3);
+    serial.AddReads(reads);
+    parallel.AddReads(reads);
+    EXPECT_EQ(12, parallel.NumReads());
+    EXPECT_EQ(serial.Scores(), parallel.Scores());
+    EXPECT_EQ(serial.Counts(), parallel.Counts());
+    for (int n = 0; n < 12; n++) {
+        EXPECT_EQ(reads[n].Length() + 1, parallel.Scorer(n)->Alpha()->Rows());
+    }
+
+    // The M step leaves distributions
+    EdnaModelParams updated = UpdateEdnaParams(serial.Counts(), serial.Params());
+    for (int t = 0; t < 4; t++) {
+        float moveTotal = 0, stayTotal = 0;
+        for (int obs = 0; obs < 5; obs++) {
+            moveTotal += updated.moveDists_[t * 5 + obs];
+            stayTotal += (obs > 0) ? updated.stayDists_[t * 5 + obs] : 0;
+        }
+        EXPECT_NEAR(1.0, moveTotal, 1e-5);
+        EXPECT_NEAR(1.0, stayTotal, 1e-5);
+        EXPECT_GT(updated.pStay_[t], 0);
+        EXPECT_LT(updated.pStay_[t], 1);
+    }
+
+    // Each EM iteration can only improve the likelihood
+    float score = parallel.BaselineScore();
+    std::vector<MultiReadEdnaScorer*> scorers(1, &parallel);
+    for (int iter = 0; iter < 3; iter++) {
+        TrainEdnaParams(scorers, 1, -FLT_MAX);
+        EXPECT_GT(parallel.BaselineScore(), score - 1e-2f);
+        score = parallel.BaselineScore();
+    }
+    EXPECT_GT(score, serial.BaselineScore());
+}
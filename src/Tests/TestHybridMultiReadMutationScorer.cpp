@@ -0,0 +1,112 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Quiver/HybridMultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/MutationEnumerator.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+#include <ConsensusCore/Sequence.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+MappedRead MappedReadOf(std::string seq, StrandEnum strand, int tStart, int tEnd)
+{
+    if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+    return MappedRead(Read(QvSequenceFeatures(seq), "anonymous", "unknown"), strand, tStart, tEnd);
+}
+
+class HybridMultiReadMutationScorerTest : public testing::Test
+{
+protected:
+    HybridMultiReadMutationScorerTest()
+        : truth_("GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA")
+    {
+        configs_.InsertDefault(
+            QuiverConfig(TestingParams(), ALL_MOVES, BandingOptions(4, 200), -12.5f));
+    }
+
+    void AddReads(AbstractMultiReadMutationScorer* mms) const
+    {
+        for (int i = 0; i < 6; i++) {
+            StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+            std::string seq = truth_;
+            if (i == 3) seq[20] = 'T';
+            mms->AddRead(MappedReadOf(seq, strand, 0, truth_.length()));
+        }
+    }
+
+    std::string truth_;
+    QuiverConfigTable configs_;
+};
+}
+
+TEST_F(HybridMultiReadMutationScorerTest, ScoresAreSumProductScores)
+{
+    std::string draft = truth_;
+    draft[30] = 'G';
+    HybridMultiReadMutationScorer hybrid(configs_, draft);
+    SparseSseQvSumProductMultiReadMutationScorer sumProduct(configs_, draft);
+    AddReads(&hybrid);
+    AddReads(&sumProduct);
+
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(draft).Mutations();
+    EXPECT_EQ(sumProduct.BaselineScores(), hybrid.BaselineScores());
+    EXPECT_EQ(sumProduct.ScoreMany(muts), hybrid.ScoreMany(muts));
+    EXPECT_EQ(sumProduct.ScoresMany(muts), hybrid.ScoresMany(muts));
+
+    // The screen passes every mutation the sum-product scorer finds
+    // favorable, and those it passes get their sum-product FastScore
+    std::vector<float> fastScores = hybrid.FastScoreMany(muts);
+    int nScreened = 0;
+    for (size_t i = 0; i < muts.size(); i++) {
+        const Mutation& m = muts[i];
+        EXPECT_EQ(hybrid.FastScore(m), fastScores[i]);
+        EXPECT_EQ(sumProduct.FastIsFavorable(m), hybrid.FastIsFavorable(m));
+        float viterbiScore = hybrid.ViterbiScorer().FastScore(m);
+        if (viterbiScore > MIN_FAVORABLE_SCOREDIFF - hybrid.ScreenTolerance()) {
+            EXPECT_EQ(sumProduct.FastScore(m), fastScores[i]);
+        } else {
+            nScreened++;
+            EXPECT_EQ(viterbiScore, fastScores[i]);
+        }
+    }
+    EXPECT_LT(0, nScreened);
+    EXPECT_TRUE(hybrid.FastIsFavorable(Mutation(SUBSTITUTION, 30, truth_[30])));
+}
+
+TEST_F(HybridMultiReadMutationScorerTest, RefinesToTruth)
+{
+    std::string draft = truth_;
+    draft[12] = 'G';
+    draft.erase(40, 1);
+    HybridMultiReadMutationScorer hybrid(configs_, draft);
+    for (int i = 0; i < 6; i++) {
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        hybrid.AddRead(MappedReadOf(truth_, strand, 0, draft.length()));
+    }
+    EXPECT_TRUE(RefineConsensus(hybrid));
+    EXPECT_EQ(truth_, hybrid.Template());
+    EXPECT_EQ(hybrid.Template(), hybrid.ViterbiScorer().Template());
+    EXPECT_EQ(truth_.length(), ConsensusQVs(hybrid).size());
+
+    HybridMultiReadMutationScorer copy(hybrid);
+    EXPECT_EQ(hybrid.BaselineScore(), copy.BaselineScore());
+}
+
+TEST_F(HybridMultiReadMutationScorerTest, ScreenToleranceMustNotBeNegative)
+{
+    HybridMultiReadMutationScorer hybrid(configs_, truth_, 0.5f);
+    EXPECT_EQ(0.5f, hybrid.ScreenTolerance());
+    hybrid.SetScreenTolerance(0.0f);
+    EXPECT_EQ(0.0f, hybrid.ScreenTolerance());
+    EXPECT_THROW(hybrid.SetScreenTolerance(-1.0f), InvalidInputError);
+    EXPECT_THROW(HybridMultiReadMutationScorer(configs_, truth_, -1.0f), InvalidInputError);
+}
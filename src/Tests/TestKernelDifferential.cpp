@@ -0,0 +1,241 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/Int16Recursor.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/MutationEnumerator.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+#include <ConsensusCore/Quiver/SimpleRecursor.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+
+#include "BenchUtils.hpp"
+#include "KernelVariants.hpp"
+#include "ParameterSettings.hpp"
+#include "Random.hpp"
+#include "ScoreTolerance.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+//
+// Differential tests of the fast recursion kernels: on random reads,
+// each must score within its budget (see KernelVariants.hpp) of the
+// reference, and MultiReadMutationScorers built on it must find the
+// same favorable mutations and the same consensus.
+//
+
+extern Read AnonymousRead(std::string seq);
+extern MappedRead AnonymousMappedRead(std::string seq, StrandEnum strand, int tStart, int tEnd);
+
+namespace {
+const BandingOptions WIDE_BANDING(4, 200);
+
+// Noisy reads of random templates, short to long
+std::vector<QvEvaluator> NoisyEvaluators(int seed)
+{
+    Rng rng(seed);
+    std::vector<QvEvaluator> evaluators;
+    for (int n = 0; n < 12; n++) {
+        std::string tpl = RandomSequence(rng, 40 + n * 37);
+        std::string seq = NoisyCopy(rng, tpl, 0.02f + 0.01f * (n % 4));
+        evaluators.push_back(QvEvaluator(AnonymousRead(seq), tpl, TestingParams()));
+    }
+    return evaluators;
+}
+
+QuiverConfigTable VariantConfigs(const KernelVariant& variant)
+{
+    QuiverConfig config = TestingConfig();
+    config.Recursor.LogAdd = variant.LogAdd;
+    QuiverConfigTable configs;
+    configs.InsertDefault(config);
+    return configs;
+}
+
+// Reads of truth, on alternating strands, each missing a few bases at
+// its ends and with errors at the given rate
+std::vector<MappedRead> NoisyMappedReads(Rng& rng, const std::string& truth, int numReads,
+                                         float errorRate)
+{
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < numReads; i++) {
+        int tStart = (i * 7) % 9;
+        int tEnd = truth.length() - (i * 5) % 7;
+        std::string seq = NoisyCopy(rng, truth.substr(tStart, tEnd - tStart), errorRate);
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        reads.push_back(AnonymousMappedRead(seq, strand, tStart, tEnd));
+    }
+    return reads;
+}
+
+// The drift a mutation's summed score may show: each read's score,
+// with and without the mutation, may drift by its budget
+float MutationBudget(const SparseSseQvSumProductMultiReadMutationScorer& mms,
+                     const KernelVariant& variant)
+{
+    float budget = 0;
+    std::vector<float> baselines = mms.BaselineScores();
+    for (int r = 0; r < mms.NumReads(); r++) {
+        int cells = mms.Read(r)->Length() + mms.TemplateLength();
+        budget += 2 * ScoreTolerance(baselines[r], variant.CellBudget * cells);
+    }
+    return budget;
+}
+}
+
+TEST(KernelDifferentialTest, SumProductScoresWithinBudget)
+{
+    SparseSimpleQvSumProductRecursor reference(BASIC_MOVES | MERGE, WIDE_BANDING);
+    foreach (const KernelVariant& variant, SumProductKernelVariants()) {
+        ScopedKernelVariant scope(variant);
+        RecursorConfig config;
+        config.LogAdd = variant.LogAdd;
+        SparseSseQvSumProductRecursor fast(BASIC_MOVES | MERGE, WIDE_BANDING, config);
+
+        foreach (const QvEvaluator& e, NoisyEvaluators(42)) {
+            int I = e.ReadLength(), J = e.TemplateLength();
+            SparseMatrix alpha(I + 1, J + 1), beta(I + 1, J + 1);
+            SparseMatrix fastAlpha(I + 1, J + 1), fastBeta(I + 1, J + 1);
+            reference.FillAlphaBeta(e, alpha, beta);
+            fast.FillAlphaBeta(e, fastAlpha, fastBeta);
+
+            float budget = ScoreTolerance(beta(0, 0), variant.CellBudget * (I + J));
+            EXPECT_NEAR(alpha(I, J), fastAlpha(I, J), budget) << variant.Name << " " << J;
+            EXPECT_NEAR(beta(0, 0), fastBeta(0, 0), budget) << variant.Name << " " << J;
+            for (int j = 2; j < J - 2; j += 7) {
+                EXPECT_NEAR(reference.LinkAlphaBeta(e, alpha, j, beta, j, j),
+                            fast.LinkAlphaBeta(e, fastAlpha, j, fastBeta, j, j), budget)
+                    << variant.Name << " " << J << " " << j;
+            }
+        }
+    }
+}
+
+TEST(KernelDifferentialTest, ViterbiScoresWithinBudget)
+{
+    // The float kernels take the same maximum, whatever their width;
+    // the int16 one rounds each move by up to half a unit
+    SparseSimpleQvRecursor reference(BASIC_MOVES | MERGE, WIDE_BANDING);
+    Int16ViterbiRecursor compact(BASIC_MOVES | MERGE, WIDE_BANDING);
+    foreach (const QvEvaluator& e, NoisyEvaluators(7)) {
+        int I = e.ReadLength(), J = e.TemplateLength();
+        SparseMatrix alpha(I + 1, J + 1);
+        reference.FillAlpha(e, SparseMatrix::Null(), alpha);
+        for (int width = 4; width <= 16; width *= 2) {
+            SetMaxSimdWidth(width);
+            SparseSseQvRecursor fast(BASIC_MOVES | MERGE, WIDE_BANDING);
+            SparseMatrix fastAlpha(I + 1, J + 1);
+            fast.FillAlpha(e, SparseMatrix::Null(), fastAlpha);
+            float budget = ScoreTolerance(alpha(I, J), 1e-5f * (I + J));
+            EXPECT_NEAR(alpha(I, J), fastAlpha(I, J), budget) << width << " " << J;
+        }
+        SetMaxSimdWidth(16);
+        float int16Budget = (I + J + 1) * 0.5f / Int16ViterbiRecursor::Scale;
+        EXPECT_NEAR(alpha(I, J), compact.Score(e), int16Budget) << J;
+    }
+}
+
+TEST(KernelDifferentialTest, MutationScoresAndFavorableSetsWithinBudget)
+{
+    // A template with a few errors, so that some mutations fix them
+    Rng rng(11);
+    std::string truth = RandomSequence(rng, 150);
+    std::string tpl = truth;
+    tpl[30] = (tpl[30] == 'A') ? 'C' : 'A';
+    tpl.erase(75, 1);
+    tpl.insert(110, "G");
+    std::vector<MappedRead> reads = NoisyMappedReads(rng, truth, 12, 0.05f);
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+
+    KernelVariant exact = SumProductKernelVariants()[0];
+    SparseSseQvSumProductMultiReadMutationScorer reference(VariantConfigs(exact), tpl);
+    {
+        ScopedKernelVariant scope(exact);
+        foreach (const MappedRead& mr, reads) {
+            reference.AddRead(mr);
+        }
+    }
+    std::vector<float> expected = reference.ScoreMany(muts);
+    ASSERT_GT(std::count_if(expected.begin(), expected.end(),
+                            [](float s) { return s > MIN_FAVORABLE_SCOREDIFF; }),
+              0);
+
+    foreach (const KernelVariant& variant, SumProductKernelVariants()) {
+        ScopedKernelVariant scope(variant);
+        SparseSseQvSumProductMultiReadMutationScorer mms(VariantConfigs(variant), tpl);
+        foreach (const MappedRead& mr, reads) {
+            mms.AddRead(mr);
+        }
+        ASSERT_EQ(reference.NumReads(), mms.NumReads());
+        float budget = MutationBudget(reference, variant);
+        std::vector<float> scores = mms.ScoreMany(muts);
+
+        // Only mutations scored within the budget of the bar may fall
+        // on the other side of it
+        for (size_t k = 0; k < muts.size(); k++) {
+            EXPECT_NEAR(expected[k], scores[k], budget) << variant.Name << " " << muts[k];
+            if (std::fabs(expected[k] - MIN_FAVORABLE_SCOREDIFF) > budget) {
+                EXPECT_EQ(expected[k] > MIN_FAVORABLE_SCOREDIFF, mms.IsFavorable(muts[k]))
+                    << variant.Name << " " << muts[k];
+            }
+        }
+    }
+}
+
+TEST(KernelDifferentialTest, ConsensusAgreesAcrossKernels)
+{
+    // Every kernel refines to the reference's consensus, and the
+    // incrementally updated scores of its reads stay within its budget
+    // of those of the reads added afresh, at their new coordinates, to
+    // the consensus
+    for (int seed = 1; seed <= 3; seed++) {
+        Rng rng(seed);
+        std::string truth = RandomSequence(rng, 200);
+        std::string tpl = truth;
+        tpl[50] = (tpl[50] == 'G') ? 'T' : 'G';
+        tpl.erase(100, 1);
+        tpl.insert(150, "C");
+        std::vector<MappedRead> reads = NoisyMappedReads(rng, truth, 16, 0.05f);
+
+        std::string expected;
+        foreach (const KernelVariant& variant, SumProductKernelVariants()) {
+            ScopedKernelVariant scope(variant);
+            SparseSseQvSumProductMultiReadMutationScorer mms(VariantConfigs(variant), tpl);
+            foreach (const MappedRead& mr, reads) {
+                mms.AddRead(mr);
+            }
+            EXPECT_TRUE(RefineConsensus(mms)) << variant.Name;
+            if (expected.empty()) expected = mms.Template();
+            EXPECT_EQ(expected, mms.Template()) << variant.Name << " " << seed;
+
+            SparseSseQvSumProductMultiReadMutationScorer fresh(VariantConfigs(variant),
+                                                               mms.Template());
+            for (int r = 0; r < mms.NumReads(); r++) {
+                fresh.AddRead(*mms.Read(r));
+            }
+            std::vector<float> incremental = mms.BaselineScores();
+            std::vector<float> refilled = fresh.BaselineScores();
+            ASSERT_EQ(refilled.size(), incremental.size());
+            for (size_t r = 0; r < refilled.size(); r++) {
+                int cells = mms.Read(r)->Length() + mms.TemplateLength();
+                EXPECT_NEAR(refilled[r], incremental[r],
+                            ScoreTolerance(refilled[r], variant.CellBudget * cells))
+                    << variant.Name << " " << seed << " " << r;
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ConsensusCore/Logging.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+// The lines of the log, without the level and location that lead them
+std::vector<std::string> Messages(const std::string& log)
+{
+    std::vector<std::string> messages;
+    std::istringstream lines(log);
+    std::string line;
+    while (std::getline(lines, line)) {
+        messages.push_back(line.substr(line.find("): ") + 3));
+    }
+    return messages;
+}
+
+int Formatted = 0;
+
+int Format()
+{
+    Formatted++;
+    return Formatted;
+}
+}
+
+TEST(LoggingTest, DisabledMessagesAreNotFormatted)
+{
+    Formatted = 0;
+    ASSERT_FALSE(Logging::flog->Enabled(LL_DEBUG));
+    LDEBUG << Format();
+    LTRACE << Format();
+    EXPECT_EQ(0, Formatted);
+}
+
+TEST(LoggingTest, AsyncLoggerKeepsEachThreadsOrder)
+{
+    const int numThreads = 4;
+    const int numMessages = 200;
+    cpplog::StringLogger out;
+    detail::ThreadSafeLogger logger(LL_DEBUG, &out);
+    logger.SetAsync(true);
+    EXPECT_TRUE(logger.Async());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.push_back(std::thread([&logger, t]() {
+            for (int i = 0; i < numMessages; i++) {
+                LOG_LEVEL(LL_INFO, logger) << t << " " << i;
+                LOG_LEVEL(LL_TRACE, logger) << "filtered";
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    logger.Flush();
+
+    std::vector<std::string> messages = Messages(out.getString());
+    ASSERT_EQ(numThreads * numMessages, static_cast<int>(messages.size()));
+    std::vector<int> next(numThreads, 0);
+    for (size_t k = 0; k < messages.size(); k++) {
+        int t, i;
+        std::istringstream(messages[k]) >> t >> i;
+        ASSERT_EQ(next[t], i);
+        next[t]++;
+    }
+
+    // A fatal message is written at once, after those queued
+    out.clear();
+    LOG_LEVEL(LL_INFO, logger) << "queued";
+    LOG_LEVEL(LL_FATAL, logger) << "fatal";
+    messages = Messages(out.getString());
+    ASSERT_EQ(2, static_cast<int>(messages.size()));
+    EXPECT_EQ("queued", messages[0]);
+    EXPECT_EQ("fatal", messages[1]);
+
+    logger.SetAsync(false);
+    out.clear();
+    LOG_LEVEL(LL_INFO, logger) << "synchronous";
+    EXPECT_EQ(1, static_cast<int>(Messages(out.getString()).size()));
+}
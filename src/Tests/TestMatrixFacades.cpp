@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <boost/tuple/tuple.hpp>
 #include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <typeinfo>
@@ -12,12 +14,16 @@
 
 #include <ConsensusCore/LFloat.hpp>
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/MatrixPool.hpp>
 #include <ConsensusCore/Matrix/SparseMatrix.hpp>
 
 using std::cout;
 using std::endl;
 
 using ConsensusCore::DenseMatrix;
+using ConsensusCore::InvalidInputError;
+using ConsensusCore::Interval;
+using ConsensusCore::MatrixPool;
 using ConsensusCore::SparseMatrix;
 using ConsensusCore::lfloat;
 
@@ -213,3 +219,200 @@ TYPED_TEST(MatrixTest, CopyTest)
 
     ASSERT_EQ(5, mCopy(1, 1));
 }
+
+TYPED_TEST(MatrixTest, Reset)
+{
+    float NEG_INF = -FLT_MAX;
+    TypeParam m(10, 10);
+    for (int j = 0; j < 10; ++j) {
+        m.StartEditingColumn(j, 0, 10);
+        for (int i = 0; i < 10; ++i) {
+            m.Set(i, j, i + j);
+        }
+        m.FinishEditingColumn(j, 0, 10);
+    }
+
+    m.Reset(12, 8);
+    EXPECT_EQ(12, m.Rows());
+    EXPECT_EQ(8, m.Columns());
+    for (int j = 0; j < 8; ++j) {
+        EXPECT_TRUE(m.IsColumnEmpty(j));
+        for (int i = 0; i < 12; ++i) {
+            EXPECT_EQ(NEG_INF, m(i, j));
+        }
+    }
+
+    m.StartEditingColumn(7, 0, 12);
+    m.Set(11, 7, 5);
+    m.FinishEditingColumn(7, 11, 12);
+    EXPECT_EQ(5, m(11, 7));
+}
+
+TYPED_TEST(MatrixTest, Pool)
+{
+    MatrixPool<TypeParam>::Clear();
+    TypeParam* m = MatrixPool<TypeParam>::Acquire(100, 100);
+    m->StartEditingColumn(3, 0, 100);
+    m->Set(10, 3, 5);
+    m->FinishEditingColumn(3, 10, 11);
+    MatrixPool<TypeParam>::Release(m);
+    EXPECT_EQ(1, MatrixPool<TypeParam>::Size());
+
+    // a matrix of about the same size is recycled, and comes back empty
+    TypeParam* m2 = MatrixPool<TypeParam>::Acquire(100, 101);
+    EXPECT_EQ(m, m2);
+    EXPECT_EQ(0, MatrixPool<TypeParam>::Size());
+    EXPECT_EQ(101, m2->Columns());
+    EXPECT_TRUE(m2->IsColumnEmpty(3));
+    EXPECT_EQ(-FLT_MAX, (*m2)(10, 3));
+
+    // a much smaller one is not
+    TypeParam* m3 = MatrixPool<TypeParam>::Acquire(10, 10);
+    MatrixPool<TypeParam>::Release(m2);
+    TypeParam* m4 = MatrixPool<TypeParam>::Acquire(10, 10);
+    EXPECT_NE(m2, m4);
+    delete m3;
+    delete m4;
+    MatrixPool<TypeParam>::Clear();
+    EXPECT_EQ(0, MatrixPool<TypeParam>::Size());
+}
+
+TEST(SparseMatrixTest, ToHostBand)
+{
+    // a diagonal band three rows wide
+    SparseMatrix m(10, 8);
+    for (int j = 0; j < 8; j++) {
+        m.StartEditingColumn(j, j, j + 3);
+        for (int i = j; i < j + 3; i++) {
+            m.Set(i, j, 10 * i + j);
+        }
+        m.FinishEditingColumn(j, j, j + 3);
+    }
+
+    float* values;
+    int* offsets;
+    int* ranges;
+    int nValues, nOffsets, cols, two;
+    m.ToHostBand(&values, &nValues);
+    m.ToHostBandOffsets(&offsets, &nOffsets);
+    m.ToHostUsedRowRanges(&ranges, &cols, &two);
+    EXPECT_EQ(m.UsedEntries(), nValues);
+    EXPECT_EQ(9, nOffsets);
+    EXPECT_EQ(8, cols);
+    EXPECT_EQ(2, two);
+    EXPECT_EQ(nValues, offsets[8]);
+    for (int j = 0; j < 8; j++) {
+        EXPECT_EQ(j, ranges[2 * j]);
+        EXPECT_EQ(j + 3, ranges[2 * j + 1]);
+        for (int i = ranges[2 * j]; i < ranges[2 * j + 1]; i++) {
+            EXPECT_EQ(10 * i + j, values[offsets[j] + i - ranges[2 * j]]);
+        }
+    }
+    free(values);
+    free(offsets);
+    free(ranges);
+
+    // columns Reset leaves unstored are empty
+    m.Reset(10, 8, 2, 5);
+    m.ToHostBandOffsets(&offsets, &nOffsets);
+    m.ToHostUsedRowRanges(&ranges, &cols, &two);
+    for (int j = 0; j < 8; j++) {
+        EXPECT_EQ(0, offsets[j + 1] - offsets[j]);
+        EXPECT_EQ(ranges[2 * j], ranges[2 * j + 1]);
+    }
+    free(offsets);
+    free(ranges);
+}
+
+TEST(SparseMatrixTest, ToHostMatrixWindow)
+{
+    SparseMatrix m(10, 8);
+    for (int j = 0; j < 8; j++) {
+        m.StartEditingColumn(j, j, j + 3);
+        for (int i = j; i < j + 3; i++) {
+            m.Set(i, j, 10 * i + j);
+        }
+        m.FinishEditingColumn(j, j, j + 3);
+    }
+
+    float* full;
+    float* window;
+    int rows, cols, windowRows, windowCols;
+    m.ToHostMatrix(&full, &rows, &cols);
+    m.ToHostMatrix(&window, &windowRows, &windowCols, 2, 7, 3, 6);
+    EXPECT_EQ(5, windowRows);
+    EXPECT_EQ(3, windowCols);
+    for (int i = 0; i < windowRows; i++) {
+        for (int j = 0; j < windowCols; j++) {
+            float expected = full[(i + 2) * cols + j + 3];
+            float actual = window[i * windowCols + j];
+            EXPECT_TRUE(expected == actual || (std::isnan(expected) && std::isnan(actual)));
+        }
+    }
+    delete[] full;
+    free(window);
+
+    EXPECT_THROW(m.ToHostMatrix(&window, &windowRows, &windowCols, 0, 11, 0, 8),
+                 InvalidInputError);
+    EXPECT_THROW(m.ToHostMatrix(&window, &windowRows, &windowCols, 0, 10, 5, 4),
+                 InvalidInputError);
+}
+
+TEST(SparseMatrixTest, ShrinkToFit)
+{
+    // a diagonal band three rows wide, in columns allocated far wider
+    SparseMatrix m(200, 100);
+    for (int j = 0; j < 100; j++) {
+        m.StartEditingColumn(j, 0, 80);
+        for (int i = j; i < j + 3; i++) {
+            m.Set(i, j, 10 * i + j);
+        }
+        m.FinishEditingColumn(j, j, j + 3);
+    }
+    SparseMatrix wide(m);
+    int64_t bytes = m.AllocatedBytes();
+    EXPECT_LT(m.UsedEntries(), m.AllocatedEntries());
+
+    m.ShrinkToFit();
+    EXPECT_EQ(m.UsedEntries(), m.AllocatedEntries());
+    EXPECT_LT(m.AllocatedBytes(), bytes);
+    for (int j = 0; j < 100; j++) {
+        EXPECT_EQ(Interval(j, j + 3), m.UsedRowRange(j));
+        for (int i = 0; i < 200; i++) {
+            EXPECT_EQ(wide(i, j), m(i, j)) << i << " " << j;
+        }
+    }
+
+    // columns edited afterwards grow again
+    m.StartEditingColumn(5, 0, 40);
+    for (int i = 0; i < 40; i++) {
+        m.Set(i, 5, i);
+    }
+    m.FinishEditingColumn(5, 0, 40);
+    EXPECT_EQ(39, m(39, 5));
+    EXPECT_EQ(wide(6, 6), m(6, 6));
+}
+
+TEST(DenseMatrixTest, ColumnsAreAligned)
+{
+    // every column starts on a cache line, whatever the number of rows,
+    // and stays there across Reset and copying
+    DenseMatrix m(13, 5);
+    for (int j = 0; j < 5; j++) {
+        EXPECT_EQ(0u, reinterpret_cast<size_t>(&m(0, j)) % 64);
+    }
+    m.StartEditingColumn(2, 0, 13);
+    m.Set(12, 2, 7);
+    m.FinishEditingColumn(2, 12, 13);
+    DenseMatrix mCopy(m);
+    EXPECT_EQ(7, mCopy(12, 2));
+    EXPECT_EQ(0u, reinterpret_cast<size_t>(&mCopy(0, 4)) % 64);
+
+    m.Reset(30, 3);
+    for (int j = 0; j < 3; j++) {
+        EXPECT_EQ(0u, reinterpret_cast<size_t>(&m(0, j)) % 64);
+        for (int i = 0; i < 30; i++) {
+            EXPECT_EQ(-FLT_MAX, m(i, j));
+        }
+    }
+}
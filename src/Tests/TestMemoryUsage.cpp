@@ -0,0 +1,129 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Matrix/DenseMatrix.hpp>
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
+#include <ConsensusCore/Poa/PoaConsensus.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+const std::string TPL = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGATCCAAGTTCAGGTTACACATGATTAC";
+}
+
+TEST(MemoryUsageTest, MatricesAreCountedAsTheyGrow)
+{
+    int64_t before = ProcessMemoryUsage().MatrixBytes;
+    {
+        SparseMatrix m(200, 50);
+        EXPECT_EQ(before + m.AllocatedBytes(), ProcessMemoryUsage().MatrixBytes);
+
+        // Bands wider than the arena was sized for grow it
+        for (int j = 0; j < m.Columns(); j++) {
+            m.StartEditingColumn(j, 0, m.Rows());
+            m.FinishEditingColumn(j, 0, m.Rows());
+        }
+        m.Reset(200, 50);
+        EXPECT_GT(m.AllocatedBytes(), 200 * 50 * SparseMatrix::EntryBytes());
+        EXPECT_EQ(before + m.AllocatedBytes(), ProcessMemoryUsage().MatrixBytes);
+
+        int64_t scratch = ProcessMemoryUsage().ScratchBytes;
+        m.SetMemoryCategory(SCRATCH_MEMORY);
+        EXPECT_EQ(before, ProcessMemoryUsage().MatrixBytes);
+        EXPECT_EQ(scratch + m.AllocatedBytes(), ProcessMemoryUsage().ScratchBytes);
+        m.SetMemoryCategory(MATRIX_MEMORY);
+
+        DenseMatrix d(100, 10);
+        EXPECT_GE(d.AllocatedBytes(), 100 * 10 * DenseMatrix::EntryBytes());
+        EXPECT_EQ(before + m.AllocatedBytes() + d.AllocatedBytes(),
+                  ProcessMemoryUsage().MatrixBytes);
+    }
+    EXPECT_EQ(before, ProcessMemoryUsage().MatrixBytes);
+}
+
+TEST(MemoryUsageTest, FeaturesAreCountedUntilFreed)
+{
+    int64_t before = ProcessMemoryUsage().FeatureBytes;
+    {
+        QvSequenceFeatures f(TPL);
+        EXPECT_EQ(static_cast<int64_t>(TPL.length()) * (1 + 6 * sizeof(float)),
+                  f.AllocatedBytes());
+        EXPECT_EQ(before + f.AllocatedBytes(), ProcessMemoryUsage().FeatureBytes);
+
+        // Copies share the arrays
+        QvSequenceFeatures copy(f);
+        EXPECT_EQ(before + f.AllocatedBytes(), ProcessMemoryUsage().FeatureBytes);
+    }
+    EXPECT_EQ(before, ProcessMemoryUsage().FeatureBytes);
+}
+
+TEST(MemoryUsageTest, PoaAlignmentsAndThePeakAreCounted)
+{
+    std::vector<std::string> reads(4, TPL);
+    delete PoaConsensus::FindConsensus(reads);
+    // The calling thread keeps its alignment columns, of a float and a
+    // traceback per cell, for the next read
+    int64_t cells = TPL.length() * TPL.length();
+    EXPECT_GT(ProcessMemoryUsage().PoaBytes, cells * 6);
+
+    ResetPeakMemoryBytes();
+    int64_t peak = PeakMemoryBytes();
+    EXPECT_EQ(ProcessMemoryUsage().TotalBytes(), peak);
+    {
+        DenseMatrix m(1000, 100);
+        EXPECT_EQ(peak + m.AllocatedBytes(), PeakMemoryBytes());
+    }
+    EXPECT_GT(PeakMemoryBytes(), ProcessMemoryUsage().TotalBytes());
+}
+
+TEST(MemoryUsageTest, ScorerReportsWhatItHolds)
+{
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    MemoryUsage before = ProcessMemoryUsage();
+    {
+        SparseSseQvMultiReadMutationScorer mms(configs, TPL);
+        MemoryUsage empty = mms.Memory();
+        EXPECT_EQ(0, empty.MatrixBytes);
+        EXPECT_EQ(0, empty.FeatureBytes);
+        EXPECT_GT(empty.ScorerBytes, 0);
+
+        for (int i = 0; i < 4; i++) {
+            StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+            std::string seq = (strand == FORWARD_STRAND) ? TPL : ReverseComplement(TPL);
+            mms.AddRead(MappedRead(Read(QvSequenceFeatures(seq), "read", "test"), strand, 0,
+                                   TPL.length()));
+        }
+        MemoryUsage usage = mms.Memory();
+
+        int64_t entryBytes = 0, readFeatureBytes = 0;
+        std::vector<int> entries = mms.AllocatedMatrixEntries();
+        for (int i = 0; i < mms.NumReads(); i++) {
+            entryBytes += entries[i] * SparseMatrix::EntryBytes();
+            readFeatureBytes += mms.Read(i)->Features.AllocatedBytes();
+        }
+        EXPECT_GT(usage.MatrixBytes, entryBytes);
+        // The evaluators' move scores besides the reads' features
+        EXPECT_GT(usage.FeatureBytes, readFeatureBytes);
+        EXPECT_GT(usage.ScorerBytes, empty.ScorerBytes);
+        EXPECT_EQ(0, usage.ScratchBytes);
+        EXPECT_EQ(0, usage.PoaBytes);
+
+        // The process holds all the scorer's matrices and features
+        MemoryUsage process = ProcessMemoryUsage();
+        EXPECT_GE(process.MatrixBytes - before.MatrixBytes, usage.MatrixBytes);
+        EXPECT_GE(process.FeatureBytes - before.FeatureBytes, usage.FeatureBytes);
+    }
+    EXPECT_EQ(before.FeatureBytes, ProcessMemoryUsage().FeatureBytes);
+}
@@ -1,16 +1,29 @@
 // Author: David Alexander
 
 #include <gtest/gtest.h>
+#include <unistd.h>
+#include <algorithm>
 #include <boost/assign.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <cmath>
+#include <cstdio>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <ConsensusCore/Logging.hpp>
+#include <ConsensusCore/Poa/PoaConsensus.hpp>
 #include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/MutationEnumerator.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QuiverConsensus.hpp>
 #include <ConsensusCore/Quiver/ReadScorer.hpp>
+#include <ConsensusCore/Quiver/ReadScorerCache.hpp>
 #include <ConsensusCore/Quiver/SimpleRecursor.hpp>
 #include <ConsensusCore/Quiver/SseRecursor.hpp>
 #include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 
 #include "ParameterSettings.hpp"
 
@@ -30,6 +43,23 @@ MappedRead AnonymousMappedRead(std::string seq, StrandEnum strand, int tStart, i
     return MappedRead(AnonymousRead(seq), strand, tStart, tEnd);
 }
 
+// Reads of tpl with assorted errors and extents, on both strands
+std::vector<MappedRead> AssortedMappedReads(const std::string& tpl, int numReads)
+{
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < numReads; i++) {
+        int tStart = (i * 7) % 9;
+        int tEnd = tpl.length() - (i * 5) % 7;
+        std::string seq = tpl.substr(tStart, tEnd - tStart);
+        seq[(i * 11) % seq.length()] = "ACGT"[i % 4];
+        if (i % 3 == 0) seq.erase((i * 13) % seq.length(), 1);
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        reads.push_back(AnonymousMappedRead(seq, strand, tStart, tEnd));
+    }
+    return reads;
+}
+
 //
 // Tests for supporting code: QuiverConfigTable, OrientedMutation,
 // ReadScoresMutation
@@ -43,6 +73,23 @@ TEST(QuiverConfigTableTests, IllegalChemistry)
     EXPECT_THROW(qt.Insert(qc), InvalidInputError);
 }
 
+TEST(QuiverConfigTableTests, CompilesEachChemistryOnce)
+{
+    QuiverConfigTable qt;
+    qt.Insert(TestingConfig("A"));
+    qt.Insert(TestingConfig("B"));
+    qt.InsertDefault(TestingConfig("C"));
+
+    EXPECT_EQ(0, qt.At("A").Model->ChemistryId());
+    EXPECT_EQ(1, qt.At("B").Model->ChemistryId());
+    EXPECT_EQ(2, qt.At("unknown").Model->ChemistryId());
+    EXPECT_EQ("B", qt.At("B").Model->Params().ChemistryName);
+
+    // copies of a config share its model
+    QuiverConfig copy(qt.At("A"));
+    EXPECT_EQ(qt.At("A").Model.get(), copy.Model.get());
+}
+
 TEST(MutationOrientationTests, ReadScoresMutation1)
 {
     //  012345678901
@@ -150,6 +197,30 @@ TEST(MutationOrientationTests, OrientedMutation)
 //  Tests for the multi read mutation scorer itself
 //
 
+TEST(ReadBandingTests, FollowsQualityAndLength)
+{
+    std::string seq = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    int n = seq.length();
+    std::vector<float> highQv(n, 30), lowQv(n, 5), tags(n, 'N');
+    QvSequenceFeatures clean(seq, &highQv[0], &highQv[0], &highQv[0], &tags[0], &highQv[0]);
+    QvSequenceFeatures noisy(seq, &lowQv[0], &lowQv[0], &lowQv[0], &tags[0], &lowQv[0]);
+
+    BandingOptions banding(4, 10);
+    EXPECT_EQ(10, ReadBanding(banding, noisy, n).ScoreDiff);
+
+    banding.Adaptive = true;
+    banding.MinScoreDiff = 2;
+    banding.MaxScoreDiff = 30;
+    float cleanDiff = ReadBanding(banding, clean, n).ScoreDiff;
+    float noisyDiff = ReadBanding(banding, noisy, n).ScoreDiff;
+    EXPECT_LT(cleanDiff, 10);
+    EXPECT_GT(noisyDiff, 10);
+    EXPECT_GT(ReadBanding(banding, clean, n / 2).ScoreDiff, cleanDiff);
+    // within the bounds
+    EXPECT_EQ(2, ReadBanding(banding, clean, n).ScoreDiff);
+    EXPECT_EQ(30, ReadBanding(banding, noisy, 3 * n).ScoreDiff);
+}
+
 TYPED_TEST_CASE(MultiReadMutationScorerTest, testing::Types<SparseSseQvRecursor>);
 
 template <typename R>
@@ -356,6 +427,23 @@ TYPED_TEST(MultiReadMutationScorerTest, ReverseStrandTest)
     EXPECT_EQ(0, mScorer.Score(newNoOpMutation));
 }
 
+TYPED_TEST(MultiReadMutationScorerTest, AlignmentsOfAllReads)
+{
+    std::string tpl = "AATGTAATCAA";
+    MMS mScorer(this->testingConfigs_, tpl);
+    mScorer.AddRead(MappedRead(AnonymousRead("AATGAATCAA"), FORWARD_STRAND, 0, tpl.length()));
+    mScorer.AddRead(MappedRead(AnonymousRead("TTGATTACATT"), REVERSE_STRAND, 0, tpl.length()));
+    mScorer.SetNumThreads(2);
+
+    std::vector<CompactAlignment> alignments = mScorer.Alignments();
+    ASSERT_EQ(2, alignments.size());
+    EXPECT_EQ("4M1D6M", alignments[0].Cigar());
+    EXPECT_EQ("AATG-AATCAA", alignments[0].Query("AATGAATCAA"));
+    // in the read's orientation
+    EXPECT_EQ("11M", alignments[1].Cigar());
+    EXPECT_EQ(mScorer.Template(REVERSE_STRAND), alignments[1].Target(ReverseComplement(tpl)));
+}
+
 TYPED_TEST(MultiReadMutationScorerTest, TestMutationsAtBeginning)
 {
     std::string tpl = "TTGATTACATT";
@@ -442,6 +530,37 @@ TYPED_TEST(MultiReadMutationScorerTest, NonSpanningReadsTest1)
     EXPECT_EQ("AATGTTAATCAATTGATTAACATT", mScorer.Template());
 }
 
+TYPED_TEST(MultiReadMutationScorerTest, ApplyMutationsKeepsStrandsInStep)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::vector<Mutation> muts;
+    muts += Mutation(INSERTION, 0, 'C'), Mutation(SUBSTITUTION, 0, 'T'),
+        Mutation(INSERTION, 9, 9, "GG"), Mutation(DELETION, 9, 11, ""),
+        Mutation(SUBSTITUTION, 11, 'A'), Mutation(SUBSTITUTION, 20, 23, "TTT"),
+        Mutation(INSERTION, 40, 'A');
+
+    MMS mms(this->testingConfigs_, tpl);
+    foreach (const MappedRead& mr, AssortedMappedReads(tpl, 8)) {
+        mms.AddRead(mr);
+    }
+    mms.ApplyMutations(muts);
+
+    std::string newTpl = ApplyMutations(muts, tpl);
+    EXPECT_EQ(newTpl, mms.Template());
+    EXPECT_EQ(ReverseComplement(newTpl), mms.Template(REVERSE_STRAND));
+    EXPECT_EQ(1, mms.TemplateVersion());
+    EXPECT_EQ(TemplateFingerprint(newTpl), mms.TemplateFingerprint());
+
+    // The reads' scorers see the same templates as those of reads
+    // added afresh at the new coordinates
+    MMS fresh(this->testingConfigs_, newTpl);
+    for (int r = 0; r < mms.NumReads(); r++) {
+        ASSERT_TRUE(mms.Read(r) != NULL);
+        fresh.AddRead(*mms.Read(r));
+    }
+    EXPECT_EQ(fresh.BaselineScores(), mms.BaselineScores());
+}
+
 TYPED_TEST(MultiReadMutationScorerTest, CopyTest)
 {
     // read1:                     >>>>>>>>>>>
@@ -456,6 +575,43 @@ TYPED_TEST(MultiReadMutationScorerTest, CopyTest)
     ASSERT_EQ(mScorer.BaselineScore(), mScorerCopy.BaselineScore());
 }
 
+TYPED_TEST(MultiReadMutationScorerTest, CopiesRefineIndependently)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    MMS mms(this->testingConfigs_, tpl);
+    foreach (const MappedRead& mr, AssortedMappedReads(tpl, 8)) {
+        mms.AddRead(mr);
+    }
+    std::vector<float> baselines = mms.BaselineScores();
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+    std::vector<float> scores = mms.ScoreMany(muts);
+
+    // Each branch edits its own copy
+    std::vector<Mutation> edits;
+    edits += Mutation(SUBSTITUTION, 10, 'C'), Mutation(INSERTION, 25, 'G');
+    MMS branch(mms);
+    EXPECT_EQ(scores, branch.ScoreMany(muts));
+    branch.ApplyMutations(edits);
+
+    EXPECT_EQ(tpl, mms.Template());
+    EXPECT_EQ(baselines, mms.BaselineScores());
+    EXPECT_EQ(scores, mms.ScoreMany(muts));
+
+    std::string newTpl = ApplyMutations(edits, tpl);
+    EXPECT_EQ(newTpl, branch.Template());
+    MMS fresh(this->testingConfigs_, newTpl);
+    for (int r = 0; r < branch.NumReads(); r++) {
+        ASSERT_TRUE(branch.Read(r) != NULL);
+        fresh.AddRead(*branch.Read(r));
+    }
+    std::vector<float> freshBaselines = fresh.BaselineScores();
+    std::vector<float> branchBaselines = branch.BaselineScores();
+    ASSERT_EQ(freshBaselines.size(), branchBaselines.size());
+    for (size_t r = 0; r < freshBaselines.size(); r++) {
+        EXPECT_NEAR(freshBaselines[r], branchBaselines[r], 0.01);
+    }
+}
+
 TYPED_TEST(MultiReadMutationScorerTest, MultiBaseSubstitutionsAtBounds)
 {
     // read1:                     >>>>>>>>>
@@ -507,3 +663,1096 @@ TYPED_TEST(MultiReadMutationScorerTest, MultiBaseIndelsAtBounds)
     EXPECT_EQ(params.Nce, mScorer.Score(Mutation(DELETION, 19, 21, "")));
     EXPECT_EQ(0, mScorer.Score(Mutation(DELETION, 20, 22, "")));
 }
+
+TYPED_TEST(MultiReadMutationScorerTest, MultithreadedScoringMatchesSerial)
+{
+    //                 0123456789012345678901234567890123456789
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    MMS serialScorer(this->testingConfigs_, tpl);
+    MMS parallelScorer(this->testingConfigs_, tpl);
+    parallelScorer.SetNumThreads(4);
+    EXPECT_EQ(1, serialScorer.NumThreads());
+    EXPECT_EQ(4, parallelScorer.NumThreads());
+
+    foreach (const MappedRead& mr, AssortedMappedReads(tpl, 37)) {
+        EXPECT_EQ(serialScorer.AddRead(mr), parallelScorer.AddRead(mr));
+    }
+
+    const int tplLen = tpl.length();
+    for (int pos = 0; pos < tplLen; pos++) {
+        std::vector<Mutation> muts;
+        muts += Mutation(DELETION, pos, '-');
+        for (int b = 0; b < 4; b++) {
+            muts += Mutation(INSERTION, pos, "ACGT"[b]);
+            if (tpl[pos] != "ACGT"[b]) muts += Mutation(SUBSTITUTION, pos, "ACGT"[b]);
+        }
+        foreach (const Mutation& m, muts) {
+            EXPECT_EQ(serialScorer.Score(m), parallelScorer.Score(m));
+            EXPECT_EQ(serialScorer.FastScore(m), parallelScorer.FastScore(m));
+            EXPECT_EQ(serialScorer.Scores(m, -1.0f), parallelScorer.Scores(m, -1.0f));
+            EXPECT_EQ(serialScorer.IsFavorable(m), parallelScorer.IsFavorable(m));
+            EXPECT_EQ(serialScorer.FastIsFavorable(m), parallelScorer.FastIsFavorable(m));
+        }
+    }
+
+    parallelScorer.SetNumThreads(1);
+    EXPECT_EQ(1, parallelScorer.NumThreads());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, FewerReadsThanThreadsShareThemOut)
+{
+    // Two reads and eight threads: each read's mutations are scored on
+    // several threads at once
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+    MMS serialScorer(this->testingConfigs_, tpl);
+    MMS parallelScorer(this->testingConfigs_, tpl);
+    parallelScorer.SetNumThreads(8);
+    foreach (const MappedRead& mr, AssortedMappedReads(tpl, 2)) {
+        serialScorer.AddRead(mr);
+        parallelScorer.AddRead(mr);
+    }
+
+    std::vector<float> expected = serialScorer.ScoreMany(muts);
+    EXPECT_EQ(expected, parallelScorer.ScoreMany(muts));
+    EXPECT_EQ(expected, parallelScorer.ScoreMany(muts));
+    for (size_t k = 0; k < muts.size(); k++) {
+        EXPECT_EQ(expected[k], parallelScorer.Score(muts[k]));
+    }
+    EXPECT_EQ(tpl, parallelScorer.Template());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, IndependentScorersRunConcurrently)
+{
+    // Scorers share no state but the log and, here, a thread pool;
+    // driving several from their own threads gives the serial results.
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+    std::vector<MappedRead> reads = AssortedMappedReads(tpl, 15);
+
+    MMS serialScorer(this->testingConfigs_, tpl);
+    foreach (const MappedRead& mr, reads) {
+        serialScorer.AddRead(mr);
+    }
+    std::vector<float> expected = serialScorer.ScoreMany(muts);
+
+    const int numClients = 4;
+    boost::shared_ptr<ThreadPool> pool(new ThreadPool(2));
+    std::vector<std::vector<float> > results(numClients);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < numClients; c++) {
+        clients.push_back(std::thread([&, c]() {
+            MMS scorer(this->testingConfigs_, tpl);
+            if (c % 2 == 1) scorer.SetThreadPool(pool);
+            foreach (const MappedRead& mr, reads) {
+                scorer.AddRead(mr);
+                LTRACE << "client " << c << " added a read";
+            }
+            results[c] = scorer.ScoreMany(muts);
+        }));
+    }
+    for (int c = 0; c < numClients; c++) {
+        clients[c].join();
+        EXPECT_EQ(expected, results[c]);
+    }
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, ConsensusQVsMatchPerSiteScoring)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::vector<MappedRead> reads = AssortedMappedReads(tpl, 15);
+    MMS mms(this->testingConfigs_, tpl);
+    foreach (const MappedRead& mr, reads) {
+        mms.AddRead(mr);
+    }
+
+    // The QV of a site, from its mutations scored one at a time
+    UniqueSingleBaseMutationEnumerator mutationEnumerator(tpl);
+    std::vector<int> expected;
+    for (size_t pos = 0; pos < tpl.length(); pos++) {
+        double scoreSum = 0.0;
+        foreach (const Mutation& m, mutationEnumerator.Mutations(pos, pos + 1)) {
+            scoreSum += std::exp(static_cast<double>(mms.FastScore(m)));
+        }
+        double pError = 1.0 - 1.0 / (1.0 + scoreSum);
+        expected.push_back(
+            pError <= 0.0 ? 93 : std::min(93, static_cast<int>(round(-10.0 * log10(pError)))));
+    }
+
+    EXPECT_EQ(expected, ConsensusQVs(mms));
+    mms.SetNumThreads(3);
+    EXPECT_EQ(expected, ConsensusQVs(mms));
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, BatchScoringMatchesSingle)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+    std::reverse(muts.begin(), muts.end());
+
+    // A tight fast-score threshold exercises the early rejection paths
+    QuiverConfig tightConfig(TestingParams(), ALL_MOVES, BandingOptions(4, 200), -2);
+    QuiverConfigTable tightConfigs;
+    tightConfigs.InsertDefault(tightConfig);
+
+    for (int trial = 0; trial < 4; trial++) {
+        MMS mScorer(trial < 2 ? this->testingConfigs_ : tightConfigs, tpl);
+        mScorer.SetNumThreads(trial % 2 == 0 ? 1 : 3);
+        foreach (const MappedRead& mr, AssortedMappedReads(tpl, 21)) {
+            mScorer.AddRead(mr);
+        }
+        const int nReads = mScorer.NumReads();
+
+        std::vector<float> scores = mScorer.ScoreMany(muts);
+        std::vector<float> fastScores = mScorer.FastScoreMany(muts);
+        std::vector<float> scoresByRead = mScorer.ScoresMany(muts, -1.0f);
+        ASSERT_EQ(muts.size(), scores.size());
+        ASSERT_EQ(muts.size(), fastScores.size());
+        ASSERT_EQ(muts.size() * nReads, scoresByRead.size());
+
+        for (size_t i = 0; i < muts.size(); i++) {
+            EXPECT_EQ(mScorer.Score(muts[i]), scores[i]);
+            EXPECT_EQ(mScorer.FastScore(muts[i]), fastScores[i]);
+            EXPECT_EQ(mScorer.Scores(muts[i], -1.0f),
+                      std::vector<float>(scoresByRead.begin() + i * nReads,
+                                         scoresByRead.begin() + (i + 1) * nReads));
+        }
+    }
+
+    MMS emptyScorer(this->testingConfigs_, tpl);
+    EXPECT_EQ(std::vector<float>(muts.size(), 0.0f), emptyScorer.ScoreMany(muts));
+    EXPECT_TRUE(emptyScorer.ScoresMany(muts).empty());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, ScoringVisitsOnlyOverlappingReads)
+{
+    std::string unit = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    std::string tpl = unit + ReverseComplement(unit) + unit.substr(0, 36);
+
+    // Short reads tiling the template, added out of template order;
+    // enough of them that most mutations are near only a few
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < 20; i++) {
+        int tStart = ((i * 3) % 20) * 8;
+        int tEnd = std::min(static_cast<int>(tpl.length()), tStart + 14);
+        std::string seq = tpl.substr(tStart, tEnd - tStart);
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        reads.push_back(AnonymousMappedRead(seq, strand, tStart, tEnd));
+    }
+
+    for (int trial = 0; trial < 2; trial++) {
+        MMS mms(this->testingConfigs_, tpl);
+        mms.SetNumThreads(trial == 0 ? 1 : 3);
+        // Each read on its own, to score by brute force
+        std::vector<boost::shared_ptr<MMS> > singles;
+        foreach (const MappedRead& mr, reads) {
+            mms.AddRead(mr);
+            singles.push_back(boost::shared_ptr<MMS>(new MMS(this->testingConfigs_, tpl)));
+            singles.back()->AddRead(mr);
+        }
+
+        for (int round = 0; round < 2; round++) {
+            std::string currentTpl = mms.Template();
+            std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(currentTpl).Mutations();
+            std::vector<float> scores = mms.ScoreMany(muts);
+            MMS copy(mms);
+            for (size_t i = 0; i < muts.size(); i++) {
+                float expected = 0;
+                std::vector<float> expectedByRead;
+                foreach (const boost::shared_ptr<MMS>& single, singles) {
+                    float score = single->Scores(muts[i], -1.0f)[0];
+                    expectedByRead.push_back(score);
+                    if (score != -1.0f) expected += score;
+                }
+                EXPECT_EQ(expected, mms.Score(muts[i]));
+                EXPECT_EQ(expected, scores[i]);
+                EXPECT_EQ(expected, copy.Score(muts[i]));
+                EXPECT_EQ(expectedByRead, mms.Scores(muts[i], -1.0f));
+            }
+
+            // Move the reads' extents, and score again
+            std::vector<Mutation> edits;
+            edits.push_back(Mutation(DELETION, 5, '-'));
+            edits.push_back(Mutation(INSERTION, 30, 'T'));
+            mms.ApplyMutations(edits);
+            foreach (const boost::shared_ptr<MMS>& single, singles) {
+                single->ApplyMutations(edits);
+            }
+        }
+    }
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, RefineConsensusRepairsScatteredErrors)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    // Errors far apart, and a cluster that takes more than one round
+    std::vector<Mutation> errors;
+    errors += Mutation(SUBSTITUTION, 5, 'G'), Mutation(DELETION, 20, '-'),
+        Mutation(INSERTION, 33, 'T'), Mutation(SUBSTITUTION, 40, 'T'),
+        Mutation(SUBSTITUTION, 41, 'C'), Mutation(SUBSTITUTION, 52, 'A');
+    std::string draft = ApplyMutations(errors, truth);
+
+    MMS mms(this->testingConfigs_, draft);
+    for (int i = 0; i < 6; i++) {
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        std::string seq = (strand == FORWARD_STRAND) ? truth : ReverseComplement(truth);
+        mms.AddRead(AnonymousMappedRead(seq, strand, 0, draft.length()));
+    }
+
+    EXPECT_TRUE(RefineConsensus(mms));
+    EXPECT_EQ(truth, mms.Template());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, RefineConsensusBatchCostliestFirst)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    std::vector<Mutation> errors;
+    errors += Mutation(SUBSTITUTION, 5, 'G'), Mutation(DELETION, 20, '-'),
+        Mutation(INSERTION, 33, 'T');
+    std::string draft = ApplyMutations(errors, truth);
+
+    // One window deep enough to be split over the threads, and shallow
+    // ones, each refined in the batch and on its own
+    std::vector<boost::shared_ptr<MMS> > batched, alone;
+    std::vector<AbstractMultiReadMutationScorer*> batch;
+    for (int w = 0; w < 6; w++) {
+        int numReads = (w == 2) ? 24 : 2;
+        for (int copy = 0; copy < 2; copy++) {
+            boost::shared_ptr<MMS> mms(new MMS(this->testingConfigs_, draft));
+            for (int i = 0; i < numReads; i++) {
+                StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+                std::string seq = (strand == FORWARD_STRAND) ? truth : ReverseComplement(truth);
+                mms->AddRead(AnonymousMappedRead(seq, strand, 0, draft.length()));
+            }
+            (copy == 0 ? batched : alone).push_back(mms);
+        }
+        batch.push_back(batched.back().get());
+    }
+    EXPECT_LT(10 * RefineCost(*batched[0]), RefineCost(*batched[2]));
+
+    std::vector<bool> converged = RefineConsensusBatch(batch, DefaultRefineOptions, 3);
+    ASSERT_EQ(batch.size(), converged.size());
+    for (size_t w = 0; w < batch.size(); w++) {
+        EXPECT_EQ(RefineConsensus(*alone[w]), converged[w]);
+        EXPECT_EQ(alone[w]->Template(), batched[w]->Template());
+        EXPECT_EQ(1, batched[w]->NumThreads());
+    }
+    EXPECT_EQ(truth, batched[2]->Template());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, RefineConsensusFromPileup)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    std::vector<Mutation> errors;
+    errors += Mutation(SUBSTITUTION, 5, 'G'), Mutation(DELETION, 20, '-'),
+        Mutation(INSERTION, 33, 'T'), Mutation(SUBSTITUTION, 40, 'T'),
+        Mutation(SUBSTITUTION, 52, 'A');
+    std::string draft = ApplyMutations(errors, truth);
+
+    // one read has an error of its own, which is not proposed
+    char readError = (truth[15] == 'A' ? 'C' : 'A');
+    MMS mms(this->testingConfigs_, draft);
+    for (int i = 0; i < 6; i++) {
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        std::string seq = (strand == FORWARD_STRAND) ? truth : ReverseComplement(truth);
+        if (i == 0) seq[15] = readError;
+        mms.AddRead(AnonymousMappedRead(seq, strand, 0, draft.length()));
+    }
+
+    // the reads' fixes, plus the homopolymer length changes, are a
+    // small part of what UniqueSingleBaseMutationEnumerator proposes
+    std::vector<Mutation> candidates = PileupMutationEnumerator(mms, 2).Mutations();
+    std::vector<Mutation> all = UniqueSingleBaseMutationEnumerator(draft).Mutations();
+    EXPECT_LT(5 * candidates.size(), all.size());
+    foreach (const Mutation& m, candidates) {
+        EXPECT_TRUE(std::find(all.begin(), all.end(), m) != all.end()) << m;
+    }
+    EXPECT_TRUE(std::find(candidates.begin(), candidates.end(),
+                          Mutation(SUBSTITUTION, 5, truth[5])) != candidates.end());
+    EXPECT_TRUE(std::find(candidates.begin(), candidates.end(),
+                          Mutation(SUBSTITUTION, 15, readError)) == candidates.end());
+
+    RefineOptions opts = DefaultRefineOptions;
+    opts.MinPileupSupport = 2;
+    EXPECT_TRUE(RefineConsensus(mms, opts));
+    EXPECT_EQ(truth, mms.Template());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, StripedBatchScoringMatchesSerial)
+{
+    // A template many reads long, so the batch is split into stripes
+    std::string tpl;
+    unsigned int x = 1;
+    for (int j = 0; j < 400; j++) {
+        x = x * 1103515245 + 12345;
+        tpl.push_back("ACGT"[(x >> 16) % 4]);
+    }
+    std::vector<MappedRead> reads;
+    for (int tStart = 0; tStart + 30 <= static_cast<int>(tpl.length()); tStart += 15) {
+        std::string seq = tpl.substr(tStart, 30);
+        seq[(tStart * 7) % 30] = 'A';
+        StrandEnum strand = (tStart % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        reads.push_back(AnonymousMappedRead(seq, strand, tStart, tStart + 30));
+    }
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+    std::reverse(muts.begin(), muts.end());
+
+    QuiverConfig tightConfig(TestingParams(), ALL_MOVES, BandingOptions(4, 200), -2);
+    QuiverConfigTable tightConfigs;
+    tightConfigs.InsertDefault(tightConfig);
+
+    for (int trial = 0; trial < 2; trial++) {
+        MMS serial(trial == 0 ? this->testingConfigs_ : tightConfigs, tpl);
+        foreach (const MappedRead& mr, reads) {
+            serial.AddRead(mr);
+        }
+        MMS striped(serial);
+        striped.SetNumThreads(3);
+
+        std::vector<float> scores = striped.ScoreMany(muts);
+        std::vector<float> fastScores = striped.FastScoreMany(muts);
+        std::vector<float> scoresByRead = striped.ScoresMany(muts, -1.0f);
+        const int nReads = serial.NumReads();
+        for (size_t i = 0; i < muts.size(); i++) {
+            EXPECT_EQ(serial.Score(muts[i]), scores[i]);
+            EXPECT_EQ(serial.FastScore(muts[i]), fastScores[i]);
+            EXPECT_EQ(serial.Scores(muts[i], -1.0f),
+                      std::vector<float>(scoresByRead.begin() + i * nReads,
+                                         scoresByRead.begin() + (i + 1) * nReads));
+        }
+    }
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, MemoryBudgetDropsCostliestReads)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::vector<MappedRead> reads = AssortedMappedReads(tpl, 10);
+
+    MMS unbounded(this->testingConfigs_, tpl);
+    foreach (const MappedRead& mr, reads) {
+        unbounded.AddRead(mr);
+    }
+    EXPECT_TRUE(unbounded.DroppedReads().empty());
+    std::vector<int> entries = unbounded.AllocatedMatrixEntries();
+    int64_t totalBytes = 0;
+    std::vector<double> costPerBase;
+    for (size_t r = 0; r < reads.size(); r++) {
+        totalBytes += entries[r] * SparseMatrix::EntryBytes();
+        costPerBase.push_back(entries[r] * SparseMatrix::EntryBytes() /
+                              static_cast<double>(reads[r].TemplateEnd - reads[r].TemplateStart));
+    }
+    int64_t budget = totalBytes / 2;
+
+    // Enforced as reads arrive
+    MMS bounded(this->testingConfigs_, tpl);
+    bounded.SetMemoryBudget(budget);
+    EXPECT_EQ(budget, bounded.MemoryBudget());
+    foreach (const MappedRead& mr, reads) {
+        bounded.AddRead(mr);
+    }
+    ASSERT_EQ(static_cast<int>(reads.size()), bounded.NumReads());
+    std::vector<int> dropped = bounded.DroppedReads();
+    EXPECT_FALSE(dropped.empty());
+    std::vector<int> keptEntries = bounded.AllocatedMatrixEntries();
+    int64_t keptBytes = 0;
+    for (int r = 0; r < bounded.NumReads(); r++) {
+        bool wasDropped = std::find(dropped.begin(), dropped.end(), r) != dropped.end();
+        EXPECT_EQ(wasDropped, bounded.Read(r) == NULL);
+        keptBytes += keptEntries[r] * SparseMatrix::EntryBytes();
+    }
+    EXPECT_LE(keptBytes, budget);
+
+    // Enforced over all the reads at once, the costliest per base go
+    MMS late(unbounded);
+    late.SetMemoryBudget(budget);
+    dropped = late.DroppedReads();
+    EXPECT_FALSE(dropped.empty());
+    double maxKeptCost = 0, minDroppedCost = 1e30;
+    for (int r = 0; r < late.NumReads(); r++) {
+        if (late.Read(r) == NULL) {
+            minDroppedCost = std::min(minDroppedCost, costPerBase[r]);
+        } else {
+            maxKeptCost = std::max(maxKeptCost, costPerBase[r]);
+        }
+    }
+    EXPECT_LE(maxKeptCost, minDroppedCost);
+    EXPECT_EQ(unbounded.NumReads() - static_cast<int>(dropped.size()),
+              static_cast<int>(late.BaselineScores().size()));
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, ReleasedReadsKeepTheirIndices)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::vector<MappedRead> reads = AssortedMappedReads(tpl, 6);
+
+    // Reads 1 and 4 are rejected, and let go of
+    MMS mms(this->testingConfigs_, tpl);
+    MMS all(this->testingConfigs_, tpl);
+    for (int r = 0; r < 6; r++) {
+        EXPECT_EQ(r != 1 && r != 4, mms.AddRead(reads[r], (r == 1 || r == 4) ? 0.0f : 1.0f));
+        all.AddRead(reads[r], 1.0f);
+    }
+    ASSERT_EQ(6, mms.NumReads());
+    std::vector<int> entries = mms.AllocatedMatrixEntries();
+    std::vector<int> allEntries = all.AllocatedMatrixEntries();
+    ASSERT_EQ(6u, entries.size());
+    for (int r = 0; r < 6; r++) {
+        bool kept = r != 1 && r != 4;
+        EXPECT_EQ(kept, mms.Read(r) != NULL);
+        EXPECT_EQ(kept, mms.AlphaMatrix(r) != NULL);
+        EXPECT_EQ(kept ? allEntries[r] : 0, entries[r]);
+    }
+
+    // The kept reads' scores land at their own indices
+    std::vector<Mutation> muts;
+    muts.push_back(Mutation(SUBSTITUTION, 12, 'C'));
+    muts.push_back(Mutation(DELETION, 20, '-'));
+    std::vector<float> many = mms.ScoresMany(muts, -1.0f);
+    std::vector<float> allMany = all.ScoresMany(muts, -1.0f);
+    ASSERT_EQ(12u, many.size());
+    for (int i = 0; i < 2; i++) {
+        std::vector<float> scores = mms.Scores(muts[i], -1.0f);
+        std::vector<float> allScores = all.Scores(muts[i], -1.0f);
+        ASSERT_EQ(6u, scores.size());
+        for (int r = 0; r < 6; r++) {
+            float expected = (r == 1 || r == 4) ? -1.0f : allScores[r];
+            EXPECT_EQ(expected, scores[r]);
+            EXPECT_EQ(expected, many[i * 6 + r]);
+        }
+    }
+
+    // as do later reads', and the copies'
+    MMS copy(mms);
+    copy.AddRead(reads[0]);
+    EXPECT_EQ(7, copy.NumReads());
+    EXPECT_TRUE(copy.Read(6) != NULL);
+    EXPECT_TRUE(copy.Read(4) == NULL);
+    EXPECT_EQ(copy.Scores(muts[0])[0], copy.Scores(muts[0])[6]);
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, CoverageCapKeepsBestReadsAsActive)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::string deleted = tpl;
+    deleted.erase(17, 1);
+    std::vector<MappedRead> reads;
+    reads.push_back(AnonymousMappedRead(tpl.substr(0, 20), FORWARD_STRAND, 0, 20));
+    reads.push_back(AnonymousMappedRead(deleted, FORWARD_STRAND, 0, 40));
+    reads.push_back(AnonymousMappedRead(tpl, FORWARD_STRAND, 0, 40));
+    reads.push_back(AnonymousMappedRead(tpl.substr(20, 20), FORWARD_STRAND, 20, 40));
+    reads.push_back(AnonymousMappedRead(ReverseComplement(tpl), REVERSE_STRAND, 0, 40));
+
+    // The exact spanning reads are preferred to the one with a
+    // deletion, and that to the partial reads
+    MMS mms(this->testingConfigs_, tpl);
+    mms.SetCoverageCap(2);
+    EXPECT_EQ(2, mms.CoverageCap());
+    EXPECT_EQ(2, mms.AddReads(reads));
+    ASSERT_EQ(5, mms.NumReads());
+    EXPECT_TRUE(mms.Read(2) != NULL);
+    EXPECT_TRUE(mms.Read(4) != NULL);
+    std::vector<int> standbys;
+    standbys.push_back(1);
+    standbys.push_back(0);
+    standbys.push_back(3);
+    EXPECT_EQ(standbys, mms.StandbyReads());
+    EXPECT_EQ(2, static_cast<int>(mms.BaselineScores().size()));
+
+    // Raising the cap activates standbys where they are needed
+    mms.SetCoverageCap(3);
+    EXPECT_TRUE(mms.Read(1) != NULL);
+    standbys.erase(standbys.begin());
+    EXPECT_EQ(standbys, mms.StandbyReads());
+
+    // Reads added singly are kept aside once the cap is met
+    EXPECT_FALSE(mms.AddRead(reads[0]));
+    standbys.push_back(5);
+    EXPECT_EQ(standbys, mms.StandbyReads());
+
+    // The active reads score as they would alone
+    MMS alone(this->testingConfigs_, tpl);
+    alone.AddRead(reads[1]);
+    alone.AddRead(reads[2]);
+    alone.AddRead(reads[4]);
+    EXPECT_FLOAT_EQ(alone.BaselineScore(), mms.BaselineScore());
+    Mutation m(SUBSTITUTION, 10, 'G');
+    EXPECT_FLOAT_EQ(alone.Score(m), mms.Score(m));
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, BatchedAddReadsMatchesSingleAdds)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA";
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < 12; i++) {
+        int tStart = (i % 4) * 11;
+        int tEnd = std::min(static_cast<int>(tpl.length()), tStart + 30 - i);
+        std::string seq = tpl.substr(tStart, tEnd - tStart);
+        seq[(i * 5) % seq.length()] = "ACGT"[i % 4];
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        reads.push_back(AnonymousMappedRead(seq, strand, tStart, tEnd));
+    }
+
+    MMS single(this->testingConfigs_, tpl);
+    foreach (const MappedRead& mr, reads) {
+        single.AddRead(mr);
+    }
+    for (int nThreads = 1; nThreads <= 3; nThreads += 2) {
+        MMS batched(this->testingConfigs_, tpl);
+        batched.SetNumThreads(nThreads);
+        EXPECT_EQ(static_cast<int>(single.BaselineScores().size()), batched.AddReads(reads));
+        ASSERT_EQ(single.NumReads(), batched.NumReads());
+        EXPECT_EQ(single.BaselineScores(), batched.BaselineScores());
+        Mutation m(SUBSTITUTION, 21, 'A');
+        EXPECT_FLOAT_EQ(single.Score(m), batched.Score(m));
+    }
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, CappedAddReadsInWavesMatchSingleAdds)
+{
+    // Reads of decreasing extent, so offered in the order given, every
+    // fourth of them garbage that overfills its band and is rejected
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA";
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < 20; i++) {
+        int tStart = (i * 3) % 15;
+        int tEnd = tStart + 40 - i;
+        std::string seq = tpl.substr(tStart, tEnd - tStart);
+        if (i % 4 == 1) {
+            for (size_t k = 0; k < seq.length(); k++) {
+                seq[k] = "ACGT"[(k * k + i) % 4];
+            }
+        }
+        reads.push_back(AnonymousMappedRead(seq, FORWARD_STRAND, tStart, tEnd));
+    }
+    QuiverConfig tight(TestingParams(), ALL_MOVES, BandingOptions(4, 12), -12.5, 0.3f);
+    QuiverConfigTable configs;
+    configs.InsertDefault(tight);
+
+    MMS single(configs, tpl);
+    single.SetCoverageCap(3);
+    foreach (const MappedRead& mr, reads) {
+        single.AddRead(mr);
+    }
+    int rejected = 0;
+    for (int r = 0; r < single.NumReads(); r++) {
+        std::vector<int> standbys = single.StandbyReads();
+        bool standby = std::find(standbys.begin(), standbys.end(), r) != standbys.end();
+        rejected += single.Read(r) == NULL && !standby;
+    }
+    EXPECT_GT(rejected, 0);
+
+    for (int nThreads = 1; nThreads <= 3; nThreads += 2) {
+        MMS batched(configs, tpl);
+        batched.SetCoverageCap(3);
+        batched.SetNumThreads(nThreads);
+        EXPECT_EQ(static_cast<int>(single.BaselineScores().size()), batched.AddReads(reads));
+        EXPECT_EQ(single.StandbyReads(), batched.StandbyReads());
+        for (int r = 0; r < single.NumReads(); r++) {
+            EXPECT_EQ(single.Read(r) != NULL, batched.Read(r) != NULL);
+        }
+        EXPECT_EQ(single.BaselineScores(), batched.BaselineScores());
+    }
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, CachedScoresMatchFreshOnes)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA";
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < 6; i++) {
+        int tStart = (i % 3) * 18;
+        int tEnd = std::min(static_cast<int>(tpl.length()), tStart + 24);
+        std::string seq = tpl.substr(tStart, tEnd - tStart);
+        seq[(i * 7) % seq.length()] = "ACGT"[i % 4];
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        reads.push_back(AnonymousMappedRead(seq, strand, tStart, tEnd));
+    }
+
+    MMS cached(this->testingConfigs_, tpl);
+    MMS uncached(this->testingConfigs_, tpl);
+    EXPECT_TRUE(cached.ScoreCaching());
+    uncached.SetScoreCaching(false);
+    EXPECT_FALSE(uncached.ScoreCaching());
+    foreach (const MappedRead& mr, reads) {
+        cached.AddRead(mr);
+        uncached.AddRead(mr);
+    }
+
+    // Scoring twice, and across an edit touching only some of the
+    // reads, gives the scores computed afresh
+    std::vector<Mutation> edit(1, Mutation(SUBSTITUTION, 5, 'C'));
+    for (int round = 0; round < 3; round++) {
+        std::vector<Mutation> muts =
+            UniqueSingleBaseMutationEnumerator(cached.Template()).Mutations();
+        foreach (const Mutation& m, muts) {
+            ASSERT_EQ(uncached.Scores(m), cached.Scores(m));
+        }
+        EXPECT_EQ(uncached.ScoresMany(muts), cached.ScoresMany(muts));
+        EXPECT_EQ(uncached.FastScoreMany(muts), cached.FastScoreMany(muts));
+        if (round == 1) {
+            cached.ApplyMutations(edit);
+            uncached.ApplyMutations(edit);
+        }
+    }
+    EXPECT_EQ(uncached.BaselineScores(), cached.BaselineScores());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, ScorerCacheReusesOverlappingWindows)
+{
+    // Two windows overlapping in tpl[20, 57), and reads within the
+    // overlap, some added twice
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCAGGTCCA";
+    std::string left = tpl.substr(0, 57);
+    std::string right = tpl.substr(20);
+    std::vector<MappedRead> leftReads, rightReads;
+    for (int i = 0; i < 4; i++) {
+        int tStart = 20 + i * 4;
+        int tEnd = 57 - i * 3;
+        std::string seq = tpl.substr(tStart, tEnd - tStart);
+        seq[(i * 7) % seq.length()] = "ACGT"[i % 4];
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        leftReads.push_back(AnonymousMappedRead(seq, strand, tStart, tEnd));
+        rightReads.push_back(AnonymousMappedRead(seq, strand, tStart - 20, tEnd - 20));
+    }
+
+    boost::shared_ptr<ReadScorerCache<MS> > cache(new ReadScorerCache<MS>(16));
+    MMS cachedLeft(this->testingConfigs_, left);
+    MMS cachedRight(this->testingConfigs_, right);
+    MMS uncachedRight(this->testingConfigs_, right);
+    cachedLeft.SetScorerCache(cache);
+    cachedRight.SetScorerCache(cache);
+    EXPECT_EQ(cache, cachedRight.ScorerCache());
+    EXPECT_FALSE(uncachedRight.ScorerCache());
+
+    cachedLeft.AddReads(leftReads);
+    EXPECT_EQ(4, cache->Size());
+    EXPECT_EQ(0, cache->Hits());
+    foreach (const MappedRead& mr, rightReads) {
+        cachedRight.AddRead(mr);
+        uncachedRight.AddRead(mr);
+    }
+    EXPECT_EQ(4, cache->Hits());
+    EXPECT_EQ(4, cache->Size());
+
+    // The same read against another slice, or with other QVs, misses
+    MappedRead shifted(rightReads[0]);
+    shifted.TemplateStart++;
+    cachedRight.AddRead(shifted);
+    uncachedRight.AddRead(shifted);
+    std::vector<float> qvs(rightReads[1].Length(), 10.0f);
+    std::vector<float> tags(rightReads[1].Length(), 'N');
+    QvSequenceFeatures features(rightReads[1].Features.Sequence().ToString(), &qvs[0],
+                                &qvs[0], &qvs[0], &tags[0], &qvs[0]);
+    MappedRead requalified(Read(features, "anonymous", "unknown"), rightReads[1].Strand,
+                           rightReads[1].TemplateStart, rightReads[1].TemplateEnd);
+    cachedRight.AddRead(requalified);
+    uncachedRight.AddRead(requalified);
+    EXPECT_EQ(4, cache->Hits());
+    EXPECT_EQ(6, cache->Size());
+
+    // The reused matrices score as fresh ones do, and are unchanged by
+    // the edits of the scorers sharing them
+    std::vector<Mutation> edit(1, Mutation(SUBSTITUTION, 12, 'C'));
+    for (int round = 0; round < 2; round++) {
+        EXPECT_EQ(uncachedRight.BaselineScores(), cachedRight.BaselineScores());
+        std::vector<Mutation> muts =
+            UniqueSingleBaseMutationEnumerator(cachedRight.Template()).Mutations();
+        EXPECT_EQ(uncachedRight.ScoresMany(muts), cachedRight.ScoresMany(muts));
+        cachedRight.ApplyMutations(edit);
+        uncachedRight.ApplyMutations(edit);
+    }
+    MMS uncachedLeft(this->testingConfigs_, left);
+    uncachedLeft.AddReads(leftReads);
+    EXPECT_EQ(uncachedLeft.BaselineScores(), cachedLeft.BaselineScores());
+
+    cache->Clear();
+    EXPECT_EQ(0, cache->Size());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, SavedScorersRestoreTheirState)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA";
+    std::vector<MappedRead> reads = AssortedMappedReads(tpl, 8);
+    MMS mms(this->testingConfigs_, tpl);
+    mms.SetCoverageCap(3);
+    mms.AddReads(reads);
+    std::vector<Mutation> muts;
+    muts.push_back(Mutation(SUBSTITUTION, 21, 'A'));
+    muts.push_back(Mutation(INSERTION, 30, 'T'));
+    mms.ApplyMutations(muts);
+
+    std::string filename = "/tmp/scorer." + std::to_string(getpid()) + ".ccscore";
+    mms.Save(filename);
+    boost::scoped_ptr<MMS> restored(MMS::Restore(this->testingConfigs_, filename));
+    EXPECT_EQ(mms.Template(), restored->Template());
+    EXPECT_EQ(mms.Template(REVERSE_STRAND), restored->Template(REVERSE_STRAND));
+    ASSERT_EQ(mms.NumReads(), restored->NumReads());
+    for (int k = 0; k < mms.NumReads(); k++) {
+        EXPECT_EQ(mms.Read(k) == NULL, restored->Read(k) == NULL);
+    }
+    EXPECT_EQ(mms.StandbyReads(), restored->StandbyReads());
+    EXPECT_EQ(3, restored->CoverageCap());
+    EXPECT_EQ(mms.BaselineScores(), restored->BaselineScores());
+    EXPECT_EQ(mms.UsedMatrixEntries(), restored->UsedMatrixEntries());
+    std::vector<FillStatistics> stats = mms.FillStats();
+    std::vector<FillStatistics> restoredStats = restored->FillStats();
+    ASSERT_EQ(stats.size(), restoredStats.size());
+    for (size_t k = 0; k < stats.size(); k++) {
+        EXPECT_EQ(stats[k].Passes, restoredStats[k].Passes);
+        EXPECT_EQ(stats[k].FlipFlops, restoredStats[k].FlipFlops);
+        EXPECT_EQ(stats[k].AlphaUsedEntries, restoredStats[k].AlphaUsedEntries);
+        EXPECT_EQ(stats[k].AlphaAllocatedEntries, restoredStats[k].AlphaAllocatedEntries);
+        EXPECT_EQ(stats[k].BetaUsedEntries, restoredStats[k].BetaUsedEntries);
+        EXPECT_EQ(stats[k].BetaAllocatedEntries, restoredStats[k].BetaAllocatedEntries);
+        EXPECT_EQ(stats[k].Seconds, restoredStats[k].Seconds);
+    }
+    for (int pos = 2; pos < static_cast<int>(tpl.length()) - 2; pos += 5) {
+        Mutation m(SUBSTITUTION, pos, 'C');
+        EXPECT_EQ(mms.Score(m), restored->Score(m));
+        EXPECT_EQ(mms.Scores(m), restored->Scores(m));
+    }
+
+    // The restored scorer goes on as the original does
+    std::vector<Mutation> more;
+    more.push_back(Mutation(DELETION, 12, '-'));
+    mms.ApplyMutations(more);
+    restored->ApplyMutations(more);
+    EXPECT_EQ(mms.BaselineScores(), restored->BaselineScores());
+
+    // A negative read index, after the 64-byte header and the padded
+    // work unit, is refused
+    {
+        std::FILE* f = std::fopen(filename.c_str(), "r+b");
+        ASSERT_TRUE(f != NULL);
+        uint64_t unitBytes = 0;
+        int32_t negative = -1;
+        EXPECT_EQ(0, std::fseek(f, 16, SEEK_SET));
+        EXPECT_EQ(1u, std::fread(&unitBytes, sizeof(unitBytes), 1, f));
+        EXPECT_EQ(0, std::fseek(f, 64 + (unitBytes + 7) / 8 * 8, SEEK_SET));
+        EXPECT_EQ(1u, std::fwrite(&negative, sizeof(negative), 1, f));
+        std::fclose(f);
+    }
+    EXPECT_THROW(MMS::Restore(this->testingConfigs_, filename), InvalidInputError);
+
+    // Truncated and foreign files are refused
+    EXPECT_EQ(0, truncate(filename.c_str(), 100));
+    EXPECT_THROW(MMS::Restore(this->testingConfigs_, filename), InvalidInputError);
+    std::remove(filename.c_str());
+    EXPECT_THROW(MMS::Restore(this->testingConfigs_, filename), InvalidInputError);
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, HibernatingScorersWakeToTheSameScores)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA";
+    std::vector<MappedRead> reads = AssortedMappedReads(tpl, 8);
+    MMS mms(this->testingConfigs_, tpl);
+    mms.SetScoreCaching(false);
+    mms.AddReads(reads);
+    std::vector<float> baselines = mms.BaselineScores();
+    std::vector<int> used = mms.UsedMatrixEntries();
+    std::vector<Mutation> muts;
+    std::vector<float> scores;
+    for (int pos = 2; pos < static_cast<int>(tpl.length()) - 2; pos += 5) {
+        muts.push_back(Mutation(SUBSTITUTION, pos, 'C'));
+        scores.push_back(mms.Score(muts.back()));
+    }
+
+    mms.Hibernate();
+    EXPECT_TRUE(mms.IsHibernating());
+    EXPECT_EQ(0, mms.Memory().MatrixBytes);
+    EXPECT_EQ(std::vector<int>(mms.NumReads(), 0), mms.UsedMatrixEntries());
+    EXPECT_EQ(baselines, mms.BaselineScores());
+
+    // Scoring wakes the scorer, refilled within the bands it had
+    for (size_t k = 0; k < muts.size(); k++) {
+        EXPECT_NEAR(scores[k], mms.Score(muts[k]),
+                    1e-3 * static_cast<double>(std::max(1.0f, std::fabs(scores[k]))));
+        EXPECT_FALSE(mms.IsHibernating());
+    }
+    EXPECT_EQ(used, mms.UsedMatrixEntries());
+    EXPECT_GT(mms.Memory().MatrixBytes, 0);
+
+    // It goes on as a scorer never hibernated does, copies included
+    MMS awake(this->testingConfigs_, tpl);
+    awake.AddReads(reads);
+    mms.Hibernate();
+    MMS copy(mms);
+    EXPECT_TRUE(copy.IsHibernating());
+    std::vector<Mutation> applied(1, Mutation(INSERTION, 30, 'T'));
+    awake.ApplyMutations(applied);
+    mms.ApplyMutations(applied);
+    copy.ApplyMutations(applied);
+    for (int k = 0; k < mms.NumReads(); k++) {
+        EXPECT_NEAR(awake.BaselineScores()[k], mms.BaselineScores()[k], 1e-2);
+        EXPECT_NEAR(awake.BaselineScores()[k], copy.BaselineScores()[k], 1e-2);
+    }
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, ArrayEntryPointsMatchTheVectorOnes)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA";
+    MMS mms(this->testingConfigs_, tpl);
+    mms.AddReads(AssortedMappedReads(tpl, 6));
+    Mutation m(SUBSTITUTION, 20, 'C');
+
+    float* scores;
+    int nScores;
+    mms.ScoresArray(m, -1.0f, &scores, &nScores);
+    EXPECT_EQ(mms.Scores(m, -1.0f), std::vector<float>(scores, scores + nScores));
+    free(scores);
+    mms.BaselineScoresArray(&scores, &nScores);
+    EXPECT_EQ(mms.BaselineScores(), std::vector<float>(scores, scores + nScores));
+    free(scores);
+
+    int* entries;
+    int nEntries;
+    mms.UsedMatrixEntriesArray(&entries, &nEntries);
+    EXPECT_EQ(mms.UsedMatrixEntries(), std::vector<int>(entries, entries + nEntries));
+    free(entries);
+    mms.AllocatedMatrixEntriesArray(&entries, &nEntries);
+    EXPECT_EQ(mms.AllocatedMatrixEntries(), std::vector<int>(entries, entries + nEntries));
+    free(entries);
+
+    std::vector<Mutation> muts;
+    muts.push_back(m);
+    muts.push_back(Mutation(DELETION, 5, '-'));
+    muts.push_back(Mutation(INSERTION, 40, 'G'));
+    std::vector<float> into(muts.size() * mms.NumReads());
+    mms.ScoresManyInto(muts, -1.0f, &into[0], muts.size(), mms.NumReads());
+    EXPECT_EQ(mms.ScoresMany(muts, -1.0f), into);
+    EXPECT_THROW(mms.ScoresManyInto(muts, -1.0f, &into[0], muts.size(), mms.NumReads() - 1),
+                 InvalidInputError);
+
+    int* qvs;
+    int nQvs;
+    ConsensusQVsArray(mms, &qvs, &nQvs);
+    EXPECT_EQ(ConsensusQVs(mms), std::vector<int>(qvs, qvs + nQvs));
+    free(qvs);
+    int nMuts, nReads;
+    MutationScoresMatrixArray(mms, &scores, &nMuts, &nReads);
+    EXPECT_EQ(mms.NumReads(), nReads);
+    EXPECT_EQ(MutationScoresMatrix(mms), std::vector<float>(scores, scores + nMuts * nReads));
+    free(scores);
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, ParallelArraysScoreAsMutationsDo)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTACCATGACTTAGCA";
+    MMS mms(this->testingConfigs_, tpl);
+    mms.AddReads(AssortedMappedReads(tpl, 6));
+    std::vector<Mutation> muts;
+    muts.push_back(Mutation(SUBSTITUTION, 20, 'C'));
+    muts.push_back(Mutation(DELETION, 5, 7, ""));
+    muts.push_back(Mutation(INSERTION, 40, 40, "GA"));
+    muts.push_back(Mutation(SUBSTITUTION, 30, 32, "TC"));
+
+    std::vector<int> types, starts, ends, counts;
+    std::string bases;
+    foreach (const Mutation& m, muts) {
+        types.push_back(m.Type());
+        starts.push_back(m.Start());
+        ends.push_back(m.End());
+        counts.push_back(m.NewBases().length());
+        bases += m.NewBases();
+    }
+    int n = muts.size();
+    std::vector<float> scores(n);
+    mms.ScoreManyArrays(n, &types[0], n, &starts[0], n, &ends[0], n, &counts[0], bases,
+                        &scores[0], n);
+    EXPECT_EQ(mms.ScoreMany(muts), scores);
+    mms.FastScoreManyArrays(n, &types[0], n, &starts[0], n, &ends[0], n, &counts[0], bases,
+                            &scores[0], n);
+    EXPECT_EQ(mms.FastScoreMany(muts), scores);
+    std::vector<float> byRead(n * mms.NumReads());
+    mms.ScoresManyArrays(n, &types[0], n, &starts[0], n, &ends[0], n, &counts[0], bases, -1.0f,
+                         &byRead[0], n, mms.NumReads());
+    EXPECT_EQ(mms.ScoresMany(muts, -1.0f), byRead);
+
+    // The arrays must agree with one another
+    EXPECT_THROW(mms.ScoreManyArrays(n, &types[0], n - 1, &starts[0], n, &ends[0], n, &counts[0],
+                                     bases, &scores[0], n),
+                 InvalidInputError);
+    EXPECT_THROW(mms.ScoreManyArrays(n, &types[0], n, &starts[0], n, &ends[0], n, &counts[0],
+                                     bases + "A", &scores[0], n),
+                 InvalidInputError);
+    types[0] = 7;
+    EXPECT_THROW(mms.ScoreManyArrays(n, &types[0], n, &starts[0], n, &ends[0], n, &counts[0],
+                                     bases, &scores[0], n),
+                 InvalidInputError);
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, FastScoreVisitsBestFittingReadsFirst)
+{
+    QuiverConfig rejecting(TestingParams(), ALL_MOVES, BandingOptions(4, 200), -5);
+    QuiverConfigTable configs;
+    configs.InsertDefault(rejecting);
+
+    // Error-laden reads come first, the exact ones last
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    MMS mms(configs, tpl);
+    for (int i = 0; i < 4; i++) {
+        std::string seq = tpl;
+        for (int k = i; k < static_cast<int>(seq.length()); k += 6) {
+            seq[k] = seq[k] == 'A' ? 'C' : 'A';
+        }
+        mms.AddRead(AnonymousMappedRead(seq, FORWARD_STRAND, 0, tpl.length()));
+    }
+    for (int i = 0; i < 4; i++) {
+        mms.AddRead(AnonymousMappedRead(tpl, FORWARD_STRAND, 0, tpl.length()));
+    }
+
+    MMS pooled(mms);
+    pooled.SetNumThreads(3);
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+    std::vector<float> fastScores = mms.FastScoreMany(muts);
+    std::vector<float> pooledScores = pooled.FastScoreMany(muts);
+    int nRejected = 0;
+    for (size_t i = 0; i < muts.size(); i++) {
+        float fast = mms.FastScore(muts[i]);
+        EXPECT_EQ(fast, fastScores[i]);
+        EXPECT_EQ(fast, pooled.FastScore(muts[i]));
+        EXPECT_EQ(fast, pooledScores[i]);
+        // A mutation is either rejected or summed in full, in read order
+        if (fast < rejecting.FastScoreThreshold) {
+            nRejected++;
+        } else {
+            EXPECT_EQ(mms.Score(muts[i]), fast);
+        }
+    }
+    EXPECT_LT(0, nRejected);
+}
+
+TEST(PoaHandoffTest, PlacedReadsScoreLikeUnhinted)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGATCCAAGTTCAGGTTACACATGATTAC";
+    std::vector<std::string> seqs;
+    seqs.push_back(tpl);
+    seqs.push_back(tpl.substr(0, 30) + "G" + tpl.substr(30));
+    seqs.push_back(tpl.substr(0, 45) + tpl.substr(46));
+    seqs.push_back(tpl.substr(10, 40));
+    const PoaConsensus* pc = PoaConsensus::FindConsensus(seqs, SEMIGLOBAL);
+    ASSERT_EQ(tpl, pc->Sequence);
+
+    QuiverConfigTable configs;
+    configs.InsertDefault(QuiverConfig(TestingParams(), ALL_MOVES, BandingOptions(4, 12), -500));
+    SparseSseQvMultiReadMutationScorer hinted(configs, pc->Sequence);
+    SparseSseQvMultiReadMutationScorer unhinted(configs, pc->Sequence);
+    for (size_t k = 0; k < seqs.size(); k++) {
+        MappedRead mr = pc->ToMappedRead(k, AnonymousRead(seqs[k]));
+        EXPECT_FALSE(mr.BandHint.empty());
+        EXPECT_TRUE(hinted.AddRead(mr));
+        EXPECT_TRUE(unhinted.AddRead(AnonymousMappedRead(seqs[k], FORWARD_STRAND,
+                                                         mr.TemplateStart, mr.TemplateEnd)));
+    }
+    std::vector<float> hintedScores = hinted.BaselineScores();
+    std::vector<float> unhintedScores = unhinted.BaselineScores();
+    for (size_t k = 0; k < seqs.size(); k++) {
+        EXPECT_FLOAT_EQ(unhintedScores[k], hintedScores[k]);
+    }
+
+    // The hints go with the template they were made for
+    std::vector<Mutation> muts;
+    muts.push_back(Mutation(SUBSTITUTION, 20, 'T'));
+    hinted.ApplyMutations(muts);
+    for (size_t k = 0; k < seqs.size(); k++) {
+        EXPECT_TRUE(hinted.Read(k)->BandHint.empty());
+    }
+    delete pc;
+}
+
+TEST(ReadScorerCacheTest, EvictsLeastRecentlyUsed)
+{
+    typedef MutationScorer<SparseSseQvRecursor> ScorerType;
+    QuiverConfig qc(TestingParams(), ALL_MOVES, BandingOptions(4, 200), -500);
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGG";
+    SparseSseQvRecursor recursor(qc.MovesAvailable, qc.Banding);
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < 3; i++) {
+        std::string seq = tpl;
+        seq[i * 5] = 'T';
+        reads.push_back(AnonymousMappedRead(seq, FORWARD_STRAND, 0, tpl.length()));
+    }
+
+    EXPECT_THROW(ReadScorerCache<ScorerType>(0), InvalidInputError);
+    ReadScorerCache<ScorerType> cache(2);
+    EXPECT_EQ(2, cache.Capacity());
+    foreach (const MappedRead& mr, reads) {
+        EXPECT_TRUE(cache.Find(mr, tpl) == NULL);
+        QvEvaluator ev(mr, tpl, qc.QvParams);
+        cache.Insert(mr, tpl, ScorerType(ev, recursor));
+        if (&mr == &reads[1]) {
+            // reads[0] is used again, so reads[1] goes first
+            delete cache.Find(reads[0], tpl);
+        }
+    }
+    EXPECT_EQ(2, cache.Size());
+    EXPECT_EQ(1, cache.Hits());
+    EXPECT_EQ(3, cache.Misses());
+    EXPECT_TRUE(cache.Find(reads[1], tpl) == NULL);
+    boost::scoped_ptr<ScorerType> hit(cache.Find(reads[0], tpl));
+    ASSERT_TRUE(hit != NULL);
+    QvEvaluator ev(reads[0], tpl, qc.QvParams);
+    EXPECT_EQ(ScorerType(ev, recursor).Score(), hit->Score());
+}
+
+TYPED_TEST(MultiReadMutationScorerTest, AdaptiveBandsRescueReads)
+{
+    std::string tpl;
+    for (int k = 0; k < 400; k++) {
+        tpl += "ACGT"[(k * 7 + k / 3 + k * k) % 4];
+    }
+    std::vector<MappedRead> reads = AssortedMappedReads(tpl, 12);
+
+    // Bands too wide for the AddThreshold narrow to fit it
+    QuiverConfig wide(TestingParams(), ALL_MOVES, BandingOptions(4, 50), -500, 0.1f);
+    QuiverConfigTable fixedConfigs;
+    fixedConfigs.InsertDefault(wide);
+    wide.Banding.Adaptive = true;
+    wide.Banding.MinScoreDiff = 0.1f;
+    wide.Banding.MaxScoreDiff = 200;
+    QuiverConfigTable adaptiveConfigs;
+    adaptiveConfigs.InsertDefault(wide);
+
+    MMS fixed(fixedConfigs, tpl), adaptive(adaptiveConfigs, tpl);
+    int fixedAdded = 0, adaptiveAdded = 0;
+    foreach (const MappedRead& mr, reads) {
+        fixedAdded += fixed.AddRead(mr);
+        adaptiveAdded += adaptive.AddRead(mr);
+    }
+    EXPECT_EQ(0, fixedAdded);
+    EXPECT_EQ(12, adaptiveAdded);
+
+    // and bands too narrow to mate alpha and beta widen
+    std::string shortTpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    std::vector<MappedRead> shortReads = AssortedMappedReads(shortTpl, 12);
+    QuiverConfig narrow(TestingParams(), ALL_MOVES, BandingOptions(4, 0.5f), -500);
+    fixedConfigs = QuiverConfigTable();
+    fixedConfigs.InsertDefault(narrow);
+    narrow.Banding.Adaptive = true;
+    narrow.Banding.MinScoreDiff = 0.5f;
+    narrow.Banding.MaxScoreDiff = 200;
+    adaptiveConfigs = QuiverConfigTable();
+    adaptiveConfigs.InsertDefault(narrow);
+    QuiverConfigTable referenceConfigs;
+    referenceConfigs.InsertDefault(TestingConfig());
+
+    MMS narrowFixed(fixedConfigs, shortTpl), narrowAdaptive(adaptiveConfigs, shortTpl);
+    MMS reference(referenceConfigs, shortTpl);
+    fixedAdded = adaptiveAdded = 0;
+    foreach (const MappedRead& mr, shortReads) {
+        fixedAdded += narrowFixed.AddRead(mr);
+        adaptiveAdded += narrowAdaptive.AddRead(mr);
+        reference.AddRead(mr);
+    }
+    EXPECT_LT(fixedAdded, 12);
+    EXPECT_EQ(12, adaptiveAdded);
+    std::vector<float> scores = narrowAdaptive.BaselineScores();
+    std::vector<float> referenceScores = reference.BaselineScores();
+    for (int r = 0; r < 12; r++) {
+        EXPECT_NEAR(referenceScores[r], scores[r], 0.5);
+    }
+}
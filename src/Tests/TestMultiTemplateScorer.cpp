@@ -0,0 +1,177 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/Int16Recursor.hpp>
+#include <ConsensusCore/Quiver/MultiReadMutationScorer.hpp>
+#include <ConsensusCore/Quiver/MultiTemplateScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+// Two haplotypes, differing at three positions
+const std::string HAPLOTYPE_A = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+const std::string HAPLOTYPE_B = "GATTACAGATTACATTGACCAGTCCGGGATCCATTAGACAGGTGAATGCATTGCAGTAACC";
+
+QuiverConfigTable TestingConfigs()
+{
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    return configs;
+}
+
+// Reads of each haplotype, alternating strands, with an error apiece
+std::vector<MappedRead> HaplotypeReads(int numReads)
+{
+    std::vector<MappedRead> reads;
+    for (int i = 0; i < numReads; i++) {
+        std::string seq = (i % 2 == 0) ? HAPLOTYPE_A : HAPLOTYPE_B;
+        seq[(i * 11 + 3) % seq.length()] = "ACGT"[i % 4];
+        StrandEnum strand = (i % 4 < 2) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        Read read(QvSequenceFeatures(seq), "read", "unknown");
+        reads.push_back(MappedRead(read, strand, 0, HAPLOTYPE_A.length()));
+    }
+    return reads;
+}
+
+std::vector<std::string> Haplotypes()
+{
+    std::vector<std::string> templates;
+    templates.push_back(HAPLOTYPE_A);
+    templates.push_back(HAPLOTYPE_B);
+    return templates;
+}
+}
+
+TEST(MultiTemplateScorerTest, ScoresMatchOneScorerPerTemplate)
+{
+    std::vector<MappedRead> reads = HaplotypeReads(8);
+    SparseSseQvMultiTemplateScorer mts(TestingConfigs(), Haplotypes());
+    mts.SetNumThreads(3);
+    mts.AddReads(reads);
+    ASSERT_EQ(8, mts.NumReads());
+    ASSERT_EQ(2, mts.NumTemplates());
+
+    std::vector<float> scores = mts.Scores(0);
+    for (int t = 0; t < 2; t++) {
+        SparseSseQvMultiReadMutationScorer mrms(TestingConfigs(), mts.Template(t));
+        foreach (const MappedRead& mr, reads) {
+            mrms.AddRead(mr);
+        }
+        std::vector<float> baselines = mrms.BaselineScores();
+        for (int r = 0; r < 8; r++) {
+            EXPECT_FLOAT_EQ(baselines[r], scores[r * 2 + t]);
+        }
+
+        Mutation subs(SUBSTITUTION, 23, 'C');
+        Mutation ins(INSERTION, 40, 'T');
+        Mutation del(DELETION, 52, '-');
+        EXPECT_NEAR(mrms.Score(subs), mts.Score(t, subs), 1e-3);
+        EXPECT_NEAR(mrms.Score(ins), mts.Score(t, ins), 1e-3);
+        EXPECT_NEAR(mrms.Score(del), mts.Score(t, del), 1e-3);
+    }
+}
+
+TEST(MultiTemplateScorerTest, AssignsReadsToTheirHaplotypes)
+{
+    SparseSseQvMultiTemplateScorer mts(TestingConfigs(), Haplotypes());
+    mts.AddReads(HaplotypeReads(8));
+    std::vector<int> assignment = mts.AssignReads(1);
+    for (int r = 0; r < 8; r++) {
+        EXPECT_EQ(r % 2, assignment[r]);
+    }
+    // No read is that sure of its haplotype
+    std::vector<int> unsure = mts.AssignReads(1e6);
+    EXPECT_EQ(std::vector<int>(8, -1), unsure);
+
+    // Only the reads given are summed
+    std::vector<int> readsOfA;
+    readsOfA.push_back(0);
+    readsOfA.push_back(2);
+    Mutation toA(SUBSTITUTION, 23, 'A');
+    EXPECT_GT(mts.Score(1, toA, readsOfA), 0);
+    EXPECT_LT(mts.Score(1, toA, std::vector<int>(1, 1)), 0);
+}
+
+TEST(MultiTemplateScorerTest, ApplyingMutationsRefillsTheTemplate)
+{
+    std::vector<MappedRead> reads = HaplotypeReads(6);
+    SparseSseQvMultiTemplateScorer mts(TestingConfigs(), Haplotypes());
+    mts.AddReads(reads);
+    std::vector<float> before = mts.Scores(0);
+
+    std::vector<Mutation> toA;
+    toA.push_back(Mutation(SUBSTITUTION, 23, 'A'));
+    toA.push_back(Mutation(SUBSTITUTION, 43, 'C'));
+    toA.push_back(Mutation(SUBSTITUTION, 57, 'T'));
+    std::vector<float> predicted = mts.ScoreMany(1, toA, std::vector<int>(1, 0));
+    mts.ApplyMutations(1, toA);
+    EXPECT_EQ(HAPLOTYPE_A, mts.Template(1));
+
+    std::vector<float> after = mts.Scores(0);
+    for (int r = 0; r < 6; r++) {
+        EXPECT_FLOAT_EQ(before[r * 2], after[r * 2]);
+        EXPECT_FLOAT_EQ(after[r * 2], after[r * 2 + 1]);
+    }
+    EXPECT_GT(predicted[0], 0);
+    EXPECT_THROW(mts.ApplyMutations(2, toA), InvalidInputError);
+}
+
+// No read's matrices fit, so none has a scorer; each still has its
+// likelihood, as a full fill finds it to within tolerance
+template <typename S>
+void CheckReadsTooBigToHold(float tolerance)
+{
+    QuiverConfigTable tight;
+    QuiverConfig config = TestingConfig();
+    config.AddThreshold = 0.01f;
+    tight.InsertDefault(config);
+    std::vector<MappedRead> reads = HaplotypeReads(4);
+
+    S held(TestingConfigs(), Haplotypes());
+    S unheld(tight, Haplotypes());
+    S unscored(tight, Haplotypes());
+    held.AddReads(reads);
+    unheld.SetScoreUnheldReads(true);
+    EXPECT_EQ(2, unheld.AddRead(reads[0]));
+    unheld.AddReads(std::vector<MappedRead>(reads.begin() + 1, reads.end()));
+    EXPECT_EQ(0, unheld.AllocatedMatrixEntries());
+    EXPECT_EQ(0, unscored.AddRead(reads[0]));
+    unscored.AddReads(std::vector<MappedRead>(reads.begin() + 1, reads.end()));
+
+    std::vector<float> heldScores = held.Scores(0);
+    std::vector<float> unheldScores = unheld.Scores(0);
+    for (size_t k = 0; k < heldScores.size(); k++) {
+        EXPECT_NEAR(heldScores[k], unheldScores[k], tolerance) << k;
+    }
+    EXPECT_EQ(held.AssignReads(1), unheld.AssignReads(1));
+    // Unless asked to, the reads over the AddThreshold are left unscored
+    EXPECT_EQ(std::vector<float>(heldScores.size(), 0), unscored.Scores(0));
+    EXPECT_EQ(std::vector<int>(reads.size(), -1), unscored.AssignReads(1));
+    EXPECT_NE(unscored.AssignReads(1), unheld.AssignReads(1));
+    // Mutations can't be scored without the matrices
+    EXPECT_EQ(0, unheld.Score(0, Mutation(SUBSTITUTION, 23, 'A')));
+}
+
+TEST(MultiTemplateScorerTest, ScoresReadsTooBigToHold)
+{
+    // The int16 recursor rounds each move of the best path by at most
+    // half a unit
+    int moves = 2 * HAPLOTYPE_A.length() + 1;
+    CheckReadsTooBigToHold<SparseSseQvMultiTemplateScorer>(moves * 0.5f /
+                                                           Int16ViterbiRecursor::Scale);
+    CheckReadsTooBigToHold<SparseSseQvSumProductMultiTemplateScorer>(1e-3f);
+}
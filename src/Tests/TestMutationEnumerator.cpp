@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <boost/assign.hpp>
 #include <boost/assign/std/set.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
 #include <boost/range/as_array.hpp>
 #include <iostream>
 #include <set>
@@ -14,6 +16,7 @@
 
 #include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Quiver/MutationEnumerator.hpp>
+#include <ConsensusCore/Quiver/TandemRepeatIndex.hpp>
 #include <ConsensusCore/Utils.hpp>
 
 using std::string;
@@ -82,3 +85,107 @@ TEST(MutationEnumerationTest, TestDinucleotideMutations)
     expected.push_back(Mutation(DELETION, 5, 7, std::string("")));
     EXPECT_THAT(result, UnorderedElementsAreArray(expected));
 }
+
+TEST(MutationEnumerationTest, ForEachMutationMatchesMutations)
+{
+    string tpl = "GATTACACACACAGGATT";
+    AllSingleBaseMutationEnumerator all(tpl);
+    UniqueSingleBaseMutationEnumerator unique(tpl);
+    DinucleotideRepeatMutationEnumerator dinuc(tpl, 3);
+
+    vector<Mutation> visited;
+    auto visit = [&](const Mutation& m) { visited.push_back(m); };
+
+    all.ForEachMutation(visit);
+    EXPECT_EQ(all.Mutations(), visited);
+    visited.clear();
+    unique.ForEachMutation(3, 9, visit);
+    EXPECT_EQ(unique.Mutations(3, 9), visited);
+    visited.clear();
+    dinuc.ForEachMutation(visit);
+    EXPECT_EQ(dinuc.Mutations(), visited);
+    EXPECT_FALSE(visited.empty());
+}
+
+TEST(MutationEnumerationTest, TestTrinucleotideMutations)
+{
+    std::string tpl = "GACGACGACTTAGCAGCAT";
+    std::vector<Mutation> result = TandemRepeatMutationEnumerator(tpl, 3, 3).Mutations();
+    // GACGACGAC has three elements, AGCAGCA only two
+    std::vector<Mutation> expected;
+    expected.push_back(Mutation(INSERTION, 0, 0, std::string("GAC")));
+    expected.push_back(Mutation(DELETION, 0, 3, std::string("")));
+    EXPECT_THAT(result, UnorderedElementsAreArray(expected));
+
+    // repeats are listed by where they start
+    EXPECT_TRUE(TandemRepeatMutationEnumerator(tpl, 3, 2).Mutations(1, 11).empty());
+    EXPECT_EQ(2, TandemRepeatMutationEnumerator(tpl, 3, 2).Mutations(11, 19).size());
+}
+
+TEST(TandemRepeatIndexTest, Repeats)
+{
+    TandemRepeatIndex index("AAAACACACTTGTTGTTG");
+    vector<TandemRepeat> expected;
+    expected.push_back(TandemRepeat(0, 4, 1));
+    expected.push_back(TandemRepeat(9, 11, 1));
+    expected.push_back(TandemRepeat(12, 14, 1));
+    expected.push_back(TandemRepeat(15, 17, 1));
+    EXPECT_EQ(expected, index.Repeats(1, 0, 18));
+    expected.clear();
+    expected.push_back(TandemRepeat(0, 4, 2));
+    expected.push_back(TandemRepeat(3, 9, 2));
+    EXPECT_EQ(expected, index.Repeats(2, 0, 18));
+    expected.clear();
+    expected.push_back(TandemRepeat(9, 18, 3));
+    EXPECT_EQ(expected, index.Repeats(3, 0, 18));
+    EXPECT_TRUE(index.Repeats(3, 0, 9).empty());
+}
+
+TEST(TandemRepeatIndexTest, ApplyMutationsMatchesRebuild)
+{
+    boost::random::mt19937 rng(42);
+    boost::random::uniform_int_distribution<int> base(0, 3);
+    boost::random::uniform_int_distribution<int> kind(0, 2);
+    boost::random::uniform_int_distribution<int> length(1, 4);
+    boost::random::uniform_int_distribution<int> gap(0, 12);
+    const char units[][4] = {"A", "AC", "AGT", "CG"};
+
+    for (int trial = 0; trial < 100; trial++) {
+        // repeat-rich templates
+        string tpl;
+        while (tpl.length() < 120) {
+            const char* unit = units[base(rng)];
+            for (int n = length(rng); n > 0; n--) tpl += unit;
+            tpl += "ACGT"[base(rng)];
+        }
+        TandemRepeatIndex index(tpl);
+
+        for (int round = 0; round < 5; round++) {
+            vector<Mutation> muts;
+            for (int pos = gap(rng); pos + 4 < static_cast<int>(tpl.length());
+                 pos += 5 + gap(rng)) {
+                string bases;
+                for (int n = length(rng); n > 0; n--) bases += "ACGT"[base(rng)];
+                switch (kind(rng)) {
+                    case 0:
+                        muts.push_back(Mutation(SUBSTITUTION, pos, pos + 1, bases.substr(0, 1)));
+                        break;
+                    case 1:
+                        muts.push_back(Mutation(INSERTION, pos, pos, bases));
+                        break;
+                    default:
+                        muts.push_back(Mutation(DELETION, pos, pos + bases.length(), ""));
+                }
+            }
+            string newTpl = ApplyMutations(muts, tpl);
+            index.ApplyMutations(muts, tpl, newTpl);
+            tpl = newTpl;
+
+            TandemRepeatIndex rebuilt(tpl);
+            for (int k = 1; k <= 3; k++) {
+                ASSERT_EQ(rebuilt.Repeats(k, 0, tpl.length()), index.Repeats(k, 0, tpl.length()))
+                    << "unit length " << k << " of " << tpl;
+            }
+        }
+    }
+}
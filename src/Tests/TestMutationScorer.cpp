@@ -1,12 +1,14 @@
 // Author: David Alexander
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <boost/assign.hpp>
 #include <string>
 #include <vector>
 
 #include <ConsensusCore/Features.hpp>
 #include <ConsensusCore/Mutation.hpp>
+#include <ConsensusCore/Quiver/MutationEnumerator.hpp>
 #include <ConsensusCore/Quiver/MutationScorer.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
 #include <ConsensusCore/Quiver/QvEvaluator.hpp>
@@ -15,8 +17,11 @@
 #include <ConsensusCore/Quiver/SseRecursor.hpp>
 #include <ConsensusCore/Read.hpp>
 #include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/ThreadPool.hpp>
 
+#include "BenchUtils.hpp"
 #include "ParameterSettings.hpp"
+#include "Random.hpp"
 
 using namespace ConsensusCore;  // NOLINT
 using namespace boost::assign;  // NOLINT
@@ -95,6 +100,91 @@ TYPED_TEST(MutationScorerTest, CopyTest)
     ASSERT_EQ(ms.Score(), msCopy.Score());
 }
 
+TYPED_TEST(MutationScorerTest, CopiesShareMatricesUntilTheirTemplateChanges)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    Read read = AnonymousRead("GATTACAGATTCATTGACCAGTTACGGGATCATTAGACA");
+    E ev(read, tpl, params, true, true);
+    MS ms(ev, recursor);
+    float score = ms.Score();
+    Mutation probe(SUBSTITUTION, 17, 'A');
+    float probeScore = ms.ScoreMutation(probe);
+
+    MS msCopy(ms);
+    EXPECT_EQ(ms.Alpha(), msCopy.Alpha());
+    EXPECT_EQ(ms.Beta(), msCopy.Beta());
+    EXPECT_EQ(probeScore, msCopy.ScoreMutation(probe));
+
+    std::string newTpl = ApplyMutation(Mutation(DELETION, 12, '-'), tpl);
+    msCopy.Template(newTpl);
+    EXPECT_NE(ms.Alpha(), msCopy.Alpha());
+    EXPECT_NE(ms.Beta(), msCopy.Beta());
+
+    // The original is untouched, and the copy scores like a fresh scorer
+    EXPECT_EQ(tpl, ms.Template());
+    EXPECT_EQ(score, ms.Score());
+    EXPECT_EQ(probeScore, ms.ScoreMutation(probe));
+    E freshEv(read, newTpl, params, true, true);
+    MS fresh(freshEv, recursor);
+    EXPECT_NEAR(fresh.Score(), msCopy.Score(), 0.01);
+    EXPECT_NEAR(fresh.ScoreMutation(probe), msCopy.ScoreMutation(probe), 0.01);
+}
+
+TYPED_TEST(MutationScorerTest, ScorersShareTheThreadsExtendBuffer)
+{
+    // Scorers of reads of different lengths take turns with the
+    // thread's scratch space, and score as they would alone
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    E longEv(AnonymousRead("GATTACAGATTCATTGACCAGTTACGGGATCATTAGACA"), tpl, params, true, true);
+    E shortEv(AnonymousRead("GATTACAGATTCATTGACCAGTACGGGATCATTAGACA"), tpl, params, true, true);
+    MS longScorer(longEv, recursor);
+    MS shortScorer(shortEv, recursor);
+    std::vector<Mutation> probes;
+    probes.push_back(Mutation(SUBSTITUTION, 17, 'A'));
+    probes.push_back(Mutation(INSERTION, 22, 'T'));
+    probes.push_back(Mutation(DELETION, 30, '-'));
+
+    std::vector<float> longScores, shortScores;
+    foreach (const Mutation& m, probes) {
+        longScores.push_back(longScorer.ScoreMutation(m));
+    }
+    foreach (const Mutation& m, probes) {
+        shortScores.push_back(shortScorer.ScoreMutation(m));
+    }
+    for (size_t k = 0; k < probes.size(); k++) {
+        EXPECT_EQ(shortScores[k], shortScorer.ScoreMutation(probes[k]));
+        EXPECT_EQ(longScores[k], longScorer.ScoreMutation(probes[k]));
+    }
+}
+
+TYPED_TEST(MutationScorerTest, ThreadsScoreOneScorerAtOnce)
+{
+    // More threads than the scorer keeps scratch evaluators, each
+    // scoring every mutation, leave the template and scores untouched
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    E ev(AnonymousRead("GATTACAGATTCATTGACCAGTTACGGGATCATTAGACA"), tpl, params, true, true);
+    const MS scorer(ev, recursor);
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+    std::vector<float> serial;
+    foreach (const Mutation& m, muts) {
+        serial.push_back(scorer.ScoreMutation(m));
+    }
+
+    const int numThreads = 2 * SCRATCH_EVALUATORS;
+    std::vector<std::vector<float> > parallel(numThreads, std::vector<float>(muts.size()));
+    ThreadPool pool(numThreads);
+    pool.ParallelFor(numThreads, [&](int t) {
+        for (size_t k = 0; k < muts.size(); k++) {
+            size_t j = (k + t * 7) % muts.size();
+            parallel[t][j] = scorer.ScoreMutation(muts[j]);
+        }
+    });
+    for (int t = 0; t < numThreads; t++) {
+        EXPECT_EQ(serial, parallel[t]);
+    }
+    EXPECT_EQ(tpl, scorer.Template());
+}
+
 TYPED_TEST(MutationScorerTest, MutationsAtBeginning)
 {
     std::string tpl = "GATTACA";
@@ -178,6 +268,47 @@ TYPED_TEST(MutationScorerTest, TemplateMutationWorkflow)
     EXPECT_EQ("GATTAACA", ms.Template());
 }
 
+TYPED_TEST(MutationScorerTest, IncrementalTemplateRefill)
+{
+    //                 0123456789012345678901234567890123456789
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    Read read = AnonymousRead("GATTACAGATTCATTGACCAGTTACGGGATCATTAGACA");
+
+    std::vector<Mutation> muts;
+    muts += Mutation(SUBSTITUTION, 0, 'C'), Mutation(SUBSTITUTION, 20, 'T'),
+        Mutation(SUBSTITUTION, 39, 'G'), Mutation(INSERTION, 0, 'T'), Mutation(INSERTION, 23, 'T'),
+        Mutation(INSERTION, 40, 'C'), Mutation(DELETION, 0, '-'), Mutation(DELETION, 12, '-'),
+        Mutation(DELETION, 39, '-'), Mutation(INSERTION, 31, 31, "CC");
+
+    foreach (const Mutation& m, muts) {
+        std::string newTpl = ApplyMutation(m, tpl);
+
+        E ev(read, tpl, params, true, true);
+        MS ms(ev, recursor);
+        ms.Template(newTpl);
+
+        E freshEv(read, newTpl, params, true, true);
+        MS fresh(freshEv, recursor);
+
+        EXPECT_EQ(newTpl, ms.Template());
+        EXPECT_NEAR(fresh.Score(), ms.Score(), 0.01);
+        EXPECT_NEAR(ms.Alpha()->Get(read.Length(), newTpl.length()), ms.Score(), 0.2);
+
+        // The refilled matrices must support mutation scoring as usual
+        Mutation probe(SUBSTITUTION, 17, 'A');
+        EXPECT_NEAR(fresh.ScoreMutation(probe), ms.ScoreMutation(probe), 0.01);
+    }
+
+    // Templates sharing nothing at either end still refill correctly
+    E ev(read, tpl, params, true, true);
+    MS ms(ev, recursor);
+    std::string otherTpl = "T" + tpl.substr(1, 38) + "T";
+    ms.Template(otherTpl);
+    E otherEv(read, otherTpl, params, true, true);
+    MS other(otherEv, recursor);
+    EXPECT_NEAR(other.Score(), ms.Score(), 0.01);
+}
+
 TYPED_TEST(MutationScorerTest, DinucleotideInsertionTest)
 {
     //                     0123456789012345678
@@ -229,3 +360,202 @@ TYPED_TEST(MutationScorerTest, DinucleotideDeletionTest)
     SparseSimpleQvMutationScorer ms2(e2, r2);
     EXPECT_EQ(scoreTT, ms2.ScoreMutation(Mutation(DELETION, 7, 9, "")));
 }
+
+//
+// ================== Tests for checkpointed alpha and beta
+// ============================
+//
+
+namespace {
+template <typename R>
+void ExpectCheckpointsScoreAlike()
+{
+    Rng rng(42);
+    std::string tpl = RandomSequence(rng, 300);
+    std::string seq = tpl;
+    seq.erase(250, 1);
+    seq[150] = (seq[150] == 'A') ? 'C' : 'A';
+    seq.insert(40, "G");
+    QvEvaluator ev(AnonymousRead(seq), tpl, TestingParams());
+    R r(ALL_MOVES, BandingOptions(4, 12));
+    MutationScorer<R> whole(ev, r);
+    std::vector<Mutation> muts = UniqueSingleBaseMutationEnumerator(tpl).Mutations();
+
+    int intervals[] = {MIN_CHECKPOINT_INTERVAL, 16, 64};
+    foreach (int k, intervals) {
+        MutationScorer<R> checkpointed(ev, r, k);
+        EXPECT_EQ(k, checkpointed.CheckpointInterval());
+        EXPECT_EQ(whole.Score(), checkpointed.Score());
+        EXPECT_EQ(2 * (301 / k), checkpointed.Alpha()->Columns());
+        EXPECT_GT(whole.Alpha()->UsedEntries(), k / 4 * checkpointed.Alpha()->UsedEntries());
+        EXPECT_GT(whole.Beta()->UsedEntries(), k / 4 * checkpointed.Beta()->UsedEntries());
+
+        // In template order, and from the end back, so that both cached
+        // and fresh refills are scored
+        for (size_t i = 0; i < muts.size(); i++) {
+            EXPECT_FLOAT_EQ(whole.ScoreMutation(muts[i]), checkpointed.ScoreMutation(muts[i]));
+        }
+        for (size_t i = muts.size(); i-- > 0;) {
+            EXPECT_FLOAT_EQ(whole.ScoreMutation(muts[i]), checkpointed.ScoreMutation(muts[i]));
+        }
+    }
+}
+}
+
+TEST(CheckpointedMutationScorerTest, ScoresLikeWholeMatrices)
+{
+    ExpectCheckpointsScoreAlike<SparseSimpleQvRecursor>();
+    ExpectCheckpointsScoreAlike<SparseSseQvRecursor>();
+    ExpectCheckpointsScoreAlike<SparseSseQvSumProductRecursor>();
+}
+
+TEST(CheckpointedMutationScorerTest, TemplateChangesRefillTheCheckpoints)
+{
+    Rng rng(7);
+    std::string tpl = RandomSequence(rng, 200);
+    std::string seq = tpl;
+    seq.erase(120, 1);
+    QvEvaluator ev(AnonymousRead(seq), tpl, TestingParams());
+    SparseSseQvRecursor r(ALL_MOVES, BandingOptions(4, 18));
+    SparseSseQvMutationScorer ms(ev, r, 16);
+    SparseSseQvMutationScorer copy(ms);
+    Mutation probe(SUBSTITUTION, 60, 'A');
+    float probeScore = ms.ScoreMutation(probe);
+
+    std::string newTpl = ApplyMutation(Mutation(DELETION, 120, '-'), tpl);
+    ms.Template(newTpl);
+    QvEvaluator freshEv(AnonymousRead(seq), newTpl, TestingParams());
+    SparseSseQvMutationScorer fresh(freshEv, r, 16);
+    EXPECT_EQ(fresh.Score(), ms.Score());
+    EXPECT_EQ(fresh.ScoreMutation(probe), ms.ScoreMutation(probe));
+    EXPECT_EQ(2 * (201 / 16), ms.Alpha()->Columns());
+
+    // The copy keeps the old checkpoints, and none of the refills made
+    // from the new ones
+    EXPECT_EQ(probeScore, copy.ScoreMutation(probe));
+    EXPECT_EQ(tpl, copy.Template());
+}
+
+TEST(CheckpointedMutationScorerTest, IntervalMustBeAtLeastTheMinimum)
+{
+    std::string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    QvEvaluator ev(AnonymousRead(tpl), tpl, TestingParams());
+    SparseSseQvRecursor r(ALL_MOVES, BandingOptions(4, 18));
+    EXPECT_THROW(SparseSseQvMutationScorer(ev, r, MIN_CHECKPOINT_INTERVAL - 1), InvalidInputError);
+    EXPECT_NO_THROW(SparseSseQvMutationScorer(ev, r, MIN_CHECKPOINT_INTERVAL));
+
+    // Dense matrices have no columns to spare
+    SseQvRecursor dense(ALL_MOVES, BandingOptions(4, 18));
+    EXPECT_THROW(SseQvMutationScorer(ev, dense, 16), InvalidInputError);
+}
+
+TEST(BandHintMutationScorerTest, ScoresLikeUnhinted)
+{
+    Rng rng(5);
+    std::string tpl = RandomSequence(rng, 300);
+    std::string seq = tpl;
+    seq.erase(200, 3);
+    seq.insert(100, "GG");
+    QvEvaluator ev(AnonymousRead(seq), tpl, TestingParams());
+    SparseSseQvRecursor r(ALL_MOVES, BandingOptions(4, 12));
+    SparseSseQvMutationScorer unhinted(ev, r);
+
+    // A band about the diagonal, wide enough for the gaps
+    int I = seq.length();
+    std::vector<Interval> band;
+    for (int j = 0; j <= 300; j++) {
+        band.push_back(Interval(std::max(0, j - 8), std::min(I, j + 8) + 1));
+    }
+    SparseSseQvMutationScorer hinted(ev, r, 0, band);
+    EXPECT_FLOAT_EQ(unhinted.Score(), hinted.Score());
+    Mutation probe(SUBSTITUTION, 150, 'A');
+    EXPECT_FLOAT_EQ(unhinted.ScoreMutation(probe), hinted.ScoreMutation(probe));
+
+    // One band per column, each within the rows
+    band.pop_back();
+    EXPECT_THROW(SparseSseQvMutationScorer(ev, r, 0, band), InvalidInputError);
+    band.push_back(Interval(I, I + 2));
+    EXPECT_THROW(SparseSseQvMutationScorer(ev, r, 0, band), InvalidInputError);
+}
+
+TEST(BandSeededRefillTest, MovedBandsScoreLikeFreshFills)
+{
+    // Several edits at once, moved through either by the column map of
+    // the edit or by the ends it left alone
+    Rng rng(9);
+    std::string tpl = RandomSequence(rng, 400);
+    std::string seq = NoisyCopy(rng, tpl, 0.05f);
+    std::vector<Mutation> muts;
+    muts.push_back(Mutation(INSERTION, 60, 60, "GA"));
+    muts.push_back(Mutation(DELETION, 150, 153, ""));
+    muts.push_back(Mutation(SUBSTITUTION, 240, 'T'));
+    muts.push_back(Mutation(INSERTION, 330, 'C'));
+    std::string newTpl = ApplyMutations(muts, tpl);
+    std::vector<int> columns = TargetToQueryPositions(muts, tpl);
+    QvEvaluator ev(AnonymousRead(seq), tpl, TestingParams());
+    QvEvaluator freshEv(AnonymousRead(seq), newTpl, TestingParams());
+    SparseSseQvRecursor r(ALL_MOVES, BandingOptions(4, 12));
+    Mutation probe(SUBSTITUTION, 200, 'A');
+
+    int intervals[] = {0, 16};
+    foreach (int k, intervals) {
+        SparseSseQvMutationScorer fresh(freshEv, r, k);
+        SparseSseQvMutationScorer mapped(ev, r, k);
+        SparseSseQvMutationScorer unmapped(ev, r, k);
+        mapped.Template(newTpl, 0, newTpl.length(), columns);
+        unmapped.Template(newTpl, 0, newTpl.length());
+        EXPECT_NEAR(fresh.Score(), mapped.Score(), 0.01) << k;
+        EXPECT_NEAR(fresh.Score(), unmapped.Score(), 0.01) << k;
+        EXPECT_NEAR(fresh.ScoreMutation(probe), mapped.ScoreMutation(probe), 0.01) << k;
+        EXPECT_NEAR(fresh.ScoreMutation(probe), unmapped.ScoreMutation(probe), 0.01) << k;
+        if (k != 0) {
+            // Seeded, the checkpoints' fill finds its band in one pass
+            // of alpha and one of beta
+            EXPECT_EQ(2, mapped.FillStats().Passes);
+            EXPECT_EQ(0, mapped.FillStats().FlipFlops);
+        }
+    }
+
+    // One column per column of the old matrices
+    SparseSseQvMutationScorer ms(ev, r);
+    columns.pop_back();
+    EXPECT_THROW(ms.Template(newTpl, 0, newTpl.length(), columns), InvalidInputError);
+}
+
+TEST(BandSeededRefillTest, EndsLeftAloneMoveBandsLikeTheColumnMap)
+{
+    // A single edit inside the template leaves both a prefix and a
+    // suffix alone, which between them move the bands, checkpoints and
+    // all, as well as the edit's own column map does
+    Rng rng(11);
+    std::string tpl = RandomSequence(rng, 300);
+    std::string seq = NoisyCopy(rng, tpl, 0.05f);
+    QvEvaluator ev(AnonymousRead(seq), tpl, TestingParams());
+    SparseSseQvRecursor r(ALL_MOVES, BandingOptions(4, 12));
+    std::vector<Mutation> edits;
+    edits.push_back(Mutation(INSERTION, 120, 120, "GAT"));
+    edits.push_back(Mutation(DELETION, 120, 124, ""));
+    edits.push_back(Mutation(SUBSTITUTION, 120, 122, "TC"));
+    Mutation probe(SUBSTITUTION, 200, 'A');
+
+    int intervals[] = {0, 16};
+    foreach (int k, intervals) {
+        foreach (const Mutation& m, edits) {
+            std::vector<Mutation> muts(1, m);
+            std::string newTpl = ApplyMutations(muts, tpl);
+            QvEvaluator freshEv(AnonymousRead(seq), newTpl, TestingParams());
+            SparseSseQvMutationScorer fresh(freshEv, r, k);
+            SparseSseQvMutationScorer mapped(ev, r, k);
+            SparseSseQvMutationScorer unmapped(ev, r, k);
+            mapped.Template(newTpl, 0, newTpl.length(), TargetToQueryPositions(muts, tpl));
+            unmapped.Template(newTpl, 0, newTpl.length());
+            EXPECT_NEAR(fresh.Score(), unmapped.Score(), 0.01) << m.ToString() << " " << k;
+            EXPECT_NEAR(fresh.ScoreMutation(probe), unmapped.ScoreMutation(probe), 0.01)
+                << m.ToString() << " " << k;
+            EXPECT_EQ(mapped.FillStats().Passes, unmapped.FillStats().Passes)
+                << m.ToString() << " " << k;
+            EXPECT_EQ(mapped.FillStats().FlipFlops, unmapped.FillStats().FlipFlops)
+                << m.ToString() << " " << k;
+        }
+    }
+}
@@ -15,6 +15,8 @@
 #include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Utils.hpp>
 
+#include "Random.hpp"
+
 using std::string;
 using std::vector;
 using std::cout;
@@ -85,6 +87,62 @@ TEST(MutationTest, ApplyMutationsToSamePositionTest)
     EXPECT_EQ("GATATACA", ApplyMutations(muts, tpl));
 }
 
+TEST(MutationTest, LongMutationsTest)
+{
+    // bases past those held inline survive copying and assignment
+    const string bases = "ACGTACGTACGTA";
+    Mutation m(SUBSTITUTION, 2, 15, bases);
+    Mutation copy(m);
+    Mutation assigned(INSERTION, 0, 'G');
+    assigned = m;
+    EXPECT_EQ(bases, copy.NewBases());
+    EXPECT_EQ(bases, assigned.NewBases());
+    EXPECT_EQ(13, assigned.NewBasesLength());
+    EXPECT_EQ(m, assigned);
+    assigned = Mutation(INSERTION, 0, 'G');
+    EXPECT_EQ("G", assigned.NewBases());
+    EXPECT_TRUE(m < Mutation(SUBSTITUTION, 2, 15, "ACGTACGTACGTC"));
+    EXPECT_FALSE(Mutation(SUBSTITUTION, 2, 15, "ACGTACGTACGTC") < m);
+}
+
+TEST(MutationTest, ApplyMutationsToBufferTest)
+{
+    const string tpl = "GATTACA";
+    std::vector<Mutation> muts;
+    muts += Mutation(SUBSTITUTION, 6, 'T'), Mutation(INSERTION, 0, 'G'),
+        Mutation(DELETION, 4, '-'), Mutation(INSERTION, 3, 3, "CCCCCCCCCC");
+
+    // the buffer is overwritten, not appended to
+    string out = "junk";
+    ApplyMutations(muts, tpl, &out);
+    EXPECT_EQ("GGATCCCCCCCCCCTCT", out);
+    EXPECT_EQ(ApplyMutations(muts, tpl), out);
+
+    // overlapping mutations are applied one after another
+    std::vector<Mutation> overlapping;
+    overlapping += Mutation(DELETION, 2, '-'), Mutation(SUBSTITUTION, 1, 4, "CCC");
+    ApplyMutations(overlapping, tpl, &out);
+    EXPECT_EQ("GCCACA", out);
+}
+
+TEST(MutationTest, ApplyMutationInPlaceTest)
+{
+    const string tpl = "GATTACA";
+    std::vector<Mutation> muts;
+    muts += Mutation(SUBSTITUTION, 0, 'C'), Mutation(SUBSTITUTION, 2, 5, "CCG"),
+        Mutation(DELETION, 6, '-'), Mutation(DELETION, 1, 4, ""), Mutation(INSERTION, 0, 'G'),
+        Mutation(INSERTION, 7, 7, "TT");
+
+    string work = tpl;
+    string saved;
+    foreach (const Mutation& m, muts) {
+        ApplyMutationInPlace(m, &work, &saved);
+        EXPECT_EQ(ApplyMutation(m, tpl), work);
+        UndoMutationInPlace(m, &work, saved);
+        EXPECT_EQ(tpl, work);
+    }
+}
+
 TEST(MutationTest, MutationsToTranscript)
 {
     //                 0123456
@@ -143,3 +201,54 @@ TEST(MutationTest, MutatedTemplatePositionsTest)
         ASSERT_THAT(TargetToQueryPositions(muts3, tpl3), ElementsAreArray(expectedMtp3));
     }
 }
+
+TEST(MutationTest, TemplateFingerprintTest)
+{
+    // Mutated fingerprints match those of the mutated templates, for
+    // mutations at the ends, abutting or clustered within a window of
+    // one another, and too long to be held inline
+    Rng rng(17);
+    boost::random::uniform_int_distribution<> typeDist(0, 2), lengthDist(1, 12);
+    for (int trial = 0; trial < 200; trial++) {
+        string tpl = RandomSequence(rng, 1 + trial % 90);
+        int L = tpl.length();
+        boost::random::uniform_int_distribution<> posDist(0, L);
+        vector<Mutation> muts;
+        for (int k = 0, n = 1 + trial % 5; k < n; k++) {
+            int start = posDist(rng);
+            MutationType type = static_cast<MutationType>(typeDist(rng));
+            if (type == INSERTION) {
+                muts.push_back(Mutation(INSERTION, start, start,
+                                        RandomSequence(rng, lengthDist(rng))));
+            } else if (start < L) {
+                int end = std::min(L, start + lengthDist(rng) % 3 + 1);
+                string bases = (type == DELETION) ? "" : RandomSequence(rng, end - start);
+                muts.push_back(Mutation(type, start, end, bases));
+            }
+        }
+        // Of mutations that overlap, only the first is kept
+        std::sort(muts.begin(), muts.end());
+        vector<Mutation> disjoint;
+        foreach (const Mutation& m, muts) {
+            if (disjoint.empty() || disjoint.back().End() <= m.Start()) disjoint.push_back(m);
+        }
+        muts = disjoint;
+        string newTpl = ApplyMutations(muts, tpl);
+        ASSERT_EQ(TemplateFingerprint(newTpl),
+                  MutatedTemplateFingerprint(TemplateFingerprint(tpl), muts, tpl))
+            << tpl << " -> " << newTpl;
+    }
+
+    // Templates a base apart, or of one base shifted along, differ
+    string tpl = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACA";
+    std::set<uint64_t> fingerprints;
+    fingerprints.insert(TemplateFingerprint(tpl));
+    fingerprints.insert(TemplateFingerprint(ApplyMutation(Mutation(SUBSTITUTION, 20, 'T'), tpl)));
+    fingerprints.insert(TemplateFingerprint(ApplyMutation(Mutation(INSERTION, 0, 'G'), tpl)));
+    fingerprints.insert(TemplateFingerprint(ApplyMutation(Mutation(DELETION, 39, '-'), tpl)));
+    fingerprints.insert(TemplateFingerprint("A" + tpl.substr(0, 39)));
+    fingerprints.insert(TemplateFingerprint(""));
+    EXPECT_EQ(6, fingerprints.size());
+    EXPECT_EQ(TemplateFingerprint(tpl), MutatedTemplateFingerprint(TemplateFingerprint(tpl),
+                                                                   vector<Mutation>(), tpl));
+}
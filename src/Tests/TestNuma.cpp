@@ -0,0 +1,66 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Numa.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+TEST(NumaTest, EveryCpuIsOnOneNode)
+{
+    ASSERT_GE(NumNumaNodes(), 1);
+    std::set<int> seen;
+    bool anyCpus = false;
+    for (int node = 0; node < NumNumaNodes(); node++) {
+        foreach (int cpu, NumaNodeCpus(node)) {
+            EXPECT_TRUE(seen.insert(cpu).second);
+            anyCpus = true;
+        }
+    }
+    EXPECT_TRUE(anyCpus);
+    EXPECT_TRUE(NumaNodeCpus(-1).empty());
+    EXPECT_TRUE(NumaNodeCpus(NumNumaNodes()).empty());
+    EXPECT_GE(CurrentNumaNode(), 0);
+    EXPECT_LT(CurrentNumaNode(), NumNumaNodes());
+}
+
+TEST(NumaTest, PinnedThreadsStayOnTheirNode)
+{
+    int node = NumNumaNodes() - 1;
+    while (NumaNodeCpus(node).empty()) {
+        node--;
+    }
+    std::thread pinned([node] {
+        if (!PinThreadToNumaNode(node)) return;
+        EXPECT_EQ(node, CurrentNumaNode());
+        // as do the threads they start
+        std::thread child([node] { EXPECT_EQ(node, CurrentNumaNode()); });
+        child.join();
+    });
+    pinned.join();
+    EXPECT_FALSE(PinThreadToNumaNode(NumNumaNodes()));
+}
+
+TEST(NumaTest, MatricesSpanningHugePagesWork)
+{
+    // A band arena chunk of well over a huge page
+    SparseMatrix m(2000, 1000);
+    for (int j = 0; j < m.Columns(); j++) {
+        m.StartEditingColumn(j, 0, m.Rows());
+        for (int i = 0; i < m.Rows(); i++) {
+            m.Set(i, j, static_cast<float>(i - j));
+        }
+        m.FinishEditingColumn(j, 0, m.Rows());
+    }
+    EXPECT_GE(m.AllocatedEntries(), 2000 * 1000);
+    EXPECT_NEAR(1000.0f, m.Get(1999, 999), 4.0f);
+    // and the arena keeps them, merged, for the next fill
+    m.Reset(2000, 1000);
+    EXPECT_GE(m.AllocatedBytes(), 2000 * 1000 * SparseMatrix::EntryBytes());
+}
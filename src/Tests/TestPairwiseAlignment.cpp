@@ -5,8 +5,21 @@
 #include <boost/shared_ptr.hpp>
 
 #include <ConsensusCore/Align/AffineAlignment.hpp>
+#include <ConsensusCore/Align/BatchAlignment.hpp>
+#include <ConsensusCore/Align/EditDistance.hpp>
 #include <ConsensusCore/Align/LinearAlignment.hpp>
 #include <ConsensusCore/Align/PairwiseAlignment.hpp>
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BenchUtils.hpp"
+#include "Random.hpp"
 
 using namespace ConsensusCore;  // NOLINT
 using ::testing::ElementsAreArray;
@@ -31,6 +44,44 @@ TEST(PairwiseAlignmentTests, RepresentationTests)
     EXPECT_EQ(1, a2.Deletions());
     EXPECT_EQ(1, a2.Insertions());
     EXPECT_EQ(5, a2.Matches());
+    EXPECT_EQ("GATTA-CA", a2.Target());
+    EXPECT_EQ("CA-TAACA", a2.Query());
+
+    // Gapped strings are rebuilt from the packed transcript
+    PairwiseAlignment a3("--GATTACAT", "TTGAC-TCA-");
+    EXPECT_EQ("--GATTACAT", a3.Target());
+    EXPECT_EQ("TTGAC-TCA-", a3.Query());
+    EXPECT_EQ("IIMMRDRMMD", a3.Transcript());
+    EXPECT_EQ(4, a3.Errors() - a3.Mismatches());
+}
+
+TEST(PairwiseAlignmentTests, CompactRepresentationTests)
+{
+    CompactAlignment a;
+    EXPECT_TRUE(a.Empty());
+    EXPECT_EQ("", a.Cigar());
+
+    // appended last move first, as by a traceback
+    a.Append(INCORPORATE);
+    a.Append(MERGE);
+    a.Append(INCORPORATE, 2);
+    a.Append(INCORPORATE);
+    a.Append(EXTRA);
+    a.Append(DELETE);
+    a.Reverse();
+
+    EXPECT_EQ(5, a.NumRuns());
+    EXPECT_EQ(INCORPORATE, a.RunMove(2));
+    EXPECT_EQ(3, a.RunLength(2));
+    EXPECT_EQ(6, a.ReadLength());
+    EXPECT_EQ(7, a.TemplateLength());
+    EXPECT_EQ("1D1I3M1D2M", a.Cigar());
+    EXPECT_EQ("G-ATTACA", a.Target("GATTACA"));
+    EXPECT_EQ("-CATT-AA", a.Query("CATTAA"));
+
+    PairwiseAlignment* p = a.ToPairwiseAlignment("GATTACA", "CATTAA");
+    EXPECT_EQ("DIMMMDRM", p->Transcript());
+    delete p;
 }
 
 TEST(PairwiseAlignmentTests, GlobalAlignmentTests)
@@ -56,6 +107,42 @@ TEST(PairwiseAlignmentTests, GlobalAlignmentTests)
     delete a;
 }
 
+TEST(PairwiseAlignmentTests, BitParallelEditDistance)
+{
+    // Doubling the edit-distance penalties keeps every tie of the full
+    // DP, so it traces back the same alignment at twice the score
+    AlignConfig doubled(AlignParams(0, -2, -2, -2), GLOBAL);
+    Rng rng(3);
+    for (int n = 0; n < 60; n++) {
+        std::string target = RandomSequence(rng, n % 10 == 0 ? n % 3 : 1 + n * 5);
+        std::string query = NoisyCopy(rng, target, 0.2f);
+
+        int expectedScore, score;
+        PairwiseAlignment* expected = Align(target, query, &expectedScore, doubled);
+        PairwiseAlignment* a = Align(target, query, &score);
+        EXPECT_EQ(expected->Target(), a->Target());
+        EXPECT_EQ(expected->Query(), a->Query());
+        EXPECT_EQ(expectedScore, 2 * score);
+        EXPECT_EQ(-score, EditDistance(target, query));
+        delete a;
+        delete expected;
+
+        // Semiglobal: the best over every substring of the target
+        std::string inner = target.substr(target.length() / 3, target.length() / 3);
+        query = NoisyCopy(rng, inner, 0.1f);
+        int best = query.length();
+        for (size_t s = 0; s <= target.length(); s++) {
+            for (size_t e = s; e <= target.length(); e++) {
+                best = std::min(best, EditDistance(target.substr(s, e - s), query));
+            }
+        }
+        EXPECT_EQ(best, EditDistance(target, query, SEMIGLOBAL));
+    }
+    EXPECT_EQ(0, EditDistance("GATTACA", "TTAC", SEMIGLOBAL));
+    EXPECT_EQ(3, EditDistance("GATTACA", "TTAC"));
+    EXPECT_EQ(4, EditDistance("", "TTAC"));
+}
+
 TEST(PairwiseAlignmentTests, TargetPositionsInQueryTest)
 {
     // MMM -> 0123
@@ -223,6 +310,222 @@ TEST(IupacAlignmentTests, BasicTest)
     delete a;
 }
 
+namespace {
+bool IsIupacPartialMatch(char iupacCode, char b)
+{
+    switch (iupacCode) {
+        case 'R':
+            return (b == 'A' || b == 'G');
+        case 'Y':
+            return (b == 'C' || b == 'T');
+        case 'S':
+            return (b == 'G' || b == 'C');
+        case 'W':
+            return (b == 'A' || b == 'T');
+        case 'K':
+            return (b == 'G' || b == 'T');
+        case 'M':
+            return (b == 'A' || b == 'C');
+        default:
+            return false;
+    }
+}
+
+// The scalar two-state recursion the striped kernels replace, as the
+// gapped target and query
+std::pair<std::string, std::string> ScalarAffineAlignment(const std::string& target,
+                                                          const std::string& query,
+                                                          const AffineAlignmentParams& p,
+                                                          bool iupacAware = false)
+{
+    int I = query.length();
+    int J = target.length();
+    std::vector<std::vector<float> > M(I + 1, std::vector<float>(J + 1));
+    std::vector<std::vector<float> > G(I + 1, std::vector<float>(J + 1));
+    M[0][0] = 0;
+    G[0][0] = -FLT_MAX;
+    for (int i = 1; i <= I; ++i) {
+        M[i][0] = -FLT_MAX;
+        G[i][0] = p.GapOpen + (i - 1) * p.GapExtend;
+    }
+    for (int j = 1; j <= J; ++j) {
+        M[0][j] = -FLT_MAX;
+        G[0][j] = p.GapOpen + (j - 1) * p.GapExtend;
+    }
+    for (int i = 1; i <= I; ++i) {
+        for (int j = 1; j <= J; ++j) {
+            char tb = target[j - 1], qb = query[i - 1];
+            float s = (tb == qb) ? p.MatchScore : p.MismatchScore;
+            if (iupacAware && (IsIupacPartialMatch(tb, qb) || IsIupacPartialMatch(qb, tb))) {
+                s = p.PartialMatchScore;
+            }
+            M[i][j] = std::max(M[i - 1][j - 1], G[i - 1][j - 1]) + s;
+            G[i][j] = std::max(std::max(M[i][j - 1] + p.GapOpen, G[i][j - 1] + p.GapExtend),
+                               std::max(M[i - 1][j] + p.GapOpen, G[i - 1][j] + p.GapExtend));
+        }
+    }
+    std::string t, q;
+    int i = I, j = J;
+    bool match = M[I][J] >= G[I][J];
+    while (i > 0 || j > 0) {
+        if (match) {
+            match = M[i - 1][j - 1] >= G[i - 1][j - 1];
+            t += target[--j];
+            q += query[--i];
+        } else {
+            float s[4] = {j > 0 ? M[i][j - 1] + p.GapOpen : -FLT_MAX,
+                          j > 0 ? G[i][j - 1] + p.GapExtend : -FLT_MAX,
+                          i > 0 ? M[i - 1][j] + p.GapOpen : -FLT_MAX,
+                          i > 0 ? G[i - 1][j] + p.GapExtend : -FLT_MAX};
+            int argMax = std::max_element(s, s + 4) - s;
+            match = (argMax == 0 || argMax == 2);
+            if (argMax < 2) {
+                t += target[--j];
+                q += '-';
+            } else {
+                t += '-';
+                q += query[--i];
+            }
+        }
+    }
+    return std::make_pair(std::string(t.rbegin(), t.rend()), std::string(q.rbegin(), q.rend()));
+}
+}
+
+TEST(AffineAlignmentTests, StripedKernelsMatchScalarRecursion)
+{
+    Rng rng(42);
+    AffineAlignmentParams params[] = {DefaultAffineAlignmentParams(),
+                                      AffineAlignmentParams(0.7f, -1.3f, -2.1f, -0.3f)};
+    int widths[] = {4, 8};
+    for (int w = 0; w < 2; w++) {
+        SetMaxSimdWidth(widths[w]);
+        for (int n = 0; n < 100; n++) {
+            std::string target = RandomSequence(rng, n % 7 == 0 ? n % 5 : 1 + n * 3);
+            std::string query = NoisyCopy(rng, target, 0.2f);
+            const AffineAlignmentParams& p = params[n % 2];
+
+            std::pair<std::string, std::string> expected =
+                ScalarAffineAlignment(target, query, p);
+            PairwiseAlignment* a = AlignAffine(target, query, p);
+            EXPECT_EQ(expected.first, a->Target());
+            EXPECT_EQ(expected.second, a->Query());
+            delete a;
+        }
+    }
+    SetMaxSimdWidth(16);
+}
+
+TEST(IupacAlignmentTests, MatchesScalarRecursion)
+{
+    // Every code, and a character that is none
+    const std::string codes = "ACGTRYSWKMBDHVNX";
+    boost::random::uniform_int_distribution<int> code(0, codes.length() - 1);
+    boost::random::uniform_int_distribution<int> coin(0, 2);
+    Rng rng(23);
+    for (int n = 0; n < 60; n++) {
+        std::string target = RandomSequence(rng, 1 + n * 4);
+        std::string query = NoisyCopy(rng, target, 0.1f);
+        for (size_t k = 0; k < target.length(); k++) {
+            if (coin(rng) == 0) target[k] = codes[code(rng)];
+        }
+        std::pair<std::string, std::string> expected =
+            ScalarAffineAlignment(target, query, IupacAwareAffineAlignmentParams(), true);
+        PairwiseAlignment* a = AlignAffineIupac(target, query);
+        EXPECT_EQ(expected.first, a->Target());
+        EXPECT_EQ(expected.second, a->Query());
+        delete a;
+    }
+}
+
+TEST(AffineAlignmentTests, BandedMatchesFullAlignment)
+{
+    Rng rng(7);
+    for (int n = 0; n < 50; n++) {
+        std::string target = RandomSequence(rng, n % 10 == 0 ? n % 3 : 20 + n * 7);
+        std::string query = NoisyCopy(rng, target, 0.15f);
+        PairwiseAlignment* full = AlignAffine(target, query);
+
+        // A band holding every cell is the full alignment
+        PairwiseAlignment* a = AlignAffineBanded(target, query, DefaultAffineAlignmentParams(), 0,
+                                                 target.length() + query.length());
+        EXPECT_EQ(full->Target(), a->Target());
+        EXPECT_EQ(full->Query(), a->Query());
+        delete a;
+
+        // As, here, is one widened until the path is clear of its edges
+        a = AlignAffineBanded(target, query, DefaultAffineAlignmentParams(), 0, 2);
+        EXPECT_EQ(full->Target(), a->Target());
+        EXPECT_EQ(full->Query(), a->Query());
+        delete a;
+        delete full;
+    }
+}
+
+TEST(AffineAlignmentTests, BandedWidensPastLargeGap)
+{
+    std::string target = "GATTACAGATTACA";
+    std::string query = "GATTACAACCTTGGAACCGATTACA";
+    PairwiseAlignment* full = AlignAffine(target, query);
+    PairwiseAlignment* a = AlignAffineBanded(target, query, DefaultAffineAlignmentParams(), 0, 1);
+    EXPECT_EQ(full->Target(), a->Target());
+    EXPECT_EQ(full->Query(), a->Query());
+    EXPECT_EQ("GATTACA-----------GATTACA", a->Target());
+    delete a;
+    delete full;
+
+    // The band is placed off the main diagonal
+    a = AlignAffineBanded(query, target, DefaultAffineAlignmentParams(), 11, 1);
+    EXPECT_EQ("GATTACA-----------GATTACA", a->Query());
+    delete a;
+}
+
+TEST(BatchAlignmentTests, MatchesOneAtATime)
+{
+    Rng rng(19);
+    std::vector<std::string> targets, queries;
+    for (int n = 0; n < 40; n++) {
+        targets.push_back(RandomSequence(rng, n % 8 == 0 ? n % 3 : 5 + n * 4));
+        queries.push_back(NoisyCopy(rng, targets.back(), 0.15f));
+    }
+    AlignConfig nonUnit(AlignParams(2, -1, -2, -2), GLOBAL);
+
+    for (int numThreads = 1; numThreads <= 3; numThreads += 2) {
+        boost::shared_ptr<PairwiseAlignmentBatch> editBatch(
+            AlignBatch(targets, queries, AlignConfig::Default(), numThreads));
+        boost::shared_ptr<PairwiseAlignmentBatch> nwBatch(
+            AlignBatch(targets, queries, nonUnit, numThreads));
+        boost::shared_ptr<PairwiseAlignmentBatch> affineBatch(
+            AlignAffineBatch(targets, queries, DefaultAffineAlignmentParams(), numThreads));
+        ASSERT_EQ(40, editBatch->Size());
+        ASSERT_EQ(41u, editBatch->Offsets().size());
+        EXPECT_EQ(editBatch->Offsets().back(), static_cast<int>(editBatch->Targets().length()));
+
+        for (int i = 0; i < 40; i++) {
+            int score;
+            boost::shared_ptr<PairwiseAlignment> a(Align(targets[i], queries[i], &score));
+            EXPECT_EQ(a->Target(), editBatch->Target(i));
+            EXPECT_EQ(a->Query(), editBatch->Query(i));
+            EXPECT_EQ(a->Transcript(), editBatch->Transcript(i));
+            EXPECT_EQ(score, editBatch->Score(i));
+            if (a->Length() > 0) {
+                EXPECT_FLOAT_EQ(a->Accuracy(), editBatch->Accuracy(i));
+            }
+
+            a.reset(Align(targets[i], queries[i], &score, nonUnit));
+            EXPECT_EQ(a->Transcript(), nwBatch->Transcript(i));
+            EXPECT_EQ(score, nwBatch->Score(i));
+
+            a.reset(AlignAffine(targets[i], queries[i]));
+            EXPECT_EQ(a->Target(), affineBatch->Target(i));
+            EXPECT_EQ(a->Query(), affineBatch->Query(i));
+        }
+    }
+
+    queries.pop_back();
+    EXPECT_THROW(AlignBatch(targets, queries), InvalidInputError);
+}
+
 // ---------------- Linear-space alignment tests -----------------------
 
 TEST(LinearAlignmentTests, BasicTest)
@@ -288,6 +591,27 @@ TEST(LinearAlignmentTests, BasicTest)
     EXPECT_EQ(score, peerScore);
 }
 
+TEST(LinearAlignmentTests, ParallelMatchesSerial)
+{
+    AlignConfig config(AlignParams(2, -1, -2, -2), GLOBAL);
+    Rng rng(11);
+    for (int n = 0; n < 20; n++) {
+        std::string target = RandomSequence(rng, 2 + n * 97);
+        std::string query = NoisyCopy(rng, target, 0.15f);
+
+        int score, parallelScore, peerScore;
+        PairwiseAlignment* a = AlignLinear(target, query, &score);
+        PairwiseAlignment* b = AlignLinear(target, query, &parallelScore, config, 4);
+        PairwiseAlignment* peer = Align(target, query, &peerScore, config);
+        EXPECT_EQ(a->Transcript(), b->Transcript());
+        EXPECT_EQ(score, parallelScore);
+        EXPECT_EQ(peerScore, score);
+        delete peer;
+        delete b;
+        delete a;
+    }
+}
+
 #if 0
 TEST(LinearAlignmentTests, SemiglobalTests)
 {
@@ -0,0 +1,121 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ConsensusCore/ChromeTrace.hpp>
+#include <ConsensusCore/PerfStats.hpp>
+#include <ConsensusCore/Quiver/MutationEnumerator.hpp>
+#include <ConsensusCore/Quiver/MutationScorer.hpp>
+#include <ConsensusCore/Quiver/QuiverConfig.hpp>
+#include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/SseRecursor.hpp>
+#include <ConsensusCore/Types.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+void ScoreAllMutations()
+{
+    std::string tpl = "GATTACAGATTACAGATTACAGATTACA";
+    std::string seq = "GATTACAGATTCAGATTACAGGATTACA";
+    QvEvaluator e(Read(QvSequenceFeatures(seq), "anonymous", "unknown"), tpl, TestingParams());
+    SparseSseQvRecursor recursor(BASIC_MOVES, BandingOptions(4, 200));
+    SparseSseQvMutationScorer scorer(e, recursor);
+    foreach (const Mutation& m, UniqueSingleBaseMutationEnumerator(tpl).Mutations()) {
+        scorer.ScoreMutation(m);
+    }
+}
+}
+
+TEST(PerfStatsTest, CountsPerPhase)
+{
+    ResetPerfStats();
+    ScoreAllMutations();
+    // Counts made on a thread that has since exited are kept
+    std::thread worker(ScoreAllMutations);
+    worker.join();
+
+    PerfStats stats = CollectPerfStats();
+    ASSERT_EQ(PERF_NUM_PHASES, static_cast<int>(stats.Phases.size()));
+    EXPECT_EQ("FillAlphaBeta", stats.Phases[PERF_FILL_ALPHA_BETA].Phase);
+    EXPECT_EQ("ScoreMutation", stats.Phases[PERF_SCORE_MUTATION].Phase);
+
+    const PhaseStats& fill = stats.Phases[PERF_FILL_ALPHA_BETA];
+    const PhaseStats& score = stats.Phases[PERF_SCORE_MUTATION];
+    const PhaseStats& extend = stats.Phases[PERF_EXTEND];
+    if (stats.Enabled) {
+        EXPECT_EQ(2, fill.Calls);
+        EXPECT_LT(0, fill.Cells);
+        EXPECT_EQ(2, stats.Phases[PERF_ENUMERATE_MUTATIONS].Calls);
+        EXPECT_LT(0, score.Calls);
+        EXPECT_LT(0, extend.Cells);
+        EXPECT_LE(extend.Calls, score.Calls);
+        EXPECT_LE(0, score.Seconds);
+    } else {
+        EXPECT_EQ(0, fill.Calls);
+        EXPECT_EQ(0, score.Calls);
+        EXPECT_EQ(0, stats.SparseVectorReallocs);
+    }
+
+    ResetPerfStats();
+    EXPECT_EQ(0, CollectPerfStats().Phases[PERF_SCORE_MUTATION].Calls);
+}
+
+TEST(PerfStatsTest, TraceHooksSeeEveryCallStartAndEnd)
+{
+    int begins = 0, ends = 0, depth = 0, maxDepth = 0;
+    SetPerfTraceHook([&](const PerfTraceEvent& e) {
+        depth += e.Begin ? 1 : -1;
+        maxDepth = std::max(maxDepth, depth);
+        (e.Begin ? begins : ends)++;
+        EXPECT_STREQ(CollectPerfStats().Phases[e.Phase].Phase.c_str(), e.Name);
+    });
+    ScoreAllMutations();
+    SetPerfTraceHook(PerfTraceHook());
+
+    EXPECT_EQ(begins, ends);
+    EXPECT_EQ(0, depth);
+    if (PerfTraceEnabled()) {
+        EXPECT_LT(0, begins);
+        // ScoreMutation encloses Extend
+        EXPECT_LE(2, maxDepth);
+    } else {
+        EXPECT_EQ(0, begins);
+    }
+}
+
+TEST(PerfStatsTest, WritesAChromeTrace)
+{
+    std::string filename = "/tmp/ConsensusCoreTestTrace.json";
+    if (!PerfTraceEnabled()) {
+        EXPECT_THROW(StartChromeTrace(filename), UnsupportedFeatureError);
+        return;
+    }
+
+    StartChromeTrace(filename);
+    EXPECT_THROW(StartChromeTrace(filename), InvalidInputError);
+    ScoreAllMutations();
+    std::thread worker(ScoreAllMutations);
+    worker.join();
+    StopChromeTrace();
+    EXPECT_THROW(StopChromeTrace(), InvalidInputError);
+
+    std::ifstream in(filename.c_str());
+    std::stringstream json;
+    json << in.rdbuf();
+    std::remove(filename.c_str());
+    std::string trace = json.str();
+    EXPECT_EQ(0u, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"ScoreMutation\",\"ph\":\"B\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"FillAlphaBeta\",\"ph\":\"E\""));
+}
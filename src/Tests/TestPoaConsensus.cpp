@@ -14,10 +14,16 @@
 #include <vector>
 
 #include <ConsensusCore/Align/AlignConfig.hpp>
+#include <ConsensusCore/MemoryUsage.hpp>
 #include <ConsensusCore/Mutation.hpp>
 #include <ConsensusCore/Poa/PoaConsensus.hpp>
+#include <ConsensusCore/Poa/RangeFinder.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
 #include <ConsensusCore/Utils.hpp>
 
+#include "Random.hpp"
+
 using std::string;
 using std::vector;
 using std::cout;
@@ -455,6 +461,561 @@ TEST(PoaConsensus, TestLongInsert)
     delete pc;
 }
 
+TEST(PoaConsensus, TestScatteredErrorsAllModes)
+{
+    // Read lengths that are not multiples of four, with errors spread
+    // along the template, exercise both the vector and the scalar rows
+    // of the alignment column fill.
+    std::string tpl = "GATTACAGGCTAACGTTAGCCATGCAATCGGATCCA";
+    vector<std::string> reads;
+    reads += "GATTACAGGCTAACGTTAGCCATGCAATCGGATCCA",
+        "GATTACAGGCTAACGTTAGCCAATGCAATCGGATCCA",  // insertion
+        "GATTACAGGCTAACTTTAGCCATGCAATCGGATCCA",   // substitution
+        "GATTACAGGCTAACGTTAGCCATGCAATCGATCCA",    // deletion
+        "GATTACAGGGCTAACGTTAGCCATGCAATCGGATCCA",  // insertion
+        "GATTACAGGCTAACGTTAGCCATGCAATCGGATCCA";
+    AlignMode modes[] = {GLOBAL, SEMIGLOBAL, LOCAL};
+    foreach (AlignMode mode, modes) {
+        const PoaConsensus* pc = PoaConsensus::FindConsensus(reads, mode);
+        EXPECT_EQ(tpl, pc->Sequence);
+        delete pc;
+    }
+}
+
+TEST(PoaGraph, TryAddReadMatchesAddRead)
+{
+    // AddRead reuses one alignment matrix from read to read; a graph
+    // built through separately allocated matrices must come out the same.
+    vector<std::string> reads;
+    reads += "GATTACAGGCTAACGTTAGCCATGCA", "GATTACAGGCTAACTTTAGCCATGCA",
+        "GATTACAGGCTAACGTTAGCCAATGCATT", "GATTACAGCTAACGTTAGCCATGCA";
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+
+    PoaGraph reused, fresh;
+    foreach (const std::string& read, reads) {
+        reused.AddRead(read, config);
+        if (fresh.NumReads() == 0) {
+            fresh.AddFirstRead(read);
+        } else {
+            PoaAlignmentMatrix* mat = fresh.TryAddRead(read, config);
+            fresh.CommitAdd(mat);
+            delete mat;
+        }
+    }
+    EXPECT_EQ(reused.ToGraphViz(), fresh.ToGraphViz());
+}
+
+TEST(PoaGraph, MoveCopyAndRelease)
+{
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+    PoaGraph pg;
+    pg.AddRead("GATTACA", config);
+    pg.AddRead("GATTACA", config);
+    pg.AddRead("GATCACA", config);
+    const std::string dot = pg.ToGraphViz();
+
+    PoaGraph moved(std::move(pg));
+    EXPECT_EQ(dot, moved.ToGraphViz());
+    pg = moved;
+    EXPECT_EQ(dot, pg.ToGraphViz());
+
+    const PoaConsensus* found = pg.FindConsensus(config);
+    const PoaConsensus* released = pg.ReleaseConsensus(config);
+    EXPECT_EQ(found->Sequence, released->Sequence);
+    EXPECT_EQ(found->Path, released->Path);
+    EXPECT_EQ(dot, released->Graph.ToGraphViz());
+    EXPECT_EQ(0u, pg.NumReads());
+    delete found;
+    delete released;
+}
+
+TEST(PoaGraph, PruneDropsSingleReadNodes)
+{
+    // Each noisy read carries an insertion no other read has
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+    vector<std::string> reads;
+    reads += "GATTACAGGCTAACGTTAGCCATGCA", "GATTACAGGCTTAACGTTAGCCATGCA",
+        "GATTACAGGCTAACGTTAGCCATGCA", "GATTACAGGCTAACGTTAGGCCATGCA",
+        "GATTACAGGCTAACGTTAGCCATGCA", "GAATTACAGGCTAACGTTAGCCATGCA";
+    PoaGraph pg;
+    foreach (const std::string& read, reads) {
+        pg.AddRead(read, config);
+    }
+    const PoaConsensus* before = pg.FindConsensus(config);
+
+    size_t numVertices = pg.NumVertices();
+    EXPECT_EQ(3u, pg.Prune(2, config));
+    EXPECT_EQ(numVertices - 3, pg.NumVertices());
+    EXPECT_EQ(0u, pg.Prune(2, config));
+
+    const PoaConsensus* after = pg.FindConsensus(config);
+    EXPECT_EQ(before->Sequence, after->Sequence);
+    EXPECT_EQ(26u + 2, pg.NumVertices());
+    delete before;
+    delete after;
+
+    // the pruned graph takes further reads
+    pg.AddRead("GATTACAGGCTAACGTTAGCCATGCA", config);
+    const PoaConsensus* more = pg.FindConsensus(config);
+    EXPECT_EQ("GATTACAGGCTAACGTTAGCCATGCA", more->Sequence);
+    delete more;
+}
+
+TEST(PoaGraph, PruneKeepsConsensusPath)
+{
+    // The two reads disagree at one base; whichever the consensus
+    // takes survives, though no base there has two reads.
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+    PoaGraph pg;
+    pg.AddRead("GATTACA", config);
+    pg.AddRead("GATCACA", config);
+    const PoaConsensus* before = pg.FindConsensus(config);
+    EXPECT_EQ(1u, pg.Prune(2, config));
+    const PoaConsensus* after = pg.FindConsensus(config);
+    EXPECT_EQ(before->Sequence, after->Sequence);
+    delete before;
+    delete after;
+}
+
+TEST(PoaGraph, BinaryRoundTrip)
+{
+    AlignConfig config = DefaultPoaConfig(LOCAL);
+    vector<std::string> reads;
+    reads += "GATTACAGGCTAACGTTAGCCATGCA", "GATTACAGGCTTAACGTTAGCCATGCA",
+        "TACAGGCTAACGTTAGGCCATG", "GATTACAGGCTAACGTAGCCATGCATT";
+    PoaGraph pg;
+    foreach (const std::string& read, reads) {
+        pg.AddRead(read, config);
+    }
+
+    const std::string bytes = pg.ToBinary();
+    PoaGraph loaded = PoaGraph::FromBinary(bytes.data(), bytes.size());
+    EXPECT_EQ(pg.NumReads(), loaded.NumReads());
+    EXPECT_EQ(pg.NumVertices(), loaded.NumVertices());
+    EXPECT_EQ(pg.ToGraphViz(PoaGraph::VERBOSE_NODES), loaded.ToGraphViz(PoaGraph::VERBOSE_NODES));
+    EXPECT_EQ(bytes, loaded.ToBinary());
+
+    // the loaded graph takes further reads just as the original does
+    pg.AddRead("GATTACAGGCTAACGTTAGCCATGCA", config);
+    loaded.AddRead("GATTACAGGCTAACGTTAGCCATGCA", config);
+    EXPECT_EQ(pg.ToBinary(), loaded.ToBinary());
+    const PoaConsensus* expected = pg.FindConsensus(config);
+    const PoaConsensus* pc = loaded.FindConsensus(config);
+    EXPECT_EQ(expected->Sequence, pc->Sequence);
+    delete expected;
+    delete pc;
+
+    // an empty graph round-trips too
+    const std::string empty = PoaGraph().ToBinary();
+    EXPECT_EQ(2u, PoaGraph::FromBinary(empty.data(), empty.size()).NumVertices());
+}
+
+TEST(PoaGraph, BinaryRejectsMalformedInput)
+{
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+    PoaGraph pg;
+    pg.AddRead("GATTACA", config);
+    pg.AddRead("GATCACA", config);
+    const std::string bytes = pg.ToBinary();
+
+    EXPECT_THROW(PoaGraph::FromBinary(bytes.data(), bytes.size() - 1), InvalidInputError);
+    EXPECT_THROW(PoaGraph::FromBinary(bytes.data(), 10), InvalidInputError);
+    std::string badMagic = bytes;
+    badMagic[0] = 'X';
+    EXPECT_THROW(PoaGraph::FromBinary(badMagic.data(), badMagic.size()), InvalidInputError);
+    std::string badVersion = bytes;
+    badVersion[8] = 99;
+    EXPECT_THROW(PoaGraph::FromBinary(badVersion.data(), badVersion.size()),
+                 UnsupportedFeatureError);
+
+    // Turn the last edge around; it then closes a cycle or leaves a
+    // vertex dangling
+    std::string flipped = bytes;
+    const size_t last = flipped.size() - 8;
+    std::string source = flipped.substr(last, 4);
+    flipped.replace(last, 4, flipped.substr(last + 4, 4));
+    flipped.replace(last + 4, 4, source);
+    EXPECT_THROW(PoaGraph::FromBinary(flipped.data(), flipped.size()), InvalidInputError);
+}
+
+TEST(PoaGraph, TryAddReadsMatchesTryAddRead)
+{
+    vector<std::string> reads;
+    reads += "GATTACAGGCTAACGTTAGCCATGCA", "GATTACAGGCTAACTTTAGCCATGCA",
+        "GATTACAGGCTAACGTTAGCCAATGCATT", "GATTACAGCTAACGTTAGCCATGCA", "CCCCGGGG",
+        "GATTACAGGCTAACGTTAGCC";
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+    PoaGraph pg;
+    pg.AddRead(reads[0], config);
+
+    int threadCounts[] = {1, 4};
+    foreach (int numThreads, threadCounts) {
+        vector<PoaAlignmentMatrix*> mats = pg.TryAddReads(reads, config, numThreads);
+        ASSERT_EQ(reads.size(), mats.size());
+        for (size_t i = 0; i < reads.size(); i++) {
+            detail::MinimizerRangeFinder rangeFinder;
+            PoaAlignmentMatrix* mat = pg.TryAddRead(reads[i], config, &rangeFinder);
+            EXPECT_EQ(mat->Score(), mats[i]->Score());
+            delete mat;
+        }
+        // the graph was left as it was, and any one may be committed
+        EXPECT_EQ(1u, pg.NumReads());
+        foreach (PoaAlignmentMatrix* mat, mats) {
+            delete mat;
+        }
+    }
+
+    vector<PoaAlignmentMatrix*> mats = pg.TryAddReads(reads, config, 2);
+    pg.CommitAdd(mats[1]);
+    EXPECT_EQ(2u, pg.NumReads());
+    foreach (PoaAlignmentMatrix* mat, mats) {
+        delete mat;
+    }
+}
+
+TEST(PoaGraph, ParallelColumnsMatchSerial)
+{
+    // Noisy reads of a template long enough to align in parallel, whose
+    // errors open bubbles for the columns to be made side by side
+    Rng rng(7);
+    std::string tpl = RandomSequence(rng, 400);
+    boost::random::uniform_int_distribution<> posDist(0, 390);
+    vector<std::string> reads;
+    for (int r = 0; r < 8; r++) {
+        std::string read = tpl;
+        for (int e = 0; e < 6; e++) {
+            int pos = posDist(rng);
+            switch ((r + e) % 3) {
+                case 0:
+                    read.insert(pos, "T");
+                    break;
+                case 1:
+                    read[pos] = (read[pos] == 'A' ? 'C' : 'A');
+                    break;
+                case 2:
+                    read.erase(pos, 1);
+                    break;
+            }
+        }
+        reads.push_back(read);
+    }
+
+    AlignMode modes[] = {GLOBAL, SEMIGLOBAL, LOCAL};
+    foreach (AlignMode mode, modes) {
+        AlignConfig config = DefaultPoaConfig(mode);
+        PoaGraph serial, parallel;
+        parallel.SetNumThreads(4);
+        EXPECT_EQ(4, parallel.NumThreads());
+        detail::MinimizerRangeFinder serialFinder, parallelFinder;
+        for (size_t r = 0; r < reads.size(); r++) {
+            // banded and unbanded in turn
+            serial.AddRead(reads[r], config, (r % 2) ? &serialFinder : NULL);
+            parallel.AddRead(reads[r], config, (r % 2) ? &parallelFinder : NULL);
+        }
+        ASSERT_GE(parallel.NumVertices(), 256u);
+        EXPECT_EQ(serial.ToGraphViz(), parallel.ToGraphViz());
+
+        PoaAlignmentMatrix* serialMat = serial.TryAddRead(tpl, config);
+        PoaAlignmentMatrix* parallelMat = parallel.TryAddRead(tpl, config);
+        EXPECT_EQ(serialMat->Score(), parallelMat->Score());
+        delete serialMat;
+        delete parallelMat;
+    }
+
+    PoaGraph pg;
+    pg.SetNumThreads(1);
+    EXPECT_EQ(1, pg.NumThreads());
+}
+
+TEST(PoaGraph, CheckpointedMatchesUnbounded)
+{
+    Rng rng(11);
+    std::string tpl = RandomSequence(rng, 300);
+    boost::random::uniform_int_distribution<> posDist(0, 290);
+    vector<std::string> reads;
+    for (int r = 0; r < 8; r++) {
+        std::string read = tpl;
+        for (int e = 0; e < 5; e++) {
+            int pos = posDist(rng);
+            switch ((r + e) % 3) {
+                case 0:
+                    read.insert(pos, "G");
+                    break;
+                case 1:
+                    read[pos] = (read[pos] == 'A' ? 'T' : 'A');
+                    break;
+                case 2:
+                    read.erase(pos, 1);
+                    break;
+            }
+        }
+        // clipped reads, for the local and semiglobal End moves
+        reads.push_back(read.substr(r % 4 * 10, read.length() - r % 3 * 15));
+    }
+
+    AlignMode modes[] = {GLOBAL, SEMIGLOBAL, LOCAL};
+    foreach (AlignMode mode, modes) {
+        AlignConfig config = DefaultPoaConfig(mode);
+        // room for segments of about 16 columns, and of 1
+        size_t budgets[] = {(tpl.length() + 1) * 6 * 32, 1};
+        foreach (size_t budget, budgets) {
+            PoaGraph unbounded, bounded;
+            bounded.SetMemoryBudget(budget);
+            EXPECT_EQ(budget, bounded.MemoryBudget());
+            detail::MinimizerRangeFinder unboundedFinder, boundedFinder;
+            for (size_t r = 0; r < reads.size(); r++) {
+                // banded and unbanded in turn
+                vector<PoaGraph::Vertex> unboundedPath, boundedPath;
+                unbounded.AddRead(reads[r], config, (r % 2) ? &unboundedFinder : NULL,
+                                  &unboundedPath);
+                bounded.AddRead(reads[r], config, (r % 2) ? &boundedFinder : NULL,
+                                &boundedPath);
+                EXPECT_EQ(unboundedPath, boundedPath);
+            }
+            EXPECT_EQ(unbounded.ToGraphViz(), bounded.ToGraphViz());
+
+            int64_t before = ProcessMemoryUsage().PoaBytes;
+            PoaAlignmentMatrix* unboundedMat = unbounded.TryAddRead(tpl, config);
+            int64_t unboundedBytes = ProcessMemoryUsage().PoaBytes - before;
+            PoaAlignmentMatrix* boundedMat = bounded.TryAddRead(tpl, config);
+            int64_t boundedBytes = ProcessMemoryUsage().PoaBytes - before - unboundedBytes;
+            EXPECT_EQ(unboundedMat->Score(), boundedMat->Score());
+            // (with segments of a column, nearly every column is kept)
+            if (budget > 1) {
+                EXPECT_LT(boundedBytes, unboundedBytes / 4);
+            }
+            unbounded.CommitAdd(unboundedMat);
+            bounded.CommitAdd(boundedMat);
+            EXPECT_EQ(unbounded.ToGraphViz(), bounded.ToGraphViz());
+            delete unboundedMat;
+            delete boundedMat;
+        }
+    }
+}
+
+TEST(PoaGraph, TryAddReadsRejectsEmptyGraph)
+{
+    vector<std::string> reads;
+    reads += "GATTACA";
+    PoaGraph pg;
+    EXPECT_THROW(pg.TryAddReads(reads, DefaultPoaConfig(GLOBAL)), InvalidInputError);
+}
+
+TEST(PoaGraph, BandedMatchesUnbanded)
+{
+    // Reads long enough to share minimizers with the consensus are
+    // aligned within a band; with errors few and far between, the band
+    // holds the best alignment, so the graph comes out the same.
+    Rng rng(42);
+    std::string tpl = RandomSequence(rng, 600);
+    boost::random::uniform_int_distribution<> posDist(0, 550);
+    vector<std::string> reads;
+    for (int r = 0; r < 6; r++) {
+        std::string read = tpl;
+        int pos = posDist(rng);
+        switch (r % 3) {
+            case 0:
+                read.insert(pos, "T");
+                break;
+            case 1:
+                read[pos] = (read[pos] == 'A' ? 'C' : 'A');
+                break;
+            case 2:
+                read.erase(pos, 1);
+                break;
+        }
+        reads.push_back(read);
+    }
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+
+    PoaGraph banded, unbanded;
+    detail::MinimizerRangeFinder rangeFinder;
+    foreach (const std::string& read, reads) {
+        banded.AddRead(read, config, &rangeFinder);
+        unbanded.AddRead(read, config);
+    }
+    EXPECT_EQ(unbanded.ToGraphViz(), banded.ToGraphViz());
+
+    const PoaConsensus* pc = PoaConsensus::FindConsensus(reads, config);
+    EXPECT_EQ(tpl, pc->Sequence);
+    delete pc;
+}
+
+TEST(PoaGraph, ConsensusFollowsReadsAdded)
+{
+    // The consensus path is kept between reads; adding one must still
+    // be reflected in the next consensus.
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+    PoaGraph pg;
+    pg.AddRead("GATTACA", config);
+    pg.AddRead("GATTACA", config);
+    const PoaConsensus* before = pg.FindConsensus(config);
+    EXPECT_EQ("GATTACA", before->Sequence);
+    delete before;
+
+    pg.AddRead("GATCACA", config);
+    pg.AddRead("GATCACA", config);
+    pg.AddRead("GATCACA", config);
+    const PoaConsensus* after = pg.FindConsensus(config);
+    EXPECT_EQ("GATCACA", after->Sequence);
+    delete after;
+}
+
+TEST(PoaConsensus, BatchMatchesOneAtATime)
+{
+    vector<vector<std::string> > readSets(7);
+    readSets[0] += "GGG", "TGGG";
+    readSets[1] += "GGG", "GTG", "GTG";
+    readSets[2] += "GATTACAGGCTAACGTTAGCCATGCA", "GATTACAGGCTAACTTTAGCCATGCA",
+        "GATTACAGGCTAACGTTAGCCAATGCATT";
+    readSets[3] += "TTTACAGGATAGTGCCGCCAATCTTCCAGTGATACCCCG", "TTTACAGGATAGTGCCGGCCAATCTTCC";
+    readSets[4] += "A";
+    readSets[5] += "ACGTACGTACGT", "ACGTACGACGT", "ACGTTACGTACGT", "ACGTACGTACGT";
+    readSets[6] += "CCCCGGGG", "CCCGGGG";
+
+    AlignMode modes[] = {GLOBAL, SEMIGLOBAL, LOCAL};
+    foreach (AlignMode mode, modes) {
+        vector<const PoaConsensus*> batch =
+            PoaConsensus::FindConsensusBatch(readSets, mode, -INT_MAX, 3);
+        ASSERT_EQ(readSets.size(), batch.size());
+        for (size_t i = 0; i < readSets.size(); i++) {
+            const PoaConsensus* pc = PoaConsensus::FindConsensus(readSets[i], mode);
+            EXPECT_EQ(pc->Sequence, batch[i]->Sequence);
+            EXPECT_EQ(pc->ToGraphViz(), batch[i]->ToGraphViz());
+            delete pc;
+            delete batch[i];
+        }
+    }
+}
+
+TEST(PoaConsensus, BatchRejectsEmptyRead)
+{
+    vector<vector<std::string> > readSets(3);
+    readSets[0] += "GGG", "GGG";
+    readSets[1] += "GGG", "";
+    readSets[2] += "TTT";
+    EXPECT_THROW(PoaConsensus::FindConsensusBatch(readSets, GLOBAL, -INT_MAX, 2),
+                 InvalidInputError);
+}
+
+TEST(PoaGraph, MergeConsensusWeighsByReads)
+{
+    AlignConfig config = DefaultPoaConfig(GLOBAL);
+    vector<std::string> reads;
+    reads += "GATCACA", "GATCACA", "GATCACA", "GATTACA", "GATCACA", "GATCACA";
+    const PoaConsensus* merged = PoaConsensus::FindConsensus(reads, config);
+
+    // Four reads one way are outvoted by the five of the six merged
+    // that go the other
+    PoaGraph pg;
+    for (int r = 0; r < 4; r++) {
+        pg.AddRead("GATTACA", config);
+    }
+    vector<PoaGraph::Vertex> path;
+    pg.MergeConsensus(*merged, config, NULL, &path);
+    EXPECT_EQ(10u, pg.NumReads());
+    EXPECT_EQ(7u, path.size());
+    const PoaConsensus* pc = pg.FindConsensus(config);
+    EXPECT_EQ("GATCACA", pc->Sequence);
+    delete pc;
+    delete merged;
+}
+
+TEST(PoaConsensus, HierarchicalRecoversTemplate)
+{
+    Rng rng(5);
+    std::string tpl = RandomSequence(rng, 250);
+    boost::random::uniform_int_distribution<> posDist(0, 240);
+    vector<std::string> reads;
+    for (int r = 0; r < 24; r++) {
+        std::string read = tpl;
+        for (int e = 0; e < 2; e++) {
+            int pos = posDist(rng);
+            switch ((r + e) % 3) {
+                case 0:
+                    read.insert(pos, "C");
+                    break;
+                case 1:
+                    read[pos] = (read[pos] == 'G' ? 'T' : 'G');
+                    break;
+                case 2:
+                    read.erase(pos, 1);
+                    break;
+            }
+        }
+        reads.push_back(read);
+    }
+
+    AlignMode modes[] = {GLOBAL, SEMIGLOBAL, LOCAL};
+    foreach (AlignMode mode, modes) {
+        AlignConfig config = DefaultPoaConfig(mode);
+        const PoaConsensus* serial =
+            PoaConsensus::FindConsensusHierarchical(reads, config, -INT_MAX, 4, 1);
+        const PoaConsensus* parallel =
+            PoaConsensus::FindConsensusHierarchical(reads, config, -INT_MAX, 4, 3);
+        EXPECT_EQ(tpl, parallel->Sequence);
+        EXPECT_EQ(24u, parallel->Graph.NumReads());
+        EXPECT_TRUE(parallel->ReadPaths.empty());
+        EXPECT_EQ(serial->ToGraphViz(), parallel->ToGraphViz());
+        delete serial;
+        delete parallel;
+    }
+
+    // Too few reads to divide
+    vector<std::string> few(reads.begin(), reads.begin() + 3);
+    const PoaConsensus* pc =
+        PoaConsensus::FindConsensusHierarchical(few, DefaultPoaConfig(GLOBAL), -INT_MAX, 4, 2);
+    EXPECT_EQ(3u, pc->ReadPaths.size());
+    delete pc;
+}
+
+TEST(PoaConsensus, ToMappedReadPlacesReads)
+{
+    Rng rng(11);
+    std::string tpl = RandomSequence(rng, 200);
+    vector<std::string> reads;
+    for (int k = 0; k < 6; k++) {
+        std::string read = tpl;
+        read[20 + 30 * k] = (read[20 + 30 * k] == 'A') ? 'C' : 'A';
+        reads.push_back(read);
+    }
+    reads.push_back(tpl.substr(50, 100));
+    reads.push_back(tpl);
+    const PoaConsensus* pc = PoaConsensus::FindConsensus(reads, SEMIGLOBAL);
+    ASSERT_EQ(tpl, pc->Sequence);
+    ASSERT_EQ(reads.size(), pc->ReadPaths.size());
+
+    // The partial read spans its part of the consensus, and its band
+    // reaches from the first cell of the alignment to the last
+    MappedRead partial = pc->ToMappedRead(6, Read(QvSequenceFeatures(reads[6]), "", ""));
+    EXPECT_EQ(FORWARD_STRAND, partial.Strand);
+    EXPECT_EQ(50, partial.TemplateStart);
+    EXPECT_EQ(150, partial.TemplateEnd);
+    ASSERT_EQ(101u, partial.BandHint.size());
+    EXPECT_EQ(0, partial.BandHint.front().Begin);
+    EXPECT_EQ(101, partial.BandHint.back().End);
+
+    // The exact read aligns along the diagonal, on either strand
+    StrandEnum strands[] = {FORWARD_STRAND, REVERSE_STRAND};
+    foreach (StrandEnum strand, strands) {
+        std::string seq = (strand == FORWARD_STRAND) ? tpl : ReverseComplement(tpl);
+        MappedRead exact = pc->ToMappedRead(7, Read(QvSequenceFeatures(seq), "", ""), strand);
+        EXPECT_EQ(strand, exact.Strand);
+        EXPECT_EQ(0, exact.TemplateStart);
+        EXPECT_EQ(200, exact.TemplateEnd);
+        ASSERT_EQ(201u, exact.BandHint.size());
+        for (int j = 0; j <= 200; j++) {
+            EXPECT_LE(exact.BandHint[j].Begin, j);
+            EXPECT_GT(exact.BandHint[j].End, j);
+        }
+    }
+
+    EXPECT_THROW(pc->ToMappedRead(8, Read(QvSequenceFeatures(tpl), "", "")), InvalidInputError);
+    EXPECT_THROW(pc->ToMappedRead(7, Read(QvSequenceFeatures("GATTACA"), "", "")),
+                 InvalidInputError);
+    delete pc;
+}
+
 #if 0
 TEST(PoaConsensus, TestMutations)
 {
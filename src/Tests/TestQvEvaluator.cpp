@@ -2,8 +2,13 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <cfloat>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -89,6 +94,49 @@ TEST_F(QvEvaluatorTest, MergeVsMerge4)
     }
 }
 
+TEST_F(QvEvaluatorTest, MoveScoresFollowTheModel)
+{
+    // Fractional QVs, so the precomputed scores are checked away from
+    // integer QV values too
+    std::string seq = "ACGTNA";
+    float insQv[] = {0.5f, 1, 2.25f, 3, 4, 5};
+    float subsQv[] = {6, 7.5f, 8, 9, 10, 11};
+    float delQv[] = {12, 13, 14.75f, 15, 16, 17};
+    float delTag[] = {'A', 'N', 'G', 0, 'T', 'C'};
+    float mergeQv[] = {18, 19, 20, 21.5f, 22, 23};
+    QvSequenceFeatures features(seq, insQv, subsQv, delQv, delTag, mergeQv);
+    QvModelParams params = TestingParams();
+    QvEvaluator e(Read(features, "anonymous", "unknown"), "CCGGTTAA", params);
+
+    EXPECT_FLOAT_EQ(params.Mismatch + params.MismatchS * 6, e.Inc(0, 0));
+    EXPECT_FLOAT_EQ(params.Match, e.Inc(1, 0));
+    EXPECT_FLOAT_EQ(params.DeletionWithTag + params.DeletionWithTagS * 14.75f, e.Del(2, 2));
+    EXPECT_FLOAT_EQ(params.DeletionN, e.Del(2, 0));
+    EXPECT_FLOAT_EQ(params.Branch + params.BranchS * 2.25f, e.Extra(2, 2));
+    EXPECT_FLOAT_EQ(params.Nce + params.NceS * 0.5f, e.Extra(0, 0));
+    EXPECT_FLOAT_EQ(params.Merge[3] + params.MergeS[3] * 21.5f, e.Merge(3, 4));
+    EXPECT_EQ(-FLT_MAX, e.Merge(0, 0));
+
+    // Copies share the precomputed scores
+    QvEvaluator copy(e);
+    EXPECT_EQ(e.Inc(0, 0), copy.Inc(0, 0));
+    EXPECT_EQ(e.Merge(3, 4), copy.Merge(3, 4));
+
+    // The row past the end deletes without a tag, and unpinned ends
+    // delete for free, in the scalar and the vector paths alike
+    EXPECT_FLOAT_EQ(params.DeletionN, e.Del(6, 0));
+    QvEvaluator unpinned(Read(features, "anonymous", "unknown"), "CCGGTTAA", params, false, false);
+    EXPECT_EQ(0.0f, unpinned.Del(0, 1));
+    EXPECT_EQ(0.0f, unpinned.Del(6, 0));
+    EXPECT_FLOAT_EQ(params.DeletionWithTag + params.DeletionWithTagS * 14.75f, unpinned.Del(2, 2));
+    for (int j = 0; j < unpinned.TemplateLength(); j++) {
+        COMPARE4(unpinned.Del4, unpinned.Del, 0, j);
+        COMPARE4(unpinned.Del4, unpinned.Del, 3, j);
+        COMPARE4(e.Del4, e.Del, 3, j);
+        COMPARE4(unpinned.Extra4, unpinned.Extra, 0, j);
+    }
+}
+
 TEST_F(QvEvaluatorTest, BadTagTest)
 {
     Rng rng(42);
@@ -112,3 +160,56 @@ TEST_F(QvEvaluatorTest, BadTagTest)
     delete[] delTag;
     delete[] mergeQv;
 }
+
+TEST(QvModelTest, TablesMatchScores)
+{
+    QvModel model(TestingParams());
+    const QvModelParams& p = model.Params();
+
+    // integral QVs are looked up, others computed, to the same values
+    for (float qv : {0.0f, 7.0f, 93.0f, 255.0f, 256.0f, 3.5f, -1.0f}) {
+        float mismatch = p.Mismatch + p.MismatchS * qv;
+        EXPECT_EQ(mismatch, model.Mismatch().Score(qv));
+        EXPECT_EQ(std::exp(mismatch), model.Mismatch().Prob(qv));
+        EXPECT_EQ(p.Nce + p.NceS * qv, model.Nce().Score(qv));
+        EXPECT_EQ(p.Merge[2] + p.MergeS[2] * qv, model.Merge(2).Score(qv));
+    }
+    EXPECT_EQ(std::exp(p.DeletionN), model.DeletionNProb());
+}
+
+TEST(FeatureTest, BorrowedFeatureSharesStorage)
+{
+    std::string seq = "GATTACA";
+    const int n = seq.length();
+    boost::shared_ptr<std::vector<float> > qvs(new std::vector<float>(5 * n, 7.0f));
+    float* base = &(*qvs)[0];
+    std::fill(base + 3 * n, base + 4 * n, 'A');  // DelTag
+    boost::weak_ptr<std::vector<float> > watch(qvs);
+
+    {
+        QvSequenceFeatures features(
+            seq, FloatFeature(base + 0 * n, n, qvs), FloatFeature(base + 1 * n, n, qvs),
+            FloatFeature(base + 2 * n, n, qvs), FloatFeature(base + 3 * n, n, qvs),
+            FloatFeature(base + 4 * n, n, qvs));
+        qvs.reset();
+
+        // the features view the caller's arrays, which they keep alive
+        EXPECT_FALSE(watch.expired());
+        EXPECT_EQ(base + 0 * n, features.InsQv.get());
+        EXPECT_EQ(base + 4 * n, features.MergeQv.get());
+        EXPECT_EQ(n, features.SubsQv.Length());
+        EXPECT_EQ(7.0f, features.DelQv[n - 1]);
+    }
+    EXPECT_TRUE(watch.expired());
+}
+
+TEST(QvEvaluatorReadTest, CopiesShareTheRead)
+{
+    boost::shared_ptr<const Read> read(
+        new Read(QvSequenceFeatures("GATTACA"), "anonymous", "unknown"));
+    boost::shared_ptr<const QvModel> model(new QvModel(TestingParams()));
+    QvEvaluator e(read, "GATTACA", model);
+    QvEvaluator copy(e);
+    EXPECT_EQ(3, read.use_count());
+    EXPECT_EQ(QvEvaluator(*read, "GATTACA", model).Inc(3, 3), copy.Inc(3, 3));
+}
@@ -0,0 +1,113 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/ReadStore.hpp>
+#include <ConsensusCore/Types.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+std::string TempFilename(const std::string& name)
+{
+    return "/tmp/" + name + "." + std::to_string(getpid()) + ".ccreads";
+}
+
+MappedRead TestRead(const std::string& seq, const std::string& name, const std::string& chemistry,
+                    StrandEnum strand, int tStart, int tEnd, bool pinStart, bool pinEnd)
+{
+    int n = seq.length();
+    std::vector<float> insQv(n), subsQv(n), delQv(n), delTag(n), mergeQv(n);
+    for (int i = 0; i < n; i++) {
+        insQv[i] = i;
+        subsQv[i] = 2 * i;
+        delQv[i] = 3 * i;
+        delTag[i] = "ACGTN"[i % 5];
+        mergeQv[i] = 100 - i;
+    }
+    QvSequenceFeatures f(seq, &insQv[0], &subsQv[0], &delQv[0], &delTag[0], &mergeQv[0]);
+    return MappedRead(Read(f, name, chemistry), strand, tStart, tEnd, pinStart, pinEnd);
+}
+
+void ExpectSameFeature(const FloatFeature& a, const FloatFeature& b)
+{
+    ASSERT_EQ(a.Length(), b.Length());
+    for (int i = 0; i < a.Length(); i++) {
+        EXPECT_EQ(a[i], b[i]);
+    }
+}
+}
+
+TEST(ReadStoreTest, RoundTrip)
+{
+    std::vector<MappedRead> reads;
+    reads.push_back(TestRead("GATTACA", "m1/1/0_7", "P6-C4", FORWARD_STRAND, 0, 7, true, true));
+    reads.push_back(TestRead("", "m1/2/0_0", "P6-C4", FORWARD_STRAND, 3, 3, true, true));
+    reads.push_back(TestRead("TTGACCAGTA", "m1/3/5_15", "S/P1-C1", REVERSE_STRAND, 2, 11, false,
+                             true));
+
+    std::string filename = TempFilename("RoundTrip");
+    ReadStore::Write(filename, reads);
+    std::vector<MappedRead> views;
+    {
+        ReadStore store(filename);
+        ASSERT_EQ(3, store.NumReads());
+        EXPECT_EQ(17, store.NumBases());
+        std::vector<std::string> chemistries;
+        chemistries.push_back("P6-C4");
+        chemistries.push_back("S/P1-C1");
+        EXPECT_EQ(chemistries, store.Chemistries());
+        views = store.Reads(0, 3);
+        EXPECT_THROW(store.ReadAt(3), InvalidInputError);
+    }
+    std::remove(filename.c_str());
+
+    // The views outlive the store, and the file
+    for (int r = 0; r < 3; r++) {
+        const MappedRead& mr = reads[r];
+        const MappedRead& view = views[r];
+        EXPECT_EQ(mr.ToString(), view.ToString());
+        EXPECT_EQ(mr.Features.Sequence().ToString(), view.Features.Sequence().ToString());
+        ExpectSameFeature(mr.Features.SequenceAsFloat, view.Features.SequenceAsFloat);
+        ExpectSameFeature(mr.Features.InsQv, view.Features.InsQv);
+        ExpectSameFeature(mr.Features.SubsQv, view.Features.SubsQv);
+        ExpectSameFeature(mr.Features.DelQv, view.Features.DelQv);
+        ExpectSameFeature(mr.Features.DelTag, view.Features.DelTag);
+        ExpectSameFeature(mr.Features.MergeQv, view.Features.MergeQv);
+        EXPECT_EQ(mr.Strand, view.Strand);
+        EXPECT_EQ(mr.PinStart, view.PinStart);
+        EXPECT_EQ(mr.PinEnd, view.PinEnd);
+    }
+
+    // The features of a read are views, not copies
+    EXPECT_EQ(views[0].Features.InsQv.get() + 7, views[2].Features.InsQv.get());
+}
+
+TEST(ReadStoreTest, RejectsOtherFiles)
+{
+    EXPECT_THROW(ReadStore("/nonexistent/reads.ccreads"), InvalidInputError);
+
+    std::string filename = TempFilename("RejectsOtherFiles");
+    {
+        std::ofstream out(filename.c_str());
+        out << "not a read store, but long enough to hold a header of one";
+    }
+    EXPECT_THROW(ReadStore store(filename), InvalidInputError);
+
+    // A store cut short
+    std::vector<MappedRead> reads(
+        1, TestRead("GATTACA", "m1/1/0_7", "P6-C4", FORWARD_STRAND, 0, 7, true, true));
+    ReadStore::Write(filename, reads);
+    ASSERT_EQ(0, truncate(filename.c_str(), 100));
+    EXPECT_THROW(ReadStore store(filename), InvalidInputError);
+    std::remove(filename.c_str());
+}
@@ -3,7 +3,9 @@
 #include <gtest/gtest.h>
 
 #include <boost/format.hpp>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -11,14 +13,19 @@
 #include <ConsensusCore/Features.hpp>
 #include <ConsensusCore/Matrix/DenseMatrix.hpp>
 #include <ConsensusCore/Matrix/SparseMatrix.hpp>
+#include <ConsensusCore/Quiver/CompactAlignment.hpp>
+#include <ConsensusCore/Quiver/Int16Recursor.hpp>
 #include <ConsensusCore/Quiver/QuiverConfig.hpp>
 #include <ConsensusCore/Quiver/QvEvaluator.hpp>
+#include <ConsensusCore/Quiver/ScaledRecursor.hpp>
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
 #include <ConsensusCore/Quiver/SimpleRecursor.hpp>
 #include <ConsensusCore/Quiver/SseRecursor.hpp>
 
 #include "MatrixPrinting.hpp"
 #include "ParameterSettings.hpp"
 #include "Random.hpp"
+#include "ScoreTolerance.hpp"
 
 using namespace ConsensusCore;  // NOLINT
 
@@ -26,7 +33,19 @@ using namespace ConsensusCore;  // NOLINT
 //  Instantiate the concrete test classes, by speciying the implementations we
 //  seek to test.
 //
-typedef testing::Types<SimpleQvRecursor, SseQvRecursor, SparseSimpleQvRecursor, SparseSseQvRecursor>
+typedef SimdRecursor<SparseMatrix, QvEvaluator, detail::ViterbiCombiner, 4> SparseSimd4QvRecursor;
+
+typedef testing::Types<SimpleQvRecursor, SseQvRecursor, SparseSimpleQvRecursor, SparseSseQvRecursor,
+                       SparseSimd4QvRecursor
+#ifdef __AVX2__
+                       ,
+                       SparseAvx2QvRecursor
+#endif
+#ifdef __AVX512F__
+                       ,
+                       SparseAvx512QvRecursor
+#endif
+                       >
     Implementations;
 
 TYPED_TEST_CASE(RecursorTest, Implementations);
@@ -132,6 +151,12 @@ TYPED_TEST(RecursorTest, SmallMergeTest)
     EXPECT_EQ("GA-T", alignment->Query());
     delete alignment;
 
+    // and the compact one
+    CompactAlignment compact = recursor.Traceback(e, alpha);
+    EXPECT_EQ("2M1D1M", compact.Cigar());
+    EXPECT_EQ("GATT", compact.Target(tpl));
+    EXPECT_EQ("GA-T", compact.Query("GAT"));
+
     // Make sure Beta gave the same score
     EXPECT_FLOAT_EQ(-2.0f, beta(0, 0));
     //    std::cout << std::endl;
@@ -282,7 +307,102 @@ TYPED_TEST(RecursorFuzzTest, AlphaBetaConcordance)
         M beta(readLength + 1, tplLength + 1);
 
         recursor.FillAlphaBeta(e, alpha, beta);
-        EXPECT_FLOAT_EQ(alpha(readLength, tplLength), beta(0, 0));
+        EXPECT_SCORE_EQ(alpha(readLength, tplLength), beta(0, 0));
+    }
+}
+
+TYPED_TEST(RecursorFuzzTest, FillStatistics)
+{
+    R recursor(BASIC_MOVES | MERGE, this->banding_);
+
+    foreach (const QvEvaluator& e, this->fuzzEvaluators_) {
+        int tplLength = e.TemplateLength();
+        int readLength = e.ReadLength();
+
+        M alpha(readLength + 1, tplLength + 1);
+        M beta(readLength + 1, tplLength + 1);
+
+        FillStatistics stats;
+        int flipflops = recursor.FillAlphaBeta(e, alpha, beta, &stats);
+        EXPECT_EQ(flipflops, stats.FlipFlops);
+        EXPECT_EQ(flipflops + 2, stats.Passes);
+        EXPECT_LE(flipflops, RecursorConfig().MaxFlipFlops + 1);
+        EXPECT_EQ(alpha.UsedEntries(), stats.AlphaUsedEntries);
+        EXPECT_EQ(beta.AllocatedEntries(), stats.BetaAllocatedEntries);
+        EXPECT_LE(stats.AlphaUsedEntries, stats.AlphaAllocatedEntries);
+        EXPECT_LE(0, stats.Seconds);
+    }
+}
+
+TYPED_TEST(RecursorFuzzTest, RebandingStopsOnceTheBandIsStable)
+{
+    // A zero threshold always rebands; stopping once a refill leaves
+    // its band as it was must change nothing over the three rebanding
+    // passes done unconditionally
+    R recursor(BASIC_MOVES | MERGE, this->banding_, RecursorConfig(5, 0.2f, 0));
+
+    foreach (const QvEvaluator& e, this->fuzzEvaluators_) {
+        int tplLength = e.TemplateLength();
+        int readLength = e.ReadLength();
+
+        M alpha(readLength + 1, tplLength + 1);
+        M beta(readLength + 1, tplLength + 1);
+        int flipflops = recursor.FillAlphaBeta(e, alpha, beta);
+        EXPECT_LE(1, flipflops);
+
+        M alpha3(readLength + 1, tplLength + 1);
+        M beta3(readLength + 1, tplLength + 1);
+        recursor.FillAlpha(e, alpha3.Null(), alpha3);
+        recursor.FillBeta(e, alpha3, beta3);
+        recursor.FillAlpha(e, beta3, alpha3);
+        recursor.FillBeta(e, alpha3, beta3);
+        recursor.FillAlpha(e, beta3, alpha3);
+        if (flipflops <= 3) {
+            EXPECT_EQ(alpha3(readLength, tplLength), alpha(readLength, tplLength));
+            EXPECT_EQ(beta3(0, 0), beta(0, 0));
+            EXPECT_EQ(alpha3.UsedEntries(), alpha.UsedEntries());
+        }
+    }
+}
+
+TYPED_TEST(RecursorFuzzTest, CompactedBandsScoreAlike)
+{
+    // The used rows of every column are all that is ever read, so the
+    // compacted matrices link, extend and refill exactly as the others
+    R recursor(BASIC_MOVES | MERGE, this->banding_);
+    R compacting(BASIC_MOVES | MERGE, this->banding_,
+                 RecursorConfig(5, 0.2f, 0.04, EXACT_LOGADD, true));
+
+    foreach (const QvEvaluator& e, this->fuzzEvaluators_) {
+        int tplLength = e.TemplateLength();
+        int readLength = e.ReadLength();
+
+        M alpha(readLength + 1, tplLength + 1), beta(readLength + 1, tplLength + 1);
+        M compactAlpha(readLength + 1, tplLength + 1), compactBeta(readLength + 1, tplLength + 1);
+        FillStatistics stats, compactStats;
+        recursor.FillAlphaBeta(e, alpha, beta, &stats);
+        compacting.FillAlphaBeta(e, compactAlpha, compactBeta, &compactStats);
+        EXPECT_EQ(stats.AlphaAllocatedEntries, compactStats.AlphaAllocatedEntries);
+        EXPECT_EQ(alpha.UsedEntries(), compactAlpha.UsedEntries());
+        EXPECT_LE(compactAlpha.AllocatedEntries(), alpha.AllocatedEntries());
+        EXPECT_LE(compactBeta.AllocatedEntries(), beta.AllocatedEntries());
+        EXPECT_EQ(alpha(readLength, tplLength), compactAlpha(readLength, tplLength));
+        EXPECT_EQ(beta(0, 0), compactBeta(0, 0));
+
+        M ext(readLength + 1, 2), compactExt(readLength + 1, 2);
+        for (int j = 2; j < tplLength - 1; j += 5) {
+            EXPECT_EQ(recursor.LinkAlphaBeta(e, alpha, j, beta, j, j),
+                      recursor.LinkAlphaBeta(e, compactAlpha, j, compactBeta, j, j));
+            recursor.ExtendAlpha(e, alpha, j, ext);
+            recursor.ExtendAlpha(e, compactAlpha, j, compactExt);
+            EXPECT_EQ(ext(readLength, 1), compactExt(readLength, 1)) << j;
+        }
+
+        M refilledAlpha(readLength + 1, tplLength + 1), refilledBeta(readLength + 1, tplLength + 1);
+        ASSERT_TRUE(compacting.RefillAlphaBeta(e, compactAlpha, compactBeta, tplLength / 2,
+                                               tplLength / 4, refilledAlpha, refilledBeta));
+        EXPECT_EQ(beta(0, 0), refilledBeta(0, 0));
+        EXPECT_LE(refilledAlpha.AllocatedEntries(), alpha.AllocatedEntries());
     }
 }
 
@@ -300,6 +420,12 @@ TYPED_TEST(RecursorFuzzTest, Alignment)
         recursor.FillAlphaBeta(e, alpha, beta);
         const PairwiseAlignment* alignment = recursor.Alignment(e, alpha);
         EXPECT_TRUE(alignment->Target().length() == alignment->Query().length());
+
+        CompactAlignment compact = recursor.Traceback(e, alpha);
+        EXPECT_EQ(readLength, compact.ReadLength());
+        EXPECT_EQ(tplLength, compact.TemplateLength());
+        EXPECT_EQ(alignment->Target(), compact.Target(e.Template()));
+        EXPECT_EQ(alignment->Query(), compact.Query(e.Basecalls()));
         delete alignment;
     }
 }
@@ -319,7 +445,7 @@ TYPED_TEST(RecursorFuzzTest, LinkAlphaBeta)
         float score = beta(0, 0);
         for (int j = 2; j < tplLength - 1; j++) {
             float linkScore = recursor.LinkAlphaBeta(e, alpha, j, beta, j, j);
-            ASSERT_FLOAT_EQ(score, linkScore) << "(Column " << j << ")";
+            ASSERT_SCORE_EQ(score, linkScore) << "(Column " << j << ")";
         }
     }
 }
@@ -372,3 +498,227 @@ TYPED_TEST(RecursorFuzzTest, ExtendBeta)
         }
     }
 }
+
+TYPED_TEST(RecursorFuzzTest, ExtendBetaAcrossMutations)
+{
+    // The extensions MutationScorer asks for near the template start,
+    // checked against SimpleRecursor's
+    R recursor(BASIC_MOVES | MERGE, this->banding_);
+    SimpleRecursor<M, E, detail::ViterbiCombiner> simpleRecursor(BASIC_MOVES | MERGE,
+                                                                 this->banding_);
+
+    foreach (const QvEvaluator& e, this->fuzzEvaluators_) {
+        int tplLength = e.TemplateLength();
+        int readLength = e.ReadLength();
+
+        M alpha(readLength + 1, tplLength + 1);
+        M beta(readLength + 1, tplLength + 1);
+        recursor.FillAlphaBeta(e, alpha, beta);
+
+        for (int pos = 0; pos < 4; pos++) {
+            std::vector<Mutation> muts;
+            muts.push_back(Mutation(INSERTION, pos, 'A'));
+            muts.push_back(Mutation(DELETION, pos, '-'));
+            muts.push_back(Mutation(SUBSTITUTION, pos, 'C'));
+            muts.push_back(Mutation(SUBSTITUTION, pos, pos + 2, "GT"));
+            foreach (const Mutation& m, muts) {
+                E mutatedE(e);
+                mutatedE.ApplyMutation(m);
+                int lastColumn = m.End();
+                int numExtColumns = m.End() + m.LengthDiff() + 1;
+
+                M ext(readLength + 1, numExtColumns);
+                M expected(readLength + 1, numExtColumns);
+                recursor.ExtendBeta(mutatedE, beta, lastColumn, ext, numExtColumns, m.LengthDiff());
+                simpleRecursor.ExtendBeta(mutatedE, beta, lastColumn, expected, numExtColumns,
+                                          m.LengthDiff());
+                for (int extCol = 0; extCol < numExtColumns; extCol++) {
+                    ASSERT_EQ(expected.UsedRowRange(extCol), ext.UsedRowRange(extCol));
+                    for (int i = 0; i <= readLength; i++) {
+                        ASSERT_FLOAT_EQ(expected(i, extCol), ext(i, extCol))
+                            << m.ToString() << " " << i << " " << extCol << std::endl;
+                    }
+                }
+            }
+        }
+    }
+}
+
+#ifdef __AVX2__
+template <int W>
+void CheckSimdLogExp()
+{
+    float xs[W];
+    for (float x = -80.0f; x < 80.0f; x += W * 0.37f) {
+        for (int k = 0; k < W; k++) {
+            xs[k] = x + k * 0.37f;
+        }
+        float exps[W], logs[W];
+        Simd<W>::Store(exps, detail::ExpN<W>(Simd<W>::Load(xs)));
+        Simd<W>::Store(logs, detail::LogN<W>(Simd<W>::Load(exps)));
+        for (int k = 0; k < W; k++) {
+            ASSERT_NEAR(1.0, exps[k] / std::exp(xs[k]), 1e-6) << xs[k];
+            ASSERT_NEAR(xs[k], logs[k], 1e-4) << xs[k];
+        }
+    }
+}
+
+TEST(SimdMathTest, LogExp)
+{
+    CheckSimdLogExp<8>();
+#ifdef __AVX512F__
+    CheckSimdLogExp<16>();
+#endif
+}
+
+#endif  // __AVX2__
+
+template <typename K>
+void CheckFastLogAdd(float maxError)
+{
+    float xs[4], ys[4], sums[4];
+    for (float d = 0.0f; d < 30.0f; d += 4 * 0.0013f) {
+        for (int k = 0; k < 4; k++) {
+            xs[k] = -3.5f;
+            ys[k] = xs[k] - (d + k * 0.0013f);
+        }
+        Simd<4>::Store(sums, K::Combine4(Simd<4>::Load(xs), Simd<4>::Load(ys)));
+        for (int k = 0; k < 4; k++) {
+            double x = static_cast<double>(xs[k]);
+            double exact = x + std::log1p(std::exp(static_cast<double>(ys[k]) - x));
+            ASSERT_NEAR(exact, sums[k], maxError) << xs[k] - ys[k];
+            ASSERT_NEAR(exact, K::Combine(ys[k], xs[k]), maxError) << xs[k] - ys[k];
+        }
+    }
+    // Infinite operands are those of the exact sum
+    const float INF = std::numeric_limits<float>::infinity();
+    EXPECT_EQ(2.0f, K::Combine(2.0f, -INF));
+    EXPECT_EQ(-INF, K::Combine(-INF, -INF));
+    Simd<4>::Store(sums, K::Combine4(Simd<4>::Set1(-INF), Simd<4>::Set1(-INF)));
+    EXPECT_EQ(-INF, sums[0]);
+}
+
+TEST(SimdMathTest, FastLogAddIsWithinItsBound)
+{
+    CheckFastLogAdd<detail::TableSumProductCombiner>(LOG1P_EXP_TABLE_MAX_ERROR);
+    CheckFastLogAdd<detail::PolynomialSumProductCombiner>(LOG1P_EXP_POLYNOMIAL_MAX_ERROR);
+}
+
+TEST(SimdRecursorTest, FastLogAddScoresAreNearExact)
+{
+    Rng rng(42);
+    BandingOptions banding(4, 200);
+    SparseSseQvSumProductRecursor exact(BASIC_MOVES | MERGE, banding);
+    for (int mode = TABLE_LOGADD; mode <= POLYNOMIAL_LOGADD; mode++) {
+        RecursorConfig config(5, 0.2f, 0.04, static_cast<LogAddMode>(mode));
+        SparseSseQvSumProductRecursor fast(BASIC_MOVES | MERGE, banding, config);
+        float maxError =
+            (mode == TABLE_LOGADD) ? LOG1P_EXP_TABLE_MAX_ERROR : LOG1P_EXP_POLYNOMIAL_MAX_ERROR;
+
+        for (int n = 0; n < 10; n++) {
+            QvEvaluator e = RandomQvEvaluator(rng, 50 + n * 11);
+            int I = e.ReadLength(), J = e.TemplateLength();
+            SparseMatrix alpha(I + 1, J + 1), beta(I + 1, J + 1);
+            SparseMatrix fastAlpha(I + 1, J + 1), fastBeta(I + 1, J + 1);
+            exact.FillAlphaBeta(e, alpha, beta);
+            fast.FillAlphaBeta(e, fastAlpha, fastBeta);
+            // Each cell adds at most a few errors to those of the cells
+            // it draws on
+            float tolerance = 4 * (I + J) * maxError;
+            EXPECT_NEAR(alpha(I, J), fastAlpha(I, J), ScoreTolerance(alpha(I, J), tolerance));
+            EXPECT_NEAR(beta(0, 0), fastBeta(0, 0), ScoreTolerance(beta(0, 0), tolerance));
+        }
+    }
+}
+
+TEST(SimdRecursorTest, DispatchedWidthsAgree)
+{
+    Rng rng(42);
+    BandingOptions banding(4, 200);
+    SetMaxSimdWidth(4);
+    SparseSseQvSumProductRecursor sse(BASIC_MOVES | MERGE, banding);
+    EXPECT_EQ(4, sse.Width());
+
+    for (int width = 8; width <= 16; width *= 2) {
+        SetMaxSimdWidth(width);
+        SparseSseQvSumProductRecursor wide(BASIC_MOVES | MERGE, banding);
+        EXPECT_EQ(SimdWidth(), wide.Width());
+        EXPECT_LE(wide.Width(), width);
+
+        for (int n = 0; n < 20; n++) {
+            QvEvaluator e = RandomQvEvaluator(rng, 50 + n * 7);
+            int I = e.ReadLength(), J = e.TemplateLength();
+            SparseMatrix alpha4(I + 1, J + 1), beta4(I + 1, J + 1);
+            SparseMatrix alphaN(I + 1, J + 1), betaN(I + 1, J + 1);
+            sse.FillAlphaBeta(e, alpha4, beta4);
+            wide.FillAlphaBeta(e, alphaN, betaN);
+            EXPECT_NEAR(alpha4(I, J), alphaN(I, J), ScoreTolerance(alpha4(I, J), 0.01f));
+            EXPECT_NEAR(beta4(0, 0), betaN(0, 0), ScoreTolerance(beta4(0, 0), 0.01f));
+            for (int j = 2; j < J - 2; j++) {
+                float linkScore = sse.LinkAlphaBeta(e, alpha4, j, beta4, j, j);
+                EXPECT_NEAR(linkScore, wide.LinkAlphaBeta(e, alphaN, j, betaN, j, j),
+                            ScoreTolerance(linkScore, 0.01f));
+            }
+        }
+    }
+    SetMaxSimdWidth(16);
+    EXPECT_THROW(SetMaxSimdWidth(5), InvalidInputError);
+}
+
+TEST(Int16RecursorTest, MatchesFloatViterbi)
+{
+    // Reads are their templates with a few edits, so the best path runs
+    // well inside the band and the banding granularity (the float
+    // recursor stops row by row, the int16 one eight rows at a time)
+    // does not matter.
+    Rng rng(42);
+    for (int k = 0; k < 2; k++) {
+        BandingOptions banding(4, k == 0 ? 200 : 12.5);
+        Int16ViterbiRecursor compact(BASIC_MOVES | MERGE, banding);
+        SparseSimpleQvRecursor reference(BASIC_MOVES | MERGE, banding);
+
+        for (int n = 0; n < 25; n++) {
+            int length = 20 + n * 20;
+            std::string tpl = RandomSequence(rng, length);
+            std::string seq = tpl.substr(0, length / 3) + "T" + tpl.substr(length / 3);
+            seq[2 * length / 3] = 'A';
+            seq.erase(length / 2, 1);
+            QvEvaluator e(AnonymousRead(seq), tpl, TestingParams());
+
+            int I = e.ReadLength(), J = e.TemplateLength();
+            SparseMatrix alpha(I + 1, J + 1);
+            reference.FillAlpha(e, SparseMatrix::Null(), alpha);
+            // rounding costs at most half a unit per move
+            float tolerance = (I + J + 1) * 0.5f / Int16ViterbiRecursor::Scale;
+            EXPECT_LT(-FLT_MAX, alpha(I, J));
+            EXPECT_NEAR(alpha(I, J), compact.Score(e), tolerance);
+        }
+    }
+}
+
+TEST(ScaledRecursorTest, MatchesLogSpaceSumProduct)
+{
+    // Reads are their templates with a few edits, so the end of the
+    // alignment is never far below the best of its column
+    Rng rng(42);
+    for (int k = 0; k < 3; k++) {
+        BandingOptions banding(4, k == 0 ? 200 : (k == 1 ? 18 : 12.5));
+        ScaledSumProductRecursor scaled(BASIC_MOVES | MERGE, banding);
+        SparseSseQvSumProductRecursor reference(BASIC_MOVES | MERGE, banding);
+
+        for (int n = 0; n < 25; n++) {
+            int length = 20 + n * 20;
+            std::string tpl = RandomSequence(rng, length);
+            std::string seq = tpl.substr(0, length / 3) + "T" + tpl.substr(length / 3);
+            seq[2 * length / 3] = 'A';
+            seq.erase(length / 2, 1);
+            QvEvaluator e(AnonymousRead(seq), tpl, TestingParams());
+
+            int I = e.ReadLength(), J = e.TemplateLength();
+            SparseMatrix alpha(I + 1, J + 1);
+            reference.FillAlpha(e, SparseMatrix::Null(), alpha);
+            EXPECT_LT(-FLT_MAX, alpha(I, J));
+            EXPECT_NEAR(alpha(I, J), scaled.Score(e), ScoreTolerance(alpha(I, J), 1e-3f));
+        }
+    }
+}
@@ -0,0 +1,93 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <ConsensusCore/Quiver/SimdRecursor.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+// A sequence of length n, of ACGT in both cases with, if mixed, an
+// occasional other character
+std::string TestSequence(int n, bool mixed)
+{
+    const char* bases = mixed ? "ACGTacgtACGTNM-ACGTacgt" : "ACGTTGCAAGCTtcga";
+    int numBases = std::string(bases).length();
+    std::string seq(n, 'A');
+    for (int i = 0; i < n; i++) {
+        seq[i] = bases[(i * 7 + i / 5) % numBases];
+    }
+    return seq;
+}
+
+std::string ReverseComplementByBase(const std::string& seq)
+{
+    std::string rc;
+    for (int i = seq.length() - 1; i >= 0; i--) {
+        rc.push_back(ComplementaryBase(seq[i]));
+    }
+    return rc;
+}
+}
+
+TEST(SequenceTest, ComplementaryBases)
+{
+    EXPECT_EQ('T', ComplementaryBase('A'));
+    EXPECT_EQ('g', ComplementaryBase('c'));
+    EXPECT_EQ('M', ComplementaryBase('N'));
+    EXPECT_EQ('-', ComplementaryBase('-'));
+    EXPECT_EQ(127, ComplementaryBase(static_cast<char>(0xC3)));
+    EXPECT_EQ("ATTGCAT", ReverseComplement("ATGCAAT"));
+    EXPECT_EQ("TACGTTA", Complement("ATGCAAT"));
+}
+
+TEST(SequenceTest, BlocksAndTheirTailsAgreeWithBaseByBase)
+{
+    int widths[] = {4, 16};
+    for (int w = 0; w < 2; w++) {
+        SetMaxSimdWidth(widths[w]);
+        for (int mixed = 0; mixed < 2; mixed++) {
+            for (int n = 0; n < 200; n += (n < 70) ? 1 : 13) {
+                std::string seq = TestSequence(n, mixed);
+                std::string rc = ReverseComplementByBase(seq);
+                EXPECT_EQ(rc, ReverseComplement(seq));
+                EXPECT_EQ(Reverse(rc), Complement(seq));
+
+                // into buffers, complementing in place
+                std::string buffer(seq);
+                Complement(&buffer[0], n, &buffer[0]);
+                EXPECT_EQ(Reverse(rc), buffer);
+                std::string out(n + 1, '*');
+                ReverseComplement(seq.data(), n, &out[0]);
+                EXPECT_EQ(rc + "*", out);
+            }
+        }
+    }
+    SetMaxSimdWidth(16);
+}
+
+TEST(SequenceTest, PackedSequencesReverseComplementByWord)
+{
+    for (int n = 0; n < 200; n += (n < 70) ? 1 : 13) {
+        std::string seq = TestSequence(n, false);
+        for (int i = 0; i < n; i++) {
+            seq[i] = toupper(seq[i]);
+        }
+        PackedSequence packed(seq);
+        EXPECT_EQ(n, packed.Length());
+        EXPECT_EQ(seq, packed.ToString());
+        EXPECT_EQ(static_cast<size_t>((n + 31) / 32 * 8), packed.Bytes());
+        PackedSequence rc = packed.ReverseComplement();
+        EXPECT_EQ(ReverseComplement(seq), rc.ToString());
+        EXPECT_TRUE(packed == rc.ReverseComplement());
+        if (n > 0) {
+            EXPECT_EQ(ComplementaryBase(seq[n - 1]), rc.Base(0));
+        }
+    }
+    EXPECT_THROW(PackedSequence("ACGN"), InvalidInputError);
+    EXPECT_THROW(PackedSequence("acgt"), InvalidInputError);
+}
@@ -67,3 +67,42 @@ TEST(SparseVector, CopyTest)
         ASSERT_EQ(sv(i), svCopy(i));
     }
 }
+
+TEST(SparseVectorTest, ArenaTest)
+{
+    BandArena arena(100);
+    SparseVector sv(100, &arena);
+    EXPECT_EQ(0, sv.AllocatedEntries());
+    EXPECT_FALSE(sv.IsAllocated(50));
+    EXPECT_EQ(-FLT_MAX, sv(50));
+
+    sv.ResetForRange(40, 60);
+    for (int i = 40; i < 60; i++) {
+        sv.Set(i, i);
+    }
+    // expanding the band preserves the contents
+    sv.Set(90, 90);
+    sv.Set(2, 2);
+    for (int i = 0; i < 100; i++) {
+        if ((i >= 40 && i < 60) || i == 90 || i == 2)
+            EXPECT_EQ(i, sv(i));
+        else
+            EXPECT_EQ(-FLT_MAX, sv(i));  // NOLINT
+    }
+
+    // a narrower band reuses the storage
+    int allocated = sv.AllocatedEntries();
+    sv.ResetForRange(10, 20);
+    EXPECT_EQ(allocated, sv.AllocatedEntries());
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(-FLT_MAX, sv(i));
+    }
+
+    BandArena otherArena(0);
+    sv.Set(15, 15);
+    SparseVector svCopy(sv, &otherArena);
+    EXPECT_LT(0, otherArena.ReservedEntries());
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(sv(i), svCopy(i));
+    }
+}
@@ -0,0 +1,96 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/StreamingQuiver.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+std::string RandomSequence(int length, unsigned int seed)
+{
+    std::string seq;
+    for (int i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        seq += "ACGT"[(seed >> 16) % 4];
+    }
+    return seq;
+}
+
+// The draft drops truth base 1000 and has a base inserted before truth
+// base 2200
+int DraftPosition(int truthPos) { return truthPos - (truthPos > 1000) + (truthPos >= 2200); }
+}
+
+TEST(StreamingQuiverTest, PolishesAReferenceInOnePass)
+{
+    const int length = 3000;
+    const int readLength = 400;
+    std::string truth = RandomSequence(length, 17);
+    std::string draft = truth.substr(0, 1000) + truth.substr(1001, 1199) + "A" + truth.substr(2200);
+    draft[300] = (draft[300] == 'A') ? 'C' : 'A';
+    draft[1700] = (draft[1700] == 'G') ? 'T' : 'G';
+
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    StreamingQuiver sq(configs, draft, 500);
+
+    std::string sequence;
+    std::vector<int> qvs;
+    int numReads = 0;
+    int maxWindow = 0;
+    for (int k = 0; k * 50 + readLength <= length; k++) {
+        int start = k * 50;
+        std::string seq = truth.substr(start, readLength);
+        StrandEnum strand = (k % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        if (strand == REVERSE_STRAND) seq = ReverseComplement(seq);
+        sq.AddRead(MappedRead(Read(QvSequenceFeatures(seq), "read", "test"), strand,
+                              DraftPosition(start), DraftPosition(start + readLength)));
+        maxWindow = std::max(maxWindow, sq.WindowLength());
+
+        ConsensusResult r = sq.Take();
+        sequence += r.Sequence;
+        qvs.insert(qvs.end(), r.QVs.begin(), r.QVs.end());
+        numReads += r.NumReads;
+    }
+    sq.Finish();
+    ConsensusResult r = sq.Take();
+    EXPECT_TRUE(r.Converged);
+    sequence += r.Sequence;
+    qvs.insert(qvs.end(), r.QVs.begin(), r.QVs.end());
+    numReads += r.NumReads;
+
+    EXPECT_EQ(truth, sequence);
+    EXPECT_EQ(truth.length(), qvs.size());
+    EXPECT_EQ(53, numReads);
+    EXPECT_LT(maxWindow, 2 * (readLength + 500));
+    EXPECT_EQ(0, sq.WindowLength());
+
+    // Nothing more can be added once finished
+    EXPECT_THROW(sq.AddRead(MappedRead(Read(QvSequenceFeatures("ACGT"), "read", "test"),
+                                       FORWARD_STRAND, 2990, 2994)),
+                 InvalidInputError);
+}
+
+TEST(StreamingQuiverTest, RejectsReadsOutOfOrder)
+{
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    std::string reference = RandomSequence(1000, 3);
+    StreamingQuiver sq(configs, reference);
+    Read read(QvSequenceFeatures(reference.substr(200, 100)), "read", "test");
+    sq.AddRead(MappedRead(read, FORWARD_STRAND, 200, 300));
+    EXPECT_THROW(sq.AddRead(MappedRead(read, FORWARD_STRAND, 100, 200)), InvalidInputError);
+    EXPECT_THROW(sq.AddRead(MappedRead(read, FORWARD_STRAND, 950, 1050)), InvalidInputError);
+    EXPECT_THROW(StreamingQuiver(configs, reference, 0), InvalidInputError);
+}
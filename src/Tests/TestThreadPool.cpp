@@ -0,0 +1,51 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/ThreadPool.hpp>
+#include <ConsensusCore/Types.hpp>
+
+using namespace ConsensusCore;  // NOLINT
+
+TEST(ThreadPoolTest, EachIndexRunsOnce)
+{
+    ThreadPool pool(4);
+    EXPECT_EQ(4, pool.NumThreads());
+
+    for (int n = 0; n < 50; n += 7) {
+        std::vector<int> counts(n, 0);
+        pool.ParallelFor(n, [&](int i) { counts[i]++; });
+        for (int i = 0; i < n; i++) {
+            EXPECT_EQ(1, counts[i]);
+        }
+    }
+}
+
+TEST(ThreadPoolTest, NestedCallsRunInline)
+{
+    ThreadPool pool(3);
+    std::atomic<int> total(0);
+    pool.ParallelFor(6, [&](int) { pool.ParallelFor(5, [&](int j) { total += j; }); });
+    EXPECT_EQ(6 * 10, total.load());
+}
+
+TEST(ThreadPoolTest, ExceptionsPropagate)
+{
+    ThreadPool pool(2);
+    EXPECT_THROW(pool.ParallelFor(10,
+                                  [](int i) {
+                                      if (i == 3) throw InternalError("boom");
+                                  }),
+                 InternalError);
+
+    // The pool is still usable afterwards
+    std::atomic<int> calls(0);
+    pool.ParallelFor(10, [&](int) { calls++; });
+    EXPECT_EQ(10, calls.load());
+
+    EXPECT_THROW(ThreadPool(0), InvalidInputError);
+}
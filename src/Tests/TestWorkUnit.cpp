@@ -0,0 +1,327 @@
+// Author: David Alexander
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+#include <ConsensusCore/Features.hpp>
+#include <ConsensusCore/Quiver/WorkUnit.hpp>
+#include <ConsensusCore/Read.hpp>
+#include <ConsensusCore/Sequence.hpp>
+#include <ConsensusCore/Types.hpp>
+#include <ConsensusCore/Utils.hpp>
+
+#include "ParameterSettings.hpp"
+
+using namespace ConsensusCore;  // NOLINT
+
+namespace {
+// A read whose InsQv is fractional, so kept as floats, and whose other
+// tracks take a byte a base
+MappedRead TestRead(const std::string& seq, const std::string& chemistry, StrandEnum strand,
+                    int tStart, int tEnd)
+{
+    int n = seq.length();
+    std::vector<float> insQv(n), subsQv(n), delQv(n), delTag(n), mergeQv(n);
+    for (int i = 0; i < n; i++) {
+        insQv[i] = i + 0.5f;
+        subsQv[i] = 2 * i;
+        delQv[i] = 3 * i;
+        delTag[i] = "ACGTN"[i % 5];
+        mergeQv[i] = 100 - i;
+    }
+    QvSequenceFeatures f(seq, &insQv[0], &subsQv[0], &delQv[0], &delTag[0], &mergeQv[0]);
+    return MappedRead(Read(f, "read/" + seq.substr(0, 3), chemistry), strand, tStart, tEnd,
+                      tStart == 0, false);
+}
+
+void ExpectSameTrack(const Feature<float>& expected, const Feature<float>& actual)
+{
+    ASSERT_EQ(expected.Length(), actual.Length());
+    for (int i = 0; i < expected.Length(); i++) {
+        EXPECT_EQ(expected[i], actual[i]);
+    }
+}
+}
+
+TEST(WorkUnitTest, RoundTrips)
+{
+    WorkUnit unit(42, "GATTACAGATTACA");
+    unit.Reads.push_back(TestRead("GATTACA", "P6-C4", FORWARD_STRAND, 0, 7));
+    unit.Reads.push_back(TestRead("TGTAATC", "S/P1-C1", REVERSE_STRAND, 6, 14));
+    unit.Reads.push_back(TestRead("TTACAG", "P6-C4", FORWARD_STRAND, 2, 8));
+    unit.Reads.push_back(TestRead("", "P6-C4", FORWARD_STRAND, 3, 3));
+
+    boost::shared_ptr<std::string> buffer(new std::string(EncodeWorkUnit(unit)));
+    WorkUnit decoded = DecodeWorkUnit(buffer);
+    EXPECT_EQ(42, decoded.Id);
+    EXPECT_EQ(unit.Template, decoded.Template);
+    ASSERT_EQ(unit.Reads.size(), decoded.Reads.size());
+    for (size_t k = 0; k < unit.Reads.size(); k++) {
+        const MappedRead& a = unit.Reads[k];
+        const MappedRead& b = decoded.Reads[k];
+        EXPECT_EQ(a.Name, b.Name);
+        EXPECT_EQ(a.Chemistry, b.Chemistry);
+        EXPECT_EQ(a.Strand, b.Strand);
+        EXPECT_EQ(a.TemplateStart, b.TemplateStart);
+        EXPECT_EQ(a.TemplateEnd, b.TemplateEnd);
+        EXPECT_EQ(a.PinStart, b.PinStart);
+        EXPECT_EQ(a.PinEnd, b.PinEnd);
+        EXPECT_EQ(a.Features.Sequence().ToString(), b.Features.Sequence().ToString());
+        ExpectSameTrack(a.Features.SequenceAsFloat, b.Features.SequenceAsFloat);
+        ExpectSameTrack(a.Features.InsQv, b.Features.InsQv);
+        ExpectSameTrack(a.Features.SubsQv, b.Features.SubsQv);
+        ExpectSameTrack(a.Features.DelQv, b.Features.DelQv);
+        ExpectSameTrack(a.Features.DelTag, b.Features.DelTag);
+        ExpectSameTrack(a.Features.MergeQv, b.Features.MergeQv);
+    }
+
+    // The bases and the float track view the buffer
+    const char* begin = buffer->data();
+    const char* end = begin + buffer->size();
+    const char* bases = decoded.Reads[0].Features.Sequence().get();
+    const char* insQv = reinterpret_cast<const char*>(decoded.Reads[0].Features.InsQv.get());
+    EXPECT_TRUE(begin <= bases && bases < end);
+    EXPECT_TRUE(begin <= insQv && insQv < end);
+
+    // and the buffer outlives it
+    buffer.reset();
+    EXPECT_EQ("GATTACA", decoded.Reads[0].Features.Sequence().ToString());
+}
+
+TEST(WorkUnitTest, RejectsBadEncodings)
+{
+    WorkUnit unit(1, "GATTACA");
+    unit.Reads.push_back(TestRead("GATTACA", "P6-C4", FORWARD_STRAND, 0, 7));
+    std::string bytes = EncodeWorkUnit(unit);
+
+    EXPECT_THROW(DecodeWorkUnit(bytes.substr(0, bytes.size() - 8)), InvalidInputError);
+    EXPECT_THROW(DecodeWorkUnit(bytes + std::string(8, '\0')), InvalidInputError);
+    EXPECT_THROW(DecodeWorkUnit(std::string()), InvalidInputError);
+    std::string versioned = bytes;
+    versioned[8]++;
+    EXPECT_THROW(DecodeWorkUnit(versioned), InvalidInputError);
+    EXPECT_THROW(DecodeConsensusResult(bytes), InvalidInputError);
+
+    // Reads must lie within the template
+    const int extents[][2] = {{-1, 6}, {5, 4}, {0, 8}};
+    foreach (const int* e, extents) {
+        WorkUnit offTemplate(1, "GATTACA");
+        offTemplate.Reads.push_back(TestRead("GATTAC", "P6-C4", FORWARD_STRAND, e[0], e[1]));
+        EXPECT_THROW(DecodeWorkUnit(EncodeWorkUnit(offTemplate)), InvalidInputError);
+    }
+}
+
+TEST(WorkUnitTest, ResultsRoundTrip)
+{
+    ConsensusResult result;
+    result.Id = 7;
+    result.Sequence = "GATTACA";
+    result.QVs = {93, 0, 12, 40, 40, 7, 1};
+    result.Converged = true;
+    result.NumReads = 12;
+    ConsensusResult decoded = DecodeConsensusResult(EncodeConsensusResult(result));
+    EXPECT_EQ(result.Id, decoded.Id);
+    EXPECT_EQ(result.Sequence, decoded.Sequence);
+    EXPECT_EQ(result.QVs, decoded.QVs);
+    EXPECT_TRUE(decoded.Converged);
+    EXPECT_EQ(12, decoded.NumReads);
+    EXPECT_EQ("", decoded.Error);
+
+    ConsensusResult failed;
+    failed.Id = 8;
+    failed.Error = "no consensus";
+    EXPECT_EQ("no consensus", DecodeConsensusResult(EncodeConsensusResult(failed)).Error);
+
+    result.QVs.push_back(256);
+    EXPECT_THROW(EncodeConsensusResult(result), InvalidInputError);
+}
+
+TEST(WorkUnitTest, RefinesADecodedUnit)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    std::string draft = truth.substr(0, 20) + truth.substr(21);
+    WorkUnit unit(3, draft);
+    for (int i = 0; i < 6; i++) {
+        StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+        std::string seq = (strand == FORWARD_STRAND) ? truth : ReverseComplement(truth);
+        unit.Reads.push_back(
+            MappedRead(Read(QvSequenceFeatures(seq), "read", "test"), strand, 0, draft.length()));
+    }
+
+    QuiverConfigTable configs;
+    configs.InsertDefault(TestingConfig());
+    ConsensusResult result = RefineWorkUnit(configs, DecodeWorkUnit(EncodeWorkUnit(unit)));
+    EXPECT_EQ("", result.Error);
+    EXPECT_EQ(3, result.Id);
+    EXPECT_EQ(6, result.NumReads);
+    EXPECT_EQ(truth, result.Sequence);
+    EXPECT_EQ(truth.length(), result.QVs.size());
+
+    // A read of a chemistry the worker has no config for fails the unit
+    QuiverConfigTable strict;
+    strict.Insert(TestingConfig());
+    WorkUnit bad(4, draft);
+    bad.Reads.push_back(TestRead(truth, "P6-C4", FORWARD_STRAND, 0, draft.length()));
+    ConsensusResult failed = RefineWorkUnit(strict, bad);
+    EXPECT_NE("", failed.Error);
+    EXPECT_EQ(4, failed.Id);
+    EXPECT_EQ("", failed.Sequence);
+}
+
+TEST(WorkUnitTest, RefinesABatchAsUnitByUnit)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    std::vector<WorkUnit> units;
+    for (int u = 0; u < 12; u++) {
+        // Drafts missing a base apiece, of windows of assorted sizes
+        std::string window = truth.substr(0, truth.length() - 2 * u);
+        std::string draft = window.substr(0, 5 + u) + window.substr(6 + u);
+        WorkUnit unit(u, draft);
+        for (int i = 0; i < 3 + u % 4; i++) {
+            StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+            std::string seq = (strand == FORWARD_STRAND) ? window : ReverseComplement(window);
+            unit.Reads.push_back(MappedRead(Read(QvSequenceFeatures(seq), "read", "test"), strand,
+                                            0, draft.length()));
+        }
+        units.push_back(unit);
+    }
+    // one of which fails
+    units[7].Reads.push_back(TestRead(truth, "P6-C4", FORWARD_STRAND, 0, 10));
+
+    QuiverConfigTable configs;
+    configs.Insert(TestingConfig("test"));
+    BatchRefiner refiner(configs, 3);
+    EXPECT_EQ(3, refiner.NumThreads());
+    for (int batch = 0; batch < 2; batch++) {
+        std::vector<ConsensusResult> results = refiner.Refine(units);
+        ASSERT_EQ(units.size(), results.size());
+        for (size_t u = 0; u < units.size(); u++) {
+            ConsensusResult expected = RefineWorkUnit(configs, units[u]);
+            EXPECT_EQ(units[u].Id, results[u].Id);
+            EXPECT_EQ(expected.Error, results[u].Error);
+            EXPECT_EQ(expected.Sequence, results[u].Sequence);
+            EXPECT_EQ(expected.QVs, results[u].QVs);
+            EXPECT_EQ(expected.NumReads, results[u].NumReads);
+        }
+        EXPECT_NE("", results[7].Error);
+        EXPECT_EQ(truth.substr(0, truth.length() - 2), results[1].Sequence);
+    }
+
+    std::vector<ConsensusResult> single = RefineConsensusBatch(configs, units);
+    EXPECT_EQ(truth, single[0].Sequence);
+    EXPECT_THROW(BatchRefiner(configs, 0), InvalidInputError);
+}
+
+TEST(WorkUnitTest, RefinesAsynchronously)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    QuiverConfigTable configs;
+    configs.Insert(TestingConfig("test"));
+
+    // Units, as drafts missing a base; and windows, with no draft, of
+    // the reads alone
+    AsyncRefiner refiner(configs, 3);
+    EXPECT_EQ(3, refiner.NumThreads());
+    std::vector<RefineFuture> futures;
+    std::vector<ConsensusResult> expected;
+    for (int u = 0; u < 8; u++) {
+        std::string draft = truth.substr(0, 5 + u) + truth.substr(6 + u);
+        WorkUnit unit(u, draft);
+        ConsensusWindow window(100 + u);
+        for (int i = 0; i < 4; i++) {
+            StrandEnum strand = (i % 2 == 0) ? FORWARD_STRAND : REVERSE_STRAND;
+            std::string seq = (strand == FORWARD_STRAND) ? truth : ReverseComplement(truth);
+            Read read(QvSequenceFeatures(seq), "read", "test");
+            unit.Reads.push_back(MappedRead(read, strand, 0, draft.length()));
+            window.AddRead(read, strand);
+        }
+        futures.push_back(refiner.Submit(unit));
+        expected.push_back(RefineWorkUnit(configs, unit));
+        futures.push_back(refiner.SubmitWindow(window));
+        expected.push_back(FindWindowConsensus(configs, window));
+    }
+    futures.push_back(refiner.SubmitWindow(ConsensusWindow(200)));
+
+    // Every job finishes, and is reported finished, once
+    std::vector<int> finished;
+    for (size_t k = 0; k < futures.size(); k++) {
+        int ticket = refiner.NextCompleted();
+        ASSERT_LE(0, ticket);
+        finished.push_back(ticket);
+    }
+    EXPECT_EQ(-1, refiner.NextCompleted(0.01));
+    EXPECT_EQ(0, refiner.Pending());
+    std::sort(finished.begin(), finished.end());
+    for (size_t k = 0; k < futures.size(); k++) {
+        EXPECT_EQ(static_cast<int>(k), finished[k]);
+        EXPECT_EQ(static_cast<int>(k), futures[k].Ticket());
+        EXPECT_TRUE(futures[k].Wait(0));
+        EXPECT_TRUE(futures[k].Done());
+        EXPECT_FALSE(futures[k].Cancelled());
+    }
+    for (size_t k = 0; k < expected.size(); k++) {
+        ConsensusResult result = futures[k].Result();
+        EXPECT_EQ(expected[k].Id, result.Id);
+        EXPECT_EQ("", result.Error);
+        EXPECT_EQ(truth, result.Sequence);
+        EXPECT_EQ(expected[k].QVs, result.QVs);
+        EXPECT_EQ(4, result.NumReads);
+    }
+    EXPECT_EQ(200, futures.back().Result().Id);
+    EXPECT_NE("", futures.back().Result().Error);
+
+    EXPECT_EQ(-1, RefineFuture().Ticket());
+    EXPECT_THROW(RefineFuture().Wait(), InvalidInputError);
+    EXPECT_THROW(AsyncRefiner(configs, 0), InvalidInputError);
+}
+
+TEST(WorkUnitTest, CancelsQueuedJobs)
+{
+    std::string truth = "GATTACAGATTACATTGACCAGTACGGGATCCATTAGACAGGTCAATGCATTGCAGTTACC";
+    QuiverConfigTable configs;
+    configs.Insert(TestingConfig("test"));
+    WorkUnit unit(7, truth.substr(0, 20) + truth.substr(21));
+    for (int i = 0; i < 6; i++) {
+        unit.Reads.push_back(
+            MappedRead(Read(QvSequenceFeatures(truth), "read", "test"), FORWARD_STRAND, 0,
+                       truth.length() - 1));
+    }
+
+    // One worker, well behind: the last job is still queued
+    std::vector<RefineFuture> futures;
+    RefineFuture last;
+    {
+        AsyncRefiner refiner(configs, 1);
+        for (int k = 0; k < 200; k++) {
+            futures.push_back(refiner.Submit(unit));
+        }
+        last = futures.back();
+        EXPECT_TRUE(last.Cancel());
+        EXPECT_FALSE(last.Cancel());
+        EXPECT_TRUE(last.Cancelled());
+        EXPECT_TRUE(last.Wait(0));
+        EXPECT_EQ(7, last.Result().Id);
+        EXPECT_EQ("Cancelled", last.Result().Error);
+        EXPECT_GT(refiner.Pending(), 0);
+        EXPECT_LT(refiner.Pending(), 200);
+
+        ASSERT_LE(0, refiner.NextCompleted());
+        EXPECT_EQ(truth, futures[0].Result().Sequence);
+        // Destroying the refiner cancels the rest of the queue
+    }
+    int cancelled = 0;
+    foreach (const RefineFuture& future, futures) {
+        EXPECT_TRUE(future.Done());
+        if (future.Cancelled()) {
+            cancelled++;
+        } else {
+            EXPECT_EQ(truth, future.Result().Sequence);
+        }
+    }
+    EXPECT_GT(cancelled, 1);
+    EXPECT_FALSE(futures[0].Cancelled());
+}